@@ -0,0 +1,145 @@
+// Benchmarks a compiled kernel without Python:
+//
+//   triton-bench --cubin kernel.cubin --kernel name --grid 128,1,1 [--num-warps 4]
+//                [--shared bytes] [--arg ptr:bytes | i32:value | i64:value | f32:value]...
+//                [--warmup 10] [--repeat 200] [--no-flush] [--name name] [--output report.json]
+//
+// Pointer arguments are zero-initialized device buffers of the given size. The
+// statistics are printed as one line of JSON, and appended to the report if any.
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "triton/driver/dispatch.h"
+#include "triton/runtime/runtime.h"
+#include "triton/tools/bench.hpp"
+
+namespace drv = triton::driver;
+namespace rt = triton::runtime;
+
+namespace {
+
+struct options {
+  std::string cubin;
+  std::string kernel;
+  std::string name;
+  std::string output;
+  unsigned grid[3] = {1, 1, 1};
+  unsigned num_warps = 4;
+  unsigned shared = 0;
+  size_t warmup = 10;
+  size_t repeat = 200;
+  bool flush = true;
+  std::vector<std::string> args;
+};
+
+void usage(const char* prog) {
+  std::cerr << "usage: " << prog << " --cubin file --kernel name --grid x[,y[,z]] [--num-warps n] [--shared bytes]"
+            << " [--arg ptr:bytes|i32:v|i64:v|f32:v]... [--warmup n] [--repeat n] [--no-flush]"
+            << " [--name name] [--output file]" << std::endl;
+  exit(1);
+}
+
+options parse(int argc, char** argv) {
+  options opt;
+  for(int i = 1; i < argc; i++){
+    std::string key = argv[i];
+    if(key == "--no-flush"){
+      opt.flush = false;
+      continue;
+    }
+    if(i + 1 >= argc)
+      usage(argv[0]);
+    std::string val = argv[++i];
+    if(key == "--cubin") opt.cubin = val;
+    else if(key == "--kernel") opt.kernel = val;
+    else if(key == "--name") opt.name = val;
+    else if(key == "--output") opt.output = val;
+    else if(key == "--num-warps") opt.num_warps = std::stoul(val);
+    else if(key == "--shared") opt.shared = std::stoul(val);
+    else if(key == "--warmup") opt.warmup = std::stoul(val);
+    else if(key == "--repeat") opt.repeat = std::stoul(val);
+    else if(key == "--arg") opt.args.push_back(val);
+    else if(key == "--grid"){
+      size_t pos = 0;
+      for(int d = 0; d < 3 && pos != std::string::npos; d++){
+        size_t next = val.find(',', pos);
+        opt.grid[d] = std::stoul(val.substr(pos, next - pos));
+        pos = next == std::string::npos ? next : next + 1;
+      }
+    }
+    else
+      usage(argv[0]);
+  }
+  if(opt.cubin.empty() || opt.kernel.empty())
+    usage(argv[0]);
+  if(opt.name.empty())
+    opt.name = opt.kernel;
+  return opt;
+}
+
+}
+
+int main(int argc, char** argv) {
+  options opt = parse(argc, argv);
+  // context
+  CUdevice dev;
+  CUcontext ctx;
+  CUstream stream;
+  drv::dispatch::cuDeviceGet(&dev, 0);
+  drv::dispatch::cuCtxCreate_v2(&ctx, 0, dev);
+  drv::dispatch::cuStreamCreate(&stream, 0);
+  char device_name[256];
+  drv::dispatch::cuDeviceGetName(device_name, sizeof(device_name), dev);
+  // kernel
+  std::ifstream ifs(opt.cubin, std::ios::binary);
+  if(!ifs){
+    std::cerr << "cannot read " << opt.cubin << std::endl;
+    return 1;
+  }
+  std::string image((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  rt::module_registry registry;
+  const rt::kernel_t& kernel = registry.load(opt.cubin, dev, rt::CUDA, opt.kernel, image, opt.shared, 32 * opt.num_warps);
+  // arguments
+  rt::arg_packer params;
+  std::vector<CUdeviceptr> buffers;
+  for(const std::string& arg: opt.args){
+    size_t colon = arg.find(':');
+    if(colon == std::string::npos)
+      usage(argv[0]);
+    std::string ty = arg.substr(0, colon);
+    std::string val = arg.substr(colon + 1);
+    if(ty == "ptr"){
+      CUdeviceptr buf;
+      size_t size = std::stoull(val);
+      drv::dispatch::cuMemAlloc_v2(&buf, std::max<size_t>(size, 1));
+      drv::dispatch::cuMemsetD8Async(buf, 0, size, stream);
+      buffers.push_back(buf);
+      params.add_pointer(buf);
+    }
+    else if(ty == "i32") params.add_int32(std::stol(val));
+    else if(ty == "i64") params.add_int64(std::stoll(val));
+    else if(ty == "f32") params.add_float(std::stof(val));
+    else
+      usage(argv[0]);
+  }
+  // benchmark
+  auto launch = [&](){
+    rt::launch(kernel, (uint64_t)stream, opt.grid[0], opt.grid[1], opt.grid[2], params);
+  };
+  triton::tools::bench_result res = triton::tools::bench_events(launch, stream, opt.warmup, opt.repeat, opt.flush);
+  std::string json = res.to_json(opt.name, device_name);
+  std::cout << json << std::endl;
+  if(!opt.output.empty())
+    std::ofstream(opt.output, std::ios::app) << json << std::endl;
+  // cleanup
+  for(CUdeviceptr buf: buffers)
+    drv::dispatch::cuMemFree_v2(buf);
+  registry.clear();
+  drv::dispatch::cuStreamDestroy_v2(stream);
+  drv::dispatch::cuCtxDestroy_v2(ctx);
+  return 0;
+}
@@ -3,6 +3,7 @@
 
 #include <map>
 #include <set>
+#include <vector>
 #include <iostream>
 #include "triton/codegen/analysis/liveness.h"
 
@@ -30,12 +31,27 @@ public:
   bool has_offset(const data_layout *x)    const { return offsets_.find(x) != offsets_.end(); }
   unsigned offset(const data_layout *x)    const { return offsets_.at(x); }
   unsigned allocated_size()        const { return allocated_size_; }
+  // peak number of bytes live at the same time; a lower bound on `allocated_size()`
+  size_t max_live_size()           const { return max_live_size_; }
+  size_t wasted_size()             const { return allocated_size_ - max_live_size_; }
   // run
   void run(ir::module& mod);
 
 private:
+  unsigned lowest_offset(shared_layout* x, const std::vector<shared_layout*>& placed,
+                         const std::map<shared_layout*, unsigned>& offsets);
+  size_t place(const std::vector<shared_layout*>& order, std::map<shared_layout*, unsigned>& offsets,
+               size_t bound);
+  void search(std::vector<shared_layout*>& order, size_t n_placed,
+              std::map<shared_layout*, unsigned>& offsets, size_t size,
+              size_t& best, std::map<shared_layout*, unsigned>& best_offsets);
+
+private:
+  // buffers are placed exactly when there are at most this many
+  static const size_t max_exhaustive = 8;
   std::map<const data_layout*, unsigned> offsets_;
   size_t allocated_size_;
+  size_t max_live_size_;
   // dependences
   liveness *liveness_;
 };
@@ -1,8 +1,7 @@
 #ifndef _TRITON_CODEGEN_ANALYSIS_AXES_H_
 #define _TRITON_CODEGEN_ANALYSIS_AXES_H_
 
-#include "triton/tools/graph.h"
-#include <map>
+#include "triton/tools/union_find.h"
 #include <vector>
 
 namespace triton{
@@ -18,6 +17,11 @@ namespace analysis{
 
 class axes {
   typedef std::pair<ir::value*, unsigned> node_t;
+  struct node_hash {
+    size_t operator()(const node_t& x) const {
+      return std::hash<ir::value*>()(x.first) * 31 + x.second;
+    }
+  };
 
 private:
   // update graph
@@ -30,6 +34,7 @@ private:
   void update_graph_elementwise(ir::instruction *i,
                                 bool is_masked_load_async=false);
   void update_graph_no_edge(ir::instruction *i);
+  void update_graph_call(ir::instruction *i);
   void update_graph(ir::instruction *i);
 
 public:
@@ -40,8 +45,8 @@ public:
   std::vector<int> get(ir::value *value);
 
 private:
-  tools::graph<node_t> graph_;
-  std::map<node_t, size_t> axes_;
+  tools::union_find<node_t, node_hash> graph_;
+  tools::union_find<node_t, node_hash>::nmap_t axes_;
 };
 
 }
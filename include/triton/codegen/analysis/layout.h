@@ -5,7 +5,7 @@
 #include <set>
 #include <vector>
 #include <memory>
-#include "triton/tools/graph.h"
+#include "triton/tools/union_find.h"
 #include "triton/codegen/target.h"
 
 namespace triton{
@@ -116,6 +116,8 @@ public:
     FP32_FP16_FP16_FP32 = 0, // default
     FP32_BF16_BF16_FP32,
     FP32_TF32_TF32_FP32,
+    // fp16 accumulators, packed by pairs in 32-bit registers (sm >= 80)
+    FP16_FP16_FP16_FP16,
     // integer tensor core instr
     INT32_INT1_INT1_INT32, // Not implemented
     INT32_INT4_INT4_INT32, // Not implemented
@@ -129,6 +131,7 @@ public:
     {FP32_FP16_FP16_FP32, {16, 8, 16}}, 
     {FP32_BF16_BF16_FP32, {16, 8, 16}},
     {FP32_TF32_TF32_FP32, {16, 8, 8}},
+    {FP16_FP16_FP16_FP16, {16, 8, 16}},
 
     {INT32_INT1_INT1_INT32, {16, 8, 256}},
     {INT32_INT4_INT4_INT32, {16, 8, 64}},
@@ -140,6 +143,7 @@ public:
     {FP32_FP16_FP16_FP32, {8, 8, 8}}, 
     {FP32_BF16_BF16_FP32, {8, 8, 8}},
     {FP32_TF32_TF32_FP32, {8, 8, 4}},
+    {FP16_FP16_FP16_FP16, {8, 8, 8}},
 
     {INT32_INT1_INT1_INT32, {8, 8, 64}},
     {INT32_INT4_INT4_INT32, {8, 8, 32}},
@@ -150,6 +154,7 @@ public:
     {FP32_FP16_FP16_FP32, "mma.sync.aligned.m16n8k16.row.col.f32.f16.f16.f32"}, 
     {FP32_BF16_BF16_FP32, "mma.sync.aligned.m16n8k16.row.col.f32.bf16.bf16.f32"},
     {FP32_TF32_TF32_FP32, "mma.sync.aligned.m16n8k8.row.col.f32.tf32.tf32.f32"},
+    {FP16_FP16_FP16_FP16, "mma.sync.aligned.m16n8k16.row.col.f16.f16.f16.f16"},
 
     {INT32_INT1_INT1_INT32, "mma.sync.aligned.m16n8k256.row.col.s32.b1.b1.s32.xor.popc"},
     {INT32_INT4_INT4_INT32, "mma.sync.aligned.m16n8k64.row.col.satfinite.s32.s4.s4.s32"},
@@ -161,6 +166,7 @@ public:
     {FP32_FP16_FP16_FP32, 8},
     {FP32_BF16_BF16_FP32, 8},
     {FP32_TF32_TF32_FP32, 4},
+    {FP16_FP16_FP16_FP16, 8},
 
     {INT32_INT1_INT1_INT32, 128},
     {INT32_INT4_INT4_INT32, 32},
@@ -190,6 +196,9 @@ public:
   std::vector<int> get_mma_mat_shape() const { return mma_mat_shape_.at(tensor_core_type_); }
   int get_vec_a() const { return mma_instr_vec_.at(tensor_core_type_); }
   int get_vec_b() const { return mma_instr_vec_.at(tensor_core_type_); }
+  // whether the layout is the one of AMD matrix cores, where each wavefront (pair of
+  // warps) computes 32x32 tiles with v_mfma_f32_32x32x8f16, and `wpt` counts wavefronts
+  bool is_mfma() const { return is_mfma_; }
 
   // setter
   void set_tensor_core_type(TensorCoreType type) { tensor_core_type_ = type; }
@@ -209,6 +218,7 @@ private:
   std::vector<int> contig_per_thread_;
 
   TensorCoreType tensor_core_type_ = FP32_FP16_FP16_FP32;
+  bool is_mfma_ = false;
 };
 
 struct scanline_layout: public distributed_layout {
@@ -258,7 +268,8 @@ public:
                 const std::vector<unsigned>& shapes,
                 const std::vector<ir::value *> &values_,
                 ir::type *ty,
-                analysis::align* align, target *tgt);
+                analysis::align* align, target *tgt,
+                size_t num_warps);
   void accept(layout_visitor* vst) { vst->visit_layout_shared(this); }
   // accessors
   size_t get_size()                         { return size_; }
@@ -276,9 +287,13 @@ public:
   int  get_mma_strided()                    { return mma_strided_; }
   bool allow_swizzle() const                { return allow_swizzle_; }
   data_layout* get_arg_layout()             { return arg_layout_; }
+  // alignment of the offset of the buffer, in bytes
+  void set_alignment(size_t alignment)      { alignment_ = alignment; }
+  size_t get_alignment() const              { return alignment_; }
 
 private:
   size_t size_;
+  size_t alignment_ = 1;
   ir::type *ty_;
   std::shared_ptr<double_buffer_info_t> double_buffer_;
   std::shared_ptr<N_buffer_info_t>      N_buffer_;
@@ -310,7 +325,7 @@ private:
 
 public:
   // constructor
-  layouts(analysis::axes *axes, analysis::align *align, size_t num_warps, target* tgt);
+  layouts(analysis::axes *axes, analysis::align *align, size_t num_warps, target* tgt, bool tma = false);
 
   // accessors
   unsigned layout_of(ir::value *value) const                  { return groups_.at(value); }
@@ -323,6 +338,24 @@ public:
   bool has_tmp(ir::value* i)                                  { return tmp_.find(i) != tmp_.end(); }
   int tmp(ir::value* i)                                       { return tmp_.at(i);}
   void copy(ir::value* dst, ir::value* src)                   { groups_[dst] = groups_[src]; }
+  // Whether converting from `in` to `out` keeps every element in its warp, with
+  // at most `max_shuffles_per_reg` registers of `in` read, across lanes, by each
+  // register of `out`. If so, `in_regs` holds these registers for each register
+  // of `out`, and `same_lane` whether its elements are already in their lane.
+  // Registers are numbered with the first axis fastest
+  static const int max_shuffles_per_reg = 4;
+  bool shuffle_within_warps(scanline_layout* in, scanline_layout* out,
+                            std::vector<std::vector<int>>& in_regs, std::vector<bool>& same_lane);
+  // Padding of the leading dimension of the shared buffer through which `in` is
+  // converted to `out`, of elements of type `ty` (none for modules compiled without
+  // shared padding)
+  int convert_pad(distributed_layout* in, distributed_layout* out, ir::type* ty);
+  // Whether `in` is written to that buffer by stmatrix: 16-bit accumulators of tensor
+  // cores on sm_90, transposed when `out` is column-major
+  bool stmatrix_convert(distributed_layout* in, distributed_layout* out, ir::type* ty);
+  // Buffers written by copies of the Tensor Memory Accelerator (see is_tma_buffer in
+  // layout.cc) -> the buffers of the mbarriers that track these copies, one per stage
+  const std::map<shared_layout*, shared_layout*>& get_tma() const { return tma_; }
   // execution
   void run(ir::module &mod);
 
@@ -331,11 +364,14 @@ private:
   analysis::align* align_;
   size_t num_warps_;
   target* tgt_;
-  tools::graph<ir::value*> graph_;
-  std::map<ir::value*, size_t> groups_;
-  std::map<size_t, std::vector<ir::value*>> values_;
+  bool shared_padding_ = true;
+  tools::union_find<ir::value*> graph_;
+  tools::union_find<ir::value*>::nmap_t groups_;
+  tools::union_find<ir::value*>::cmap_t values_;
   std::map<size_t, data_layout*> layouts_;
   std::map<ir::value*, size_t> tmp_;
+  bool use_tma_;
+  std::map<shared_layout*, shared_layout*> tma_;
 };
 
 }
@@ -5,7 +5,6 @@
 #include <set>
 #include <vector>
 #include "triton/codegen/analysis/layout.h"
-#include "triton/tools/graph.h"
 
 namespace triton{
 
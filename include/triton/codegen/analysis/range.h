@@ -0,0 +1,49 @@
+#ifndef TDL_INCLUDE_CODEGEN_RANGE_INFO_PASS_H
+#define TDL_INCLUDE_CODEGEN_RANGE_INFO_PASS_H
+
+#include <cstdint>
+#include <map>
+
+namespace triton {
+
+namespace ir {
+  class value;
+  class module;
+  class instruction;
+}
+
+namespace codegen{
+namespace analysis{
+
+/**
+ * Signed interval [lo, hi] that holds every element of each integer value.
+ * Sources are constants, `make_range`, `get_program_id` and `get_num_programs`;
+ * intervals flow through shape operations, integer arithmetic, casts and
+ * selects, and values whose interval could overflow their type are unknown.
+ * Loop-carried values are unknown too.
+ */
+class range {
+public:
+  struct interval {
+    int64_t lo;
+    int64_t hi;
+  };
+
+private:
+  bool compute(ir::instruction* i, interval& ret);
+  void populate(ir::value* v);
+
+public:
+  void run(ir::module &mod);
+  bool has(ir::value* v) const { return ranges_.find(v) != ranges_.end(); }
+  interval get(ir::value* v) const { return ranges_.at(v); }
+
+private:
+  std::map<ir::value*, interval> ranges_;
+};
+
+}
+}
+}
+
+#endif
@@ -16,6 +16,7 @@ namespace analysis{
 
 class layouts;
 class data_layout;
+class shared_layout;
 
 class swizzle {
 public:
@@ -27,6 +28,8 @@ public:
   int get_vec  (data_layout* layout)     { return vec_.at(layout); }
   // run
   void run(ir::module &mod);
+private:
+  bool get_fmadot_swizzle(shared_layout* layout, int& per_phase, int& max_phase);
 private:
   layouts* layouts_;
   target* tgt_;
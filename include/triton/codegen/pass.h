@@ -2,7 +2,10 @@
 #define _TRITON_CODEGEN_PASS_H_
 
 
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace llvm{
   class Module;
@@ -28,12 +31,74 @@ namespace driver{
 namespace triton{
 namespace codegen{
 
-// TODO:
-// There should be a proper pass manager there!
+// What a pass does to the module, which lets the pass manager skip it
+enum pass_kind_t {
+  // may modify the IR; always runs
+  TRANSFORM,
+  // leaves the IR untouched, and its results only depend on it:
+  // skipped when the IR did not change since its last run
+  ANALYSIS,
+  // transformation with nothing left to do on IR it already ran on
+  // (e.g., dce): also skipped when the IR did not change since its last run
+  CLEANUP,
+};
+
+// Statistics of one run of a pass. Instruction counts are always recorded,
+// times and memory when the pass manager collects statistics
+struct pass_stats {
+  std::string name;
+  bool skipped;
+  double time_us;
+  size_t num_insts_before;
+  size_t num_insts_after;
+  // resident set size of the process, at its peak so far
+  size_t peak_rss_kb;
+};
+
+// Runs passes over a Triton-IR module in the order they were added,
+// optionally recording per-pass statistics
+class pass_manager {
+  struct entry {
+    std::string name;
+    std::function<void(ir::module&)> run;
+    pass_kind_t kind;
+    // key identifying the pass object, shared by all of its entries
+    const void* id;
+  };
+
+public:
+  pass_manager(bool collect_stats): collect_stats_(collect_stats) {}
+  template<class Pass>
+  void add(const std::string& name, Pass& pass, pass_kind_t kind = TRANSFORM) {
+    entries_.push_back({name, [&pass](ir::module& mod) { pass.run(mod); }, kind, &pass});
+  }
+  void add(const std::string& name, std::function<void(ir::module&)> run) {
+    entries_.push_back({name, run, TRANSFORM, nullptr});
+  }
+  void run(ir::module& mod);
+  // number of passes skipped by the last `run`
+  size_t num_skipped() const { return num_skipped_; }
+  const std::vector<pass_stats>& stats() const { return stats_; }
+  // human-readable table of `stats()`, with totals per pass
+  std::string report() const;
+
+private:
+  std::vector<entry> entries_;
+  bool collect_stats_;
+  std::vector<pass_stats> stats_;
+  size_t num_skipped_ = 0;
+};
+
+// Statistics are collected when `stats` is not null, and returned as a report.
+// `codegen_stats`, if not null, receives a summary of the decisions of code generation
+// (instructions after each pass, layout conversions, barriers, shared memory buffers,
+// vector widths of global accesses and pipelining), one record per line
 std::unique_ptr<llvm::Module> add_passes_to_emit_bin(ir::module &ir, llvm::LLVMContext& ctx,
                                                      codegen::target* target,
                                                      int sm, int num_warps,
-                                                     int num_stages, int &shared_static);
+                                                     int num_stages, int &shared_static,
+                                                     std::string* stats = nullptr,
+                                                     std::string* codegen_stats = nullptr);
 
 
 }
@@ -4,8 +4,10 @@
 #define _TRITON_SELECTION_GENERATOR_H_
 
 #include "triton/ir/visitor.h"
+#include "triton/ir/instructions.h"
 #include "triton/codegen/analysis/layout.h"
 #include <functional>
+#include <tuple>
 
 // forward
 namespace llvm{
@@ -16,6 +18,7 @@ namespace llvm{
   class Attribute;
   class Instruction;
   class Constant;
+  class GlobalVariable;
   class LLVMContext;
   class Module;
   class ConstantFolder;
@@ -25,6 +28,9 @@ namespace llvm{
   class ArrayType;
   class Function;
   class StructType;
+  class DIBuilder;
+  class DIScope;
+  class DIFile;
 }
 
 namespace triton{
@@ -59,6 +65,7 @@ typedef llvm::BasicBlock BasicBlock;
 typedef llvm::Module Module;
 typedef llvm::Instruction Instruction;
 typedef llvm::Constant Constant;
+typedef llvm::GlobalVariable GlobalVariable;
 typedef llvm::ArrayType ArrayType;
 typedef llvm::Function Function;
 typedef std::vector<Value*> indices_t;
@@ -76,6 +83,16 @@ struct distributed_axis {
   Value* thread_id;
 };
 
+/// vector width chosen for a global load or store of a block
+struct io_vector {
+  bool is_store;
+  /// source line of the instruction, or 0
+  unsigned line;
+  /// elements per vector, and bits per element
+  size_t vec;
+  size_t bits;
+};
+
 class adder{
 public:
   adder(Builder** builder): builder_(builder) { }
@@ -104,9 +121,26 @@ private:
 };
 
 class generator: public ir::visitor, public analysis::layout_visitor {
+private:
+  // warps that execute an instruction in warp-specialized blocks
+  enum warp_group_t {
+    ALL_WARPS,
+    PRODUCER_WARPS,
+    CONSUMER_WARPS
+  };
+
 private:
   void init_idx(ir::value *x);
   Instruction* add_barrier();
+  Instruction* add_memfence(ir::mem_scope_t scope);
+  Value* thread_id();
+  Function* trace_fn();
+  void trace(unsigned event);
+  void set_debug_loc(ir::instruction* i);
+  llvm::DIFile* debug_file(unsigned file);
+  bool init_warp_groups(ir::function* fn);
+  warp_group_t warp_group(ir::instruction* i);
+  void visit_in_warp_group(ir::instruction* i, warp_group_t group);
   Value* shared_off(const std::vector<unsigned>& shapes, const std::vector<int>& order, indices_t idx);
   void finalize_shared_layout(analysis::shared_layout*);
   void finalize_function(ir::function*);
@@ -117,6 +151,17 @@ private:
   llvm::Attribute cvt(ir::attribute attr);
   llvm::StructType* packed_type(ir::value* i);
   void forward_declare(ir::function* fn);
+  void declare_consts(ir::module &src);
+  std::vector<size_t> count_thread_values(ir::function* fn, size_t& n_ret);
+  bool in_function(analysis::data_layout* layout, ir::function* fn);
+  bool uses_shared_memory(ir::function* fn);
+  bool calls_grid_sync(ir::function* fn);
+  void init_read_only_args(ir::function* fn);
+  bool is_read_only(ir::value* ptr);
+  std::vector<analysis::shared_layout*> tma_buffers(ir::function* fn);
+  void init_tma(ir::function* fn);
+  void wait_tma(analysis::shared_layout* layout, Value* count);
+  void visit_tma_load(ir::masked_load_async_inst* x);
 
 public:
   generator(analysis::axes *a_axes,
@@ -125,12 +170,18 @@ public:
             analysis::allocation *alloc,
             analysis::swizzle *swizzle,
             target *tgt,
-            unsigned num_warps);
+            unsigned num_warps,
+            bool warp_specialize = false,
+            unsigned l2_prefetch = 0,
+            unsigned trace_level = 0,
+            bool line_info = false);
 
   void visit_value(ir::value* v);
   void visit_call_inst(ir::call_inst*);
   void visit_launch_inst(ir::launch_inst *);
   void visit_phi_node(ir::phi_node*);
+  bool is_f16x2(ir::value* v);
+  Value* f16x2(ir::value* v, const indices_t& lo, const indices_t& hi);
   void visit_binary_operator(ir::binary_operator*);
   void visit_getelementptr_inst(ir::getelementptr_inst*);
   void visit_icmp_inst(ir::icmp_inst*);
@@ -141,15 +192,20 @@ public:
   std::tuple<Value*, Value*, Value*, Value*> fp16x4_to_fp8x4(Value *in0, Value *in1, Value *in2, Value *in3);
   Value* bf16_to_fp32(Value *in0);
   Value* fp32_to_bf16(Value *in0);
+  std::tuple<Value*, Value*> fp32x2_to_half2(Value *in0, Value *in1, Type *half_ty);
+  bool has_packed_cvt();
 
   void visit_cast_inst(ir::cast_inst*);
   void visit_return_inst(ir::return_inst*);
   void visit_cond_branch_inst(ir::cond_branch_inst*);
   void visit_uncond_branch_inst(ir::uncond_branch_inst*);
   void visit_load_inst(ir::load_inst*);
+  void visit_host_load_inst(ir::load_inst*, Type* ty, size_t vec);
+  Value* host_if(Value* pred, std::function<Value*()> then, Value* otherwise);
   void visit_unmasked_load_inst(ir::unmasked_load_inst*);
   void visit_masked_load_inst(ir::masked_load_inst*);
   void visit_store_inst(ir::store_inst*);
+  void visit_staged_store_inst(ir::store_inst*);
   void visit_unmasked_store_inst(ir::unmasked_store_inst*);
   void visit_masked_store_inst(ir::masked_store_inst*);
   void visit_cat_inst(ir::cat_inst*);
@@ -162,24 +218,41 @@ public:
   void visit_exp_inst(ir::exp_inst*);
   void visit_cos_inst(ir::cos_inst*);
   void visit_umulhi_inst(ir::umulhi_inst* x);
+  void visit_philox_inst(ir::philox_inst* x);
+  void visit_math_inst(ir::math_inst* x);
+  void visit_approx_inst(ir::instruction* x, const std::string& f32_op, const std::string& f16x2_op, float scale);
   void visit_sin_inst(ir::sin_inst*);
   void visit_log_inst(ir::log_inst*);
+  void visit_host_math_inst(ir::instruction*, unsigned id);
   void visit_get_program_id_inst(ir::get_program_id_inst*);
   void visit_get_num_programs_inst(ir::get_num_programs_inst*);
   void visit_atomic_cas_inst(ir::atomic_cas_inst*);
   void visit_atomic_rmw_inst(ir::atomic_rmw_inst*);
+  void visit_host_atomic_rmw_inst(ir::atomic_rmw_inst*);
   void visit_mma884(ir::dot_inst*, ir::value *A, ir::value *B, ir::value *D, unsigned NK);
   void visit_mma16816(ir::dot_inst*, ir::value *A, ir::value *B, ir::value *D, unsigned NK);
+  void visit_mma16816_sp(ir::dot_inst*, ir::value *A, ir::value *B, ir::value *D, ir::value *E);
+  void visit_mfma(ir::dot_inst*, ir::value *A, ir::value *B, ir::value *D, unsigned NK);
   void visit_fmadot(ir::dot_inst*, ir::value *A, ir::value *B, ir::value *D, unsigned NK, Type *c_ty, Function *f_mul_add);
+  void visit_host_dot(ir::dot_inst*, ir::value *A, ir::value *B, ir::value *D, Type *c_ty, Function *f_mul_add);
   void visit_dot_inst(ir::dot_inst*);
   void visit_trans_inst(ir::trans_inst*);
   void visit_sqrt_inst(ir::sqrt_inst*);
   Value* shfl_sync(Value* acc, int32_t i);
+  Value* shfl_idx_sync(Value* acc, Value* lane);
+  Value* shfl_sync(Value* acc, Value* i, const std::string& mode);
+  Value* shfl_amd(Value* acc, Value* i, const std::string& mode);
   void visit_reduce1d_inst(ir::reduce_inst*, std::function<Value*(Value*,Value*)>, Value*);
   void visit_reducend_inst(ir::reduce_inst*, std::function<Value*(Value*,Value*)>, Value*);
   void visit_reduce_inst(ir::reduce_inst*);
+  Value* reduce_op(ir::reduce_inst::op_t op, Value *x, Value *y);
+  void reduce_arg_op(ir::reduce_inst::op_t op, Value *&x, Value *&x_idx, Value *y, Value *y_idx);
+  Value* reduce_neutral(ir::reduce_inst::op_t op, Type *ty);
+  void visit_scan_inst(ir::scan_inst*);
   void visit_select_inst(ir::select_inst*);
   void visit_layout_convert(ir::value *out, ir::value *in);
+  void visit_layout_convert_shfl(ir::value *out, ir::value *in, const std::vector<std::vector<int>>& in_regs,
+                                 const std::vector<bool>& same_lane);
   void visit_cvt_layout_inst(ir::cvt_layout_inst*);
   void visit_masked_load_async_inst(ir::masked_load_async_inst*);
   void visit_copy_to_shared_inst(ir::copy_to_shared_inst*);
@@ -191,6 +264,8 @@ public:
   void visit_make_range(ir::make_range*);
   void visit_clock_inst(ir::clock_inst*);
   void visit_globaltimer_inst(ir::globaltimer_inst*);
+  void visit_grid_sync_inst(ir::grid_sync_inst*);
+  void visit_fence_inst(ir::fence_inst*);
 //  void visit_make_range_sta(ir::make_range_sta*);
   void visit_undef_value(ir::undef_value*);
   void visit_constant_int(ir::constant_int*);
@@ -200,6 +275,8 @@ public:
   void visit_basic_block(ir::basic_block*);
   void visit_argument(ir::argument*);
   void visit(ir::module &, llvm::Module &);
+  /// vector widths of the global loads and stores of blocks, in the order they were lowered
+  const std::vector<io_vector>& io_vectors() const { return io_vectors_; }
 
 
   // layouts
@@ -224,6 +301,63 @@ private:
   std::set<ir::value*> seen_;
 
   unsigned num_warps_;
+  /// threads of a warp (wavefront on AMD GPUs) that take part in shuffles
+  unsigned warp_size_;
+
+  /// warp specialization: `num_warps_` consumer warps run the program, and as many
+  /// producer warps mirror them to issue its asynchronous copies to shared memory
+  bool warp_specialize_;
+  Value *is_consumer_;
+  std::set<ir::value*> producer_values_;
+  warp_group_t current_group_;
+
+  /// noalias pointer arguments that the kernel never writes through,
+  /// loaded through the non-coherent cache
+  std::set<ir::value*> read_only_args_;
+  /// size (in bytes) of the L2 prefetch hinted on global loads, or 0
+  unsigned l2_prefetch_;
+
+  /// in-kernel tracing: 0 disables it, 1 records function entries and exits and
+  /// loop headers, 2 also records barriers, and 3 only function entries and exits
+  unsigned trace_level_;
+  std::map<ir::basic_block*, unsigned> trace_loops_;
+  unsigned trace_barriers_;
+
+  /// fast math (see ir::module::set_fast_math): math functions use the approximate,
+  /// flush-to-zero forms of the target, packed in pairs for fp16 where they exist
+  bool fast_math_ = false;
+
+  /// programs per wave of the grouped order of program ids (see ir::module::set_raster),
+  /// or 0 if programs ids are those of the launch
+  unsigned raster_ = 0;
+
+  /// whether the current function has stores staged in shared memory, whose
+  /// bulk copies must have read their buffer before it returns
+  bool staged_stores_ = false;
+
+  /// TMA copies (see analysis::layouts::get_tma): the buffers they write in each kernel, in
+  /// the order of the tensor maps appended to its parameters, and the swizzling of each
+  std::map<ir::function*, std::vector<analysis::shared_layout*>> tma_buffers_;
+  std::map<analysis::shared_layout*, unsigned> tma_swizzle_;
+  /// tensor maps of the buffers of the current kernel, and, in allocas, how many copies to
+  /// each were issued and waited for, and which of the last 64 commit groups hold one of
+  /// them (least significant bit for the newest)
+  std::map<analysis::shared_layout*, Value*> tma_descs_;
+  std::map<analysis::shared_layout*, Value*> tma_issued_;
+  std::map<analysis::shared_layout*, Value*> tma_waited_;
+  std::map<analysis::shared_layout*, Value*> tma_groups_;
+  /// counter of the `grid_sync` barriers of the current kernel, its last parameter
+  /// (nullptr if it calls none)
+  Value *grid_barrier_ = nullptr;
+
+  std::vector<io_vector> io_vectors_;
+
+  /// line information: the source location of each instruction is attached to
+  /// what it lowers to, in the scope of its function and file
+  bool line_info_;
+  llvm::DIBuilder* di_;
+  std::map<unsigned, llvm::DIScope*> di_scopes_;
+  std::vector<std::string> source_files_;
 
   std::map<analysis::data_layout*, Value*> offset_a_m_;
   std::map<analysis::data_layout*, Value*> offset_a_k_;
@@ -242,6 +376,9 @@ private:
   std::map<ir::value*, Value*> shoffs_;
   std::map<ir::value*, std::vector<indices_t>> idxs_;
   std::map<ir::value*, std::map<indices_t, Value*>> vals_;
+  /// words of the Philox counters of a block, by offset, keys and number of rounds
+  std::map<std::tuple<ir::basic_block*, ir::value*, ir::value*, ir::value*, unsigned>,
+           std::map<indices_t, std::vector<Value*>>> philox_words_;
   /// idx for multi-stage pipeline
   std::map<analysis::data_layout*, Value*> read_smem_idx_;
   std::map<analysis::data_layout*, Value*> write_smem_idx_;
@@ -250,6 +387,8 @@ private:
   std::map<ir::value*, BasicBlock *> bbs_;
   std::map<ir::value*, std::vector<int>> ords_;
   std::map<ir::value*, Function*> fns_;
+  /// constant allocations of the module -> their global variables
+  std::map<ir::alloc_const*, GlobalVariable*> consts_;
 
   // helper for creating llvm values
   adder add;
@@ -1,6 +1,8 @@
 #ifndef TDL_INCLUDE_IR_CODEGEN_TARGET_H
 #define TDL_INCLUDE_IR_CODEGEN_TARGET_H
 
+#include <string>
+
 namespace llvm{
   class Type;
   class Value;
@@ -36,37 +38,59 @@ namespace triton{
 namespace codegen{
 
 class nvidia_cu_target;
+class amd_cl_target;
 
 class target {
 public:
-  target(bool is_gpu): is_gpu_(is_gpu){}
+  target(bool is_gpu, unsigned max_shared_memory = 0): is_gpu_(is_gpu), max_shared_memory_(max_shared_memory){}
   virtual ~target() {}
   virtual void set_kernel(Builder& builder, LLVMContext &ctx, Module *module, Function* fn) = 0;
   virtual Instruction* add_barrier(Module *module, Builder& builder) = 0;
+  // targets without named barriers synchronize all threads
+  virtual Instruction* add_named_barrier(Module *module, Builder& builder, int id, int num_threads) {
+    return add_barrier(module, builder);
+  }
   virtual Instruction* add_memfence(Module *module, Builder& builder) = 0;
+  // fence that also orders accesses as seen by the host and by peer devices
+  virtual Instruction* add_sys_memfence(Module *module, Builder& builder) = 0;
   virtual Value* get_global_offset(Module *module, Builder& builder, unsigned stride, unsigned ax) = 0;
   virtual Value* get_local_id(Module *module, Builder& builder, unsigned ax) = 0;
   virtual Value* get_block_id(Module *module, Builder& builder, unsigned ax) = 0;
   virtual Value* get_num_blocks(Module *module, Builder& builder, unsigned ax) = 0;
   virtual unsigned guaranteed_alignment() = 0;
+  // number of threads that run in lockstep and exchange registers with shuffles
+  virtual unsigned warp_size() { return 32; }
+  // bytes of shared memory available to a block, or 0 if unknown
+  unsigned max_shared_memory() const { return max_shared_memory_; }
   nvidia_cu_target* as_nvidia();
+  amd_cl_target* as_amd();
   bool is_gpu() const;
 
 private:
   bool is_gpu_;
+  unsigned max_shared_memory_;
 };
 
 class amd_cl_target: public target {
 public:
-  amd_cl_target(): target(true){}
+  amd_cl_target(const std::string& arch = "gfx908", unsigned max_shared_memory = 0)
+    : target(true, max_shared_memory), arch_(arch){}
   void set_kernel(Builder& builder, LLVMContext &ctx, Module *module, Function* fn);
   Instruction* add_barrier(Module *module, Builder& builder);
   Instruction* add_memfence(Module *module, Builder& builder);
+  Instruction* add_sys_memfence(Module *module, Builder& builder);
   Value* get_global_offset(Module *module, Builder& builder, unsigned stride, unsigned ax);
   Value* get_local_id(Module *module, Builder& builder, unsigned ax);
   Value* get_block_id(Module *module, Builder& builder, unsigned ax);
   Value* get_num_blocks(Module *module, Builder& builder, unsigned ax);
   unsigned guaranteed_alignment() { return 16; }
+  unsigned warp_size() { return 64; }
+  const std::string& arch() { return arch_; }
+  // CDNA GPUs (MI100, MI200) have matrix cores, used through MFMA instructions
+  bool has_mfma() { return arch_ == "gfx908" || arch_ == "gfx90a"; }
+
+private:
+  std::string arch_;
 };
 
 class nvidia_cu_target: public target {
@@ -74,7 +98,9 @@ public:
   nvidia_cu_target(int sm): target(true), sm_(sm){}
   void set_kernel(Builder& builder, LLVMContext &ctx, Module *module, Function* fn);
   Instruction* add_barrier(Module *module, Builder& builder);
+  Instruction* add_named_barrier(Module *module, Builder& builder, int id, int num_threads);
   Instruction* add_memfence(Module *module, Builder& builder);
+  Instruction* add_sys_memfence(Module *module, Builder& builder);
   Value* get_global_offset(Module *module, Builder& builder, unsigned stride, unsigned ax);
   Value* get_local_id(Module *module, Builder& builder, unsigned ax);
   Value* get_block_id(Module *module, Builder& builder, unsigned ax);
@@ -92,11 +118,13 @@ public:
   void set_kernel(Builder& builder, LLVMContext &ctx, Module *module, Function* fn);
   Instruction* add_barrier(Module *module, Builder& builder);
   Instruction* add_memfence(Module *module, Builder& builder);
+  Instruction* add_sys_memfence(Module *module, Builder& builder);
   Value* get_global_offset(Module *module, Builder& builder, unsigned stride, unsigned ax);
   Value* get_local_id(Module *module, Builder& builder, unsigned ax);
   Value* get_block_id(Module *module, Builder& builder, unsigned ax);
   Value* get_num_blocks(Module *module, Builder& builder, unsigned ax);
   unsigned guaranteed_alignment() { return 1; }
+  unsigned warp_size() { return 1; }
 };
 
 }
@@ -0,0 +1,48 @@
+#ifndef TRITON_INCLUDE_IR_CODEGEN_BOUNDS_H
+#define TRITON_INCLUDE_IR_CODEGEN_BOUNDS_H
+
+namespace triton {
+
+// forward declaration
+namespace ir {
+class module;
+class instruction;
+class builder;
+}
+
+namespace codegen{
+
+namespace analysis{
+class range;
+}
+
+namespace transform{
+
+/**
+ * Bounds-check elimination.
+ * Integer comparisons that the intervals of `analysis::range` decide are
+ * folded to constants, boolean and/or with a decided operand are simplified,
+ * and loads and stores whose mask is provably true everywhere lose it.
+ */
+class bounds {
+private:
+  int decide(ir::instruction* cmp);
+  bool rewrite_cmp(ir::instruction* i, ir::builder& builder);
+  bool rewrite_logical(ir::instruction* i);
+  bool rewrite_masked_load(ir::instruction* i, ir::builder& builder);
+  bool rewrite_masked_store(ir::instruction* i, ir::builder& builder);
+  bool is_true(ir::value* v);
+
+public:
+  bounds(analysis::range* range): range_(range) {}
+  void run(ir::module& module);
+
+private:
+  analysis::range* range_;
+};
+
+}
+}
+}
+
+#endif
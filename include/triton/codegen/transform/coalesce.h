@@ -25,6 +25,12 @@ namespace analysis{
 
 namespace transform{
 
+/**
+ * Inserts layout conversions around loads and stores of MMA and poorly
+ * coalesced tiles, then simplifies them: chains of conversions are merged, and
+ * expressions of ranges, splats and scalars that are cheaper to recompute than
+ * to move through shared memory are copied in the layout of their consumers.
+ */
 class coalesce {
 private:
   void extract_io_use(ir::value *v, std::set<ir::io_inst*>& result);
@@ -0,0 +1,41 @@
+#ifndef TRITON_INCLUDE_IR_CODEGEN_CSE_H
+#define TRITON_INCLUDE_IR_CODEGEN_CSE_H
+
+#include <cstdint>
+#include <vector>
+
+namespace triton {
+
+// forward declaration
+namespace ir {
+class module;
+class function;
+class instruction;
+}
+
+namespace codegen{
+namespace transform{
+
+/**
+ * Common subexpression elimination.
+ * Pure instructions are numbered by a structural hash of their kind,
+ * attributes, type, operands and metadata, and each instruction equal to
+ * one that dominates it is replaced by the latter. Blocks are visited in
+ * reverse post-order, so that the operands of an instruction are numbered
+ * before it.
+ */
+class cse {
+private:
+  static bool get_key(ir::instruction* i, std::vector<uint64_t>& key);
+  void run(ir::function* fn);
+
+public:
+  cse() {}
+  void run(ir::module& module);
+};
+
+}
+}
+}
+
+#endif
@@ -1,17 +1,26 @@
 #ifndef TDL_INCLUDE_CODEGEN_OPTIMIZE_CSE_H
 #define TDL_INCLUDE_CODEGEN_OPTIMIZE_CSE_H
 
+#include <vector>
 
 namespace triton {
 
 namespace ir {
   class module;
+  class instruction;
 }
 
 namespace codegen{
 namespace transform{
 
 class dce {
+public:
+  // instructions that must be kept even when their result is unused
+  static bool is_root(ir::instruction *i);
+  // erases `seeds` if they are unused, and then the operands they kept alive;
+  // returns the erased instructions
+  static std::vector<ir::instruction*> erase_unused(std::vector<ir::instruction*> seeds);
+
 public:
   dce() {}
   void run(ir::module &mod);
@@ -0,0 +1,41 @@
+#ifndef TRITON_INCLUDE_IR_CODEGEN_HORIZONTAL_H
+#define TRITON_INCLUDE_IR_CODEGEN_HORIZONTAL_H
+
+namespace triton {
+
+// forward declaration
+namespace ir {
+class module;
+class function;
+class builder;
+}
+
+namespace codegen{
+namespace transform{
+
+/**
+ * Horizontally fused kernels.
+ * The kernels of a horizontal module (see ir::module::set_horizontal) run the programs of
+ * many launches of themselves in one launch, whose 1D grid is the concatenation of their
+ * grids. Kernels take a table in global memory as their last argument, and read the values
+ * of their other arguments from it. The table starts with three int32: the number n of
+ * launches, the size in bytes of the parameters of a launch, and the offset of the
+ * parameters of the first launch. Then follow, from byte 16, n rows of four int32: the first
+ * program of the launch in the fused grid, in increasing order, and the three sizes of its
+ * grid. The parameters of launch i are packed at byte offset + i * size as for a launch of
+ * the kernel, each aligned to its size. Programs find their launch by a binary search of the
+ * rows, and program ids and numbers of programs are those of this launch.
+ */
+class horizontal {
+private:
+  void run(ir::builder& builder, ir::function* fn);
+
+public:
+  void run(ir::module& mod);
+};
+
+}
+}
+}
+
+#endif
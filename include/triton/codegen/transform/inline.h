@@ -1,6 +1,8 @@
 #pragma once
 
 #include <list>
+#include <map>
+#include <set>
 
 namespace triton {
 
@@ -18,11 +20,28 @@ struct fncmp {
   bool operator()(ir::function* x, ir::function* y) const;
 };
 
+// Inlines calls to device functions. When `outline` is set, the calls to a callee whose
+// inlined copies would add more than `threshold` instructions to the module are kept,
+// and lowered to calls that pass the values of tensors held by each thread. Calls that
+// reach a `grid_sync` are always inlined, as its counter is a parameter of the kernel
 class inliner {
 public:
-  inliner() {}
+  // how a call site is handled, from its `inline_hint` metadata
+  enum hint_t {
+    DEFAULT = 0,   // by the cost of the callee
+    ALWAYS = 1,
+    NEVER = 2      // kept as a call if outlining is enabled
+  };
+
+  inliner(bool outline = false, unsigned threshold = 1024): outline_(outline), threshold_(threshold) {}
   void do_inline(ir::function* fn, ir::call_inst* callsite, ir::builder& builder, std::list<ir::call_inst*>& callsites);
+  bool should_inline(ir::call_inst* callsite, const std::map<ir::function*, size_t>& counts);
   void run(ir::module &mod);
+
+private:
+  bool calls_grid_sync(ir::function* fn, std::set<ir::function*>& seen);
+  bool outline_;
+  unsigned threshold_;
 };
 
 
@@ -0,0 +1,58 @@
+#ifndef TRITON_INCLUDE_IR_CODEGEN_LICM_H
+#define TRITON_INCLUDE_IR_CODEGEN_LICM_H
+
+#include <set>
+#include <vector>
+
+namespace triton {
+
+// forward declaration
+namespace ir {
+class module;
+class function;
+class basic_block;
+class instruction;
+class builder;
+class value;
+}
+
+namespace codegen{
+namespace transform{
+
+/**
+ * Loop-invariant code motion.
+ * Pure instructions whose operands are all defined outside of a loop are moved
+ * to the end of its preheader, so that e.g. the increments of loop-carried
+ * pointers are computed once and each iteration is left with a single add.
+ * Only instructions that cannot fault are speculated, and hoisted tiles extend
+ * the live range of their registers over the whole loop, so their footprint is
+ * bounded by a per-loop budget; scalars and broadcasts are always hoisted.
+ * The pass runs again after coalescing, to hoist the layout conversions of
+ * invariant values and the expressions rematerialized in their place.
+ */
+class licm {
+private:
+  struct loop {
+    ir::basic_block* header;
+    ir::basic_block* preheader;
+    std::set<ir::basic_block*> blocks;
+  };
+
+  std::vector<loop> get_loops(ir::function* fn);
+  bool is_hoistable(ir::instruction* i);
+  unsigned footprint(ir::instruction* i);
+  void hoist(ir::builder& builder, loop& l);
+
+public:
+  licm(int num_warps): num_warps_(num_warps) {}
+  void run(ir::module& module);
+
+private:
+  int num_warps_;
+};
+
+}
+}
+}
+
+#endif
@@ -54,6 +54,8 @@ public:
          transform::prefetch *prefetch, target* tgt):
     liveness_(liveness), layouts_(layouts), alloc_(alloc), prefetch_(prefetch), tgt_(tgt) {}
   void run(ir::module &mod);
+  // barriers the last run added to the module
+  size_t num_inserted() const { return num_inserted_; }
 
 private:
   analysis::liveness *liveness_;
@@ -62,6 +64,7 @@ private:
   transform::prefetch *prefetch_;
 
   target* tgt_;
+  size_t num_inserted_ = 0;
 };
 
 
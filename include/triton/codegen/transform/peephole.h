@@ -1,6 +1,7 @@
 #ifndef TDL_INCLUDE_CODEGEN_OPTIMIZE_TRANS_H
 #define TDL_INCLUDE_CODEGEN_OPTIMIZE_TRANS_H
 
+#include <functional>
 #include "triton/codegen/target.h"
 
 namespace triton {
@@ -38,7 +39,10 @@ private:
   bool rewrite_select_masked_load(ir::instruction *value, ir::builder& builder);
   bool rewrite_load_to_shared(ir::instruction *value, ir::builder& builder);
   bool rewrite_cvt_layout(ir::instruction *value, ir::builder& builder);
- 
+  // applies `rewrite` until no instruction changes, revisiting only the
+  // neighbourhood of each rewrite and erasing what it left dead
+  void run_to_fixpoint(ir::module &mod, const std::function<bool(ir::instruction*)> &rewrite);
+
 public:
   peephole(target* tgt, analysis::layouts* layouts): tgt_(tgt), layouts_(layouts) {}
   void run(ir::module &mod);
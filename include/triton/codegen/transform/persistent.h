@@ -0,0 +1,40 @@
+#ifndef TRITON_INCLUDE_IR_CODEGEN_PERSISTENT_H
+#define TRITON_INCLUDE_IR_CODEGEN_PERSISTENT_H
+
+namespace triton {
+
+// forward declaration
+namespace ir {
+class module;
+class function;
+class builder;
+class value;
+}
+
+namespace codegen{
+namespace transform{
+
+/**
+ * Persistent kernels.
+ * The body of the kernels of a persistent module (see ir::module::set_persistent)
+ * becomes a loop over the tiles of their logical grid, which programs claim from a
+ * counter in global memory until none is left. Kernels take the counter and the
+ * three sizes of the logical grid as their last four arguments; program ids and
+ * numbers of programs are those of the claimed tile in this grid, in the grouped
+ * order of ir::module::set_raster if any. The next tile is claimed as soon as the
+ * current one starts, so that the latency of the atomic is hidden by its work, and
+ * the program that makes the last claim of a launch resets the counter.
+ */
+class persistent {
+private:
+  void run(ir::builder& builder, ir::function* fn, unsigned raster);
+
+public:
+  void run(ir::module& mod);
+};
+
+}
+}
+}
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef TRITON_INCLUDE_IR_CODEGEN_PIPELINE_H
 #define TRITON_INCLUDE_IR_CODEGEN_PIPELINE_H
 
+#include <cstddef>
+
 // forward declaration
 namespace triton {
 namespace ir {
@@ -14,13 +16,23 @@ namespace transform {
 
 class pipeline {
 public:
-  pipeline(bool has_copy_async, int num_stages)
-      : has_copy_async_(has_copy_async), num_stages_(num_stages) {}
+  // `max_shared_memory` bounds the buffers of loads pipelined in shared memory (0: unbounded)
+  pipeline(bool has_copy_async, int num_stages, unsigned max_shared_memory = 0)
+      : has_copy_async_(has_copy_async), num_stages_(num_stages), max_shared_memory_(max_shared_memory) {}
   void run(ir::module &module);
+  // loads of the last run whose pointer is an induction variable of their loop,
+  // those of them that were pipelined, and the stages of the ones that feed dots
+  size_t num_candidates() const { return num_candidates_; }
+  size_t num_pipelined() const { return num_pipelined_; }
+  int num_dot_stages() const { return num_dot_stages_; }
 
 private:
   bool has_copy_async_;
   int num_stages_;
+  unsigned max_shared_memory_;
+  size_t num_candidates_ = 0;
+  size_t num_pipelined_ = 0;
+  int num_dot_stages_ = 0;
 };
 
 } // namespace transform
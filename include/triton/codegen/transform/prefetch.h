@@ -2,23 +2,32 @@
 #define TRITON_INCLUDE_TRITON_CODEGEN_TRANSFORM_PREFETCH_H
 
 #include <set>
+#include <cstddef>
 
 // forward dclaration
 namespace triton::ir{
 class module;
 class value;
+class dot_inst;
 }
 
 namespace triton::codegen {
 class target;
+namespace analysis {
+class layouts;
+}
 }
 
 namespace triton::codegen::transform {
 class prefetch {
   target* tgt_;
+  analysis::layouts* layouts_;
+  size_t num_warps_;
   std::set<ir::value*> prefetched_vals_;
+  bool can_prefetch(ir::dot_inst* dot);
 public:
-  prefetch(target *tgt) : tgt_(tgt) {}
+  prefetch(target *tgt, analysis::layouts* layouts, size_t num_warps)
+    : tgt_(tgt), layouts_(layouts), num_warps_(num_warps) {}
   void run(ir::module &module);
   bool is_prefetched(ir::value* v) { return prefetched_vals_.find(v) != prefetched_vals_.end(); }
 };
@@ -6,15 +6,38 @@ namespace triton {
 // forward declaration
 namespace ir {
 class module;
+class basic_block;
+class value;
 }
 
 namespace codegen{
 
+namespace analysis{
+class layouts;
+}
+
 namespace transform{
 
+/**
+ * List scheduler over the instructions of each basic block.
+ * Global loads are issued as early as their operands allow, and other
+ * instructions are kept in order, away from the loads they consume, as long as
+ * the estimated register footprint of live tiles fits the budget of a thread.
+ * Beyond it, instructions that free the most registers go first.
+ * Memory operations keep their relative order.
+ */
 class reorder {
+private:
+  unsigned footprint(ir::value* v);
+  void schedule(ir::basic_block* block);
+
 public:
+  reorder(analysis::layouts* layouts, int num_warps): layouts_(layouts), num_warps_(num_warps) {}
   void run(ir::module& module);
+
+private:
+  analysis::layouts* layouts_;
+  int num_warps_;
 };
 
 }
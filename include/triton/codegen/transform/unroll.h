@@ -0,0 +1,53 @@
+#ifndef TRITON_INCLUDE_IR_CODEGEN_UNROLL_H
+#define TRITON_INCLUDE_IR_CODEGEN_UNROLL_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace triton {
+
+// forward declaration
+namespace ir {
+class module;
+class basic_block;
+class instruction;
+class builder;
+class value;
+}
+
+namespace codegen{
+namespace transform{
+
+/**
+ * Loop unrolling.
+ * Single-block loops whose trip count folds to a constant, e.g.
+ * `for i in range(CONST)` beyond what the front-end unrolls, are unrolled
+ * fully when the unrolled body stays below `max_insts` instructions, so that
+ * their values no longer sit behind phis. Other loops are unrolled by the
+ * largest factor up to `max_factor` that divides their trip count and keeps
+ * the body within budget, except loops with dots, which `pipeline` and
+ * `prefetch` handle.
+ */
+class unroll {
+private:
+  typedef std::map<ir::value*, ir::value*> value_map_t;
+  bool eval(ir::value* v, std::map<ir::value*, int64_t>& env, int64_t& ret);
+  int64_t get_trip_count(ir::basic_block* loop, ir::basic_block* preheader);
+  void clone_body(ir::builder& builder, const std::vector<ir::instruction*>& body, value_map_t& vmap);
+  bool run(ir::builder& builder, ir::basic_block* loop);
+
+public:
+  unroll(unsigned max_insts = 256, unsigned max_factor = 4): max_insts_(max_insts), max_factor_(max_factor) {}
+  void run(ir::module& module);
+
+private:
+  unsigned max_insts_;
+  unsigned max_factor_;
+};
+
+}
+}
+}
+
+#endif
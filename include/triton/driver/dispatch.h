@@ -10,6 +10,37 @@
 #include "triton/external/CUDA/cuda.h"
 #include "triton/external/CUDA/nvml.h"
 
+// tensor maps of the Tensor Memory Accelerator (CUDA 12), which the
+// driver encodes for sm_90 kernels
+#if CUDA_VERSION < 12000
+typedef struct CUtensorMap_st { alignas(64) cuuint64_t opaque[16]; } CUtensorMap;
+typedef enum CUtensorMapDataType_enum {
+  CU_TENSOR_MAP_DATA_TYPE_UINT8 = 0,
+  CU_TENSOR_MAP_DATA_TYPE_UINT16,
+  CU_TENSOR_MAP_DATA_TYPE_UINT32,
+  CU_TENSOR_MAP_DATA_TYPE_INT32,
+  CU_TENSOR_MAP_DATA_TYPE_UINT64
+} CUtensorMapDataType;
+typedef enum CUtensorMapInterleave_enum {
+  CU_TENSOR_MAP_INTERLEAVE_NONE = 0
+} CUtensorMapInterleave;
+typedef enum CUtensorMapSwizzle_enum {
+  CU_TENSOR_MAP_SWIZZLE_NONE = 0,
+  CU_TENSOR_MAP_SWIZZLE_32B,
+  CU_TENSOR_MAP_SWIZZLE_64B,
+  CU_TENSOR_MAP_SWIZZLE_128B
+} CUtensorMapSwizzle;
+typedef enum CUtensorMapL2promotion_enum {
+  CU_TENSOR_MAP_L2_PROMOTION_NONE = 0,
+  CU_TENSOR_MAP_L2_PROMOTION_L2_64B,
+  CU_TENSOR_MAP_L2_PROMOTION_L2_128B,
+  CU_TENSOR_MAP_L2_PROMOTION_L2_256B
+} CUtensorMapL2promotion;
+typedef enum CUtensorMapFloatOOBfill_enum {
+  CU_TENSOR_MAP_FLOAT_OOB_FILL_NONE = 0
+} CUtensorMapFloatOOBfill;
+#endif
+
 //// HIP backend
 //#define __HIP_PLATFORM_AMD__
 #include "triton/external/hip.h"
@@ -80,6 +111,9 @@ public:
   static CUresult cuCtxPushCurrent_v2(CUcontext ctx);
   static CUresult cuCtxPopCurrent_v2(CUcontext *pctx);
   static CUresult cuCtxGetDevice(CUdevice* result);
+  static CUresult cuCtxGetCurrent(CUcontext *pctx);
+  static CUresult cuCtxSetCurrent(CUcontext ctx);
+  static CUresult cuDevicePrimaryCtxRetain(CUcontext *pctx, CUdevice dev);
   static CUresult cuCtxEnablePeerAccess(CUcontext peerContext, unsigned int flags);
   static CUresult cuDriverGetVersion(int *driverVersion);
   // device management
@@ -111,20 +145,32 @@ public:
   static CUresult cuFuncGetAttribute(int* pi, CUfunction_attribute attrib, CUfunction hfunc);
   static CUresult cuFuncSetAttribute(CUfunction hfunc, CUfunction_attribute attrib, int value);
   static CUresult cuFuncSetCacheConfig(CUfunction hfunc, CUfunc_cache config);
+  static CUresult cuOccupancyMaxActiveBlocksPerMultiprocessor(int* numBlocks, CUfunction func, int blockSize, size_t dynamicSMemSize);
   // memory management
   static CUresult cuMemAlloc_v2(CUdeviceptr *dptr, size_t bytesize);
   static CUresult cuPointerGetAttribute(void * data, CUpointer_attribute attribute, CUdeviceptr ptr);
+  static CUresult cuMemGetAddressRange_v2(CUdeviceptr* pbase, size_t* psize, CUdeviceptr dptr);
   static CUresult cuMemsetD8Async(CUdeviceptr dst, unsigned char x, size_t N, CUstream stream);
   static CUresult cuMemcpyDtoH_v2(void *dstHost, CUdeviceptr srcDevice, size_t ByteCount);
   static CUresult cuMemFree_v2(CUdeviceptr dptr);
   static CUresult cuMemcpyDtoHAsync_v2(void *dstHost, CUdeviceptr srcDevice, size_t ByteCount, CUstream hStream);
   static CUresult cuMemcpyHtoDAsync_v2(CUdeviceptr dstDevice, const void *srcHost, size_t ByteCount, CUstream hStream);
   static CUresult cuMemcpyHtoD_v2(CUdeviceptr dstDevice, const void *srcHost, size_t ByteCount);
+  // tensor maps
+  static CUresult cuTensorMapEncodeTiled(CUtensorMap* tensorMap, CUtensorMapDataType tensorDataType, cuuint32_t tensorRank, void* globalAddress, const cuuint64_t* globalDim, const cuuint64_t* globalStrides, const cuuint32_t* boxDim, const cuuint32_t* elementStrides, CUtensorMapInterleave interleave, CUtensorMapSwizzle swizzle, CUtensorMapL2promotion l2Promotion, CUtensorMapFloatOOBfill oobFill);
   // event management
   static CUresult cuEventCreate(CUevent *phEvent, unsigned int Flags);
   static CUresult cuEventElapsedTime(float *pMilliseconds, CUevent hStart, CUevent hEnd);
   static CUresult cuEventRecord(CUevent hEvent, CUstream hStream);
   static CUresult cuEventDestroy_v2(CUevent hEvent);
+  // graph management
+  static CUresult cuGraphCreate(CUgraph *phGraph, unsigned int flags);
+  static CUresult cuGraphAddKernelNode(CUgraphNode *phGraphNode, CUgraph hGraph, const CUgraphNode *dependencies, size_t numDependencies, const CUDA_KERNEL_NODE_PARAMS *nodeParams);
+  static CUresult cuGraphInstantiate_v2(CUgraphExec *phGraphExec, CUgraph hGraph, CUgraphNode *phErrorNode, char *logBuffer, size_t bufferSize);
+  static CUresult cuGraphExecKernelNodeSetParams(CUgraphExec hGraphExec, CUgraphNode hNode, const CUDA_KERNEL_NODE_PARAMS *nodeParams);
+  static CUresult cuGraphLaunch(CUgraphExec hGraphExec, CUstream hStream);
+  static CUresult cuGraphExecDestroy(CUgraphExec hGraphExec);
+  static CUresult cuGraphDestroy(CUgraph hGraph);
 
 
   /* ------------------- *
@@ -134,6 +180,13 @@ public:
   static nvmlReturn_t nvmlDeviceGetClockInfo(nvmlDevice_t device, nvmlClockType_t type, unsigned int *clock);
   static nvmlReturn_t nvmlDeviceGetMaxClockInfo(nvmlDevice_t device, nvmlClockType_t type, unsigned int *clock);
   static nvmlReturn_t nvmlDeviceSetApplicationsClocks(nvmlDevice_t device, unsigned int mem_clock, unsigned int sm_clock);
+  static nvmlReturn_t nvmlDeviceResetApplicationsClocks(nvmlDevice_t device);
+  static nvmlReturn_t nvmlDeviceSetGpuLockedClocks(nvmlDevice_t device, unsigned int min_clock, unsigned int max_clock);
+  static nvmlReturn_t nvmlDeviceResetGpuLockedClocks(nvmlDevice_t device);
+  static nvmlReturn_t nvmlDeviceGetTemperature(nvmlDevice_t device, nvmlTemperatureSensors_t type, unsigned int *temp);
+  static nvmlReturn_t nvmlDeviceGetPowerUsage(nvmlDevice_t device, unsigned int *power);
+  static nvmlReturn_t nvmlDeviceGetCurrentClocksThrottleReasons(nvmlDevice_t device, unsigned long long *reasons);
+  static const char* nvmlErrorString(nvmlReturn_t result);
 
   /* ------------------- *
    * HIP
@@ -153,6 +206,7 @@ public:
   static hipError_t hipDeviceGetPCIBusId(char *id, int len, hipDevice_t dev);
   static hipError_t hipDeviceGetAttribute(int *pi, hipDeviceAttribute_t attrib, hipDevice_t dev);
   static hipError_t hipGetDeviceCount(int *count);
+  static hipError_t hipGetDeviceProperties(hipDeviceProp_t *prop, int device);
   // module management
   static hipError_t hipModuleGetGlobal(hipDeviceptr_t *dptr, size_t* bytes, hipModule_t hmod, const char *name);
   static hipError_t hipModuleLoad(hipModule_t *module, const char *fname);
@@ -200,6 +254,7 @@ private:
   // context management
   static void* cuCtxGetCurrent_;
   static void* cuCtxSetCurrent_;
+  static void* cuDevicePrimaryCtxRetain_;
   static void* cuCtxDestroy_v2_;
   static void* cuCtxCreate_v2_;
   static void* cuCtxGetDevice_;
@@ -237,6 +292,7 @@ private:
   static void* cuFuncGetAttribute_;
   static void* cuFuncSetAttribute_;
   static void* cuFuncSetCacheConfig_;
+  static void* cuOccupancyMaxActiveBlocksPerMultiprocessor_;
   // memory management
   static void* cuMemcpyDtoH_v2_;
   static void* cuMemFree_v2_;
@@ -246,11 +302,22 @@ private:
   static void* cuMemAlloc_v2_;
   static void* cuMemsetD8Async_;
   static void* cuPointerGetAttribute_;
+  static void* cuMemGetAddressRange_v2_;
+  // tensor maps
+  static void* cuTensorMapEncodeTiled_;
   // event management
   static void* cuEventCreate_;
   static void* cuEventElapsedTime_;
   static void* cuEventRecord_;
   static void* cuEventDestroy_v2_;
+  // graph management
+  static void* cuGraphCreate_;
+  static void* cuGraphAddKernelNode_;
+  static void* cuGraphInstantiate_v2_;
+  static void* cuGraphExecKernelNodeSetParams_;
+  static void* cuGraphLaunch_;
+  static void* cuGraphExecDestroy_;
+  static void* cuGraphDestroy_;
 
   /* ------------------- *
    * NVML
@@ -260,6 +327,13 @@ private:
   static void* nvmlDeviceGetClockInfo_;
   static void* nvmlDeviceGetMaxClockInfo_;
   static void* nvmlDeviceSetApplicationsClocks_;
+  static void* nvmlDeviceResetApplicationsClocks_;
+  static void* nvmlDeviceSetGpuLockedClocks_;
+  static void* nvmlDeviceResetGpuLockedClocks_;
+  static void* nvmlDeviceGetTemperature_;
+  static void* nvmlDeviceGetPowerUsage_;
+  static void* nvmlDeviceGetCurrentClocksThrottleReasons_;
+  static void* nvmlErrorString_;
 
   /* ------------------- *
    * HIP
@@ -279,6 +353,7 @@ private:
   static void* hipDeviceGetPCIBusId_;
   static void* hipDeviceGetAttribute_;
   static void* hipGetDeviceCount_;
+  static void* hipGetDeviceProperties_;
   // module management
   static void* hipModuleGetGlobal_;
   static void* hipModuleLoad_;
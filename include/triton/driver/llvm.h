@@ -1,20 +1,85 @@
+#include <functional>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 #include "triton/driver/dispatch.h"
 
 namespace llvm{
 class Module;
+class LLVMContext;
+class TargetMachine;
+class TargetOptions;
 }
 
 namespace triton{
 namespace driver{
 
+// resources used by a kernel, as reported by `ptxas -v`
+struct ptxas_info {
+  int n_regs = 0;
+  int n_spill_stores = 0;
+  int n_spill_loads = 0;
+  int n_stack_frame = 0;
+  int n_shared_static = 0;
+  std::string log;
+};
+
 void init_llvm();
+// Target machines are expensive to create, and cannot be used by two threads at once:
+// each compilation takes one from a pool of those created for the same triple, processor
+// and features (with `options`, which each of them always uses), and returns it
+typedef std::unique_ptr<llvm::TargetMachine, std::function<void(llvm::TargetMachine*)>> target_machine_ptr;
+target_machine_ptr get_target_machine(const std::string& triple, const std::string& proc, const std::string& features,
+                                      const llvm::TargetOptions& options, bool pic);
+// LLVM contexts are reused across compilations, and replaced once they
+// have served a few of them so that the types and constants they intern
+// do not accumulate. Their modules must be destroyed before them
+typedef std::unique_ptr<llvm::LLVMContext, std::function<void(llvm::LLVMContext*)>> llvm_context_ptr;
+llvm_context_ptr get_llvm_context();
 std::string path_to_ptxas(int& version);
-std::string llir_to_ptx(llvm::Module* module, int cc, int version);
-std::string ptx_to_cubin(const std::string& ptx, const std::string& ptxas_path, int cc);
+// PTX is assembled in-process by the driver's JIT linker when a CUDA context
+// is current and TRITON_PTXAS_PATH is not set; returns an empty path then.
+// Otherwise, returns the path of the `ptxas` executable to use
+std::string ptx_assembler(int& version);
+void parse_ptxas_info(const std::string& log, ptxas_info& info);
+// the lines of the `ptxas -v` log of several kernels that are about `function`
+std::string ptxas_function_log(const std::string& log, const std::string& function);
+// Parses the LLVM-IR of several kernels into a single module of `ctx`, so that
+// they are lowered to PTX and assembled once. Kernels whose names are already
+// taken are renamed, and `names` holds their new names
+std::unique_ptr<llvm::Module> link_llir(const std::vector<std::string>& llirs, std::vector<std::string>& names,
+                                        llvm::LLVMContext& ctx);
+// Runs an LLVM middle-end pipeline on `module` before code generation: "fast", a short
+// pipeline for the straight-line code Triton generates, "O1" to "O3", or any pipeline in
+// the textual syntax of `opt -passes=`. Returns a summary of its effect on the instruction
+// count, or an empty string if `pipeline` is empty
+std::string optimize_llir(llvm::Module* module, llvm::TargetMachine* machine, const std::string& pipeline);
+// compute capability of an NVIDIA architecture name (e.g., 80 for "sm_80").
+// Throws std::invalid_argument if `arch` is malformed
+int nvidia_cc(const std::string& arch);
+std::string llir_to_ptx(llvm::Module* module, int cc, int version,
+                        const std::string& pipeline = "", std::string* opt_report = nullptr);
+std::string ptx_to_cubin(const std::string& ptx, const std::string& ptxas_path, int cc, ptxas_info* info = nullptr);
 CUmodule ptx_to_cumodule(const std::string& ptx, int cc);
-std::string llir_to_amdgpu(llvm::Module* module, const std::string& proc);
-hipModule_t amdgpu_to_hipmodule(const std::string& path);
+// processor and LLVM target features of a GCN architecture name with its target
+// features (e.g., "gfx90a" and "+sramecc,-xnack" for "gfx90a:sramecc+:xnack-").
+// Throws std::invalid_argument if `arch` is malformed
+std::pair<std::string, std::string> amdgpu_target(const std::string& arch);
+// returns the bytes of the linked HSA code object. `arch` is the GCN architecture
+// name of the device, with its target features (e.g., "gfx90a:sramecc+:xnack-")
+std::string llir_to_amdgpu(llvm::Module* module, const std::string& arch,
+                           const std::string& pipeline = "", std::string* opt_report = nullptr);
+std::string amdgpu_link(const std::string& obj);
+hipModule_t amdgpu_to_hipmodule(const std::string& hsaco);
+// host kernels are called through a launcher that unpacks their parameter buffer
+typedef void (*host_launch_t)(char* params, int32_t pid_0, int32_t pid_1, int32_t pid_2,
+                              int32_t num_0, int32_t num_1, int32_t num_2);
+std::string host_cpu_name();
+// returns the optimized LLVM-IR of the host kernel `name`, with its launcher
+std::string llir_to_host(llvm::Module* module, const std::string& name);
+// JIT-compiles host LLVM-IR; returns a module handle
+uint64_t host_load(const std::string& llir, const std::string& name, host_launch_t& launch);
 
 }
 }
@@ -237,6 +237,44 @@ typedef enum hipDeviceAttribute_t {
 
 typedef void* hipDeviceptr_t;
 
+/*
+ * @brief hipDeviceProp_t
+ * Leading fields of the properties returned by hipGetDeviceProperties on ROCm 4 and 5,
+ * up to the name of the GCN architecture; `reserved` covers the remaining ones.
+ */
+typedef struct hipDeviceProp_t {
+    char name[256];
+    size_t totalGlobalMem;
+    size_t sharedMemPerBlock;
+    int regsPerBlock;
+    int warpSize;
+    int maxThreadsPerBlock;
+    int maxThreadsDim[3];
+    int maxGridSize[3];
+    int clockRate;
+    int memoryClockRate;
+    int memoryBusWidth;
+    size_t totalConstMem;
+    int major;
+    int minor;
+    int multiProcessorCount;
+    int l2CacheSize;
+    int maxThreadsPerMultiProcessor;
+    int computeMode;
+    int clockInstructionRate;
+    unsigned arch;  ///< hipDeviceArch_t bit-field
+    int concurrentKernels;
+    int pciDomainID;
+    int pciBusID;
+    int pciDeviceID;
+    size_t maxSharedMemoryPerMultiProcessor;
+    int isMultiGpuBoard;
+    int canMapHostMemory;
+    int gcnArch;
+    char gcnArchName[256];  ///< e.g., "gfx90a:sramecc+:xnack-"
+    char reserved[1024];
+} hipDeviceProp_t;
+
 /*
  * @brief hipJitOption
  * @enum
@@ -5,6 +5,7 @@
 
 #include <string>
 #include <list>
+#include <algorithm>
 #include "value.h"
 #include "visitor.h"
 
@@ -30,6 +31,10 @@ private:
   basic_block(context &ctx, const std::string &name, function *parent, basic_block *next);
 
 public:
+  // basic blocks are allocated in the arena of their context (see context_impl.h)
+  static void* operator new(size_t size, context &ctx);
+  static void operator delete(void *ptr, context &ctx);
+  static void operator delete(void *ptr) { }
   // accessors
   function* get_parent() { return parent_; }
   context& get_context() { return ctx_; }
@@ -41,7 +46,12 @@ public:
   // get instruction list
   inst_list_t           &get_inst_list()       { return inst_list_; }
   const inst_list_t     &get_inst_list() const { return inst_list_; }
-  void  erase(instruction *i)                  {  inst_list_.remove(i); }
+  void  erase(instruction *i)                  {
+    // stop at the first match instead of scanning the whole block
+    iterator it = std::find(begin(), end(), i);
+    if(it != end())
+      inst_list_.erase(it);
+  }
 
   // instruction iterator functions
   inline iterator                begin()       { return inst_list_.begin(); }
@@ -0,0 +1,38 @@
+#pragma once
+
+#ifndef _TRITON_IR_BITCODE_H_
+#define _TRITON_IR_BITCODE_H_
+
+#include <string>
+#include <string_view>
+
+namespace triton{
+namespace ir{
+
+class module;
+class builder;
+
+// Serialization of Triton-IR modules, with their functions, argument attributes,
+// types, constants, instructions (and their metadata), source files and module
+// metadata. Modules read back print, and compile, the same as the ones written.
+//
+// The bitcode is a sequence of records: a tag followed by unsigned integers,
+// reals and strings. The binary form writes them as LEB128 varints after a
+// magic number; the text form writes one record per line, with the names of
+// the tags (e.g., `binop`, `masked_load`), so that modules can be diffed and
+// written by hand. Both start with the version of the format: readers reject
+// any other version.
+//
+// Readers throw std::runtime_error on malformed input. The modules they return
+// are created with `builder`, and belong to the caller.
+const unsigned bitcode_version = 4;
+
+std::string write_bitcode(module &mod);
+module* read_bitcode(std::string_view data, builder &builder);
+std::string write_text(module &mod);
+module* parse_text(std::string_view text, builder &builder);
+
+}
+}
+
+#endif
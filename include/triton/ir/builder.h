@@ -5,6 +5,7 @@
 
 #include <vector>
 #include <string>
+#include <tuple>
 #include "instructions.h"
 #include "basic_block.h"
 #include "type.h"
@@ -39,6 +40,11 @@ public:
   void set_insert_point(basic_block* block);
   basic_block* get_insert_block() { return block_; }
   iterator get_insert_point() { return insert_point_;}
+  // Source location of the instructions inserted next (see `module::add_source_file`);
+  // line 0 means no location. Inserting next to an instruction adopts its location
+  void set_loc(unsigned file, unsigned line, unsigned column);
+  void set_loc(instruction* i);
+  std::tuple<unsigned, unsigned, unsigned> get_loc() const { return {loc_file_, loc_line_, loc_column_}; }
   // Constants
   value *get_int1(bool val);
   value *get_int32(uint32_t val);
@@ -46,6 +52,9 @@ public:
   value *get_float16(float val);
   value *get_float32(float val);
   value *get_range(int32_t lo, int32_t hi);
+  // Pointer to an array of constant memory holding `values`, of type `ty`. Tables of
+  // the same contents are shared by the functions of the module
+  value *get_constant_table(type *ty, const std::vector<constant*> &values);
   // Types
   type *get_void_ty();
   type *get_int1_ty();
@@ -64,6 +73,11 @@ public:
     assert(block_);
     block_->get_inst_list().insert(insert_point_, inst);
     inst->set_parent(block_);
+    if(loc_line_){
+      inst->set_metadata(metadata::file, loc_file_);
+      inst->set_metadata(metadata::line, loc_line_);
+      inst->set_metadata(metadata::column, loc_column_);
+    }
 //    for(ir::value* op: inst->ops())
 //      op->add_use(inst);
     return inst;
@@ -144,6 +158,9 @@ public:
   value *create_load(value *arg, load_inst::CACHE_MODIFIER cache, load_inst::EVICTION_POLICY eviction, bool is_volatile);
   value *create_store(value *ptr, value *val);
   value *create_masked_load(value *arg, value *mask, value *false_value, load_inst::CACHE_MODIFIER cache, load_inst::EVICTION_POLICY eviction, bool is_volatile);
+  value *create_tile_load(value *arg, value *mask, value *false_value, value *base, const std::vector<value*>& shape,
+                          const std::vector<value*>& strides, const std::vector<value*>& offsets,
+                          load_inst::CACHE_MODIFIER cache, load_inst::EVICTION_POLICY eviction, bool is_volatile);
   value *create_masked_store(value *ptr, value *val, value *mask);
   // Struct instructions
   value *create_insert_value(value* val, value *elt, size_t idx);
@@ -154,8 +171,8 @@ public:
   value *create_cat(value *lhs, value *rhs);
   value *create_broadcast(value *arg, const type::block_shapes_t &shapes);
   // Atomic instruction
-  value *create_atomic_cas(value *ptr, value *cmp, value *val);
-  value *create_atomic_rmw(atomic_rmw_op_t op, value *ptr, value *val, value *msk);
+  value *create_atomic_cas(value *ptr, value *cmp, value *val, mem_scope_t scope = mem_scope_t::GPU);
+  value *create_atomic_rmw(atomic_rmw_op_t op, value *ptr, value *val, value *msk, mem_scope_t scope = mem_scope_t::GPU);
   value *create_atomic_max(value *ptr, value *val, value *msk);
   value *create_atomic_umax(value *ptr, value *val, value *msk);
   value *create_atomic_min(value *ptr, value *val, value *msk);
@@ -169,6 +186,8 @@ public:
   // Utilities
   value *create_clock();
   value *create_globaltimer();
+  value *create_grid_sync();
+  value *create_fence(mem_scope_t scope);
   // Built-in instruction
   value *create_get_program_id(unsigned axis);
   value *create_get_num_programs(unsigned axis);
@@ -176,25 +195,41 @@ public:
   value *create_cos(value* arg);
   value *create_sin(value* arg);
   value *create_log(value* arg);
-  value *create_dot(value *A, value *B, value *C, bool allow_tf32);
+  value *create_dot(value *A, value *B, value *C, bool allow_tf32, bool split_tf32);
+  value *create_sparse_dot(value *A, value *E, value *B, value *C);
   value *create_trans(value *A, const std::vector<int> &perm = {});
   value *create_sqrt(value *A);
   value *create_reduce(value *A, reduce_inst::op_t op, unsigned axis);
+  value *create_scan(value *A, reduce_inst::op_t op, unsigned axis, bool exclusive);
   value *create_select(value *pred, value *if_value, value *else_value);
   // Intrinsics
   // These have no place in the IR, and hopefully they can be removed at some point
   value *create_umulhi(value* lhs, value* rhs);
+  value *create_philox(value* offset, value* k0, value* k1, unsigned n_rounds, unsigned word, bool to_float);
+  value *create_math(const std::string &fn, const std::vector<value*> &args);
   value *create_copy_to_shared(value *arg);
   value *create_masked_load_async(value *arg, value *mask, value *false_value, load_inst::CACHE_MODIFIER cache, load_inst::EVICTION_POLICY);
   value *create_copy_from_shared(value *arg);
   value *create_barrier(const std::string &name = "");
+  value *create_named_barrier(int id, int num_threads);
   value *create_async_wait(int N);
   value *create_prefetch_s(value *arg, int inc);
 
+private:
+  // constant folding and algebraic simplification; these return nullptr
+  // when an instruction must be created
+  value *fold_binop(binary_op_t op, value *lhs, value *rhs);
+  value *fold_cast(cast_op_t op, value *src, type *dst_ty);
+  value *fold_cmp(cmp_pred_t pred, value *lhs, value *rhs);
+  value *splat_like(value *cst, value *like);
+
 private:
   context &ctx_;
   basic_block *block_;
   iterator insert_point_;
+  unsigned loc_file_;
+  unsigned loc_line_;
+  unsigned loc_column_;
 };
 
 
@@ -97,10 +97,15 @@ public:
 };
 
 /* global variable */
+// Array of `size` elements of `ty` in the constant memory of the device, which holds
+// `init` when it is given (see builder::get_constant_table)
 class alloc_const: public global_object {
 public:
   alloc_const(type *ty, constant_int *size,
-              const std::string &name = "");
+              const std::string &name = "",
+              const std::vector<constant*> &init = {});
+  constant_int *get_size() const { return (constant_int*)get_operand(0); }
+  std::vector<constant*> get_init() const;
   std::string repr() const { return get_name(); }
   void accept(visitor* vst) { vst->visit_alloc_const(this); }
 
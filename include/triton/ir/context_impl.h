@@ -5,13 +5,63 @@
 
 #include "triton/ir/type.h"
 #include "triton/ir/constant.h"
+#include <functional>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace triton{
 namespace ir{
 
 class context;
+class value;
+
+// Bump allocator of the instructions and basic blocks of a context. They live as long
+// as its types and constants: the values allocated here are destroyed, in the reverse
+// order of their allocation, with the context, and are never deleted one by one
+class value_arena {
+public:
+  value_arena() {}
+  value_arena(const value_arena&) = delete;
+  value_arena& operator=(const value_arena&) = delete;
+  ~value_arena();
+  // storage of a value that derives from `value` alone, and thus starts with it
+  void* allocate(size_t size);
+  // storage whose value threw during its construction
+  void release(void* ptr);
+
+private:
+  static const size_t slab_size = 64*1024;
+  std::vector<std::unique_ptr<char[]>> slabs_;
+  char* cur_ = nullptr;
+  size_t left_ = 0;
+  std::vector<void*> values_;
+};
+
+// hash of the keys under which types and constants are interned
+struct interning_hash {
+  static size_t combine(size_t seed, size_t v) {
+    return seed ^ (v + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+  }
+  template<class T>
+  size_t operator()(const std::vector<T>& v) const {
+    size_t ret = v.size();
+    for(const T& x: v)
+      ret = combine(ret, std::hash<T>()(x));
+    return ret;
+  }
+  template<class T, class U>
+  size_t operator()(const std::pair<T, U>& p) const {
+    return combine(std::hash<T>()(p.first), hash_second(p.second));
+  }
+
+private:
+  template<class U>
+  size_t hash_second(const U& v) const { return std::hash<U>()(v); }
+  template<class U>
+  size_t hash_second(const std::vector<U>& v) const { return (*this)(v); }
+};
 
 /* Context impl */
 class context_impl {
@@ -27,18 +77,19 @@ public:
   // integer types
   integer_type int1_ty, int8_ty, int16_ty, int32_ty, int64_ty, int128_ty;
   // Pointer types
-  std::map<std::pair<type*, unsigned>, std::unique_ptr<pointer_type>> ptr_tys;
+  std::unordered_map<std::pair<type*, unsigned>, std::unique_ptr<pointer_type>, interning_hash> ptr_tys;
   // Block types
-  std::map<std::pair<type*, type::block_shapes_t>, std::unique_ptr<block_type>> block_tys;
+  std::unordered_map<std::pair<type*, type::block_shapes_t>, std::unique_ptr<block_type>, interning_hash> block_tys;
   // Struct types
-  std::map<type::contained_tys_vec_t, struct_type*> struct_tys;
+  std::unordered_map<type::contained_tys_vec_t, struct_type*, interning_hash> struct_tys;
   // Int constants
-  std::map<std::pair<type*, uint64_t>, std::unique_ptr<constant_int>> int_constants_;
+  std::unordered_map<std::pair<type*, uint64_t>, std::unique_ptr<constant_int>, interning_hash> int_constants_;
   // Float constants
-  std::map<std::pair<type*, double>, std::unique_ptr<constant_fp>> fp_constants_;
+  std::unordered_map<std::pair<type*, double>, std::unique_ptr<constant_fp>, interning_hash> fp_constants_;
   // undef values
-  std::map<type*, std::unique_ptr<undef_value>> uv_constants_;
-
+  std::unordered_map<type*, std::unique_ptr<undef_value>> uv_constants_;
+  // instructions and basic blocks, destroyed before the types and constants they use
+  value_arena values;
 };
 
 }
@@ -41,6 +41,12 @@ enum class atomic_rmw_op_t: unsigned int{
   Xchg,
 };
 
+// the threads that see the effects of an atomic or a fence in order
+enum class mem_scope_t: unsigned int{
+  GPU,
+  SYS,
+};
+
 enum cast_op_t: unsigned int {
   Trunc,
   ZExt,
@@ -157,6 +163,7 @@ enum value_id_t: unsigned {
   // array arithmetic
   INST_TRANS,
   INST_REDUCE,
+  INST_SCAN,
   INST_DOT,
   // intrinsics
   INST_COPY_TO_SHARED,
@@ -173,6 +180,10 @@ enum value_id_t: unsigned {
   INST_PREFETCH_S,
   INST_GLOBALTIMER,
   INST_CLOCK,
+  INST_GRID_SYNC,
+  INST_PHILOX,
+  INST_MATH,
+  INST_FENCE,
 };
 
 
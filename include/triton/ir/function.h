@@ -123,6 +123,9 @@ public:
   std::set<attribute> get_attributes(const argument* arg) { return attrs_[arg->get_arg_no() + 1]; }
   void set_is_kernel(bool new_val) { is_kernel_ = new_val; }
   bool get_is_kernel() { return is_kernel_; }
+  // whether transform::reorder schedules the instructions of this function
+  void set_schedule(bool new_val) { schedule_ = new_val; }
+  bool get_schedule() const { return schedule_; }
 
   void print(std::ostream &os);
 
@@ -137,6 +140,7 @@ private:
   blocks_t blocks_;
   attr_map_t attrs_;
   bool is_kernel_;
+  bool schedule_;
 };
 
 }
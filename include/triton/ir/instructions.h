@@ -13,7 +13,7 @@
 #include "triton/ir/visitor.h"
 
 #define _TRITON_DEFINE_CLONE(name) \
-  ir::instruction* clone_impl() const { return new name(*this); }
+  ir::instruction* clone_impl() const { return new (get_type()->get_context()) name(*this); }
 
 #define _TRITON_DEFINE_ACCEPT(name) \
   void accept(visitor* v) { v->visit_ ## name (this); }
@@ -48,6 +48,10 @@ protected:
               const std::string &name = "", instruction *next = nullptr);
 
 public:
+  // instructions are allocated in the arena of their context (see context_impl.h)
+  static void* operator new(size_t size, context &ctx);
+  static void operator delete(void *ptr, context &ctx);
+  static void operator delete(void *ptr)                      { }
   // parent
   void set_parent(basic_block *block)                         { parent_ = block; }
   const basic_block *get_parent() const                       { return parent_;  }
@@ -61,6 +65,7 @@ public:
   void set_metadata(ir::metadata::kind_t kind,
                     unsigned value)                           { metadatas_[kind] = value;}
   unsigned get_metadata(ir::metadata::kind_t kind)            { return metadatas_[kind];}
+  const std::map<ir::metadata::kind_t, unsigned>& get_metadatas() const { return metadatas_; }
   // cloning
   ir::instruction* clone() {
     ir::instruction* res = clone_impl();
@@ -101,6 +106,9 @@ private:
   ir::function* fn_;
 };
 
+// launches `fn`, a kernel of the same module, from the first thread of the program.
+// Modules are lowered for one number of warps, which the callee runs with: the
+// `num_warps` operand is kept for the format of the IR but not used
 class launch_inst: public instruction {
 private:
   std::string repr_impl() const { return "launch"; }
@@ -463,6 +471,17 @@ public:
   EVICTION_POLICY get_eviction_policy() const { return eviction_; }
   bool get_is_volatile() const { return is_volatile_; }
 
+  // tiles (see builder::create_tile_load): the block that the pointer operand spans
+  // is also described as the one at `offsets` of the tensor of `shape` and `strides`
+  // (in elements) at `base`. These operands follow those of the load
+  void set_tile(const std::vector<value*>& tile);
+  std::vector<value*> get_tile() const;
+  unsigned get_tile_rank() const { return (get_num_operands() - num_load_ops_) / 3; }
+  value *get_tile_base() const { return get_operand(num_load_ops_); }
+  value *get_tile_shape(unsigned d) const { return get_operand(num_load_ops_ + 1 + d); }
+  value *get_tile_stride(unsigned d) const { return get_operand(num_load_ops_ + 1 + get_tile_rank() + d); }
+  value *get_tile_offset(unsigned d) const { return get_operand(num_load_ops_ + 1 + 2*get_tile_rank() + d); }
+
 protected:
   load_inst(value *ptr, value_id_t id, unsigned num_ops, CACHE_MODIFIER cache, EVICTION_POLICY eviction,
           bool is_volatile,
@@ -483,6 +502,8 @@ protected:
     return is_volatile_ ? ".volatile" : "";
   }
   bool is_volatile_;
+  // operands of the load, before those of its tile
+  unsigned num_load_ops_;
 
 private:
   static type *get_pointee_type(type *ty);
@@ -754,6 +775,11 @@ private:
 class atomic_inst: public io_inst {
 public:
   using io_inst::io_inst;
+  mem_scope_t get_scope() const { return scope_; }
+  void set_scope(mem_scope_t scope) { scope_ = scope; }
+
+private:
+  mem_scope_t scope_ = mem_scope_t::GPU;
 };
 
 class atomic_rmw_inst: public atomic_inst {
@@ -793,6 +819,51 @@ public:
   static instruction* create(value *lhs, value *rhs, const std::string &name = "", instruction *next = nullptr);
 };
 
+// word `word` of `n_rounds` rounds of Philox 4x32 on the counter (offset, 0, 0, 0)
+// and the key (k0, k1), as a uint32 or, if `to_float`, as a float32 in [0, 1).
+// The four words of a counter are computed once for all the instructions of a
+// block that share its operands
+class philox_inst: public builtin_inst {
+private:
+  philox_inst(value *offset, value *k0, value *k1, unsigned n_rounds, unsigned word, bool to_float,
+              const std::string &name = "", instruction *next = nullptr);
+  std::string repr_impl() const { return "philox"; }
+  _TRITON_DEFINE_CLONE(philox_inst)
+  _TRITON_DEFINE_ACCEPT(philox_inst)
+
+public:
+  static instruction* create(value *offset, value *k0, value *k1, unsigned n_rounds, unsigned word, bool to_float,
+                             const std::string &name = "", instruction *next = nullptr);
+  unsigned get_n_rounds() const { return n_rounds_; }
+  unsigned get_word() const { return word_; }
+  bool get_to_float() const { return to_float_; }
+
+private:
+  unsigned n_rounds_;
+  unsigned word_;
+  bool to_float_;
+};
+
+// element-wise math function `fn` (e.g., "erf", "pow") of floating-point operands of
+// the same type, lowered to a call to the math library of the target (libdevice,
+// ocml or libm) unless the target has an instruction for it
+class math_inst: public builtin_inst {
+private:
+  math_inst(const std::string &fn, const std::vector<value*> &args, const std::string &name = "",
+            instruction *next = nullptr);
+  std::string repr_impl() const { return fn_; }
+  _TRITON_DEFINE_CLONE(math_inst)
+  _TRITON_DEFINE_ACCEPT(math_inst)
+
+public:
+  static instruction* create(const std::string &fn, const std::vector<value*> &args, const std::string &name = "",
+                             instruction *next = nullptr);
+  const std::string& get_fn() const { return fn_; }
+
+private:
+  std::string fn_;
+};
+
 class exp_inst: public builtin_inst {
 private:
   exp_inst(value *val, const std::string &name = "", instruction *next = nullptr);
@@ -848,16 +919,27 @@ public:
   };
 
 private:
-  dot_inst(value *A, value *B, value *C, TransT AT, TransT BT, bool allow_tf32, const std::string &name, instruction *next);
+  dot_inst(value *A, value *B, value *C, TransT AT, TransT BT, bool allow_tf32, const std::string &name, instruction *next,
+           value *E = nullptr);
   std::string repr_impl() const { return "dot"; }
   
 public:
   bool is_prefetched() const { return is_prefetched_; }
   void set_prefetched(bool is_prefetched) { is_prefetched_ = is_prefetched; }
   bool allow_tf32() const { return allow_tf32_; }
+  // fp32 operands are split into a tf32 part and a tf32 remainder,
+  // multiplied with three tf32 MMAs (3xTF32)
+  bool split_tf32() const { return split_tf32_; }
+  void set_split_tf32(bool split_tf32) { split_tf32_ = split_tf32; }
+  // 2:4 structured sparsity: A holds the two kept values of every group of four
+  // along K, and the int32 metadata E (operand 3) the positions of the values of
+  // each row in 32 columns of K, as two 2-bit indices per group
+  bool is_sparse() const { return get_num_operands() == 4; }
+  value *get_meta() const { return is_sparse() ? get_operand(3) : nullptr; }
 
 public:
   static instruction *create(value *A, value *B, value *C, bool AT, bool BT, bool allow_tf32, const std::string &name = "", instruction *next = nullptr);
+  static instruction* create_sparse(value *A, value *E, value *B, value *C, const std::string &name = "", instruction *next = nullptr);
   static instruction* create_nn(value *A, value *B, value *C, bool allow_tf32, const std::string &name = "", instruction *next = nullptr);
   static instruction* create_nt(value *A, value *B, value *C, bool allow_tf32, const std::string &name = "", instruction *next = nullptr);
   static instruction* create_tn(value *A, value *B, value *C, bool allow_tf32, const std::string &name = "", instruction *next = nullptr);
@@ -868,6 +950,7 @@ public:
 private:
   bool is_prefetched_ = false;
   bool allow_tf32_ = false;
+  bool split_tf32_ = false;
   DataType C_type_ = DataType::FP32;
   DataType A_type_ = DataType::FP16;
   DataType B_type_ = DataType::FP16;
@@ -914,11 +997,13 @@ public:
   enum op_t{
     ADD, SUB, MAX, MIN,
     FADD, FSUB, FMAX, FMIN,
-    XOR
+    XOR,
+    // index of the extreme element along the axis (the first one, on ties)
+    ARGMAX, ARGMIN, ARGFMAX, ARGFMIN
   };
 
 private:
-  static type* get_res_type(value *arg, unsigned axis);
+  static type* get_res_type(value *arg, op_t op, unsigned axis);
   static std::string to_str(op_t op);
 
 private:
@@ -931,12 +1016,33 @@ public:
   static instruction* create(value *arg, op_t op, unsigned axis, const std::string &name = "", instruction *next = nullptr);
   unsigned get_axis() const { return axis_; }
   op_t get_op() const { return op_; }
+  bool is_arg() const { return op_ >= ARGMAX; }
 
 private:
   unsigned axis_;
   op_t op_;
 };
 
+class scan_inst: public builtin_inst {
+private:
+  scan_inst(value* arg, reduce_inst::op_t op, unsigned axis, bool exclusive, const std::string& name, instruction* next);
+  std::string repr_impl() const { return exclusive_ ? "exclusive_scan" : "scan"; }
+  _TRITON_DEFINE_CLONE(scan_inst)
+  _TRITON_DEFINE_ACCEPT(scan_inst)
+
+public:
+  static instruction* create(value *arg, reduce_inst::op_t op, unsigned axis, bool exclusive,
+                             const std::string &name = "", instruction *next = nullptr);
+  unsigned get_axis() const { return axis_; }
+  reduce_inst::op_t get_op() const { return op_; }
+  bool is_exclusive() const { return exclusive_; }
+
+private:
+  unsigned axis_;
+  reduce_inst::op_t op_;
+  bool exclusive_;
+};
+
 class select_inst: public builtin_inst {
 private:
   select_inst(value *pred, value *if_value, value *else_value, const std::string& name, instruction* next);
@@ -991,16 +1097,31 @@ public:
   _TRITON_DEFINE_ACCEPT(cvt_layout_inst)
 };
 
+// Synchronizes all threads of a program or, for named barriers,
+// the first `num_threads` threads that arrive at barrier `id`
 class barrier_inst: public instruction{
 private:
-  barrier_inst(context &ctx, const std::string &name, instruction *next);
-  std::string repr_impl() const { return "barrier"; }
+  barrier_inst(context &ctx, int id, int num_threads, const std::string &name, instruction *next);
+  std::string repr_impl() const {
+    if(num_threads_ == 0)
+      return "barrier";
+    return "barrier(" + std::to_string(id_) + ", " + std::to_string(num_threads_) + ")";
+  }
   _TRITON_DEFINE_CLONE(barrier_inst)
   _TRITON_DEFINE_ACCEPT(barrier_inst)
 
 public:
   static barrier_inst* create(context &ctx, const std::string &name = "",
                                             instruction *next = nullptr);
+  static barrier_inst* create_named(context &ctx, int id, int num_threads, const std::string &name = "",
+                                    instruction *next = nullptr);
+  bool is_named() const { return num_threads_ > 0; }
+  int get_barrier_id() const { return id_; }
+  int get_num_threads() const { return num_threads_; }
+
+private:
+  int id_;
+  int num_threads_;
 };
 
 class async_wait_inst: public instruction{
@@ -1075,6 +1196,32 @@ public:
   static globaltimer_inst* create(context &ctx, const std::string &name = "", instruction *next = nullptr);
 };
 
+// Synchronizes all the programs of the grid, which must all be resident at once
+class grid_sync_inst: public instruction{
+  grid_sync_inst(context &ctx, const std::string &name, instruction *next);
+  std::string repr_impl() const { return "grid_sync"; }
+  _TRITON_DEFINE_CLONE(grid_sync_inst)
+  _TRITON_DEFINE_ACCEPT(grid_sync_inst)
+
+public:
+  static grid_sync_inst* create(context &ctx, const std::string &name = "", instruction *next = nullptr);
+};
+
+// Orders the memory accesses of each thread before and after it, as seen by the threads of `scope`
+class fence_inst: public instruction{
+  fence_inst(context &ctx, mem_scope_t scope, const std::string &name, instruction *next);
+  std::string repr_impl() const { return scope_ == mem_scope_t::SYS ? "fence.sys" : "fence.gpu"; }
+  _TRITON_DEFINE_CLONE(fence_inst)
+  _TRITON_DEFINE_ACCEPT(fence_inst)
+
+public:
+  static fence_inst* create(context &ctx, mem_scope_t scope, const std::string &name = "", instruction *next = nullptr);
+  mem_scope_t get_scope() const { return scope_; }
+
+private:
+  mem_scope_t scope_;
+};
+
 
 }
 }
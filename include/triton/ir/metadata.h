@@ -12,7 +12,14 @@ class metadata{
 public:
   enum kind_t{
     multiple_of,
-    max_contiguous
+    max_contiguous,
+    // source location of an instruction: index of its file in the
+    // source files of the module, line and column
+    file,
+    line,
+    column,
+    // how a call is handled by the inliner (see `codegen::transform::inliner::hint_t`)
+    inline_hint
   };
 
 private:
@@ -20,6 +27,8 @@ private:
 
 public:
   static metadata* get(kind_t kind, unsigned value);
+  // locations do not change the value of an instruction
+  static bool is_location(kind_t kind) { return kind == file || kind == line || kind == column; }
 
 private:
   kind_t kind_;
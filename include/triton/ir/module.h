@@ -113,6 +113,29 @@ public:
   void print(std::ostream &os);
   void add_metadata(const std::string &name, md_pair_t x)     { metadatas_[name] = x; }
   const std::map<std::string, md_pair_t> &get_metadatas() const { return metadatas_; }
+  // Source files, referred to by the `file` metadata of instructions (from 1)
+  unsigned add_source_file(const std::string& path);
+  const std::vector<std::string>& get_source_files() const    { return source_files_; }
+  // LLVM pipeline run before code generation (see driver::optimize_llir); none if empty
+  void set_llvm_opt(const std::string& pipeline)              { llvm_opt_ = pipeline; }
+  const std::string& get_llvm_opt() const                     { return llvm_opt_; }
+  // Layout conversions pad their shared memory to avoid bank conflicts, unless
+  // the module is compiled without padding to fit in less shared memory
+  void set_shared_padding(bool padding)                       { shared_padding_ = padding; }
+  bool get_shared_padding() const                             { return shared_padding_; }
+  // Math functions use the approximate, flush-to-zero forms of the target
+  void set_fast_math(bool fast_math)                          { fast_math_ = fast_math; }
+  bool get_fast_math() const                                  { return fast_math_; }
+  // Program ids along the first two axes are remapped to a grouped order, in which
+  // waves of `raster` programs run on tiles close to each other (0: launch order)
+  void set_raster(unsigned raster)                            { raster_ = raster; }
+  unsigned get_raster() const                                 { return raster_; }
+  // Kernels loop over the tiles of their grid (see codegen::transform::persistent)
+  void set_persistent(bool persistent)                        { persistent_ = persistent; }
+  bool get_persistent() const                                 { return persistent_; }
+  // Kernels run many launches of themselves at once (see codegen::transform::horizontal)
+  void set_horizontal(bool horizontal)                        { horizontal_ = horizontal; }
+  bool get_horizontal() const                                 { return horizontal_; }
 
 private:
   std::string name_;
@@ -122,6 +145,13 @@ private:
   std::vector<ir::alloc_const*> allocs_;
   std::map<std::string, ir::value*> globals_;
   std::map<std::string, md_pair_t> metadatas_;
+  std::vector<std::string> source_files_;
+  std::string llvm_opt_;
+  bool shared_padding_ = true;
+  bool fast_math_ = false;
+  unsigned raster_ = 0;
+  bool persistent_ = false;
+  bool horizontal_ = false;
 };
 
 }
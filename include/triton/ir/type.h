@@ -187,6 +187,7 @@ class struct_type: public composite_type {
 public:
   struct_type(const contained_tys_vec_t& tys, bool is_packed);
   unsigned get_num_types() const { return contained_tys_.size(); }
+  bool is_packed() const { return is_packed_; }
   static struct_type* get(const contained_tys_vec_t& tys, bool is_packed);
 
 private:
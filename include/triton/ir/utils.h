@@ -3,6 +3,8 @@
 #ifndef _TRITON_IR_CFG_H_
 #define _TRITON_IR_CFG_H_
 
+#include <map>
+#include <set>
 #include <vector>
 #include <functional>
 
@@ -19,10 +21,14 @@ class cfg {
 public:
   static std::vector<basic_block *> post_order(function* fn);
   static std::vector<basic_block *> reverse_post_order(function* fn);
+  // blocks that dominate each block, including itself
+  static std::map<basic_block *, std::set<basic_block *>> dominators(function* fn);
 };
 
 void for_each_instruction(ir::module& mod, const std::function<void(triton::ir::instruction*)> &fn);
 void for_each_value(ir::module& mod, const std::function<void(triton::ir::value *)> &fn);
+// values that pointer `v` may be derived from; values whose origin is unknown are their own base
+std::set<value*> get_bases(value* v);
 
 }
 }
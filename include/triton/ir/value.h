@@ -3,7 +3,9 @@
 #ifndef _TRITON_IR_VALUE_H_
 #define _TRITON_IR_VALUE_H_
 
+#include <list>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <set>
 
@@ -15,13 +17,41 @@ class use;
 class user;
 class visitor;
 
+//===----------------------------------------------------------------------===//
+//                               use list
+//===----------------------------------------------------------------------===//
+
+// Users of a value, in the order they were added, with one entry per use.
+// Entries are indexed by user so that removing one does not scan the list
+class use_list {
+public:
+  typedef std::list<user*>::const_iterator const_iterator;
+
+public:
+  use_list() {}
+  use_list(const use_list& other) { for(user* u: other) push_back(u); }
+  use_list& operator=(const use_list& other);
+  void push_back(user* u);
+  bool erase(user* u);
+  void clear() { users_.clear(); pos_.clear(); }
+  const_iterator begin() const { return users_.begin(); }
+  const_iterator end() const { return users_.end(); }
+  user* front() const { return users_.front(); }
+  size_t size() const { return users_.size(); }
+  bool empty() const { return users_.empty(); }
+
+private:
+  std::list<user*> users_;
+  std::unordered_map<user*, std::vector<std::list<user*>::iterator>> pos_;
+};
+
 //===----------------------------------------------------------------------===//
 //                               value class
 //===----------------------------------------------------------------------===//
 
 class value {
 public:
-  typedef std::vector<user*> users_t;
+  typedef use_list users_t;
 
 public:
   // constructor
@@ -29,8 +59,8 @@ public:
   virtual ~value(){ }
   // uses
   void add_use(user* arg);
-  users_t::iterator erase_use(user* arg);
-  const std::vector<user*> &get_users() { return users_; }
+  bool erase_use(user* arg);
+  const users_t &get_users() { return users_; }
   void replace_all_uses_with(value *target);
   // name
   void set_name(const std::string &name);
@@ -80,7 +110,7 @@ public:
   unsigned get_num_hidden() const;
 
   // Utils
-  value::users_t::iterator replace_uses_of_with(value *before, value *after);
+  void replace_uses_of_with(value *before, value *after);
 
 
 private:
@@ -70,6 +70,7 @@ class dot_inst;
 class trans_inst;
 class sqrt_inst;
 class reduce_inst;
+class scan_inst;
 class select_inst;
 
 class cvt_layout_inst;
@@ -83,6 +84,10 @@ class make_range;
 class prefetch_s_inst;
 class clock_inst;
 class globaltimer_inst;
+class grid_sync_inst;
+class fence_inst;
+class philox_inst;
+class math_inst;
 
 class make_range_sta;
 class undef_value;
@@ -157,6 +162,7 @@ public:
   virtual void visit_trans_inst(trans_inst*) = 0;
   virtual void visit_sqrt_inst(sqrt_inst*) = 0;
   virtual void visit_reduce_inst(reduce_inst*) = 0;
+  virtual void visit_scan_inst(scan_inst*) = 0;
   virtual void visit_select_inst(select_inst*) = 0;
 
   virtual void visit_cvt_layout_inst(cvt_layout_inst*) = 0;
@@ -172,6 +178,10 @@ public:
   virtual void visit_function(function*) = 0;
   virtual void visit_clock_inst(clock_inst*) = 0;
   virtual void visit_globaltimer_inst(globaltimer_inst*) = 0;
+  virtual void visit_grid_sync_inst(grid_sync_inst*) = 0;
+  virtual void visit_fence_inst(fence_inst*) = 0;
+  virtual void visit_philox_inst(philox_inst*) = 0;
+  virtual void visit_math_inst(math_inst*) = 0;
 
   virtual void visit_undef_value(undef_value*) = 0;
   virtual void visit_constant_int(constant_int*) = 0;
@@ -0,0 +1,124 @@
+#pragma once
+
+#ifndef _TRITON_RUNTIME_RUNTIME_H_
+#define _TRITON_RUNTIME_RUNTIME_H_
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace triton{
+namespace runtime{
+
+enum backend_t {
+  HOST,
+  CUDA,
+  ROCM,
+};
+
+// a kernel loaded on a device, with what it is launched with
+struct kernel_t {
+  backend_t backend;
+  uint64_t module;
+  uint64_t function;
+  size_t shared_mem;
+  int num_threads;
+};
+
+// Loads `image` (a cubin or PTX on CUDA, an HSA code object on ROCm, LLVM-IR
+// on the host) on `device` and returns the handles of its module and of the
+// kernel `name`. CUDA kernels that use more than 48KB of shared memory are
+// opted into the maximum dynamic shared memory of the device, and `carveout`,
+// if not negative, is the percentage of the L1/shared memory of multiprocessors
+// they prefer as shared memory
+std::tuple<uint64_t, uint64_t> load_binary(backend_t backend, const std::string& name, std::string_view image,
+                                           size_t shared_mem, int64_t device, int carveout = -1);
+void unload_binary(backend_t backend, uint64_t module);
+// The two halves of `load_binary`, for images that hold several kernels
+// (CUDA and ROCm only). The current device must be `device`
+uint64_t load_module(backend_t backend, std::string_view image);
+uint64_t get_function(backend_t backend, uint64_t module, const std::string& name, size_t shared_mem, int64_t device,
+                      int carveout = -1);
+
+// Kernels loaded by C++ callers, by key (e.g., the key of the kernel in
+// Triton's cache) and device. Modules are loaded once and unloaded with the
+// registry or when it is cleared, which must happen before their context
+// is destroyed.
+// Lookups and loads are thread-safe
+class module_registry {
+public:
+  ~module_registry() { clear(); }
+  void clear();
+  const kernel_t* find(const std::string& key, int64_t device);
+  const kernel_t& load(const std::string& key, int64_t device, backend_t backend, const std::string& name,
+                       std::string_view image, size_t shared_mem, int num_threads);
+  size_t size();
+
+private:
+  std::mutex mutex_;
+  std::map<std::pair<std::string, int64_t>, kernel_t> kernels_;
+};
+
+// Packs kernel arguments into a parameter buffer, with the sizes and
+// alignments of their types in the kernel's signature: 1-byte bools
+// are not padded, and other values are aligned to their size
+class arg_packer {
+public:
+  void clear() { size_ = 0; ptr_offsets_.clear(); }
+  void reserve(size_t n_args) { if(data_.size() < 8*n_args) data_.resize(8*n_args); }
+  void add_int32(int32_t value) { add(&value, 4); }
+  void add_uint32(uint32_t value) { add(&value, 4); }
+  void add_int64(int64_t value) { add(&value, 8); }
+  void add_uint64(uint64_t value) { add(&value, 8); }
+  void add_float(float value) { add(&value, 4); }
+  void add_bool(bool value) { add(&value, 1); }
+  void add_pointer(uint64_t value) { ptr_offsets_.push_back((size_ + 7) & ~size_t(7)); add(&value, 8); }
+
+  const char* data() const { return data_.data(); }
+  size_t size() const { return size_; }
+  // offsets of pointers in the buffer
+  const std::vector<size_t>& ptr_offsets() const { return ptr_offsets_; }
+  // the packed parameters, as a string of `size()` bytes
+  std::string str() const { return data_.substr(0, size_); }
+
+private:
+  void add(const void* value, size_t size) {
+    size_ = (size_ + size - 1) & ~(size - 1);
+    if(data_.size() < size_ + size)
+      data_.resize(2*(size_ + size));
+    std::memcpy(&data_[size_], value, size);
+    size_ += size;
+  }
+
+private:
+  std::string data_;
+  size_t size_ = 0;
+  std::vector<size_t> ptr_offsets_;
+};
+
+// Enqueues `kernel` on `stream` with the parameters packed in `params`.
+// Host launches are synchronous and run on all cores. Empty grids are not launched
+void launch(backend_t backend, uint64_t function, uint64_t stream, unsigned grid_0, unsigned grid_1, unsigned grid_2,
+            unsigned block_0, unsigned block_1, unsigned block_2, const void* params, size_t params_size, size_t shared_mem);
+inline void launch(const kernel_t& kernel, uint64_t stream, unsigned grid_0, unsigned grid_1, unsigned grid_2,
+                   const arg_packer& params) {
+  launch(kernel.backend, kernel.function, stream, grid_0, grid_1, grid_2, kernel.num_threads, 1, 1,
+         params.data(), params.size(), kernel.shared_mem);
+}
+
+// size of the allocation that `addr` belongs to (CUDA), or 0 if unknown. The ranges of
+// allocations are cached (unless TRITON_CACHE_POINTER_RANGES=0): a range is dropped when
+// an allocation that overlaps it is found, and all of them by `clear_pointer_ranges`,
+// which must be called after memory freed outside of the PyTorch allocator is reused
+size_t pointer_range_size(uint64_t addr);
+void clear_pointer_ranges();
+
+}
+}
+
+#endif
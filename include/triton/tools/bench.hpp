@@ -3,49 +3,112 @@
 #ifndef _TRITON_TOOLS_BENCH_H_
 #define _TRITON_TOOLS_BENCH_H_
 
-#include <chrono>
-#include <functional>
 #include <algorithm>
-#include "triton/driver/device.h"
-#include "triton/driver/stream.h"
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "triton/driver/dispatch.h"
 
 namespace triton{
 namespace tools{
 
-class timer{
-    typedef std::chrono::high_resolution_clock high_resolution_clock;
-    typedef std::chrono::nanoseconds nanoseconds;
+namespace drv = triton::driver;
 
-public:
-    explicit timer(bool run = false)
-    { if (run) start(); }
+// distribution of the running times of a benchmark, in milliseconds
+struct bench_result {
+  std::vector<float> times;
 
-    void start()
-    { _start = high_resolution_clock::now(); }
+  // linear interpolation between the closest ranks
+  float percentile(float q) const {
+    if(times.empty())
+      return NAN;
+    std::vector<float> sorted(times);
+    std::sort(sorted.begin(), sorted.end());
+    float pos = q / 100 * (sorted.size() - 1);
+    size_t lo = std::floor(pos);
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+  }
 
-    nanoseconds get() const
-    { return std::chrono::duration_cast<nanoseconds>(high_resolution_clock::now() - _start); }
+  float median() const { return percentile(50); }
+  float min() const { return percentile(0); }
+  float max() const { return percentile(100); }
+  float mean() const {
+    return times.empty() ? NAN : std::accumulate(times.begin(), times.end(), 0.f) / times.size();
+  }
+
+  // one line of JSON per benchmark, keys in a fixed order so that reports diff cleanly
+  std::string to_json(const std::string& name, const std::string& device = "") const {
+    std::ostringstream os;
+    os << "{\"name\": \"" << name << "\"";
+    if(!device.empty())
+      os << ", \"device\": \"" << device << "\"";
+    os << ", \"repeat\": " << times.size();
+    os << ", \"ms\": {\"min\": " << min() << ", \"p10\": " << percentile(10)
+       << ", \"median\": " << median() << ", \"p90\": " << percentile(90)
+       << ", \"max\": " << max() << ", \"mean\": " << mean() << "}}";
+    return os.str();
+  }
+};
+
+// clears the L2 cache of the current device by overwriting a buffer twice its size
+class l2_flusher {
+public:
+  l2_flusher() {
+    CUdevice dev;
+    int l2_size;
+    drv::dispatch::cuCtxGetDevice(&dev);
+    drv::dispatch::cuDeviceGetAttribute(&l2_size, CU_DEVICE_ATTRIBUTE_L2_CACHE_SIZE, dev);
+    size_ = std::max(2 * (size_t)l2_size, (size_t)1 << 20);
+    drv::dispatch::cuMemAlloc_v2(&buffer_, size_);
+  }
+  ~l2_flusher() { drv::dispatch::cuMemFree_v2(buffer_); }
+  void operator()(CUstream stream) { drv::dispatch::cuMemsetD8Async(buffer_, 0, size_, stream); }
 
 private:
-    high_resolution_clock::time_point _start;
+  CUdeviceptr buffer_;
+  size_t size_;
 };
 
-inline double bench(std::function<void()> const & op, driver::stream * stream, size_t warmup = 10, size_t repeat = 200)
+// times `op` on `stream` with events recorded around each repetition; the L2 cache
+// is flushed before each of them unless `flush` is false
+inline bench_result bench_events(std::function<void()> const & op, CUstream stream,
+                                 size_t warmup = 10, size_t repeat = 200, bool flush = true)
 {
-  timer tmr;
-  std::vector<size_t> times;
-  double total_time = 0;
+  l2_flusher flusher;
   for(size_t i = 0; i < warmup; i++)
     op();
-  stream->synchronize();
-  tmr.start();
+  std::vector<CUevent> start(repeat), end(repeat);
+  for(size_t i = 0; i < repeat; i++){
+    drv::dispatch::cuEventCreate(&start[i], CU_EVENT_DEFAULT);
+    drv::dispatch::cuEventCreate(&end[i], CU_EVENT_DEFAULT);
+  }
   for(size_t i = 0; i < repeat; i++){
+    if(flush)
+      flusher(stream);
+    drv::dispatch::cuEventRecord(start[i], stream);
     op();
+    drv::dispatch::cuEventRecord(end[i], stream);
   }
-  stream->synchronize();
-  return (float)tmr.get().count() / repeat;
+  drv::dispatch::cuStreamSynchronize(stream);
+  bench_result ret;
+  for(size_t i = 0; i < repeat; i++){
+    float ms;
+    drv::dispatch::cuEventElapsedTime(&ms, start[i], end[i]);
+    ret.times.push_back(ms);
+    drv::dispatch::cuEventDestroy_v2(start[i]);
+    drv::dispatch::cuEventDestroy_v2(end[i]);
+  }
+  return ret;
+}
 
-//  return *std::min_element(times.begin(), times.end());
+// median running time of `op`, in milliseconds
+inline double bench(std::function<void()> const & op, CUstream stream, size_t warmup = 10, size_t repeat = 200)
+{
+  return bench_events(op, stream, warmup, repeat).median();
 }
 
 }
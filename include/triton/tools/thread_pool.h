@@ -3,40 +3,174 @@
 #ifndef _TRITON_TOOLS_THREAD_POOL_H_
 #define _TRITON_TOOLS_THREAD_POOL_H_
 
+#include <algorithm>
 #include <vector>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <fstream>
+#include <string>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
+// Work-stealing thread pool.
+//
+// Each worker owns a deque (Chase-Lev): tasks enqueued by a worker are pushed to
+// and popped from the bottom of its own deque without locks, and idle workers
+// steal from the top of the others'. Tasks enqueued by other threads go through
+// a shared queue. `parallel_for` submits a whole range of indices at once, which
+// workers claim in chunks from a shared counter, and returns a single latch.
+//
+// Workers may be pinned to the CPUs of the NUMA nodes of the machine, round-robin.
 class ThreadPool {
+    typedef std::function<void()> task_t;
+
+    // single-producer, multi-consumer deque of tasks (Lê et al., PPoPP 2013).
+    // Rings that are outgrown are kept until destruction, as thieves may still read them
+    class work_deque {
+        struct ring {
+            int64_t capacity;
+            std::unique_ptr<std::atomic<task_t*>[]> slots;
+            ring(int64_t capacity): capacity(capacity), slots(new std::atomic<task_t*>[capacity]) {}
+            task_t* get(int64_t i) { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+            void put(int64_t i, task_t* x) { slots[i & (capacity - 1)].store(x, std::memory_order_relaxed); }
+        };
+
+    public:
+        work_deque(): top_(0), bottom_(0) {
+            rings_.emplace_back(new ring(64));
+            ring_.store(rings_.back().get(), std::memory_order_relaxed);
+        }
+
+        // owner only
+        void push(task_t* x) {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_acquire);
+            ring* r = ring_.load(std::memory_order_relaxed);
+            if(b - t > r->capacity - 1) {
+                rings_.emplace_back(new ring(2 * r->capacity));
+                for(int64_t i = t; i < b; i++)
+                    rings_.back()->put(i, r->get(i));
+                r = rings_.back().get();
+                ring_.store(r, std::memory_order_release);
+            }
+            r->put(b, x);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+
+        // owner only
+        task_t* pop() {
+            int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            ring* r = ring_.load(std::memory_order_relaxed);
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_relaxed);
+            if(t > b) {
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            task_t* x = r->get(b);
+            if(t == b) {
+                // last task: race against thieves
+                if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    x = nullptr;
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+            return x;
+        }
+
+        // any thread
+        task_t* steal() {
+            int64_t t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom_.load(std::memory_order_acquire);
+            if(t >= b)
+                return nullptr;
+            task_t* x = ring_.load(std::memory_order_acquire)->get(t);
+            if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return x;
+        }
+
+    private:
+        std::atomic<int64_t> top_;
+        std::atomic<int64_t> bottom_;
+        std::atomic<ring*> ring_;
+        std::vector<std::unique_ptr<ring>> rings_;
+    };
+
 public:
-    ThreadPool(size_t threads)
-        :   stop(false) {
-      for(size_t i = 0;i < threads;++i)
-          workers.emplace_back(
-              [this] {
-                for(;;){
-                  std::function<void()> task;
-                  {
-                    std::unique_lock<std::mutex> lock(this->queue_mutex);
-                    this->condition.wait(lock,
-                      [this]{ return this->stop || !this->tasks.empty(); });
-                    if(this->stop && this->tasks.empty())
-                      return;
-                    task = std::move(this->tasks.front());
-                    this->tasks.pop();
-                  }
-                  task();
+    // Completion of a `parallel_for`. Threads that wait on it run the chunks
+    // that are left, and exceptions thrown by the body are rethrown to them
+    class latch {
+        friend class ThreadPool;
+
+    public:
+        latch(int64_t n, int64_t grain, std::function<void(int64_t, int64_t)> fn)
+            : n_(n), grain_(grain), fn_(std::move(fn)), next_(0), done_(0) {}
+
+        bool done() const { return done_.load(std::memory_order_acquire) == n_; }
+
+        void wait() {
+            run();
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]{ return done(); });
+            if(error_)
+                std::rethrow_exception(error_);
+        }
+
+    private:
+        // claims and runs chunks until there are none left; returns false if there were none
+        bool run() {
+            bool ran = false;
+            for(int64_t begin = next_.fetch_add(grain_); begin < n_; begin = next_.fetch_add(grain_)) {
+                int64_t end = std::min(begin + grain_, n_);
+                try {
+                    fn_(begin, end);
+                } catch(...) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if(!error_)
+                        error_ = std::current_exception();
                 }
-              }
-          );
-    }
+                ran = true;
+                if(done_.fetch_add(end - begin, std::memory_order_acq_rel) + (end - begin) == n_) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    cv_.notify_all();
+                }
+            }
+            return ran;
+        }
+
+        bool exhausted() const { return next_.load(std::memory_order_relaxed) >= n_; }
 
+        const int64_t n_;
+        const int64_t grain_;
+        std::function<void(int64_t, int64_t)> fn_;
+        std::atomic<int64_t> next_;
+        std::atomic<int64_t> done_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::exception_ptr error_;
+    };
+
+    ThreadPool(size_t threads, bool pin_workers = false)
+        : deques_(threads), n_shared_(0), pending_(0), n_sleeping_(0), n_bulk_(0), stop_(false) {
+        std::vector<std::vector<int>> nodes = pin_workers ? numa_nodes() : std::vector<std::vector<int>>();
+        for(size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this, i] { work(i); });
+            if(!nodes.empty())
+                pin(workers_.back(), nodes[i % nodes.size()]);
+        }
+    }
 
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
@@ -49,41 +183,181 @@ public:
             );
 
         std::future<return_type> res = task->get_future();
+        // don't allow enqueueing after stopping the pool
+        if(stop_.load())
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        task_t* x = new task_t([task](){ (*task)(); });
+        if(current_.pool == this)
+            deques_[current_.index].push(x);
+        else {
+            std::lock_guard<std::mutex> lock(shared_mutex_);
+            shared_.push_back(x);
+            n_shared_++;
+        }
+        submitted();
+        return res;
+    }
+
+    // Runs `fn(begin, end)` over chunks of `grain` indices that cover [0, n)
+    // (n / (8 * workers) indices when `grain` is 0). The caller usually waits
+    // on the returned latch, which makes it run chunks too
+    std::shared_ptr<latch> parallel_for(int64_t n, std::function<void(int64_t, int64_t)> fn, int64_t grain = 0) {
+        if(grain <= 0)
+            grain = std::max<int64_t>(1, n / (8 * (int64_t)(workers_.size() + 1)));
+        auto ret = std::make_shared<latch>(n, grain, std::move(fn));
+        if(n <= grain || workers_.empty())
+            return ret;
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
+            std::lock_guard<std::mutex> lock(bulk_mutex_);
+            bulk_.push_back(ret);
+        }
+        n_bulk_++;
+        submitted();
+        return ret;
+    }
 
-            // don't allow enqueueing after stopping the pool
-            if(stop)
-                throw std::runtime_error("enqueue on stopped ThreadPool");
+    size_t size() const { return workers_.size(); }
 
-            tasks.emplace([task](){ (*task)(); });
+    ~ThreadPool() {
+        stop_.store(true);
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
         }
-        condition.notify_one();
-        return res;
+        sleep_cv_.notify_all();
+        for(std::thread &worker: workers_)
+            worker.join();
     }
 
+private:
+    struct worker_id {
+        ThreadPool* pool;
+        size_t index;
+    };
+    static inline thread_local worker_id current_ = {nullptr, 0};
 
-    ~ThreadPool() {
+    void submitted() {
+        pending_++;
+        if(n_sleeping_.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.notify_one();
+        }
+    }
+
+    // runs one task, or chunks of one bulk submission; returns false if there was nothing to do
+    bool run_one(size_t index) {
+        task_t* x = deques_[index].pop();
+        if(!x && n_shared_.load() > 0) {
+            std::lock_guard<std::mutex> lock(shared_mutex_);
+            if(!shared_.empty()) {
+                x = shared_.front();
+                shared_.pop_front();
+                n_shared_--;
+            }
+        }
+        if(!x && n_bulk_.load() > 0 && run_bulk())
+            return true;
+        for(size_t k = 1; !x && k < deques_.size(); k++)
+            x = deques_[(index + k) % deques_.size()].steal();
+        if(!x)
+            return false;
+        pending_--;
+        (*x)();
+        delete x;
+        return true;
+    }
+
+    bool run_bulk() {
+        std::shared_ptr<latch> job;
         {
-          std::unique_lock<std::mutex> lock(queue_mutex);
-          stop = true;
+            std::lock_guard<std::mutex> lock(bulk_mutex_);
+            if(bulk_.empty())
+                return false;
+            job = bulk_.front();
+        }
+        bool ran = job->run();
+        // the first worker to find the job exhausted retires it
+        std::lock_guard<std::mutex> lock(bulk_mutex_);
+        if(job->exhausted() && !bulk_.empty() && bulk_.front() == job) {
+            bulk_.pop_front();
+            n_bulk_--;
+            pending_--;
         }
-        condition.notify_all();
-        for(std::thread &worker: workers)
-          worker.join();
+        return ran;
     }
 
+    void work(size_t index) {
+        current_ = {this, index};
+        for(;;) {
+            if(run_one(index))
+                continue;
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            n_sleeping_++;
+            sleep_cv_.wait(lock, [this]{ return stop_.load() || pending_.load() > 0; });
+            n_sleeping_--;
+            if(stop_.load() && pending_.load() <= 0)
+                return;
+        }
+    }
 
-private:
-    // need to keep track of threads so we can join them
-    std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
-
-    // synchronization
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
+    // CPUs of each NUMA node, or of the whole machine if they are unknown
+    static std::vector<std::vector<int>> numa_nodes() {
+        std::vector<std::vector<int>> ret;
+#ifdef __linux__
+        for(int node = 0; ; node++) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if(!file || !std::getline(file, list))
+                break;
+            // e.g., "0-15,32-47"
+            std::vector<int> cpus;
+            size_t pos = 0;
+            while(pos < list.size()) {
+                size_t end = list.find(',', pos);
+                std::string range = list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+                size_t dash = range.find('-');
+                int first = std::stoi(range);
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for(int cpu = first; cpu <= last; cpu++)
+                    cpus.push_back(cpu);
+                if(end == std::string::npos)
+                    break;
+                pos = end + 1;
+            }
+            if(!cpus.empty())
+                ret.push_back(cpus);
+        }
+#endif
+        return ret;
+    }
+
+    static void pin(std::thread& thread, const std::vector<int>& cpus) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu: cpus)
+            if(cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#endif
+    }
+
+    std::vector< std::thread > workers_;
+    std::vector< work_deque > deques_;
+    // tasks enqueued by threads that are not workers
+    std::deque< task_t* > shared_;
+    std::mutex shared_mutex_;
+    std::atomic<int> n_shared_;
+    // `parallel_for` submissions with chunks left
+    std::deque< std::shared_ptr<latch> > bulk_;
+    std::mutex bulk_mutex_;
+
+    // synchronization: `pending_` counts queued tasks and bulk submissions
+    std::atomic<int64_t> pending_;
+    std::atomic<int> n_sleeping_;
+    std::atomic<int> n_bulk_;
+    std::atomic<bool> stop_;
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
 };
 
 
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef _TRITON_TOOLS_UNION_FIND_H_
+#define _TRITON_TOOLS_UNION_FIND_H_
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace triton {
+namespace tools{
+
+// Equivalence classes of nodes, over dense node ids given in insertion order
+template<class node_t, class hash_t = std::hash<node_t>>
+class union_find {
+public:
+  typedef std::vector<std::vector<node_t>> cmap_t;
+  typedef std::unordered_map<node_t, size_t, hash_t> nmap_t;
+
+private:
+  size_t find(size_t x) {
+    while(parent_[x] != x){
+      parent_[x] = parent_[parent_[x]];
+      x = parent_[x];
+    }
+    return x;
+  }
+
+public:
+  size_t add(const node_t &x) {
+    auto it = ids_.emplace(x, nodes_.size());
+    if(it.second){
+      nodes_.push_back(x);
+      parent_.push_back(nodes_.size() - 1);
+      rank_.push_back(0);
+    }
+    return it.first->second;
+  }
+
+  void unite(const node_t &x, const node_t &y) {
+    size_t rx = find(add(x));
+    size_t ry = find(add(y));
+    if(rx == ry)
+      return;
+    if(rank_[rx] < rank_[ry])
+      std::swap(rx, ry);
+    parent_[ry] = rx;
+    if(rank_[rx] == rank_[ry])
+      rank_[rx]++;
+  }
+
+  // components are numbered in the order their first node was added
+  void connected_components(cmap_t *cmap, nmap_t *nmap) {
+    if(cmap)
+      cmap->clear();
+    if(nmap){
+      nmap->clear();
+      nmap->reserve(nodes_.size());
+    }
+    std::vector<size_t> component(nodes_.size(), -1);
+    size_t n_components = 0;
+    for(size_t x = 0; x < nodes_.size(); x++){
+      size_t &id = component[find(x)];
+      if(id == size_t(-1)){
+        id = n_components++;
+        if(cmap)
+          cmap->emplace_back();
+      }
+      if(nmap)
+        nmap->emplace(nodes_[x], id);
+      if(cmap)
+        (*cmap)[id].push_back(nodes_[x]);
+    }
+  }
+
+  void clear() {
+    ids_.clear();
+    nodes_.clear();
+    parent_.clear();
+    rank_.clear();
+  }
+
+private:
+  nmap_t ids_;
+  std::vector<node_t> nodes_;
+  std::vector<size_t> parent_;
+  std::vector<unsigned> rank_;
+};
+
+}
+}
+
+#endif
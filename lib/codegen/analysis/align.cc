@@ -163,6 +163,32 @@ std::vector<align::cst_info> align::populate_is_constant_gep(ir::getelementptr_i
   return add_to_cache(x, result, is_constant_);
 }
 
+std::vector<align::cst_info> align::populate_is_constant_cmp(ir::cmp_inst* x) {
+  auto x_shapes = get_shapes(x);
+  ir::value* lhs_op = x->get_operand(0);
+  ir::value* rhs_op = x->get_operand(1);
+  auto lhs = populate_is_constant(lhs_op);
+  auto rhs = populate_is_constant(rhs_op);
+  auto lhs_max_contiguous = populate_max_contiguous(lhs_op);
+  auto rhs_max_contiguous = populate_max_contiguous(rhs_op);
+  auto lhs_multiple_of = populate_starting_multiple(lhs_op);
+  auto rhs_multiple_of = populate_starting_multiple(rhs_op);
+  std::vector<cst_info> result;
+  for(size_t d = 0; d < x_shapes.size(); d++) {
+    // e.g., [16, 17, ..., 31] < [24, 24, ..., 24] is constant in groups of 8:
+    // comparing a contiguous range that starts at a multiple of M with
+    // constants that are multiples of K gives groups of gcd(M, K)
+    cst_info ax = {std::min(lhs[d].num_cst, rhs[d].num_cst), 0};
+    if(rhs[d].num_cst % lhs_max_contiguous[d] == 0 && lhs_max_contiguous[d] > 1)
+      ax.num_cst = std::max<unsigned>(ax.num_cst, gcd(std::min(lhs_multiple_of[d], lhs_max_contiguous[d]), rhs_multiple_of[d]));
+    if(lhs[d].num_cst % rhs_max_contiguous[d] == 0 && rhs_max_contiguous[d] > 1)
+      ax.num_cst = std::max<unsigned>(ax.num_cst, gcd(std::min(rhs_multiple_of[d], rhs_max_contiguous[d]), lhs_multiple_of[d]));
+    ax.num_cst = std::max<unsigned>(ax.num_cst, 1);
+    result.push_back(ax);
+  }
+  return add_to_cache(x, result, is_constant_);
+}
+
 std::vector<align::cst_info> align::populate_is_constant_default(ir::value *v) {
   auto shapes = get_shapes(v);
   std::vector<cst_info> result(shapes.size(), {1, 0});
@@ -186,6 +212,8 @@ std::vector<align::cst_info> align::populate_is_constant(ir::value *v) {
     return populate_is_constant_binop(x);
   if(auto *x = dynamic_cast<ir::getelementptr_inst*>(v))
     return populate_is_constant_gep(x);
+  if(auto *x = dynamic_cast<ir::cmp_inst*>(v))
+    return populate_is_constant_cmp(x);
   return populate_is_constant_default(v);
 }
 
@@ -288,6 +316,13 @@ std::vector<unsigned> align::populate_max_contiguous_binop(ir::binary_operator*
       lvalue = gcd(rhs_max_contiguous[d], lhs_starting_multiple[d]);
       rvalue = gcd(lhs_max_contiguous[d], rhs_starting_multiple[d]);
       value = std::max(lvalue, rvalue);
+      // adding a value that is constant along `d` (e.g., gathered row offsets
+      // `idx[:, None] * stride`) keeps contiguous runs that fall within a
+      // constant group, whatever that value is; alignment is tracked separately
+      // by the starting multiple
+      value = std::max<unsigned>(value, gcd(lhs_max_contiguous[d], rhs_cst_info[d].num_cst));
+      if(x->get_op() == ir::binary_op_t::Add)
+        value = std::max<unsigned>(value, gcd(rhs_max_contiguous[d], lhs_cst_info[d].num_cst));
     }
     result.push_back(value);
   }
@@ -468,6 +503,12 @@ std::vector<unsigned> align::populate_starting_multiple_default(ir::value* v) {
       }
     }
   }
+  // constant tables are 16-byte aligned (see generator::declare_consts)
+  if(auto *x = dynamic_cast<ir::alloc_const*>(v)){
+    int nbits  = x->get_type()->get_pointer_element_ty()->get_primitive_size_in_bits();
+    int nbytes = std::max<int>(nbits / 8, 1);
+    return add_to_cache(x, {(unsigned)std::max<int>(16 / nbytes, 1)}, starting_multiple_);
+  }
   return add_to_cache(v, {1}, starting_multiple_);
 }
 
@@ -511,6 +552,13 @@ std::vector<unsigned> align::contiguous(ir::value* v) const {
   return max_contiguous_.at(v);
 }
 
+std::vector<unsigned> align::constancy(ir::value* v) const {
+  std::vector<unsigned> result;
+  for(const cst_info& x: is_constant_.at(v))
+    result.push_back(x.num_cst);
+  return result;
+}
+
 
 void align::populate(ir::value *v) {
   populate_is_constant(v);
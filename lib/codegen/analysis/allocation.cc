@@ -1,5 +1,8 @@
 #include <algorithm>
 #include <climits>
+#include <cstdint>
+#include <functional>
+#include <tuple>
 #include "triton/codegen/analysis/layout.h"
 #include "triton/codegen/analysis/allocation.h"
 #include "triton/codegen/analysis/liveness.h"
@@ -10,90 +13,115 @@ namespace codegen{
 namespace analysis{
 
 
-void allocation::run(ir::module &mod) {
-  using std::max;
-  using std::min;
-  typedef std::multimap<unsigned, segment> triples_map_type;
-
-  std::vector<shared_layout*> I;
-  for(auto x: liveness_->get())
-    I.push_back(x.first);
-  std::vector<shared_layout*> J = I;
+// Lowest offset at which `x` can be placed without overlapping the buffers
+// of `placed` that are live at the same time
+unsigned allocation::lowest_offset(shared_layout* x, const std::vector<shared_layout*>& placed,
+                                   const std::map<shared_layout*, unsigned>& offsets) {
+  segment live_x = liveness_->get(x);
+  std::vector<std::pair<unsigned, unsigned>> busy;
+  for(shared_layout* y: placed)
+    if(liveness_->get(y).intersect(live_x))
+      busy.push_back({offsets.at(y), offsets.at(y) + y->get_size()});
+  std::sort(busy.begin(), busy.end());
+  unsigned align = x->get_alignment();
+  unsigned ret = 0;
+  for(const auto& b: busy){
+    if(ret + x->get_size() <= b.first)
+      break;
+    ret = std::max<unsigned>(ret, (b.second + align - 1) / align * align);
+  }
+  return ret;
+}
 
-  triples_map_type H;
-  H.insert({0, segment{0, INT_MAX}});
+// Places buffers one at a time, in the given order, at the lowest free offset.
+// Returns the size of the resulting memory space
+size_t allocation::place(const std::vector<shared_layout*>& order, std::map<shared_layout*, unsigned>& offsets,
+                         size_t bound) {
+  size_t size = 0;
+  std::vector<shared_layout*> placed;
+  for(shared_layout* x: order){
+    offsets[x] = lowest_offset(x, placed, offsets);
+    size = std::max<size_t>(size, offsets[x] + x->get_size());
+    if(size >= bound)
+      return size;
+    placed.push_back(x);
+  }
+  return size;
+}
 
-  std::vector<shared_layout*> V;
-  std::map<shared_layout*, unsigned> starts;
-  while(!J.empty()){
-    auto h_it = H.begin();
-    unsigned w = h_it->first;
-    segment xh = h_it->second;
-    H.erase(h_it);
-    auto j_it = std::find_if(J.begin(), J.end(), [&](shared_layout* JJ){
-      segment xj = liveness_->get(JJ);
-      bool res = xj.intersect(xh);
-      for(auto val: H)
-        res = res && !val.second.intersect(xj);
-      return res;
-    });
-    if(j_it != J.end()){
-      unsigned size = (*j_it)->get_size();
-      segment xj = liveness_->get(*j_it);
-      starts[*j_it] = w;
-      H.insert({w + size, segment{max(xh.start, xj.start), min(xh.end, xj.end)}});
-      if(xh.start < xj.start)
-        H.insert({w, segment{xh.start, xj.end}});
-      if(xj.end < xh.end)
-        H.insert({w, segment{xj.start, xh.end}});
-      V.push_back(*j_it);
-      J.erase(j_it);
-    }
+// Any allocation is obtained by placing buffers by increasing offset, so
+// trying all orders is exact. Partial orders that exceed `best` are pruned
+void allocation::search(std::vector<shared_layout*>& order, size_t n_placed,
+                        std::map<shared_layout*, unsigned>& offsets, size_t size,
+                        size_t& best, std::map<shared_layout*, unsigned>& best_offsets) {
+  if(n_placed == order.size()){
+    best = size;
+    best_offsets = offsets;
+    return;
   }
-  // Build interference graph
-  std::map<shared_layout*, std::set<shared_layout*>> interferences;
-  for(shared_layout* x: V)
-  for(shared_layout* y: V){
-    if(x == y)
-      continue;
-    unsigned X0 = starts[x], Y0 = starts[y];
-    unsigned NX = x->get_size();
-    unsigned NY = y->get_size();
-    segment XS = {X0, X0 + NX};
-    segment YS = {Y0, Y0 + NY};
-    if(liveness_->get(x).intersect(liveness_->get(y))
-        && XS.intersect(YS))
-      interferences[x].insert(y);
+  std::vector<shared_layout*> placed(order.begin(), order.begin() + n_placed);
+  for(size_t i = n_placed; i < order.size() && best > max_live_size_; i++){
+    std::swap(order[n_placed], order[i]);
+    shared_layout* x = order[n_placed];
+    unsigned off = lowest_offset(x, placed, offsets);
+    size_t new_size = std::max<size_t>(size, off + x->get_size());
+    if(new_size < best){
+      offsets[x] = off;
+      search(order, n_placed + 1, offsets, new_size, best, best_offsets);
+    }
+    std::swap(order[n_placed], order[i]);
   }
-  // Initialize colors
-  std::map<shared_layout*, int> colors;
-  for(shared_layout* X: V)
-    colors[X] = (X==V[0])?0:-1;
-  // First-fit graph coloring
-  std::vector<bool> available(V.size());
+}
+
+void allocation::run(ir::module &mod) {
+  std::vector<shared_layout*> V;
+  for(auto x: liveness_->get())
+    V.push_back(x.first);
+  // lower bound: bytes live at the same time.
+  // Live ranges are intervals, so the peak is reached where one starts
+  max_live_size_ = 0;
   for(shared_layout* x: V){
-    // Non-neighboring colors are available
-    std::fill(available.begin(), available.end(), true);
-    for(shared_layout* Y: interferences[x]){
-      int color = colors[Y];
-      if(color >= 0)
-        available[color] = false;
+    slot_index t = liveness_->get(x).start;
+    size_t live = 0;
+    for(shared_layout* y: V)
+      if(liveness_->get(y).contains(t))
+        live += y->get_size();
+    max_live_size_ = std::max(max_live_size_, live);
+  }
+  // heuristic orders: largest, longest-lived, and earliest buffers first
+  auto size_of = [&](shared_layout* x) { return (long)x->get_size(); };
+  auto length_of = [&](shared_layout* x) { segment s = liveness_->get(x); return (long)s.end - (long)s.start; };
+  auto start_of = [&](shared_layout* x) { return (long)liveness_->get(x).start; };
+  std::vector<std::function<bool(shared_layout*, shared_layout*)>> orders = {
+    [&](shared_layout* a, shared_layout* b) { return std::make_tuple(size_of(a), length_of(a), -start_of(a))
+                                                   > std::make_tuple(size_of(b), length_of(b), -start_of(b)); },
+    [&](shared_layout* a, shared_layout* b) { return std::make_tuple(length_of(a), size_of(a))
+                                                   > std::make_tuple(length_of(b), size_of(b)); },
+    [&](shared_layout* a, shared_layout* b) { return std::make_tuple(start_of(a), -size_of(a))
+                                                   < std::make_tuple(start_of(b), -size_of(b)); },
+  };
+  std::map<shared_layout*, unsigned> best_offsets;
+  size_t best = SIZE_MAX;
+  for(const auto& cmp: orders){
+    std::vector<shared_layout*> order = V;
+    std::stable_sort(order.begin(), order.end(), cmp);
+    std::map<shared_layout*, unsigned> offsets;
+    size_t size = place(order, offsets, best);
+    if(size < best){
+      best = size;
+      best_offsets = offsets;
     }
-    // Assigns first available color
-    auto It = std::find(available.begin(), available.end(), true);
-    colors[x] = std::distance(available.begin(), It);
   }
-  // Finalize allocation
-  for(shared_layout* x: V){
-    unsigned Adj = 0;
-    for(shared_layout* y: interferences[x])
-      Adj = std::max<unsigned>(Adj, starts[y] + y->get_size());
-    offsets_[x] = starts[x] + colors[x] * Adj;
+  // bounded exact search for few buffers
+  if(V.size() <= max_exhaustive && best > max_live_size_){
+    std::map<shared_layout*, unsigned> offsets;
+    search(V, 0, offsets, 0, best, best_offsets);
   }
-  // Save maximum size of induced memory space
-  allocated_size_ = 0;
-  for(shared_layout* x: V)
-    allocated_size_ = std::max<size_t>(allocated_size_, starts[x] + x->get_size());
+  // Finalize allocation
+  offsets_.clear();
+  for(const auto& x: best_offsets)
+    offsets_[x.first] = x.second;
+  allocated_size_ = V.empty() ? 0 : best;
 }
 
 }
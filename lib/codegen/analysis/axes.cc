@@ -1,5 +1,7 @@
 #include "triton/codegen/analysis/axes.h"
 #include "triton/ir/utils.h"
+#include "triton/ir/function.h"
+#include "triton/ir/basic_block.h"
 #include "triton/ir/instructions.h"
 #include "triton/ir/type.h"
 #include <iostream>
@@ -20,7 +22,7 @@ void axes::update_graph_reduce(ir::instruction *i) {
   for(unsigned d = 0; d < in_shapes.size(); d++){
     if(d == axis)
       continue;
-    graph_.add_edge({i, current++}, {arg, d});
+    graph_.unite({i, current++}, {arg, d});
   }
 }
 
@@ -38,9 +40,9 @@ void axes::update_graph_reshape(ir::instruction *i) {
     bool same_shape = res_shapes[d] == op_shapes[current];
     // either add edge between axis or just add a node in the graph
     if(!is_skewed && same_shape)
-      graph_.add_edge({i, d}, {op, current++});
+      graph_.unite({i, d}, {op, current++});
     else
-      graph_.add_edge({i, d}, {i, d});
+      graph_.unite({i, d}, {i, d});
     // reshaping is skewed
     if(res_shapes[d] > 1 && !same_shape)
       is_skewed = true;
@@ -53,7 +55,7 @@ void axes::update_graph_trans(ir::instruction *i) {
   auto perm = trans->get_perm();
   // add edge between axis perm[d] and axis d
   for(unsigned d = 0; d < perm.size(); d++)
-    graph_.add_edge({i, perm[d]}, {op, d});
+    graph_.unite({i, perm[d]}, {op, d});
 }
 
 void axes::update_graph_broadcast(ir::instruction *i) {
@@ -65,7 +67,7 @@ void axes::update_graph_broadcast(ir::instruction *i) {
   // add edge between non-broadcast axes
   for(unsigned d = 0; d < shapes.size(); d ++)
     if(op_shapes[d] == shapes[d])
-      graph_.add_edge({i, d}, {op, d});
+      graph_.unite({i, d}, {op, d});
 }
 
 void axes::update_graph_dot(ir::instruction *i) {
@@ -76,7 +78,7 @@ void axes::update_graph_dot(ir::instruction *i) {
   ir::value *D = dot->get_operand(2);
   // add edges between result and accumulator
   for(unsigned d = 0; d < shapes.size(); d++)
-    graph_.add_edge({dot, d}, {D, d});
+    graph_.unite({dot, d}, {D, d});
 }
 
 void axes::update_graph_elementwise(ir::instruction *i, 
@@ -92,14 +94,17 @@ void axes::update_graph_elementwise(ir::instruction *i,
     // dimensions so we match the behaviour of the copy_to_shared instruction
     // which async masked load replaces.
     if (is_masked_load_async) {
-      graph_.add_edge({i, d}, {i, d});
+      graph_.unite({i, d}, {i, d});
     }
 
+    // scalar operands (e.g., those of the tile of a load) have no axes
     for(ir::value* opx: i->ops())
     for(ir::value* opy: i->ops()) {
+      if(!opx->get_type()->is_block_ty() || !opy->get_type()->is_block_ty())
+        continue;
       if(!is_masked_load_async && !i->get_type()->is_void_ty())
-        graph_.add_edge({i, d}, {opx, d});
-      graph_.add_edge({opx, d}, {opy, d});
+        graph_.unite({i, d}, {opx, d});
+      graph_.unite({opx, d}, {opy, d});
     }
   }
 }
@@ -109,12 +114,29 @@ void axes::update_graph_no_edge(ir::instruction *i) {
     return;
   auto rank = i->get_type()->get_tile_rank();
   for(unsigned d = 0; d < rank; d++)
-    graph_.add_edge({i, d}, {i, d});
+    graph_.unite({i, d}, {i, d});
+}
+
+// calls that are not inlined pass the values of tensors held by each thread:
+// arguments share the axes of their operands, and results those of returned values
+void axes::update_graph_call(ir::instruction *i) {
+  ir::function *fn = ((ir::call_inst*)i)->get_fn();
+  for(size_t k = 0; k < fn->args().size(); k++){
+    ir::value *op = i->get_operand(k);
+    for(unsigned d = 0; d < op->get_type()->get_tile_rank(); d++)
+      graph_.unite({op, d}, {fn->args()[k], d});
+  }
+  for(ir::basic_block *block: fn->blocks())
+  if(auto *ret = dynamic_cast<ir::return_inst*>(block->get_inst_list().back()))
+  if(ir::value *ret_val = ret->get_return_value())
+    for(unsigned d = 0; d < i->get_type()->get_tile_rank(); d++)
+      graph_.unite({i, d}, {ret_val, d});
 }
 
 void axes::update_graph(ir::instruction *i) {
   switch (i->get_id()) {
     case ir::INST_REDUCE:            return update_graph_reduce(i);
+    case ir::INST_SCAN:              return update_graph_elementwise(i);
     case ir::INST_RESHAPE:           return update_graph_reshape(i);
     case ir::INST_SPLAT:             return update_graph_no_edge(i);
     case ir::INST_CAT:               return update_graph_elementwise(i, true);
@@ -125,6 +147,7 @@ void axes::update_graph(ir::instruction *i) {
     case ir::INST_MASKED_LOAD_ASYNC: return update_graph_elementwise(i, true);
     case ir::INST_COPY_FROM_SHARED:  return update_graph_no_edge(i);
     case ir::INST_CVT_LAYOUT:        return update_graph_no_edge(i);
+    case ir::INST_CALL:              return update_graph_call(i);
     default:                         return update_graph_elementwise(i);
   }
   return;
@@ -151,9 +174,6 @@ void axes::run(ir::module &mod) {
   });
   // find connected components
   graph_.connected_components(nullptr, &axes_);
-  std::set<size_t> uniq;
-  for(auto x: axes_)
-    uniq.insert(x.second);
 }
 
 }
@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <numeric>
 #include <iostream>
+#include <set>
 #include "triton/codegen/analysis/axes.h"
 #include "triton/codegen/analysis/align.h"
 #include "triton/codegen/analysis/layout.h"
@@ -23,20 +24,52 @@ inline unsigned clamp(unsigned x, unsigned a, unsigned b) {
   return std::min(std::max(x, lo), hi);
 }
 
-inline bool is_hmma_c(ir::value *v, int sm){
+// returns the compute capability of NVIDIA targets, 0 otherwise
+inline int mma_sm(target *tgt){
+  return tgt->as_nvidia() ? tgt->as_nvidia()->sm() : 0;
+}
+
+// AMD matrix cores multiply fp16 tiles of 32x32x8 and accumulate in fp32, and
+// are issued by whole wavefronts, i.e., pairs of warps
+inline bool is_mfma_c(ir::dot_inst *x, size_t num_warps){
+  ir::type *a_ty = x->get_operand(0)->get_type();
+  ir::type *b_ty = x->get_operand(1)->get_type();
+  return num_warps % 2 == 0 && x->get_type()->get_scalar_ty()->is_fp32_ty() &&
+         a_ty->get_scalar_ty()->is_fp16_ty() && b_ty->get_scalar_ty()->is_fp16_ty() &&
+         a_ty->get_block_shapes()[0] >= 32 && a_ty->get_block_shapes()[1] >= 8 &&
+         b_ty->get_block_shapes()[1] >= 32;
+}
+
+inline bool is_hmma_c(ir::value *v, target *tgt, size_t num_warps){
   bool result = false;
-  if(auto *x = dynamic_cast<ir::dot_inst*>(v)){
-    ir::value *a = x->get_operand(0);
-    ir::type *a_ty = a->get_type();
-    ir::value *b = x->get_operand(1);
-    ir::type *b_ty = b->get_type();
-    result = (a_ty->get_scalar_ty()->is_fp16_ty() && b_ty->get_scalar_ty()->is_fp16_ty()) ||
-             (a_ty->get_scalar_ty()->is_bf16_ty() && b_ty->get_scalar_ty()->is_bf16_ty()) ||
-             (a_ty->get_scalar_ty()->is_fp32_ty() && b_ty->get_scalar_ty()->is_fp32_ty() && 
-              x->allow_tf32() && sm >= 80) ||
-             (a_ty->get_scalar_ty()->is_integer_ty(8) && b_ty->get_scalar_ty()->is_integer_ty(8) && 
-              sm >= 80);
-  }
+  auto *x = dynamic_cast<ir::dot_inst*>(v);
+  if(!x)
+    return result;
+  if(tgt->as_amd())
+    return tgt->as_amd()->has_mfma() && is_mfma_c(x, num_warps);
+  // tensor cores are only available on NVIDIA GPUs
+  int sm = mma_sm(tgt);
+  if(sm == 0)
+    return result;
+  ir::value *a = x->get_operand(0);
+  ir::type *a_ty = a->get_type();
+  ir::value *b = x->get_operand(1);
+  ir::type *b_ty = b->get_type();
+  // tiles smaller than an instruction, or older GPUs, go through FMAs (or dp4a for int8),
+  // so that skinny products do not waste most of each instruction. bf16 has no FMA path
+  bool fits = a_ty->get_block_shapes()[0] >= 16 && a_ty->get_block_shapes()[1] >= 16 &&
+              b_ty->get_block_shapes()[1] >= 16;
+  // sparse dots only have tensor core instructions (mma.sp), on sm >= 80
+  if(x->is_sparse())
+    return sm >= 80 && fits &&
+           ((a_ty->get_scalar_ty()->is_fp16_ty() && b_ty->get_scalar_ty()->is_fp16_ty()) ||
+            (a_ty->get_scalar_ty()->is_bf16_ty() && b_ty->get_scalar_ty()->is_bf16_ty()));
+  result = (a_ty->get_scalar_ty()->is_fp16_ty() && b_ty->get_scalar_ty()->is_fp16_ty() && sm >= 70 && fits) ||
+           (a_ty->get_scalar_ty()->is_bf16_ty() && b_ty->get_scalar_ty()->is_bf16_ty()) ||
+           (a_ty->get_scalar_ty()->is_fp32_ty() && b_ty->get_scalar_ty()->is_fp32_ty() && 
+            x->allow_tf32() && sm >= 80 && fits) ||
+           (a_ty->get_scalar_ty()->is_integer_ty(8) && b_ty->get_scalar_ty()->is_integer_ty(8) && 
+            sm >= 80 && fits);
   return result;
 }
 
@@ -64,6 +97,12 @@ static mma_layout::TensorCoreType get_mma_type(ir::value *v) {
         mma_type = mma_layout::FP32_TF32_TF32_FP32;
         return mma_type;
       }
+    } else if (c_ty->get_scalar_ty()->is_fp16_ty()) {
+      // fp16 accumulators, in half of the registers of fp32 ones
+      if (a_ty->get_scalar_ty()->is_fp16_ty() && b_ty->get_scalar_ty()->is_fp16_ty()) {
+        mma_type = mma_layout::FP16_FP16_FP16_FP16;
+        return mma_type;
+      }
     } else if (c_ty->get_scalar_ty()->is_integer_ty(32)) {
       // throw std::runtime_error("integer tensor cores are not yet supported");
       // // integer tensor cores
@@ -100,10 +139,10 @@ inline void extract_dot_use(ir::value *v, ir::value*& result, size_t n) {
   }
 }
 
-inline void extract_hmma_dot_use(ir::value *v, ir::value*& result, size_t n, int sm) {
+inline void extract_hmma_dot_use(ir::value *v, ir::value*& result, size_t n, target *tgt, size_t num_warps) {
   for(ir::user* u: v->get_users()){
     auto i = dynamic_cast<ir::dot_inst*>(u);
-    if(i && is_hmma_c(i, sm) && i->get_operand(n) == v) {
+    if(i && is_hmma_c(i, tgt, num_warps) && i->get_operand(n) == v) {
       result = i;
     }
   }
@@ -194,6 +233,34 @@ mma_layout::mma_layout(size_t num_warps,
                        shared_layout *layout_a, shared_layout *layout_b,
                        ir::value *dot): distributed_layout(MMA, axes, shape, values, align) {
   tensor_core_type_ = get_mma_type(dot);
+  is_mfma_ = tgt->as_amd() != nullptr;
+  if(is_mfma_){
+    // one 32x32 tile per wavefront, with wavefronts spread as for sm >= 80
+    spw_ = {32, 32, 1};
+    contig_per_thread_ = {1, 1};
+    order_ = {0, 1};
+    int num_waves = num_warps / 2;
+    wpt_ = {1, 1, 1};
+    bool changed = false;
+    do {
+      changed = false;
+      if (wpt_[0] * wpt_[1] >= num_waves)
+        break;
+      if (shape_[0] / spw_[0] / wpt_[0] >= shape_[1] / spw_[1] / wpt_[1]) {
+        if (wpt_[0] < (int)(shape_[0] / spw_[0])) {
+          wpt_[0] *= 2;
+          changed = true;
+        }
+      } else {
+        if (wpt_[1] < (int)(shape_[1] / spw_[1])) {
+          wpt_[1] *= 2;
+          changed = true;
+        }
+      }
+    } while (changed);
+    shape_per_cta_ = {spw_[0]*wpt_[0], spw_[1]*wpt_[1], 1};
+    return;
+  }
   /* fragments per warp */
   // try to make things as square as possible to maximize data re-use
   if(tgt->as_nvidia()->sm() < 80){
@@ -225,24 +292,24 @@ mma_layout::mma_layout(size_t num_warps,
     std::vector<int> wpt_nm1;
     do{
       wpt_nm1 = wpt_;
-      if(wpt_[0] * wpt_[1] * wpt_[2] < num_warps)
+      if(wpt_[0] * wpt_[1] * wpt_[2] < (int)num_warps)
         wpt_[0] = clamp(wpt_[0]*2, 1, shape_[0] / spw_[0]);
-      if(wpt_[0] * wpt_[1] * wpt_[2] < num_warps)
+      if(wpt_[0] * wpt_[1] * wpt_[2] < (int)num_warps)
         wpt_[1] = clamp(wpt_[1]*2, 1, shape_[1] / spw_[1]);
     }while(wpt_nm1 != wpt_);
   } else {
     bool changed = false;
     do {
       changed = false;
-      if (wpt_[0] * wpt_[1] * wpt_[2] >= num_warps)
+      if (wpt_[0] * wpt_[1] * wpt_[2] >= (int)num_warps)
         break;
       if (shape_[0] / spw_[0] / wpt_[0] >= shape_[1] / (spw_[1]*2) / wpt_[1]) {
-        if (wpt_[0] < shape_[0] / spw_[0]) {
+        if (wpt_[0] < (int)(shape_[0] / spw_[0])) {
           wpt_[0] *= 2;
           changed = true;
         }
       } else {
-        if (wpt_[1] < shape_[1] / (spw_[1]*2)) {
+        if (wpt_[1] < (int)(shape_[1] / (spw_[1]*2))) {
           wpt_[1] *= 2;
           changed = true;
         }
@@ -429,7 +496,8 @@ shared_layout::shared_layout(data_layout *arg,
                                  const std::vector<unsigned>& shape,
                                  const std::vector<ir::value *> &values,
                                  ir::type *ty,
-                                 analysis::align* align, target *tgt)
+                                 analysis::align* align, target *tgt,
+                                 size_t num_warps)
     : data_layout(SHARED, axes, shape, values, align), ty_(ty), tgt_(tgt) {
 
   size_ = 0;
@@ -456,8 +524,8 @@ shared_layout::shared_layout(data_layout *arg,
   for(ir::value* v: values){
     extract_dot_use(v, dot_a, 0);
     extract_dot_use(v, dot_b, 1);
-    extract_hmma_dot_use(v, hmma_dot_a, /*op*/0, tgt_->as_nvidia()->sm());
-    extract_hmma_dot_use(v, hmma_dot_b, /*op*/1, tgt_->as_nvidia()->sm());
+    extract_hmma_dot_use(v, hmma_dot_a, /*op*/0, tgt_, num_warps);
+    extract_hmma_dot_use(v, hmma_dot_b, /*op*/1, tgt_, num_warps);
   }
   hmma_dot_a_ = hmma_dot_a;
   hmma_dot_b_ = hmma_dot_b;
@@ -512,8 +580,8 @@ size_t shared_layout::get_per_stage_elements() const {
  * ---- Layouts Inference Pass ---- *
  * -------------------------------- */
 
-layouts::layouts(analysis::axes *axes, analysis::align *align, size_t num_warps, target* tgt)
-  : axes_(axes), align_(align), num_warps_(num_warps), tgt_(tgt){ }
+layouts::layouts(analysis::axes *axes, analysis::align *align, size_t num_warps, target* tgt, bool tma)
+  : axes_(axes), align_(align), num_warps_(num_warps), tgt_(tgt), use_tma_(tma){ }
 
 
 void layouts::connect(ir::value *x, ir::value *y) {
@@ -531,13 +599,24 @@ void layouts::connect(ir::value *x, ir::value *y) {
   std::set_intersection(sx_axes.begin(), sx_axes.end(),
                         sy_axes.begin(), sy_axes.end(),
                         std::inserter(common, common.begin()));
-  graph_.add_edge(x, x);
-  graph_.add_edge(y, y);
+  graph_.add(x);
+  graph_.add(y);
   if(!common.empty())
-    graph_.add_edge(x, y);
+    graph_.unite(x, y);
 }
 
 void layouts::make_graph(ir::instruction *i) {
+  // arguments and results of calls have the layouts of the values they are bound to
+  if(auto *call = dynamic_cast<ir::call_inst*>(i)){
+    ir::function *fn = call->get_fn();
+    for(size_t k = 0; k < fn->args().size(); k++)
+      connect(call->get_operand(k), fn->args()[k]);
+    for(ir::basic_block *block: fn->blocks())
+    if(auto *ret = dynamic_cast<ir::return_inst*>(block->get_inst_list().back()))
+    if(ir::value *ret_val = ret->get_return_value())
+      connect(call, ret_val);
+    return;
+  }
   for(ir::value* opx: i->ops())
   for(ir::value* opy: i->ops()){
     connect(i, opx);
@@ -549,7 +628,7 @@ void layouts::create(size_t id, const std::vector<ir::value*>& values) {
 //  if(layouts_.find(id) != layouts_.end())
 //    return;
   auto it_hmma_c = std::find_if(values.begin(), values.end(), 
-                               [&](ir::value* v){ return is_hmma_c(v, tgt_->as_nvidia()->sm()); });
+                               [&](ir::value* v){ return is_hmma_c(v, tgt_, num_warps_); });
   auto cmp = [](ir::value* x, ir::value *y) {
     std::pair<int, int> xx = {x->get_type()->get_tile_rank(), x->get_type()->get_tile_num_elements()};
     std::pair<int, int> yy = {y->get_type()->get_tile_rank(), y->get_type()->get_tile_num_elements()};
@@ -580,14 +659,267 @@ void layouts::create(size_t id, const std::vector<ir::value*>& values) {
     ir::instruction *cts = (ir::instruction*)*it_cts;
     ir::value *arg = cts->get_operand(0);
     create(groups_.at(arg), values_.at(groups_.at(arg)));
-    layouts_[id] = new shared_layout(get(arg), axes, shapes, values, largest->get_type()->get_scalar_ty(), align_, tgt_);
+    layouts_[id] = new shared_layout(get(arg), axes, shapes, values, largest->get_type()->get_scalar_ty(), align_, tgt_, num_warps_);
   }
   else{
     layouts_[id] = new scanline_layout(num_warps_, axes, shapes, values, align_, tgt_);
   }
 }
 
+int layouts::convert_pad(distributed_layout* in, distributed_layout* out, ir::type* ty) {
+  if(!shared_padding_)
+    return 0;
+  // stmatrix writes rows of 16 bytes, which shifting consecutive rows by 16 bytes
+  // keeps aligned and in distinct banks
+  bool stmatrix = stmatrix_convert(in, out, ty);
+  auto in_ord = in->to_mma() ? out->get_order() : in->get_order();
+  auto out_ord = out->to_mma() ? in_ord : out->get_order();
+  if(out_ord[0] == 0)
+    return stmatrix ? 8 : 1;
+  int in_vec = in->contig_per_thread(in_ord[0]);
+  int out_vec = out->contig_per_thread(out_ord[0]);
+  int pad = std::max(in_vec, out_vec);
+  // a quad of lanes holds consecutive elements of the same row of an accumulator;
+  // shifting consecutive rows by the width of a quad keeps its stores in distinct banks
+  if(in->to_mma())
+    pad = std::max(pad, 4*in_vec);
+  if(stmatrix)
+    pad = std::max(pad, 8);
+  return pad;
+}
+
+bool layouts::stmatrix_convert(distributed_layout* in, distributed_layout* out, ir::type* ty) {
+  mma_layout* mma = in->to_mma();
+  return mma_sm(tgt_) >= 90 && mma && !mma->is_mfma() && out->to_scanline() &&
+         ty->get_primitive_size_in_bits() == 16;
+}
+
+bool layouts::shuffle_within_warps(scanline_layout* in, scanline_layout* out,
+                                   std::vector<std::vector<int>>& in_regs, std::vector<bool>& same_lane) {
+  const std::vector<unsigned>& shape = out->get_shape();
+  size_t dim = shape.size();
+  if(num_warps_ == 0 || in->get_shape() != shape)
+    return false;
+  int num_threads = num_warps_ * 32;
+  int warp_size = tgt_->warp_size();
+  int in_threads = 1, out_threads = 1;
+  for(size_t k = 0; k < dim; k++){
+    // elements held by several threads are not supported
+    if(shape[k] % in->shape_per_cta(k) != 0 || shape[k] % out->shape_per_cta(k) != 0)
+      return false;
+    in_threads *= in->mts(k);
+    out_threads *= out->mts(k);
+  }
+  if(in_threads != num_threads || out_threads != num_threads)
+    return false;
+  std::vector<int> out_pt(dim), in_pt(dim);
+  int num_regs = 1;
+  for(size_t k = 0; k < dim; k++){
+    out_pt[k] = out->per_thread(k);
+    in_pt[k] = in->per_thread(k);
+    num_regs *= out_pt[k];
+  }
+  const std::vector<int>& in_ord = in->get_order();
+  const std::vector<int>& out_ord = out->get_order();
+  std::vector<std::set<int>> regs(num_regs);
+  same_lane.assign(num_regs, true);
+  std::vector<int> t(dim), x(dim);
+  for(int thread = 0; thread < num_threads; thread++){
+    // coordinates of the thread in `out`, as in generator::visit_layout_scanline
+    int rem = thread;
+    for(size_t k = 0; k < dim - 1; k++){
+      t[out_ord[k]] = rem % out->mts(out_ord[k]);
+      rem /= out->mts(out_ord[k]);
+    }
+    t[out_ord[dim - 1]] = rem;
+    for(int reg = 0; reg < num_regs; reg++){
+      int r = reg;
+      for(size_t k = 0; k < dim; k++){
+        int r_k = r % out_pt[k];
+        r /= out_pt[k];
+        int nts = out->nts(k);
+        x[k] = r_k / nts * out->shape_per_cta(k) + t[k] * nts + r_k % nts;
+      }
+      // owner of the element in `in`
+      int in_reg = 0, stride = 1;
+      for(size_t k = 0; k < dim; k++){
+        int nts = in->nts(k);
+        int per_cta = in->shape_per_cta(k);
+        in_reg += (x[k] / per_cta * nts + x[k] % nts) * stride;
+        stride *= in_pt[k];
+      }
+      int in_thread = 0;
+      for(int k = dim - 1; k >= 0; k--){
+        int d = in_ord[k];
+        in_thread = in_thread * in->mts(d) + x[d] % in->shape_per_cta(d) / in->nts(d);
+      }
+      if(in_thread / warp_size != thread / warp_size)
+        return false;
+      regs[reg].insert(in_reg);
+      if(regs[reg].size() > max_shuffles_per_reg)
+        return false;
+      same_lane[reg] = same_lane[reg] && in_thread == thread;
+    }
+  }
+  in_regs.clear();
+  for(const std::set<int>& r: regs)
+    in_regs.push_back(std::vector<int>(r.begin(), r.end()));
+  return true;
+}
+
+// whether `block` is part of a loop
+static bool in_loop(ir::basic_block* block) {
+  std::set<ir::basic_block*> seen;
+  std::vector<ir::basic_block*> stack = block->get_successors();
+  while(!stack.empty()){
+    ir::basic_block* curr = stack.back();
+    stack.pop_back();
+    if(curr == block)
+      return true;
+    if(!seen.insert(curr).second)
+      continue;
+    for(ir::basic_block* succ: curr->get_successors())
+      stack.push_back(succ);
+  }
+  return false;
+}
+
+// Whether the 2D block stored by `st` is staged in shared memory and written to global
+// memory by bulk copies of its rows (see generator::visit_staged_store_inst), so that the
+// program moves on while it is written: on sm_90, in loops of kernels, when its rows are
+// contiguous and 16-byte aligned in global memory and are masked as a whole. Bulk copies
+// are not ordered with other accesses, so the arguments the block is stored to must be
+// noalias, and only accessed by this store
+static bool is_staged_store(ir::store_inst* st, layouts* self, align* align, target* tgt) {
+  static const unsigned max_staged_bytes = 32768;
+  ir::value* ptr = st->get_pointer_operand();
+  ir::type* ty = st->get_value_operand()->get_type();
+  ir::function* fn = st->get_parent()->get_parent();
+  if(mma_sm(tgt) < 90 || !fn->get_is_kernel() || !ty->is_block_ty() || ty->get_tile_rank() != 2)
+    return false;
+  if(!in_loop(st->get_parent()))
+    return false;
+  auto shape = ty->get_block_shapes();
+  unsigned bytes = ty->get_scalar_ty()->get_primitive_size_in_bits() / 8;
+  int ld = self->get(ptr)->get_order(0);
+  if(bytes == 0 || shape[ld] * bytes % 16 != 0 || shape[0] * shape[1] * bytes > max_staged_bytes)
+    return false;
+  if(align->contiguous(ptr)[ld] < shape[ld] || align->get(ptr, ld) * bytes % 16 != 0)
+    return false;
+  if(auto* mx = dynamic_cast<ir::masked_store_inst*>(st))
+  if(align->constancy(mx->get_mask_operand())[ld] < shape[ld])
+    return false;
+  // bases of the pointer
+  std::set<ir::value*> bases = ir::get_bases(ptr);
+  for(ir::value* base: bases){
+    auto* arg = dynamic_cast<ir::argument*>(base);
+    if(!arg)
+      return false;
+    bool noalias = false;
+    for(const ir::attribute& attr: fn->get_attributes(arg))
+      noalias |= attr.get_kind() == ir::noalias;
+    if(!noalias)
+      return false;
+  }
+  for(ir::basic_block* block: fn->blocks())
+  for(ir::instruction* i: block->get_inst_list()){
+    bool accesses = dynamic_cast<ir::io_inst*>(i) || dynamic_cast<ir::call_inst*>(i) ||
+                    dynamic_cast<ir::launch_inst*>(i);
+    if(i == st || !accesses)
+      continue;
+    for(ir::value* op: i->ops()){
+      if(!op->get_type()->get_scalar_ty()->is_pointer_ty())
+        continue;
+      for(ir::value* base: ir::get_bases(op))
+        if(bases.count(base))
+          return false;
+    }
+  }
+  return true;
+}
+
+// whether `v` is a constant block of zeros or of undefined values
+static bool is_zero_or_undef(ir::value* v) {
+  if(auto* splat = dynamic_cast<ir::splat_inst*>(v))
+    v = splat->get_operand(0);
+  if(dynamic_cast<ir::undef_value*>(v))
+    return true;
+  if(auto* cst = dynamic_cast<ir::constant_int*>(v))
+    return cst->get_value() == 0;
+  if(auto* cst = dynamic_cast<ir::constant_fp*>(v))
+    return cst->get_value() == 0;
+  return false;
+}
+
+// Whether the argument `v` of `fn` is known to be a multiple of `n`
+static bool is_multiple_of(ir::value* v, ir::function* fn, unsigned n) {
+  if(auto* cst = dynamic_cast<ir::constant_int*>(v))
+    return cst->get_value() > 0 && cst->get_value() % n == 0;
+  auto* arg = dynamic_cast<ir::argument*>(v);
+  if(!arg || arg->get_parent() != fn)
+    return false;
+  for(const ir::attribute& attr: fn->get_attributes(arg))
+    if(attr.get_kind() == ir::multiple_of || attr.get_kind() == ir::aligned)
+      return attr.get_value() % n == 0;
+  return false;
+}
+
+// Whether the buffer of `layout` is written by copies of the Tensor Memory Accelerator
+// (see generator::visit_tma_load) rather than by cp.async: on sm_90, when it is only
+// written by asynchronous loads of the same 2D tile (see builder::create_tile_load) of
+// a 16-byte aligned argument of a kernel, whose rows are contiguous and start every
+// 16 bytes, and whose shape is that of arguments or constants, so that the runtime can
+// describe it before the launch. The buffer must have the rows of the tile, unpadded,
+// of at most 256 elements, and TMA copies ignore the mask of the load: its other values
+// must be zero, which TMA fills out-of-bounds elements with
+static bool is_tma_buffer(shared_layout* layout) {
+  ir::load_inst* tile = nullptr;
+  for(ir::value* v: layout->get_values()){
+    if(dynamic_cast<ir::phi_node*>(v))
+      continue;
+    auto* ld = dynamic_cast<ir::masked_load_async_inst*>(v);
+    if(!ld || ld->get_tile_rank() != 2 || !is_zero_or_undef(ld->get_false_value_operand()))
+      return false;
+    if(!tile)
+      tile = ld;
+    for(unsigned d = 0; d < 2; d++)
+      if(ld->get_tile_shape(d) != tile->get_tile_shape(d) || ld->get_tile_stride(d) != tile->get_tile_stride(d))
+        return false;
+    if(ld->get_tile_base() != tile->get_tile_base())
+      return false;
+  }
+  if(!tile)
+    return false;
+  ir::function* fn = tile->get_parent()->get_parent();
+  auto* base = dynamic_cast<ir::argument*>(tile->get_tile_base());
+  if(!fn->get_is_kernel() || !base || base->get_type()->get_pointer_address_space() != 1 ||
+     !is_multiple_of(base, fn, 16))
+    return false;
+  unsigned bytes = layout->get_type()->get_primitive_size_in_bits() / 8;
+  if(bytes != 1 && bytes != 2 && bytes != 4 && bytes != 8)
+    return false;
+  int inner = layout->get_order(0);
+  int outer = layout->get_order(1);
+  auto* unit = dynamic_cast<ir::constant_int*>(tile->get_tile_stride(inner));
+  if(!unit || unit->get_value() != 1)
+    return false;
+  ir::value* stride = tile->get_tile_stride(outer);
+  if(!is_multiple_of(stride, fn, 16 / std::__gcd(bytes, 16u)))
+    return false;
+  for(unsigned d = 0; d < 2; d++){
+    ir::value* shape = tile->get_tile_shape(d);
+    auto* arg = dynamic_cast<ir::argument*>(shape);
+    if(!dynamic_cast<ir::constant_int*>(shape) && !(arg && arg->get_parent() == fn))
+      return false;
+  }
+  const std::vector<unsigned>& shape = layout->get_shape();
+  if(shape[inner] * bytes % 16 != 0 || shape[inner] > 256 || shape[outer] > 256)
+    return false;
+  return layout->get_per_stage_elements() == shape[0] * shape[1];
+}
+
 void layouts::run(ir::module &mod) {
+  shared_padding_ = mod.get_shared_padding();
   // make graph
   graph_.clear();
   layouts_.clear();
@@ -602,8 +934,8 @@ void layouts::run(ir::module &mod) {
   graph_.connected_components(&values_, &groups_);
 
   // create layouts
-  for(const auto& x: values_)
-    create(x.first, x.second);
+  for(size_t id = 0; id < values_.size(); id++)
+    create(id, values_[id]);
 
   // create temporaries
   size_t id = values_.size();
@@ -618,13 +950,42 @@ void layouts::run(ir::module &mod) {
       auto shapes = arg->get_type()->get_block_shapes();
       scanline_layout *layout = get(arg)->to_scanline();
       shapes[axis] = layout->mts(axis);
+      // 1D reductions also stage one partial per lane of the first warp
+      if(shapes.size() == 1)
+        shapes[0] = std::max<unsigned>(shapes[0], std::min<unsigned>(tgt_->warp_size(), num_warps_ * 32));
+      // arg reductions stage an i32 index after each partial value
+      ir::type *ty = red->get_type()->get_scalar_ty();
+      if(red->is_arg()){
+        ir::type *arg_ty = arg->get_type()->get_scalar_ty();
+        ty = arg_ty->get_primitive_size_in_bits() <= 32 ? ir::type::get_int64_ty(ty->get_context())
+                                                        : ir::type::get_int128_ty(ty->get_context());
+      }
       // create layout
-      layouts_[id] = new shared_layout(layout, axes_->get(arg), shapes, {red}, red->get_type()->get_scalar_ty(), align_, tgt_);
+      layouts_[id] = new shared_layout(layout, axes_->get(arg), shapes, {red}, ty, align_, tgt_, num_warps_);
       tmp_[red] = id;
     }
+    if(auto *scan = dynamic_cast<ir::scan_inst*>(i)) {
+      id++;
+      ir::value *arg = scan->get_operand(0);
+      unsigned axis = scan->get_axis();
+      // one running total per thread along the axis
+      auto shapes = arg->get_type()->get_block_shapes();
+      scanline_layout *layout = get(arg)->to_scanline();
+      if(!layout)
+        throw std::runtime_error("scan operands must have a scanline layout");
+      shapes[axis] = layout->mts(axis);
+      layouts_[id] = new shared_layout(layout, axes_->get(arg), shapes, {scan}, scan->get_type()->get_scalar_ty(), align_, tgt_, num_warps_);
+      tmp_[scan] = id;
+    }
     if(auto *val = dynamic_cast<ir::cvt_layout_inst*>(i)){
       distributed_layout* out_layout = dynamic_cast<distributed_layout*>(get(val));
       distributed_layout* in_layout = dynamic_cast<distributed_layout*>(get(i->get_operand(0)));
+      // conversions within warps go through registers
+      std::vector<std::vector<int>> in_regs;
+      std::vector<bool> same_lane;
+      if(in_layout->to_scanline() && out_layout->to_scanline() &&
+         shuffle_within_warps(in_layout->to_scanline(), out_layout->to_scanline(), in_regs, same_lane))
+        return;
       id++;
       size_t dim = val->get_type()->get_tile_rank();
       ir::type::block_shapes_t shape(dim);
@@ -632,22 +993,50 @@ void layouts::run(ir::module &mod) {
         shape[k] = std::max(in_layout->shape_per_cta(k),
                             out_layout->shape_per_cta(k));
       }
-      auto in_ord = in_layout->get_order();
-      auto out_ord = out_layout->get_order();
-      int in_vec = in_layout->contig_per_thread(in_ord[0]);
-      int out_vec = out_layout->contig_per_thread(out_ord[0]);
-      int pad = std::max(in_vec, out_vec);
-      shape[out_ord[0]] += pad;
-      layouts_[id] = new shared_layout(out_layout, axes_->get(val), shape, {val}, val->get_type()->get_scalar_ty(), align_, tgt_);
+      auto out_ord = out_layout->to_mma() ? in_layout->get_order() : out_layout->get_order();
+      shape[out_ord[0]] += convert_pad(in_layout, out_layout, val->get_type()->get_scalar_ty());
+      layouts_[id] = new shared_layout(out_layout, axes_->get(val), shape, {val}, val->get_type()->get_scalar_ty(), align_, tgt_, num_warps_);
+      // stmatrix writes 16-byte aligned rows
+      if(stmatrix_convert(in_layout, out_layout, val->get_type()->get_scalar_ty()))
+        layouts_[id]->to_shared()->set_alignment(16);
       tmp_[val] = id;
     }
     if(auto *atom = dynamic_cast<ir::atomic_inst*>(i)){
       id++;
-      layouts_[id] = new shared_layout(nullptr, {}, {1}, {atom}, atom->get_type()->get_scalar_ty(), align_, tgt_);
+      layouts_[id] = new shared_layout(nullptr, {}, {1}, {atom}, atom->get_type()->get_scalar_ty(), align_, tgt_, num_warps_);
       tmp_[atom] = id;
     }
+    if(auto *st = dynamic_cast<ir::store_inst*>(i))
+    if(is_staged_store(st, this, align_, tgt_)){
+      id++;
+      ir::value *val = st->get_value_operand();
+      layouts_[id] = new shared_layout(get(val), axes_->get(val), val->get_type()->get_block_shapes(), {st},
+                                       val->get_type()->get_scalar_ty(), align_, tgt_, num_warps_);
+      // bulk copies read 16-byte aligned rows
+      layouts_[id]->to_shared()->set_alignment(16);
+      tmp_[st] = id;
+    }
   });
 
+  // buffers of TMA copies are aligned on their swizzling pattern, and the mbarrier
+  // of each of their stages counts the bytes that have landed
+  tma_.clear();
+  if(!use_tma_ || mma_sm(tgt_) < 90)
+    return;
+  for(size_t k = 0; k < values_.size(); k++){
+    shared_layout* layout = layouts_.at(k)->to_shared();
+    if(!layout || !is_tma_buffer(layout))
+      continue;
+    id++;
+    ir::type *ty = ir::type::get_int64_ty(layout->get_type()->get_context());
+    shared_layout* barriers = new shared_layout(nullptr, {}, {(unsigned)layout->get_num_stages()}, {}, ty,
+                                                align_, tgt_, num_warps_);
+    barriers->set_alignment(8);
+    layout->set_alignment(1024);
+    layouts_[id] = barriers;
+    tma_[layout] = barriers;
+  }
+
 }
 
 }
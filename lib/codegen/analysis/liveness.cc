@@ -1,8 +1,10 @@
 #include <climits>
+#include <set>
 #include <iostream>
 #include "triton/codegen/analysis/liveness.h"
 #include "triton/codegen/analysis/layout.h"
 #include "triton/ir/function.h"
+#include "triton/ir/instructions.h"
 #include "triton/ir/module.h"
 #include "triton/ir/utils.h"
 
@@ -16,7 +18,14 @@ void liveness::run(ir::module &mod) {
 
   // Assigns index to each instruction
   std::map<ir::value*, slot_index> indices;
+  // buffers of functions that are called rather than inlined may be used while
+  // any buffer of their callers is live
+  std::set<ir::value*> in_callee;
   for(ir::function *fn: mod.get_function_list()){
+    if(!fn->get_is_kernel())
+    for(ir::basic_block *block: fn->blocks())
+    for(ir::instruction *instr: block->get_inst_list())
+      in_callee.insert(instr);
     slot_index index = 0;
     for(ir::basic_block *block: fn->blocks())
     for(ir::instruction *instr: block->get_inst_list()){
@@ -47,8 +56,18 @@ void liveness::run(ir::module &mod) {
         end = std::max(end, indices.at(u));
     if(end == 0)
       end = start + 1;
+    // staged stores are read by bulk copies until the next one waits for them
+    for(ir::value *v: layout->get_values())
+      if(in_callee.count(v) || dynamic_cast<ir::store_inst*>(v)){
+        start = 0;
+        end = INT32_MAX;
+      }
     intervals_[layout] = segment{start, end};
   }
+  // mbarriers of TMA copies are initialized at the entry of the kernel and waited on
+  // until its exit
+  for(auto &x: layouts_->get_tma())
+    intervals_[x.second] = segment{0, INT32_MAX};
 
 
 
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include "triton/codegen/analysis/range.h"
+#include "triton/ir/utils.h"
+#include "triton/ir/module.h"
+#include "triton/ir/function.h"
+#include "triton/ir/basic_block.h"
+#include "triton/ir/constant.h"
+#include "triton/ir/instructions.h"
+#include "triton/ir/type.h"
+
+namespace triton {
+namespace codegen{
+namespace analysis{
+
+typedef range::interval interval;
+
+static unsigned width(ir::value* v) {
+  return v->get_type()->get_scalar_ty()->get_integer_bitwidth();
+}
+
+// whether `x` is representable by a signed integer of `w` bits
+static bool fits(const interval& x, unsigned w) {
+  if(w >= 64)
+    return true;
+  int64_t max = (int64_t(1) << (w - 1)) - 1;
+  return x.lo >= -max - 1 && x.hi <= max;
+}
+
+static bool is_cst(const interval& x) {
+  return x.lo == x.hi;
+}
+
+bool range::compute(ir::instruction* i, interval& ret) {
+  auto get_op = [&](unsigned n, interval& x) {
+    ir::value* op = i->get_operand(n);
+    if(!has(op))
+      return false;
+    x = get(op);
+    return true;
+  };
+  // sources
+  if(auto* x = dynamic_cast<ir::make_range*>(i)){
+    ret = {(int64_t)x->get_first()->get_value(), (int64_t)x->get_last()->get_value() - 1};
+    return true;
+  }
+  if(auto* x = dynamic_cast<ir::get_program_id_inst*>(i)){
+    ret = {0, x->get_axis() == 0 ? (int64_t(1) << 31) - 1 : 65535};
+    return true;
+  }
+  if(dynamic_cast<ir::get_num_programs_inst*>(i)){
+    ret = {1, (int64_t(1) << 31) - 1};
+    return true;
+  }
+  // shapes
+  if(dynamic_cast<ir::splat_inst*>(i) || dynamic_cast<ir::broadcast_inst*>(i) ||
+     dynamic_cast<ir::reshape_inst*>(i))
+    return get_op(0, ret);
+  // control flow
+  if(auto* x = dynamic_cast<ir::phi_node*>(i)){
+    for(unsigned n = 0; n < x->get_num_incoming(); n++){
+      interval inc;
+      if(!get_op(n, inc))
+        return false;
+      ret = n == 0 ? inc : interval{std::min(ret.lo, inc.lo), std::max(ret.hi, inc.hi)};
+    }
+    return x->get_num_incoming() > 0;
+  }
+  if(dynamic_cast<ir::select_inst*>(i)){
+    interval a, b;
+    if(!get_op(1, a) || !get_op(2, b))
+      return false;
+    ret = {std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+    return true;
+  }
+  // casts
+  if(auto* x = dynamic_cast<ir::cast_inst*>(i)){
+    interval a;
+    if(!get_op(0, a))
+      return false;
+    switch(x->get_op()){
+    case ir::cast_op_t::SExt:
+      // booleans are sign-extended to 0 or -1
+      ret = width(x->get_operand(0)) == 1 ? interval{-a.hi, -a.lo} : a;
+      return true;
+    case ir::cast_op_t::ZExt:
+      if(a.lo < 0)
+        return false;
+      ret = a;
+      return true;
+    case ir::cast_op_t::Trunc:
+      ret = a;
+      return fits(a, width(x));
+    default:
+      return false;
+    }
+  }
+  // arithmetic
+  auto* x = dynamic_cast<ir::binary_operator*>(i);
+  if(!x || !x->get_type()->get_scalar_ty()->is_integer_ty())
+    return false;
+  interval a, b;
+  if(!get_op(0, a) || !get_op(1, b))
+    return false;
+  // bounds of the intermediate results stay far away from int64 overflows
+  const int64_t max = int64_t(1) << 62;
+  auto bounded = [&](const interval& y) { return y.lo > -max && y.hi < max; };
+  if(!bounded(a) || !bounded(b))
+    return false;
+  // bitwise operations on constants, e.g., between decided comparisons
+  if(is_cst(a) && is_cst(b) && (x->get_op() == ir::binary_op_t::And || x->get_op() == ir::binary_op_t::Or ||
+                                x->get_op() == ir::binary_op_t::Xor)){
+    int64_t v = x->get_op() == ir::binary_op_t::And ? a.lo & b.lo :
+                x->get_op() == ir::binary_op_t::Or  ? a.lo | b.lo : a.lo ^ b.lo;
+    ret = {v, v};
+    return true;
+  }
+  switch(x->get_op()){
+  case ir::binary_op_t::Add:
+    ret = {a.lo + b.lo, a.hi + b.hi};
+    break;
+  case ir::binary_op_t::Sub:
+    ret = {a.lo - b.hi, a.hi - b.lo};
+    break;
+  case ir::binary_op_t::Mul: {
+    auto small = [](const interval& y) { return y.lo >= -(int64_t(1) << 31) && y.hi < (int64_t(1) << 31); };
+    if(!small(a) || !small(b))
+      return false;
+    int64_t p[4] = {a.lo*b.lo, a.lo*b.hi, a.hi*b.lo, a.hi*b.hi};
+    ret = {*std::min_element(p, p + 4), *std::max_element(p, p + 4)};
+    break;
+  }
+  case ir::binary_op_t::UDiv:
+  case ir::binary_op_t::SDiv:
+    if(!is_cst(b) || b.lo <= 0 || a.lo < 0)
+      return false;
+    ret = {a.lo / b.lo, a.hi / b.lo};
+    break;
+  case ir::binary_op_t::URem:
+  case ir::binary_op_t::SRem:
+    if(!is_cst(b) || b.lo <= 0 || a.lo < 0)
+      return false;
+    ret = a.hi < b.lo ? a : interval{0, b.lo - 1};
+    break;
+  case ir::binary_op_t::And:
+    if(a.lo >= 0 && b.lo >= 0)
+      ret = {0, std::min(a.hi, b.hi)};
+    else if(a.lo >= 0 || b.lo >= 0)
+      ret = {0, a.lo >= 0 ? a.hi : b.hi};
+    else
+      return false;
+    break;
+  case ir::binary_op_t::Shl:
+    if(!is_cst(b) || b.lo < 0 || b.lo >= 31 || a.lo < 0 || a.hi >= (int64_t(1) << 31))
+      return false;
+    ret = {a.lo << b.lo, a.hi << b.lo};
+    break;
+  case ir::binary_op_t::LShr:
+  case ir::binary_op_t::AShr:
+    if(!is_cst(b) || b.lo < 0 || b.lo >= 63 || a.lo < 0)
+      return false;
+    ret = {a.lo >> b.lo, a.hi >> b.lo};
+    break;
+  default:
+    return false;
+  }
+  return fits(ret, width(x));
+}
+
+void range::populate(ir::value* v) {
+  if(!v->get_type()->get_scalar_ty()->is_integer_ty())
+    return;
+  interval ret;
+  if(auto* x = dynamic_cast<ir::constant_int*>(v)){
+    unsigned w = width(x);
+    uint64_t value = x->get_value();
+    // booleans are 0 or 1, other integers are sign-extended
+    if(w == 1)
+      ranges_[v] = {(int64_t)(value & 1), (int64_t)(value & 1)};
+    else if(w < 64)
+      ranges_[v] = {(int64_t)(value << (64 - w)) >> (64 - w), (int64_t)(value << (64 - w)) >> (64 - w)};
+    else
+      ranges_[v] = {(int64_t)value, (int64_t)value};
+    return;
+  }
+  auto* i = dynamic_cast<ir::instruction*>(v);
+  if(i && compute(i, ret))
+    ranges_[v] = ret;
+}
+
+void range::run(ir::module &mod) {
+  ranges_.clear();
+  // operands are visited before their users, except through back edges
+  for(ir::function* fn: mod.get_function_list())
+  for(ir::basic_block* block: ir::cfg::reverse_post_order(fn))
+  for(ir::instruction* i: block->get_inst_list()){
+    for(ir::value* op: i->ops())
+      if(dynamic_cast<ir::constant_int*>(op))
+        populate(op);
+    populate(i);
+  }
+}
+
+}
+}
+}
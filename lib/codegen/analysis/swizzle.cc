@@ -1,13 +1,69 @@
 #include "triton/codegen/analysis/swizzle.h"
 #include "triton/codegen/analysis/layout.h"
 #include "triton/codegen/target.h"
+#include "triton/ir/instructions.h"
 #include "triton/ir/type.h"
+#include <algorithm>
 #include <iostream>
 
 namespace triton{
 namespace codegen{
 namespace analysis{
 
+// Shared tiles read by FMA dots along their strided dimension get one thread
+// per row, and rows whose pitch is a multiple of 128 bytes all start in the
+// same bank. XOR-ing the column with the row (`phase`) spreads them over the
+// banks, within the range of columns that every writer covers per CTA so that
+// writers can keep their constant offsets. Returns false when the tile is
+// read or written in any other way.
+bool swizzle::get_fmadot_swizzle(shared_layout* layout, int& per_phase, int& max_phase) {
+  auto ord = layout->get_order();
+  auto shapes = layout->get_shape();
+  if(!tgt_->is_gpu() || ord.size() != 2)
+    return false;
+  int dtsize = layout->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8;
+  if(dtsize < 4)
+    return false;
+  int ld = shapes[ord[0]];
+  int spc = ld;
+  bool strided = false;
+  for(ir::value* v: layout->get_values()){
+    // writers
+    ir::value* arg = nullptr;
+    if(auto* cts = dynamic_cast<ir::copy_to_shared_inst*>(v))
+      arg = cts->get_operand(0);
+    else if(auto* ld_async = dynamic_cast<ir::masked_load_async_inst*>(v))
+      arg = ld_async->get_pointer_operand();
+    else if(!dynamic_cast<ir::phi_node*>(v))
+      return false;
+    if(arg){
+      scanline_layout* in_layout = layouts_->get(arg)->to_scanline();
+      if(!in_layout || in_layout->get_order() != ord)
+        return false;
+      spc = std::min<int>(spc, in_layout->shape_per_cta(ord[0]));
+    }
+    // readers
+    for(ir::user* u: v->get_users()){
+      if(dynamic_cast<ir::phi_node*>(u) && layouts_->get(u) == layout)
+        continue;
+      auto* dot = dynamic_cast<ir::dot_inst*>(u);
+      if(!dot || !layouts_->get(dot)->to_scanline())
+        return false;
+      if(dot->get_operand(0) == v)
+        strided |= ord[0] == 1;
+      else if(dot->get_operand(1) == v)
+        strided |= ord[0] == 0;
+      else
+        return false;
+    }
+  }
+  if(!strided)
+    return false;
+  per_phase = std::max<int>(128 / (ld*dtsize), 1);
+  max_phase = std::min<int>({ld, spc, 128 / (dtsize*per_phase)});
+  return max_phase > 1;
+}
+
 
 void swizzle::run(ir::module &) {
     per_phase_.clear();
@@ -21,8 +77,13 @@ void swizzle::run(ir::module &) {
       ir::value* mma_dot_b = layout->hmma_dot_b();
 
       if(!mma_dot_a && !mma_dot_b){
-        per_phase_[layout] = 1;
-        max_phase_[layout] = 1;
+        int per_phase, max_phase;
+        if(!get_fmadot_swizzle(layout, per_phase, max_phase)){
+          per_phase = 1;
+          max_phase = 1;
+        }
+        per_phase_[layout] = per_phase;
+        max_phase_[layout] = max_phase;
         vec_[layout] = 1;
         continue;
       }
@@ -3,93 +3,310 @@
 #include "triton/codegen/analysis/allocation.h"
 #include "triton/codegen/analysis/axes.h"
 #include "triton/codegen/analysis/liveness.h"
+#include "triton/codegen/analysis/range.h"
 #include "triton/codegen/analysis/swizzle.h"
 #include "triton/codegen/selection/generator.h"
+#include "triton/codegen/transform/bounds.h"
 #include "triton/codegen/transform/coalesce.h"
+#include "triton/codegen/transform/cse.h"
 #include "triton/codegen/transform/cts.h"
 #include "triton/codegen/transform/dce.h"
 #include "triton/codegen/transform/disassociate.h"
 #include "triton/codegen/transform/membar.h"
+#include "triton/codegen/transform/persistent.h"
+#include "triton/codegen/transform/horizontal.h"
 #include "triton/codegen/transform/peephole.h"
 #include "triton/codegen/transform/pipeline.h"
 #include "triton/codegen/transform/prefetch.h"
 #include "triton/codegen/transform/inline.h"
+#include "triton/codegen/transform/licm.h"
+#include "triton/codegen/transform/reorder.h"
+#include "triton/codegen/transform/unroll.h"
+#include "triton/ir/basic_block.h"
 #include "triton/ir/function.h"
+#include "triton/ir/instructions.h"
 #include "triton/ir/module.h"
 #include "triton/ir/print.h"
+#include "triton/tools/sys/getenv.hpp"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Verifier.h"
+#include <chrono>
+#include <map>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 namespace triton {
 namespace codegen {
 
-// TODO:
-// There should be a proper pass manager there!
+static size_t num_instructions(ir::module& mod) {
+  size_t ret = 0;
+  for(ir::function* fn: mod.get_function_list())
+    for(ir::basic_block* block: fn->blocks())
+      ret += block->get_inst_list().size();
+  return ret;
+}
+
+static size_t peak_rss_kb() {
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+#endif
+}
+
+// Hash of the structure of the module: its instructions, their kind, type,
+// operands and metadata. Transformations that create, erase or rewire
+// instructions change it
+static uint64_t fingerprint(ir::module& mod) {
+  uint64_t ret = 0;
+  auto combine = [&](uint64_t v) { ret ^= v + 0x9e3779b97f4a7c15ULL + (ret << 6) + (ret >> 2); };
+  for(ir::function* fn: mod.get_function_list())
+  for(ir::basic_block* block: fn->blocks()){
+    combine((uint64_t)block);
+    for(ir::instruction* inst: block->get_inst_list()){
+      combine((uint64_t)inst);
+      combine(inst->get_id());
+      combine((uint64_t)inst->get_type());
+      for(ir::value* op: inst->ops())
+        combine((uint64_t)op);
+      for(const auto& md: inst->get_metadatas()){
+        combine(md.first);
+        combine(md.second);
+      }
+    }
+  }
+  return ret;
+}
+
+void pass_manager::run(ir::module& mod) {
+  // IR version each pass last ran on
+  std::map<const void*, size_t> last_run;
+  size_t version = 0;
+  uint64_t hash = fingerprint(mod);
+  num_skipped_ = 0;
+  for(entry& e: entries_){
+    bool skip = false;
+    if(e.kind != TRANSFORM){
+      auto it = last_run.find(e.id);
+      skip = it != last_run.end() && it->second == version;
+    }
+    pass_stats stats;
+    stats.name = e.name;
+    stats.skipped = skip;
+    stats.num_insts_before = num_instructions(mod);
+    auto start = std::chrono::steady_clock::now();
+    if(!skip)
+      e.run(mod);
+    auto end = std::chrono::steady_clock::now();
+    // analyses preserve the IR
+    if(!skip && e.kind != ANALYSIS){
+      uint64_t new_hash = fingerprint(mod);
+      version += new_hash != hash;
+      hash = new_hash;
+    }
+    if(e.id)
+      last_run[e.id] = version;
+    num_skipped_ += skip;
+    stats.time_us = std::chrono::duration<double, std::micro>(end - start).count();
+    stats.num_insts_after = num_instructions(mod);
+    stats.peak_rss_kb = collect_stats_ ? peak_rss_kb() : 0;
+    stats_.push_back(stats);
+  }
+}
+
+std::string pass_manager::report() const {
+  std::ostringstream os;
+  char line[256];
+  snprintf(line, sizeof(line), "%-16s %12s %10s %10s %14s\n", "pass", "time (us)", "insts in", "insts out", "peak rss (kB)");
+  os << line;
+  // passes that run several times are also totalled
+  std::map<std::string, std::pair<int, double>> totals;
+  double total = 0;
+  for(const pass_stats& s: stats_){
+    if(s.skipped)
+      snprintf(line, sizeof(line), "%-16s %12s\n", s.name.c_str(), "skipped");
+    else
+      snprintf(line, sizeof(line), "%-16s %12.1f %10zu %10zu %14zu\n", s.name.c_str(), s.time_us,
+               s.num_insts_before, s.num_insts_after, s.peak_rss_kb);
+    os << line;
+    if(s.skipped)
+      continue;
+    totals[s.name].first++;
+    totals[s.name].second += s.time_us;
+    total += s.time_us;
+  }
+  os << "\n";
+  snprintf(line, sizeof(line), "%-16s %6s %12s %8s\n", "pass", "runs", "time (us)", "%");
+  os << line;
+  for(const auto& it: totals){
+    snprintf(line, sizeof(line), "%-16s %6d %12.1f %8.1f\n", it.first.c_str(), it.second.first,
+             it.second.second, total > 0 ? 100*it.second.second/total : 0.);
+    os << line;
+  }
+  return os.str();
+}
+
+// Records of the summary of code generation (see `add_passes_to_emit_bin`):
+//   insts <pass> <n>                        instructions after each pass that ran
+//   cvt_layout <n>                          layout conversions left in the module
+//   barriers <n>                            barriers inserted by membar
+//   shared <offset> <bytes> <stages> <line> buffers placed in shared memory
+//   load|store <line> <vec> <bits>          vector widths of global accesses of blocks
+//   pipeline <pipelined> <candidates> <stages>
+static std::string codegen_report(ir::module& mod, const pass_manager& pm, analysis::layouts& layouts,
+                                  const analysis::allocation& allocation, const transform::membar& barriers,
+                                  const transform::pipeline& pipeline, const generator& isel) {
+  std::ostringstream os;
+  for(const pass_stats& s: pm.stats())
+    if(!s.skipped)
+      os << "insts " << s.name << " " << s.num_insts_after << "\n";
+  size_t num_cvt_layout = 0;
+  for(ir::function* fn: mod.get_function_list())
+  for(ir::basic_block* block: fn->blocks())
+  for(ir::instruction* i: block->get_inst_list())
+    num_cvt_layout += dynamic_cast<ir::cvt_layout_inst*>(i) != nullptr;
+  os << "cvt_layout " << num_cvt_layout << "\n";
+  os << "barriers " << barriers.num_inserted() << "\n";
+  for(const auto& it: layouts.get_all()){
+    analysis::shared_layout* layout = it.second->to_shared();
+    if(!layout || !allocation.has_offset(layout))
+      continue;
+    unsigned line = 0;
+    for(ir::value* v: layout->get_values())
+      if(auto* i = dynamic_cast<ir::instruction*>(v))
+        if((line = i->get_metadata(ir::metadata::line)))
+          break;
+    os << "shared " << allocation.offset(layout) << " " << layout->get_size() << " "
+       << layout->get_num_stages() << " " << line << "\n";
+  }
+  for(const io_vector& io: isel.io_vectors())
+    os << (io.is_store ? "store " : "load ") << io.line << " " << io.vec << " " << io.bits << "\n";
+  os << "pipeline " << pipeline.num_pipelined() << " " << pipeline.num_candidates() << " "
+     << pipeline.num_dot_stages() << "\n";
+  return os.str();
+}
+
 std::unique_ptr<llvm::Module> add_passes_to_emit_bin(ir::module &ir, llvm::LLVMContext& ctx, codegen::target* target,
-                                                     int cc, int num_warps, int num_stages, int& shared_static) {
+                                                     int cc, int num_warps, int num_stages, int& shared_static,
+                                                     std::string* stats, std::string* codegen_stats) {
   // generate llvm code
   std::string name = ir.get_function_list()[0]->get_name();
   std::unique_ptr<llvm::Module> llvm(new llvm::Module(name, ctx));
   // optimizations
   bool cts_use_async = target->as_nvidia() && target->as_nvidia()->sm() >= 80;
+  // producer warps issue the asynchronous copies of consumer warps
+  bool warp_specialize = cts_use_async && tools::getenv("TRITON_WARP_SPECIALIZE") == "1";
+  // tiles of kernel arguments are copied to shared memory by the Tensor Memory Accelerator
+  bool use_tma = cts_use_async && !warp_specialize && target->as_nvidia()->sm() >= 90 &&
+                 tools::getenv("TRITON_DISABLE_TMA") != "1";
+  // global loads may hint the size of an L2 prefetch (in bytes)
+  std::string l2_prefetch_str = tools::getenv("TRITON_L2_PREFETCH");
+  unsigned l2_prefetch = 0;
+  if(l2_prefetch_str == "64" || l2_prefetch_str == "128" || l2_prefetch_str == "256")
+    l2_prefetch = std::stoi(l2_prefetch_str);
+  // kernels may be instrumented to record timestamps of their warps (see `generator::trace_fn`)
+  std::string trace_str = tools::getenv("TRITON_TRACE");
+  unsigned trace_level = trace_str == "1" || trace_str == "2" || trace_str == "3" ? std::stoi(trace_str) : 0;
+  // source lines of the frontend are attached to the PTX, for profilers and `disasm`
+  bool line_info = tools::getenv("TRITON_DISABLE_LINE_INFO") != "1";
+  // device functions whose inlined copies would add more instructions than this are
+  // kept as calls, on GPUs and outside of warp specialization and tracing
+  std::string inline_threshold_str = tools::getenv("TRITON_INLINE_THRESHOLD");
+  unsigned inline_threshold = inline_threshold_str.empty() ? 1024 : std::stoul(inline_threshold_str);
+  // persistent and horizontal kernels remap the program ids of the functions they inline
+  bool outline = target->is_gpu() && !warp_specialize && !trace_level && !ir.get_persistent() && !ir.get_horizontal();
   // create passes
   codegen::analysis::align align;
-  codegen::transform::inliner inliner;
+  codegen::analysis::range range;
+  codegen::transform::inliner inliner(outline, inline_threshold);
+  codegen::transform::persistent persistent;
+  codegen::transform::horizontal horizontal;
   codegen::analysis::axes axes;
   codegen::transform::cts cts(cts_use_async);
-  codegen::transform::pipeline pipeline(cts_use_async, num_stages);
+  codegen::transform::pipeline pipeline(cts_use_async, num_stages, target->max_shared_memory());
   codegen::transform::disassociate disassociate;
-  codegen::analysis::layouts layouts(&axes, &align, num_warps, target);
+  codegen::analysis::layouts layouts(&axes, &align, num_warps, target, use_tma);
   codegen::analysis::liveness liveness(&layouts);
   codegen::analysis::swizzle swizzle(&layouts, target);
   codegen::analysis::allocation allocation(&liveness);
   codegen::transform::dce dce;
+  codegen::transform::cse cse;
+  codegen::transform::bounds bounds(&range);
+  codegen::transform::licm licm(num_warps);
+  codegen::transform::unroll unroll;
   codegen::transform::peephole peephole(target, &layouts);
   codegen::transform::coalesce coalesce(&align, &layouts);
-  codegen::transform::prefetch prefetch_s(target);
+  codegen::transform::prefetch prefetch_s(target, &layouts, num_warps);
+  codegen::transform::reorder reorder(&layouts, num_warps);
   codegen::transform::membar barriers(&liveness, &layouts, &allocation, &prefetch_s, target);
-  codegen::generator isel(&axes, &layouts, &align, &allocation, &swizzle, target, num_warps);
-  // run passes
-  inliner.run(ir);
-  dce.run(ir);
-  peephole.run(ir);
-  dce.run(ir);
-  pipeline.run(ir);
-  dce.run(ir);  
-  disassociate.run(ir);
-  dce.run(ir);
-  align.run(ir);
-  axes.run(ir);
-  layouts.run(ir);
-  peephole.run(ir);
-  dce.run(ir);
+  codegen::generator isel(&axes, &layouts, &align, &allocation, &swizzle, target, num_warps, warp_specialize, l2_prefetch,
+                          trace_level, line_info);
+  // schedule passes
+  pass_manager pm(stats != nullptr);
+  pm.add("inliner", inliner);
+  if (ir.get_persistent())
+    pm.add("persistent", persistent);
+  if (ir.get_horizontal())
+    pm.add("horizontal", horizontal);
+  pm.add("dce", dce, CLEANUP);
+  pm.add("cse", cse);
+  pm.add("range", range, ANALYSIS);
+  pm.add("bounds", bounds);
+  pm.add("dce", dce, CLEANUP);
+  pm.add("peephole", peephole);
+  pm.add("licm", licm);
+  pm.add("unroll", unroll);
+  pm.add("pipeline", pipeline);
+  pm.add("dce", dce, CLEANUP);
+  pm.add("disassociate", disassociate);
+  pm.add("dce", dce, CLEANUP);
+  pm.add("align", align, ANALYSIS);
+  pm.add("axes", axes, ANALYSIS);
+  pm.add("layouts", layouts, ANALYSIS);
+  pm.add("peephole", peephole);
+  if (target->is_gpu())
+    pm.add("cts", cts);
+  pm.add("align", align, ANALYSIS);
+  pm.add("axes", axes, ANALYSIS);
+  pm.add("layouts", layouts, ANALYSIS);
+  pm.add("coalesce", coalesce);
+  pm.add("dce", dce, CLEANUP);
+  pm.add("licm", licm);
+  pm.add("dce", dce, CLEANUP);
+  pm.add("align", align, ANALYSIS);
+  pm.add("dce", dce, CLEANUP);
   if (target->is_gpu())
-    cts.run(ir);
-  align.run(ir);
-  axes.run(ir);
-  layouts.run(ir);
-  coalesce.run(ir);
-  dce.run(ir);
-  align.run(ir);
-  dce.run(ir);
+    pm.add("cts", cts);
+  pm.add("dce", dce, CLEANUP);
+  pm.add("align", align, ANALYSIS);
+  pm.add("axes", axes, ANALYSIS);
+  pm.add("layouts", layouts, ANALYSIS);
+  pm.add("peephole", peephole);
+  pm.add("align", align, ANALYSIS);
+  pm.add("axes", axes, ANALYSIS);
+  pm.add("layouts", layouts, ANALYSIS);
   if (target->is_gpu())
-    cts.run(ir);
-  dce.run(ir);
-  align.run(ir);
-  axes.run(ir);
-  layouts.run(ir);
-  peephole.run(ir);
-  dce.run(ir);
-  align.run(ir);
-  axes.run(ir);
-  layouts.run(ir);
-  swizzle.run(ir);
-  liveness.run(ir);
-  allocation.run(ir);
-  prefetch_s.run(ir);
-  barriers.run(ir);
-  isel.visit(ir, *llvm);
+    pm.add("reorder", reorder);
+  pm.add("swizzle", swizzle, ANALYSIS);
+  pm.add("liveness", liveness, ANALYSIS);
+  pm.add("allocation", allocation, ANALYSIS);
+  // prefetched operands are loaded across loop iterations, which warp groups cannot split
+  if (!warp_specialize)
+    pm.add("prefetch", prefetch_s);
+  pm.add("membar", barriers);
+  pm.add("isel", [&](ir::module& mod) { isel.visit(mod, *llvm); });
+  pm.run(ir);
   shared_static = allocation.allocated_size();
+  if (stats)
+    *stats = pm.report() + "\nshared memory: " + std::to_string(allocation.allocated_size()) + " bytes allocated, "
+           + std::to_string(allocation.max_live_size()) + " bytes live at peak, "
+           + std::to_string(allocation.wasted_size()) + " bytes wasted\n";
+  if (codegen_stats)
+    *codegen_stats = codegen_report(ir, pm, layouts, allocation, barriers, pipeline, isel);
   return llvm;
 }
 
@@ -1,4 +1,5 @@
 ﻿#include <numeric>
+#include <cmath>
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
@@ -16,10 +17,13 @@
 #include "triton/ir/utils.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicsAMDGPU.h"
 #include "llvm/IR/IntrinsicsNVPTX.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Attributes.h"
+#include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/InlineAsm.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 namespace triton{
@@ -207,9 +211,17 @@ generator::generator(analysis::axes *a_axes,
                     analysis::allocation *alloc,
                     analysis::swizzle *swizzle,
                     target *tgt,
-                    unsigned num_warps)
+                    unsigned num_warps,
+                    bool warp_specialize,
+                    unsigned l2_prefetch,
+                    unsigned trace_level,
+                    bool line_info)
   : a_axes_(a_axes), layouts_(layouts), alignment_(alignment), alloc_(alloc), swizzle_(swizzle),
-    tgt_(tgt), num_warps_(num_warps), add(&builder_), mul(&builder_), gep(&builder_) {
+    tgt_(tgt), num_warps_(num_warps), warp_size_(std::min(tgt->warp_size(), num_warps*32)),
+    warp_specialize_(warp_specialize), is_consumer_(nullptr),
+    current_group_(ALL_WARPS), l2_prefetch_(l2_prefetch), trace_level_(tgt->as_nvidia() ? trace_level : 0),
+    trace_barriers_(0), line_info_(line_info && tgt->as_nvidia()), di_(nullptr),
+    add(&builder_), mul(&builder_), gep(&builder_) {
 
 }
 
@@ -275,7 +287,10 @@ void generator::visit_value(ir::value* v) {
     builder_->SetInsertPoint(&*current->getFirstNonPHI());
   // visit user
   if(auto *usr = dynamic_cast<ir::user*>(v)){
-    if(!dynamic_cast<ir::function*>(usr))
+    warp_group_t group = inst ? warp_group(inst) : ALL_WARPS;
+    if(group != ALL_WARPS)
+      visit_in_warp_group(inst, group);
+    else if(!dynamic_cast<ir::function*>(usr))
       usr->accept(this);
   }
   // revert insert point
@@ -296,18 +311,88 @@ void generator::visit_phi_node(ir::phi_node* x) {
  * \brief Code Generation for `call`
  */
 void generator::visit_call_inst(ir::call_inst* call) {
-  throw std::runtime_error("call not supported! Triton should be inlining everything.");
+  ir::function* fn = call->get_fn();
+  if(!tgt_->is_gpu())
+    throw std::runtime_error("call not supported! Triton should be inlining everything.");
+  // the values that each thread holds of block operands are passed in the order of their indices
+  std::vector<Value*> args;
+  for(ir::value* op: call->ops())
+  for(const indices_t& idx: idxs_.at(op))
+    args.push_back(vals_[op][idx]);
+  // the buffers of the callee are not tracked by the barriers of its callers
+  bool sync = uses_shared_memory(fn);
+  if(sync)
+    add_barrier();
+  Value* ret = builder_->CreateCall(fns_.at(fn), args);
+  if(sync)
+    add_barrier();
+  if(call->get_type()->is_block_ty()){
+    unsigned n = 0;
+    for(const indices_t& idx: idxs_.at(call))
+      vals_[call][idx] = extract_val(ret, n++);
+  }
+  else if(!call->get_type()->is_void_ty())
+    vals_[call][{}] = ret;
+}
+
+/**
+ * \brief Whether `fn`, or a function it calls, uses shared memory
+ */
+bool generator::uses_shared_memory(ir::function* fn) {
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction *i: block->get_inst_list()){
+    if(layouts_->has_tmp(i))
+      return true;
+    if(i->get_type()->is_block_ty() && layouts_->has(i) && layouts_->get(i)->to_shared())
+      return true;
+    if(auto *callee = dynamic_cast<ir::call_inst*>(i))
+    if(uses_shared_memory(callee->get_fn()))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * \brief Number of values that each thread holds of the arguments of an outlined
+ * function, and of the value it returns in `n_ret`. Its layouts are lowered in a
+ * scratch function, which is then removed
+ */
+std::vector<size_t> generator::count_thread_values(ir::function* fn, size_t& n_ret) {
+  Function* scratch = Function::Create(FunctionType::get(void_ty, false), Function::InternalLinkage, "", mod_);
+  builder_->SetInsertPoint(BasicBlock::Create(*ctx_, "", scratch));
+  for(auto x: layouts_->get_all())
+  if(!x.second->to_shared() && in_function(x.second, fn))
+    visit_layout(x.second);
+  auto count = [&](ir::value* v) {
+    if(v->get_type()->is_block_ty() && layouts_->get(v)->to_shared())
+      throw std::runtime_error("arguments and results of outlined functions must be distributed tensors");
+    init_idx(v);
+    return idxs_[v].size();
+  };
+  std::vector<size_t> ret;
+  for(ir::argument *arg: fn->args())
+    ret.push_back(count(arg));
+  n_ret = 0;
+  for(ir::basic_block *block: fn->blocks())
+  if(auto *rr = dynamic_cast<ir::return_inst*>(block->get_inst_list().back()))
+  if(ir::value *ret_val = rr->get_return_value())
+    n_ret = count(ret_val);
+  scratch->eraseFromParent();
+  idxs_.clear();
+  return ret;
 }
 
 void generator::visit_launch_inst(ir::launch_inst *launch) {
+  if(!tgt_->as_nvidia())
+    throw std::runtime_error("device-side kernel launches are only supported on NVIDIA GPUs");
   ir::function* fn = (ir::function*)launch->get_operand(0);
-  // forward-declare cudaGetParameterBufferV2
+  // declare cudaGetParameterBufferV2, once per module
   std::vector<Type*> get_param_arg_tys = {PointerType::get(builder_->getInt8Ty(), 0),
                                            ArrayType::get(builder_->getInt32Ty(), 3),
                                            ArrayType::get(builder_->getInt32Ty(), 3),
                                            builder_->getInt32Ty()};
   FunctionType* get_param_ty = FunctionType::get(PointerType::get(builder_->getInt8Ty(), 0), get_param_arg_tys, false);
-  Function* get_param_buffer = Function::Create(get_param_ty, Function::ExternalLinkage, "cudaGetParameterBufferV2", mod_);
+  FunctionCallee get_param_buffer = mod_->getOrInsertFunction("cudaGetParameterBufferV2", get_param_ty);
   AllocaInst* grid = builder_->CreateAlloca(get_param_arg_tys[1]);
   AllocaInst* block = builder_->CreateAlloca(get_param_arg_tys[2]);
   ConstantInt* _0 = builder_->getInt32(0);
@@ -316,7 +401,7 @@ void generator::visit_launch_inst(ir::launch_inst *launch) {
   // create basic block
   BasicBlock* launch_done_bb = BasicBlock::Create(builder_->getContext(), "launch_done", builder_->GetInsertBlock()->getParent());
   BasicBlock* launch_bb = BasicBlock::Create(builder_->getContext(), "launch", launch_done_bb->getParent(), launch_done_bb);
-  Value *tid = tgt_->get_local_id(mod_, *builder_, 0);
+  Value *tid = thread_id();
   Value *is_first_thread = builder_->CreateICmpEQ(tid, i32(0));
   builder_->CreateCondBr(is_first_thread, launch_bb, launch_done_bb);
   builder_->SetInsertPoint(launch_bb);
@@ -325,18 +410,21 @@ void generator::visit_launch_inst(ir::launch_inst *launch) {
   builder_->CreateStore(vals_[launch->get_grid()[0]][{}], builder_->CreateGEP(grid, {_0, _0}));
   builder_->CreateStore(vals_[launch->get_grid()[1]][{}], builder_->CreateGEP(grid, {_0, _1}));
   builder_->CreateStore(vals_[launch->get_grid()[2]][{}], builder_->CreateGEP(grid, {_0, _2}));
-  Value* num_warps = mul(builder_->getInt32(32), vals_[launch->get_num_warps()][{}]);
-  builder_->CreateStore(num_warps, builder_->CreateGEP(block, {_0, _0}));
+  // the callee is lowered in this module, for the same number of threads and with
+  // the same shared memory as the caller
+  Value* num_threads = i32(num_warps_*32*(warp_specialize_ ? 2 : 1));
+  builder_->CreateStore(num_threads, builder_->CreateGEP(block, {_0, _0}));
   builder_->CreateStore(builder_->getInt32(1), builder_->CreateGEP(block, {_0, _1}));
   builder_->CreateStore(builder_->getInt32(1), builder_->CreateGEP(block, {_0, _2}));
+  Value* shared_mem = i32(alloc_->allocated_size());
   Function* called_fn = fns_[fn];
   Value* callee = ConstantExpr::getCast(Instruction::BitCast, called_fn, get_param_arg_tys[0]);
-  Value* arg_ptr = builder_->CreateCall(get_param_buffer, {callee, builder_->CreateLoad(grid), builder_->CreateLoad(block), builder_->getInt32(0)});
-  // forwrd-declare cudaLaunchDeviceV2
+  Value* arg_ptr = builder_->CreateCall(get_param_buffer, {callee, builder_->CreateLoad(grid), builder_->CreateLoad(block), shared_mem});
+  // declare cudaLaunchDeviceV2, once per module
   std::vector<Type*> launch_device_arg_tys = {get_param_ty->getReturnType(), builder_->getInt64Ty()};
   FunctionType* launch_device_ty = FunctionType::get(builder_->getInt32Ty(), launch_device_arg_tys, false);
-  Function* launch_device = Function::Create(launch_device_ty, Function::ExternalLinkage, "cudaLaunchDeviceV2", mod_);
-  // TODO: add branch
+  FunctionCallee launch_device = mod_->getOrInsertFunction("cudaLaunchDeviceV2", launch_device_ty);
+  // the parameter buffer is null when the device runtime runs out of launch slots
   Value* do_not_launch = builder_->CreateICmpEQ(builder_->CreatePtrToInt(arg_ptr, builder_->getInt64Ty()),
                                                 builder_->getInt64(0));
   BasicBlock* launch2_bb = BasicBlock::Create(builder_->getContext(), "launch2", launch_done_bb->getParent(), launch_done_bb);
@@ -360,6 +448,7 @@ void generator::visit_launch_inst(ir::launch_inst *launch) {
     builder_->CreateStore(curr_arg, curr_arg_ptr);
     last_size = size;
   }
+  // on the default stream of the device runtime, so that launches of a program are ordered
   builder_->CreateCall(launch_device, {arg_ptr, builder_->getInt64(0)});
   builder_->CreateBr(launch_done_bb);
   // done
@@ -370,6 +459,22 @@ void generator::visit_launch_inst(ir::launch_inst *launch) {
 /**
  * \brief Code Generation for `binary_operator`
  */
+/**
+ * \brief Whether elementwise fp16 operations on `v` run on pairs of values held
+ * by the same thread, so that the backend selects the packed (f16x2) forms
+ */
+bool generator::is_f16x2(ir::value* v) {
+  return tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 53 &&
+         v->get_type()->is_block_ty() && v->get_type()->get_scalar_ty()->is_fp16_ty() &&
+         idxs_.at(v).size() % 2 == 0;
+}
+
+Value* generator::f16x2(ir::value* v, const indices_t& lo, const indices_t& hi) {
+  Value* ret = UndefValue::get(vec_ty(f16_ty, 2));
+  ret = insert_elt(ret, vals_[v][lo], i32(0));
+  return insert_elt(ret, vals_[v][hi], i32(1));
+}
+
 void generator::visit_binary_operator(ir::binary_operator*x) {
   using ll = llvm::Instruction::BinaryOps;
   auto cvt = [](ir::binary_op_t op){
@@ -397,16 +502,27 @@ void generator::visit_binary_operator(ir::binary_operator*x) {
     }
   };
 //  x->print(std::cout);
+  auto op = cvt(x->get_op());
+  if(is_f16x2(x) && (op == ll::FAdd || op == ll::FSub || op == ll::FMul)){
+    const std::vector<indices_t>& idxs = idxs_.at(x);
+    for(size_t i = 0; i < idxs.size(); i += 2){
+      Value *lhs = f16x2(x->get_operand(0), idxs[i], idxs[i + 1]);
+      Value *rhs = f16x2(x->get_operand(1), idxs[i], idxs[i + 1]);
+      Value *ret = bin_op(op, lhs, rhs);
+      vals_[x][idxs[i]] = extract_elt(ret, i32(0));
+      vals_[x][idxs[i + 1]] = extract_elt(ret, i32(1));
+    }
+    return;
+  }
   for(indices_t idx: idxs_.at(x)){
     Value *lhs = vals_[x->get_operand(0)][idx];
     Value *rhs = vals_[x->get_operand(1)][idx];
-    auto op = cvt(x->get_op());
     if(op == ll::Add)
        vals_[x][idx] = add(lhs, rhs);
      else if(op == ll::Mul)
        vals_[x][idx] = mul(lhs, rhs);
      else if(op == ll::FDiv && !x->get_fdiv_ieee_rounding() &&
-             x->get_type()->get_scalar_ty()->is_fp32_ty()){
+             x->get_type()->get_scalar_ty()->is_fp32_ty() && tgt_->is_gpu()){
        InlineAsm *ptx = InlineAsm::get(FunctionType::get(f32_ty, {f32_ty, f32_ty}, false),
                                       " div.full.f32 $0, $1, $2;", "=r,r,r", false);
        vals_[x][idx] = builder_->CreateCall(ptx, {lhs, rhs});
@@ -491,6 +607,17 @@ void generator::visit_fcmp_inst(ir::fcmp_inst* x) {
       default: throw std::runtime_error("unreachable switch");
     }
   };
+  if(is_f16x2(x->get_operand(0))){
+    const std::vector<indices_t>& idxs = idxs_.at(x);
+    for(size_t i = 0; i < idxs.size(); i += 2){
+      Value *lhs = f16x2(x->get_operand(0), idxs[i], idxs[i + 1]);
+      Value *rhs = f16x2(x->get_operand(1), idxs[i], idxs[i + 1]);
+      Value *ret = fcmp(cvt(x->get_pred()), lhs, rhs);
+      vals_[x][idxs[i]] = extract_elt(ret, i32(0));
+      vals_[x][idxs[i + 1]] = extract_elt(ret, i32(1));
+    }
+    return;
+  }
   for(indices_t idx: idxs_.at(x)){
     Value *lhs = vals_[x->get_operand(0)][idx];
     Value *rhs = vals_[x->get_operand(1)][idx];
@@ -500,10 +627,16 @@ void generator::visit_fcmp_inst(ir::fcmp_inst* x) {
 
 
 std::tuple<Value*, Value*, Value*, Value*> generator::fp32x4_to_fp8x4(Value *in0, Value *in1, Value *in2, Value *in3){
-  in0 = cast(llvm::Instruction::FPTrunc, in0, f16_ty);
-  in1 = cast(llvm::Instruction::FPTrunc, in1, f16_ty);
-  in2 = cast(llvm::Instruction::FPTrunc, in2, f16_ty);
-  in3 = cast(llvm::Instruction::FPTrunc, in3, f16_ty);
+  if(has_packed_cvt()){
+    std::tie(in0, in1) = fp32x2_to_half2(in0, in1, f16_ty);
+    std::tie(in2, in3) = fp32x2_to_half2(in2, in3, f16_ty);
+  }
+  else{
+    in0 = cast(llvm::Instruction::FPTrunc, in0, f16_ty);
+    in1 = cast(llvm::Instruction::FPTrunc, in1, f16_ty);
+    in2 = cast(llvm::Instruction::FPTrunc, in2, f16_ty);
+    in3 = cast(llvm::Instruction::FPTrunc, in3, f16_ty);
+  }
   Value *ret0, *ret1, *ret2, *ret3;
   std::tie(ret0, ret1, ret2, ret3) = fp16x4_to_fp8x4(in0, in1, in2, in3);
   return std::make_tuple(ret0, ret1, ret2, ret3);
@@ -596,7 +729,7 @@ std::tuple<Value*, Value*, Value*, Value*> generator::fp16x4_to_fp8x4(Value *in0
 }
 
 Value* generator::bf16_to_fp32(Value *in0){
-  if (tgt_->as_nvidia()->sm() >= 80) {
+  if (tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 80) {
     InlineAsm *ptx = InlineAsm::get(FunctionType::get(f32_ty, {bf16_ty}, false),
                                     "cvt.rn.f32.bf16 $0, $1;", "=r,h", false);
     return call(ptx, {in0});
@@ -609,7 +742,7 @@ Value* generator::bf16_to_fp32(Value *in0){
 }
 
 Value* generator::fp32_to_bf16(Value *in0){
-  if(tgt_->as_nvidia()->sm() >= 80){
+  if(tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 80){
     InlineAsm *ptx = InlineAsm::get(FunctionType::get(bf16_ty, {f32_ty}, false),
                                     "cvt.rn.bf16.f32 $0, $1;", "=h,r", false);
     return call(ptx, {in0});
@@ -617,6 +750,21 @@ Value* generator::fp32_to_bf16(Value *in0){
   return extract_elt(bit_cast(in0, vec_ty(i16_ty, 2)), (uint64_t)1);
 }
 
+// whether the target converts pairs of fp32 values to fp16 or bf16 at once (sm_80+)
+bool generator::has_packed_cvt(){
+  return tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 80;
+}
+
+// fp32 -> fp16 or bf16 (`half_ty`) of two values by one cvt.rn.{f16x2,bf16x2}.f32
+std::tuple<Value*, Value*> generator::fp32x2_to_half2(Value *in0, Value *in1, Type *half_ty){
+  std::string ty = half_ty->isHalfTy() ? "f16x2" : "bf16x2";
+  // the first source goes to the upper half
+  InlineAsm *ptx = InlineAsm::get(FunctionType::get(i32_ty, {f32_ty, f32_ty}, false),
+                                  "cvt.rn." + ty + ".f32 $0, $2, $1;", "=r,f,f", false);
+  Value *ret = bit_cast(call(ptx, {in0, in1}), vec_ty(half_ty, 2));
+  return std::make_tuple(extract_elt(ret, (uint64_t)0), extract_elt(ret, (uint64_t)1));
+}
+
 /**
  * \brief Code Generation for `cast`
  */
@@ -629,12 +777,8 @@ void generator::visit_cast_inst(ir::cast_inst* x) {
 
   // <> FP8
   if(ret_sca_ty->is_fp8_ty() || op_sca_ty->is_fp8_ty()){
-    // ensure that conversions can be vectorized
-    int ld = layouts_->get(x)->get_order(0);
-    int contiguous = layouts_->get(x)->to_scanline()->nts(ld);
-    if(contiguous % 4 != 0)
-        throw std::runtime_error("unsupported fp32 -> fp8 conversion");
-
+    if(!tgt_->is_gpu())
+      throw std::runtime_error("fp8 conversions are not supported on the host");
     // run the conversion
     auto cvt = [&](Value* a, Value* b, Value* c, Value* d){
       if(op_sca_ty->is_fp32_ty() && ret_sca_ty->is_fp8_ty())
@@ -647,14 +791,30 @@ void generator::visit_cast_inst(ir::cast_inst* x) {
         return fp8x4_to_fp32x4(a, b, c, d);
       throw std::runtime_error("unsupported conversion");
     };
-    for(size_t i = 0; i < x_idxs.size(); i+=4){
-        std::tie(vals_[x][x_idxs[i+0]],
-                 vals_[x][x_idxs[i+1]],
-                 vals_[x][x_idxs[i+2]],
-                 vals_[x][x_idxs[i+3]]) = cvt(vals_[op][op_idxs[i+0]],
-                                              vals_[op][op_idxs[i+1]],
-                                              vals_[op][op_idxs[i+2]],
-                                              vals_[op][op_idxs[i+3]]);
+    // values are converted by 4, whatever the layout: threads that hold
+    // fewer (e.g., pairs) pad them with zeros
+    Value *zero = Constant::getNullValue(vals_[op][op_idxs[0]]->getType());
+    for(size_t i = 0; i < x_idxs.size(); i += 4){
+      Value *in[4], *out[4];
+      for(size_t k = 0; k < 4; k++)
+        in[k] = i + k < x_idxs.size() ? vals_[op][op_idxs[i + k]] : zero;
+      std::tie(out[0], out[1], out[2], out[3]) = cvt(in[0], in[1], in[2], in[3]);
+      for(size_t k = 0; k < 4 && i + k < x_idxs.size(); k++)
+        vals_[x][x_idxs[i + k]] = out[k];
+    }
+    return;
+  }
+
+  // FP32 -> FP16/BF16, by pairs of values where the target can
+  if(op_sca_ty->is_fp32_ty() && (ret_sca_ty->is_fp16_ty() || ret_sca_ty->is_bf16_ty()) && has_packed_cvt()){
+    Type *half_ty = ret_sca_ty->is_fp16_ty() ? f16_ty : bf16_ty;
+    size_t i = 0;
+    for(; i + 1 < x_idxs.size(); i += 2)
+      std::tie(vals_[x][x_idxs[i]], vals_[x][x_idxs[i + 1]]) = fp32x2_to_half2(vals_[op][op_idxs[i]],
+                                                                               vals_[op][op_idxs[i + 1]], half_ty);
+    if(i < x_idxs.size()){
+      Value *arg = vals_[op][op_idxs[i]];
+      vals_[x][x_idxs[i]] = half_ty == f16_ty ? cast(llvm::Instruction::FPTrunc, arg, f16_ty) : fp32_to_bf16(arg);
     }
     return;
   }
@@ -709,7 +869,23 @@ void generator::visit_cast_inst(ir::cast_inst* x) {
  * \brief Code Generation for `return`
  */
 void generator::visit_return_inst(ir::return_inst* rr) {
+  if(trace_level_)
+    trace(1);
+  if(staged_stores_)
+    call(InlineAsm::get(FunctionType::get(void_ty, {}), "cp.async.bulk.wait_group 0;", "", true));
+  // TMA copies land before the program exits, even those of loads it never used
+  for(const auto& x: tma_issued_)
+    wait_tma(x.first, load(x.second));
   ir::value *ret_val = rr->get_return_value();
+  // blocks are returned as the values that each thread holds
+  if(ret_val && ret_val->get_type()->is_block_ty()){
+    Value *agg = UndefValue::get(builder_->getCurrentFunctionReturnType());
+    unsigned n = 0;
+    for(const indices_t& idx: idxs_.at(ret_val))
+      agg = builder_->CreateInsertValue(agg, vals_[ret_val][idx], n++);
+    ret(agg);
+    return;
+  }
   ret(ret_val ? vals_[ret_val][{}] : nullptr);
 }
 
@@ -731,6 +907,48 @@ void generator::visit_uncond_branch_inst(ir::uncond_branch_inst* br) {
   br(dest);
 }
 
+/**
+ * \brief Finds the noalias pointer arguments that `fn` does not write through.
+ * Writes through pointers of unknown origin may alias any argument
+ */
+void generator::init_read_only_args(ir::function* fn) {
+  read_only_args_.clear();
+  std::set<ir::value*> written;
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction *i: block->get_inst_list()){
+    std::vector<ir::value*> ptrs;
+    if(auto* x = dynamic_cast<ir::store_inst*>(i))
+      ptrs.push_back(x->get_pointer_operand());
+    else if(dynamic_cast<ir::atomic_inst*>(i))
+      ptrs.push_back(i->get_operand(0));
+    else if(dynamic_cast<ir::call_inst*>(i) || dynamic_cast<ir::launch_inst*>(i)){
+      for(ir::value* op: i->ops())
+        if(op->get_type()->get_scalar_ty()->is_pointer_ty())
+          ptrs.push_back(op);
+    }
+    for(ir::value* ptr: ptrs)
+    for(ir::value* base: ir::get_bases(ptr)){
+      if(!dynamic_cast<ir::argument*>(base))
+        return;
+      written.insert(base);
+    }
+  }
+  for(ir::argument* arg: fn->args()){
+    if(!arg->get_type()->is_pointer_ty() || written.count(arg))
+      continue;
+    for(const ir::attribute& attr: fn->get_attributes(arg))
+      if(attr.get_kind() == ir::noalias)
+        read_only_args_.insert(arg);
+  }
+}
+
+bool generator::is_read_only(ir::value* ptr) {
+  for(ir::value* base: ir::get_bases(ptr))
+    if(read_only_args_.find(base) == read_only_args_.end())
+      return false;
+  return true;
+}
+
 /**
  * \brief Code Generation for a (synchronous) `load`
  */
@@ -743,14 +961,29 @@ void generator::visit_load_inst(ir::load_inst* x){
   if(op->get_type()->is_block_ty()){
     auto   ord = ords_.at(op);
     size_t aln = alignment_->get(op, ord[0]);
+    // the elements of a vector share their predicate
+    if(mx){
+      size_t cst = alignment_->constancy(mx->get_mask_operand())[ord[0]];
+      aln = std::min<size_t>(aln, std::max<size_t>(cst, 1));
+    }
     auto layout = layouts_->get(x)->to_scanline();
     if(layout){
       size_t nts = layout->nts(ord[0]);
       vec = std::min(nts, aln);
     }
+    io_vectors_.push_back({false, x->get_metadata(ir::metadata::line), vec,
+                           x->get_type()->get_scalar_ty()->get_primitive_size_in_bits()});
   }
   // code generation
   auto idxs = idxs_.at(x);
+  // constant tables are read through the constant cache, which serves the threads
+  // of a warp that read the same address with a single broadcast
+  bool is_const = op->get_type()->get_scalar_ty()->get_pointer_address_space() == 4;
+  if(!tgt_->is_gpu() || (is_const && !tgt_->as_nvidia()))
+    return visit_host_load_inst(x, ty, vec);
+  int sm = tgt_->as_nvidia() ? tgt_->as_nvidia()->sm() : 0;
+  // data that the kernel never writes can be read through the non-coherent cache
+  bool is_nc = !is_const && !x->get_is_volatile() && is_read_only(op);
   for(size_t i = 0; i < idxs.size(); i += vec){
     indices_t idx = idxs[i];
     // pointer value
@@ -784,13 +1017,19 @@ void generator::visit_load_inst(ir::load_inst* x){
     std::ostringstream asm_oss;
     asm_oss << "@$" << n_words; // predicate
     asm_oss << " ld";
-    if(x->get_is_volatile())
-      asm_oss << ".volatile";
-    asm_oss << ".global";
-    if (x->get_cache_modifier() == ir::load_inst::CA) asm_oss << ".ca";
-    if (x->get_cache_modifier() == ir::load_inst::CG) asm_oss << ".cg";
-    if (x->get_eviction_policy() == ir::load_inst::EVICT_LAST) asm_oss << ".L1::evict_last";
-    if (x->get_eviction_policy() == ir::load_inst::EVICT_FIRST) asm_oss << ".L1::evict_first";
+    if(is_const)
+      asm_oss << ".const";
+    else {
+      if(x->get_is_volatile())
+        asm_oss << ".volatile";
+      asm_oss << ".global";
+      if (x->get_cache_modifier() == ir::load_inst::CA) asm_oss << ".ca";
+      if (x->get_cache_modifier() == ir::load_inst::CG) asm_oss << ".cg";
+      if (is_nc) asm_oss << ".nc";
+      if (x->get_eviction_policy() == ir::load_inst::EVICT_LAST) asm_oss << ".L1::evict_last";
+      if (x->get_eviction_policy() == ir::load_inst::EVICT_FIRST) asm_oss << ".L1::evict_first";
+      if (l2_prefetch_ && sm >= 75) asm_oss << ".L2::" << l2_prefetch_ << "B";
+    }
     if(n_words > 1)
       asm_oss << ".v" << n_words; // vector width
     asm_oss << ".b" << width; // word size
@@ -877,6 +1116,62 @@ void generator::visit_load_inst(ir::load_inst* x){
   }
 }
 
+/**
+ * \brief Code Generation for `load` on the host, which has no predicated loads
+ */
+void generator::visit_host_load_inst(ir::load_inst* x, Type* ty, size_t vec){
+  ir::value *op = x->get_pointer_operand();
+  ir::masked_load_inst *mx = dynamic_cast<ir::masked_load_inst*>(x);
+  size_t dtsize = ty->getPrimitiveSizeInBits() / 8;
+  auto idxs = idxs_.at(x);
+  for(size_t i = 0; i < idxs.size(); i += vec){
+    indices_t idx = idxs[i];
+    Type *v_ty = vec_ty(ty, vec);
+    Value *ptr = vals_[op][idx];
+    ptr = bit_cast(ptr, v_ty->getPointerTo(ptr->getType()->getPointerAddressSpace()));
+    auto do_load = [&]() -> Value* {
+      LoadInst *ret = load(ptr);
+      ret->setAlignment(llvm::Align(dtsize));
+      ret->setVolatile(x->get_is_volatile());
+      return ret;
+    };
+    Value *ret;
+    if(mx){
+      Value *other = UndefValue::get(v_ty);
+      for(size_t ii = 0; ii < vec; ii++)
+        other = insert_elt(other, vals_[mx->get_false_value_operand()][idxs[i + ii]], ii);
+      ret = host_if(vals_[mx->get_mask_operand()][idx], do_load, other);
+    }
+    else
+      ret = do_load();
+    for(size_t ii = 0; ii < vec; ii++)
+      vals_[x][idxs[i+ii]] = extract_elt(ret, ii);
+  }
+}
+
+/**
+ * \brief Executes `then` if `pred` holds. Returns its result, or `otherwise` when `pred`
+ * does not hold; for targets without predicated instructions.
+ */
+Value* generator::host_if(Value* pred, std::function<Value*()> then, Value* otherwise){
+  Instruction *no_op = intrinsic(Intrinsic::donothing, {}, {});
+  BasicBlock *head = no_op->getParent();
+  builder_->SetInsertPoint(head);
+  Instruction* dummy = builder_->CreateRet(nullptr);
+  Instruction *term = llvm::SplitBlockAndInsertIfThen(pred, no_op, false);
+  dummy->removeFromParent();
+  builder_->SetInsertPoint(term);
+  Value *ret = then();
+  BasicBlock *then_bb = builder_->GetInsertBlock();
+  builder_->SetInsertPoint(no_op);
+  if(!ret)
+    return nullptr;
+  PHINode *merged = phi(ret->getType(), 2);
+  merged->addIncoming(ret, then_bb);
+  merged->addIncoming(otherwise ? otherwise : UndefValue::get(ret->getType()), head);
+  return merged;
+}
+
 void generator::visit_unmasked_load_inst(ir::unmasked_load_inst* x) {
   visit_load_inst(x);
 }
@@ -889,6 +1184,8 @@ void generator::visit_masked_load_inst(ir::masked_load_inst* x) {
  */
 
 void generator::visit_store_inst(ir::store_inst * x){
+  if(layouts_->has_tmp(x))
+    return visit_staged_store_inst(x);
   ir::masked_store_inst *mx = dynamic_cast<ir::masked_store_inst*>(x);
   // operands
   ir::value *ptr_op = x->get_pointer_operand();
@@ -898,8 +1195,15 @@ void generator::visit_store_inst(ir::store_inst * x){
   if(val_op->get_type()->is_block_ty()){
     auto ord = ords_.at(x->get_pointer_operand());
     size_t aln = alignment_->get(ptr_op, ord[0]);
+    // the elements of a vector share their predicate
+    if(mx){
+      size_t cst = alignment_->constancy(mx->get_mask_operand())[ord[0]];
+      aln = std::min<size_t>(aln, std::max<size_t>(cst, 1));
+    }
     size_t nts = axes_.at(a_axes_->get(x->get_pointer_operand(), ord[0])).contiguous;
     vec  = std::min(nts, aln);
+    io_vectors_.push_back({true, x->get_metadata(ir::metadata::line), vec,
+                           val_op->get_type()->get_scalar_ty()->get_primitive_size_in_bits()});
   }
   auto idxs    = idxs_.at(val_op);
   Type *ty = cvt(val_op->get_type()->get_scalar_ty());
@@ -916,6 +1220,13 @@ void generator::visit_store_inst(ir::store_inst * x){
     Value* val = UndefValue::get(v_ty);
     for(size_t ii = 0; ii < vec; ii++)
       val = insert_elt(val, bit_cast(vals_.at(val_op)[idxs[i + ii]], ty), ii);
+    // host vectors are only as aligned as their elements
+    auto do_store = [&]() -> Value* {
+      StoreInst *st = store(val, ptr);
+      if(!tgt_->is_gpu())
+        st->setAlignment(llvm::Align(ty->getPrimitiveSizeInBits() / 8));
+      return nullptr;
+    };
     if(mx){
       Value *msk = vals_[mx->get_mask_operand()][idx];
       Instruction *no_op = intrinsic(Intrinsic::donothing, {}, {});
@@ -924,13 +1235,59 @@ void generator::visit_store_inst(ir::store_inst * x){
       Instruction *term = llvm::SplitBlockAndInsertIfThen(msk, no_op, false);
       dummy->removeFromParent();
       builder_->SetInsertPoint(term);
-      store(val, ptr);
+      do_store();
       builder_->SetInsertPoint(no_op);
     }
     else
-      store(val, ptr);
+      do_store();
+  }
+}
+/**
+ * \brief Code Generation for a `store` staged in shared memory (see analysis::layouts)
+ *
+ * The block is written to its buffer, then each row is copied to global memory with
+ * `cp.async.bulk` by the threads that hold its first element, so that the program moves
+ * on while it is written. The buffer is only written again once these copies are done,
+ * which the next store in a loop over tiles rarely waits for
+ */
+void generator::visit_staged_store_inst(ir::store_inst* x) {
+  ir::masked_store_inst *mx = dynamic_cast<ir::masked_store_inst*>(x);
+  ir::value *ptr_op = x->get_pointer_operand();
+  ir::value *val_op = x->get_value_operand();
+  analysis::data_layout* layout = layouts_->get(layouts_->tmp(x));
+  auto ord = ords_.at(ptr_op);
+  auto shape = val_op->get_type()->get_block_shapes();
+  Type *ty = cvt(val_op->get_type()->get_scalar_ty());
+  if (ty->isBFloatTy()) // llvm11-nvptx cannot select bf16 store
+    ty = f16_ty;
+  unsigned row_bytes = shape[ord[0]] * ty->getPrimitiveSizeInBits() / 8;
+  // rows are copied whole
+  io_vectors_.push_back({true, x->get_metadata(ir::metadata::line), shape[ord[0]],
+                         val_op->get_type()->get_scalar_ty()->get_primitive_size_in_bits()});
+  Value *base = bit_cast(shared_ptr_.at(layout), ptr_ty(ty, 3));
+  // copies of the previous store are done
+  call(InlineAsm::get(FunctionType::get(void_ty, {}), "cp.async.bulk.wait_group 0;", "", true));
+  add_barrier();
+  for(const indices_t& idx: idxs_.at(val_op)){
+    Value *off = add(mul(idx[ord[1]], i32(shape[ord[0]])), idx[ord[0]]);
+    store(bit_cast(vals_[val_op][idx], ty), gep(base, off));
+  }
+  // writes of threads to shared memory are visible to bulk copies
+  call(InlineAsm::get(FunctionType::get(void_ty, {}), "fence.proxy.async.shared::cta;", "", true));
+  add_barrier();
+  FunctionType *copy_ty = FunctionType::get(void_ty, {builder_->getInt1Ty(), ptr_ty(ty, 1), base->getType()}, false);
+  std::string copy_str = "@$0 cp.async.bulk.global.shared::cta.bulk_group [$1], [$2], " + std::to_string(row_bytes) + ";";
+  InlineAsm *copy = InlineAsm::get(copy_ty, copy_str, "b,l,r", true);
+  for(const indices_t& idx: idxs_.at(val_op)){
+    Value *pred = icmp_eq(idx[ord[0]], i32(0));
+    if(mx)
+      pred = and_(pred, vals_[mx->get_mask_operand()][idx]);
+    Value *row = gep(base, mul(idx[ord[1]], i32(shape[ord[0]])));
+    call(copy, {pred, bit_cast(vals_[ptr_op][idx], ptr_ty(ty, 1)), row});
   }
+  call(InlineAsm::get(FunctionType::get(void_ty, {}), "cp.async.bulk.commit_group;", "", true));
 }
+
 void generator::visit_unmasked_store_inst(ir::unmasked_store_inst* x) {
   visit_store_inst(x);
 }
@@ -1028,8 +1385,32 @@ void generator::visit_downcast_inst(ir::downcast_inst* x) {
  */
 void generator::visit_get_program_id_inst(ir::get_program_id_inst* pid) {
   Module *module = builder_->GetInsertBlock()->getModule();
-  Value *ret = tgt_->get_block_id(module, *builder_, pid->get_axis());
-  vals_[pid][{}] = ret;
+  unsigned axis = pid->get_axis();
+  if(!raster_ || axis > 1){
+    vals_[pid][{}] = tgt_->get_block_id(module, *builder_, axis);
+    return;
+  }
+  // grouped order (see tl.swizzle2d): programs run down groups of `size_g` rows
+  // of the (axis 1, axis 0) grid, column by column, so that a wave of `raster_`
+  // programs covers a block of about sqrt(raster_) x sqrt(raster_) tiles, or
+  // whole rows if there are few columns
+  Value *j = tgt_->get_block_id(module, *builder_, 0);
+  Value *i = tgt_->get_block_id(module, *builder_, 1);
+  Value *size_j = tgt_->get_num_blocks(module, *builder_, 0);
+  Value *size_i = tgt_->get_num_blocks(module, *builder_, 1);
+  unsigned side = std::max<unsigned>(1, std::sqrt(raster_));
+  Value *rows = udiv(add(i32(raster_), sub(size_j, i32(1))), size_j);
+  Value *size_g = select(icmp_ult(rows, i32(side)), i32(side), rows);
+  Value *ij = add(mul(i, size_j), j);
+  Value *size_gj = mul(size_g, size_j);
+  Value *off_i = mul(udiv(ij, size_gj), size_g);
+  // the last group may have fewer rows
+  Value *left = sub(size_i, off_i);
+  size_g = select(icmp_ult(left, size_g), left, size_g);
+  if(axis == 1)
+    vals_[pid][{}] = add(off_i, urem(ij, size_g));
+  else
+    vals_[pid][{}] = udiv(urem(ij, size_gj), size_g);
 }
 
 /**
@@ -1045,13 +1426,100 @@ void generator::visit_get_num_programs_inst(ir::get_num_programs_inst* np) {
  * \brief Code Generation for `exp`
  */
 void generator::visit_exp_inst(ir::exp_inst* x){
-  Constant *log2e = ConstantFP::get(f32_ty, 1.4426950408889634);
-  std::vector<llvm::Type*> tys = {f32_ty};
-  FunctionType *fn_ty = FunctionType::get(f32_ty, tys, false);
-  InlineAsm *ex2 = InlineAsm::get(fn_ty, "ex2.approx.f32 $0, $0;", "=f,0", false);
-  for(auto idx: idxs_.at(x)){
-    Value *ex2arg = fmul(vals_[x->get_operand(0)][idx], log2e);
-    vals_[x][idx] = call(ex2, std::vector<llvm::Value*>{ex2arg});
+  if(!tgt_->is_gpu())
+    return visit_host_math_inst(x, Intrinsic::exp);
+  // ex2.approx.f16x2 needs sm_75; fp16 values go through fp32 otherwise
+  bool packed = fast_math_ && tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 75;
+  visit_approx_inst(x, fast_math_ ? "ex2.approx.ftz" : "ex2.approx", packed ? "ex2.approx" : "", 1.4426950408889634);
+}
+
+/**
+ * \brief Code Generation for approximate PTX math instructions: `f32_op` (e.g., "ex2.approx")
+ * of the values of `x` scaled by `scale`. fp16 values are paired for `f16x2_op`, if not empty,
+ * and go through fp32 otherwise
+ */
+void generator::visit_approx_inst(ir::instruction* x, const std::string& f32_op, const std::string& f16x2_op,
+                                  float scale){
+  ir::value *op = x->get_operand(0);
+  bool is_f16 = x->get_type()->get_scalar_ty()->is_fp16_ty();
+  const std::vector<indices_t>& idxs = idxs_.at(x);
+  size_t i = 0;
+  if(is_f16 && !f16x2_op.empty()){
+    Type *f16x2_ty = vec_ty(f16_ty, 2);
+    InlineAsm *f16x2 = InlineAsm::get(FunctionType::get(i32_ty, {i32_ty}, false),
+                                      f16x2_op + ".f16x2 $0, $1;", "=r,r", false);
+    for(; i + 1 < idxs.size(); i += 2){
+      Value *pair = UndefValue::get(f16x2_ty);
+      pair = insert_elt(pair, vals_[op][idxs[i]], i32(0));
+      pair = insert_elt(pair, vals_[op][idxs[i + 1]], i32(1));
+      if(scale != 1)
+        pair = fmul(pair, splat(2, ConstantFP::get(f16_ty, scale)));
+      pair = bit_cast(call(f16x2, std::vector<llvm::Value*>{bit_cast(pair, i32_ty)}), f16x2_ty);
+      vals_[x][idxs[i]] = extract_elt(pair, i32(0));
+      vals_[x][idxs[i + 1]] = extract_elt(pair, i32(1));
+    }
+  }
+  InlineAsm *f32 = InlineAsm::get(FunctionType::get(f32_ty, {f32_ty}, false),
+                                  f32_op + ".f32 $0, $1;", "=f,f", false);
+  for(; i < idxs.size(); i++){
+    Value *arg = vals_[op][idxs[i]];
+    if(is_f16)
+      arg = cast(llvm::Instruction::FPExt, arg, f32_ty);
+    if(scale != 1)
+      arg = fmul(arg, ConstantFP::get(f32_ty, scale));
+    Value *ret = call(f32, std::vector<llvm::Value*>{arg});
+    vals_[x][idxs[i]] = is_f16 ? cast(llvm::Instruction::FPTrunc, ret, f16_ty) : ret;
+  }
+}
+
+/**
+ * \brief Code Generation for `math`: calls to libdevice on NVIDIA GPUs, ocml on AMD
+ * GPUs and libm on the host, which the driver links (see driver::llir_to_ptx)
+ */
+void generator::visit_math_inst(ir::math_inst* x){
+  const std::string& fn = x->get_fn();
+  ir::type *ty = x->get_type()->get_scalar_ty();
+  bool is_f16 = ty->is_fp16_ty();
+  bool is_f64 = ty->is_fp64_ty();
+  nvidia_cu_target *nvidia = tgt_->as_nvidia();
+  // fast math: the approximate instructions of the GPU
+  if(nvidia && fast_math_ && !is_f64){
+    if(fn == "tanh" && nvidia->sm() >= 75)
+      return visit_approx_inst(x, "tanh.approx", "tanh.approx", 1);
+    if(fn == "rsqrt")
+      return visit_approx_inst(x, "rsqrt.approx.ftz", "", 1);
+  }
+  if(!tgt_->is_gpu() && fn == "rsqrt"){
+    for(indices_t idx: idxs_.at(x)){
+      Value *arg = vals_[x->get_operand(0)][idx];
+      Value *root = intrinsic(Intrinsic::sqrt, {arg->getType()}, {arg});
+      vals_[x][idx] = builder_->CreateFDiv(ConstantFP::get(arg->getType(), 1.), root);
+    }
+    return;
+  }
+  // fp16 values go through the fp32 functions
+  std::string name;
+  if(nvidia)
+    name = (fast_math_ && fn == "pow" && !is_f64) ? "__nv_fast_powf" : "__nv_" + fn + (is_f64 ? "" : "f");
+  else if(tgt_->as_amd())
+    name = "__ocml_" + fn + (is_f64 ? "_f64" : "_f32");
+  else
+    name = fn + (is_f64 ? "" : "f");
+  Type *arg_ty = is_f64 ? builder_->getDoubleTy() : f32_ty;
+  std::vector<Type*> arg_tys(x->get_num_operands(), arg_ty);
+  FunctionCallee callee = mod_->getOrInsertFunction(name, FunctionType::get(arg_ty, arg_tys, false));
+  if(Function *f = dyn_cast<Function>(callee.getCallee())){
+    f->setDoesNotAccessMemory();
+    f->setDoesNotThrow();
+  }
+  for(indices_t idx: idxs_.at(x)){
+    std::vector<Value*> args;
+    for(ir::value *op: x->ops()){
+      Value *arg = vals_[op][idx];
+      args.push_back(is_f16 ? cast(llvm::Instruction::FPExt, arg, f32_ty) : arg);
+    }
+    Value *ret = call(callee, args);
+    vals_[x][idx] = is_f16 ? cast(llvm::Instruction::FPTrunc, ret, f16_ty) : ret;
   }
 }
 
@@ -1059,9 +1527,12 @@ void generator::visit_exp_inst(ir::exp_inst* x){
  * \brief Code Generation for `cos`
  */
 void generator::visit_cos_inst(ir::cos_inst* x){
+  if(!tgt_->is_gpu())
+    return visit_host_math_inst(x, Intrinsic::cos);
   std::vector<llvm::Type*> tys = {f32_ty};
   FunctionType *fn_ty = FunctionType::get(f32_ty, tys, false);
-  InlineAsm *cos = InlineAsm::get(fn_ty, "cos.approx.f32 $0, $0;", "=f,0", false);
+  InlineAsm *cos = InlineAsm::get(fn_ty, fast_math_ ? "cos.approx.ftz.f32 $0, $0;" : "cos.approx.f32 $0, $0;",
+                                  "=f,0", false);
   for(auto idx: idxs_.at(x)){
     vals_[x][idx] = call(cos, std::vector<llvm::Value*>{vals_[x->get_operand(0)][idx]});
   }
@@ -1071,6 +1542,15 @@ void generator::visit_cos_inst(ir::cos_inst* x){
  * \brief Code Generation for `umulhi`
  */
 void generator::visit_umulhi_inst(ir::umulhi_inst* x){
+  if(!tgt_->is_gpu()){
+    Type *i64_ty = builder_->getInt64Ty();
+    for(auto idx: idxs_.at(x)){
+      Value* lhs = builder_->CreateZExt(vals_[x->get_operand(0)][idx], i64_ty);
+      Value* rhs = builder_->CreateZExt(vals_[x->get_operand(1)][idx], i64_ty);
+      vals_[x][idx] = builder_->CreateTrunc(lshr(mul(lhs, rhs), 32), i32_ty);
+    }
+    return;
+  }
   std::vector<llvm::Type*> tys = {i32_ty, i32_ty};
   FunctionType *fn_ty = FunctionType::get(i32_ty, tys, false);
   InlineAsm *umulhi = InlineAsm::get(fn_ty, "mul.hi.u32 $0, $1, $2;", "=r,r,r", false);
@@ -1081,26 +1561,84 @@ void generator::visit_umulhi_inst(ir::umulhi_inst* x){
   }
  }
 
+/**
+ * \brief Code Generation for `philox`
+ */
+void generator::visit_philox_inst(ir::philox_inst* x){
+  ir::value *offset = x->get_operand(0);
+  ir::value *k0 = x->get_operand(1);
+  ir::value *k1 = x->get_operand(2);
+  Type *i64_ty = builder_->getInt64Ty();
+  // 32x32->64-bit products, selected as mul.wide.u32 (or mul.lo/mul.hi pairs)
+  auto mul_wide = [&](uint32_t a, Value *b, Value *&lo, Value *&hi) {
+    Value *prod = mul(builder_->getInt64(a), builder_->CreateZExt(b, i64_ty));
+    lo = builder_->CreateTrunc(prod, i32_ty);
+    hi = builder_->CreateTrunc(lshr(prod, 32), i32_ty);
+  };
+  auto &words = philox_words_[std::make_tuple(x->get_parent(), offset, k0, k1, x->get_n_rounds())];
+  for(indices_t idx: idxs_.at(x)){
+    auto it = words.find(idx);
+    if(it == words.end()){
+      std::vector<Value*> c = {vals_[offset][idx], i32(0), i32(0), i32(0)};
+      Value *key0 = vals_[k0][idx];
+      Value *key1 = vals_[k1][idx];
+      for(unsigned r = 0; r < x->get_n_rounds(); r++){
+        Value *lo0, *hi0, *lo1, *hi1;
+        mul_wide(0xD2511F53, c[0], lo0, hi0);
+        mul_wide(0xCD9E8D57, c[2], lo1, hi1);
+        c = {xor_(xor_(hi1, c[1]), key0), lo1, xor_(xor_(hi0, c[3]), key1), lo0};
+        key0 = add(key0, i32(0x9E3779B9));
+        key1 = add(key1, i32(0xBB67AE85));
+      }
+      it = words.insert({idx, c}).first;
+    }
+    Value *word = it->second[x->get_word()];
+    // as `uint32_to_uniform_float`: the int32 is folded onto [0, 2^31) and scaled
+    if(x->get_to_float()){
+      Value *is_neg = builder_->CreateICmpSLT(word, i32(0));
+      word = select(is_neg, xor_(word, i32(-1)), word);
+      word = fmul(builder_->CreateSIToFP(word, f32_ty), ConstantFP::get(f32_ty, 4.656613e-10f));
+    }
+    vals_[x][idx] = word;
+  }
+}
+
 /**
  * \brief Code Generation for `sin`
  */
 void generator::visit_sin_inst(ir::sin_inst* x){
+  if(!tgt_->is_gpu())
+    return visit_host_math_inst(x, Intrinsic::sin);
   std::vector<llvm::Type*> tys = {f32_ty};
   FunctionType *fn_ty = FunctionType::get(f32_ty, tys, false);
-  InlineAsm *sin = InlineAsm::get(fn_ty, "sin.approx.f32 $0, $0;", "=f,0", false);
+  InlineAsm *sin = InlineAsm::get(fn_ty, fast_math_ ? "sin.approx.ftz.f32 $0, $0;" : "sin.approx.f32 $0, $0;",
+                                  "=f,0", false);
   for(auto idx: idxs_.at(x)){
     vals_[x][idx] = call(sin, std::vector<llvm::Value*>{vals_[x->get_operand(0)][idx]});
   }
  }
 
+/**
+ * \brief Code Generation for math functions on the host, through LLVM intrinsics
+ */
+void generator::visit_host_math_inst(ir::instruction* x, unsigned id){
+  for(auto idx: idxs_.at(x)){
+    Value *arg = vals_[x->get_operand(0)][idx];
+    vals_[x][idx] = intrinsic(id, {arg->getType()}, {arg});
+  }
+}
+
 /**
  * \brief Code Generation for `log`
  */
 void generator::visit_log_inst(ir::log_inst* x){
+  if(!tgt_->is_gpu())
+    return visit_host_math_inst(x, Intrinsic::log);
   Constant *rcplog2e = ConstantFP::get(f32_ty, 0.6931471805599453);
   std::vector<llvm::Type*> tys = {f32_ty};
   FunctionType *fn_ty = FunctionType::get(f32_ty, tys, false);
-  InlineAsm *lg2 = InlineAsm::get(fn_ty, "lg2.approx.f32 $0, $1;", "=f,f", false);
+  InlineAsm *lg2 = InlineAsm::get(fn_ty, fast_math_ ? "lg2.approx.ftz.f32 $0, $1;" : "lg2.approx.f32 $0, $1;",
+                                  "=f,f", false);
   for(auto idx: idxs_.at(x)){
     Value *lg2arg = call(lg2, std::vector<llvm::Value*>{vals_[x->get_operand(0)][idx]});
     vals_[x][idx] = fmul(lg2arg, rcplog2e);
@@ -1111,14 +1649,23 @@ void generator::visit_log_inst(ir::log_inst* x){
  * \brief Code Generation for `atomic_cas`
  */
 void generator::visit_atomic_cas_inst(ir::atomic_cas_inst* cas) {
-  BasicBlock *current = builder_->GetInsertBlock();
-  Module *module = current->getModule();
-  Value *tid = tgt_->get_local_id(module, *builder_, 0);
+  if(!tgt_->is_gpu()){
+    Value *cas_ptr = vals_[cas->get_operand(0)][{}];
+    Value *cas_cmp = vals_[cas->get_operand(1)][{}];
+    Value *cas_val = vals_[cas->get_operand(2)][{}];
+    cas_ptr = bit_cast(cas_ptr, cas_cmp->getType()->getPointerTo(cas_ptr->getType()->getPointerAddressSpace()));
+    llvm::Align align(cas_cmp->getType()->getPrimitiveSizeInBits() / 8);
+    Value *old = builder_->Insert(new AtomicCmpXchgInst(cas_ptr, cas_cmp, cas_val, align, AtomicOrdering::Monotonic,
+                                                        AtomicOrdering::Monotonic, SyncScope::System));
+    vals_[cas][{}] = extract_val(old, {0});
+    return;
+  }
+  Value *tid = thread_id();
   Value *pred = icmp_eq(tid, i32(0));
 //  BasicBlock *tid_0_bb = BasicBlock::Create(*ctx_, "tid_0", current->getParent());
 //  BasicBlock *tid_0_done_bb = BasicBlock::Create(*ctx_, "tid_0_done", current->getParent());
   add_barrier();
-  tgt_->add_memfence(module, *builder_);
+  add_memfence(cas->get_scope());
   Value *atom_ptr;
   atom_ptr = gep(shmem_, i32(alloc_->offset(layouts_->get(layouts_->tmp(cas)))), "");
   atom_ptr = bit_cast(atom_ptr, ptr_ty(cvt(cas->get_type()->get_scalar_ty()), 3));
@@ -1127,7 +1674,8 @@ void generator::visit_atomic_cas_inst(ir::atomic_cas_inst* cas) {
   Value *cas_ptr = vals_[cas->get_operand(0)][{}];
   Value *cas_cmp = vals_[cas->get_operand(1)][{}];
   Value *cas_val = vals_[cas->get_operand(2)][{}];
-  std::string asm_str = "@$1 atom.global.cas.b32 $0, [$2], $3, $4;";
+  std::string scope = cas->get_scope() == ir::mem_scope_t::SYS ? ".sys" : "";
+  std::string asm_str = "@$1 atom.global" + scope + ".cas.b32 $0, [$2], $3, $4;";
   FunctionType *fn_ty = FunctionType::get(i32_ty, {pred->getType(), cas_ptr->getType(), cas_cmp->getType(), cas_val->getType()}, false);
   InlineAsm *iasm = InlineAsm::get(fn_ty, asm_str, "=r,b,l,r,r", true);
   add_barrier();
@@ -1139,7 +1687,7 @@ void generator::visit_atomic_cas_inst(ir::atomic_cas_inst* cas) {
   InlineAsm *iasm2 = InlineAsm::get(fn2_ty, asm2_str, "b,r,r", true);
   add_barrier();
   call(iasm2, {pred, atom_ptr, old});
-  tgt_->add_memfence(module, *builder_);
+  add_memfence(cas->get_scope());
   add_barrier();
   vals_[cas][{}] = load(atom_ptr);
   add_barrier();
@@ -1147,30 +1695,94 @@ void generator::visit_atomic_cas_inst(ir::atomic_cas_inst* cas) {
 
 /**
  * \brief Code Generation for `atomic_rmw`
+ *
+ * Block atomics whose result is unused are emitted as `red`. Their additions
+ * to an address shared by consecutive elements of a thread are combined in
+ * registers, so that each thread issues one atomic per distinct address
  */
 void generator::visit_atomic_rmw_inst(ir::atomic_rmw_inst *atom) {
   ir::value* ptr = atom->get_operand(0);
   ir::value* val = atom->get_operand(1);
   ir::value* msk = atom->get_operand(2);
+  using tt = ir::atomic_rmw_op_t;
+  bool is_block = atom->get_type()->is_block_ty();
+  bool is_dead = is_block && atom->get_users().empty();
+  int sm = tgt_->as_nvidia() ? tgt_->as_nvidia()->sm() : 0;
+  std::string scope = atom->get_scope() == ir::mem_scope_t::SYS ? ".sys" : ".gpu";
 
   // vector size
   int vec = 1;
+  // axis along which the elements of a thread are combined
+  int agg_axis = -1;
+  int agg_nts = 1;
   if(atom->get_type()->is_block_ty()){
+    analysis::scanline_layout* layout = layouts_->get(ptr)->to_scanline();
     int ld = ords_.at(ptr)[0];
-    unsigned alignment = alignment_->get(ptr, ld);
-    vec = std::min<int>(layouts_->get(ptr)->to_scanline()->nts(ld), alignment);
-    vec = std::min(vec, val->get_type()->get_tile_element_ty()->is_fp16_ty() ? 2 : 1);
+    if(is_dead && (atom->get_op() == tt::Add || atom->get_op() == tt::FAdd)){
+      std::vector<unsigned> cst = alignment_->constancy(ptr);
+      for(int d: ords_.at(ptr))
+        if(layout->nts(d) > 1 && cst[d] % layout->nts(d) == 0){
+          agg_axis = d;
+          agg_nts = layout->nts(d);
+          break;
+        }
+    }
+    ir::type* elt_ty = val->get_type()->get_tile_element_ty();
+    int max_vec = 1;
+    if(elt_ty->is_fp16_ty() || (elt_ty->is_bf16_ty() && sm >= 90))
+      max_vec = 2;
+    if(elt_ty->is_fp32_ty() && atom->get_op() == tt::FAdd && is_dead && sm >= 90)
+      max_vec = 4;
+    if(agg_axis != ld){
+      unsigned alignment = alignment_->get(ptr, ld);
+      vec = std::min<int>(layout->nts(ld), alignment);
+      vec = std::min(vec, max_vec);
+    }
   }
 
-  for(int i = 0; i < idxs_.at(val).size(); i += vec){
+  if(!tgt_->is_gpu())
+    return visit_host_atomic_rmw_inst(atom);
+
+  // operands of each atomic, identified by the indices of their first element
+  std::vector<indices_t> keys;
+  std::map<indices_t, Value*> rmw_vals;
+  std::map<indices_t, Value*> rmw_msks;
+  std::map<Value*, int> agg_pos;
+  if(agg_axis >= 0){
+    const std::vector<Value*>& values = axes_.at(a_axes_->get(ptr, agg_axis)).values;
+    for(size_t k = 0; k < values.size(); k++)
+      agg_pos[values[k]] = k;
+  }
+  for(size_t i = 0; i < idxs_.at(val).size(); i += vec){
     auto idx = idxs_[val][i];
     Value *rmw_val = UndefValue::get(vec_ty(vals_[val][idx]->getType(), vec));
     for(int ii = 0; ii < vec; ii++)
       rmw_val = insert_elt(rmw_val, vals_[val][idxs_[val][i+ii]], ii);
-    Value *rmw_ptr = vals_[ptr][idx];
     Value *rmw_msk = vals_[msk][idx];
     if(vec == 1)
       rmw_val = extract_elt(rmw_val, i32(0));
+    indices_t key = idx;
+    if(agg_axis >= 0){
+      // masked elements do not contribute to the sum
+      rmw_val = select(rmw_msk, rmw_val, Constant::getNullValue(rmw_val->getType()));
+      int k = agg_pos.at(idx[agg_axis]);
+      key[agg_axis] = axes_.at(a_axes_->get(ptr, agg_axis)).values[k - k % agg_nts];
+    }
+    if(rmw_vals.find(key) == rmw_vals.end()){
+      keys.push_back(key);
+      rmw_vals[key] = rmw_val;
+      rmw_msks[key] = rmw_msk;
+      continue;
+    }
+    Value *&acc = rmw_vals[key];
+    acc = atom->get_op() == tt::FAdd ? fadd(acc, rmw_val) : add(acc, rmw_val);
+    rmw_msks[key] = builder_->CreateOr(rmw_msks[key], rmw_msk);
+  }
+
+  for(indices_t idx: keys){
+    Value *rmw_val = rmw_vals[idx];
+    Value *rmw_ptr = vals_[ptr][idx];
+    Value *rmw_msk = rmw_msks[idx];
     Type* ty = rmw_val->getType();
     size_t nbits = ty->getScalarSizeInBits();
     // extract pointer offset
@@ -1182,15 +1794,10 @@ void generator::visit_atomic_rmw_inst(ir::atomic_rmw_inst *atom) {
       rmw_ptr = gep->getPointerOperand();
     }
     rmw_ptr = bit_cast(rmw_ptr, ty->getPointerTo(1));
-    // asm argument type
-    std::vector<Type*> arg_ty = {rmw_msk->getType(), rmw_ptr->getType(), rmw_val->getType()};
-    // asm function type
-    FunctionType *fn_ty = FunctionType::get(ty, arg_ty, false);
     // asm string
     std::string s_nbits = std::to_string(nbits);
     std::string name;
     std::string s_ty;
-    using tt = ir::atomic_rmw_op_t;
     switch(atom->get_op()){
       case tt::Or: name = "or"; s_ty = "b"; break;
       case tt::And: name = "and"; s_ty = "b"; break;
@@ -1200,25 +1807,82 @@ void generator::visit_atomic_rmw_inst(ir::atomic_rmw_inst *atom) {
       case tt::Max: name = "max", s_ty = "s"; break;
       case tt::UMin: name = "min", s_ty = "u"; break;
       case tt::UMax: name = "max", s_ty = "u"; break;
-      case tt::FAdd: name = "add", s_ty = "f"; break;
+      case tt::FAdd: name = "add", s_ty = ty->getScalarType()->isBFloatTy() ? "bf" : "f"; break;
       case tt::Xchg: name = "exch", s_ty = "b"; break;
     }
-    std::string s_vec = vec == 2 ? "x2" : "";
+    std::string s_vec = vec == 2 && nbits == 16 ? "x2" : "";
     std::string mod = nbits == 16 ? ".noftz" : "";
-
-    std::string asm_str = "@$1 atom.global.gpu." + name + mod + "." + s_ty + s_nbits + s_vec + " $0, [$2" + offset + "], $3;";
     std::string ty_id = nbits*vec == 64 ? "l" : (nbits*vec == 32 ? "r" : "h");
+    // atom.add.noftz.bf16 needs sm_90: earlier targets compare-and-swap the element until no
+    // other thread updated it between the load and the swap
+    bool bf16_cas = atom->get_op() == tt::FAdd && ty->getScalarType()->isBFloatTy() && sm < 90;
+    // the old value is not needed
+    if(is_dead && atom->get_op() != tt::Xchg && !bf16_cas){
+      std::vector<Value*> args = {rmw_msk, rmw_ptr};
+      std::string operands;
+      std::string constraint = "b,l";
+      std::string asm_str;
+      if(vec > 1 && nbits == 32){
+        for(int ii = 0; ii < vec; ii++){
+          args.push_back(extract_elt(rmw_val, i32(ii)));
+          operands += (ii == 0 ? "{$" : ", $") + std::to_string(2 + ii);
+          constraint += ",r";
+        }
+        operands += "}";
+        asm_str = "@$0 red.global" + scope + ".v" + std::to_string(vec) + "." + s_ty + s_nbits + "." + name + " [$1" + offset + "], " + operands + ";";
+      }
+      else{
+        args.push_back(rmw_val);
+        constraint += "," + ty_id;
+        asm_str = "@$0 red.global" + scope + "." + name + mod + "." + s_ty + s_nbits + s_vec + " [$1" + offset + "], $2;";
+      }
+      std::vector<Type*> arg_ty;
+      for(Value* arg: args)
+        arg_ty.push_back(arg->getType());
+      InlineAsm *iasm = InlineAsm::get(FunctionType::get(void_ty, arg_ty, false), asm_str, constraint, true);
+      call(iasm, args);
+      continue;
+    }
+    // asm argument type
+    std::vector<Type*> arg_ty = {rmw_msk->getType(), rmw_ptr->getType(), rmw_val->getType()};
+    // asm function type
+    FunctionType *fn_ty = FunctionType::get(ty, arg_ty, false);
+    std::string asm_str = "@$1 atom.global" + scope + "." + name + mod + "." + s_ty + s_nbits + s_vec + " $0, [$2" + offset + "], $3;";
+    if(bf16_cas){
+      // fma.rn.bf16 rounds the sum once on sm_80+; before, it is added in fp32 and truncated
+      std::string add_str = sm >= 80 ? "fma.rn.bf16 NEW, CUR, ONE, $3;\n\t"
+                                     : "mov.b32 A, {ZERO, CUR};\n\t"
+                                       "mov.b32 B, {ZERO, $3};\n\t"
+                                       "add.f32 A, A, B;\n\t"
+                                       "mov.b32 {LOW, NEW}, A;\n\t";
+      asm_str = "{\n\t"
+                ".reg .pred P1;\n\t"
+                ".reg .b16 CUR, NEW, OLD, ONE, ZERO, LOW;\n\t"
+                ".reg .f32 A, B;\n\t"
+                "mov.b16 ONE, 0x3F80;\n\t"
+                "mov.b16 ZERO, 0;\n\t"
+                "@!$1 bra DONE;\n\t"
+                "ld.global.b16 CUR, [$2" + offset + "];\n\t"
+                "LAB_CAS:\n\t"
+                + add_str +
+                "atom.global" + scope + ".cas.b16 OLD, [$2" + offset + "], CUR, NEW;\n\t"
+                "setp.eq.b16 P1, OLD, CUR;\n\t"
+                "mov.b16 CUR, OLD;\n\t"
+                "@!P1 bra LAB_CAS;\n\t"
+                "mov.b16 $0, CUR;\n\t"
+                "DONE:\n\t"
+                "}";
+    }
     std::string constraint = "=" + ty_id + ",b,l," + ty_id;
     // create inline asm
     InlineAsm *iasm = InlineAsm::get(fn_ty, asm_str, constraint, true);
     // call asm
-    if(atom->get_type()->is_block_ty())
+    if(is_block)
       vals_[atom][idx] = call(iasm, (ArrayRef<Value*>{rmw_msk, rmw_ptr, rmw_val}));
     else{
-      Module *mod = builder_->GetInsertBlock()->getModule();
-      tgt_->add_memfence(mod, *builder_);
+      add_memfence(atom->get_scope());
       add_barrier();
-      Value *tid = tgt_->get_local_id(mod, *builder_, 0);
+      Value *tid = thread_id();
       rmw_msk = builder_->CreateAnd(rmw_msk, icmp_eq(tid, i32(0)));
       Value *old = call(iasm, (ArrayRef<Value*>{rmw_msk, rmw_ptr, rmw_val}));
       Value *atom_ptr;
@@ -1232,6 +1896,40 @@ void generator::visit_atomic_rmw_inst(ir::atomic_rmw_inst *atom) {
   }
 }
 
+/**
+ * \brief Code Generation for `atomic_rmw` on the host: one LLVM `atomicrmw` per element.
+ * Each program runs on a single thread, so scalar atomics need no broadcast
+ */
+void generator::visit_host_atomic_rmw_inst(ir::atomic_rmw_inst *atom) {
+  ir::value* ptr = atom->get_operand(0);
+  ir::value* val = atom->get_operand(1);
+  ir::value* msk = atom->get_operand(2);
+  using tt = ir::atomic_rmw_op_t;
+  AtomicRMWInst::BinOp op;
+  switch(atom->get_op()){
+    case tt::Or: op = AtomicRMWInst::Or; break;
+    case tt::And: op = AtomicRMWInst::And; break;
+    case tt::Xor: op = AtomicRMWInst::Xor; break;
+    case tt::Add: op = AtomicRMWInst::Add; break;
+    case tt::Min: op = AtomicRMWInst::Min; break;
+    case tt::Max: op = AtomicRMWInst::Max; break;
+    case tt::UMin: op = AtomicRMWInst::UMin; break;
+    case tt::UMax: op = AtomicRMWInst::UMax; break;
+    case tt::FAdd: op = AtomicRMWInst::FAdd; break;
+    case tt::Xchg: op = AtomicRMWInst::Xchg; break;
+    default: throw std::runtime_error("unsupported atomic_rmw operation");
+  }
+  for(indices_t idx: idxs_.at(val)){
+    Value *rmw_val = vals_[val][idx];
+    Value *rmw_ptr = vals_[ptr][idx];
+    rmw_ptr = bit_cast(rmw_ptr, rmw_val->getType()->getPointerTo(rmw_ptr->getType()->getPointerAddressSpace()));
+    vals_[atom][idx] = host_if(vals_[msk][idx], [&]() -> Value* {
+      llvm::Align align(rmw_val->getType()->getPrimitiveSizeInBits() / 8);
+      return builder_->Insert(new AtomicRMWInst(op, rmw_ptr, rmw_val, align, AtomicOrdering::Monotonic, SyncScope::System));
+    }, nullptr);
+  }
+}
+
 /**
  * \brief Code Generation for `mma.884` (V100)
  */
@@ -1334,10 +2032,13 @@ void generator::visit_mma884(ir::dot_inst* C, ir::value *A, ir::value *B, ir::va
     ptr_b[i] = gep(shmems_[B], off_b[i]);
 
 
-  // initialize accumulators
+  // initialize accumulators. m8n8k4 assigns other elements to threads with fp16
+  // accumulators than with the fp32 ones of the layout, so fp16 accumulators are
+  // only stored in fp16 between dots, and accumulated in fp32 within them
+  bool is_f16_acc = C->get_type()->get_scalar_ty()->is_fp16_ty();
   std::vector<Value*> acc;
   for(indices_t idx: idxs_.at(C))
-    acc.push_back(vals_[D][idx]);
+    acc.push_back(is_f16_acc ? fpcast(vals_[D][idx], f32_ty) : vals_[D][idx]);
 
   unsigned num_m = layout_c->rep(0) * shape_c[0] / layout_c->shape_per_cta(0);
   unsigned num_n = layout_c->rep(1) * shape_c[1] / layout_c->shape_per_cta(1);
@@ -1499,7 +2200,7 @@ void generator::visit_mma884(ir::dot_inst* C, ir::value *A, ir::value *B, ir::va
 
   // write back accumulators
   for(size_t i = 0; i < idxs_.at(C).size(); i++)
-    vals_[C][idxs_[C][i]] = acc[i];
+    vals_[C][idxs_[C][i]] = is_f16_acc ? fpcast(acc[i], f16_ty) : acc[i];
 }
 
 namespace {
@@ -1915,7 +2616,18 @@ void generator::visit_mma16816(ir::dot_inst* C, ir::value *A, ir::value *B, ir::
 
   ir::type *A_ir_ty = A->get_type()->get_scalar_ty();
   ir::type *B_ir_ty = B->get_type()->get_scalar_ty();
-  if (A_ir_ty->is_fp16_ty() && B_ir_ty->is_fp16_ty()) {
+  // fp16 accumulators: the 4 values of a thread are those of fp32 accumulators,
+  // packed by pairs of columns into 2 registers
+  bool is_f16_acc = C->get_type()->get_scalar_ty()->is_fp16_ty();
+  Type *fp16x2_pack2_ty = StructType::get(*ctx_, std::vector<llvm::Type*>{fp16x2_ty, fp16x2_ty});
+  if (is_f16_acc) {
+    if (!A_ir_ty->is_fp16_ty() || !B_ir_ty->is_fp16_ty())
+      throw std::runtime_error("fp16 accumulators require fp16 operands");
+    mma_ty = FunctionType::get(fp16x2_pack2_ty, std::vector<llvm::Type*>{fp16x2_ty, fp16x2_ty, fp16x2_ty, fp16x2_ty, fp16x2_ty, fp16x2_ty, fp16x2_ty, fp16x2_ty}, false);
+    smem_ptr_ty = ptr_ty(f16_ty, 3);
+    ldmatrix_ty = FunctionType::get(fp16x2_pack4_ty, std::vector<llvm::Type*>{smem_ptr_ty}, false);
+    phi_ty = fp16x2_ty;
+  } else if (A_ir_ty->is_fp16_ty() && B_ir_ty->is_fp16_ty()) {
     mma_ty = FunctionType::get(fp32_pack4_ty, std::vector<llvm::Type*>{fp16x2_ty, fp16x2_ty, fp16x2_ty, fp16x2_ty, fp16x2_ty, fp16x2_ty, fp32_ty, fp32_ty, fp32_ty, fp32_ty}, false);
     smem_ptr_ty = ptr_ty(f16_ty, 3);
     ldmatrix_ty = FunctionType::get(fp16x2_pack4_ty, std::vector<llvm::Type*>{smem_ptr_ty}, false);
@@ -1957,7 +2669,7 @@ void generator::visit_mma16816(ir::dot_inst* C, ir::value *A, ir::value *B, ir::
   if(FirstBB != CurrBB)
     builder_->SetInsertPoint(FirstBB->getTerminator());
 
-  Value* thread = tgt_->get_local_id(mod_, *builder_, 0);
+  Value* thread = thread_id();
   Value *lane   = urem(thread, i32(32));
   Value *warp   = udiv(thread, i32(32));
   Value *warp_mn = udiv(warp, i32(layout->wpt(0)));
@@ -2000,13 +2712,29 @@ void generator::visit_mma16816(ir::dot_inst* C, ir::value *A, ir::value *B, ir::
   for(int i = 0; i < num_ptr_b; i++)
     ptrs_b[i] = bit_cast(gep(shmems_[B], {off_b[i]}), smem_ptr_ty);
 
-  InlineAsm *mma_fn = InlineAsm::get(mma_ty, layout->get_ptx_instr() +
-                                             " {$0, $1, $2, $3},"
-                                             " {$4, $5, $6, $7},"
-                                             " {$8, $9},"
-                                             " {$10, $11, $12, $13};",
-                                             "=r,=r,=r,=r,r,r,r,r,r,r,0,1,2,3", true);
-
+  InlineAsm *mma_fn = is_f16_acc ? InlineAsm::get(mma_ty, layout->get_ptx_instr() +
+                                                          " {$0, $1},"
+                                                          " {$2, $3, $4, $5},"
+                                                          " {$6, $7},"
+                                                          " {$8, $9};",
+                                                          "=r,=r,r,r,r,r,r,r,0,1", true)
+                                 : InlineAsm::get(mma_ty, layout->get_ptx_instr() +
+                                                          " {$0, $1, $2, $3},"
+                                                          " {$4, $5, $6, $7},"
+                                                          " {$8, $9},"
+                                                          " {$10, $11, $12, $13};",
+                                                          "=r,=r,=r,=r,r,r,r,r,r,r,0,1,2,3", true);
+
+  // tf32 part and remainder of each fp32 operand, for 3xTF32
+  std::map<Value*, std::pair<Value*, Value*>> splits;
+  auto split_tf32 = [&](Value* x) {
+    if(splits.find(x) == splits.end()){
+      Value* big = bit_cast(and_(bit_cast(x, i32_ty), i32(0xffffe000)), f32_ty);
+      Value* small = fsub(bit_cast(x, f32_ty), big);
+      splits[x] = {bit_cast(big, x->getType()), bit_cast(small, x->getType())};
+    }
+    return splits[x];
+  };
   // create mma & unpack result, m, n, k are offsets in mat
   auto call_mma = [&](unsigned m, unsigned n, unsigned k) {
       unsigned cols_per_thread = num_rep_m * 2;
@@ -2016,10 +2744,45 @@ void generator::visit_mma16816(ir::dot_inst* C, ir::value *A, ir::value *B, ir::
         (m + 1) + (n*2 + 0)*cols_per_thread,
         (m + 1) + (n*2 + 1)*cols_per_thread
       };
-      Value *nc = call(mma_ty, mma_fn, 
-                       {ha[{m, k}], ha[{m+1, k}], ha[{m, k+1}], ha[{m+1, k+1}],
-                        hb[{n, k}], hb[{n, k+1}],
-                        fc[idx[0]], fc[idx[1]], fc[idx[2]], fc[idx[3]]});
+      std::vector<Value*> a = {ha[{m, k}], ha[{m+1, k}], ha[{m, k+1}], ha[{m+1, k+1}]};
+      std::vector<Value*> b = {hb[{n, k}], hb[{n, k+1}]};
+      std::vector<Value*> acc = {fc[idx[0]], fc[idx[1]], fc[idx[2]], fc[idx[3]]};
+      auto mma = [&](const std::vector<Value*>& a, const std::vector<Value*>& b, const std::vector<Value*>& acc) {
+        return call(mma_ty, mma_fn, {a[0], a[1], a[2], a[3], b[0], b[1], acc[0], acc[1], acc[2], acc[3]});
+      };
+      Value *nc;
+      if(is_f16_acc){
+        auto pack = [&](Value* x, Value* y) {
+          return insert_elt(insert_elt(UndefValue::get(fp16x2_ty), x, i32(0)), y, i32(1));
+        };
+        Value *d = call(mma_ty, mma_fn, {a[0], a[1], a[2], a[3], b[0], b[1], pack(acc[0], acc[1]), pack(acc[2], acc[3])});
+        Value *d0 = extract_val(d, std::vector<unsigned>{0});
+        Value *d1 = extract_val(d, std::vector<unsigned>{1});
+        fc[idx[0]] = extract_elt(d0, i32(0));
+        fc[idx[1]] = extract_elt(d0, i32(1));
+        fc[idx[2]] = extract_elt(d1, i32(0));
+        fc[idx[3]] = extract_elt(d1, i32(1));
+        return;
+      }
+      if(C->split_tf32()){
+        std::vector<Value*> a_big, a_small, b_big, b_small;
+        for(Value* x: a){
+          a_big.push_back(split_tf32(x).first);
+          a_small.push_back(split_tf32(x).second);
+        }
+        for(Value* x: b){
+          b_big.push_back(split_tf32(x).first);
+          b_small.push_back(split_tf32(x).second);
+        }
+        // the small products go first, so that they are not absorbed by the big one
+        nc = mma(a_small, b_big, acc);
+        nc = mma(a_big, b_small, {extract_val(nc, std::vector<unsigned>{0}), extract_val(nc, std::vector<unsigned>{1}),
+                                  extract_val(nc, std::vector<unsigned>{2}), extract_val(nc, std::vector<unsigned>{3})});
+        nc = mma(a_big, b_big, {extract_val(nc, std::vector<unsigned>{0}), extract_val(nc, std::vector<unsigned>{1}),
+                                extract_val(nc, std::vector<unsigned>{2}), extract_val(nc, std::vector<unsigned>{3})});
+      }
+      else
+        nc = mma(a, b, acc);
       fc[idx[0]] = extract_val(nc, std::vector<unsigned>{0});
       fc[idx[1]] = extract_val(nc, std::vector<unsigned>{1});
       fc[idx[2]] = extract_val(nc, std::vector<unsigned>{2});
@@ -2119,56 +2882,212 @@ void generator::visit_mma16816(ir::dot_inst* C, ir::value *A, ir::value *B, ir::
 }
 
 /**
- * \brief Code Generation for FMA-based `dot` (FP32, FP64, Default)
+ * \brief Code Generation for sparse `dot` with `mma.sp` (sm >= 80, fp16/bf16)
+ *
+ * A is compressed to half of the columns of K, so that its fragments are the
+ * ones of a dense m16n8k16 product, loaded by the same ldmatrix loader, while
+ * each instruction consumes 32 rows of B, i.e., two dense B fragments. With
+ * sparsity selector 0, lanes 4g and 4g+1 hold the metadata of rows g and g+8
+ * of each 16-row instruction, one int32 per 32 columns of K
  */
-void generator::visit_fmadot(ir::dot_inst* C, ir::value* A, ir::value* B, ir::value* D, unsigned NK, Type *c_ty, Function *f_mul_add) {
-  auto shape_c = C->get_type()->get_block_shapes();
+void generator::visit_mma16816_sp(ir::dot_inst* C, ir::value *A, ir::value *B, ir::value *D, ir::value *E) {
+  const std::vector<unsigned>& shapes = C->get_type()->get_block_shapes();
+  std::map<std::vector<Value*>, std::vector<Value*>> fcs;
+  for(indices_t idx: idxs_.at(C)){
+    std::vector<Value*> key(idx.size() - 2);
+    std::copy(idx.begin() + 2, idx.end(), key.begin());
+    fcs[key].push_back(vals_[D][idx]);
+  };
   auto shape_a = A->get_type()->get_block_shapes();
   auto shape_b = B->get_type()->get_block_shapes();
+  auto shape_e = E->get_type()->get_block_shapes();
   auto ord_a = layouts_->get(A)->get_order();
   auto ord_b = layouts_->get(B)->get_order();
-  analysis::scanline_layout* layout_c = layouts_->get(C)->to_scanline();
-  analysis::shared_layout* layout_a = (analysis::shared_layout*)layouts_->get(C->get_operand(0));
-  analysis::shared_layout* layout_b = (analysis::shared_layout*)layouts_->get(C->get_operand(1));
-  bool is_a_row = ord_a[0] == 1;
-  bool is_b_row = ord_b[0] == 1;
-  std::string a_trans = is_a_row ? "" : ".trans";
-  std::string b_trans = is_b_row ? ".trans" : "";
-  int stride_a_m = is_a_row ? shape_a[1] : 1;
-  int stride_a_k = is_a_row ? 1 : shape_a[0];
-  int stride_b_n = is_b_row ? 1 : shape_b[0];
-  int stride_b_k = is_b_row ? shape_b[1] : 1;
-  int stride_a0 = is_a_row ? stride_a_k : stride_a_m;
-  int stride_a1 = is_a_row ? stride_a_m : stride_a_k;
-  int stride_b0 = is_b_row ? stride_b_n : stride_b_k;
-  int stride_b1 = is_b_row ? stride_b_k : stride_b_n;
-  int lda = is_a_row ? stride_a_m : stride_a_k;
-  int ldb = is_b_row ? stride_b_k : stride_b_n;
-  int per_phase_a = swizzle_->get_per_phase(layout_a);
-  int max_phase_a = swizzle_->get_max_phase(layout_a);
-  int per_phase_b = swizzle_->get_per_phase(layout_b);
-  int max_phase_b = swizzle_->get_max_phase(layout_b);
-  int num_ptr_a   = 8;
-  int num_ptr_b   = 8;
-  int vec_a = 2;
-  int vec_b = 4;
-  distributed_axis ax_m = axes_.at(a_axes_->get(C, 0));
-  distributed_axis ax_n = axes_.at(a_axes_->get(C, 1));
-//  Value* thread = tgt_->get_local_id(mod_, *builder_, 0);
+  auto ord_e = layouts_->get(E)->get_order();
+  analysis::mma_layout* layout = layouts_->get(C)->to_mma();
+  analysis::shared_layout* layout_a = (analysis::shared_layout*)layouts_->get(A);
+  analysis::shared_layout* layout_b = (analysis::shared_layout*)layouts_->get(B);
 
-  Value* off_a0 = is_a_row ? i32(0) : mul(ax_m.thread_id, i32(ax_m.contiguous));
-  Value* off_a1 = is_a_row ? mul(ax_m.thread_id, i32(ax_m.contiguous)): i32(0);
-  std::vector<Value*> off_a(num_ptr_a);
-  for(int i = 0; i < num_ptr_a; i++){
-//    Value* off_a0i = add(off_a0, i32(is_a_row ? vec_a : layout_c->mts(0)*vec_a));
-//    off_a0i = exact_udiv(off_a0i, i32(vec_a));
-//    off_a0i = xor_(off_a0i, phase_a);
-//    off_a0i = mul(off_a0i, i32(vec_a));
-    off_a[i] = add(mul(off_a0, i32(stride_a0)), mul(off_a1, i32(stride_a1)));
-  }
-  Value* off_b0 = is_b_row ? mul(ax_n.thread_id, i32(ax_n.contiguous)): i32(0);
-  Value* off_b1 = is_b_row ? i32(0) : mul(ax_n.thread_id, i32(ax_n.contiguous));
-  std::vector<Value*> off_b(num_ptr_b);
+  const int per_phase_a = swizzle_->get_per_phase(layout_a);
+  const int max_phase_a = swizzle_->get_max_phase(layout_a);
+  const int per_phase_b = swizzle_->get_per_phase(layout_b);
+  const int max_phase_b = swizzle_->get_max_phase(layout_b);
+
+  const int num_rep_m = shapes[0] / layout->shape_per_cta(0);
+  const int num_rep_n = shapes[1] / layout->shape_per_cta(1);
+  const int num_rep_k = shape_b[0] / 32;
+
+  Type *fp16x2_ty = vec_ty(f16_ty, 2);
+  Type *fp16x2_pack4_ty = StructType::get(*ctx_, std::vector<llvm::Type*>{fp16x2_ty, fp16x2_ty, fp16x2_ty, fp16x2_ty});
+  Type *fp32_pack4_ty = StructType::get(*ctx_, std::vector<llvm::Type*>{f32_ty, f32_ty, f32_ty, f32_ty});
+  // bf16 pairs are passed as fp16 pairs, as for dense dots
+  Type *smem_ptr_ty = ptr_ty(f16_ty, 3);
+  FunctionType *ldmatrix_ty = FunctionType::get(fp16x2_pack4_ty, std::vector<llvm::Type*>{smem_ptr_ty}, false);
+  std::vector<Type*> mma_args(8, fp16x2_ty);
+  mma_args.insert(mma_args.end(), 4, f32_ty);
+  mma_args.push_back(i32_ty);
+  FunctionType *mma_ty = FunctionType::get(fp32_pack4_ty, mma_args, false);
+  std::string dtype = A->get_type()->get_scalar_ty()->is_bf16_ty() ? "bf16" : "f16";
+  InlineAsm *mma_fn = InlineAsm::get(mma_ty, "mma.sp.sync.aligned.m16n8k32.row.col.f32." + dtype + "." + dtype + ".f32"
+                                             " {$0, $1, $2, $3},"
+                                             " {$4, $5, $6, $7},"
+                                             " {$8, $9, $10, $11},"
+                                             " {$12, $13, $14, $15}, $16, 0x0;",
+                                             "=r,=r,=r,=r,r,r,r,r,r,r,r,r,0,1,2,3,r", true);
+
+  std::map<std::pair<unsigned, unsigned>, Value*> ha;
+  std::map<std::pair<unsigned, unsigned>, Value*> hb;
+
+  BasicBlock* CurrBB = builder_->GetInsertBlock();
+  BasicBlock* FirstBB = &CurrBB->getParent()->getEntryBlock();
+  if(FirstBB != CurrBB)
+    builder_->SetInsertPoint(FirstBB->getTerminator());
+
+  Value* thread = thread_id();
+  Value *lane   = urem(thread, i32(32));
+  Value *warp   = udiv(thread, i32(32));
+  Value *warp_mn = udiv(warp, i32(layout->wpt(0)));
+  Value *warp_m  = urem(warp, i32(layout->wpt(0)));
+  Value *warp_n  = urem(warp_mn, i32(layout->wpt(1)));
+  std::vector<Value *>& fc = fcs.begin()->second;
+
+  size_t dtsize = A->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8;
+  mma16816_smem_loader a_loader(layout->wpt(0), ord_a, /*k_order*/1, shape_a,
+                                {16, 16}, {8, 8},
+                                per_phase_a, max_phase_a, dtsize, builder_, add, mul, gep);
+  std::vector<Value*> off_a = a_loader.compute_offs(warp_m, lane);
+  int num_ptr_a = a_loader.get_num_ptr();
+  mma16816_smem_loader b_loader(layout->wpt(1), ord_b, /*k_order*/0, shape_b,
+                                {16, 8}, {8, 8},
+                                per_phase_b, max_phase_b, dtsize, builder_, add, mul, gep);
+  std::vector<Value*> off_b = b_loader.compute_offs(warp_n, lane);
+  int num_ptr_b = b_loader.get_num_ptr();
+  // row of the metadata held by this lane in the first instruction of the warp
+  Value *row_e = add(mul(warp_m, i32(16)), add(udiv(lane, i32(4)), mul(urem(lane, i32(2)), i32(8))));
+  int stride_e_m = ord_e[0] == 1 ? shape_e[1] : 1;
+  int stride_e_k = ord_e[0] == 1 ? 1 : shape_e[0];
+  Value *off_e = mul(row_e, i32(stride_e_m));
+
+  builder_->SetInsertPoint(CurrBB);
+  std::vector<Value*> ptrs_a(num_ptr_a);
+  for(int i = 0; i < num_ptr_a; i++)
+    ptrs_a[i] = bit_cast(gep(shmems_[A], {off_a[i]}), smem_ptr_ty);
+  std::vector<Value*> ptrs_b(num_ptr_b);
+  for(int i = 0; i < num_ptr_b; i++)
+    ptrs_b[i] = bit_cast(gep(shmems_[B], {off_b[i]}), smem_ptr_ty);
+  Value *ptr_e = bit_cast(gep(shmems_[E], {off_e}), ptr_ty(i32_ty, 3));
+
+  auto load_a = [&](int m, int k) {
+    auto [ha0, ha1, ha2, ha3] = a_loader.load_x4(m, k, 0, false, nullptr, shared_pre_ptr_[layout_a],
+                                                 shared_next_ptr_[layout_a], off_a, ptrs_a,
+                                                 ldmatrix_ty, smem_ptr_ty, prefetch_latch_to_bb_);
+    ha[{m, k}] = ha0;
+    ha[{m+1, k}] = ha1;
+    ha[{m, k+1}] = ha2;
+    ha[{m+1, k+1}] = ha3;
+  };
+  auto load_b = [&](int n, int k) {
+    auto [hb0, hb1, hb2, hb3] = b_loader.load_x4(k, n, 0, false, nullptr, shared_pre_ptr_[layout_b],
+                                                 shared_next_ptr_[layout_b], off_b, ptrs_b,
+                                                 ldmatrix_ty, smem_ptr_ty, prefetch_latch_to_bb_);
+    hb[{n, k}] = hb0;
+    hb[{n+1, k}] = hb2;
+    hb[{n, k+1}] = hb1;
+    hb[{n+1, k+1}] = hb3;
+  };
+  auto load_e = [&](int m, int k) {
+    int off = m * layout->shape_per_cta(0) * stride_e_m + k * stride_e_k;
+    return load(gep(ptr_e, {i32(off)}));
+  };
+
+  for(int k = 0; k < num_rep_k; k++){
+    // 16 columns of compressed A, and 32 rows of B, per instruction
+    for(int m = 0; m < num_rep_m; m++)
+      load_a(2*m, 2*k);
+    for(int n = 0; n < num_rep_n; n+=2){
+      load_b(n, 4*k);
+      load_b(n, 4*k + 2);
+    }
+    for(int m = 0; m < num_rep_m; m++){
+      Value *e = load_e(m, k);
+      for(int n = 0; n < num_rep_n; n++){
+        unsigned cols_per_thread = num_rep_m * 2;
+        std::vector<size_t> idx = {
+          (2*m + 0) + (n*2 + 0)*cols_per_thread,
+          (2*m + 0) + (n*2 + 1)*cols_per_thread,
+          (2*m + 1) + (n*2 + 0)*cols_per_thread,
+          (2*m + 1) + (n*2 + 1)*cols_per_thread
+        };
+        Value *nc = call(mma_ty, mma_fn, {ha[{2*m, 2*k}], ha[{2*m+1, 2*k}], ha[{2*m, 2*k+1}], ha[{2*m+1, 2*k+1}],
+                                          hb[{n, 4*k}], hb[{n, 4*k+1}], hb[{n, 4*k+2}], hb[{n, 4*k+3}],
+                                          fc[idx[0]], fc[idx[1]], fc[idx[2]], fc[idx[3]], e});
+        for(unsigned i = 0; i < 4; i++)
+          fc[idx[i]] = extract_val(nc, std::vector<unsigned>{i});
+      }
+    }
+  }
+  // write back
+  unsigned i = 0;
+  for(indices_t idx: idxs_.at(C)){
+    std::vector<Value*> key(idx.size() - 2);
+    std::copy(idx.begin() + 2, idx.end(), key.begin());
+    if(i >= fcs.at(key).size())
+      i = 0;
+    vals_[C][idx] = fcs.at(key)[i++];
+  };
+}
+
+/**
+ * \brief Code Generation for FMA-based `dot` (FP32, FP64, Default)
+ */
+void generator::visit_fmadot(ir::dot_inst* C, ir::value* A, ir::value* B, ir::value* D, unsigned NK, Type *c_ty, Function *f_mul_add) {
+  auto shape_c = C->get_type()->get_block_shapes();
+  auto shape_a = A->get_type()->get_block_shapes();
+  auto shape_b = B->get_type()->get_block_shapes();
+  auto ord_a = layouts_->get(A)->get_order();
+  auto ord_b = layouts_->get(B)->get_order();
+  analysis::scanline_layout* layout_c = layouts_->get(C)->to_scanline();
+  analysis::shared_layout* layout_a = (analysis::shared_layout*)layouts_->get(C->get_operand(0));
+  analysis::shared_layout* layout_b = (analysis::shared_layout*)layouts_->get(C->get_operand(1));
+  bool is_a_row = ord_a[0] == 1;
+  bool is_b_row = ord_b[0] == 1;
+  std::string a_trans = is_a_row ? "" : ".trans";
+  std::string b_trans = is_b_row ? ".trans" : "";
+  int stride_a_m = is_a_row ? shape_a[1] : 1;
+  int stride_a_k = is_a_row ? 1 : shape_a[0];
+  int stride_b_n = is_b_row ? 1 : shape_b[0];
+  int stride_b_k = is_b_row ? shape_b[1] : 1;
+  int stride_a0 = is_a_row ? stride_a_k : stride_a_m;
+  int stride_a1 = is_a_row ? stride_a_m : stride_a_k;
+  int stride_b0 = is_b_row ? stride_b_n : stride_b_k;
+  int stride_b1 = is_b_row ? stride_b_k : stride_b_n;
+  int lda = is_a_row ? stride_a_m : stride_a_k;
+  int ldb = is_b_row ? stride_b_k : stride_b_n;
+  int per_phase_a = swizzle_->get_per_phase(layout_a);
+  int max_phase_a = swizzle_->get_max_phase(layout_a);
+  int per_phase_b = swizzle_->get_per_phase(layout_b);
+  int max_phase_b = swizzle_->get_max_phase(layout_b);
+  int num_ptr_a   = 8;
+  int num_ptr_b   = 8;
+  int vec_a = 2;
+  int vec_b = 4;
+  distributed_axis ax_m = axes_.at(a_axes_->get(C, 0));
+  distributed_axis ax_n = axes_.at(a_axes_->get(C, 1));
+//  Value* thread = tgt_->get_local_id(mod_, *builder_, 0);
+
+  Value* off_a0 = is_a_row ? i32(0) : mul(ax_m.thread_id, i32(ax_m.contiguous));
+  Value* off_a1 = is_a_row ? mul(ax_m.thread_id, i32(ax_m.contiguous)): i32(0);
+  std::vector<Value*> off_a(num_ptr_a);
+  for(int i = 0; i < num_ptr_a; i++){
+//    Value* off_a0i = add(off_a0, i32(is_a_row ? vec_a : layout_c->mts(0)*vec_a));
+//    off_a0i = exact_udiv(off_a0i, i32(vec_a));
+//    off_a0i = xor_(off_a0i, phase_a);
+//    off_a0i = mul(off_a0i, i32(vec_a));
+    off_a[i] = add(mul(off_a0, i32(stride_a0)), mul(off_a1, i32(stride_a1)));
+  }
+  Value* off_b0 = is_b_row ? mul(ax_n.thread_id, i32(ax_n.contiguous)): i32(0);
+  Value* off_b1 = is_b_row ? i32(0) : mul(ax_n.thread_id, i32(ax_n.contiguous));
+  std::vector<Value*> off_b(num_ptr_b);
   for(int i = 0; i < num_ptr_b; i++){
 //    Value* off_b0i = add(off_b0, i32(is_b_row ? layout_c->mts(1)*vec_b : vec_b));
 //    off_b0i = exact_udiv(off_b0i, i32(vec_b));
@@ -2183,10 +3102,62 @@ void generator::visit_fmadot(ir::dot_inst* C, ir::value* A, ir::value* B, ir::va
   for(int i = 0; i < num_ptr_b; i++)
     ptrs_b[i] = gep(shmems_[B], off_b[i]);
 
-  std::map<indices_t, Value*> ret = vals_[D];
+  // operands read along their strided dimension may be swizzled;
+  // the column is then XOR-ed with the phase of the row
+  std::map<unsigned, Value*> phases_a, phases_b;
+  auto get_phase = [&](std::map<unsigned, Value*>& phases, Value* off, unsigned row, int per_phase, int max_phase){
+    if(phases.find(row) == phases.end())
+      phases[row] = urem(udiv(add(off, i32(row)), i32(per_phase)), i32(max_phase));
+    return phases[row];
+  };
+  // operands are read once per thread and converted to the type of the accumulator;
+  // int8 operands are packed by groups of 4 along k for dp4a
+  bool is_int = c_ty->isIntegerTy();
+  bool is_dp4a = is_int && A->get_type()->get_scalar_ty()->is_integer_ty(8) && NK % 4 == 0 &&
+                 tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 61;
+  unsigned k_width = is_dp4a ? 4 : 1;
+  auto ext = [&](Value* v){
+    if(v->getType()->isHalfTy() && v->getType() != c_ty)
+      return cast(llvm::Instruction::FPExt, v, c_ty);
+    if(is_int && v->getType() != c_ty && !is_dp4a)
+      return cast(llvm::Instruction::SExt, v, c_ty);
+    return v;
+  };
   std::map<std::pair<int, int>, Value*> has, hbs;
+  auto load_a = [&](unsigned row, unsigned k){
+    if(has.find({row, k}) == has.end()){
+      Value* off_k = i32(k*stride_a_k);
+      if(is_a_row && max_phase_a > 1)
+        off_k = xor_(off_k, get_phase(phases_a, off_a1, row, per_phase_a, max_phase_a));
+      has[{row, k}] = ext(load(gep(ptrs_a[0], add(i32(row*stride_a_m), off_k))));
+    }
+    return has[{row, k}];
+  };
+  auto load_b = [&](unsigned col, unsigned k){
+    if(hbs.find({col, k}) == hbs.end()){
+      Value* off_k = i32(k*stride_b_k);
+      if(!is_b_row && max_phase_b > 1)
+        off_k = xor_(off_k, get_phase(phases_b, off_b1, col, per_phase_b, max_phase_b));
+      hbs[{col, k}] = ext(load(gep(ptrs_b[0], add(i32(col*stride_b_n), off_k))));
+    }
+    return hbs[{col, k}];
+  };
+  std::map<std::pair<int, int>, Value*> has4, hbs4;
+  auto pack4 = [&](std::map<std::pair<int, int>, Value*>& packs, std::function<Value*(unsigned, unsigned)> load_x,
+                   unsigned row, unsigned k){
+    if(packs.find({row, k}) == packs.end()){
+      Value* pack = UndefValue::get(vec_ty(i8_ty, 4));
+      for(unsigned kk = 0; kk < 4; kk++)
+        pack = insert_elt(pack, load_x(row, k + kk), kk);
+      packs[{row, k}] = bit_cast(pack, i32_ty);
+    }
+    return packs[{row, k}];
+  };
+  InlineAsm *dp4a = InlineAsm::get(FunctionType::get(i32_ty, {i32_ty, i32_ty, i32_ty}, false),
+                                   "dp4a.s32.s32 $0, $1, $2, $3;", "=r,r,r,r", false);
+  std::map<indices_t, Value*> ret = vals_[D];
   auto ord = layout_c->get_order();
-  for(unsigned k = 0; k < NK; k++){
+  for(unsigned k = 0; k < NK; k += k_width){
     int z = 0;
     for(unsigned i = 0; i < shape_c[ord[1]]; i += layout_c->shape_per_cta(ord[1]))
     for(unsigned j = 0; j < shape_c[ord[0]]; j += layout_c->shape_per_cta(ord[0]))
@@ -2196,17 +3167,13 @@ void generator::visit_fmadot(ir::dot_inst* C, ir::value* A, ir::value* B, ir::va
       unsigned n = (ord[0] == 1) ? j : i;
       unsigned mm = (ord[0] == 1) ? ii : jj;
       unsigned nn = (ord[0] == 1) ? jj : ii;
-      if(has.find({m + mm, k}) == has.end()){
-        Value* pa = gep(ptrs_a[0], i32((m + mm)*stride_a_m + k*stride_a_k));
-        Value* va = load(pa);
-        has[{m + mm, k}] = va;
-      }
-      if(hbs.find({n + nn, k}) == hbs.end()){
-        Value* pb = gep(ptrs_b[0], i32((n + nn)*stride_b_n + k*stride_b_k));
-        Value* vb = load(pb);
-        hbs[{n + nn, k}] = vb;
-      }
-      ret[idxs_[C].at(z)] = call(f_mul_add, {has[{m+mm,k}], hbs[{n+nn, k}], ret[idxs_[C].at(z)]});
+      Value*& acc = ret[idxs_[C].at(z)];
+      if(is_dp4a)
+        acc = call(dp4a, {pack4(has4, load_a, m + mm, k), pack4(hbs4, load_b, n + nn, k), acc});
+      else if(is_int)
+        acc = add(mul(load_a(m + mm, k), load_b(n + nn, k)), acc);
+      else
+        acc = call(f_mul_add, {load_a(m + mm, k), load_b(n + nn, k), acc});
       z++;
     }
   }
@@ -2216,6 +3183,90 @@ void generator::visit_fmadot(ir::dot_inst* C, ir::value* A, ir::value* B, ir::va
   }
 }
 
+/**
+ * \brief Code Generation for `dot` with the matrix cores of AMD GPUs
+ *
+ * Each wavefront computes 32x32 tiles of C (see `visit_layout_mma`), with one
+ * v_mfma_f32_32x32x8f16 per group of 8 along k, for which lane `l` holds
+ * A[l % 32, 4*(l / 32) + {0, 1, 2, 3}] and B[4*(l / 32) + {0, 1, 2, 3}, l % 32].
+ * Operands are read from shared memory with the swizzle they were written with,
+ * 4 halves at a time when they are contiguous along k
+ */
+void generator::visit_mfma(ir::dot_inst* C, ir::value *A, ir::value *B, ir::value *D, unsigned NK) {
+  analysis::mma_layout* layout = layouts_->get(C)->to_mma();
+  analysis::shared_layout* layout_a = layouts_->get(A)->to_shared();
+  analysis::shared_layout* layout_b = layouts_->get(B)->to_shared();
+  auto shape_c = C->get_type()->get_block_shapes();
+  Module *module = builder_->GetInsertBlock()->getModule();
+  Function *mfma = Intrinsic::getDeclaration(module, Intrinsic::amdgcn_mfma_f32_32x32x8f16);
+
+  Value* thread = thread_id();
+  Value* lane = urem(thread, i32(64));
+  Value* wave = udiv(thread, i32(64));
+  Value* wave_0 = urem(wave, i32(layout->wpt(0)));
+  Value* wave_1 = urem(udiv(wave, i32(layout->wpt(0))), i32(layout->wpt(1)));
+  Value* off_m = add(mul(wave_0, i32(layout->spw(0))), urem(lane, i32(32)));
+  Value* off_n = add(mul(wave_1, i32(layout->spw(1))), urem(lane, i32(32)));
+  Value* off_k = mul(udiv(lane, i32(32)), i32(4));
+
+  // reads the 4 elements (idx_0 + {0..3}, idx_1) of a tile when `k` is its first
+  // axis (B), or (idx_0, idx_1 + {0..3}) when it is its second one (A)
+  auto load_x4 = [&](ir::value* X, analysis::shared_layout* layout_x, unsigned k_axis, Value* idx_0, Value* idx_1) -> Value* {
+    auto ord = layout_x->get_order();
+    auto shape = layout_x->get_shape();
+    int per_phase = swizzle_->get_per_phase(layout_x);
+    int max_phase = swizzle_->get_max_phase(layout_x);
+    int vec = swizzle_->get_vec(layout_x);
+    auto offset = [&](Value* idx_0, Value* idx_1){
+      indices_t idx = {idx_0, idx_1};
+      Value* row = idx[ord[1]];
+      Value* col = idx[ord[0]];
+      if(max_phase > 1){
+        Value* phase = urem(udiv(row, i32(per_phase)), i32(max_phase));
+        col = add(mul(xor_(udiv(col, i32(vec)), phase), i32(vec)), urem(col, i32(vec)));
+      }
+      return add(mul(row, i32(shape[ord[0]])), col);
+    };
+    Value* ptr = gep(shmems_[X], offset(idx_0, idx_1));
+    if(ord[0] == (int)k_axis)
+      return load(bit_cast(ptr, ptr_ty(vec_ty(f16_ty, 4), 3)));
+    Value* ret = UndefValue::get(vec_ty(f16_ty, 4));
+    for(unsigned q = 0; q < 4; q++){
+      Value* idx_0_q = k_axis == 0 ? add(idx_0, i32(q)) : idx_0;
+      Value* idx_1_q = k_axis == 1 ? add(idx_1, i32(q)) : idx_1;
+      ret = insert_elt(ret, load(gep(shmems_[X], offset(idx_0_q, idx_1_q))), q);
+    }
+    return ret;
+  };
+  std::map<std::pair<unsigned, unsigned>, Value*> has, hbs;
+  auto get_a = [&](unsigned m, unsigned k){
+    if(has.find({m, k}) == has.end())
+      has[{m, k}] = load_x4(A, layout_a, 1, add(off_m, i32(m)), add(off_k, i32(k)));
+    return has[{m, k}];
+  };
+  auto get_b = [&](unsigned n, unsigned k){
+    if(hbs.find({n, k}) == hbs.end())
+      hbs[{n, k}] = load_x4(B, layout_b, 0, add(off_k, i32(k)), add(off_n, i32(n)));
+    return hbs[{n, k}];
+  };
+
+  const std::vector<Value*>& idx_m = axes_.at(a_axes_->get(C, 0)).values;
+  const std::vector<Value*>& idx_n = axes_.at(a_axes_->get(C, 1)).values;
+  unsigned num_m = shape_c[0] / layout->shape_per_cta(0);
+  unsigned num_n = shape_c[1] / layout->shape_per_cta(1);
+  for(unsigned i = 0; i < num_m; i++)
+  for(unsigned j = 0; j < num_n; j++){
+    Value* acc = UndefValue::get(vec_ty(f32_ty, 16));
+    for(unsigned r = 0; r < 16; r++)
+      acc = insert_elt(acc, vals_[D][{idx_m[i*16 + r], idx_n[j]}], r);
+    for(unsigned k = 0; k < NK; k += 8)
+      acc = call(mfma, {get_a(i*layout->shape_per_cta(0), k), get_b(j*layout->shape_per_cta(1), k), acc,
+                        i32(0), i32(0), i32(0)});
+    for(unsigned r = 0; r < 16; r++)
+      vals_[C][{idx_m[i*16 + r], idx_n[j]}] = extract_elt(acc, r);
+  }
+}
+
 /**
  * \brief Code Generation for `dot`
  * Dispatches to appropriate specialized function
@@ -2232,17 +3283,64 @@ void generator::visit_dot_inst(ir::dot_inst* dot) {
   size_t red_axis = 1;
   unsigned NK = A_shapes[red_axis];
   bool is_outer = NK == 1;
-  bool is_mma = layouts_->get(dot)->to_mma();
+  bool is_mma = tgt_->is_gpu() && layouts_->get(dot)->to_mma();
+  if(dot->is_sparse()){
+    if(!is_mma || !tgt_->as_nvidia() || tgt_->as_nvidia()->sm() < 80)
+      throw std::runtime_error("sparse dot requires the tensor cores of NVIDIA GPUs with sm >= 80, "
+                               "and fp16 or bf16 blocks of at least 16x32 by 32x16");
+    return visit_mma16816_sp(dot, A, B, D, dot->get_meta());
+  }
+  if(!tgt_->is_gpu())
+    return visit_host_dot(dot, A, B, D, c_ty, f_mul_add);
+  if(!is_outer && is_mma && layouts_->get(dot)->to_mma()->is_mfma())
+    return visit_mfma(dot, A, B, D, NK);
   if(!is_outer && is_mma && tgt_->as_nvidia()->sm() < 80)
     return visit_mma884(dot, A, B, D, NK);
   if(!is_outer && is_mma && tgt_->as_nvidia()->sm() >= 80)
     return visit_mma16816(dot, A, B, D, NK); // rename it as visit_mma_v2()?
-  if (dot->get_type()->get_scalar_ty()->is_fp32_ty() && 
-      A->get_type()->get_scalar_ty()->is_fp32_ty())
+  ir::type *a_ty = A->get_type()->get_scalar_ty();
+  ir::type *c_sca_ty = dot->get_type()->get_scalar_ty();
+  if((c_sca_ty->is_fp32_ty() && (a_ty->is_fp32_ty() || a_ty->is_fp16_ty())) ||
+     (c_sca_ty->is_fp16_ty() && a_ty->is_fp16_ty()) ||
+     (c_sca_ty->is_integer_ty(32) && a_ty->is_integer_ty(8)))
     return visit_fmadot(dot, A, B, D, NK, c_ty, f_mul_add);
   throw std::runtime_error("dot has invalid operand type");
 }
 
+/**
+ * \brief Code Generation for `dot` on the host. Programs run on a single thread,
+ * which holds all the elements of A, B and D
+ */
+void generator::visit_host_dot(ir::dot_inst* C, ir::value *A, ir::value *B, ir::value *D, Type *c_ty, Function *f_mul_add) {
+  // index constants are uniqued, so A[m, k] and B[k, n] can be
+  // looked up from the indices of C
+  std::map<std::pair<Value*, Value*>, Value*> va, vb;
+  std::vector<Value*> ks;
+  for(indices_t idx: idxs_.at(A)){
+    va[{idx[0], idx[1]}] = vals_[A][idx];
+    if(std::find(ks.begin(), ks.end(), idx[1]) == ks.end())
+      ks.push_back(idx[1]);
+  }
+  for(indices_t idx: idxs_.at(B))
+    vb[{idx[0], idx[1]}] = vals_[B][idx];
+  auto promote = [&](Value* v) -> Value* {
+    if(v->getType() == c_ty)
+      return v;
+    if(c_ty->isFloatingPointTy())
+      return v->getType()->isIntegerTy() ? builder_->CreateSIToFP(v, c_ty) : builder_->CreateFPExt(v, c_ty);
+    return builder_->CreateSExt(v, c_ty);
+  };
+  for(indices_t idx: idxs_.at(C)){
+    Value *acc = vals_[D][idx];
+    for(Value *k: ks){
+      Value *a = promote(va.at({idx[0], k}));
+      Value *b = promote(vb.at({k, idx[1]}));
+      acc = c_ty->isFloatingPointTy() ? call(f_mul_add, {a, b, acc}) : add(mul(a, b), acc);
+    }
+    vals_[C][idx] = acc;
+  }
+}
+
 void generator::visit_trans_inst(ir::trans_inst* trans) {
   throw std::runtime_error("not supported");
 }
@@ -2251,6 +3349,8 @@ void generator::visit_trans_inst(ir::trans_inst* trans) {
  * \brief Code Generation for `sqrt`
  */
 void generator::visit_sqrt_inst(ir::sqrt_inst* x) {
+  if(fast_math_ && tgt_->as_nvidia() && !x->get_type()->get_scalar_ty()->is_fp64_ty())
+    return visit_approx_inst(x, "sqrt.approx.ftz", "", 1);
   for(indices_t idx: idxs_.at(x)){
     Value *val = vals_[x->get_operand(0)][idx];
     Value *ret = intrinsic(Intrinsic::sqrt, {val->getType()}, {val});
@@ -2272,17 +3372,69 @@ Value* generator::shared_off(const std::vector<unsigned>& shapes, const std::vec
 }
 
 inline Value* generator::shfl_sync(Value* acc, int32_t i){
+  return shfl_sync(acc, i32(i), "bfly");
+}
+
+inline Value* generator::shfl_idx_sync(Value* acc, Value* lane){
+  return shfl_sync(acc, lane, "idx");
+}
+
+/**
+ * \brief Exchanges 32-bit values between the lanes of an AMD wavefront
+ *
+ * Butterflies within quads use DPP permutations and the other ones within 32
+ * lanes use ds_swizzle, neither of which goes through the LDS; butterflies
+ * across halves of the wavefront and indexed shuffles use ds_bpermute
+ */
+Value* generator::shfl_amd(Value* acc, Value* i, const std::string& mode){
+  Value* val = bit_cast(acc, i32_ty);
+  Value* ret;
+  ConstantInt* mask = dyn_cast<ConstantInt>(i);
+  if(mode == "bfly" && mask && mask->getZExtValue() < 3){
+    // quad_perm [1, 0, 3, 2] and [2, 3, 0, 1]
+    unsigned ctrl = mask->getZExtValue() == 1 ? 0xb1 : 0x4e;
+    ret = builder_->CreateIntrinsic(Intrinsic::amdgcn_update_dpp, {i32_ty},
+                                    {UndefValue::get(i32_ty), val, i32(ctrl), i32(0xf), i32(0xf), builder_->getFalse()});
+  }
+  else if(mode == "bfly" && mask && mask->getZExtValue() < 32){
+    // bitmask mode: and_mask = 0x1f, or_mask = 0, xor_mask = `mask`
+    unsigned pattern = 0x1f | (mask->getZExtValue() << 10);
+    ret = builder_->CreateIntrinsic(Intrinsic::amdgcn_ds_swizzle, {}, {val, i32(pattern)});
+  }
+  else{
+    Value* lane = urem(thread_id(), i32(64));
+    Value* src = mode == "bfly" ? xor_(lane, i) : i;
+    ret = builder_->CreateIntrinsic(Intrinsic::amdgcn_ds_bpermute, {}, {shl(src, i32(2)), val});
+  }
+  return bit_cast(ret, acc->getType());
+}
+
+Value* generator::shfl_sync(Value* acc, Value* i, const std::string& mode){
   Type* ty = acc->getType();
-  std::string asm_str = "shfl.sync.bfly.b32 $0, $1, $2, 0x1f, 0xffffffff;";
-  InlineAsm *shfl = InlineAsm::get(FunctionType::get(ty, {ty, i32_ty}, false), asm_str, "=f,f,r", false);
-  if(ty->getPrimitiveSizeInBits() <= 32)
-    return call(shfl, {acc, i32(i)});
+  std::string asm_str = "shfl.sync." + mode + ".b32 $0, $1, $2, 0x1f, 0xffffffff;";
+  InlineAsm *shfl_asm = InlineAsm::get(FunctionType::get(f32_ty, {f32_ty, i32_ty}, false), asm_str, "=f,f,r", false);
+  auto shfl = [&](Value* x) -> Value* {
+    return tgt_->as_amd() ? shfl_amd(x, i, mode) : call(shfl_asm, {x, i});
+  };
+  unsigned bits = ty->getPrimitiveSizeInBits();
+  if(ty->isFloatTy())
+    return shfl(acc);
+  // other 32-bit values (e.g., packed f16x2) travel as floats
+  if(bits == 32)
+    return bit_cast(shfl(bit_cast(acc, f32_ty)), ty);
+  // narrower values are extended to 32 bits
+  if(bits < 32){
+    Type* int_ty = builder_->getIntNTy(bits);
+    Value* ext = builder_->CreateZExt(bit_cast(acc, int_ty), i32_ty);
+    Value* ret = bit_cast(shfl(bit_cast(ext, f32_ty)), i32_ty);
+    return bit_cast(builder_->CreateTrunc(ret, int_ty), ty);
+  }
   acc = bit_cast(acc, vec_ty(f32_ty, 2));
   Value* acc0 = builder_->CreateExtractElement(acc, i32(0));
   Value* acc1 = builder_->CreateExtractElement(acc, i32(1));
   Value* ret = UndefValue::get(vec_ty(f32_ty, 2));
-  ret = insert_elt(ret, shfl_sync(acc0, i), i32(0));
-  ret = insert_elt(ret, shfl_sync(acc1, i), i32(1));
+  ret = insert_elt(ret, shfl_sync(acc0, i, mode), i32(0));
+  ret = insert_elt(ret, shfl_sync(acc1, i, mode), i32(1));
   return bit_cast(ret, ty);
 }
 
@@ -2292,28 +3444,82 @@ inline Value* generator::shfl_sync(Value* acc, int32_t i){
 void generator::visit_reduce1d_inst(ir::reduce_inst* x, std::function<Value*(Value*,Value*)> do_acc, Value *neutral) {
   std::map<indices_t, Value*> partial;
   ir::value *arg = x->get_operand(0);
-  Type *ret_ty = cvt(x->get_type()->get_scalar_ty());
+  Type *ty = cvt(arg->get_type()->get_scalar_ty());
   Value *acc = nullptr;
-
-  // reduce within thread
-  for(indices_t idx: idxs_.at(arg)){
-    Value *val = vals_[arg][idx];
-    acc = !acc ? val : do_acc(acc, val);
+  // arg reductions carry the index of the partial alongside its value
+  Value *acc_idx = nullptr;
+  ir::reduce_inst::op_t op = x->get_op();
+  auto accumulate = [&](Value *&acc, Value *&acc_idx, Value *val, Value *val_idx) {
+    if(!x->is_arg())
+      acc = do_acc(acc, val);
+    else
+      reduce_arg_op(op, acc, acc_idx, val, val_idx);
+  };
+  const std::vector<indices_t>& idxs = idxs_.at(arg);
+  // fp16 partials are reduced in pairs, so that each shuffle moves two of them
+  bool packed = tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 53 && ty->isHalfTy() &&
+                idxs.size() >= 2 && (op == ir::reduce_inst::FADD || op == ir::reduce_inst::FMAX ||
+                                     op == ir::reduce_inst::FMIN);
+  if(packed){
+    // reduce within thread
+    Value *acc2 = nullptr;
+    for(size_t i = 0; i < idxs.size(); i += 2){
+      Value *hi = i + 1 < idxs.size() ? vals_[arg][idxs[i + 1]] : neutral;
+      Value *pair = UndefValue::get(vec_ty(f16_ty, 2));
+      pair = insert_elt(pair, vals_[arg][idxs[i]], i32(0));
+      pair = insert_elt(pair, hi, i32(1));
+      acc2 = !acc2 ? pair : do_acc(acc2, pair);
+    }
+    // reduce within warp
+    for(int i = warp_size_/2; i > 0; i >>= 1)
+      acc2 = do_acc(acc2, shfl_sync(acc2, i));
+    acc = do_acc(extract_elt(acc2, i32(0)), extract_elt(acc2, i32(1)));
+  }
+  else{
+    // reduce within thread
+    for(indices_t idx: idxs){
+      Value *val = vals_[arg][idx];
+      if(!acc){
+        acc = val;
+        acc_idx = idx[0];
+      }
+      else
+        accumulate(acc, acc_idx, val, idx[0]);
+    }
+    // on the host, the only thread holds the whole block
+    if(!tgt_->is_gpu()){
+      for(indices_t idx: idxs_.at(x))
+        vals_[x][idx] = x->is_arg() ? acc_idx : acc;
+      return;
+    }
+    // reduce within wrap
+    for(int i = warp_size_/2; i > 0; i >>= 1){
+      Value *val = shfl_sync(acc, i);
+      Value *val_idx = x->is_arg() ? shfl_sync(acc_idx, i) : nullptr;
+      accumulate(acc, acc_idx, val, val_idx);
+    }
   }
-  // reduce within wrap
-  for(int i = 16; i > 0; i >>= 1)
-    acc = do_acc(acc, shfl_sync(acc, i));
   // pointers
   unsigned addr_space = shmem_->getType()->getPointerAddressSpace();
-  Value *base = bit_cast(shmem_, ptr_ty(ret_ty, addr_space));
-  Value* thread = tgt_->get_local_id(mod_, *builder_, 0);
-  Value* warp = udiv(thread, i32(32));
-  Value* lane = urem(thread, i32(32));
+  Value *base = bit_cast(shmem_, ptr_ty(ty, addr_space));
+  Value *idx_base = nullptr;
+  if(x->is_arg()){
+    unsigned size = layouts_->get(layouts_->tmp(x))->get_shape()[0];
+    unsigned stride = std::max<unsigned>(ty->getPrimitiveSizeInBits(), 32) / 32;
+    idx_base = gep(bit_cast(shmem_, ptr_ty(i32_ty, addr_space)), i32(size * stride));
+  }
+  Value* thread = thread_id();
+  Value* warp = udiv(thread, i32(warp_size_));
+  Value* lane = urem(thread, i32(warp_size_));
   // store warp result in shared memory
   add_barrier();
   store(neutral, gep(base, lane));
+  if(idx_base)
+    store(i32(INT32_MAX), gep(idx_base, lane));
   add_barrier();
   store(acc, gep(base, warp));
+  if(idx_base)
+    store(acc_idx, gep(idx_base, warp));
   add_barrier();
 
   // reduce across warps
@@ -2325,15 +3531,20 @@ void generator::visit_reduce1d_inst(ir::reduce_inst* x, std::function<Value*(Val
   dummy->removeFromParent();
   builder_->SetInsertPoint(term);
   Value* ret = load(gep(base, thread));
-  for(int i = (num_warps_+1)/2; i > 0; i >>= 1){
+  Value* ret_idx = idx_base ? load(gep(idx_base, thread)) : nullptr;
+  int num_warps = num_warps_*32 / warp_size_;
+  for(int i = (num_warps+1)/2; i > 0; i >>= 1){
     Value *current = shfl_sync(ret, i);
-    ret = do_acc(ret, current);
+    Value *current_idx = idx_base ? shfl_sync(ret_idx, i) : nullptr;
+    accumulate(ret, ret_idx, current, current_idx);
   }
   store(ret, gep(base, thread));
+  if(idx_base)
+    store(ret_idx, gep(idx_base, thread));
 
   // store first warp done
   builder_->SetInsertPoint(barrier->getParent());
-  ret = load(base);
+  ret = idx_base ? load(idx_base) : load(base);
   for(indices_t idx: idxs_.at(x))
     vals_[x][idx] = ret;
 }
@@ -2343,17 +3554,30 @@ void generator::visit_reduce1d_inst(ir::reduce_inst* x, std::function<Value*(Val
  */
 void generator::visit_reducend_inst(ir::reduce_inst* x, std::function<Value*(Value*,Value*)> do_acc, Value *neutral) {
   ir::value *arg = x->get_operand(0);
-  Type *ty = cvt(x->get_type()->get_scalar_ty());
+  Type *ty = cvt(arg->get_type()->get_scalar_ty());
   unsigned axis = x->get_axis();
+  ir::reduce_inst::op_t op = x->get_op();
+  auto accumulate = [&](Value *&acc, Value *&acc_idx, Value *val, Value *val_idx) {
+    if(!x->is_arg())
+      acc = do_acc(acc, val);
+    else
+      reduce_arg_op(op, acc, acc_idx, val, val_idx);
+  };
 
   // reduce within thread
   std::map<indices_t, Value*> accs;
+  std::map<indices_t, Value*> acc_idxs;
   for(indices_t idx: idxs_.at(arg)){
     indices_t pidx = idx;
     pidx[axis] = i32(0);
     Value *current = vals_[arg][idx];
     bool is_first = accs.find(pidx) == accs.end();
-    accs[pidx] = is_first ? current : do_acc(accs[pidx], current);
+    if(is_first){
+      accs[pidx] = current;
+      acc_idxs[pidx] = idx[axis];
+    }
+    else
+      accumulate(accs[pidx], acc_idxs[pidx], current, idx[axis]);
   };
 
   // reduce within blocks
@@ -2363,18 +3587,29 @@ void generator::visit_reducend_inst(ir::reduce_inst* x, std::function<Value*(Val
   auto order  = layout->get_order();
   int  space = base->getType()->getPointerAddressSpace();
   Value *ptr = bit_cast(base, ptr_ty(ty, space));
+  // indices of arg reductions are staged after the values
+  Value *idx_ptr = nullptr;
+  if(x->is_arg()){
+    unsigned size = std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<unsigned>());
+    unsigned stride = std::max<unsigned>(ty->getPrimitiveSizeInBits(), 32) / 32;
+    idx_ptr = gep(bit_cast(base, ptr_ty(i32_ty, space)), i32(size * stride));
+  }
   Value *lane = axes_.at(a_axes_->get(arg, axis)).thread_id;
   for(auto& x: accs) {
     // current element being computed
     Value *&acc = x.second;
+    Value *&acc_idx = acc_idxs[x.first];
     indices_t write_idx = x.first;
     write_idx[axis] = lane;
     // shared memory write  pointer
     Value *write_off = shared_off(shape, order, write_idx);
     Value *write_ptr = gep(ptr, write_off);
+    Value *write_idx_ptr = idx_ptr ? gep(idx_ptr, write_off) : nullptr;
     // initialize shared memory
     add_barrier();
     store(acc, write_ptr);
+    if(idx_ptr)
+      store(acc_idx, write_idx_ptr);
     // build result
     indices_t idx(write_idx.size(), i32(0));
     for(size_t i = shape[axis]/2; i > 0; i >>= 1){
@@ -2385,9 +3620,13 @@ void generator::visit_reducend_inst(ir::reduce_inst* x, std::function<Value*(Val
       Value *read_ptr = gep(write_ptr, read_off);
       add_barrier();
       // update accumulator
-      acc = do_acc(acc, load(read_ptr));
+      Value *current = load(read_ptr);
+      Value *current_idx = idx_ptr ? load(gep(write_idx_ptr, read_off)) : nullptr;
+      accumulate(acc, acc_idx, current, current_idx);
       add_barrier();
       store(acc, write_ptr);
+      if(idx_ptr)
+        store(acc_idx, write_idx_ptr);
     }
   }
   add_barrier();
@@ -2397,7 +3636,7 @@ void generator::visit_reducend_inst(ir::reduce_inst* x, std::function<Value*(Val
     indices_t read_idx = idx;
     read_idx.insert(read_idx.begin() + axis, i32(0));
     Value *read_off = shared_off(shape, order, read_idx);
-    Value *read_ptr = gep(ptr, read_off);
+    Value *read_ptr = gep(idx_ptr ? idx_ptr : ptr, read_off);
     vals_[x][idx] = load(read_ptr);
   };
 }
@@ -2406,44 +3645,194 @@ void generator::visit_reducend_inst(ir::reduce_inst* x, std::function<Value*(Val
  * \brief Code Generation for `reduce` (generic case)
  */
 void generator::visit_reduce_inst(ir::reduce_inst* x) {
-  Type *ty = cvt(x->get_type()->get_scalar_ty());
+  ir::value *arg = x->get_operand(0);
+  Type *ty = cvt(arg->get_type()->get_scalar_ty());
   // accumulation function
   ir::reduce_inst::op_t op = x->get_op();
   auto do_acc = [&](Value *x, Value *y) -> Value* {
-    switch(op){
-    case ir::reduce_inst::ADD: return add(x, y);
-    case ir::reduce_inst::SUB: return sub(x, y);
-    case ir::reduce_inst::MAX: return select(icmp_sge(x, y), x, y);
-    case ir::reduce_inst::MIN: return select(icmp_sle(x, y), x, y);
-    case ir::reduce_inst::FADD: return fadd(x, y);
-    case ir::reduce_inst::FSUB: return fsub(x, y);
-    case ir::reduce_inst::FMAX: return max_num(x, y);
-    case ir::reduce_inst::FMIN: return min_num(x, y);
-    case ir::reduce_inst::XOR: return xor_(x, y);
-    default: throw std::runtime_error("unreachable");
-    }
+    return reduce_op(op, x, y);
   };
   // neutral element
-  Value *neutral;
-  switch(op) {
-    case ir::reduce_inst::ADD: neutral = ConstantInt::get(ty, 0); break;
-    case ir::reduce_inst::SUB:  neutral = ConstantInt::get(ty, 0); break;
-    case ir::reduce_inst::MAX:  neutral = ConstantInt::get(ty, INT32_MIN); break;
-    case ir::reduce_inst::MIN:  neutral = ConstantInt::get(ty, INT32_MAX); break;
-    case ir::reduce_inst::FADD: neutral = ConstantFP::get(ty, 0); break;
-    case ir::reduce_inst::FSUB: neutral = ConstantFP::get(ty, 0); break;
-    case ir::reduce_inst::FMAX: neutral = ConstantFP::get(ty, -INFINITY); break;
-    case ir::reduce_inst::FMIN: neutral = ConstantFP::get(ty, INFINITY); break;
-    case ir::reduce_inst::XOR: neutral = neutral = ConstantInt::get(ty, 0); break;
-    default: throw std::runtime_error("unreachable");
-  }
-  ir::value *arg = x->get_operand(0);
+  Value *neutral = reduce_neutral(op, ty);
   if(arg->get_type()->get_tile_rank() == 1)
     visit_reduce1d_inst(x, do_acc, neutral);
   else
     visit_reducend_inst(x, do_acc, neutral);
 }
 
+Value* generator::reduce_op(ir::reduce_inst::op_t op, Value *x, Value *y) {
+  switch(op){
+  case ir::reduce_inst::ADD: return add(x, y);
+  case ir::reduce_inst::SUB: return sub(x, y);
+  case ir::reduce_inst::MAX: return select(icmp_sge(x, y), x, y);
+  case ir::reduce_inst::MIN: return select(icmp_sle(x, y), x, y);
+  case ir::reduce_inst::FADD: return fadd(x, y);
+  case ir::reduce_inst::FSUB: return fsub(x, y);
+  case ir::reduce_inst::FMAX: return max_num(x, y);
+  case ir::reduce_inst::FMIN: return min_num(x, y);
+  case ir::reduce_inst::XOR: return xor_(x, y);
+  default: throw std::runtime_error("unreachable");
+  }
+}
+
+/**
+ * \brief Accumulates (y, y_idx) into (x, x_idx) for arg reductions.
+ * Ties keep the smaller index, and NaNs are ignored like in `FMAX`/`FMIN`,
+ * so that the result does not depend on the shape of the reduction tree
+ */
+void generator::reduce_arg_op(ir::reduce_inst::op_t op, Value *&x, Value *&x_idx, Value *y, Value *y_idx) {
+  Value *better;
+  switch(op){
+  case ir::reduce_inst::ARGMAX: better = icmp(CmpInst::ICMP_SGT, y, x); break;
+  case ir::reduce_inst::ARGMIN: better = icmp(CmpInst::ICMP_SLT, y, x); break;
+  case ir::reduce_inst::ARGFMAX: better = fcmp(CmpInst::FCMP_OGT, y, x); break;
+  case ir::reduce_inst::ARGFMIN: better = fcmp(CmpInst::FCMP_OLT, y, x); break;
+  default: throw std::runtime_error("unreachable");
+  }
+  Value *tie = and_(x->getType()->isFloatingPointTy() ? fcmp(CmpInst::FCMP_OEQ, y, x) : icmp_eq(y, x),
+                    icmp(CmpInst::ICMP_SLT, y_idx, x_idx));
+  Value *take = builder_->CreateOr(better, tie);
+  if(x->getType()->isFloatingPointTy())
+    take = builder_->CreateOr(take, and_(fcmp(CmpInst::FCMP_UNO, x, x), fcmp(CmpInst::FCMP_ORD, y, y)));
+  x = select(take, y, x);
+  x_idx = select(take, y_idx, x_idx);
+}
+
+Value* generator::reduce_neutral(ir::reduce_inst::op_t op, Type *ty) {
+  switch(op) {
+    case ir::reduce_inst::ADD:  return ConstantInt::get(ty, 0);
+    case ir::reduce_inst::SUB:  return ConstantInt::get(ty, 0);
+    case ir::reduce_inst::MAX:  return ConstantInt::get(ty, INT32_MIN);
+    case ir::reduce_inst::MIN:  return ConstantInt::get(ty, INT32_MAX);
+    case ir::reduce_inst::FADD: return ConstantFP::get(ty, 0);
+    case ir::reduce_inst::FSUB: return ConstantFP::get(ty, 0);
+    case ir::reduce_inst::FMAX: return ConstantFP::get(ty, -INFINITY);
+    case ir::reduce_inst::FMIN: return ConstantFP::get(ty, INFINITY);
+    case ir::reduce_inst::XOR:  return ConstantInt::get(ty, 0);
+    case ir::reduce_inst::ARGMAX:  return ConstantInt::get(ty, INT32_MIN);
+    case ir::reduce_inst::ARGMIN:  return ConstantInt::get(ty, INT32_MAX);
+    case ir::reduce_inst::ARGFMAX: return ConstantFP::get(ty, -INFINITY);
+    case ir::reduce_inst::ARGFMIN: return ConstantFP::get(ty, INFINITY);
+    default: throw std::runtime_error("unreachable");
+  }
+}
+
+/**
+ * \brief Code Generation for `scan`
+ *
+ * Each thread scans its contiguous elements sequentially, threads of a warp
+ * combine their totals with butterfly shuffles, and warps exchange theirs
+ * through shared memory. Repetitions of the layout along the axis are
+ * processed in order, each starting from the total of the previous ones
+ */
+void generator::visit_scan_inst(ir::scan_inst* x) {
+  ir::value *arg = x->get_operand(0);
+  ir::reduce_inst::op_t op = x->get_op();
+  unsigned axis = x->get_axis();
+  Type *ty = cvt(x->get_type()->get_scalar_ty());
+  Value *neutral = reduce_neutral(op, ty);
+  auto do_acc = [&](Value *x, Value *y) -> Value* {
+    return reduce_op(op, x, y);
+  };
+  analysis::scanline_layout* layout = layouts_->get(arg)->to_scanline();
+  int nts = layout->nts(axis);
+  int mts = layout->mts(axis);
+  // consecutive threads along the axis are `stride` apart, and groups of
+  // `lanes` of them are in the same warp
+  int stride = 1;
+  for(int d: layout->get_order()){
+    if(d == (int)axis)
+      break;
+    stride *= layout->mts(d);
+  }
+  int lanes = std::max(std::min(mts, (int)warp_size_ / stride), 1);
+  int warps = mts / lanes;
+  const distributed_axis& dax = axes_.at(a_axes_->get(arg, axis));
+  Value *lane = urem(dax.thread_id, i32(lanes));
+  Value *warp = udiv(dax.thread_id, i32(lanes));
+  int reps = dax.values.size() / nts;
+  // rows of elements that only differ along the axis
+  std::vector<indices_t> rows;
+  std::set<indices_t> seen;
+  for(indices_t idx: idxs_.at(arg)){
+    idx[axis] = i32(0);
+    if(seen.insert(idx).second)
+      rows.push_back(idx);
+  }
+  // shared memory that holds the total of each warp along the axis
+  Value *tmp = nullptr;
+  std::vector<unsigned> tmp_shape;
+  std::vector<int> tmp_order;
+  if(warps > 1){
+    analysis::data_layout* tmp_layout = layouts_->get(layouts_->tmp(x));
+    Value *base = shared_ptr_.at(tmp_layout);
+    tmp = bit_cast(base, ptr_ty(ty, base->getType()->getPointerAddressSpace()));
+    tmp_shape = tmp_layout->get_shape();
+    tmp_order = tmp_layout->get_order();
+  }
+  std::vector<Value*> carry(rows.size(), nullptr);
+  for(int r = 0; r < reps; r++){
+    std::vector<std::vector<Value*>> incl(rows.size());
+    std::vector<Value*> prefix(rows.size(), neutral);
+    std::vector<Value*> total(rows.size());
+    for(size_t n = 0; n < rows.size(); n++){
+      // scan within thread
+      for(int j = 0; j < nts; j++){
+        indices_t idx = rows[n];
+        idx[axis] = dax.values[r*nts + j];
+        Value *val = vals_[arg][idx];
+        incl[n].push_back(j == 0 ? val : do_acc(incl[n].back(), val));
+      }
+      // scan within warp
+      total[n] = incl[n].back();
+      for(int i = 1; i < lanes; i <<= 1){
+        Value *other = shfl_sync(total[n], i*stride);
+        Value *after = builder_->CreateICmpNE(and_(lane, i32(i)), i32(0));
+        prefix[n] = select(after, do_acc(other, prefix[n]), prefix[n]);
+        total[n] = do_acc(total[n], other);
+      }
+    }
+    // scan across warps
+    if(warps > 1){
+      add_barrier();
+      for(size_t n = 0; n < rows.size(); n++){
+        indices_t idx = rows[n];
+        idx[axis] = warp;
+        store(total[n], gep(tmp, shared_off(tmp_shape, tmp_order, idx)));
+      }
+      add_barrier();
+      for(size_t n = 0; n < rows.size(); n++){
+        Value *warp_prefix = neutral;
+        Value *warp_total = nullptr;
+        for(int w = 0; w < warps; w++){
+          indices_t idx = rows[n];
+          idx[axis] = i32(w);
+          Value *current = load(gep(tmp, shared_off(tmp_shape, tmp_order, idx)));
+          warp_prefix = select(icmp_ult(i32(w), warp), do_acc(warp_prefix, current), warp_prefix);
+          warp_total = warp_total ? do_acc(warp_total, current) : current;
+        }
+        prefix[n] = do_acc(warp_prefix, prefix[n]);
+        total[n] = warp_total;
+      }
+    }
+    // write back
+    for(size_t n = 0; n < rows.size(); n++){
+      Value *pre = carry[n] ? do_acc(carry[n], prefix[n]) : prefix[n];
+      for(int j = 0; j < nts; j++){
+        indices_t idx = rows[n];
+        idx[axis] = dax.values[r*nts + j];
+        if(x->is_exclusive())
+          vals_[x][idx] = j == 0 ? pre : do_acc(pre, incl[n][j - 1]);
+        else
+          vals_[x][idx] = do_acc(pre, incl[n][j]);
+      }
+      carry[n] = carry[n] ? do_acc(carry[n], total[n]) : total[n];
+    }
+  }
+  if(warps > 1)
+    add_barrier();
+}
+
 /**
  * \brief Code Generation for `select`
  */
@@ -2490,31 +3879,89 @@ void generator::visit_layout_convert(ir::value *out, ir::value *in){
   out_ord = out_layout->to_mma() ? in_ord : out_ord;
   int in_vec = out_ord[0] == 0 ? 1 : in_layout->contig_per_thread(in_ord[0]);
   int out_vec = out_ord[0] == 0 ? 1 : out_layout->contig_per_thread(out_ord[0]);
-  int pad = std::max(in_vec, out_vec);
+  ir::type *scalar_ty = out->get_type()->get_scalar_ty();
+  int pad = layouts_->convert_pad(in_layout, out_layout, scalar_ty);
   Value *in_ld = i32(shape[in_ord[0]] + pad);
   Value *out_ld = i32(shape[out_ord[0]] + pad);
+  // accumulators are stashed by stmatrix, one 16x8 tile of each warp after the
+  // other, by pairs along n: lanes 0-15 address the rows of a tile and lanes 16-31
+  // those of the next one, or their columns when the buffer is column-major
+  bool stmatrix = layouts_->stmatrix_convert(in_layout, out_layout, scalar_ty);
+  Value *st_ptr = nullptr;
+  if(stmatrix){
+    Value *lane = urem(thread_id(), i32(32));
+    Value *row = sub(in_ax[0][0], udiv(lane, i32(4)));
+    Value *col = sub(in_ax[1][0], mul(urem(lane, i32(4)), i32(2)));
+    col = add(col, mul(udiv(lane, i32(16)), i32(in_layout->shape_per_cta(1))));
+    if(out_ord[0] == 1)
+      row = add(row, urem(lane, i32(16)));
+    else{
+      row = add(row, mul(urem(udiv(lane, i32(8)), i32(2)), i32(8)));
+      col = add(col, urem(lane, i32(8)));
+    }
+    indices_t offs = {row, col};
+    st_ptr = gep(base, add(offs[out_ord[0]], mul(out_ld, offs[out_ord[1]])));
+  }
   for(int i = 0; i < n_reps[0]; i++)
   for(int j = 0; j < n_reps[1]; j++){
     int max_ii, max_jj;
     add_barrier();
     max_ii = in_ax[0].size()/n_reps[0];
     max_jj = in_ax[1].size()/n_reps[1];
-    for(int ii = 0; ii < max_ii; ii++)
-    for(int jj = 0; jj < max_jj; jj+=in_vec){
-      // shared mem pointer
-      indices_t offs = {in_ax[0][ii], in_ax[1][jj]};
-      Value *off  = add(offs[out_ord[0]], mul(out_ld, offs[out_ord[1]]));
-      Value *ptr = gep(base, off);
-      // stash value to shared mem
-      Value* vals = UndefValue::get(vec_ty(ty, in_vec));
-      for(int jjj = 0; jjj < in_vec; jjj++){
-        indices_t idxs = {in_ax[0][i*max_ii + ii],
-                          in_ax[1][j*max_jj + jj + jjj]};
-        Value* val = bit_cast(vals_[in][idxs], ty);
-        vals = insert_elt(vals, val, jjj);
+    if(stmatrix){
+      int ld = shape[out_ord[0]] + pad;
+      // pairs of tiles along n, or single tiles when a warp has an odd number of them
+      int num_mats = (max_jj/2) % 2 == 0 ? 4 : 2;
+      std::string trans = out_ord[0] == 0 ? ".trans" : "";
+      std::vector<Type*> arg_tys(num_mats + 1, i32_ty);
+      arg_tys[0] = st_ptr->getType();
+      std::string regs, cstr = "r";
+      for(int m = 0; m < num_mats; m++){
+        regs += (m ? ", $" : "$") + std::to_string(m + 1);
+        cstr += ",r";
+      }
+      FunctionType *st_ty = FunctionType::get(void_ty, arg_tys, false);
+      InlineAsm *st_fn = InlineAsm::get(st_ty,
+                                        "stmatrix.sync.aligned.m8n8.x" + std::to_string(num_mats) + trans +
+                                        ".shared.b16 [$0], {" + regs + "};", cstr, true);
+      for(int ii = 0; ii < max_ii; ii += 2)
+      for(int jj = 0; jj < max_jj; jj += num_mats){
+        // offset of the tiles from those of the first rows and columns of the warp
+        int off_0 = ii/2 * in_layout->shape_per_cta(0);
+        int off_1 = jj/2 * in_layout->shape_per_cta(1);
+        int off = out_ord[0] == 1 ? off_1 + ld*off_0 : off_0 + ld*off_1;
+        std::vector<Value*> args = {gep(st_ptr, i32(off))};
+        // rows 0-7 then 8-15 of each tile
+        for(int m = 0; m < num_mats; m++){
+          Value *pair = UndefValue::get(vec_ty(ty, 2));
+          for(int k = 0; k < 2; k++){
+            indices_t idxs = {in_ax[0][i*max_ii + ii + m%2],
+                              in_ax[1][j*max_jj + jj + m/2*2 + k]};
+            pair = insert_elt(pair, bit_cast(vals_[in][idxs], ty), k);
+          }
+          args.push_back(bit_cast(pair, i32_ty));
+        }
+        call(st_ty, st_fn, args);
+      }
+    }
+    else{
+      for(int ii = 0; ii < max_ii; ii++)
+      for(int jj = 0; jj < max_jj; jj+=in_vec){
+        // shared mem pointer
+        indices_t offs = {in_ax[0][ii], in_ax[1][jj]};
+        Value *off  = add(offs[out_ord[0]], mul(out_ld, offs[out_ord[1]]));
+        Value *ptr = gep(base, off);
+        // stash value to shared mem
+        Value* vals = UndefValue::get(vec_ty(ty, in_vec));
+        for(int jjj = 0; jjj < in_vec; jjj++){
+          indices_t idxs = {in_ax[0][i*max_ii + ii],
+                            in_ax[1][j*max_jj + jj + jjj]};
+          Value* val = bit_cast(vals_[in][idxs], ty);
+          vals = insert_elt(vals, val, jjj);
+        }
+        ptr = bit_cast(ptr, ptr_ty(vals->getType(), ptr->getType()->getPointerAddressSpace()));
+        store(vals, ptr);
       }
-      ptr = bit_cast(ptr, ptr_ty(vals->getType(), ptr->getType()->getPointerAddressSpace()));
-      store(vals, ptr);
     }
     add_barrier();
     max_ii = out_ax[0].size()/n_reps[0];
@@ -2538,14 +3985,268 @@ void generator::visit_layout_convert(ir::value *out, ir::value *in){
   }
 }
 
+/**
+ * \brief Code Generation for layout conversions that keep every element in its warp:
+ * each register of `out` is read from the lane of `in` that holds it, once for
+ * each register of `in` that holds it in some lane
+ */
+void generator::visit_layout_convert_shfl(ir::value *out, ir::value *in, const std::vector<std::vector<int>>& in_regs,
+                                          const std::vector<bool>& same_lane) {
+  analysis::scanline_layout* in_layout = layouts_->get(in)->to_scanline();
+  size_t dim = out->get_type()->get_tile_rank();
+  std::vector<std::vector<Value*>> in_ax, out_ax;
+  for(size_t d = 0; d < dim; d++){
+    in_ax.push_back(axes_.at(a_axes_->get(in, d)).values);
+    out_ax.push_back(axes_.at(a_axes_->get(out, d)).values);
+  }
+  const auto& in_ord = in_layout->get_order();
+  // value of register `q` of `in`
+  auto get_in = [&](int q) {
+    indices_t in_idx(dim);
+    for(size_t k = 0; k < dim; k++){
+      in_idx[k] = in_ax[k][q % in_ax[k].size()];
+      q /= in_ax[k].size();
+    }
+    return vals_[in][in_idx];
+  };
+  for(size_t reg = 0; reg < in_regs.size(); reg++){
+    indices_t out_idx(dim);
+    for(size_t k = 0, r = reg; k < dim; k++){
+      out_idx[k] = out_ax[k][r % out_ax[k].size()];
+      r /= out_ax[k].size();
+    }
+    if(same_lane[reg]){
+      vals_[out][out_idx] = get_in(in_regs[reg][0]);
+      continue;
+    }
+    // lane and register of `in` that hold the element
+    Value* thread = i32(0);
+    for(int k = dim - 1; k >= 0; k--){
+      int d = in_ord[k];
+      Value* t = udiv(urem(out_idx[d], i32(in_layout->shape_per_cta(d))), i32(in_layout->nts(d)));
+      thread = add(mul(thread, i32(in_layout->mts(d))), t);
+    }
+    Value* lane = urem(thread, i32(warp_size_));
+    Value* in_reg = i32(0);
+    for(int k = dim - 1; k >= 0; k--){
+      int nts = in_layout->nts(k);
+      Value* r_k = add(mul(udiv(out_idx[k], i32(in_layout->shape_per_cta(k))), i32(nts)), urem(out_idx[k], i32(nts)));
+      in_reg = add(mul(in_reg, i32(in_ax[k].size())), r_k);
+    }
+    Value* ret = nullptr;
+    for(int q: in_regs[reg]){
+      Value* val = shfl_idx_sync(get_in(q), lane);
+      ret = ret ? select(icmp_eq(in_reg, i32(q)), val, ret) : val;
+    }
+    vals_[out][out_idx] = ret;
+  }
+}
+
 void generator::visit_cvt_layout_inst(ir::cvt_layout_inst *rc) {
-  visit_layout_convert(rc, rc->get_operand(0));
+  ir::value* arg = rc->get_operand(0);
+  analysis::scanline_layout* in_layout = layouts_->get(arg)->to_scanline();
+  analysis::scanline_layout* out_layout = layouts_->get(rc)->to_scanline();
+  std::vector<std::vector<int>> in_regs;
+  std::vector<bool> same_lane;
+  if(!layouts_->has_tmp(rc) && in_layout && out_layout &&
+     layouts_->shuffle_within_warps(in_layout, out_layout, in_regs, same_lane))
+    return visit_layout_convert_shfl(rc, arg, in_regs, same_lane);
+  visit_layout_convert(rc, arg);
+}
+
+/**
+ * \brief Buffers of kernel `fn` that TMA copies write (see analysis::layouts::get_tma): those
+ * whose swizzling is one of the TMA, i.e. none, or the index of the 16-byte vectors of rows
+ * of 32, 64 or 128 bytes xor-ed with that of the row modulo 8 in 1024-byte blocks, and that
+ * only loads of pointers in their order write. Kernels that call functions use cp.async, as
+ * `async_wait` could not count the commit groups of their callees
+ */
+std::vector<analysis::shared_layout*> generator::tma_buffers(ir::function* fn) {
+  std::vector<analysis::shared_layout*> ret;
+  if(!fn->get_is_kernel() || layouts_->get_tma().empty())
+    return ret;
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction *i: block->get_inst_list())
+    if(dynamic_cast<ir::call_inst*>(i))
+      return ret;
+  for(const auto& x: layouts_->get_all()){
+    analysis::shared_layout* layout = x.second->to_shared();
+    if(!layout || !layouts_->get_tma().count(layout) || !in_function(layout, fn))
+      continue;
+    bool ordered = true;
+    for(ir::value *v: layout->get_values())
+      if(auto *ld = dynamic_cast<ir::masked_load_async_inst*>(v))
+        ordered &= layouts_->get(ld->get_pointer_operand())->get_order() == layout->get_order();
+    unsigned dtsize = layout->get_type()->get_primitive_size_in_bits() / 8;
+    unsigned row_bytes = layout->get_shape()[layout->get_order(0)] * dtsize;
+    unsigned stage_bytes = layout->get_per_stage_elements() * dtsize;
+    unsigned vec = swizzle_->get_vec(layout);
+    unsigned per_phase = swizzle_->get_per_phase(layout);
+    unsigned max_phase = swizzle_->get_max_phase(layout);
+    if(!ordered)
+      continue;
+    // values of CUtensorMapSwizzle: none, and 32, 64 and 128-byte rows
+    if(max_phase == 1 && stage_bytes % 128 == 0)
+      tma_swizzle_[layout] = 0;
+    else if(vec*dtsize == 16 && per_phase*row_bytes == 128 && max_phase*16 == row_bytes && stage_bytes % 1024 == 0)
+      tma_swizzle_[layout] = row_bytes == 32 ? 1 : row_bytes == 64 ? 2 : 3;
+    else
+      continue;
+    ret.push_back(layout);
+  }
+  return ret;
+}
+
+/**
+ * \brief Initializes the TMA copies of kernel `fn`: the first thread initializes the mbarrier
+ * of each stage of their buffers, which expect one arrival, and their counters start at 0.
+ * Also records, for the runtime, how to encode the tensor map of each buffer from the
+ * parameters of the kernel (see `tensor_maps` in triton.cc), as
+ * `<base> <bytes of elements> <swizzle> <box> <box> <shape> <shape> <stride>`, of the
+ * contiguous dimension first, where the base, shape and stride (in elements) are `c<value>`
+ * constants or `p<offset>:<bytes>` parameters packed at `offset`
+ */
+void generator::init_tma(ir::function* fn) {
+  tma_descs_.clear();
+  tma_issued_.clear();
+  tma_waited_.clear();
+  tma_groups_.clear();
+  const std::vector<analysis::shared_layout*>& buffers = tma_buffers_[fn];
+  if(buffers.empty())
+    return;
+  Function *ret = fns_.at(fn);
+  // offsets of the parameters, packed as `rt::arg_packer` does
+  std::vector<std::string> params;
+  size_t offset = 0;
+  for(Argument& arg: ret->args()){
+    Type *ty = arg.getType();
+    size_t size = ty->isPointerTy() ? 8 : std::max<size_t>(ty->getPrimitiveSizeInBits() / 8, 1);
+    offset = (offset + size - 1) & ~(size - 1);
+    params.push_back("p" + std::to_string(offset) + ":" + std::to_string(size));
+    offset += size;
+  }
+  auto operand = [&](ir::value* v) {
+    if(auto *cst = dynamic_cast<ir::constant_int*>(v))
+      return "c" + std::to_string(cst->get_value());
+    return params.at(static_cast<ir::argument*>(v)->get_arg_no());
+  };
+  NamedMDNode *tensor_maps = mod_->getOrInsertNamedMetadata("triton.tensor_maps");
+  Value *is_first = icmp_eq(thread_id(), i32(0));
+  FunctionType *init_ty = FunctionType::get(void_ty, {builder_->getInt1Ty(), ptr_ty(builder_->getInt64Ty(), 3)}, false);
+  InlineAsm *init = InlineAsm::get(init_ty, "@$0 mbarrier.init.shared.b64 [$1], 1;", "b,r", true);
+  for(size_t k = 0; k < buffers.size(); k++){
+    analysis::shared_layout* layout = buffers[k];
+    tma_descs_[layout] = &*(ret->arg_begin() + fn->args().size() + k);
+    tma_issued_[layout] = builder_->CreateAlloca(i32_ty);
+    tma_waited_[layout] = builder_->CreateAlloca(i32_ty);
+    tma_groups_[layout] = builder_->CreateAlloca(builder_->getInt64Ty());
+    store(i32(0), tma_issued_[layout]);
+    store(i32(0), tma_waited_[layout]);
+    store(builder_->getInt64(0), tma_groups_[layout]);
+    Value *barriers = shared_ptr_.at(layouts_->get_tma().at(layout));
+    for(int s = 0; s < layout->get_num_stages(); s++)
+      call(init, {is_first, gep(barriers, i32(s))});
+    // description of the tensor map
+    ir::masked_load_async_inst *ld = nullptr;
+    for(ir::value *v: layout->get_values())
+      if(!ld)
+        ld = dynamic_cast<ir::masked_load_async_inst*>(v);
+    int inner = layout->get_order(0);
+    int outer = layout->get_order(1);
+    std::string desc = operand(ld->get_tile_base()) + " " +
+                       std::to_string(layout->get_type()->get_primitive_size_in_bits() / 8) + " " +
+                       std::to_string(tma_swizzle_.at(layout)) + " " +
+                       std::to_string(layout->get_shape()[inner]) + " " +
+                       std::to_string(layout->get_shape()[outer]) + " " +
+                       operand(ld->get_tile_shape(inner)) + " " + operand(ld->get_tile_shape(outer)) + " " +
+                       operand(ld->get_tile_stride(outer));
+    tensor_maps->addOperand(MDNode::get(*ctx_, MDString::get(*ctx_, desc)));
+  }
+  call(InlineAsm::get(FunctionType::get(void_ty, {}), "fence.mbarrier_init.release.cluster;", "", true));
+  add_barrier();
+}
+
+/**
+ * \brief Waits until the first `count` TMA copies to `layout` have landed, on the mbarriers of
+ * their stages, whose phases complete in the order the copies were issued
+ */
+void generator::wait_tma(analysis::shared_layout* layout, Value* count) {
+  unsigned stages = layout->get_num_stages();
+  Value *waited = tma_waited_.at(layout);
+  Value *barriers = shared_ptr_.at(layouts_->get_tma().at(layout));
+  BasicBlock *current = builder_->GetInsertBlock();
+  Function *fn = current->getParent();
+  BasicBlock *done = BasicBlock::Create(*ctx_, "tma_wait_done", fn, current->getNextNode());
+  BasicBlock *header = BasicBlock::Create(*ctx_, "tma_wait", fn, done);
+  BasicBlock *body = BasicBlock::Create(*ctx_, "tma_wait_body", fn, done);
+  br(header);
+  builder_->SetInsertPoint(header);
+  Value *n = load(waited);
+  cond_br(icmp(ICmpInst::ICMP_SLT, n, count), body, done);
+  builder_->SetInsertPoint(body);
+  Value *barrier = gep(barriers, urem(n, i32(stages)));
+  Value *parity = and_(udiv(n, i32(stages)), i32(1));
+  FunctionType *wait_ty = FunctionType::get(void_ty, {barrier->getType(), i32_ty}, false);
+  std::string wait_str = "{\n\t"
+                         ".reg .pred P1;\n\t"
+                         "LAB_WAIT:\n\t"
+                         "mbarrier.try_wait.parity.shared.b64 P1, [$0], $1;\n\t"
+                         "@P1 bra.uni DONE;\n\t"
+                         "bra.uni LAB_WAIT;\n\t"
+                         "DONE:\n\t"
+                         "}";
+  call(InlineAsm::get(wait_ty, wait_str, "r,r", true), {barrier, parity});
+  store(add(n, i32(1)), waited);
+  br(header);
+  builder_->SetInsertPoint(done);
+}
+
+/**
+ * \brief Code Generation for `masked_load_async` to a buffer written by TMA copies: once the
+ * copy that last used the mbarrier of its stage has landed, the first thread expects the
+ * bytes of the tile on it and copies the tile, whose out-of-bounds elements are zeros. The
+ * load still commits a group, which `async_wait` counts
+ */
+void generator::visit_tma_load(ir::masked_load_async_inst* x) {
+  analysis::shared_layout* layout = layouts_->get(x)->to_shared();
+  unsigned stages = layout->get_num_stages();
+  Value *issued = tma_issued_.at(layout);
+  Value *count = load(issued);
+  wait_tma(layout, sub(count, i32(stages - 1)));
+  Value *barrier = gep(shared_ptr_.at(layouts_->get_tma().at(layout)), urem(count, i32(stages)));
+  Value *dst = bit_cast(shmems_.at(x), ptr_ty(i8_ty, 3));
+  Value *desc = tma_descs_.at(layout);
+  // coordinates of the tile, of its contiguous dimension first
+  Value *coords[2];
+  for(unsigned d = 0; d < 2; d++)
+    coords[d] = builder_->CreateSExtOrTrunc(vals_[x->get_tile_offset(layout->get_order(d))][{}], i32_ty);
+  unsigned bytes = layout->get_per_stage_elements() * layout->get_type()->get_primitive_size_in_bits() / 8;
+  FunctionType *copy_ty = FunctionType::get(void_ty, {builder_->getInt1Ty(), dst->getType(), barrier->getType(),
+                                                      desc->getType(), i32_ty, i32_ty}, false);
+  std::string copy_str = "{\n\t"
+                         ".reg .b64 state;\n\t"
+                         "@$0 fence.proxy.async.shared::cta;\n\t"
+                         "@$0 mbarrier.arrive.expect_tx.shared.b64 state, [$2], " + std::to_string(bytes) + ";\n\t"
+                         "@$0 cp.async.bulk.tensor.2d.shared::cluster.global.mbarrier::complete_tx::bytes "
+                         "[$1], [$3, {$4, $5}], [$2];\n\t"
+                         "}";
+  call(InlineAsm::get(copy_ty, copy_str, "b,r,r,l,r,r", true),
+       {icmp_eq(thread_id(), i32(0)), dst, barrier, desc, coords[0], coords[1]});
+  store(add(count, i32(1)), issued);
+  call(InlineAsm::get(FunctionType::get(void_ty, {}), "cp.async.commit_group;", "", true));
 }
 
 void generator::visit_masked_load_async_inst(ir::masked_load_async_inst* x){
+  analysis::shared_layout* out_layout = layouts_->get(x)->to_shared();
+  // commit groups that hold TMA copies are tracked, for `async_wait` to count them
+  for(const auto& groups: tma_groups_){
+    Value *newest = builder_->getInt64(groups.first == out_layout);
+    store(builder_->CreateOr(shl(load(groups.second), 1), newest), groups.second);
+  }
+  if(tma_descs_.count(out_layout))
+    return visit_tma_load(x);
   unsigned in_vec = 1;
   ir::value *arg = x->get_pointer_operand();
-  analysis::shared_layout* out_layout = layouts_->get(x)->to_shared();
   analysis::scanline_layout* in_layout = layouts_->get(arg)->to_scanline();
   auto out_order = out_layout->get_order();
   auto in_order = in_layout->get_order();
@@ -2616,7 +4317,8 @@ void generator::visit_masked_load_async_inst(ir::masked_load_async_inst* x){
 //    if(Constant* cst = dyn_cast<Constant>(false_value))
 //      is_zero_false_value = cst->isZeroValue();
     Value* src_size = builder_->CreateSelect(vals_[x->get_mask_operand()][idx], i32(in_vec*dtsize), i32(0));
-    std::string asm_str = "cp.async" + mod + ".shared.global [$0 + " + std::to_string(out_off) + "], [$1 + " + std::to_string(in_off) + "], " + std::to_string(in_vec*dtsize) + ", $2;";
+    std::string prefetch = l2_prefetch_ ? ".L2::" + std::to_string(l2_prefetch_) + "B" : "";
+    std::string asm_str = "cp.async" + mod + ".shared.global" + prefetch + " [$0 + " + std::to_string(out_off) + "], [$1 + " + std::to_string(in_off) + "], " + std::to_string(in_vec*dtsize) + ", $2;";
     FunctionType *ty = FunctionType::get(void_ty, {out_base->getType(), ptr->getType(), builder_->getInt32Ty()}, false);
     InlineAsm *iasm = InlineAsm::get(ty, asm_str, "r,l,r", true);
     call(iasm, {out_base, ptr, src_size});
@@ -2701,23 +4403,297 @@ void generator::visit_copy_from_shared_inst(ir::copy_from_shared_inst*) {
 
 Instruction* generator::add_barrier() {
   Module *module = builder_->GetInsertBlock()->getModule();
+  // barriers emitted for a single warp group only wait for its warps
+  // named barriers 1 and 2 are reserved for consumers and producers, respectively
+  if(current_group_ == CONSUMER_WARPS)
+    return tgt_->add_named_barrier(module, *builder_, 1, num_warps_*32);
+  if(current_group_ == PRODUCER_WARPS)
+    return tgt_->add_named_barrier(module, *builder_, 2, num_warps_*32);
   return tgt_->add_barrier(module, *builder_);
 }
 
-void generator::visit_barrier_inst(ir::barrier_inst*) {
+Instruction* generator::add_memfence(ir::mem_scope_t scope) {
+  Module *module = builder_->GetInsertBlock()->getModule();
+  if(scope == ir::mem_scope_t::SYS)
+    return tgt_->add_sys_memfence(module, *builder_);
+  return tgt_->add_memfence(module, *builder_);
+}
+
+/**
+ * \brief Device function that appends a trace record for the calling warp.
+ * Lane 0 of the warp writes {u64 globaltimer, u32 cta, u32 smid, u32 warp, u32 event,
+ * u32 tag, u32 0} into the ring buffer at `__triton_trace_buffer`, after its 16-byte
+ * header {u32 count, u32 capacity, u64 0}. The buffer address and the tag of the
+ * kernel are module globals set by the host; nothing is recorded while the buffer is null
+ */
+Function* generator::trace_fn() {
+  if(Function* fn = mod_->getFunction("__triton_trace_event"))
+    return fn;
+  Type *i64_ty = builder_->getInt64Ty();
+  auto *buffer = new GlobalVariable(*mod_, i64_ty, false, GlobalVariable::ExternalLinkage, builder_->getInt64(0),
+                                    "__triton_trace_buffer", nullptr, GlobalVariable::NotThreadLocal, 1);
+  auto *tag = new GlobalVariable(*mod_, i32_ty, false, GlobalVariable::ExternalLinkage, i32(0),
+                                 "__triton_trace_tag", nullptr, GlobalVariable::NotThreadLocal, 1);
+  Function *fn = Function::Create(FunctionType::get(void_ty, {i32_ty}, false), Function::InternalLinkage,
+                                  "__triton_trace_event", mod_);
+  fn->addFnAttr(Attribute::NoInline);
+  IRBuilderBase::InsertPointGuard guard(*builder_);
+  builder_->SetCurrentDebugLocation(llvm::DebugLoc());
+  BasicBlock *entry = BasicBlock::Create(*ctx_, "entry", fn);
+  BasicBlock *record = BasicBlock::Create(*ctx_, "record", fn);
+  BasicBlock *done = BasicBlock::Create(*ctx_, "done", fn);
+  builder_->SetInsertPoint(entry);
+  Value *addr = load(buffer);
+  Value *tid = tgt_->get_local_id(mod_, *builder_, 0);
+  Value *lane = urem(tid, i32(32));
+  cond_br(and_(icmp(ICmpInst::ICMP_NE, addr, builder_->getInt64(0)), icmp_eq(lane, i32(0))), record, done);
+  builder_->SetInsertPoint(record);
+  Value *header = builder_->CreateIntToPtr(addr, ptr_ty(i32_ty, 1));
+  InlineAsm *inc = InlineAsm::get(FunctionType::get(i32_ty, {i64_ty}, false),
+                                  "atom.global.gpu.add.u32 $0, [$1], 1;", "=r,l", true);
+  Value *slot = call(inc, {addr});
+  Value *idx = urem(slot, load(gep(header, i32(1))));
+  Value *off = builder_->CreateAdd(builder_->getInt64(16), builder_->CreateMul(builder_->CreateZExt(idx, i64_ty),
+                                                                                builder_->getInt64(32)));
+  Value *rec = builder_->CreateIntToPtr(builder_->CreateAdd(addr, off), ptr_ty(i32_ty, 1));
+  InlineAsm *timer = InlineAsm::get(FunctionType::get(i64_ty, {}), "mov.u64 $0, %globaltimer;", "=l", true);
+  InlineAsm *smid = InlineAsm::get(FunctionType::get(i32_ty, {}), "mov.u32 $0, %smid;", "=r", true);
+  // linear index of the CTA
+  Value *cta = tgt_->get_block_id(mod_, *builder_, 2);
+  for(int ax = 1; ax >= 0; ax--)
+    cta = builder_->CreateAdd(builder_->CreateMul(cta, tgt_->get_num_blocks(mod_, *builder_, ax)),
+                              tgt_->get_block_id(mod_, *builder_, ax));
+  store(call(timer), bit_cast(rec, ptr_ty(i64_ty, 1)));
+  store(cta, gep(rec, i32(2)));
+  store(call(smid), gep(rec, i32(3)));
+  store(udiv(tid, i32(32)), gep(rec, i32(4)));
+  store(&*fn->arg_begin(), gep(rec, i32(5)));
+  store(load(tag), gep(rec, i32(6)));
+  store(i32(0), gep(rec, i32(7)));
+  br(done);
+  builder_->SetInsertPoint(done);
+  builder_->CreateRetVoid();
+  return fn;
+}
+
+/**
+ * \brief Attaches the source location of `i` to the instructions it lowers to. Instructions
+ * from other files (e.g., inlined functions) are scoped in a lexical block of that file
+ */
+void generator::set_debug_loc(ir::instruction* i) {
+  llvm::DISubprogram* sp = builder_->GetInsertBlock()->getParent()->getSubprogram();
+  unsigned line = i->get_metadata(ir::metadata::line);
+  if(!sp || line == 0)
+    return;
+  unsigned file = i->get_metadata(ir::metadata::file);
+  llvm::DIScope*& scope = di_scopes_[file];
+  if(!scope)
+    scope = di_->createLexicalBlockFile(sp, debug_file(file));
+  builder_->SetCurrentDebugLocation(llvm::DILocation::get(*ctx_, line, i->get_metadata(ir::metadata::column), scope));
+}
+
+/**
+ * \brief Debug descriptor of the `file`-th source file of the module (from 1)
+ */
+llvm::DIFile* generator::debug_file(unsigned file) {
+  std::string path = file >= 1 && file <= source_files_.size() ? source_files_[file - 1] : "<unknown>";
+  return di_->createFile(llvm::sys::path::filename(path), llvm::sys::path::parent_path(path));
+}
+
+/**
+ * \brief Records trace `event`: 0 for the entry of the kernel, 1 for its exit,
+ * 2 + k for the header of its k-th loop and 0x1000 + k for its k-th barrier
+ */
+void generator::trace(unsigned event) {
+  call(trace_fn(), {i32(event)});
+}
+
+/**
+ * \brief Index of the current thread among the threads of its warp group
+ */
+Value* generator::thread_id() {
+  Module *module = builder_->GetInsertBlock()->getModule();
+  Value *tid = tgt_->get_local_id(module, *builder_, 0);
+  // producer warps mirror the consumer warp of the same rank
+  if(warp_specialize_)
+    tid = urem(tid, i32(num_warps_*32));
+  return tid;
+}
+
+/**
+ * \brief Finds the values that producer warps need to issue the asynchronous
+ * copies of `fn`, i.e., their pointers and masks and the conditions of branches.
+ * Returns false when these values write memory or use shared memory, in which
+ * case `fn` cannot be split across warp groups
+ */
+bool generator::init_warp_groups(ir::function* fn) {
+  producer_values_.clear();
+  std::vector<ir::value*> stack;
+  bool has_async_copies = false;
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction *i: block->get_inst_list()){
+    if(auto *x = dynamic_cast<ir::masked_load_async_inst*>(i)){
+      has_async_copies = true;
+      stack.push_back(x->get_pointer_operand());
+      stack.push_back(x->get_mask_operand());
+    }
+    // producers follow the control flow of consumers
+    if(auto *x = dynamic_cast<ir::cond_branch_inst*>(i))
+      stack.push_back(x->get_cond());
+  }
+  if(!has_async_copies)
+    return false;
+  while(!stack.empty()){
+    auto *i = dynamic_cast<ir::instruction*>(stack.back());
+    stack.pop_back();
+    if(!i || !producer_values_.insert(i).second)
+      continue;
+    if(dynamic_cast<ir::io_inst*>(i) && !dynamic_cast<ir::load_inst*>(i))
+      return false;
+    if(dynamic_cast<ir::call_inst*>(i) || dynamic_cast<ir::launch_inst*>(i))
+      return false;
+    if(i->get_type()->is_block_ty() && !layouts_->get(i)->to_scanline())
+      return false;
+    for(ir::value *op: i->ops())
+      stack.push_back(op);
+  }
+  return true;
+}
+
+/**
+ * \brief Warp group that executes `i`
+ */
+generator::warp_group_t generator::warp_group(ir::instruction* i) {
+  if(!is_consumer_ || current_group_ != ALL_WARPS)
+    return ALL_WARPS;
+  if(dynamic_cast<ir::masked_load_async_inst*>(i))
+    return PRODUCER_WARPS;
+  // both groups take part in control flow and synchronization. The CTA-wide
+  // barriers of membar are the only hand-off between them: there are no
+  // per-stage barriers, so producers never run ahead of the consumers' stage
+  if(dynamic_cast<ir::phi_node*>(i) || dynamic_cast<ir::terminator_inst*>(i) ||
+     dynamic_cast<ir::barrier_inst*>(i) || dynamic_cast<ir::async_wait_inst*>(i))
+    return ALL_WARPS;
+  if(producer_values_.find(i) != producer_values_.end())
+    return ALL_WARPS;
+  return CONSUMER_WARPS;
+}
+
+/**
+ * \brief Code Generation for `i` on the warps of `group` only
+ */
+void generator::visit_in_warp_group(ir::instruction* i, warp_group_t group) {
+  Value *pred = group == CONSUMER_WARPS ? is_consumer_ : builder_->CreateNot(is_consumer_);
+  Instruction *no_op = intrinsic(Intrinsic::donothing, {}, {});
+  BasicBlock *head = no_op->getParent();
+  builder_->SetInsertPoint(head);
+  Instruction* dummy = builder_->CreateRet(nullptr);
+  Instruction *term = llvm::SplitBlockAndInsertIfThen(pred, no_op, false);
+  dummy->removeFromParent();
+  builder_->SetInsertPoint(term);
+  current_group_ = group;
+  i->accept(this);
+  current_group_ = ALL_WARPS;
+  BasicBlock *then_bb = builder_->GetInsertBlock();
+  builder_->SetInsertPoint(no_op);
+  // values are undefined in the other group
+  for(auto& x: vals_[i]){
+    if(!isa<Instruction>(x.second))
+      continue;
+    PHINode *merged = phi(x.second->getType(), 2);
+    merged->addIncoming(x.second, then_bb);
+    merged->addIncoming(UndefValue::get(x.second->getType()), head);
+    x.second = merged;
+  }
+}
+
+void generator::visit_barrier_inst(ir::barrier_inst* barrier) {
+  if(trace_level_ == 2)
+    trace(0x1000 + trace_barriers_++);
+  if(barrier->is_named()){
+    tgt_->add_named_barrier(mod_, *builder_, barrier->get_barrier_id(), barrier->get_num_threads());
+    return;
+  }
   add_barrier();
 }
 
 void generator::visit_clock_inst(ir::clock_inst* clock){
+  if(!tgt_->is_gpu()){
+    vals_[clock][{}] = intrinsic(Intrinsic::readcyclecounter, {}, {});
+    return;
+  }
   InlineAsm *iasm = InlineAsm::get(FunctionType::get(builder_->getInt64Ty(), {}), "mov.u64 $0, %clock64;", "=l", true);
   vals_[clock][{}] = call(iasm);
 }
 
 void generator::visit_globaltimer_inst(ir::globaltimer_inst* timer){
+  if(!tgt_->is_gpu())
+    throw std::runtime_error("globaltimer is not supported on the host");
   InlineAsm *iasm = InlineAsm::get(FunctionType::get(builder_->getInt64Ty(), {}), "mov.u64 $0, %globaltimer;", "=l", true);
   vals_[timer][{}] = call(iasm);
 }
 
+/**
+ * \brief Code Generation for `grid_sync`
+ *
+ * The first thread of each program adds 1 to the counter passed as the last parameter of
+ * the kernel, except for that of program (0, 0, 0), which adds
+ * 0x80000000 - (num_programs - 1): the top bit of the counter flips once all programs
+ * have arrived, which they wait for, and its low bits are back to 0 for the next barrier,
+ * whatever the grid of the next launch. The launcher passes one counter per stream (see
+ * `grid_barrier_pool` in triton.cc), so that concurrent launches do not share one
+ */
+void generator::visit_grid_sync_inst(ir::grid_sync_inst*) {
+  if(!tgt_->is_gpu())
+    throw std::runtime_error("grid_sync is not supported on the host");
+  // calls that reach a `grid_sync` are always inlined
+  if(!grid_barrier_)
+    throw std::runtime_error("grid_sync is only supported in kernels");
+  Value *counter = grid_barrier_;
+  BasicBlock *current = builder_->GetInsertBlock();
+  Function *fn = current->getParent();
+  BasicBlock *done = BasicBlock::Create(*ctx_, "grid_sync_done", fn, current->getNextNode());
+  BasicBlock *arrive = BasicBlock::Create(*ctx_, "grid_sync_arrive", fn, done);
+  BasicBlock *wait = BasicBlock::Create(*ctx_, "grid_sync_wait", fn, done);
+  BasicBlock *leave = BasicBlock::Create(*ctx_, "grid_sync_leave", fn, done);
+  // writes of the whole program are ordered before those of its first thread
+  add_barrier();
+  cond_br(icmp_eq(thread_id(), i32(0)), arrive, done);
+  builder_->SetInsertPoint(arrive);
+  Value *num_programs = i32(1);
+  Value *is_first = builder_->getTrue();
+  for(unsigned ax = 0; ax < 3; ax++){
+    num_programs = mul(num_programs, tgt_->get_num_blocks(mod_, *builder_, ax));
+    is_first = and_(is_first, icmp_eq(tgt_->get_block_id(mod_, *builder_, ax), i32(0)));
+  }
+  Value *inc = select(is_first, sub(i32(0x80000000), sub(num_programs, i32(1))), i32(1));
+  tgt_->add_memfence(mod_, *builder_);
+  Value *old = builder_->Insert(new AtomicRMWInst(AtomicRMWInst::Add, counter, inc, llvm::Align(4),
+                                                  AtomicOrdering::Monotonic, SyncScope::System));
+  br(wait);
+  builder_->SetInsertPoint(wait);
+  LoadInst *cur = builder_->CreateLoad(i32_ty, counter);
+  cur->setVolatile(true);
+  Value *flipped = icmp(ICmpInst::ICMP_NE, and_(xor_(old, cur), i32(0x80000000)), i32(0));
+  cond_br(flipped, leave, wait);
+  builder_->SetInsertPoint(leave);
+  tgt_->add_memfence(mod_, *builder_);
+  br(done);
+  builder_->SetInsertPoint(done);
+  add_barrier();
+}
+
+/**
+ * \brief Code Generation for `fence`
+ *
+ * Each thread orders its own accesses; the scalar atomics that signal peers are issued
+ * by the first thread of the program after a barrier, so a fence in every thread followed
+ * by such a signal publishes the writes of the whole program
+ */
+void generator::visit_fence_inst(ir::fence_inst* fence) {
+  add_memfence(fence->get_scope());
+}
+
 
 
 void generator::visit_prefetch_s_inst(ir::prefetch_s_inst *i) {
@@ -2758,6 +4734,14 @@ void generator::visit_async_wait_inst(ir::async_wait_inst* i) {
   std::string asm_str = "cp.async.wait_group " + std::to_string(i->get_N()) + ";";
   InlineAsm *iasm = InlineAsm::get(FunctionType::get(void_ty, {}), asm_str, "", true);
   call(iasm);
+  // TMA copies of all but the newest N groups have landed
+  for(const auto& x: tma_groups_){
+    Value *groups = load(x.second);
+    if(i->get_N() < 64)
+      groups = and_(groups, builder_->getInt64((uint64_t(1) << i->get_N()) - 1));
+    Value *pending = builder_->CreateTrunc(builder_->CreateUnaryIntrinsic(Intrinsic::ctpop, groups), i32_ty);
+    wait_tma(x.first, sub(load(tma_issued_.at(x.first)), pending));
+  }
 }
 
 //void generator::visit_make_range_dyn(ir::make_range_dyn* x) {
@@ -2816,12 +4800,38 @@ void generator::visit_constant_fp(ir::constant_fp *x){
 }
 
 void generator::visit_alloc_const(ir::alloc_const *alloc) {
-  unsigned size = ((ir::constant_int*)alloc->get_operand(0))->get_value();
   Type *element_ty = cvt(alloc->get_type()->get_pointer_element_ty());
-  Type *array_ty = llvm::ArrayType::get(element_ty, size);
-  Value *array = new llvm::GlobalVariable(*mod_, array_ty, false, llvm::GlobalVariable::ExternalLinkage,
-                                            nullptr, alloc->get_name(), nullptr, llvm::GlobalVariable::NotThreadLocal, 4);
-  vals_[alloc][{}] = bit_cast(array, element_ty->getPointerTo(4));
+  vals_[alloc][{}] = bit_cast(consts_.at(alloc), element_ty->getPointerTo(4));
+}
+
+/**
+ * \brief Declares the constant allocations of the module, once for all of its functions.
+ * Initialized ones are part of the image of the module, which the driver copies to the
+ * constant memory of the device when it loads it
+ */
+void generator::declare_consts(ir::module &src) {
+  for(ir::alloc_const *alloc: src.allocs()){
+    unsigned size = alloc->get_size()->get_value();
+    Type *element_ty = cvt(alloc->get_type()->get_pointer_element_ty());
+    ArrayType *array_ty = ArrayType::get(element_ty, size);
+    Constant *init = nullptr;
+    std::vector<ir::constant*> values = alloc->get_init();
+    if(!values.empty()){
+      std::vector<Constant*> elts;
+      for(ir::constant *x: values){
+        if(auto *cst = dynamic_cast<ir::constant_int*>(x))
+          elts.push_back(ConstantInt::get(element_ty, cst->get_value()));
+        else
+          elts.push_back(ConstantFP::get(element_ty, ((ir::constant_fp*)x)->get_value()));
+      }
+      init = ConstantArray::get(array_ty, elts);
+    }
+    GlobalVariable *array = new GlobalVariable(*mod_, array_ty, init != nullptr, GlobalVariable::ExternalLinkage,
+                                               init, alloc->get_name(), nullptr, GlobalVariable::NotThreadLocal, 4);
+    // the alignment analysis assumes it
+    array->setAlignment(llvm::MaybeAlign(16));
+    consts_[alloc] = array;
+  }
 }
 
 
@@ -2832,25 +4842,108 @@ void generator::forward_declare(ir::function* fn){
     std::vector<Type*> fn_args_ty;
     for(unsigned i = 0; i < fn_ty->getNumParams(); i++)
       fn_args_ty.push_back(fn_ty->getParamType(i));
-    fn_args_ty.push_back(i32_ty);
-    fn_args_ty.push_back(i32_ty);
-    fn_args_ty.push_back(i32_ty);
+    // program ids and number of programs along each axis
+    for(unsigned ax = 0; ax < 6; ax++)
+      fn_args_ty.push_back(i32_ty);
+    fn_ty = FunctionType::get(fn_ret_ty, fn_args_ty, false);
+  }
+  // outlined device functions take and return the values that each thread holds of tensors
+  if(tgt_->is_gpu() && !fn->get_is_kernel()){
+    size_t n_ret;
+    std::vector<size_t> counts = count_thread_values(fn, n_ret);
+    std::vector<Type*> fn_args_ty;
+    for(size_t k = 0; k < fn->args().size(); k++)
+      for(size_t n = 0; n < counts[k]; n++)
+        fn_args_ty.push_back(cvt(fn->args()[k]->get_type()->get_scalar_ty()));
+    ir::type *ret_ty = fn->get_fn_type()->get_return_ty();
+    Type *fn_ret_ty = fn_ty->getReturnType();
+    if(ret_ty->is_block_ty())
+      fn_ret_ty = StructType::get(*ctx_, std::vector<Type*>(n_ret, cvt(ret_ty->get_scalar_ty())));
     fn_ty = FunctionType::get(fn_ret_ty, fn_args_ty, false);
+    Function *ret = Function::Create(fn_ty, Function::InternalLinkage, fn->get_name(), mod_);
+    ret->addFnAttr(llvm::Attribute::NoInline);
+    fns_[fn] = ret;
+    return;
   }
+  // kernels take the tensor maps of their TMA copies after their arguments, then the
+  // counter of their grid barriers
+  std::vector<Type*> fn_args_ty(fn_ty->param_begin(), fn_ty->param_end());
+  fn_args_ty.resize(fn_args_ty.size() + tma_buffers_[fn].size(), ptr_ty(i8_ty, 1));
+  if(tgt_->is_gpu() && calls_grid_sync(fn)){
+    fn_args_ty.push_back(ptr_ty(i32_ty, 1));
+    mod_->getOrInsertNamedMetadata("triton.grid_sync");
+  }
+  fn_ty = FunctionType::get(fn_ty->getReturnType(), fn_args_ty, false);
   Function *ret = Function::Create(fn_ty, Function::ExternalLinkage, fn->get_name(), mod_);
   fns_[fn] = ret;
 }
 
+/**
+ * \brief Whether kernel `fn` calls `grid_sync`
+ */
+bool generator::calls_grid_sync(ir::function* fn) {
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction *i: block->get_inst_list())
+    if(dynamic_cast<ir::grid_sync_inst*>(i))
+      return true;
+  return false;
+}
+
+/**
+ * \brief Whether `layout` is lowered in `fn`: it holds values of `fn`, or of no function
+ */
+bool generator::in_function(analysis::data_layout* layout, ir::function* fn) {
+  bool elsewhere = false;
+  for(ir::value *v: layout->get_values()){
+    ir::function *parent = nullptr;
+    if(auto *i = dynamic_cast<ir::instruction*>(v))
+      parent = i->get_parent() ? i->get_parent()->get_parent() : nullptr;
+    if(auto *arg = dynamic_cast<ir::argument*>(v))
+      parent = arg->get_parent();
+    if(parent == fn)
+      return true;
+    elsewhere |= parent != nullptr;
+  }
+  return !elsewhere;
+}
+
 void generator::visit_function(ir::function* fn) {
   idxs_.clear();
   vals_.clear();
   seen_.clear();
+  philox_words_.clear();
+  init_read_only_args(fn);
+  staged_stores_ = false;
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction *i: block->get_inst_list())
+    staged_stores_ |= dynamic_cast<ir::store_inst*>(i) && layouts_->has_tmp(i);
   LLVMContext &ctx = builder_->getContext();
 
   Function* ret = fns_[fn];
+  // debug scope of the function, in the file and at the line of its first located instruction
+  builder_->SetCurrentDebugLocation(llvm::DebugLoc());
+  di_scopes_.clear();
+  if(di_)
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction *i: block->get_inst_list()){
+    unsigned line = i->get_metadata(ir::metadata::line);
+    if(ret->getSubprogram() || line == 0)
+      continue;
+    unsigned file = i->get_metadata(ir::metadata::file);
+    llvm::DIFile* di_file = debug_file(file);
+    llvm::DISubroutineType* di_ty = di_->createSubroutineType(di_->getOrCreateTypeArray({}));
+    llvm::DISubprogram* sp = di_->createFunction(di_file, fn->get_name(), fn->get_name(), di_file, line, di_ty, line,
+                                                 llvm::DINode::FlagZero,
+                                                 llvm::DISubprogram::SPFlagDefinition | llvm::DISubprogram::SPFlagOptimized);
+    ret->setSubprogram(sp);
+    di_scopes_[file] = sp;
+  }
 
 
+  // outlined functions take the values of their block arguments held by each thread
+  bool outlined = tgt_->is_gpu() && !fn->get_is_kernel();
   // set attributes
+  if(!outlined)
   for(auto attr_pair: fn->attrs()){
     unsigned id = attr_pair.first;
     for(ir::attribute attr: attr_pair.second)
@@ -2861,16 +4954,17 @@ void generator::visit_function(ir::function* fn) {
     }
   }
   // set metadata
-  if(tgt_->is_gpu()){
+  if(tgt_->is_gpu() && fn->get_is_kernel()){
       tgt_->set_kernel(*builder_, ctx, mod_, ret);
       Metadata *md_args[] = {
         ValueAsMetadata::get(ret),
         MDString::get(ctx, "maxntidx"),
-        ValueAsMetadata::get(i32(num_warps_*32))
+        ValueAsMetadata::get(i32(num_warps_*32*(warp_specialize_ ? 2 : 1)))
       };
       mod_->getOrInsertNamedMetadata("nvvm.annotations")->addOperand(MDNode::get(ctx, md_args));
   }
   // set arguments
+  if(!outlined)
   for(unsigned i = 0; i < fn->args().size(); i++)
     vals_[fn->args()[i]][{}] = &*(ret->arg_begin() + i);
   // create blocks
@@ -2880,10 +4974,66 @@ void generator::visit_function(ir::function* fn) {
     bbs_[block] = dst_block;
   }
   builder_->SetInsertPoint(bbs_[fn->blocks()[0]]);
+  // warp groups
+  is_consumer_ = nullptr;
+  current_group_ = ALL_WARPS;
+  if(warp_specialize_){
+    Value *tid = tgt_->get_local_id(mod_, *builder_, 0);
+    Value *is_consumer = icmp_ult(tid, i32(num_warps_*32));
+    if(init_warp_groups(fn))
+      is_consumer_ = is_consumer;
+    else{
+      // programs that cannot be split only run on consumers, and their
+      // barriers must not wait for the producers that exited
+      BasicBlock *entry = bbs_[fn->blocks()[0]];
+      BasicBlock *exit = BasicBlock::Create(ctx, "producer_exit", ret);
+      BasicBlock *body = BasicBlock::Create(ctx, "consumer_entry", ret, entry->getNextNode());
+      cond_br(is_consumer, body, exit);
+      builder_->SetInsertPoint(exit);
+      builder_->CreateRetVoid();
+      builder_->SetInsertPoint(body);
+      bbs_[fn->blocks()[0]] = body;
+      current_group_ = CONSUMER_WARPS;
+    }
+  }
+  // on the host, shared memory is a buffer on the stack of the thread running the program
+  if(!tgt_->is_gpu())
+  if(unsigned alloc_size = alloc_->allocated_size()){
+    AllocaInst *buffer = builder_->CreateAlloca(i8_ty, i32(alloc_size));
+    buffer->setAlignment(llvm::Align(16));
+    shmem_ = builder_->CreateAddrSpaceCast(buffer, ptr_ty(i8_ty, 3));
+  }
   // initialize layouts
   for(auto x: layouts_->get_all()){
-    visit_layout(x.second);
+    if(in_function(x.second, fn))
+      visit_layout(x.second);
   }
+  init_tma(fn);
+  grid_barrier_ = !outlined && tgt_->is_gpu() && calls_grid_sync(fn) ? &*std::prev(ret->arg_end()) : nullptr;
+  if(outlined){
+    auto it = ret->arg_begin();
+    for(ir::argument *arg: fn->args()){
+      init_idx(arg);
+      for(const indices_t& idx: idxs_[arg])
+        vals_[arg][idx] = &*it++;
+    }
+  }
+  // loop headers are the targets of back-edges
+  trace_loops_.clear();
+  trace_barriers_ = 0;
+  if(trace_level_ == 1 || trace_level_ == 2){
+    std::map<ir::basic_block*, size_t> order;
+    for(ir::basic_block *block: blocks)
+      order.insert({block, order.size()});
+    for(ir::basic_block *block: blocks)
+    for(ir::basic_block *pred: block->get_predecessors()){
+      auto it = order.find(pred);
+      if(it != order.end() && it->second >= order.at(block) && !trace_loops_.count(block))
+        trace_loops_.insert({block, trace_loops_.size()});
+    }
+  }
+  if(trace_level_)
+    trace(0);
   // generate LLVM-IR code
   for(ir::basic_block *block: blocks)
     visit_basic_block(block);
@@ -2912,12 +5062,31 @@ void generator::visit_layout_mma(analysis::mma_layout* layout) {
   Value *_8 = i32(8);
   Value *_16 = i32(16);
   Value *_32 = i32(32);
-  int cc = tgt_->as_nvidia()->sm();
   std::vector<Value*> idx_m;
   std::vector<Value*> idx_n;
   std::vector<Value*> idx_z;
   //
-  Value* thread = tgt_->get_local_id(mod_, *builder_, 0);
+  Value* thread = thread_id();
+  if(layout->is_mfma()){
+    // in each 32x32 tile, lane `l` of a wavefront holds column l % 32 of
+    // rows 8*i + 4*(l / 32) + {0, 1, 2, 3}, for i in [0, 4)
+    Value *lane = urem(thread, i32(64));
+    Value *wave = udiv(thread, i32(64));
+    Value *wave_0 = urem(wave, i32(layout->wpt(0)));
+    Value *wave_1 = urem(udiv(wave, i32(layout->wpt(0))), i32(layout->wpt(1)));
+    Value *off_c_m = add(mul(wave_0, i32(layout->spw(0))), mul(udiv(lane, _32), _4));
+    Value *off_c_n = add(mul(wave_1, i32(layout->spw(1))), urem(lane, _32));
+    for(unsigned m = 0; m < shape[0]; m += layout->shape_per_cta(0))
+    for(unsigned i = 0; i < 4; i++)
+    for(unsigned j = 0; j < 4; j++)
+      idx_m.push_back(add(off_c_m, i32(m + 8*i + j)));
+    for(unsigned n = 0; n < shape[1]; n += layout->shape_per_cta(1))
+      idx_n.push_back(add(off_c_n, i32(n)));
+    axes_[layout->get_axis(0)] = distributed_axis{1, idx_m, wave_0};
+    axes_[layout->get_axis(1)] = distributed_axis{1, idx_n, wave_1};
+    return;
+  }
+  int cc = tgt_->as_nvidia()->sm();
   Value *lane = urem(thread, _32);
   Value *warp = udiv(thread, _32);
   /* lane offset */
@@ -3015,14 +5184,14 @@ void generator::visit_layout_mma(analysis::mma_layout* layout) {
 }
 
 void generator::visit_layout_scanline(analysis::scanline_layout* layout) {
-  Value *warp_size = i32(32);
-  Value* u_thread_id_0 = tgt_->get_local_id(mod_, *builder_, 0);
+  Value *warp_size = i32(warp_size_);
+  Value* u_thread_id_0 = thread_id();
   Value *u_thread_id = urem(u_thread_id_0, warp_size);
   Value *u_warp_id = udiv(u_thread_id_0, warp_size);
 
   auto order = layout->get_order();
   const auto& shape = layout->get_shape();
-  Value* full_thread_id = add(mul(u_warp_id, i32(32)), u_thread_id);
+  Value* full_thread_id = add(mul(u_warp_id, warp_size), u_thread_id);
   // Delinearize
   size_t dim = shape.size();
   std::vector<Value*> thread_id(dim);
@@ -3109,7 +5278,15 @@ void generator::visit_basic_block(ir::basic_block * block) {
 
   BasicBlock *parent = bbs_[block];
   builder_->SetInsertPoint(parent);
+  auto loop = trace_loops_.find(block);
   for(ir::instruction *i: block->get_inst_list()){
+    // loop headers are recorded after their phi nodes
+    if(loop != trace_loops_.end() && !dynamic_cast<ir::phi_node*>(i)){
+      trace(2 + loop->second);
+      loop = trace_loops_.end();
+    }
+    if(di_)
+      set_debug_loc(i);
     visit_value(i);
   }
   // Update ir bb -> llvm bb mapping
@@ -3270,6 +5447,7 @@ void generator::finalize_function(ir::function *fn) {
   // finalize double-buffering
   for(const auto& x: layouts_->get_all())
   if(auto *shared = dynamic_cast<analysis::shared_layout*>(x.second))
+  if(in_function(shared, fn))
     finalize_shared_layout(shared);
   // finalize phi
   for(ir::basic_block *block: fn->blocks())
@@ -3304,6 +5482,29 @@ void generator::visit(ir::module &src, llvm::Module &dst) {
   mod_ = &dst;
   ctx_ = &dst.getContext();
   builder_ = new Builder(*ctx_);
+  fast_math_ = src.get_fast_math();
+  raster_ = tgt_->is_gpu() ? src.get_raster() : 0;
+  // persistent kernels are passed the address of this counter by the runtime
+  if(tgt_->is_gpu() && src.get_persistent())
+    new GlobalVariable(*mod_, builder_->getInt32Ty(), false, GlobalVariable::ExternalLinkage, builder_->getInt32(0),
+                       "__triton_tile_counter", nullptr, GlobalVariable::NotThreadLocal, 1);
+  // line information only: ptxas turns the .loc directives into a line table
+  if(line_info_ && !src.get_source_files().empty()){
+    di_ = new llvm::DIBuilder(dst);
+    source_files_ = src.get_source_files();
+    di_->createCompileUnit(llvm::dwarf::DW_LANG_C, debug_file(1), "triton", true, "", 0, "",
+                           llvm::DICompileUnit::DebugDirectivesOnly);
+    dst.addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+    dst.addModuleFlag(llvm::Module::Max, "Dwarf Version", 2);
+  }
+  // buffers of TMA copies
+  tma_buffers_.clear();
+  tma_swizzle_.clear();
+  bool tma = false;
+  for(ir::function *fn: src.get_function_list()){
+    tma_buffers_[fn] = tma_buffers(fn);
+    tma |= !tma_buffers_[fn].empty();
+  }
   // allocate shared memory
   if(tgt_->is_gpu())
   if(unsigned alloc_size = alloc_->allocated_size()){
@@ -3314,8 +5515,12 @@ void generator::visit(ir::module &src, llvm::Module &dst) {
     GlobalVariable *sh_mem_array =
       new GlobalVariable(*mod_, array_ty, false, GlobalVariable::ExternalLinkage,
                          nullptr, "__shared_ptr", nullptr, GlobalVariable::NotThreadLocal, 3);
+    // buffers of staged stores are 16-byte aligned, and those of swizzled TMA copies
+    // 1024-byte aligned
+    sh_mem_array->setAlignment(llvm::MaybeAlign(tma ? 1024 : 16));
     shmem_ = bit_cast(sh_mem_array, ptr_ty);
   }
+  declare_consts(src);
   // instantiate device functions
 //  for(ir::function *fn: src.get_function_list())
 //  for(ir::basic_block *bb: fn->blocks())
@@ -3326,8 +5531,23 @@ void generator::visit(ir::module &src, llvm::Module &dst) {
   // visit functions
   for(ir::function *fn: src.get_function_list())
     forward_declare(fn);
+  // fast math also lets LLVM flush fp32 denormals and approximate divisions, and
+  // selects the flush-to-zero paths of libdevice
+  if(fast_math_ && tgt_->is_gpu()){
+    for(const auto& it: fns_){
+      it.second->addFnAttr("unsafe-fp-math", "true");
+      it.second->addFnAttr("denormal-fp-math-f32", "preserve-sign,preserve-sign");
+    }
+    if(tgt_->as_nvidia())
+      dst.addModuleFlag(llvm::Module::Override, "nvvm-reflect-ftz", 1);
+  }
   for(ir::function *fn: src.get_function_list())
     visit_function(fn);
+  if(di_){
+    di_->finalize();
+    delete di_;
+    di_ = nullptr;
+  }
 }
 
 
@@ -20,6 +20,10 @@ nvidia_cu_target* target::as_nvidia() {
   return dynamic_cast<nvidia_cu_target*>(this); 
 }
 
+amd_cl_target* target::as_amd() {
+  return dynamic_cast<amd_cl_target*>(this);
+}
+
 bool target::is_gpu() const {
   return is_gpu_;
 }
@@ -41,7 +45,11 @@ Value* amd_cl_target::get_global_offset(Module *module, IRBuilder<>& builder, un
 }
 
 Instruction* amd_cl_target::add_memfence(Module *module, IRBuilder<>& builder) {
-  throw std::runtime_error("not implemented");
+  return builder.CreateFence(AtomicOrdering::SequentiallyConsistent, module->getContext().getOrInsertSyncScopeID("agent"));
+}
+
+Instruction* amd_cl_target::add_sys_memfence(Module *module, IRBuilder<>& builder) {
+  return builder.CreateFence(AtomicOrdering::SequentiallyConsistent, SyncScope::System);
 }
 
 
@@ -86,11 +94,22 @@ Instruction* nvidia_cu_target::add_barrier(Module *module, IRBuilder<>& builder)
   return builder.CreateCall(barrier, {});
 }
 
+// bar.sync id, num_threads
+Instruction* nvidia_cu_target::add_named_barrier(Module *module, IRBuilder<>& builder, int id, int num_threads) {
+  Function *barrier = Intrinsic::getDeclaration(module, Intrinsic::nvvm_barrier_sync_cnt);
+  return builder.CreateCall(barrier, {builder.getInt32(id), builder.getInt32(num_threads)});
+}
+
 Instruction* nvidia_cu_target::add_memfence(Module *module, IRBuilder<>& builder) {
   Function *barrier = Intrinsic::getDeclaration(module, Intrinsic::nvvm_membar_gl);
   return builder.CreateCall(barrier, {});
 }
 
+Instruction* nvidia_cu_target::add_sys_memfence(Module *module, IRBuilder<>& builder) {
+  Function *barrier = Intrinsic::getDeclaration(module, Intrinsic::nvvm_membar_sys);
+  return builder.CreateCall(barrier, {});
+}
+
 
 Value* nvidia_cu_target::get_global_offset(Module *module, IRBuilder<>& builder, unsigned stride, unsigned ax) {
   Value* group_id = get_block_id(module, builder, ax);
@@ -143,20 +162,24 @@ Instruction* cpu_target::add_memfence(Module *module, IRBuilder<>& builder) {
   return (Instruction*)builder.CreateAdd(builder.getInt32(0), builder.getInt32(0));
 }
 
+// programs run on threads of the host, which may share memory with devices
+Instruction* cpu_target::add_sys_memfence(Module *module, IRBuilder<>& builder) {
+  return builder.CreateFence(AtomicOrdering::SequentiallyConsistent, SyncScope::System);
+}
+
 
+// kernels take their program ids and grid size as trailing arguments:
+// (..., pid_0, pid_1, pid_2, num_programs_0, num_programs_1, num_programs_2)
 Value* cpu_target::get_block_id(Module *module, llvm::IRBuilder<> &builder, unsigned ax) {
-  const Function *fn = builder.GetInsertBlock()->getParent();
+  Function *fn = builder.GetInsertBlock()->getParent();
   size_t num_params = fn->getFunctionType()->getNumParams();
-  static std::array<const Argument*, 3> ids = {
-    fn->arg_begin() + num_params - 3,
-    fn->arg_begin() + num_params - 2,
-    fn->arg_begin() + num_params - 1
-  };
-  return (Argument*)ids[ax];
+  return fn->arg_begin() + num_params - 6 + ax;
 }
 
 Value* cpu_target::get_num_blocks(Module *module, IRBuilder<>& builder, unsigned ax) {
-  throw std::runtime_error("not implemented");
+  Function *fn = builder.GetInsertBlock()->getParent();
+  size_t num_params = fn->getFunctionType()->getNumParams();
+  return fn->arg_begin() + num_params - 3 + ax;
 }
 
 
@@ -0,0 +1,155 @@
+#include <vector>
+#include "triton/ir/module.h"
+#include "triton/ir/function.h"
+#include "triton/ir/basic_block.h"
+#include "triton/ir/instructions.h"
+#include "triton/ir/constant.h"
+#include "triton/ir/utils.h"
+#include "triton/codegen/analysis/range.h"
+#include "triton/codegen/transform/bounds.h"
+
+namespace triton {
+namespace codegen{
+namespace transform{
+
+// whether every element of the boolean `v` is true
+bool bounds::is_true(ir::value* v) {
+  while(dynamic_cast<ir::splat_inst*>(v) || dynamic_cast<ir::broadcast_inst*>(v) ||
+        dynamic_cast<ir::reshape_inst*>(v))
+    v = ((ir::instruction*)v)->get_operand(0);
+  if(auto* x = dynamic_cast<ir::constant_int*>(v))
+    return x->get_value() & 1;
+  if(!range_->has(v))
+    return false;
+  analysis::range::interval x = range_->get(v);
+  return x.lo == 1 && x.hi == 1;
+}
+
+// 1 (resp. 0) if the comparison `i` holds (resp. fails) for all the values of
+// its operands, -1 otherwise
+int bounds::decide(ir::instruction* i) {
+  auto* cmp = dynamic_cast<ir::icmp_inst*>(i);
+  if(!cmp)
+    return -1;
+  ir::value* lhs = cmp->get_operand(0);
+  ir::value* rhs = cmp->get_operand(1);
+  if(!range_->has(lhs) || !range_->has(rhs))
+    return -1;
+  analysis::range::interval a = range_->get(lhs);
+  analysis::range::interval b = range_->get(rhs);
+  ir::cmp_pred_t pred = cmp->get_pred();
+  // unsigned comparisons agree with signed ones on non-negative values
+  bool is_unsigned = pred == ir::ICMP_UGT || pred == ir::ICMP_UGE ||
+                     pred == ir::ICMP_ULT || pred == ir::ICMP_ULE;
+  if(is_unsigned && (a.lo < 0 || b.lo < 0))
+    return -1;
+  switch(pred){
+  case ir::ICMP_EQ:
+    if(a.lo == a.hi && b.lo == b.hi && a.lo == b.lo) return 1;
+    if(a.hi < b.lo || b.hi < a.lo) return 0;
+    return -1;
+  case ir::ICMP_NE:
+    if(a.lo == a.hi && b.lo == b.hi && a.lo == b.lo) return 0;
+    if(a.hi < b.lo || b.hi < a.lo) return 1;
+    return -1;
+  case ir::ICMP_SLT:
+  case ir::ICMP_ULT:
+    if(a.hi < b.lo) return 1;
+    if(a.lo >= b.hi) return 0;
+    return -1;
+  case ir::ICMP_SLE:
+  case ir::ICMP_ULE:
+    if(a.hi <= b.lo) return 1;
+    if(a.lo > b.hi) return 0;
+    return -1;
+  case ir::ICMP_SGT:
+  case ir::ICMP_UGT:
+    if(a.lo > b.hi) return 1;
+    if(a.hi <= b.lo) return 0;
+    return -1;
+  case ir::ICMP_SGE:
+  case ir::ICMP_UGE:
+    if(a.lo >= b.hi) return 1;
+    if(a.hi < b.lo) return 0;
+    return -1;
+  default:
+    return -1;
+  }
+}
+
+bool bounds::rewrite_cmp(ir::instruction* i, ir::builder& builder) {
+  int result = decide(i);
+  if(result < 0)
+    return false;
+  builder.set_insert_point(i);
+  ir::value* ret = builder.get_int1(result);
+  if(i->get_type()->is_block_ty())
+    ret = builder.create_splat(ret, i->get_type()->get_block_shapes());
+  i->replace_all_uses_with(ret);
+  return true;
+}
+
+// x & true = x, x | false = x, and their commutations
+bool bounds::rewrite_logical(ir::instruction* i) {
+  auto* x = dynamic_cast<ir::binary_operator*>(i);
+  if(!x || !x->get_type()->get_scalar_ty()->is_bool_ty())
+    return false;
+  if(x->get_op() != ir::binary_op_t::And && x->get_op() != ir::binary_op_t::Or)
+    return false;
+  bool is_and = x->get_op() == ir::binary_op_t::And;
+  for(unsigned n = 0; n < 2; n++){
+    ir::value* op = x->get_operand(n);
+    ir::value* other = x->get_operand(1 - n);
+    bool neutral = is_and ? is_true(op) : dynamic_cast<ir::constant_int*>(op) &&
+                                          ((ir::constant_int*)op)->get_value() == 0;
+    if(neutral && other->get_type() == x->get_type()){
+      x->replace_all_uses_with(other);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool bounds::rewrite_masked_load(ir::instruction* i, ir::builder& builder) {
+  auto* x = dynamic_cast<ir::masked_load_inst*>(i);
+  if(!x || !is_true(x->get_mask_operand()))
+    return false;
+  builder.set_insert_point(x);
+  ir::value* ret = builder.create_load(x->get_pointer_operand(), x->get_cache_modifier(),
+                                       x->get_eviction_policy(), x->get_is_volatile());
+  if(x->get_tile_rank())
+    static_cast<ir::load_inst*>(ret)->set_tile(x->get_tile());
+  ret->set_name(x->get_name());
+  x->replace_all_uses_with(ret);
+  return true;
+}
+
+bool bounds::rewrite_masked_store(ir::instruction* i, ir::builder& builder) {
+  auto* x = dynamic_cast<ir::masked_store_inst*>(i);
+  if(!x || !is_true(x->get_mask_operand()))
+    return false;
+  builder.set_insert_point(x);
+  builder.create_store(x->get_pointer_operand(), x->get_value_operand());
+  x->erase_from_parent();
+  return true;
+}
+
+void bounds::run(ir::module& mod) {
+  ir::builder& builder = mod.get_builder();
+  for(ir::function* fn: mod.get_function_list())
+  for(ir::basic_block* block: ir::cfg::reverse_post_order(fn)){
+    // masks are rewritten before the instructions that consume them
+    std::vector<ir::instruction*> insts(block->get_inst_list().begin(), block->get_inst_list().end());
+    for(ir::instruction* i: insts){
+      bool was_modified = false;
+      was_modified = was_modified || rewrite_cmp(i, builder);
+      was_modified = was_modified || rewrite_logical(i);
+      was_modified = was_modified || rewrite_masked_load(i, builder);
+      was_modified = was_modified || rewrite_masked_store(i, builder);
+    }
+  }
+}
+
+}
+}
+}
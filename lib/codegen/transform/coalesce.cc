@@ -16,40 +16,87 @@ coalesce::coalesce(analysis::align* align, analysis::layouts *layouts)
   : align_(align), layout_(layouts) { }
 
 
-// simplify layout conversions using the following simple rules:
-//   - cvt_1(cvt_2(x)) if convert1 is the inverse of convert2
-//   - cvt_1(elementwise(x, y)) = elementwise(convert(x), convert(y))
-//ir::value* coalesce::simplify(ir::instruction *inst, ir::builder& builder){
-//  ir::value* _op = inst->get_operand(0);
-//  ir::instruction* op = dynamic_cast<ir::instruction*>(_op);
-//  analysis::mma_layout* mma_in  = layout_->get(op)  ->to_mma();
-//  analysis::mma_layout* mma_out = layout_->get(inst)->to_mma();
-//  std::cout << 1 << std::endl;
-//  // i must be layout conversion instruction
-//  if(!mma_in && !mma_out)
-//    return inst;
-//  //   - cvt_1(cvt_2(x)) if convert1 is the inverse of convert2
-//  bool is_op_cvt = op->get_id() == ir::INST_CVT_LAYOUT;
-//  if((mma_in || mma_out) && is_op_cvt &&
-//     (layout_->get(inst) == layout_->get(op->get_operand(0))))
-//    return op->get_operand(0);
-//  //   - cvt_1(elementwise(x, y)) = elementwise(cvt_1(x), cvt_2(y))
-//  if(op->get_id() != ir::INST_BINOP && op->get_id() != ir::INST_GETELEMENTPTR)
-//    return inst;
-//  std::cout << 1 << std::endl;
-//  for(size_t i = 0; i < op->get_num_operands(); i++){
-//    ir::value* arg_i = op->get_operand(i);
-//    builder.set_insert_point(op);
-//    // create new layout transform
-//    ir::instruction* new_arg_i = inst->clone();
-//    builder.insert(new_arg_i);
-//    // set the right args
-//    new_arg_i->replace_uses_of_with(new_arg_i->get_operand(0), arg_i);
-//    op->replace_uses_of_with(arg_i, simplify(new_arg_i, builder));
-//  }
-//  std::cout << 2 << std::endl;
-//  return op;
-//}
+// A layout conversion writes its operand to shared memory and reads it back
+// after a barrier, which moves 2 * `bytes` bytes per element. Expressions of
+// ranges, splats and scalars are instead recomputed in the layout of the
+// conversion when they take no more than this many instructions per byte of
+// element moved
+static const int max_remat_insts_per_byte = 2;
+
+// number of instructions that recomputing `v` in another layout copies, or -1
+// if `v` depends on values whose layout must be converted
+static int remat_cost(ir::value* v, std::set<ir::value*>& seen) {
+  auto* i = dynamic_cast<ir::instruction*>(v);
+  if(!i || !i->get_type()->is_block_ty() || !seen.insert(v).second)
+    return 0;
+  if(dynamic_cast<ir::make_range*>(i) || dynamic_cast<ir::splat_inst*>(i))
+    return 1;
+  if(dynamic_cast<ir::cvt_layout_inst*>(i))
+    return -1;
+  bool is_elementwise = dynamic_cast<ir::binary_operator*>(i) ||
+                        dynamic_cast<ir::cmp_inst*>(i) ||
+                        dynamic_cast<ir::cast_inst*>(i) ||
+                        dynamic_cast<ir::getelementptr_inst*>(i) ||
+                        dynamic_cast<ir::select_inst*>(i) ||
+                        dynamic_cast<ir::broadcast_inst*>(i) ||
+                        dynamic_cast<ir::reshape_inst*>(i);
+  if(!is_elementwise)
+    return -1;
+  int ret = 1;
+  for(ir::value* op: i->ops()){
+    int cost = remat_cost(op, seen);
+    if(cost < 0)
+      return -1;
+    ret += cost;
+  }
+  return ret;
+}
+
+// copies the tile-valued instructions `v` depends on
+ir::value* coalesce::rematerialize(ir::value *v, ir::builder& builder, std::map<ir::value*, ir::value*>& seen) {
+  auto* i = dynamic_cast<ir::instruction*>(v);
+  if(!i || !i->get_type()->is_block_ty())
+    return v;
+  auto it = seen.find(v);
+  if(it != seen.end())
+    return it->second;
+  ir::instruction* ret = i->clone();
+  for(ir::value* op: ret->ops())
+    op->add_use(ret);
+  for(ir::value* op: i->ops()){
+    ir::value* new_op = rematerialize(op, builder, seen);
+    if(new_op != op)
+      ret->replace_uses_of_with(op, new_op);
+  }
+  builder.insert(ret);
+  seen[v] = ret;
+  return ret;
+}
+
+// simplifies the layout conversion `i`:
+//   - cvt(cvt(x)) = cvt(x)
+//   - cvt(f(x)) = f'(x), where f' is a copy of f in the layout of the conversion,
+//     if f is cheaper to recompute than to convert
+ir::value* coalesce::simplify(ir::instruction *i, ir::builder& builder){
+  ir::value* op = i->get_operand(0);
+  if(auto* cvt = dynamic_cast<ir::cvt_layout_inst*>(op)){
+    i->replace_uses_of_with(op, cvt->get_operand(0));
+    return simplify(i, builder);
+  }
+  // values in shared memory are read in any layout
+  if(layout_->has(op) && layout_->get(op)->to_shared())
+    return i;
+  std::set<ir::value*> seen;
+  int cost = remat_cost(op, seen);
+  int bytes = std::max<int>(op->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8, 1);
+  if(cost <= 0 || cost > 2 * bytes * max_remat_insts_per_byte)
+    return i;
+  builder.set_insert_point(i);
+  std::map<ir::value*, ir::value*> remat;
+  ir::value* ret = rematerialize(op, builder, remat);
+  i->replace_all_uses_with(ret);
+  return ret;
+}
 
 void coalesce::run(ir::module &mod) {
   ir::builder& builder = mod.get_builder();
@@ -125,6 +172,15 @@ void coalesce::run(ir::module &mod) {
       x->replace_uses_of_with(val_inst, new_val);
     }
   }
+  // simplify layout conversions
+  std::vector<ir::instruction*> cvts;
+  for(ir::function *fn: mod.get_function_list())
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction* i: block->get_inst_list())
+    if(dynamic_cast<ir::cvt_layout_inst*>(i))
+      cvts.push_back(i);
+  for(ir::instruction* i: cvts)
+    simplify(i, builder);
 }
 
 
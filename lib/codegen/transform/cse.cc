@@ -0,0 +1,133 @@
+#include <map>
+#include <set>
+#include <unordered_map>
+#include "triton/ir/module.h"
+#include "triton/ir/function.h"
+#include "triton/ir/basic_block.h"
+#include "triton/ir/instructions.h"
+#include "triton/ir/constant.h"
+#include "triton/ir/utils.h"
+#include "triton/codegen/transform/cse.h"
+
+namespace triton {
+namespace codegen{
+namespace transform{
+
+namespace {
+
+struct key_hash {
+  size_t operator()(const std::vector<uint64_t>& key) const {
+    uint64_t ret = 0;
+    for(uint64_t v: key)
+      ret ^= v + 0x9e3779b97f4a7c15ULL + (ret << 6) + (ret >> 2);
+    return ret;
+  }
+};
+
+}
+
+// fills `key` with what identifies the value of `i`, or returns false if
+// instructions equal to `i` may produce different values
+bool cse::get_key(ir::instruction* i, std::vector<uint64_t>& key) {
+  key.clear();
+  key.push_back(i->get_id());
+  key.push_back((uint64_t)i->get_type());
+  for(ir::value* op: i->ops())
+    key.push_back((uint64_t)op);
+  for(const auto& md: i->get_metadatas()){
+    if(ir::metadata::is_location(md.first))
+      continue;
+    key.push_back(md.first);
+    key.push_back(md.second);
+  }
+  // attributes
+  if(auto* x = dynamic_cast<ir::binary_operator*>(i)){
+    key.push_back(x->get_op());
+    key.push_back(x->has_no_unsigned_wrap_);
+    key.push_back(x->has_no_signed_wrap_);
+    key.push_back(x->get_fdiv_ieee_rounding());
+    return true;
+  }
+  if(auto* x = dynamic_cast<ir::cmp_inst*>(i)){
+    key.push_back(x->get_pred());
+    return true;
+  }
+  if(auto* x = dynamic_cast<ir::make_range*>(i)){
+    key.push_back(x->get_first()->get_value());
+    key.push_back(x->get_last()->get_value());
+    return true;
+  }
+  if(auto* x = dynamic_cast<ir::get_program_id_inst*>(i)){
+    key.push_back(x->get_axis());
+    return true;
+  }
+  if(auto* x = dynamic_cast<ir::get_num_programs_inst*>(i)){
+    key.push_back(x->get_axis());
+    return true;
+  }
+  if(auto* x = dynamic_cast<ir::philox_inst*>(i)){
+    key.push_back(x->get_n_rounds());
+    key.push_back(x->get_word());
+    key.push_back(x->get_to_float());
+    return true;
+  }
+  if(auto* x = dynamic_cast<ir::math_inst*>(i)){
+    for(char c: x->get_fn())
+      key.push_back(c);
+    return true;
+  }
+  if(auto* x = dynamic_cast<ir::reduce_inst*>(i)){
+    key.push_back(x->get_op());
+    key.push_back(x->get_axis());
+    return true;
+  }
+  // casts are told apart by their id, and shapes by their type
+  return dynamic_cast<ir::cast_inst*>(i) ||
+         dynamic_cast<ir::getelementptr_inst*>(i) ||
+         dynamic_cast<ir::retile_inst*>(i) ||
+         dynamic_cast<ir::downcast_inst*>(i) ||
+         dynamic_cast<ir::select_inst*>(i) ||
+         dynamic_cast<ir::umulhi_inst*>(i) ||
+         dynamic_cast<ir::exp_inst*>(i) ||
+         dynamic_cast<ir::log_inst*>(i) ||
+         dynamic_cast<ir::cos_inst*>(i) ||
+         dynamic_cast<ir::sin_inst*>(i) ||
+         dynamic_cast<ir::sqrt_inst*>(i);
+}
+
+void cse::run(ir::function* fn) {
+  std::map<ir::basic_block*, std::set<ir::basic_block*>> dom = ir::cfg::dominators(fn);
+  std::unordered_map<std::vector<uint64_t>, std::vector<ir::instruction*>, key_hash> numbered;
+  std::vector<uint64_t> key;
+  for(ir::basic_block* block: ir::cfg::reverse_post_order(fn)){
+    std::set<ir::basic_block*>& block_dom = dom[block];
+    ir::basic_block::inst_list_t insts = block->get_inst_list();
+    for(ir::instruction* i: insts){
+      if(!get_key(i, key))
+        continue;
+      std::vector<ir::instruction*>& candidates = numbered[key];
+      ir::instruction* leader = nullptr;
+      for(ir::instruction* c: candidates)
+        if(block_dom.find(c->get_parent()) != block_dom.end()){
+          leader = c;
+          break;
+        }
+      if(!leader){
+        candidates.push_back(i);
+        continue;
+      }
+      // operands of later instructions change, and so does their key
+      i->replace_all_uses_with(leader);
+      i->erase_from_parent();
+    }
+  }
+}
+
+void cse::run(ir::module& mod) {
+  for(ir::function* fn: mod.get_function_list())
+    run(fn);
+}
+
+}
+}
+}
@@ -11,8 +11,9 @@ namespace transform{
 
 
 inline bool is_shmem_op(ir::instruction* i, int op) {
+  // the metadata of sparse dots is read from shared memory, like their operands
   if(i->get_id() == ir::INST_DOT)
-    return op==0 || op==1;
+    return op==0 || op==1 || op==3;
   if(i->get_id() == ir::INST_COPY_FROM_SHARED)
     return op==0;
   if(i->get_id() == ir::INST_TRANS)
@@ -3,42 +3,67 @@
 #include "triton/ir/basic_block.h"
 #include "triton/ir/module.h"
 #include "triton/ir/utils.h"
+#include <unordered_set>
 #include <iostream>
 
 namespace triton {
 namespace codegen{
 namespace transform{
 
+bool dce::is_root(ir::instruction *i) {
+  switch(i->get_id()){
+    case ir::INST_RETURN:
+    case ir::INST_UNCOND_BRANCH:
+    case ir::INST_COND_BRANCH:
+    case ir::INST_UNMASKED_STORE:
+    case ir::INST_MASKED_STORE:
+    case ir::INST_ATOMIC_CAS:
+    case ir::INST_ATOMIC_RMW:
+    case ir::INST_ATOMIC_EXCH:
+    case ir::INST_CALL:
+    case ir::INST_LAUNCH:
+    case ir::INST_BARRIER:
+    case ir::INST_GRID_SYNC:
+    case ir::INST_FENCE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::vector<ir::instruction*> dce::erase_unused(std::vector<ir::instruction*> seeds) {
+  std::vector<ir::instruction*> erased;
+  std::unordered_set<ir::instruction*> done;
+  std::vector<ir::instruction*> &work_list = seeds;
+  while(!work_list.empty()){
+    ir::instruction* current = work_list.back();
+    work_list.pop_back();
+    // an instruction may be queued several times
+    if(done.count(current) || !current->get_users().empty() || is_root(current))
+      continue;
+    std::vector<ir::value*> ops = current->ops();
+    current->erase_from_parent();
+    done.insert(current);
+    erased.push_back(current);
+    // operands may have lost their last use
+    for(ir::value* op: ops)
+      if(auto *i = dynamic_cast<ir::instruction*>(op))
+        work_list.push_back(i);
+  }
+  return erased;
+}
 
 void dce::run(ir::module &mod) {
-  std::list<ir::instruction*> work_list;
-  std::set<ir::instruction*> marked;
+  std::vector<ir::instruction*> work_list;
+  std::unordered_set<ir::instruction*> marked;
 
   // initialize work-list
-  for(ir::function *fn: mod.get_function_list()){
-    std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
-    // iterate through blocks
-    for(ir::basic_block *block: rpo)
-    for(ir::instruction *i: block->get_inst_list()){
-      switch(i->get_id()){
-        case ir::INST_RETURN:
-        case ir::INST_UNCOND_BRANCH:
-        case ir::INST_COND_BRANCH:
-        case ir::INST_UNMASKED_STORE:
-        case ir::INST_MASKED_STORE:
-        case ir::INST_ATOMIC_CAS:
-        case ir::INST_ATOMIC_RMW:
-        case ir::INST_ATOMIC_EXCH:
-        case ir::INST_CALL:
-        case ir::INST_LAUNCH:
-        case ir::INST_BARRIER: {
-          work_list.push_back(i);
-          marked.insert(i);
-          break;
-        }
-        default:
-          break;
-      }
+  for(ir::function *fn: mod.get_function_list())
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction *i: block->get_inst_list()){
+    if(is_root(i)){
+      work_list.push_back(i);
+      marked.insert(i);
     }
   }
 
@@ -56,22 +81,20 @@ void dce::run(ir::module &mod) {
     // TODO: mark last intstruction of current's reverse-dominance frontier
   }
 
-  // sweep -- delete non-branch unmarked instructions
-  std::vector<ir::instruction*> to_delete;
-  for(ir::function *fn: mod.get_function_list()){
-    std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
-    // iterate through blocks
-    for(ir::basic_block *block: rpo)
-    for(ir::instruction *i: block->get_inst_list()){
-      if(marked.find(i) == marked.end())
-        to_delete.push_back(i);
-    }
+  // sweep -- delete non-branch unmarked instructions, one pass per block
+  for(ir::function *fn: mod.get_function_list())
+  for(ir::basic_block *block: fn->blocks()){
+    std::vector<ir::instruction*> to_delete;
+    block->get_inst_list().remove_if([&](ir::instruction* i){
+      if(marked.find(i) != marked.end())
+        return false;
+      to_delete.push_back(i);
+      return true;
+    });
+    for(ir::instruction* i: to_delete)
+    for(ir::value* op: i->ops())
+      op->erase_use(i);
   }
-
-
-  // delete
-  for(ir::instruction* i: to_delete)
-    i->erase_from_parent();
 }
 
 }
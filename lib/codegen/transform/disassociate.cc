@@ -22,7 +22,7 @@ ir::instruction* rematerialize(ir::builder& bld, ir::instruction *root,
   ir::instruction *new_root = bld.insert(root->clone());
   for(ir::value *op: root->ops()){
     ir::instruction *i = dynamic_cast<ir::instruction*>(op);
-    if(!i || i->get_id() == ir::INST_REDUCE)
+    if(!i || i->get_id() == ir::INST_REDUCE || i->get_id() == ir::INST_SCAN)
       continue;
     ir::instruction* new_op = rematerialize(bld, i, seen);
     new_root->replace_uses_of_with(op, new_op);
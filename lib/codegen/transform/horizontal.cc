@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "triton/ir/module.h"
+#include "triton/ir/function.h"
+#include "triton/ir/basic_block.h"
+#include "triton/ir/instructions.h"
+#include "triton/ir/builder.h"
+#include "triton/codegen/transform/horizontal.h"
+
+namespace triton {
+namespace codegen{
+namespace transform{
+
+void horizontal::run(ir::builder& builder, ir::function* fn) {
+  const auto& args = fn->args();
+  if(args.empty())
+    throw std::runtime_error("horizontal kernel " + fn->get_name() + " lacks its table of launches");
+  ir::value* table = args.back();
+  // instructions rewritten below, collected before new ones are created
+  std::vector<ir::instruction*> ids;
+  for(ir::basic_block* block: fn->blocks())
+  for(ir::instruction* i: block->get_inst_list())
+    if(dynamic_cast<ir::get_program_id_inst*>(i) || dynamic_cast<ir::get_num_programs_inst*>(i))
+      ids.push_back(i);
+  ir::context& ctx = builder.get_context();
+  ir::basic_block* body = fn->blocks()[0];
+  ir::basic_block* entry = ir::basic_block::create(ctx, "horizontal_entry", fn, body);
+  ir::basic_block* search = ir::basic_block::create(ctx, "horizontal_search", fn, body);
+  ir::basic_block* step = ir::basic_block::create(ctx, "horizontal_step", fn, body);
+  ir::basic_block* found = ir::basic_block::create(ctx, "horizontal_found", fn, body);
+  auto load = [&](ir::value* ptr) {
+    return builder.create_load(ptr, ir::load_inst::NONE, ir::load_inst::NORMAL, false);
+  };
+  auto word = [&](ir::value* idx) { return load(builder.create_gep(table, {idx})); };
+  ir::value* one = builder.get_int32(1);
+  ir::value* four = builder.get_int32(4);
+  // entry: reads the number of launches
+  builder.set_insert_point(entry);
+  ir::value* program = builder.create_get_program_id(0);
+  ir::value* num_launches = word(builder.get_int32(0));
+  builder.create_br(search);
+  // search: the launch of the program is in [lo, hi)
+  builder.set_insert_point(search);
+  ir::phi_node* lo = builder.create_phi(builder.get_int32_ty(), 2);
+  ir::phi_node* hi = builder.create_phi(builder.get_int32_ty(), 2);
+  lo->add_incoming(builder.get_int32(0), entry);
+  hi->add_incoming(num_launches, entry);
+  builder.create_cond_br(builder.create_icmpULT(builder.create_add(lo, one), hi), step, found);
+  // step: halves the range
+  builder.set_insert_point(step);
+  ir::value* mid = builder.create_lshr(builder.create_add(lo, hi), one);
+  ir::value* after = builder.create_icmpULE(word(builder.create_add(four, builder.create_mul(mid, four))), program);
+  lo->add_incoming(builder.create_select(after, mid, lo), step);
+  hi->add_incoming(builder.create_select(after, hi, mid), step);
+  builder.create_br(search);
+  // found: program ids in the grid of the launch, and values of its parameters
+  builder.set_insert_point(found);
+  ir::value* row = builder.create_add(four, builder.create_mul(lo, four));
+  ir::value* first = word(row);
+  ir::value* size[3];
+  for(unsigned ax = 0; ax < 3; ax++)
+    size[ax] = word(builder.create_add(row, builder.get_int32(1 + ax)));
+  ir::value* local = builder.create_sub(program, first);
+  ir::value* jk = builder.create_udiv(local, size[0]);
+  ir::value* pid[3];
+  pid[0] = builder.create_urem(local, size[0]);
+  pid[1] = builder.create_urem(jk, size[1]);
+  pid[2] = builder.create_udiv(jk, size[1]);
+  ir::type* i8_ptr_ty = ir::pointer_type::get(builder.get_int8_ty(), 1);
+  ir::value* params_size = word(one);
+  ir::value* params_offset = word(builder.get_int32(2));
+  ir::value* params = builder.create_gep(builder.create_bitcast(table, i8_ptr_ty),
+                                         {builder.create_add(params_offset, builder.create_mul(lo, params_size))});
+  unsigned offset = 0;
+  for(size_t i = 0; i + 1 < args.size(); i++){
+    ir::argument* arg = args[i];
+    ir::type* ty = arg->get_type();
+    // pointers are read as 64-bit integers
+    ir::type* read_ty = ty->is_pointer_ty() ? builder.get_int64_ty() : ty;
+    unsigned nbytes = std::max<unsigned>(read_ty->get_primitive_size_in_bits() / 8, 1);
+    offset = (offset + nbytes - 1) / nbytes * nbytes;
+    ir::value* ptr = builder.create_bitcast(builder.create_gep(params, {builder.get_int32(offset)}),
+                                            ir::pointer_type::get(read_ty, 1));
+    offset += nbytes;
+    ir::value* val = load(ptr);
+    if(ty->is_pointer_ty())
+      val = builder.create_int_to_ptr(val, ty);
+    // the values of all the launches have the alignment the kernel is specialized for
+    for(ir::attribute attr: fn->get_attributes(arg)){
+      unsigned multiple_of = 0;
+      if(attr.get_kind() == ir::multiple_of)
+        multiple_of = attr.get_value();
+      if(attr.get_kind() == ir::aligned)
+        multiple_of = attr.get_value() / std::max<unsigned>(ty->get_pointer_element_ty()->get_primitive_size_in_bits() / 8, 1);
+      if(multiple_of > 0)
+        static_cast<ir::instruction*>(val)->set_metadata(ir::metadata::multiple_of, multiple_of);
+    }
+    arg->replace_all_uses_with(val);
+  }
+  builder.create_br(body);
+  for(ir::instruction* i: ids){
+    if(auto* id = dynamic_cast<ir::get_program_id_inst*>(i))
+      i->replace_all_uses_with(pid[id->get_axis()]);
+    else
+      i->replace_all_uses_with(size[static_cast<ir::get_num_programs_inst*>(i)->get_axis()]);
+    i->erase_from_parent();
+  }
+}
+
+void horizontal::run(ir::module& mod) {
+  ir::builder& builder = mod.get_builder();
+  for(ir::function* fn: mod.get_function_list())
+    if(fn->get_is_kernel())
+      run(builder, fn);
+}
+
+}
+}
+}
@@ -1,8 +1,10 @@
 #include <iostream>
+#include <set>
 #include "triton/codegen/transform/inline.h"
 #include "triton/ir/module.h"
 #include "triton/ir/function.h"
 #include "triton/ir/utils.h"
+#include "triton/ir/instructions.h"
 
 namespace triton{
 namespace codegen{
@@ -89,8 +91,43 @@ void inliner::do_inline(ir::function* fn, ir::call_inst* callsite, ir::builder&
   builder.set_insert_point(exit);
 }
 
-void inliner::run(ir::module &mod) {
+bool inliner::calls_grid_sync(ir::function* fn, std::set<ir::function*>& seen) {
+  if(!seen.insert(fn).second)
+    return false;
+  for(ir::basic_block* block: fn->blocks())
+  for(ir::instruction* instr: block->get_inst_list()){
+    if(dynamic_cast<ir::grid_sync_inst*>(instr))
+      return true;
+    if(auto* call = dynamic_cast<ir::call_inst*>(instr))
+      if(calls_grid_sync(call->get_fn(), seen))
+        return true;
+  }
+  return false;
+}
+
+bool inliner::should_inline(ir::call_inst* callsite, const std::map<ir::function*, size_t>& counts) {
+  const auto& mds = callsite->get_metadatas();
+  auto it = mds.find(ir::metadata::inline_hint);
+  unsigned hint = it == mds.end() ? static_cast<unsigned>(DEFAULT) : it->second;
+  if(!outline_ || hint == ALWAYS)
+    return true;
+  // the counter of grid barriers is a parameter of the kernel
+  std::set<ir::function*> seen;
+  if(calls_grid_sync(callsite->get_fn(), seen))
+    return true;
+  if(hint == NEVER)
+    return false;
+  // every call site but one adds a copy of the callee to the module
+  ir::function* fn = callsite->get_fn();
+  size_t size = 0;
+  for(ir::basic_block* block: fn->blocks())
+    size += block->get_inst_list().size();
+  return size * (counts.at(fn) - 1) <= threshold_;
+}
 
+void inliner::run(ir::module &mod) {
+  // call sites kept as calls
+  std::set<ir::call_inst*> outlined;
   // gather all call sites
   while(true){
     std::map<ir::function*, size_t> counts;
@@ -102,7 +139,8 @@ void inliner::run(ir::module &mod) {
       for(ir::basic_block* block: fn->blocks())
       for(ir::instruction* instr: block->get_inst_list())
       if(ir::call_inst* call = dynamic_cast<ir::call_inst*>(instr)){
-        callsites.push_back(call);
+        if(!outlined.count(call))
+          callsites.push_back(call);
         counts[call->get_fn()] += 1;
       }
     }
@@ -115,11 +153,13 @@ void inliner::run(ir::module &mod) {
     if(callsites.empty())
       break;
 
-    for(ir::call_inst* call: callsites)
-      do_inline(call->get_fn(), call, mod.get_builder(), callsites);
+    for(ir::call_inst* call: callsites){
+      if(should_inline(call, counts))
+        do_inline(call->get_fn(), call, mod.get_builder(), callsites);
+      else
+        outlined.insert(call);
+    }
   }
-
-
 }
 
 }
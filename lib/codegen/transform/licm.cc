@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <map>
+#include "triton/ir/module.h"
+#include "triton/ir/function.h"
+#include "triton/ir/basic_block.h"
+#include "triton/ir/instructions.h"
+#include "triton/ir/constant.h"
+#include "triton/ir/builder.h"
+#include "triton/ir/utils.h"
+#include "triton/codegen/transform/licm.h"
+
+namespace triton {
+namespace codegen{
+namespace transform{
+
+// hoisted tiles may keep at most this many registers of a thread live across a loop
+static const unsigned max_hoisted_footprint = 32;
+
+std::vector<licm::loop> licm::get_loops(ir::function* fn) {
+  const std::vector<ir::basic_block*>& blocks = fn->blocks();
+  std::map<ir::basic_block*, std::set<ir::basic_block*>> dom = ir::cfg::dominators(fn);
+  // natural loops of back edges, merged by header
+  std::map<ir::basic_block*, std::set<ir::basic_block*>> bodies;
+  for(ir::basic_block* block: blocks)
+  for(ir::basic_block* succ: block->get_successors()){
+    if(dom[block].find(succ) == dom[block].end())
+      continue;
+    std::set<ir::basic_block*>& body = bodies[succ];
+    body.insert(succ);
+    std::vector<ir::basic_block*> stack;
+    if(body.insert(block).second)
+      stack.push_back(block);
+    while(!stack.empty()){
+      ir::basic_block* curr = stack.back();
+      stack.pop_back();
+      for(ir::basic_block* pred: curr->get_predecessors())
+        if(body.insert(pred).second)
+          stack.push_back(pred);
+    }
+  }
+  // only loops entered from a single block can be hoisted from
+  std::vector<loop> ret;
+  for(auto& x: bodies){
+    std::vector<ir::basic_block*> entries;
+    for(ir::basic_block* pred: x.first->get_predecessors())
+      if(x.second.find(pred) == x.second.end())
+        entries.push_back(pred);
+    if(entries.size() != 1)
+      continue;
+    ir::basic_block* preheader = entries.front();
+    if(preheader->get_inst_list().empty() ||
+       !dynamic_cast<ir::terminator_inst*>(preheader->get_inst_list().back()))
+      continue;
+    ret.push_back({x.first, preheader, x.second});
+  }
+  // inner loops first, so that their hoisted instructions can move further out
+  std::sort(ret.begin(), ret.end(), [](const loop& a, const loop& b){ return a.blocks.size() < b.blocks.size(); });
+  return ret;
+}
+
+// instructions that neither access memory nor fault; layout conversions only
+// use scratch shared memory of their own
+bool licm::is_hoistable(ir::instruction* i) {
+  if(auto* bin = dynamic_cast<ir::binary_operator*>(i)){
+    if(!bin->is_int_div_rem())
+      return true;
+    ir::value* rhs = bin->get_operand(1);
+    if(auto* splat = dynamic_cast<ir::splat_inst*>(rhs))
+      rhs = splat->get_operand(0);
+    auto* cst = dynamic_cast<ir::constant_int*>(rhs);
+    return cst && cst->get_value() != 0;
+  }
+  return dynamic_cast<ir::cmp_inst*>(i) ||
+         dynamic_cast<ir::cast_inst*>(i) ||
+         dynamic_cast<ir::getelementptr_inst*>(i) ||
+         dynamic_cast<ir::retile_inst*>(i) ||
+         dynamic_cast<ir::make_range*>(i) ||
+         dynamic_cast<ir::get_program_id_inst*>(i) ||
+         dynamic_cast<ir::get_num_programs_inst*>(i) ||
+         dynamic_cast<ir::select_inst*>(i) ||
+         dynamic_cast<ir::umulhi_inst*>(i) ||
+         dynamic_cast<ir::cvt_layout_inst*>(i);
+}
+
+// 32-bit registers per thread that a hoisted `i` keeps live across the loop
+unsigned licm::footprint(ir::instruction* i) {
+  ir::type* ty = i->get_type();
+  if(!ty->is_block_ty())
+    return 0;
+  // broadcasts and ranges are materialized where they are used
+  if(dynamic_cast<ir::splat_inst*>(i) ||
+     dynamic_cast<ir::broadcast_inst*>(i) ||
+     dynamic_cast<ir::make_range*>(i))
+    return 0;
+  unsigned words = std::max<unsigned>(ty->get_scalar_ty()->get_primitive_size_in_bits(), 32) / 32;
+  unsigned num_threads = num_warps_ * 32;
+  return (ty->get_tile_num_elements() + num_threads - 1) / num_threads * words;
+}
+
+void licm::hoist(ir::builder& builder, loop& l) {
+  ir::function* fn = l.header->get_parent();
+  auto is_invariant = [&](ir::instruction* i) {
+    for(ir::value* op: i->ops()){
+      auto* op_i = dynamic_cast<ir::instruction*>(op);
+      if(op_i && l.blocks.find(op_i->get_parent()) != l.blocks.end())
+        return false;
+    }
+    return true;
+  };
+  unsigned hoisted_footprint = 0;
+  bool changed = true;
+  while(changed){
+    changed = false;
+    for(ir::basic_block* block: fn->blocks()){
+      if(l.blocks.find(block) == l.blocks.end())
+        continue;
+      ir::basic_block::inst_list_t insts = block->get_inst_list();
+      for(ir::instruction* i: insts){
+        if(!is_hoistable(i) || !is_invariant(i))
+          continue;
+        unsigned cost = footprint(i);
+        if(hoisted_footprint + cost > max_hoisted_footprint)
+          continue;
+        hoisted_footprint += cost;
+        block->erase(i);
+        builder.set_insert_point(l.preheader->get_inst_list().back());
+        builder.insert(i);
+        changed = true;
+      }
+    }
+  }
+}
+
+void licm::run(ir::module& mod) {
+  for(ir::function* fn: mod.get_function_list()){
+    if(fn->blocks().empty())
+      continue;
+    std::vector<loop> loops = get_loops(fn);
+    for(loop& l: loops)
+      hoist(mod.get_builder(), l);
+  }
+}
+
+}
+}
+}
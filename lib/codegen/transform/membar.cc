@@ -44,13 +44,12 @@ int membar::group_of(ir::value* v, std::vector<ir::value*> &async_write) {
 inline bool membar::intersect_with(analysis::shared_layout* a_layout, analysis::shared_layout* b_layout) {
   if(!a_layout || !b_layout)
     return false;
+  // byte ranges [start, end) overlap
   int a_start = alloc_->offset(a_layout);
   int a_end = a_start + a_layout->get_size();
   int b_start = alloc_->offset(b_layout);
   int b_end = b_start + b_layout->get_size();
-  if(a_start < b_end || b_start < a_end)
-    return true;
-  return false;
+  return a_start < b_end && b_start < a_end;
 }
 
 membar::val_set_t membar::intersect_with(const val_set_t& as, const val_set_t& bs) {
@@ -125,7 +124,7 @@ void membar::transfer(ir::basic_block *block,
       std::vector<int> groups(read.size());
       std::transform(read.begin(), read.end(), groups.begin(), [&](ir::value* v){ return group_of(v, async_write);});
       int N = *std::max_element(groups.begin(), groups.end());
-      if(N < async_write.size()){
+      if(N < (int)async_write.size()){
         builder.set_insert_point(i);
         async_wait = (ir::async_wait_inst*)builder.create_async_wait(async_write.size() - 1 - N);
         barrier = (ir::barrier_inst*)builder.create_barrier();
@@ -147,8 +146,9 @@ void membar::transfer(ir::basic_block *block,
       int N = async_write.size() - async_wait->get_N();
       async_write.erase(async_write.begin(), async_write.begin() + N);
     }
-    // all the copy_to_shared and read from shared are synchronized after barrier
-    if(barrier){
+    // all the copy_to_shared and read from shared are synchronized after barrier.
+    // Named barriers only synchronize some of the threads
+    if(barrier && !barrier->is_named()){
       sync_write.clear();
       sync_read.clear();
     }
@@ -159,7 +159,7 @@ void membar::transfer(ir::basic_block *block,
   // fixme: to support more general cases
   if (async_waits.size() == 2) {
     // (aw N; bar; prefetch; aw N-1; bar; prefetch; => aw N-1; bar; 2*prefetch;)
-    for (int idx=0; idx<async_waits.size()-1; ++idx) {
+    for (size_t idx=0; idx<async_waits.size()-1; ++idx) {
       ir::async_wait_inst *first_async_wait = async_waits[idx];
       std::vector<ir::instruction*> to_erase;
       ir::basic_block::inst_list_t instructions = block->get_inst_list();
@@ -191,8 +191,15 @@ void membar::transfer(ir::basic_block *block,
   }
 }
 
+static size_t num_barriers(ir::module &mod) {
+  size_t ret = 0;
+  ir::for_each_instruction(mod, [&](ir::instruction* i){ ret += dynamic_cast<ir::barrier_inst*>(i) != nullptr; });
+  return ret;
+}
+
 void membar::run(ir::module &mod) {
   ir::builder &builder = mod.get_builder();
+  size_t num_before = num_barriers(mod);
   // extract phi-node associates with double-buffered
   // shared-memory copies. These can be read from and written to
   // without needing synchronization
@@ -237,6 +244,7 @@ void membar::run(ir::module &mod) {
       }
     }while(inserted);
   }
+  num_inserted_ = num_barriers(mod) - num_before;
 }
 
 }
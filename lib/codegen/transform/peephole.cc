@@ -1,8 +1,10 @@
 #include <algorithm>
 #include <iostream>
+#include <unordered_set>
 #include "triton/ir/module.h"
 #include "triton/ir/function.h"
 #include "triton/codegen/transform/peephole.h"
+#include "triton/codegen/transform/dce.h"
 #include "triton/codegen/analysis/layout.h"
 
 namespace triton {
@@ -87,7 +89,9 @@ bool peephole::rewrite_dot(ir::instruction *value, ir::builder& builder){
     ir::value *a = dot->get_operand(0);
     ir::value *b = dot->get_operand(1);
     builder.set_insert_point(add);
-    ir::value * new_dot = builder.insert(ir::dot_inst::create_nn(a, b, other, dot->allow_tf32(), dot->get_name()));
+    ir::value * new_dot = dot->is_sparse() ? builder.create_sparse_dot(a, dot->get_meta(), b, other)
+                                           : builder.create_dot(a, b, other, dot->allow_tf32(), dot->split_tf32());
+    new_dot->set_name(dot->get_name());
     add->replace_all_uses_with(new_dot);
     return true;
   }
@@ -115,8 +119,11 @@ bool peephole::rewrite_load_to_shared(ir::instruction *value, ir::builder& build
   ir::masked_load_inst* ld = dynamic_cast<ir::masked_load_inst*>(arg);
   if(!ld)
     return false;
-  builder.set_insert_point(copy_to_shared);
+  // asynchronous copies only read global memory
   ir::value *ptr = ld->get_pointer_operand();
+  if(ptr->get_type()->get_scalar_ty()->get_pointer_address_space() == 4)
+    return false;
+  builder.set_insert_point(copy_to_shared);
   ir::value *msk = ld->get_mask_operand();
   ir::value *val = ld->get_false_value_operand();
   analysis::scanline_layout* layout = layouts_->get(ptr)->to_scanline();
@@ -124,6 +131,8 @@ bool peephole::rewrite_load_to_shared(ir::instruction *value, ir::builder& build
   int dtsize = value->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8;
   if(nts*dtsize >= 4){
     ir::value* new_load = builder.create_masked_load_async(ptr, msk, val, ld->get_cache_modifier(), ld->get_eviction_policy());
+    if(ld->get_tile_rank())
+      static_cast<ir::load_inst*>(new_load)->set_tile(ld->get_tile());
     copy_to_shared->replace_all_uses_with(new_load);
     return true;
   }
@@ -135,8 +144,17 @@ bool peephole::rewrite_load_to_shared(ir::instruction *value, ir::builder& build
 }
 
 bool peephole::rewrite_unit_red(ir::instruction *value, ir::builder& builder){
+  // inclusive scans along unit axes are no-ops
+  if(auto scan = dynamic_cast<ir::scan_inst*>(value)){
+    ir::value *arg = scan->get_operand(0);
+    if(!scan->is_exclusive() && arg->get_type()->get_block_shapes()[scan->get_axis()] == 1){
+      scan->replace_all_uses_with(arg);
+      return true;
+    }
+    return false;
+  }
   auto x = dynamic_cast<ir::reduce_inst*>(value);
-  if(!x)
+  if(!x || x->is_arg())
     return false;
   ir::value *arg = x->get_operand(0);
   auto shapes = arg->get_type()->get_block_shapes();
@@ -238,6 +256,8 @@ bool peephole::rewrite_select_masked_load(ir::instruction *value, ir::builder& b
                                                    if_value->get_cache_modifier(),
                                                    if_value->get_eviction_policy(),
                                                    if_value->get_is_volatile());
+  if(if_value->get_tile_rank())
+    static_cast<ir::load_inst*>(new_load)->set_tile(if_value->get_tile());
   select->replace_all_uses_with(new_load);
   return true;
 }
@@ -278,52 +298,61 @@ bool peephole::rewrite_cvt_layout(ir::instruction *value, ir::builder& builder){
   return false;
 }
 
+void peephole::run_to_fixpoint(ir::module &mod, const std::function<bool(ir::instruction*)> &rewrite) {
+  // visit every instruction once, then only those a rewrite may have enabled
+  std::vector<ir::instruction*> work_list;
+  for(ir::function *fn: mod.get_function_list())
+  for(ir::basic_block *block: fn->blocks())
+  for(ir::instruction* i: block->get_inst_list())
+    work_list.push_back(i);
+  std::reverse(work_list.begin(), work_list.end());
+  // rewritten or erased instructions are never visited again
+  std::unordered_set<ir::instruction*> done;
+  while(!work_list.empty()){
+    ir::instruction* i = work_list.back();
+    work_list.pop_back();
+    if(done.count(i))
+      continue;
+    std::vector<ir::user*> users(i->get_users().begin(), i->get_users().end());
+    if(!rewrite(i))
+      continue;
+    done.insert(i);
+    // former users now see the replacement, which may itself be new
+    for(ir::user* u: users)
+    if(auto *user = dynamic_cast<ir::instruction*>(u)){
+      work_list.push_back(user);
+      for(ir::value* op: user->ops())
+        if(auto *op_i = dynamic_cast<ir::instruction*>(op))
+          if(!done.count(op_i))
+            work_list.push_back(op_i);
+    }
+    for(ir::instruction* erased: dce::erase_unused({i}))
+      done.insert(erased);
+  }
+}
+
 void peephole::run(ir::module &mod) {
   ir::builder &builder = mod.get_builder();
-  // keep track of whether any modification was made
-  std::set<ir::value*> seen;
-  size_t n_seen;
-
   // rewrite dots first
-  do{
-    n_seen = seen.size();
-    for(ir::function *fn: mod.get_function_list())
-    for(ir::basic_block *block: fn->blocks())
-    for(ir::instruction* i: block->get_inst_list()){
-      if(seen.find(i) != seen.end())
-        continue;
-      bool was_modified = rewrite_dot(i, builder);
-      if(was_modified){
-        seen.insert(i);
-      }
-    }
-  }while(seen.size() != n_seen);
-
+  run_to_fixpoint(mod, [&](ir::instruction* i){
+    return rewrite_dot(i, builder);
+  });
   // rewrite other ops
-  seen.clear();
-  do{
-    n_seen = seen.size();
-    for(ir::function *fn: mod.get_function_list())
-    for(ir::basic_block *block: fn->blocks())
-    for(ir::instruction* i: block->get_inst_list()){
-      if(seen.find(i) != seen.end())
-        continue;
-      bool was_modified = false;
-      was_modified = was_modified || rewrite_mult(i, builder);
-      // was_modified = was_modified || rewrite_cts_cfs(i, builder);
-//      was_modified = was_modified || rewrite_trans_phi(i, builder);
-      was_modified = was_modified || rewrite_insert_extract(i, builder);
-      was_modified = was_modified || rewrite_unit_red(i, builder);
-      was_modified = was_modified || rewrite_gep_ptr_min_off_plus_off(i, builder);
-      // TODO: DOESN'T WORK FOR VECTORIZED MASKED LOAD
-//      was_modified = was_modified || rewrite_select_masked_load(i, builder);
-      was_modified = was_modified || rewrite_cvt_layout(i, builder);
-      if(tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 80)
-        was_modified = was_modified || rewrite_load_to_shared(i, builder);
-      if(was_modified)
-        seen.insert(i);
-    }
-  }while(seen.size() != n_seen);
+  run_to_fixpoint(mod, [&](ir::instruction* i){
+    bool was_modified = false;
+    was_modified = was_modified || rewrite_mult(i, builder);
+    // was_modified = was_modified || rewrite_cts_cfs(i, builder);
+//    was_modified = was_modified || rewrite_trans_phi(i, builder);
+    was_modified = was_modified || rewrite_insert_extract(i, builder);
+    was_modified = was_modified || rewrite_unit_red(i, builder);
+    was_modified = was_modified || rewrite_gep_ptr_min_off_plus_off(i, builder);
+    // TODO: DOESN'T WORK FOR VECTORIZED MASKED LOAD
+//    was_modified = was_modified || rewrite_select_masked_load(i, builder);
+    was_modified = was_modified || rewrite_cvt_layout(i, builder);
+    if(tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 80)
+      was_modified = was_modified || rewrite_load_to_shared(i, builder);
+    return was_modified;
+  });
 }
 
 }
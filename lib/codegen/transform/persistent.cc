@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "triton/ir/module.h"
+#include "triton/ir/function.h"
+#include "triton/ir/basic_block.h"
+#include "triton/ir/instructions.h"
+#include "triton/ir/builder.h"
+#include "triton/codegen/transform/persistent.h"
+
+namespace triton {
+namespace codegen{
+namespace transform{
+
+void persistent::run(ir::builder& builder, ir::function* fn, unsigned raster) {
+  const auto& args = fn->args();
+  if(args.size() < 4)
+    throw std::runtime_error("persistent kernel " + fn->get_name() + " lacks its tile counter and grid sizes");
+  ir::value* counter = args[args.size() - 4];
+  ir::value* size[3] = {args[args.size() - 3], args[args.size() - 2], args[args.size() - 1]};
+  // instructions rewritten below, collected before new ones are created
+  std::vector<ir::return_inst*> rets;
+  std::vector<ir::instruction*> ids;
+  for(ir::basic_block* block: fn->blocks())
+  for(ir::instruction* i: block->get_inst_list()){
+    if(auto* ret = dynamic_cast<ir::return_inst*>(i))
+      rets.push_back(ret);
+    if(dynamic_cast<ir::get_program_id_inst*>(i) || dynamic_cast<ir::get_num_programs_inst*>(i))
+      ids.push_back(i);
+  }
+  ir::context& ctx = builder.get_context();
+  ir::basic_block* body = fn->blocks()[0];
+  ir::basic_block* entry = ir::basic_block::create(ctx, "persistent_entry", fn, body);
+  ir::basic_block* header = ir::basic_block::create(ctx, "persistent_header", fn, body);
+  ir::basic_block* exit = ir::basic_block::create(ctx, "persistent_exit", fn);
+  ir::value* one = builder.get_int32(1);
+  ir::value* always = builder.get_int1(true);
+  // entry: claims the first tile
+  builder.set_insert_point(entry);
+  ir::value* first = builder.create_atomic_add(counter, one, always);
+  ir::value* num_tiles = builder.create_mul(builder.create_mul(size[0], size[1]), size[2]);
+  builder.create_br(header);
+  // header: runs the claimed tile, if any
+  builder.set_insert_point(header);
+  ir::phi_node* tile = builder.create_phi(builder.get_int32_ty(), 1 + rets.size());
+  tile->add_incoming(first, entry);
+  builder.create_cond_br(builder.create_icmpULT(tile, num_tiles), body, exit);
+  // body: claims the next tile, and computes the program ids of the current one
+  builder.set_insert_point(body->get_first_non_phi());
+  ir::value* next = builder.create_atomic_add(counter, one, always);
+  ir::value* size_ij = builder.create_mul(size[0], size[1]);
+  ir::value* ij = builder.create_urem(tile, size_ij);
+  ir::value* pid[3];
+  pid[2] = builder.create_udiv(tile, size_ij);
+  if(!raster){
+    pid[0] = builder.create_urem(ij, size[0]);
+    pid[1] = builder.create_udiv(ij, size[0]);
+  }
+  else{
+    // grouped order, as generator::visit_get_program_id_inst computes it from block ids
+    unsigned side = std::max<unsigned>(1, std::sqrt(raster));
+    ir::value* rows = builder.create_udiv(builder.create_add(builder.get_int32(raster - 1), size[0]), size[0]);
+    ir::value* size_g = builder.create_select(builder.create_icmpULT(rows, builder.get_int32(side)),
+                                              builder.get_int32(side), rows);
+    ir::value* size_gj = builder.create_mul(size_g, size[0]);
+    ir::value* off_i = builder.create_mul(builder.create_udiv(ij, size_gj), size_g);
+    ir::value* left = builder.create_sub(size[1], off_i);
+    size_g = builder.create_select(builder.create_icmpULT(left, size_g), left, size_g);
+    pid[0] = builder.create_udiv(builder.create_urem(ij, size_gj), size_g);
+    pid[1] = builder.create_add(off_i, builder.create_urem(ij, size_g));
+  }
+  for(ir::instruction* i: ids){
+    if(auto* id = dynamic_cast<ir::get_program_id_inst*>(i))
+      i->replace_all_uses_with(pid[id->get_axis()]);
+    else
+      i->replace_all_uses_with(size[static_cast<ir::get_num_programs_inst*>(i)->get_axis()]);
+    i->erase_from_parent();
+  }
+  // returns move on to the next tile
+  for(ir::return_inst* ret: rets){
+    ir::basic_block* block = ret->get_parent();
+    builder.set_insert_point(ret);
+    builder.create_br(header);
+    tile->add_incoming(next, block);
+    ret->erase_from_parent();
+  }
+  // exit: each program makes one claim past the last tile, and the
+  // last of these claims resets the counter for the next launch
+  builder.set_insert_point(exit);
+  ir::value* num_programs = builder.create_get_num_programs(0);
+  ir::value* last = builder.create_add(num_tiles, builder.create_sub(num_programs, one));
+  builder.create_atomic_xchg(counter, builder.get_int32(0), builder.create_icmpEQ(tile, last));
+  builder.create_ret_void();
+}
+
+void persistent::run(ir::module& mod) {
+  ir::builder& builder = mod.get_builder();
+  for(ir::function* fn: mod.get_function_list())
+    if(fn->get_is_kernel())
+      run(builder, fn, mod.get_raster());
+}
+
+}
+}
+}
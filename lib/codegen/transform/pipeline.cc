@@ -1,5 +1,6 @@
 #include <iostream>
 #include <algorithm>
+#include <functional>
 #include "triton/codegen/transform/pipeline.h"
 #include "triton/ir/module.h"
 #include "triton/ir/function.h"
@@ -101,43 +102,127 @@ void finalize_iv_vals(ir::builder& builder, ir::basic_block* block, std::map<ir:
   }
 }
 
+/// true if the loop `block` writes memory, which prefetched loads could alias
+bool has_stores(ir::basic_block* block) {
+  for(ir::instruction* i: block->get_inst_list())
+    if(dynamic_cast<ir::store_inst*>(i) || dynamic_cast<ir::atomic_inst*>(i))
+      return true;
+  return false;
+}
+
+/// true if `v` can be recomputed for other iterations of the loop `block`:
+/// the instructions of the loop it depends on do not access memory
+bool is_rematerializable(ir::value* v, ir::basic_block* block) {
+  ir::instruction* i = dynamic_cast<ir::instruction*>(v);
+  if(!i || i->get_parent() != block || dynamic_cast<ir::phi_node*>(i))
+    return true;
+  if(dynamic_cast<ir::io_inst*>(i) || dynamic_cast<ir::atomic_inst*>(i) || dynamic_cast<ir::call_inst*>(i))
+    return false;
+  for(ir::value* op: i->ops())
+    if(!is_rematerializable(op, block))
+      return false;
+  return true;
+}
+
+/// gives `new_load` the tile of `load`, whose operands are rematerialized by `remat`
+void copy_tile(ir::load_inst* load, ir::value* new_load, std::function<ir::value*(ir::value*)> remat) {
+  std::vector<ir::value*> tile = load->get_tile();
+  if(tile.empty())
+    return;
+  for(ir::value*& v: tile)
+    v = remat(v);
+  static_cast<ir::load_inst*>(new_load)->set_tile(tile);
+}
+
 struct pipeline_info_t {
   ir::load_inst* load;
-  ir::phi_node* ptr;
+  /// pointer induction variable of the loop, or pointers of a tile that the loop computes
+  ir::value* ptr;
+  /// dot that consumes the load through shared memory, or nullptr when
+  /// the load is prefetched in registers
   ir::dot_inst* dot;
 
-  pipeline_info_t(ir::load_inst* load, ir::phi_node* ptr, ir::dot_inst* dot)
+  pipeline_info_t(ir::load_inst* load, ir::value* ptr, ir::dot_inst* dot)
     : load(load), ptr(ptr), dot(dot) {}
 };
 
 void pipeline::run(ir::module &mod) {
+  num_candidates_ = num_pipelined_ = 0;
+  num_dot_stages_ = 0;
   if (num_stages_ <= 1)
     return;
-  // *Very* conservative heuristics for pre-fetching.
+  // Conservative heuristics for pre-fetching.
   // A load instruction can be pipelined if:
   //   - the pointer is a phi node that references a value
-  //     in its basic block (i.e., pointer induction variable)
-  //   - the load has only  a single use in a dot instruction
-  // As more use cases become apparent, this pass will be improved
+  //     in its basic block (i.e., pointer induction variable),
+  //     or the load is that of a tile whose pointers the loop computes
+  //   - the loop is a single block that does not write memory,
+  //     unless the load only feeds a dot
+  // Loads with a single use in a dot are pre-fetched in shared memory,
+  // other loads (e.g., feeding reductions and elementwise math) in registers
   std::vector<pipeline_info_t> to_pipeline;
   ir::for_each_instruction(mod, [&](ir::instruction *i){
     if(auto* load = dynamic_cast<ir::load_inst*>(i)){
-      ir::phi_node* ptr = dynamic_cast<ir::phi_node*>(load->get_pointer_operand());
+      ir::basic_block* block = load->get_parent();
+      ir::value* ptr = load->get_pointer_operand();
+      if(auto* phi = dynamic_cast<ir::phi_node*>(ptr)){
+        if(phi->get_incoming_block(1) != phi->get_parent() || phi->get_parent() != block)
+          return;
+      }
+      else{
+        auto* ptr_inst = dynamic_cast<ir::instruction*>(ptr);
+        auto preds = block->get_predecessors();
+        if(load->get_tile_rank() == 0 || !ptr_inst || ptr_inst->get_parent() != block ||
+           preds.size() != 2 || preds[1] != block || !is_rematerializable(ptr, block))
+          return;
+      }
+      if(!load->get_type()->is_block_ty() || load->get_is_volatile())
+        return;
+      num_candidates_++;
+      ir::basic_block* header = block->get_predecessors()[0];
+      if(!dynamic_cast<ir::cond_branch_inst*>(block->get_inst_list().back()) ||
+         !dynamic_cast<ir::cond_branch_inst*>(header->get_inst_list().back()))
+        return;
       auto users = load->get_users();
+      if(users.empty())
+        return;
       auto dot = dynamic_cast<ir::dot_inst*>(*users.begin());
-      if(ptr && ptr->get_incoming_block(1) == ptr->get_parent()
-         && users.size() == 1 && dot)
+      if(users.size() == 1 && dot)
         to_pipeline.push_back({load, ptr, dot});
+      else if(!has_stores(block))
+        to_pipeline.push_back({load, ptr, nullptr});
     }});
+  // loads that feed dots are buffered in shared memory, once per stage with
+  // asynchronous copies and twice otherwise: use fewer stages when their buffers
+  // would not fit in the shared memory of a block, and no pipelining at all when
+  // double-buffering does not fit either
+  int dot_stages = num_stages_;
+  if(max_shared_memory_ > 0){
+    size_t stage_bytes = 0;
+    for(const pipeline_info_t& info: to_pipeline)
+      if(info.dot){
+        ir::type* ty = info.load->get_type();
+        stage_bytes += ty->get_tile_num_elements() * ty->get_scalar_ty()->get_primitive_size_in_bits() / 8;
+      }
+    auto num_buffers = [&](int stages) { return has_copy_async_ ? stages : 2; };
+    while(dot_stages > 2 && stage_bytes * num_buffers(dot_stages) > max_shared_memory_)
+      dot_stages--;
+    if(stage_bytes * num_buffers(dot_stages) > max_shared_memory_)
+      to_pipeline.erase(std::remove_if(to_pipeline.begin(), to_pipeline.end(),
+                                       [](const pipeline_info_t& info) { return info.dot != nullptr; }),
+                        to_pipeline.end());
+  }
+  num_pipelined_ = to_pipeline.size();
+  num_dot_stages_ = dot_stages;
   // do the pipelining
   std::vector<ir::phi_node*> new_loads;
   ir::builder &builder = mod.get_builder();
-  const int num_stages = num_stages_;
   std::vector<std::pair<ir::phi_node*, std::vector<ir::value*>>> preheader_loads; // Used to reorder loads
 
   for(auto info: to_pipeline){
     ir::load_inst* load = info.load;
-    ir::phi_node* ptr   = info.ptr;
+    ir::value* ptr      = info.ptr;
+    ir::phi_node* ptr_phi = dynamic_cast<ir::phi_node*>(ptr);
     ir::basic_block* block = load->get_parent();
     ir::basic_block* header = block->get_predecessors()[0];
     auto* block_br = dynamic_cast<ir::cond_branch_inst*>(block->get_inst_list().back());
@@ -145,8 +230,10 @@ void pipeline::run(ir::module &mod) {
     assert(block_br);
     assert(header_br);
     ir::type* ty = load->get_type();
+    const int num_stages = info.dot ? dot_stages : num_stages_;
     // multi-stage pipe
-    if (has_copy_async_ && num_stages > 2) {
+    // loads prefetched in registers are multi-buffered with phi nodes on any target
+    if ((has_copy_async_ || !info.dot) && num_stages > 2) {
       ir::value* header_cond = header_br->get_cond();
       ir::value* block_cond = block_br->get_cond();
       // 1. collect induction variables
@@ -167,7 +254,7 @@ void pipeline::run(ir::module &mod) {
             prev_phi_vals[phi] = phi->get_value_for_block(header);
 
       builder.set_insert_point(header->get_inst_list().back());
-      first_ptrs[0] = ptr->get_value_for_block(header);
+      first_ptrs[0] = ptr_phi ? ptr_phi->get_value_for_block(header) : rematerialize_vals(builder, block, ptr, prev_phi_vals);
       loop_conds[0] = header_cond;
       first_masks[0] = builder.create_splat(loop_conds[0], ty->get_block_shapes());
       ir::value* false_value = nullptr;
@@ -180,6 +267,7 @@ void pipeline::run(ir::module &mod) {
       } else
         false_value = builder.create_splat(ir::undef_value::get(ty->get_scalar_ty()), ty->get_block_shapes());
       first_loads[0] = builder.create_masked_load(first_ptrs[0], first_masks[0], false_value, load->get_cache_modifier(), load->get_eviction_policy(), load->get_is_volatile());
+      copy_tile(load, first_loads[0], [&](ir::value* v) { return rematerialize_vals(builder, block, v, prev_phi_vals); });
 
       for (int stage = 1; stage < num_stages-1; ++stage) {
         // mask is the loop condition of the previous iteration
@@ -195,6 +283,7 @@ void pipeline::run(ir::module &mod) {
           false_value = remat_false_value;
         }
         first_loads[stage] = builder.create_masked_load(first_ptrs[stage], first_masks[stage], false_value, load->get_cache_modifier(), load->get_eviction_policy(), load->get_is_volatile());
+        copy_tile(load, first_loads[stage], [&](ir::value* v) { return rematerialize_vals(builder, block, v, prev_phi_vals); });
       }
 
       // create new phis for induction variables
@@ -212,7 +301,8 @@ void pipeline::run(ir::module &mod) {
       // pre-fetch next iteration
       builder.set_insert_point(block->get_inst_list().back());
 //      ir::value* next_ptr = ptr->get_value_for_block(block);
-      ir::value* next_ptr = rematerialize_vals(builder, block, ptr->get_value_for_block(block), load_ivs);
+      ir::value* next_ptr = ptr_phi ? rematerialize_vals(builder, block, ptr_phi->get_value_for_block(block), load_ivs)
+                                    : rematerialize_vals(builder, block, ptr, next_load_ivs);
       ir::value* next_mask = builder.create_splat(
           rematerialize_vals(builder, block, block_cond, load_ivs), ty->get_block_shapes());
       if (auto* masked_load = dynamic_cast<ir::masked_load_inst*>(load)) {
@@ -224,10 +314,12 @@ void pipeline::run(ir::module &mod) {
         false_value = remat_false_value;
       }
       ir::value* next_load = builder.create_masked_load(next_ptr, next_mask, false_value, load->get_cache_modifier(), load->get_eviction_policy(), load->get_is_volatile());
+      copy_tile(load, next_load, [&](ir::value* v) { return rematerialize_vals(builder, block, v, next_load_ivs); });
 
 
       // phi node
-      ptr->set_incoming_value(0, first_ptrs.back());
+      if(ptr_phi)
+        ptr_phi->set_incoming_value(0, first_ptrs.back());
       builder.set_insert_point(block->get_first_non_phi());
       // nested phis for load
       std::vector<ir::phi_node*> new_load_phis(num_stages-1);
@@ -243,11 +335,12 @@ void pipeline::run(ir::module &mod) {
       new_loads.push_back(new_load_phis.back());
 
       // record first_loads to reorder them
-      preheader_loads.push_back({new_load_phis.front(), first_loads});
+      if (info.dot)
+        preheader_loads.push_back({new_load_phis.front(), first_loads});
     } else {
       // pre-fetch first iteration
       builder.set_insert_point(header->get_inst_list().back());
-      ir::value* first_ptr = ptr->get_value_for_block(header);
+      ir::value* first_ptr = ptr_phi ? ptr_phi->get_value_for_block(header) : rematerialize(builder, block, ptr, 0);
       ir::value* first_mask = builder.create_splat(header_br->get_cond(), ty->get_block_shapes());
       ir::value* false_value;
       if(auto* masked_load = dynamic_cast<ir::masked_load_inst*>(load)){
@@ -259,9 +352,10 @@ void pipeline::run(ir::module &mod) {
       else
         false_value = builder.create_splat(ir::undef_value::get(ty->get_scalar_ty()), ty->get_block_shapes());
       ir::value* first_load = builder.create_masked_load(first_ptr, first_mask, false_value, load->get_cache_modifier(), load->get_eviction_policy(), load->get_is_volatile());
+      copy_tile(load, first_load, [&](ir::value* v) { return rematerialize(builder, block, v, 0); });
       // pre-fetch next iteration
       builder.set_insert_point(block->get_inst_list().back());
-      ir::value* next_ptr = ptr->get_value_for_block(block);
+      ir::value* next_ptr = ptr_phi ? ptr_phi->get_value_for_block(block) : rematerialize(builder, block, ptr, 1);
       ir::value* next_mask = builder.create_splat(block_br->get_cond(), ty->get_block_shapes());
       if(auto* masked_load = dynamic_cast<ir::masked_load_inst*>(load)){
         ir::value* remat_mask = rematerialize(builder, block, masked_load->get_mask_operand(), 1);
@@ -270,6 +364,7 @@ void pipeline::run(ir::module &mod) {
         false_value = remat_false_value;
       }
       ir::value* next_load = builder.create_masked_load(next_ptr, next_mask, false_value, load->get_cache_modifier(), load->get_eviction_policy(), load->get_is_volatile());
+      copy_tile(load, next_load, [&](ir::value* v) { return rematerialize(builder, block, v, 1); });
       // phi node
       builder.set_insert_point(block->get_first_non_phi());
       ir::phi_node* new_load = builder.create_phi(ty, 2);
@@ -285,8 +380,10 @@ void pipeline::run(ir::module &mod) {
   if (!preheader_loads.empty()) {
     ir::basic_block* header = preheader_loads.begin()->first->get_incoming_block(0);
     builder.set_insert_point(header->get_inst_list().back());
-    for (int i=1; i<num_stages-1; ++i) {
+    for (int i=1; i<dot_stages-1; ++i) {
       for (auto iter = preheader_loads.begin(); iter != preheader_loads.end(); ++iter) {
+        if (iter->first->get_incoming_block(0) != header)
+          continue;
         ir::instruction* original_load = static_cast<ir::instruction*>(iter->second.at(i));
         ir::instruction* moved_load = original_load->clone();
         builder.insert(moved_load);
@@ -307,14 +404,17 @@ void pipeline::run(ir::module &mod) {
     for (size_t idx = 0; idx < to_pipeline.size(); ++idx) {
       auto info = to_pipeline[idx];
       ir::load_inst* load = info.load;
-      ir::phi_node* ptr = info.ptr;
       ir::dot_inst* dot = info.dot;
+      if(!dot)
+        continue;
       ir::basic_block* bb = dot->get_parent();
       recursive_deps(dot, bb, to_move[idx].insts);
       to_move[idx].dst = load;
     }
 
     for(auto& move_config: to_move){
+      if(!move_config.dst)
+        continue;
       builder.set_insert_point_after(move_config.dst);
       for(ir::instruction* i: move_config.insts){
         i->get_parent()->erase(i);
@@ -1,5 +1,6 @@
 #include "triton/codegen/transform/prefetch.h"
 #include "triton/codegen/target.h"
+#include "triton/codegen/analysis/layout.h"
 #include "triton/ir/module.h"
 #include "triton/ir/function.h"
 #include "triton/ir/basic_block.h"
@@ -24,37 +25,61 @@ static void recursive_defs(ir::value *v, ir::basic_block *bb, std::vector<ir::in
     recursive_defs(op, bb, ret);
 }
 
+/// whether the operands of `dot` can be loaded from shared memory one k-slice
+/// ahead, across the back-edge of the loop that carries them
+bool prefetch::can_prefetch(ir::dot_inst *dot) {
+  // only tensor core dots load their operands one k-slice at a time
+  auto *mma = layouts_->get(dot)->to_mma();
+  if (!mma || mma->is_mfma() || !tgt_->as_nvidia())
+    return false;
+  auto a_shape = dot->get_operand(0)->get_type()->get_block_shapes();
+  auto b_shape = dot->get_operand(1)->get_type()->get_block_shapes();
+  // sparse dots read their metadata with each k-slice
+  if (a_shape[1] == 1 || dot->is_sparse())
+    return false;
+  // operands are multi-buffered in shared memory by the loop
+  auto *a = dynamic_cast<ir::phi_node*>(dot->get_operand(0));
+  auto *b = dynamic_cast<ir::phi_node*>(dot->get_operand(1));
+  if (!a || a->get_incoming_block(1) != a->get_parent() ||
+      !b || b->get_incoming_block(1) != b->get_parent() ||
+      a->get_incoming_block(0) != b->get_incoming_block(0))
+    return false;
+  for (ir::phi_node *phi : {a, b}) {
+    auto *shared = layouts_->get(phi)->to_shared();
+    if (!shared || !(shared->get_double_buffer() || shared->get_N_buffer()))
+      return false;
+    // another dot already prefetches this operand
+    if (is_prefetched(phi->get_incoming_value(0)))
+      return false;
+  }
+  // the fragments of the next k-slice stay live in registers with those of the
+  // current one and the accumulators
+  int k_width = tgt_->as_nvidia()->sm() >= 80 ? mma->get_mma_instr_shape()[2] : 4;
+  auto words = [](ir::value *v, unsigned num_elements) {
+    unsigned bits = v->get_type()->get_scalar_ty()->get_primitive_size_in_bits();
+    return (num_elements * bits + 31) / 32;
+  };
+  unsigned slice = words(a, a_shape[0] / mma->wpt(0) * k_width) / 32 +
+                   words(b, b_shape[1] / mma->wpt(1) * k_width) / 32;
+  unsigned acc = words(dot, dot->get_type()->get_tile_num_elements()) / (num_warps_ * 32);
+  unsigned budget = std::min<unsigned>(255, 65536 / (32 * num_warps_));
+  return acc + 2 * slice <= budget;
+}
+
 void prefetch::run(ir::module &mod) {
-  // 1. collect dots that can be prefethced
-  std::vector<ir::dot_inst*> to_prefetch;
+  prefetched_vals_.clear();
+  ir::builder &builder = mod.get_builder();
+  // 1. prefetch the operands of every dot that allows it
+  std::vector<ir::dot_inst*> dots;
   ir::for_each_instruction(mod, [&](ir::instruction *i) {
-    if (auto *dot = dynamic_cast<ir::dot_inst*>(i)) {
-      // Now only do prefetching when dot is using tensor cores
-      if (!(dot->get_operand(0)->get_type()->get_scalar_ty()->is_fp16_ty() ||
-            dot->get_operand(0)->get_type()->get_scalar_ty()->is_bf16_ty() ||
-            (dot->get_operand(0)->get_type()->get_scalar_ty()->is_fp32_ty() && dot->allow_tf32()
-             && tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 80) || 
-            (dot->get_operand(0)->get_type()->get_scalar_ty()->is_integer_ty(8)
-             && dot->get_operand(1)->get_type()->get_scalar_ty()->is_integer_ty(8)
-             && tgt_->as_nvidia() && tgt_->as_nvidia()->sm() >= 80)
-           )
-         )
-        return;
-      auto *a = dynamic_cast<ir::phi_node*>(dot->get_operand(0));
-      auto *b = dynamic_cast<ir::phi_node*>(dot->get_operand(1));
-      if (a && a->get_incoming_block(1) == a->get_parent() &&
-          b && b->get_incoming_block(1) == b->get_parent()) 
-        to_prefetch.push_back(dot);
-    }
+    if (auto *dot = dynamic_cast<ir::dot_inst*>(i))
+      dots.push_back(dot);
   });
-
-  assert(to_prefetch.size() <=1 && "Don't know what to do with multiple dots");
-  ir::builder &builder = mod.get_builder();
-  // 2. do the prefetching
-  for (ir::dot_inst* dot : to_prefetch) {
+  for (ir::dot_inst* dot : dots) {
+    if (!can_prefetch(dot))
+      continue;
     auto *a = dynamic_cast<ir::phi_node*>(dot->get_operand(0));
     auto *b = dynamic_cast<ir::phi_node*>(dot->get_operand(1));
-    assert(a->get_incoming_block(0) == b->get_incoming_block(0));
     ir::basic_block *loop_header = a->get_incoming_block(0);
     ir::basic_block *loop_body = a->get_parent();
 
@@ -63,7 +88,6 @@ void prefetch::run(ir::module &mod) {
 
     // 1. in the loop header (first iteration)
     builder.set_insert_point(loop_header->get_inst_list().back());
-    assert(a && b);
     builder.create_prefetch_s(a->get_incoming_value(0), /*inc*/ 0);
     builder.create_prefetch_s(b->get_incoming_value(0), /*inc*/ 0);
 
@@ -90,7 +114,7 @@ void prefetch::run(ir::module &mod) {
     prefetched_vals_.insert(next_b);
   }
 
-  // move loads to the beginning of the loop
+  // 2. move loads to the beginning of the loop
   if (tgt_->as_nvidia() && tgt_->as_nvidia()->sm() < 80) {
     for (ir::function *fn : mod.get_function_list())
     for (ir::basic_block *bb : fn->blocks()) {
@@ -1,49 +1,201 @@
-#include <iostream>
 #include <algorithm>
+#include <climits>
+#include <map>
+#include <set>
+#include <vector>
 #include "triton/ir/module.h"
 #include "triton/ir/function.h"
 #include "triton/ir/basic_block.h"
 #include "triton/ir/instructions.h"
+#include "triton/codegen/analysis/layout.h"
 #include "triton/codegen/transform/reorder.h"
 
 namespace triton {
 namespace codegen{
 namespace transform{
 
-void reorder::run(ir::module& mod){
-//    ir::builder &builder = mod.get_builder();
-//    std::vector<std::pair<ir::instruction*, ir::value*>> to_replace;
-
-//    for(ir::function *fn: mod.get_function_list())
-//    for(ir::basic_block *block: fn->blocks())
-//    for(ir::instruction* i: block->get_inst_list()){
-//      if(auto* ld = dynamic_cast<ir::masked_load_inst*>(i)){
-//        ir::value* _ptr = ld->get_pointer_operand();
-//        ir::value* _msk = ld->get_mask_operand();
-//        ir::value* _val = ld->get_false_value_operand();
-//        auto ptr = std::find(block->begin(), block->end(), _ptr);
-//        auto msk = std::find(block->begin(), block->end(), _msk);
-//        auto val = std::find(block->begin(), block->end(), _val);
-//        if(ptr == block->end() || msk == block->end() || val == block->end())
-//          continue;
-//        auto it = std::find(block->begin(), block->end(), i);
-//        int dist_ptr = std::distance(ptr, it);
-//        int dist_msk = std::distance(msk, it);
-//        int dist_val = std::distance(val, it);
-//        if(dist_ptr < dist_msk && dist_ptr < dist_val)
-//          builder.set_insert_point(++ptr);
-//        if(dist_msk < dist_ptr && dist_msk < dist_val)
-//          builder.set_insert_point(++msk);
-//        if(dist_val < dist_ptr && dist_val < dist_msk)
-//          builder.set_insert_point(++val);
-//        ir::value* new_ld = builder.create_masked_load(_ptr, _msk, _val);
-//        to_replace.push_back(std::make_pair(ld, new_ld));
-//      }
-//    }
-
-//    for(auto& x: to_replace)
-//      x.first->replace_all_uses_with(x.second);
+// instructions that neither read nor write memory
+static bool is_pure(ir::instruction* i) {
+  return dynamic_cast<ir::binary_operator*>(i) ||
+         dynamic_cast<ir::cmp_inst*>(i) ||
+         dynamic_cast<ir::cast_inst*>(i) ||
+         dynamic_cast<ir::getelementptr_inst*>(i) ||
+         dynamic_cast<ir::retile_inst*>(i) ||
+         dynamic_cast<ir::downcast_inst*>(i) ||
+         dynamic_cast<ir::make_range*>(i) ||
+         dynamic_cast<ir::get_program_id_inst*>(i) ||
+         dynamic_cast<ir::get_num_programs_inst*>(i) ||
+         dynamic_cast<ir::select_inst*>(i) ||
+         dynamic_cast<ir::umulhi_inst*>(i) ||
+         dynamic_cast<ir::philox_inst*>(i) ||
+         dynamic_cast<ir::math_inst*>(i) ||
+         dynamic_cast<ir::exp_inst*>(i) ||
+         dynamic_cast<ir::log_inst*>(i) ||
+         dynamic_cast<ir::cos_inst*>(i) ||
+         dynamic_cast<ir::sin_inst*>(i) ||
+         dynamic_cast<ir::sqrt_inst*>(i) ||
+         dynamic_cast<ir::insert_value_inst*>(i) ||
+         dynamic_cast<ir::extract_value_inst*>(i);
+}
+
+// instructions that only read memory
+static bool is_read(ir::instruction* i) {
+  if(dynamic_cast<ir::masked_load_async_inst*>(i))
+    return false;
+  return dynamic_cast<ir::load_inst*>(i) ||
+         dynamic_cast<ir::dot_inst*>(i) ||
+         dynamic_cast<ir::copy_from_shared_inst*>(i);
+}
+
+static bool is_global_load(ir::instruction* i) {
+  return dynamic_cast<ir::load_inst*>(i) && !dynamic_cast<ir::masked_load_async_inst*>(i);
+}
 
+// 32-bit registers per thread held by `v`
+unsigned reorder::footprint(ir::value* v) {
+  ir::type* ty = v->get_type();
+  if(ty->is_void_ty() || ty->is_label_ty())
+    return 0;
+  unsigned words = std::max<unsigned>(ty->get_scalar_ty()->get_primitive_size_in_bits(), 32) / 32;
+  if(!ty->is_block_ty())
+    return words;
+  if(layouts_->has(v) && layouts_->get(v)->to_shared())
+    return 0;
+  unsigned num_threads = num_warps_ * 32;
+  return (ty->get_tile_num_elements() + num_threads - 1) / num_threads * words;
+}
+
+void reorder::schedule(ir::basic_block* block) {
+  ir::basic_block::inst_list_t& list = block->get_inst_list();
+  // phi nodes and the terminator stay in place
+  std::vector<ir::instruction*> head, insts, tail;
+  for(ir::instruction* i: list){
+    if(dynamic_cast<ir::phi_node*>(i) && insts.empty())
+      head.push_back(i);
+    else if(dynamic_cast<ir::terminator_inst*>(i))
+      tail.push_back(i);
+    else
+      insts.push_back(i);
+  }
+  if(insts.size() < 3 || tail.size() > 1)
+    return;
+  std::map<ir::instruction*, size_t> pos;
+  for(size_t n = 0; n < insts.size(); n++)
+    pos[insts[n]] = n;
+  // dependencies, including the order of memory operations
+  std::vector<std::set<size_t>> preds(insts.size());
+  std::vector<std::vector<size_t>> succs(insts.size());
+  int last_write = -1;
+  std::vector<size_t> reads;
+  for(size_t n = 0; n < insts.size(); n++){
+    ir::instruction* i = insts[n];
+    for(ir::value* op: i->ops())
+      if(auto* op_i = dynamic_cast<ir::instruction*>(op))
+      if(pos.find(op_i) != pos.end())
+        preds[n].insert(pos[op_i]);
+    if(is_pure(i))
+      continue;
+    if(last_write >= 0)
+      preds[n].insert(last_write);
+    if(is_read(i)){
+      reads.push_back(n);
+      continue;
+    }
+    preds[n].insert(reads.begin(), reads.end());
+    reads.clear();
+    last_write = n;
+  }
+  for(size_t n = 0; n < insts.size(); n++)
+    for(size_t p: preds[n])
+      succs[p].push_back(n);
+  // values defined in the block stay live until their last use in the block,
+  // or for ever if they are used elsewhere
+  std::vector<unsigned> uses(insts.size(), 0);
+  std::vector<bool> live_out(insts.size(), false);
+  for(size_t n = 0; n < insts.size(); n++)
+    for(ir::user* u: std::set<ir::user*>(insts[n]->get_users().begin(), insts[n]->get_users().end())){
+      auto* u_i = dynamic_cast<ir::instruction*>(u);
+      if(u_i && pos.find(u_i) != pos.end())
+        uses[n]++;
+      else
+        live_out[n] = true;
+    }
+  // register budget of a thread; the footprint model ignores temporaries
+  unsigned budget = std::min(255, 65536 / (32 * num_warps_)) / 2;
+  unsigned pressure = 0;
+  std::vector<size_t> num_preds(insts.size());
+  std::set<size_t> ready;
+  for(size_t n = 0; n < insts.size(); n++)
+    if((num_preds[n] = preds[n].size()) == 0)
+      ready.insert(n);
+  // operands defined in the block
+  std::vector<std::set<size_t>> args(insts.size());
+  for(size_t n = 0; n < insts.size(); n++)
+    for(ir::value* op: insts[n]->ops())
+      if(auto* op_i = dynamic_cast<ir::instruction*>(op))
+      if(pos.find(op_i) != pos.end())
+        args[n].insert(pos[op_i]);
+  // position of each instruction in the schedule
+  std::vector<int> scheduled_at(insts.size(), -1);
+  std::vector<ir::instruction*> order;
+  while(!ready.empty()){
+    size_t best = *ready.begin();
+    if(pressure < budget){
+      // loads go first, then instructions that do not wait for recent loads
+      auto is_waiting = [&](size_t n){
+        for(size_t p: args[n])
+          if(is_global_load(insts[p]) && (int)order.size() - scheduled_at[p] < 8)
+            return true;
+        return false;
+      };
+      auto load = std::find_if(ready.begin(), ready.end(), [&](size_t n){ return is_global_load(insts[n]); });
+      auto other = std::find_if(ready.begin(), ready.end(), [&](size_t n){ return !is_waiting(n); });
+      if(load != ready.end())
+        best = *load;
+      else if(other != ready.end())
+        best = *other;
+    }
+    else{
+      // free as many registers as possible
+      int best_gain = INT_MIN;
+      for(size_t n: ready){
+        int gain = -(int)footprint(insts[n]);
+        for(size_t p: args[n])
+          if(uses[p] == 1 && !live_out[p])
+            gain += footprint(insts[p]);
+        if(gain > best_gain){
+          best_gain = gain;
+          best = n;
+        }
+      }
+    }
+    ready.erase(best);
+    scheduled_at[best] = order.size();
+    order.push_back(insts[best]);
+    pressure += footprint(insts[best]);
+    for(size_t p: args[best])
+      if(--uses[p] == 0 && !live_out[p])
+        pressure -= footprint(insts[p]);
+    for(size_t s: succs[best])
+      if(--num_preds[s] == 0)
+        ready.insert(s);
+  }
+  // the dependencies of a valid block are acyclic
+  if(order.size() != insts.size())
+    return;
+  list.clear();
+  list.insert(list.end(), head.begin(), head.end());
+  list.insert(list.end(), order.begin(), order.end());
+  list.insert(list.end(), tail.begin(), tail.end());
+}
+
+void reorder::run(ir::module& mod){
+  for(ir::function *fn: mod.get_function_list()){
+    if(!fn->get_schedule())
+      continue;
+    for(ir::basic_block *block: fn->blocks())
+      schedule(block);
+  }
 }
 
 }
@@ -0,0 +1,284 @@
+#include <vector>
+#include "triton/ir/module.h"
+#include "triton/ir/function.h"
+#include "triton/ir/basic_block.h"
+#include "triton/ir/instructions.h"
+#include "triton/ir/constant.h"
+#include "triton/ir/type.h"
+#include "triton/codegen/transform/unroll.h"
+
+namespace triton {
+namespace codegen{
+namespace transform{
+
+// trip counts are only computed for loops that run at most that many times
+static const int64_t max_trip_count = 4096;
+
+// `x` as a signed integer of `w` bits
+static int64_t normalize(int64_t x, unsigned w) {
+  if(w == 1)
+    return x & 1;
+  if(w >= 64)
+    return x;
+  return (int64_t)((uint64_t)x << (64 - w)) >> (64 - w);
+}
+
+static uint64_t as_unsigned(int64_t x, unsigned w) {
+  return w >= 64 ? (uint64_t)x : (uint64_t)x & ((uint64_t(1) << w) - 1);
+}
+
+// evaluates the scalar integer `v`, given the values of the phi nodes in `env`
+bool unroll::eval(ir::value* v, std::map<ir::value*, int64_t>& env, int64_t& ret) {
+  auto it = env.find(v);
+  if(it != env.end()){
+    ret = it->second;
+    return true;
+  }
+  ir::type* ty = v->get_type();
+  if(ty->is_block_ty() || !ty->is_integer_ty())
+    return false;
+  unsigned w = ty->get_integer_bitwidth();
+  if(auto* x = dynamic_cast<ir::constant_int*>(v)){
+    ret = normalize(x->get_value(), w);
+    return true;
+  }
+  if(auto* x = dynamic_cast<ir::select_inst*>(v)){
+    int64_t pred;
+    if(!eval(x->get_pred_op(), env, pred))
+      return false;
+    return eval(pred ? x->get_if_value_op() : x->get_else_value_op(), env, ret);
+  }
+  if(auto* x = dynamic_cast<ir::cast_inst*>(v)){
+    int64_t a;
+    ir::value* op = x->get_operand(0);
+    if(!eval(op, env, a))
+      return false;
+    unsigned w_op = op->get_type()->get_integer_bitwidth();
+    switch(x->get_op()){
+    case ir::cast_op_t::ZExt: ret = normalize(as_unsigned(a, w_op), w); return true;
+    case ir::cast_op_t::SExt: ret = normalize(w_op == 1 ? -a : a, w); return true;
+    case ir::cast_op_t::Trunc: ret = normalize(a, w); return true;
+    default: return false;
+    }
+  }
+  if(auto* x = dynamic_cast<ir::icmp_inst*>(v)){
+    int64_t a, b;
+    if(!eval(x->get_operand(0), env, a) || !eval(x->get_operand(1), env, b))
+      return false;
+    unsigned w_op = x->get_operand(0)->get_type()->get_integer_bitwidth();
+    uint64_t ua = as_unsigned(a, w_op);
+    uint64_t ub = as_unsigned(b, w_op);
+    switch(x->get_pred()){
+    case ir::ICMP_EQ:  ret = a == b; return true;
+    case ir::ICMP_NE:  ret = a != b; return true;
+    case ir::ICMP_SLT: ret = a < b; return true;
+    case ir::ICMP_SLE: ret = a <= b; return true;
+    case ir::ICMP_SGT: ret = a > b; return true;
+    case ir::ICMP_SGE: ret = a >= b; return true;
+    case ir::ICMP_ULT: ret = ua < ub; return true;
+    case ir::ICMP_ULE: ret = ua <= ub; return true;
+    case ir::ICMP_UGT: ret = ua > ub; return true;
+    case ir::ICMP_UGE: ret = ua >= ub; return true;
+    default: return false;
+    }
+  }
+  auto* x = dynamic_cast<ir::binary_operator*>(v);
+  if(!x)
+    return false;
+  int64_t a, b;
+  if(!eval(x->get_operand(0), env, a) || !eval(x->get_operand(1), env, b))
+    return false;
+  // arithmetic wraps around like in two's complement
+  uint64_t ua = a, ub = b;
+  switch(x->get_op()){
+  case ir::binary_op_t::Add: ret = normalize(ua + ub, w); return true;
+  case ir::binary_op_t::Sub: ret = normalize(ua - ub, w); return true;
+  case ir::binary_op_t::Mul: ret = normalize(ua * ub, w); return true;
+  case ir::binary_op_t::And: ret = normalize(a & b, w); return true;
+  case ir::binary_op_t::Or:  ret = normalize(a | b, w); return true;
+  case ir::binary_op_t::Xor: ret = normalize(a ^ b, w); return true;
+  case ir::binary_op_t::SDiv:
+    if(b == 0 || (b == -1 && a == normalize(int64_t(1) << (w - 1), w)))
+      return false;
+    ret = a / b;
+    return true;
+  case ir::binary_op_t::SRem:
+    if(b == 0 || b == -1)
+      return false;
+    ret = a % b;
+    return true;
+  default:
+    return false;
+  }
+}
+
+// number of times the body of the loop runs, or -1 if it is unknown
+int64_t unroll::get_trip_count(ir::basic_block* loop, ir::basic_block* preheader) {
+  std::map<ir::value*, int64_t> env;
+  // the loop is entered
+  auto* guard = dynamic_cast<ir::cond_branch_inst*>(preheader->get_inst_list().back());
+  if(guard){
+    int64_t cond;
+    if(!eval(guard->get_cond(), env, cond) || (guard->get_true_dest() == loop) != (cond != 0))
+      return -1;
+  }
+  auto* latch = (ir::cond_branch_inst*)loop->get_inst_list().back();
+  // initial values of the scalar phi nodes
+  std::vector<ir::phi_node*> phis;
+  for(ir::instruction* i: loop->get_inst_list()){
+    auto* phi = dynamic_cast<ir::phi_node*>(i);
+    if(!phi)
+      break;
+    int64_t init;
+    if(eval(phi->get_value_for_block(preheader), env, init)){
+      env[phi] = init;
+      phis.push_back(phi);
+    }
+  }
+  for(int64_t n = 1; n <= max_trip_count; n++){
+    int64_t cond;
+    if(!eval(latch->get_cond(), env, cond))
+      return -1;
+    if((latch->get_true_dest() == loop) != (cond != 0))
+      return n;
+    // phi nodes are updated at once
+    std::map<ir::value*, int64_t> next;
+    for(ir::phi_node* phi: phis){
+      int64_t value;
+      if(eval(phi->get_value_for_block(loop), env, value))
+        next[phi] = value;
+    }
+    env = next;
+  }
+  return -1;
+}
+
+// appends a copy of `body` at the insertion point, where values are replaced
+// according to `vmap`, and records the copies in `vmap`
+void unroll::clone_body(ir::builder& builder, const std::vector<ir::instruction*>& body, value_map_t& vmap) {
+  for(ir::instruction* i: body){
+    ir::instruction* new_i = i->clone();
+    for(size_t k = 0; k < new_i->get_num_operands(); k++){
+      ir::value* op = new_i->get_operand(k);
+      auto it = vmap.find(op);
+      new_i->set_operand(k, it != vmap.end() ? it->second : op);
+    }
+    builder.insert(new_i);
+    vmap[i] = new_i;
+  }
+}
+
+bool unroll::run(ir::builder& builder, ir::basic_block* loop) {
+  // single-block loops
+  auto* latch = dynamic_cast<ir::cond_branch_inst*>(loop->get_inst_list().back());
+  if(!latch || (latch->get_true_dest() == loop) == (latch->get_false_dest() == loop))
+    return false;
+  ir::basic_block* exit = latch->get_true_dest() == loop ? latch->get_false_dest() : latch->get_true_dest();
+  std::vector<ir::basic_block*> preds = loop->get_predecessors();
+  if(preds.size() != 2 || (preds[0] == loop) == (preds[1] == loop))
+    return false;
+  ir::basic_block* preheader = preds[0] == loop ? preds[1] : preds[0];
+  std::vector<ir::phi_node*> phis;
+  std::vector<ir::instruction*> body;
+  bool has_dot = false;
+  for(ir::instruction* i: loop->get_inst_list()){
+    if(auto* phi = dynamic_cast<ir::phi_node*>(i))
+      phis.push_back(phi);
+    else if(i != latch)
+      body.push_back(i);
+    has_dot = has_dot || dynamic_cast<ir::dot_inst*>(i);
+  }
+  int64_t trip_count = get_trip_count(loop, preheader);
+  if(trip_count < 1)
+    return false;
+  auto lookup = [](value_map_t& vmap, ir::value* v) {
+    auto it = vmap.find(v);
+    return it != vmap.end() ? it->second : v;
+  };
+  // full unrolling: the body runs once per iteration, and the loop runs once
+  if(trip_count * body.size() <= max_insts_){
+    value_map_t vmap;
+    for(ir::phi_node* phi: phis)
+      vmap[phi] = phi->get_value_for_block(preheader);
+    builder.set_insert_point(loop);
+    for(int64_t n = 0; n < trip_count; n++){
+      if(n > 0){
+        value_map_t next;
+        for(ir::phi_node* phi: phis)
+          next[phi] = lookup(vmap, phi->get_value_for_block(loop));
+        for(auto& x: next)
+          vmap[x.first] = x.second;
+      }
+      clone_body(builder, body, vmap);
+    }
+    // values of the last iteration are live out
+    for(ir::phi_node* phi: phis)
+      phi->replace_all_uses_with(vmap.at(phi));
+    for(ir::instruction* i: body)
+      i->replace_all_uses_with(vmap.at(i));
+    latch->erase_from_parent();
+    for(ir::instruction* i: body)
+      i->erase_from_parent();
+    for(ir::phi_node* phi: phis)
+      phi->erase_from_parent();
+    builder.set_insert_point(loop);
+    builder.create_br(exit);
+    return true;
+  }
+  // partial unrolling by a factor that divides the trip count, so that the
+  // exit condition is only checked at the end of the new body
+  if(has_dot)
+    return false;
+  int64_t factor = 1;
+  for(int64_t f = max_factor_; f > 1 && factor == 1; f--)
+    if(trip_count % f == 0 && f * body.size() <= max_insts_)
+      factor = f;
+  if(factor == 1)
+    return false;
+  // the original body is the first copy
+  value_map_t vmap;
+  builder.set_insert_point(latch);
+  for(int64_t n = 1; n < factor; n++){
+    value_map_t next;
+    for(ir::phi_node* phi: phis)
+      next[phi] = lookup(vmap, phi->get_value_for_block(loop));
+    for(auto& x: next)
+      vmap[x.first] = x.second;
+    clone_body(builder, body, vmap);
+  }
+  // the last copy feeds the next iteration, the exit condition and users
+  // outside of the loop
+  std::vector<ir::value*> live_out;
+  for(ir::phi_node* phi: phis){
+    ir::value* back = phi->get_value_for_block(loop);
+    ir::value* new_back = lookup(vmap, back);
+    if(new_back == back)
+      continue;
+    for(unsigned n = 0; n < phi->get_num_incoming(); n++)
+      if(phi->get_incoming_block(n) == loop)
+        phi->set_incoming_value(n, new_back);
+    back->erase_use(phi);
+    live_out.push_back(phi);
+  }
+  if(vmap.find(latch->get_cond()) != vmap.end())
+    latch->replace_uses_of_with(latch->get_cond(), vmap.at(latch->get_cond()));
+  live_out.insert(live_out.end(), body.begin(), body.end());
+  for(ir::value* v: live_out)
+  for(ir::user* u: std::vector<ir::user*>(v->get_users().begin(), v->get_users().end())){
+    auto* u_i = dynamic_cast<ir::instruction*>(u);
+    if(u_i && u_i->get_parent() != loop)
+      u_i->replace_uses_of_with(v, vmap.at(v));
+  }
+  return true;
+}
+
+void unroll::run(ir::module& mod) {
+  ir::builder& builder = mod.get_builder();
+  for(ir::function* fn: mod.get_function_list())
+  for(ir::basic_block* block: std::vector<ir::basic_block*>(fn->blocks().begin(), fn->blocks().end()))
+    run(builder, block);
+}
+
+}
+}
+}
@@ -76,6 +76,10 @@ void* dispatch::fname ## _;
 {return f_impl<dispatch::init>(hlib, fname, fname ## _, #fname, a, b, c, d, e, f, g, h, i, j, k); }\
 void* dispatch::fname ## _;
 
+#define DEFINE12(init, hlib, ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12) ret dispatch::fname(t1 a, t2 b, t3 c, t4 d, t5 e, t6 f, t7 g, t8 h, t9 i, t10 j, t11 k, t12 l)\
+{return f_impl<dispatch::init>(hlib, fname, fname ## _, #fname, a, b, c, d, e, f, g, h, i, j, k, l); }\
+void* dispatch::fname ## _;
+
 #define DEFINE13(init, hlib, ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13) ret dispatch::fname(t1 a, t2 b, t3 c, t4 d, t5 e, t6 f, t7 g, t8 h, t9 i, t10 j, t11 k, t12 l, t13 m)\
 {return f_impl<dispatch::init>(hlib, fname, fname ## _, #fname, a, b, c, d, e, f, g, h, i, j, k, l, m); }\
 void* dispatch::fname ## _;
@@ -122,11 +126,15 @@ bool dispatch::cuinit(){
 #define CUDA_DEFINE9(ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9) DEFINE9(cuinit, cuda_, ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9)
 #define CUDA_DEFINE10(ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10) DEFINE10(cuinit, cuda_, ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10)
 #define CUDA_DEFINE11(ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11) DEFINE11(cuinit, cuda_, ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11)
+#define CUDA_DEFINE12(ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12) DEFINE12(cuinit, cuda_, ret, fname, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12)
 
 // context management
 CUDA_DEFINE1(CUresult, cuCtxDestroy_v2, CUcontext)
 CUDA_DEFINE3(CUresult, cuCtxCreate_v2, CUcontext *, unsigned int, CUdevice)
 CUDA_DEFINE1(CUresult, cuCtxGetDevice, CUdevice*)
+CUDA_DEFINE1(CUresult, cuCtxGetCurrent, CUcontext*)
+CUDA_DEFINE1(CUresult, cuCtxSetCurrent, CUcontext)
+CUDA_DEFINE2(CUresult, cuDevicePrimaryCtxRetain, CUcontext *, CUdevice)
 CUDA_DEFINE2(CUresult, cuCtxEnablePeerAccess, CUcontext, unsigned int)
 CUDA_DEFINE1(CUresult, cuInit, unsigned int)
 CUDA_DEFINE1(CUresult, cuDriverGetVersion, int *)
@@ -160,6 +168,7 @@ CUDA_DEFINE11(CUresult, cuLaunchKernel, CUfunction, unsigned int, unsigned int,
 CUDA_DEFINE3(CUresult, cuFuncGetAttribute, int*, CUfunction_attribute, CUfunction)
 CUDA_DEFINE3(CUresult, cuFuncSetAttribute, CUfunction, CUfunction_attribute, int)
 CUDA_DEFINE2(CUresult, cuFuncSetCacheConfig, CUfunction, CUfunc_cache)
+CUDA_DEFINE4(CUresult, cuOccupancyMaxActiveBlocksPerMultiprocessor, int*, CUfunction, int, size_t)
 // memory management
 CUDA_DEFINE3(CUresult, cuMemcpyDtoH_v2, void *, CUdeviceptr, size_t)
 CUDA_DEFINE1(CUresult, cuMemFree_v2, CUdeviceptr)
@@ -168,12 +177,23 @@ CUDA_DEFINE4(CUresult, cuMemcpyHtoDAsync_v2, CUdeviceptr, const void *, size_t,
 CUDA_DEFINE3(CUresult, cuMemcpyHtoD_v2, CUdeviceptr, const void *, size_t )
 CUDA_DEFINE2(CUresult, cuMemAlloc_v2, CUdeviceptr*, size_t)
 CUDA_DEFINE3(CUresult, cuPointerGetAttribute, void*, CUpointer_attribute, CUdeviceptr)
+CUDA_DEFINE3(CUresult, cuMemGetAddressRange_v2, CUdeviceptr*, size_t*, CUdeviceptr)
 CUDA_DEFINE4(CUresult, cuMemsetD8Async, CUdeviceptr, unsigned char, size_t, CUstream)
+// tensor maps
+CUDA_DEFINE12(CUresult, cuTensorMapEncodeTiled, CUtensorMap*, CUtensorMapDataType, cuuint32_t, void*, const cuuint64_t*, const cuuint64_t*, const cuuint32_t*, const cuuint32_t*, CUtensorMapInterleave, CUtensorMapSwizzle, CUtensorMapL2promotion, CUtensorMapFloatOOBfill)
 // event management
 CUDA_DEFINE2(CUresult, cuEventCreate, CUevent *, unsigned int)
 CUDA_DEFINE3(CUresult, cuEventElapsedTime, float *, CUevent, CUevent)
 CUDA_DEFINE2(CUresult, cuEventRecord, CUevent, CUstream)
 CUDA_DEFINE1(CUresult, cuEventDestroy_v2, CUevent)
+// graph management
+CUDA_DEFINE2(CUresult, cuGraphCreate, CUgraph *, unsigned int)
+CUDA_DEFINE5(CUresult, cuGraphAddKernelNode, CUgraphNode *, CUgraph, const CUgraphNode *, size_t, const CUDA_KERNEL_NODE_PARAMS *)
+CUDA_DEFINE5(CUresult, cuGraphInstantiate_v2, CUgraphExec *, CUgraph, CUgraphNode *, char *, size_t)
+CUDA_DEFINE3(CUresult, cuGraphExecKernelNodeSetParams, CUgraphExec, CUgraphNode, const CUDA_KERNEL_NODE_PARAMS *)
+CUDA_DEFINE2(CUresult, cuGraphLaunch, CUgraphExec, CUstream)
+CUDA_DEFINE1(CUresult, cuGraphExecDestroy, CUgraphExec)
+CUDA_DEFINE1(CUresult, cuGraphDestroy, CUgraph)
 
 
 
@@ -181,19 +201,28 @@ CUDA_DEFINE1(CUresult, cuEventDestroy_v2, CUevent)
  * NVML
  * ------------------- */
 bool dispatch::nvmlinit(){
+  // NVML is initialized once per process
+  if(nvmlInit_v2_ != nullptr)
+    return true;
   #ifdef _WIN32
   if(nvml_==nullptr)
     nvml_ = dlopen("nvml.dll", RTLD_LAZY);
   #else
   if(nvml_==nullptr)
     nvml_ = dlopen("libnvidia-ml.so", RTLD_LAZY);
+  if(nvml_==nullptr)
+    nvml_ = dlopen("libnvidia-ml.so.1", RTLD_LAZY);
   #endif
+  if(nvml_==nullptr)
+    throw std::runtime_error("Could not find `libnvidia-ml.so`. Make sure it is in your LD_LIBRARY_PATH.");
   nvmlReturn_t (*fptr)();
-  nvmlInit_v2_ = dlsym(nvml_, "nvmlInit_v2");
-  *reinterpret_cast<void **>(&fptr) = nvmlInit_v2_;
+  void* init = dlsym(nvml_, "nvmlInit_v2");
+  *reinterpret_cast<void **>(&fptr) = init;
   nvmlReturn_t res = (*fptr)();
-  check(res);
-  return res;
+  if(res != NVML_SUCCESS)
+    throw std::runtime_error("NVML initialization failed with error " + std::to_string(res));
+  nvmlInit_v2_ = init;
+  return true;
 }
 
 #define NVML_DEFINE0(ret, fname) DEFINE0(nvmlinit, nvml_, ret, fname)
@@ -205,6 +234,13 @@ NVML_DEFINE2(nvmlReturn_t, nvmlDeviceGetHandleByPciBusId_v2, const char *, nvmlD
 NVML_DEFINE3(nvmlReturn_t, nvmlDeviceGetClockInfo, nvmlDevice_t, nvmlClockType_t, unsigned int*)
 NVML_DEFINE3(nvmlReturn_t, nvmlDeviceGetMaxClockInfo, nvmlDevice_t, nvmlClockType_t, unsigned int*)
 NVML_DEFINE3(nvmlReturn_t, nvmlDeviceSetApplicationsClocks, nvmlDevice_t, unsigned int, unsigned int)
+NVML_DEFINE1(nvmlReturn_t, nvmlDeviceResetApplicationsClocks, nvmlDevice_t)
+NVML_DEFINE3(nvmlReturn_t, nvmlDeviceSetGpuLockedClocks, nvmlDevice_t, unsigned int, unsigned int)
+NVML_DEFINE1(nvmlReturn_t, nvmlDeviceResetGpuLockedClocks, nvmlDevice_t)
+NVML_DEFINE3(nvmlReturn_t, nvmlDeviceGetTemperature, nvmlDevice_t, nvmlTemperatureSensors_t, unsigned int*)
+NVML_DEFINE2(nvmlReturn_t, nvmlDeviceGetPowerUsage, nvmlDevice_t, unsigned int*)
+NVML_DEFINE2(nvmlReturn_t, nvmlDeviceGetCurrentClocksThrottleReasons, nvmlDevice_t, unsigned long long*)
+NVML_DEFINE1(const char*, nvmlErrorString, nvmlReturn_t)
 
 /* ------------------- *
  * HIP
@@ -249,6 +285,7 @@ HIP_DEFINE3(hipError_t, hipDeviceGetName, char *, int, hipDevice_t)
 HIP_DEFINE3(hipError_t, hipDeviceGetPCIBusId, char *, int, hipDevice_t)
 HIP_DEFINE3(hipError_t, hipDeviceGetAttribute, int *, hipDeviceAttribute_t, hipDevice_t)
 HIP_DEFINE1(hipError_t, hipGetDeviceCount, int *)
+HIP_DEFINE2(hipError_t, hipGetDeviceProperties, hipDeviceProp_t *, int)
 // module management
 HIP_DEFINE4(hipError_t, hipModuleGetGlobal, hipDeviceptr_t*, size_t*, hipModule_t, const char*)
 HIP_DEFINE2(hipError_t, hipModuleLoad, hipModule_t *, const char *)
@@ -263,6 +300,7 @@ HIP_DEFINE1(hipError_t, hipStreamDestroy, hipStream_t)
 HIP_DEFINE11(hipError_t, hipModuleLaunchKernel, hipFunction_t, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, hipStream_t, void **, void **)
 // function management
 HIP_DEFINE2(hipError_t, hipFuncGetAttributes, hipFuncAttributes*, void*)
+HIP_DEFINE3(hipError_t, hipFuncSetAttribute, hipFunction_t, hipFuncAttribute, int)
 HIP_DEFINE2(hipError_t, hipFuncSetCacheConfig, hipFunction_t, hipFuncCache_t)
 // memory management
 HIP_DEFINE3(hipError_t, hipMemcpyDtoH, void *, hipDeviceptr_t, size_t)
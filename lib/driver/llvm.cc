@@ -23,8 +23,13 @@
 #if __has_include(<unistd.h>)
     #include <unistd.h>
 #endif
+#include <map>
 #include <memory>
+#include <mutex>
 #include <regex>
+#include <set>
+#include <stdexcept>
+#include <vector>
 #include "triton/driver/llvm.h"
 #include "triton/driver/dispatch.h"
 #include "triton/driver/error.h"
@@ -45,8 +50,18 @@
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/AlwaysInliner.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Scalar.h"
 
@@ -56,7 +71,16 @@
 #include "llvm/Support/Program.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#ifdef TRITON_USE_LLD
+#include <csignal>
+#include <cerrno>
+#include <thread>
+#include "llvm/Config/llvm-config.h"
+#include "lld/Common/Driver.h"
+#endif
 // end AMD stuff
 
 extern "C"{
@@ -70,17 +94,166 @@ namespace triton{
 namespace driver{
 
 void init_llvm() {
-  LLVMInitializeNVPTXTargetInfo();
-  LLVMInitializeNVPTXTarget();
-  LLVMInitializeNVPTXTargetMC();
-  LLVMInitializeNVPTXAsmPrinter();
-  LLVMInitializeAMDGPUTargetInfo();
-  LLVMInitializeAMDGPUTarget();
-  LLVMInitializeAMDGPUTargetMC();
-  LLVMInitializeAMDGPUAsmPrinter();
+  // target registration is not thread-safe, and
+  // modules may be compiled concurrently
+  static std::once_flag initialized;
+  std::call_once(initialized, [](){
+    LLVMInitializeNVPTXTargetInfo();
+    LLVMInitializeNVPTXTarget();
+    LLVMInitializeNVPTXTargetMC();
+    LLVMInitializeNVPTXAsmPrinter();
+    LLVMInitializeAMDGPUTargetInfo();
+    LLVMInitializeAMDGPUTarget();
+    LLVMInitializeAMDGPUTargetMC();
+    LLVMInitializeAMDGPUAsmPrinter();
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    auto options = llvm::cl::getRegisteredOptions();
+    auto* short_ptr = static_cast<llvm::cl::opt<bool>*>(options["nvptx-short-ptr"]);
+    assert(short_ptr);
+    short_ptr->setValue(true);
+  });
+}
+
+target_machine_ptr get_target_machine(const std::string& triple, const std::string& proc, const std::string& features,
+                                      const llvm::TargetOptions& options, bool pic){
+  static std::mutex mutex;
+  static std::map<std::string, std::vector<std::unique_ptr<llvm::TargetMachine>>> pools;
+  init_llvm();
+  std::string key = triple + "|" + proc + "|" + features;
+  std::unique_ptr<llvm::TargetMachine> machine;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::unique_ptr<llvm::TargetMachine>>& pool = pools[key];
+    if(!pool.empty()){
+      machine = std::move(pool.back());
+      pool.pop_back();
+    }
+  }
+  if(!machine){
+    std::string error;
+    auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if(!target)
+      throw std::runtime_error("no LLVM target for " + triple + ": " + error);
+    llvm::Optional<llvm::Reloc::Model> reloc;
+    if(pic)
+      reloc = llvm::Reloc::PIC_;
+    machine.reset(target->createTargetMachine(triple, proc, features, options, reloc, llvm::None,
+                                              llvm::CodeGenOpt::Aggressive));
+  }
+  return target_machine_ptr(machine.release(), [key](llvm::TargetMachine* machine){
+    std::lock_guard<std::mutex> lock(mutex);
+    pools[key].emplace_back(machine);
+  });
+}
+
+llvm_context_ptr get_llvm_context(){
+  // compilations served by a context before it is replaced
+  static const int max_uses = 32;
+  static std::mutex mutex;
+  static std::vector<std::pair<std::unique_ptr<llvm::LLVMContext>, int>> pool;
+  std::unique_ptr<llvm::LLVMContext> ctx;
+  int uses = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!pool.empty()){
+      ctx = std::move(pool.back().first);
+      uses = pool.back().second;
+      pool.pop_back();
+    }
+  }
+  if(!ctx)
+    ctx.reset(new llvm::LLVMContext);
+  return llvm_context_ptr(ctx.release(), [uses](llvm::LLVMContext* ctx){
+    if(uses + 1 >= max_uses){
+      delete ctx;
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    pool.emplace_back(std::unique_ptr<llvm::LLVMContext>(ctx), uses + 1);
+  });
 }
 
 
+/* ------------------------ */
+//       Middle-end         //
+/* ------------------------ */
+
+static size_t n_instructions(llvm::Module* module){
+  size_t ret = 0;
+  for(llvm::Function& f: module->functions())
+    ret += f.getInstructionCount();
+  return ret;
+}
+
+std::string optimize_llir(llvm::Module* module, llvm::TargetMachine* machine, const std::string& pipeline){
+  if(pipeline.empty())
+    return "";
+  // Triton has already simplified the IR it emits, and it has no calls left
+  // once inlined: scalar cleanups and hoisting out of loops are what pay off
+  std::string text = pipeline;
+  if(pipeline == "fast")
+    text = "always-inline,function(sroa,early-cse,instcombine,simplifycfg,loop(licm),gvn,instcombine,adce)";
+  else if(pipeline == "O1" || pipeline == "O2" || pipeline == "O3")
+    text = "default<" + pipeline + ">";
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+  llvm::PassBuilder builder(machine);
+  builder.registerModuleAnalyses(mam);
+  builder.registerCGSCCAnalyses(cgam);
+  builder.registerFunctionAnalyses(fam);
+  builder.registerLoopAnalyses(lam);
+  builder.crossRegisterProxies(lam, fam, cgam, mam);
+  llvm::ModulePassManager mpm;
+  if(llvm::Error err = builder.parsePassPipeline(mpm, text))
+    throw std::runtime_error("invalid LLVM pipeline '" + pipeline + "': " + llvm::toString(std::move(err)));
+  size_t before = n_instructions(module);
+  mpm.run(*module, mam);
+  size_t after = n_instructions(module);
+  return pipeline + ": " + std::to_string(before) + " -> " + std::to_string(after) + " instructions";
+}
+
+// whether `module` calls functions whose names start with `prefix`, which it only declares
+static bool calls_library(llvm::Module* module, const std::string& prefix){
+  for(llvm::Function& f: module->functions())
+    if(f.isDeclaration() && !f.use_empty() && f.getName().startswith(prefix))
+      return true;
+  return false;
+}
+
+// Links the bitcode libraries at `paths` into `module`. Only the functions it calls
+// are imported; they are internalized and inlined, and then removed
+static void link_libraries(llvm::Module* module, const std::vector<std::string>& paths){
+  std::set<std::string> defined;
+  for(llvm::GlobalValue& v: module->global_values())
+    if(!v.isDeclaration())
+      defined.insert(v.getName().str());
+  for(const std::string& path: paths){
+    llvm::SMDiagnostic diag;
+    std::unique_ptr<llvm::Module> lib = llvm::parseIRFile(path, diag, module->getContext());
+    if(!lib)
+      throw std::runtime_error("unable to parse " + path + ": " + diag.getMessage().str());
+    lib->setTargetTriple(module->getTargetTriple());
+    lib->setDataLayout(module->getDataLayout());
+    if(llvm::Linker::linkModules(*module, std::move(lib), llvm::Linker::Flags::LinkOnlyNeeded))
+      throw std::runtime_error("unable to link " + path);
+  }
+  for(llvm::GlobalValue& v: module->global_values()){
+    if(v.isDeclaration() || defined.count(v.getName().str()))
+      continue;
+    v.setLinkage(llvm::GlobalValue::InternalLinkage);
+    llvm::Function* f = llvm::dyn_cast<llvm::Function>(&v);
+    if(f && !f->hasFnAttribute(llvm::Attribute::NoInline))
+      f->addFnAttr(llvm::Attribute::AlwaysInline);
+  }
+  llvm::legacy::PassManager pm;
+  pm.add(llvm::createAlwaysInlinerLegacyPass());
+  pm.add(llvm::createGlobalDCEPass());
+  pm.run(*module);
+}
+
 /* ------------------------ */
 //         CUDA             //
 /* ------------------------ */
@@ -137,7 +310,34 @@ std::string path_to_ptxas(int& version) {
 }
 
 
+// path to libdevice, the bitcode math library of CUDA
+static std::string path_to_libdevice() {
+  std::vector<std::string> paths;
+  std::string triton_libdevice = tools::getenv("TRITON_LIBDEVICE_PATH");
+  if(!triton_libdevice.empty())
+    paths.push_back(triton_libdevice);
+  std::string cuda_home = tools::getenv("CUDA_HOME");
+  if(!cuda_home.empty())
+    paths.push_back(cuda_home + "/nvvm/libdevice/libdevice.10.bc");
+  paths.push_back("/usr/local/cuda/nvvm/libdevice/libdevice.10.bc");
+  for(const std::string& path: paths)
+    if(std::ifstream(path).good())
+      return path;
+  throw std::runtime_error("math functions are linked from `libdevice.10.bc`, which was searched in"
+                           " TRITON_LIBDEVICE_PATH, CUDA_HOME/nvvm/libdevice/ and /usr/local/cuda/nvvm/libdevice/"
+                           " but could not be found.");
+}
+
 int vptx(int version){
+  if(version >= 12040) return 84;
+  if(version >= 12030) return 83;
+  if(version >= 12020) return 82;
+  if(version >= 12010) return 81;
+  if(version >= 12000) return 80;
+  if(version >= 11080) return 78;
+  if(version >= 11070) return 77;
+  if(version >= 11060) return 76;
+  if(version >= 11050) return 75;
   if(version >= 11040) return 74;
   if(version >= 11030) return 73;
   if(version >= 11020) return 72;
@@ -149,15 +349,19 @@ int vptx(int version){
   throw std::runtime_error("Triton requires CUDA 10+");
 }
 
-std::string llir_to_ptx(llvm::Module* module, int cc, int version){
+int nvidia_cc(const std::string& arch) {
+  static const std::regex arch_re("sm_([1-9][0-9]{1,2})");
+  std::smatch match;
+  if(!std::regex_match(arch, match, arch_re))
+    throw std::invalid_argument("invalid NVIDIA architecture '" + arch + "'");
+  return std::stoi(match[1]);
+}
+
+std::string llir_to_ptx(llvm::Module* module, int cc, int version,
+                        const std::string& pipeline, std::string* opt_report){
   // LLVM version in use may not officially support target hardware
   int max_nvvm_cc = 75;
   int max_nvvm_ptx = 74;
-  // options
-  auto options = llvm::cl::getRegisteredOptions();
-  auto* short_ptr = static_cast<llvm::cl::opt<bool>*>(options["nvptx-short-ptr"]);
-  assert(short_ptr);
-  short_ptr->setValue(true);
   // compute capability
   std::string sm = "sm_" + std::to_string(cc);
   // max PTX version
@@ -181,24 +385,28 @@ std::string llir_to_ptx(llvm::Module* module, int cc, int version){
 
   // create machine
   module->setTargetTriple(triple);
-  std::string error;
-  llvm::TargetMachine* machine;
-  auto target = llvm::TargetRegistry::lookupTarget(module->getTargetTriple(), error);
   llvm::TargetOptions opt;
   opt.AllowFPOpFusion = llvm::FPOpFusion::Fast;
   opt.UnsafeFPMath = false;
   opt.NoInfsFPMath = false;
   opt.NoNaNsFPMath = true;
-  machine = target->createTargetMachine(module->getTargetTriple(), proc, features, opt,
-                                                             llvm::Reloc::PIC_, llvm::None, llvm::CodeGenOpt::Aggressive);
+  target_machine_ptr machine = get_target_machine(triple, proc, features, opt, true);
   // set data layout
   if(layout.empty())
     module->setDataLayout(machine->createDataLayout());
   else
     module->setDataLayout(layout);
+  // math functions; their flush-to-zero paths are selected by the NVVMReflect pass of
+  // the backend, from the `nvvm-reflect-ftz` flag of fast-math modules
+  if(calls_library(module, "__nv_"))
+    link_libraries(module, {path_to_libdevice()});
   // emit machine code
   for (llvm::Function &f : module->functions())
-    f.addFnAttr(llvm::Attribute::AlwaysInline);
+    if(!f.hasFnAttribute(llvm::Attribute::NoInline))
+      f.addFnAttr(llvm::Attribute::AlwaysInline);
+  std::string report = optimize_llir(module, machine.get(), pipeline);
+  if(opt_report)
+    *opt_report = report;
   llvm::legacy::PassManager pass;
   llvm::raw_svector_ostream stream(buffer);
   // emit
@@ -215,7 +423,135 @@ std::string llir_to_ptx(llvm::Module* module, int cc, int version){
 }
 
 
-std::string ptx_to_cubin(const std::string& ptx, const std::string& ptxas, int cc) {
+std::string ptx_assembler(int& version) {
+  CUcontext ctx = nullptr;
+  if(tools::getenv("TRITON_PTXAS_PATH").empty())
+    dispatch::cuCtxGetCurrent(&ctx);
+  if(!ctx)
+    return path_to_ptxas(version);
+  // the driver's JIT accepts PTX up to its own CUDA version
+  dispatch::cuDriverGetVersion(&version);
+  return "";
+}
+
+void parse_ptxas_info(const std::string& log, ptxas_info& info) {
+  info.log = log;
+  std::smatch match;
+  if(std::regex_search(log, match, std::regex("Used (\\d+) registers")))
+    info.n_regs = std::stoi(match[1]);
+  if(std::regex_search(log, match, std::regex("(\\d+) bytes smem")))
+    info.n_shared_static = std::stoi(match[1]);
+  if(std::regex_search(log, match, std::regex("(\\d+) bytes stack frame, (\\d+) bytes spill stores, (\\d+) bytes spill loads"))){
+    info.n_stack_frame = std::stoi(match[1]);
+    info.n_spill_stores = std::stoi(match[2]);
+    info.n_spill_loads = std::stoi(match[3]);
+  }
+}
+
+std::string ptxas_function_log(const std::string& log, const std::string& function) {
+  // each entry function starts with "Compiling entry function '<name>'"
+  std::string header = "Compiling entry function '" + function + "'";
+  size_t begin = log.find(header);
+  if(begin == std::string::npos)
+    return "";
+  begin = log.rfind('\n', begin) + 1;
+  size_t end = log.find("Compiling entry function '", begin + header.size());
+  if(end != std::string::npos)
+    end = log.rfind('\n', end) + 1;
+  return log.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
+std::unique_ptr<llvm::Module> link_llir(const std::vector<std::string>& llirs, std::vector<std::string>& names,
+                                        llvm::LLVMContext& ctx) {
+  std::unique_ptr<llvm::Module> ret;
+  std::set<std::string> taken;
+  for(size_t i = 0; i < llirs.size(); i++){
+    llvm::SMDiagnostic diag;
+    std::unique_ptr<llvm::Module> module = llvm::parseIR(llvm::MemoryBufferRef(llirs[i], names[i]), diag, ctx);
+    if(!module)
+      throw std::runtime_error("unable to parse LLVM-IR: " + diag.getMessage().str());
+    // specializations that only differ by their attributes have the same name
+    std::string name = names[i];
+    for(int n = 1; taken.count(name); n++)
+      name = names[i] + "_" + std::to_string(n);
+    if(name != names[i])
+      module->getFunction(names[i])->setName(name);
+    taken.insert(name);
+    names[i] = name;
+    if(!ret)
+      ret = std::move(module);
+    else if(llvm::Linker::linkModules(*ret, std::move(module)))
+      throw std::runtime_error("unable to link LLVM-IR of kernel " + name);
+  }
+  return ret;
+}
+
+// whether the PTX has .loc directives, to be kept in the line table of the cubin
+static bool has_line_info(const std::string& ptx) {
+  return ptx.find("\t.loc\t") != std::string::npos || ptx.find(".loc ") != std::string::npos;
+}
+
+// whether the PTX launches kernels from the device, which must then be compiled as
+// relocatable code and linked against the device runtime
+static bool launches_kernels(const std::string& ptx) {
+  return ptx.find("cudaLaunchDeviceV2") != std::string::npos;
+}
+
+// path to the static library of the CUDA device runtime
+static std::string path_to_cudadevrt() {
+  std::vector<std::string> paths;
+  std::string triton_cudadevrt = tools::getenv("TRITON_CUDADEVRT_PATH");
+  if(!triton_cudadevrt.empty())
+    paths.push_back(triton_cudadevrt);
+  std::string cuda_home = tools::getenv("CUDA_HOME");
+  if(!cuda_home.empty())
+    paths.push_back(cuda_home + "/lib64/libcudadevrt.a");
+  paths.push_back("/usr/local/cuda/lib64/libcudadevrt.a");
+  for(const std::string& path: paths)
+    if(std::ifstream(path).good())
+      return path;
+  throw std::runtime_error("kernels that launch kernels are linked against `libcudadevrt.a`, which was searched"
+                           " in TRITON_CUDADEVRT_PATH, CUDA_HOME/lib64/ and /usr/local/cuda/lib64/"
+                           " but could not be found.");
+}
+
+// PTX -> cubin through the driver's JIT linker; nothing touches the file system
+static std::string ptx_to_cubin_jit(const std::string& ptx, int cc, std::string& log) {
+  const size_t log_size = 16384;
+  std::vector<char> info_log(log_size, 0);
+  std::vector<char> error_log(log_size, 0);
+  CUjit_option opts[] = {CU_JIT_TARGET, CU_JIT_LOG_VERBOSE,
+                         CU_JIT_INFO_LOG_BUFFER, CU_JIT_INFO_LOG_BUFFER_SIZE_BYTES,
+                         CU_JIT_ERROR_LOG_BUFFER, CU_JIT_ERROR_LOG_BUFFER_SIZE_BYTES,
+                         CU_JIT_GENERATE_LINE_INFO};
+  void* vals[] = {(void*)(uintptr_t)cc, (void*)(uintptr_t)1,
+                  (void*)info_log.data(), (void*)(uintptr_t)log_size,
+                  (void*)error_log.data(), (void*)(uintptr_t)log_size,
+                  (void*)(uintptr_t)has_line_info(ptx)};
+  CUlinkState state;
+  dispatch::cuLinkCreate_v2(sizeof(opts)/sizeof(opts[0]), opts, vals, &state);
+  std::string cubin;
+  try{
+    void* data;
+    size_t size;
+    dispatch::cuLinkAddData_v2(state, CU_JIT_INPUT_PTX, (void*)ptx.c_str(), ptx.size() + 1, "triton.ptx", 0, nullptr, nullptr);
+    // the linker compiles its PTX inputs as relocatable code
+    if(launches_kernels(ptx))
+      dispatch::cuLinkAddFile_v2(state, CU_JIT_INPUT_LIBRARY, path_to_cudadevrt().c_str(), 0, nullptr, nullptr);
+    dispatch::cuLinkComplete(state, &data, &size);
+    // the linker owns `data` until it is destroyed
+    cubin.assign((const char*)data, size);
+  }
+  catch(const std::exception&){
+    dispatch::cuLinkDestroy(state);
+    throw std::runtime_error("Internal Triton PTX codegen error: \n" + std::string(error_log.data()));
+  }
+  dispatch::cuLinkDestroy(state);
+  log = info_log.data();
+  return cubin;
+}
+
+static std::string ptx_to_cubin_ptxas(const std::string& ptx, const std::string& ptxas, int cc, std::string& log) {
   // compile ptx with ptxas
   char _fsrc[L_tmpnam];
   char _flog[L_tmpnam];
@@ -230,23 +566,40 @@ std::string ptx_to_cubin(const std::string& ptx, const std::string& ptxas, int c
   ofs.close();
   std::string cmd;
   int err;
-  cmd = ptxas + " -v --gpu-name=sm_" + std::to_string(cc) + " " + fsrc + " -o " + fsrc + ".o 2> " + flog;
+  bool relocatable = launches_kernels(ptx);
+  cmd = ptxas + " -v --gpu-name=sm_" + std::to_string(cc) + (has_line_info(ptx) ? " -lineinfo " : " ")
+      + (relocatable ? "-c " : "") + fsrc + " -o " + fsrc + ".o 2> " + flog;
   err = system(cmd.c_str());
+  // relocatable code is linked against the device runtime by nvlink, next to ptxas
+  if(err == 0 && relocatable){
+    std::string nvlink = ptxas.substr(0, ptxas.size() - std::string("ptxas").size()) + "nvlink";
+    cmd = nvlink + " --arch=sm_" + std::to_string(cc) + " " + fbin + " " + path_to_cudadevrt()
+        + " -o " + fbin + ".linked 2>> " + flog + " && mv " + fbin + ".linked " + fbin;
+    err = system(cmd.c_str());
+  }
+  std::ifstream _log(_flog);
+  log.assign(std::istreambuf_iterator<char>(_log), {});
+  _log.close();
   if(err != 0){
-    std::ifstream _log(_flog);
-    std::string log(std::istreambuf_iterator<char>(_log), {});
     unlink(_fsrc);
     unlink(_flog);
     throw std::runtime_error("Internal Triton PTX codegen error: \n" + log);
   }
-  CUmodule ret;
   std::ifstream _cubin(_fbin, std::ios::binary );
   std::string cubin(std::istreambuf_iterator<char>(_cubin), {});
   _cubin.close();
   unlink(_fsrc);
   unlink(_flog);
   unlink(_fbin);
-  dispatch::cuModuleLoadData(&ret, cubin.c_str());
+  return cubin;
+}
+
+std::string ptx_to_cubin(const std::string& ptx, const std::string& ptxas, int cc, ptxas_info* info) {
+  std::string log;
+  std::string cubin = ptxas.empty() ? ptx_to_cubin_jit(ptx, cc, log)
+                                    : ptx_to_cubin_ptxas(ptx, ptxas, cc, log);
+  if(info)
+    parse_ptxas_info(log, *info);
   return cubin;
 }
 
@@ -254,95 +607,202 @@ std::string ptx_to_cubin(const std::string& ptx, const std::string& ptxas, int c
 //         HIP              //
 /* ------------------------ */
 
-std::string llir_to_amdgpu(llvm::Module* module, const std::string& _proc) {
-  init_llvm();
+// paths to ocml, the bitcode math library of ROCm, and to the control libraries that
+// configure it for `proc` (e.g., "gfx90a") and, if `fast_math`, for approximate math
+static std::vector<std::string> paths_to_ocml(const std::string& proc, bool fast_math) {
+  std::vector<std::string> dirs;
+  std::string triton_bitcode = tools::getenv("TRITON_ROCM_BITCODE_PATH");
+  if(!triton_bitcode.empty())
+    dirs.push_back(triton_bitcode);
+  std::string rocm_path = tools::getenv("ROCM_PATH");
+  if(!rocm_path.empty())
+    dirs.push_back(rocm_path + "/amdgcn/bitcode");
+  dirs.push_back("/opt/rocm/amdgcn/bitcode");
+  std::string on_off = fast_math ? "_on.bc" : "_off.bc";
+  std::vector<std::string> libs = {"ocml.bc",
+                                   "oclc_finite_only_off.bc",
+                                   "oclc_daz_opt" + on_off,
+                                   "oclc_unsafe_math" + on_off,
+                                   std::string("oclc_correctly_rounded_sqrt") + (fast_math ? "_off.bc" : "_on.bc"),
+                                   "oclc_wavefrontsize64_on.bc",
+                                   "oclc_isa_version_" + proc.substr(3) + ".bc"};
+  for(const std::string& dir: dirs){
+    if(!std::ifstream(dir + "/ocml.bc").good())
+      continue;
+    std::vector<std::string> ret;
+    for(const std::string& lib: libs)
+      ret.push_back(dir + "/" + lib);
+    return ret;
+  }
+  throw std::runtime_error("math functions are linked from `ocml.bc`, which was searched in"
+                           " TRITON_ROCM_BITCODE_PATH, ROCM_PATH/amdgcn/bitcode/ and /opt/rocm/amdgcn/bitcode/"
+                           " but could not be found.");
+}
 
-//  proc = std::get<0>(GetFeatureStrFromGCNArchName(rocminfo));
-//  features = std::get<1>(GetFeatureStrFromGCNArchName(rocminfo));
+std::pair<std::string, std::string> amdgpu_target(const std::string& arch) {
+  // "gfx90a:sramecc+:xnack-" -> processor "gfx90a", features "+sramecc,-xnack"
+  static const std::regex proc_re("gfx[0-9][0-9a-f]{2,3}");
+  static const std::regex feature_re("[a-z0-9]+[+-]");
+  llvm::SmallVector<llvm::StringRef, 4> parts;
+  llvm::StringRef(arch).split(parts, ':');
+  std::string proc = parts[0].str();
+  if(!std::regex_match(proc, proc_re))
+    throw std::invalid_argument("invalid GCN architecture '" + arch + "'");
+  std::string features;
+  for(size_t i = 1; i < parts.size(); i++){
+    std::string feature = parts[i].str();
+    if(!std::regex_match(feature, feature_re))
+      throw std::invalid_argument("invalid target feature '" + feature + "' in GCN architecture '" + arch + "'");
+    features += (features.empty() ? "" : ",") + feature.substr(feature.size() - 1)
+              + feature.substr(0, feature.size() - 1);
+  }
+  return {proc, features};
+}
 
+std::string llir_to_amdgpu(llvm::Module* module, const std::string& arch,
+                           const std::string& pipeline, std::string* opt_report) {
+  init_llvm();
+  auto [proc, features] = amdgpu_target(arch);
   // create
   llvm::SmallVector<char, 0> buffer;
   std::string triple = "amdgcn-amd-amdhsa";
   std::string layout = "";
-  std::string features;
-  std::string proc = "gfx908";
   // verify and store llvm
   llvm::legacy::PassManager pm;
   pm.add(llvm::createVerifierPass());
   pm.run(*module);
   // create machine
   module->setTargetTriple(triple);
-  std::string error;
-  auto target = llvm::TargetRegistry::lookupTarget(module->getTargetTriple(), error);
   llvm::TargetOptions opt;
   opt.AllowFPOpFusion = llvm::FPOpFusion::Fast;
   opt.UnsafeFPMath = false;
   opt.NoInfsFPMath = false;
   opt.NoNaNsFPMath = true;
-  llvm::TargetMachine *machine = target->createTargetMachine(module->getTargetTriple(), proc, features, opt,
-                                                             llvm::Reloc::PIC_, llvm::None,
-                                                             llvm::CodeGenOpt::Aggressive);
+  target_machine_ptr machine = get_target_machine(triple, proc, features, opt, true);
   // set data layout
   if(layout.empty())
     module->setDataLayout(machine->createDataLayout());
   else
     module->setDataLayout(layout);
+  // math functions, configured as approximate for fast-math modules
+  if(calls_library(module, "__ocml_")){
+    bool fast_math = false;
+    for(llvm::Function& f: module->functions())
+      fast_math |= f.getFnAttribute("unsafe-fp-math").getValueAsString() == "true";
+    link_libraries(module, paths_to_ocml(proc, fast_math));
+  }
   // emit machine code
   for (llvm::Function &f : module->functions())
-    f.addFnAttr(llvm::Attribute::AlwaysInline);
+    if(!f.hasFnAttribute(llvm::Attribute::NoInline))
+      f.addFnAttr(llvm::Attribute::AlwaysInline);
+  std::string report = optimize_llir(module, machine.get(), pipeline);
+  if(opt_report)
+    *opt_report = report;
   llvm::legacy::PassManager pass;
   llvm::raw_svector_ostream stream(buffer);
-
-  // create dump files
-  std::string module_name = module->getModuleIdentifier();
-  std::error_code ec;
-
-  // Save GCN ISA binary.
-  std::string isabin_path = std::string("/tmp/") + module_name + std::string(".o");
-  std::unique_ptr<llvm::raw_fd_ostream> isabin_fs(
-      new llvm::raw_fd_ostream(isabin_path, ec, llvm::sys::fs::OF_Text));
-  if (ec)
-  {
-    std::cout << isabin_path << " was not created. error code: " << ec << std::endl;
-  }
-
-  // emit
-  machine->addPassesToEmitFile(pass, *isabin_fs, nullptr, llvm::CGFT_ObjectFile);
+  // emit relocatable object in memory
+  machine->addPassesToEmitFile(pass, stream, nullptr, llvm::CGFT_ObjectFile);
   pass.run(*module);
-  // Save GCN ISA.
-  std::string amdgcn_path = std::string("/tmp/") + module_name + std::string(".gcn");
-  std::string result(buffer.begin(), buffer.end());
-  std::ofstream amdgcn(amdgcn_path);
-  amdgcn << result;
-  amdgcn.close();
+  // relocatable object -> HSA code object
+  return amdgpu_link(std::string(buffer.begin(), buffer.end()));
+}
 
-  // generate HASCO file
-  std::string hsaco_path = std::string("/tmp/") + module_name + std::string(".hsaco");
+#ifdef TRITON_USE_LLD
+// lld only reads its inputs from, and writes its output to, paths: these are the ones
+// of pipes, fed and drained by threads, so that code objects never touch the disk
+std::string amdgpu_link(const std::string& obj) {
+  int in[2], out[2];
+  if(pipe(in))
+    throw std::runtime_error("unable to create pipes for lld");
+  if(pipe(out)){
+    close(in[0]);
+    close(in[1]);
+    throw std::runtime_error("unable to create pipes for lld");
+  }
+  std::thread writer([&](){
+    // lld may fail before it reads its input: writes then fail with EPIPE
+    // instead of raising SIGPIPE in the process
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+    for(size_t done = 0; done < obj.size(); ){
+      ssize_t n = write(in[1], obj.data() + done, obj.size() - done);
+      if(n < 0 && errno == EINTR)
+        continue;
+      if(n <= 0)
+        break;
+      done += n;
+    }
+    close(in[1]);
+  });
+  std::string hsaco;
+  std::thread reader([&](){
+    char buf[65536];
+    for(ssize_t n; (n = read(out[0], buf, sizeof(buf))) != 0; ){
+      if(n < 0 && errno == EINTR)
+        continue;
+      if(n < 0)
+        break;
+      hsaco.append(buf, n);
+    }
+  });
+  std::string obj_path = "/proc/self/fd/" + std::to_string(in[0]);
+  std::string hsaco_path = "/proc/self/fd/" + std::to_string(out[1]);
   std::string error_message;
-  int lld_result =
-      llvm::sys::ExecuteAndWait("/opt/rocm/llvm/bin/ld.lld",
-                                {"/opt/rocm/llvm/bin/ld.lld", "-flavor", "gnu", "-shared", "-o", hsaco_path, isabin_path},
-                                llvm::None, {}, 0, 0, &error_message);
-  if (lld_result)
+  bool lld_success;
   {
-    std::cout << "ld.lld execute fail: " << std::endl;
-    std::cout << error_message << std::endl;
-    std::cout << lld_result << std::endl;
+    // lld keeps global state and is not reentrant
+    static std::mutex lld_mutex;
+    std::lock_guard<std::mutex> lock(lld_mutex);
+    llvm::raw_string_ostream lld_err(error_message);
+    std::vector<const char*> args = {"ld.lld", "-shared", "-o", hsaco_path.c_str(), obj_path.c_str()};
+#if LLVM_VERSION_MAJOR >= 14
+    lld_success = lld::elf::link(args, llvm::nulls(), lld_err, /*exitEarly=*/false, /*disableOutput=*/false);
+#else
+    lld_success = lld::elf::link(args, /*canExitEarly=*/false, llvm::nulls(), lld_err);
+#endif
   }
-
-  return hsaco_path;
+  // the output is complete once lld closed it, and so is the input once it is read
+  close(out[1]);
+  reader.join();
+  close(in[0]);
+  writer.join();
+  close(out[0]);
+  if(!lld_success || hsaco.empty())
+    throw std::runtime_error("ld.lld failed to link AMDGPU code object: \n" + error_message);
+  return hsaco;
 }
+#else
+std::string amdgpu_link(const std::string& obj) {
+  // ld.lld only reads from and writes to files; uniquely named
+  // ones so that concurrent compilations don't collide
+  llvm::SmallString<128> obj_path;
+  llvm::SmallString<128> hsaco_path;
+  int obj_fd;
+  if(llvm::sys::fs::createTemporaryFile("triton", "o", obj_fd, obj_path) ||
+     llvm::sys::fs::createTemporaryFile("triton", "hsaco", hsaco_path))
+    throw std::runtime_error("unable to create temporary files for ld.lld");
+  {
+    llvm::raw_fd_ostream obj_fs(obj_fd, /*shouldClose=*/true);
+    obj_fs << obj;
+  }
+  std::string error_message;
+  bool lld_success =
+      llvm::sys::ExecuteAndWait("/opt/rocm/llvm/bin/ld.lld",
+                                {"/opt/rocm/llvm/bin/ld.lld", "-flavor", "gnu", "-shared", "-o", hsaco_path, obj_path},
+                                llvm::None, {}, 0, 0, &error_message) == 0;
+  llvm::sys::fs::remove(obj_path);
+  auto hsaco = llvm::MemoryBuffer::getFile(hsaco_path);
+  llvm::sys::fs::remove(hsaco_path);
+  if(!lld_success || !hsaco)
+    throw std::runtime_error("ld.lld failed to link AMDGPU code object: \n" + error_message);
+  return (*hsaco)->getBuffer().str();
+}
+#endif
 
 
-hipModule_t amdgpu_to_hipmodule(const std::string& path) {
-  // Read HSACO.
-  std::ifstream hsaco_file(path, std::ios::binary | std::ios::ate);
-  std::ifstream::pos_type hsaco_file_size = hsaco_file.tellg();
-
-  std::vector<unsigned char> hsaco(hsaco_file_size);
-  hsaco_file.seekg(0, std::ios::beg);
-  hsaco_file.read(reinterpret_cast<char*>(&hsaco[0]), hsaco_file_size);
-  hsaco_file.close();
+hipModule_t amdgpu_to_hipmodule(const std::string& hsaco) {
   hipJitOption opt[] = {hipJitOptionErrorLogBufferSizeBytes, hipJitOptionErrorLogBuffer,
                             hipJitOptionInfoLogBufferSizeBytes, hipJitOptionInfoLogBuffer,
                             hipJitOptionLogVerbose};
@@ -358,6 +818,134 @@ hipModule_t amdgpu_to_hipmodule(const std::string& path) {
   return ret;
 }
 
+/* ------------------------ */
+//         HOST             //
+/* ------------------------ */
+
+std::string host_cpu_name() {
+  return llvm::sys::getHostCPUName().str();
+}
+
+static std::vector<std::string> host_cpu_features() {
+  std::vector<std::string> ret;
+  llvm::StringMap<bool> features;
+  if(llvm::sys::getHostCPUFeatures(features))
+    for(auto& f: features)
+      ret.push_back((f.getValue() ? "+" : "-") + f.getKey().str());
+  return ret;
+}
+
+// void <kernel>_launch(i8* params, i32 pid_0, i32 pid_1, i32 pid_2, i32 num_0, i32 num_1, i32 num_2)
+// unpacks `params`, laid out like CUDA parameter buffers, and calls the kernel
+static void add_host_launcher(llvm::Module* module, llvm::Function* kernel) {
+  llvm::LLVMContext& ctx = module->getContext();
+  llvm::IRBuilder<> builder(ctx);
+  const llvm::DataLayout& layout = module->getDataLayout();
+  llvm::FunctionType* kernel_ty = kernel->getFunctionType();
+  unsigned num_args = kernel_ty->getNumParams() - 6;
+  std::vector<llvm::Type*> launch_args_ty = {builder.getInt8PtrTy()};
+  for(unsigned i = 0; i < 6; i++)
+    launch_args_ty.push_back(builder.getInt32Ty());
+  llvm::FunctionType* launch_ty = llvm::FunctionType::get(builder.getVoidTy(), launch_args_ty, false);
+  llvm::Function* launch = llvm::Function::Create(launch_ty, llvm::Function::ExternalLinkage,
+                                                  kernel->getName() + "_launch", module);
+  builder.SetInsertPoint(llvm::BasicBlock::Create(ctx, "entry", launch));
+  std::vector<llvm::Value*> args;
+  uint64_t offset = 0;
+  for(unsigned i = 0; i < num_args; i++){
+    // each argument is aligned to its size
+    llvm::Type* ty = kernel_ty->getParamType(i);
+    uint64_t size = layout.getTypeStoreSize(ty);
+    offset = (offset + size - 1) / size * size;
+    llvm::Value* ptr = builder.CreateGEP(builder.getInt8Ty(), launch->arg_begin(), builder.getInt64(offset));
+    ptr = builder.CreateBitCast(ptr, ty->getPointerTo());
+    args.push_back(builder.CreateAlignedLoad(ty, ptr, llvm::MaybeAlign(1)));
+    offset += size;
+  }
+  for(unsigned i = 1; i <= 6; i++)
+    args.push_back(launch->arg_begin() + i);
+  builder.CreateCall(kernel, args);
+  builder.CreateRetVoid();
+}
+
+std::string llir_to_host(llvm::Module* module, const std::string& name) {
+  init_llvm();
+  // create machine
+  std::string triple = llvm::sys::getProcessTriple();
+  std::string features;
+  for(const std::string& f: host_cpu_features())
+    features += (features.empty() ? "" : ",") + f;
+  llvm::TargetOptions opt;
+  opt.AllowFPOpFusion = llvm::FPOpFusion::Fast;
+  target_machine_ptr machine = get_target_machine(triple, host_cpu_name(), features, opt, false);
+  module->setTargetTriple(triple);
+  module->setDataLayout(machine->createDataLayout());
+  // kernels get inlined into their launcher
+  llvm::Function* kernel = module->getFunction(name);
+  kernel->addFnAttr(llvm::Attribute::AlwaysInline);
+  add_host_launcher(module, kernel);
+  // verify
+  llvm::legacy::PassManager pm;
+  pm.add(llvm::createVerifierPass());
+  pm.run(*module);
+  // -O3, with loop and SLP vectorization for the target's vector width
+  llvm::PassManagerBuilder builder;
+  builder.OptLevel = 3;
+  builder.LoopVectorize = true;
+  builder.SLPVectorize = true;
+  builder.Inliner = llvm::createAlwaysInlinerLegacyPass();
+  machine->adjustPassManager(builder);
+  llvm::legacy::FunctionPassManager fpm(module);
+  llvm::legacy::PassManager mpm;
+  fpm.add(llvm::createTargetTransformInfoWrapperPass(machine->getTargetIRAnalysis()));
+  mpm.add(llvm::createTargetTransformInfoWrapperPass(machine->getTargetIRAnalysis()));
+  builder.populateFunctionPassManager(fpm);
+  builder.populateModulePassManager(mpm);
+  fpm.doInitialization();
+  for(llvm::Function& f: *module)
+    fpm.run(f);
+  fpm.doFinalization();
+  mpm.run(*module);
+  // the code object is produced by the JIT when the binary is loaded
+  std::string result;
+  llvm::raw_string_ostream os(result);
+  module->print(os, nullptr);
+  os.flush();
+  return result;
+}
+
+// host modules are never unloaded, like CUDA modules
+struct host_module {
+  std::unique_ptr<llvm::LLVMContext> ctx;
+  std::unique_ptr<llvm::ExecutionEngine> engine;
+};
+
+uint64_t host_load(const std::string& llir, const std::string& name, host_launch_t& launch) {
+  init_llvm();
+  host_module* ret = new host_module;
+  ret->ctx.reset(new llvm::LLVMContext);
+  llvm::SMDiagnostic diag;
+  std::unique_ptr<llvm::Module> module = llvm::parseIR(llvm::MemoryBufferRef(llir, name), diag, *ret->ctx);
+  if(!module)
+    throw std::runtime_error("unable to parse host LLVM-IR: " + diag.getMessage().str());
+  std::string error;
+  llvm::EngineBuilder builder(std::move(module));
+  builder.setErrorStr(&error)
+         .setEngineKind(llvm::EngineKind::JIT)
+         .setOptLevel(llvm::CodeGenOpt::Aggressive)
+         .setMCPU(host_cpu_name())
+         .setMAttrs(host_cpu_features())
+         .setMCJITMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+  ret->engine.reset(builder.create());
+  if(!ret->engine)
+    throw std::runtime_error("unable to create host JIT: " + error);
+  ret->engine->finalizeObject();
+  launch = (host_launch_t)ret->engine->getFunctionAddress(name + "_launch");
+  if(!launch)
+    throw std::runtime_error("host launcher not found for kernel " + name);
+  return (uint64_t)ret;
+}
+
 
 
 }
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <algorithm>
 #include "triton/ir/basic_block.h"
+#include "triton/ir/context.h"
+#include "triton/ir/context_impl.h"
 #include "triton/ir/instructions.h"
 #include "triton/ir/type.h"
 #include "triton/ir/function.h"
@@ -18,7 +20,15 @@ basic_block::basic_block(context &ctx, const std::string &name, function *parent
 }
 
 basic_block* basic_block::create(context &ctx, const std::string &name, function *parent, basic_block* next){
-  return new basic_block(ctx, name, parent, next);
+  return new (ctx) basic_block(ctx, name, parent, next);
+}
+
+void* basic_block::operator new(size_t size, context &ctx) {
+  return ctx.p_impl->values.allocate(size);
+}
+
+void basic_block::operator delete(void *ptr, context &ctx) {
+  ctx.p_impl->values.release(ptr);
 }
 
 void basic_block::replace_phi_uses_with(basic_block* before, basic_block* after) {
@@ -0,0 +1,1174 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <vector>
+#include "triton/ir/basic_block.h"
+#include "triton/ir/bitcode.h"
+#include "triton/ir/builder.h"
+#include "triton/ir/constant.h"
+#include "triton/ir/function.h"
+#include "triton/ir/instructions.h"
+#include "triton/ir/module.h"
+#include "triton/ir/type.h"
+
+namespace triton{
+namespace ir{
+
+namespace {
+
+//-------------------------------
+// Records
+//-------------------------------
+
+// instruction records are tagged by their value_id_t
+enum tag_t: unsigned {
+  TAG_MODULE = 1024,
+  TAG_SOURCE_FILE,
+  TAG_METADATA,
+  TAG_TYPE,
+  TAG_CONST_INT,
+  TAG_CONST_FP,
+  TAG_UNDEF,
+  TAG_ALLOC,
+  TAG_FUNCTION,
+  TAG_BODY,
+  TAG_FORWARD,
+  TAG_BLOCK,
+};
+
+const std::map<unsigned, std::string>& tag_names() {
+  static const std::map<unsigned, std::string> ret = {
+    {TAG_MODULE, "module"}, {TAG_SOURCE_FILE, "source_file"}, {TAG_METADATA, "metadata"},
+    {TAG_TYPE, "type"}, {TAG_CONST_INT, "const_int"}, {TAG_CONST_FP, "const_fp"},
+    {TAG_UNDEF, "undef"}, {TAG_ALLOC, "alloc"}, {TAG_FUNCTION, "function"},
+    {TAG_BODY, "body"}, {TAG_FORWARD, "forward"}, {TAG_BLOCK, "block"},
+    {INST_CALL, "call"}, {INST_LAUNCH, "launch"}, {INST_PHI, "phi"}, {INST_BINOP, "binop"},
+    {INST_GETELEMENTPTR, "getelementptr"}, {INST_SELECT, "select"}, {INST_SQRT, "sqrt"},
+    {INST_ICMP, "icmp"}, {INST_FCMP, "fcmp"},
+    {INST_CAST_TRUNC, "trunc"}, {INST_CAST_ZEXT, "zext"}, {INST_CAST_SEXT, "sext"},
+    {INST_CAST_FP_TRUNC, "fp_trunc"}, {INST_CAST_FP_EXT, "fp_ext"},
+    {INST_CAST_UI_TO_FP, "ui_to_fp"}, {INST_CAST_SI_TO_FP, "si_to_fp"},
+    {INST_CAST_FP_TO_UI, "fp_to_ui"}, {INST_CAST_FP_TO_SI, "fp_to_si"},
+    {INST_CAST_PTR_TO_INT, "ptr_to_int"}, {INST_CAST_INT_TO_PTR, "int_to_ptr"},
+    {INST_CAST_BIT_CAST, "bitcast"}, {INST_CAST_ADDR_SPACE_CAST, "addr_space_cast"},
+    {INST_RETURN, "ret"}, {INST_COND_BRANCH, "cond_br"}, {INST_UNCOND_BRANCH, "br"},
+    {INST_UNMASKED_LOAD, "unmasked_load"}, {INST_MASKED_LOAD, "masked_load"},
+    {INST_MASKED_LOAD_ASYNC, "masked_load_async"},
+    {INST_UNMASKED_STORE, "unmasked_store"}, {INST_MASKED_STORE, "masked_store"},
+    {INST_EXTRACT_VALUE, "extractvalue"}, {INST_INSERT_VALUE, "insertvalue"},
+    {INST_RESHAPE, "reshape"}, {INST_SPLAT, "splat"}, {INST_CAT, "cat"},
+    {INST_BROADCAST, "broadcast"}, {INST_DOWNCAST, "downcast"},
+    {INST_GET_PROGRAM_ID, "get_program_id"}, {INST_GET_NUM_PROGRAMS, "get_num_programs"},
+    {INST_ATOMIC_CAS, "atomic_cas"}, {INST_ATOMIC_RMW, "atomic_rmw"},
+    {INST_UMULHI, "umulhi"}, {INST_EXP, "exp"}, {INST_COS, "cos"}, {INST_SIN, "sin"}, {INST_LOG, "log"},
+    {INST_TRANS, "trans"}, {INST_REDUCE, "reduce"}, {INST_SCAN, "scan"}, {INST_DOT, "dot"},
+    {INST_COPY_TO_SHARED, "copy_to_shared"}, {INST_COPY_FROM_SHARED, "copy_from_shared"},
+    {INST_CVT_LAYOUT, "cvt_layout"}, {INST_BARRIER, "barrier"}, {INST_ASYNC_WAIT, "async_wait"},
+    {INST_MAKE_RANGE, "make_range"}, {INST_PREFETCH_S, "prefetch_s"},
+    {INST_GLOBALTIMER, "globaltimer"}, {INST_CLOCK, "clock"}, {INST_GRID_SYNC, "grid_sync"}, {INST_PHILOX, "philox"},
+    {INST_MATH, "math"}, {INST_FENCE, "fence"},
+  };
+  return ret;
+}
+
+class record_writer {
+public:
+  virtual ~record_writer() { }
+  virtual void tag(unsigned tag) = 0;
+  virtual void u(uint64_t x) = 0;
+  virtual void real(double x) = 0;
+  virtual void str(const std::string& x) = 0;
+  virtual void end() = 0;
+};
+
+class record_reader {
+public:
+  virtual ~record_reader() { }
+  // false once all records have been read
+  virtual bool tag(unsigned& tag) = 0;
+  virtual uint64_t u() = 0;
+  virtual double real() = 0;
+  virtual std::string str() = 0;
+  virtual void end() = 0;
+};
+
+const char bitcode_magic[4] = {'T', 'T', 'B', 'C'};
+
+class binary_writer: public record_writer {
+public:
+  binary_writer() { out_.append(bitcode_magic, sizeof(bitcode_magic)); }
+  void tag(unsigned tag) { u(tag); }
+  void u(uint64_t x) {
+    do {
+      uint8_t byte = x & 0x7f;
+      x >>= 7;
+      out_.push_back(x ? byte | 0x80 : byte);
+    } while(x);
+  }
+  void real(double x) {
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    u(bits);
+  }
+  void str(const std::string& x) { u(x.size()); out_ += x; }
+  void end() { }
+  const std::string& get() const { return out_; }
+
+private:
+  std::string out_;
+};
+
+class binary_reader: public record_reader {
+public:
+  binary_reader(std::string_view data): data_(data), pos_(sizeof(bitcode_magic)) {
+    if(data.size() < sizeof(bitcode_magic) || data.compare(0, sizeof(bitcode_magic), bitcode_magic, sizeof(bitcode_magic)))
+      throw std::runtime_error("not Triton-IR bitcode");
+  }
+  bool tag(unsigned& tag) {
+    if(pos_ == data_.size())
+      return false;
+    tag = u();
+    return true;
+  }
+  uint64_t u() {
+    uint64_t ret = 0;
+    for(unsigned shift = 0; ; shift += 7){
+      if(pos_ == data_.size() || shift >= 64)
+        throw std::runtime_error("truncated Triton-IR bitcode");
+      uint8_t byte = data_[pos_++];
+      ret |= uint64_t(byte & 0x7f) << shift;
+      if(!(byte & 0x80))
+        return ret;
+    }
+  }
+  double real() {
+    uint64_t bits = u();
+    double ret;
+    std::memcpy(&ret, &bits, sizeof(ret));
+    return ret;
+  }
+  std::string str() {
+    uint64_t size = u();
+    if(size > data_.size() - pos_)
+      throw std::runtime_error("truncated Triton-IR bitcode");
+    std::string ret(data_.substr(pos_, size));
+    pos_ += size;
+    return ret;
+  }
+  void end() { }
+
+private:
+  std::string_view data_;
+  size_t pos_;
+};
+
+// one record per line; strings are quoted, and reals are written in hexadecimal
+// (or as the bits of NaNs) so that they are read back exactly
+class text_writer: public record_writer {
+public:
+  void tag(unsigned tag) { out_ += tag_names().at(tag); }
+  void u(uint64_t x) { out_ += " " + std::to_string(x); }
+  void real(double x) {
+    char buf[64];
+    if(std::isnan(x)){
+      uint64_t bits;
+      std::memcpy(&bits, &x, sizeof(bits));
+      std::snprintf(buf, sizeof(buf), " nan:%llx", (unsigned long long)bits);
+    }
+    else
+      std::snprintf(buf, sizeof(buf), " %a", x);
+    out_ += buf;
+  }
+  void str(const std::string& x) {
+    out_ += " \"";
+    for(unsigned char c: x){
+      if(c == '"' || c == '\\' || c < 0x20 || c >= 0x7f){
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\%02x", c);
+        out_ += buf;
+      }
+      else
+        out_ += c;
+    }
+    out_ += "\"";
+  }
+  void end() { out_ += "\n"; }
+  const std::string& get() const { return out_; }
+
+private:
+  std::string out_;
+};
+
+// blank lines and lines that start with ';' are ignored
+class text_reader: public record_reader {
+public:
+  text_reader(std::string_view text): text_(text), pos_(0), line_(0) { }
+  bool tag(unsigned& tag) {
+    while(true){
+      if(pos_ == text_.size())
+        return false;
+      size_t eol = text_.find('\n', pos_);
+      if(eol == std::string_view::npos)
+        eol = text_.size();
+      line_++;
+      fields_ = text_.substr(pos_, eol - pos_);
+      pos_ = std::min(eol + 1, text_.size());
+      skip_spaces();
+      if(!fields_.empty() && fields_[0] != ';')
+        break;
+    }
+    std::string name = token();
+    for(const auto& it: tag_names())
+      if(it.second == name){
+        tag = it.first;
+        return true;
+      }
+    error("unknown record '" + name + "'");
+    return false;
+  }
+  uint64_t u() {
+    std::string tok = token();
+    char* end;
+    uint64_t ret = std::strtoull(tok.c_str(), &end, 10);
+    if(tok.empty() || *end)
+      error("expected an integer, got '" + tok + "'");
+    return ret;
+  }
+  double real() {
+    std::string tok = token();
+    if(tok.compare(0, 4, "nan:") == 0){
+      uint64_t bits = std::strtoull(tok.c_str() + 4, nullptr, 16);
+      double ret;
+      std::memcpy(&ret, &bits, sizeof(ret));
+      return ret;
+    }
+    char* end;
+    double ret = std::strtod(tok.c_str(), &end);
+    if(tok.empty() || *end)
+      error("expected a real, got '" + tok + "'");
+    return ret;
+  }
+  std::string str() {
+    skip_spaces();
+    if(fields_.empty() || fields_[0] != '"')
+      error("expected a string");
+    std::string ret;
+    size_t i = 1;
+    for(; i < fields_.size() && fields_[i] != '"'; i++){
+      if(fields_[i] != '\\'){
+        ret += fields_[i];
+        continue;
+      }
+      if(i + 2 >= fields_.size())
+        error("truncated escape sequence");
+      ret += (char)std::stoi(std::string(fields_.substr(i + 1, 2)), nullptr, 16);
+      i += 2;
+    }
+    if(i == fields_.size())
+      error("unterminated string");
+    fields_ = fields_.substr(i + 1);
+    return ret;
+  }
+  void end() {
+    skip_spaces();
+    if(!fields_.empty())
+      error("unexpected '" + std::string(fields_) + "'");
+  }
+
+private:
+  void skip_spaces() {
+    while(!fields_.empty() && (fields_[0] == ' ' || fields_[0] == '\t' || fields_[0] == '\r'))
+      fields_ = fields_.substr(1);
+  }
+  std::string token() {
+    skip_spaces();
+    size_t n = 0;
+    while(n < fields_.size() && fields_[n] != ' ' && fields_[n] != '\t' && fields_[n] != '\r')
+      n++;
+    std::string ret(fields_.substr(0, n));
+    fields_ = fields_.substr(n);
+    return ret;
+  }
+  void error(const std::string& msg) {
+    throw std::runtime_error("Triton-IR text, line " + std::to_string(line_) + ": " + msg);
+  }
+
+private:
+  std::string_view text_;
+  size_t pos_;
+  size_t line_;
+  std::string_view fields_;
+};
+
+//-------------------------------
+// Writer
+//-------------------------------
+
+// Types and constants are written before the first record that refers to
+// them. Values (constants, allocations, functions, arguments, blocks and
+// instructions) are numbered in the order they are defined; instructions
+// used before their definition (e.g., by phi nodes) are declared with their
+// type at the start of the body of their function
+class serializer {
+public:
+  serializer(module &mod, record_writer &w): mod_(mod), w_(w) { }
+  void write();
+
+private:
+  unsigned type_id(type *ty);
+  unsigned value_id(value *v);
+  void define_constant(value *v);
+  void write_body(function *fn);
+  void write_instruction(instruction *i);
+
+private:
+  module &mod_;
+  record_writer &w_;
+  std::map<type*, unsigned> types_;
+  std::map<value*, unsigned> values_;
+  unsigned n_values_ = 0;
+};
+
+unsigned serializer::type_id(type *ty) {
+  auto it = types_.find(ty);
+  if(it != types_.end())
+    return it->second;
+  std::vector<unsigned> contained;
+  switch(ty->get_type_id()){
+  case type::PointerTyID:
+    contained.push_back(type_id(ty->get_pointer_element_ty()));
+    break;
+  case type::BlockTyID:
+    contained.push_back(type_id(ty->get_scalar_ty()));
+    break;
+  case type::FunctionTyID: {
+    function_type *fn_ty = (function_type*)ty;
+    contained.push_back(type_id(fn_ty->get_return_ty()));
+    for(unsigned i = 0; i < fn_ty->get_num_params(); i++)
+      contained.push_back(type_id(fn_ty->get_param_ty(i)));
+    break;
+  }
+  case type::StructTyID:
+    for(unsigned i = 0; i < ty->get_struct_numel(); i++)
+      contained.push_back(type_id(ty->get_struct_type(i)));
+    break;
+  default:
+    break;
+  }
+  w_.tag(TAG_TYPE);
+  w_.u(ty->get_type_id());
+  switch(ty->get_type_id()){
+  case type::IntegerTyID:
+    w_.u(ty->get_integer_bitwidth());
+    break;
+  case type::PointerTyID:
+    w_.u(contained[0]);
+    w_.u(ty->get_pointer_address_space());
+    break;
+  case type::BlockTyID: {
+    w_.u(contained[0]);
+    const type::block_shapes_t& shapes = ((block_type*)ty)->get_shapes();
+    w_.u(shapes.size());
+    for(unsigned shape: shapes)
+      w_.u(shape);
+    break;
+  }
+  case type::FunctionTyID:
+  case type::StructTyID:
+    if(ty->is_struct_ty())
+      w_.u(((struct_type*)ty)->is_packed());
+    w_.u(contained.size());
+    for(unsigned id: contained)
+      w_.u(id);
+    break;
+  default:
+    break;
+  }
+  w_.end();
+  return types_[ty] = types_.size();
+}
+
+unsigned serializer::value_id(value *v) {
+  auto it = values_.find(v);
+  if(it == values_.end())
+    throw std::runtime_error("cannot serialize a reference to a value outside of the module");
+  return it->second;
+}
+
+void serializer::define_constant(value *v) {
+  if(values_.count(v) || !dynamic_cast<constant*>(v) || dynamic_cast<global_value*>(v))
+    return;
+  unsigned ty = type_id(v->get_type());
+  if(auto *x = dynamic_cast<constant_int*>(v)){
+    w_.tag(TAG_CONST_INT);
+    w_.u(ty);
+    w_.u(x->get_value());
+  }
+  else if(auto *x = dynamic_cast<constant_fp*>(v)){
+    w_.tag(TAG_CONST_FP);
+    w_.u(ty);
+    w_.real(x->get_value());
+  }
+  else if(dynamic_cast<undef_value*>(v)){
+    w_.tag(TAG_UNDEF);
+    w_.u(ty);
+  }
+  else
+    throw std::runtime_error("cannot serialize constant " + ((constant*)v)->repr());
+  w_.end();
+  values_[v] = n_values_++;
+}
+
+void serializer::write() {
+  w_.tag(TAG_MODULE);
+  w_.u(bitcode_version);
+  w_.str(mod_.get_name());
+  w_.str(mod_.get_llvm_opt());
+  w_.u(mod_.get_shared_padding());
+  w_.u(mod_.get_fast_math());
+  w_.u(mod_.get_raster());
+  w_.u(mod_.get_persistent());
+  w_.u(mod_.get_horizontal());
+  w_.end();
+  for(const std::string& path: mod_.get_source_files()){
+    w_.tag(TAG_SOURCE_FILE);
+    w_.str(path);
+    w_.end();
+  }
+  for(const auto& it: mod_.get_metadatas()){
+    w_.tag(TAG_METADATA);
+    w_.str(it.first);
+    w_.u(it.second.first);
+    w_.u(it.second.second);
+    w_.end();
+  }
+  for(alloc_const *alloc: mod_.allocs()){
+    unsigned ty = type_id(alloc->get_type()->get_pointer_element_ty());
+    for(value *op: alloc->ops())
+      define_constant(op);
+    w_.tag(TAG_ALLOC);
+    w_.u(ty);
+    w_.u(value_id(alloc->get_operand(0)));
+    w_.str(alloc->get_name());
+    w_.u(alloc->get_num_operands() - 1);
+    for(constant *x: alloc->get_init())
+      w_.u(value_id(x));
+    w_.end();
+    values_[alloc] = n_values_++;
+  }
+  // functions are declared before any body, which may call them
+  for(function *fn: mod_.get_function_list()){
+    unsigned ty = type_id(fn->get_fn_type());
+    w_.tag(TAG_FUNCTION);
+    w_.str(fn->get_name());
+    w_.u(ty);
+    w_.u(fn->get_is_kernel());
+    w_.u(fn->get_schedule());
+    for(argument *arg: fn->args())
+      w_.str(arg->get_name());
+    size_t n_attrs = 0;
+    for(const auto& it: fn->attrs())
+      n_attrs += it.second.size();
+    w_.u(n_attrs);
+    for(const auto& it: fn->attrs())
+    for(const attribute& attr: it.second){
+      w_.u(it.first);
+      w_.u(attr.get_kind());
+      w_.u(attr.get_value());
+    }
+    w_.end();
+    values_[fn] = n_values_++;
+    for(argument *arg: fn->args())
+      values_[arg] = n_values_++;
+  }
+  for(function *fn: mod_.get_function_list())
+    if(!fn->blocks().empty())
+      write_body(fn);
+}
+
+void serializer::write_body(function *fn) {
+  // constants are numbered before the blocks and instructions of the body
+  for(basic_block *block: fn->blocks())
+  for(instruction *i: block->get_inst_list()){
+    for(value *op: i->ops())
+      define_constant(op);
+    if(auto *x = dynamic_cast<make_range*>(i)){
+      define_constant((constant_int*)x->get_first());
+      define_constant((constant_int*)x->get_last());
+    }
+  }
+  // number blocks and instructions, and find the ones used before they are defined
+  unsigned first = n_values_;
+  for(basic_block *block: fn->blocks())
+    values_[block] = n_values_++;
+  for(basic_block *block: fn->blocks())
+  for(instruction *i: block->get_inst_list())
+    values_[i] = n_values_++;
+  std::vector<instruction*> forward;
+  std::set<instruction*> seen;
+  for(basic_block *block: fn->blocks())
+  for(instruction *i: block->get_inst_list()){
+    for(value *op: i->ops())
+      if(auto *x = dynamic_cast<instruction*>(op))
+        if(!seen.count(x) && std::find(forward.begin(), forward.end(), x) == forward.end())
+          forward.push_back(x);
+    seen.insert(i);
+  }
+  for(instruction *i: forward)
+    type_id(i->get_type());
+  w_.tag(TAG_BODY);
+  w_.u(value_id(fn));
+  w_.u(fn->blocks().size());
+  w_.u(forward.size());
+  w_.u(first);
+  w_.end();
+  for(instruction *i: forward){
+    w_.tag(TAG_FORWARD);
+    w_.u(value_id(i));
+    w_.u(type_id(i->get_type()));
+    w_.end();
+  }
+  for(basic_block *block: fn->blocks()){
+    w_.tag(TAG_BLOCK);
+    w_.str(block->get_name());
+    w_.u(block->get_inst_list().size());
+    w_.end();
+  }
+  for(basic_block *block: fn->blocks())
+  for(instruction *i: block->get_inst_list())
+    write_instruction(i);
+}
+
+void serializer::write_instruction(instruction *i) {
+  value_id_t id = i->get_id();
+  if(!tag_names().count(id))
+    throw std::runtime_error("cannot serialize instruction " + i->repr());
+  unsigned ty = type_id(i->get_type());
+  w_.tag(id);
+  w_.u(ty);
+  w_.str(i->get_name());
+  w_.u(i->get_num_operands());
+  for(unsigned k = 0; k < i->get_num_operands(); k++)
+    w_.u(value_id(i->get_operand(k)));
+  // what operands and types do not tell
+  switch(id){
+  case INST_CALL:
+    w_.u(value_id(((call_inst*)i)->get_fn()));
+    break;
+  case INST_LAUNCH:
+    w_.u(((launch_inst*)i)->get_values().size());
+    break;
+  case INST_PHI: {
+    phi_node *phi = (phi_node*)i;
+    for(unsigned k = 0; k < phi->get_num_incoming(); k++)
+      w_.u(value_id(phi->get_incoming_block(k)));
+    break;
+  }
+  case INST_BINOP: {
+    binary_operator *x = (binary_operator*)i;
+    w_.u(x->get_op());
+    w_.u(x->has_no_unsigned_wrap_);
+    w_.u(x->has_no_signed_wrap_);
+    w_.u(x->get_fdiv_ieee_rounding());
+    break;
+  }
+  case INST_ICMP:
+  case INST_FCMP:
+    w_.u(((cmp_inst*)i)->get_pred());
+    break;
+  case INST_UNMASKED_LOAD:
+  case INST_MASKED_LOAD:
+  case INST_MASKED_LOAD_ASYNC: {
+    load_inst *x = (load_inst*)i;
+    w_.u(x->get_cache_modifier());
+    w_.u(x->get_eviction_policy());
+    w_.u(x->get_is_volatile());
+    break;
+  }
+  case INST_EXTRACT_VALUE:
+    w_.u(((extract_value_inst*)i)->get_idx());
+    break;
+  case INST_INSERT_VALUE:
+    w_.u(((insert_value_inst*)i)->get_idx());
+    break;
+  case INST_GET_PROGRAM_ID:
+    w_.u(((get_program_id_inst*)i)->get_axis());
+    break;
+  case INST_GET_NUM_PROGRAMS:
+    w_.u(((get_num_programs_inst*)i)->get_axis());
+    break;
+  case INST_ATOMIC_CAS:
+    w_.u((unsigned)((atomic_inst*)i)->get_scope());
+    break;
+  case INST_ATOMIC_RMW:
+    w_.u((unsigned)((atomic_rmw_inst*)i)->get_op());
+    w_.u((unsigned)((atomic_inst*)i)->get_scope());
+    break;
+  case INST_FENCE:
+    w_.u((unsigned)((fence_inst*)i)->get_scope());
+    break;
+  case INST_TRANS: {
+    std::vector<int> perm = ((trans_inst*)i)->get_perm();
+    w_.u(perm.size());
+    for(int p: perm)
+      w_.u(p);
+    break;
+  }
+  case INST_PHILOX:
+    w_.u(((philox_inst*)i)->get_n_rounds());
+    w_.u(((philox_inst*)i)->get_word());
+    w_.u(((philox_inst*)i)->get_to_float());
+    break;
+  case INST_MATH:
+    w_.str(((math_inst*)i)->get_fn());
+    break;
+  case INST_REDUCE:
+    w_.u(((reduce_inst*)i)->get_op());
+    w_.u(((reduce_inst*)i)->get_axis());
+    break;
+  case INST_SCAN:
+    w_.u(((scan_inst*)i)->get_op());
+    w_.u(((scan_inst*)i)->get_axis());
+    w_.u(((scan_inst*)i)->is_exclusive());
+    break;
+  case INST_DOT: {
+    dot_inst *x = (dot_inst*)i;
+    w_.u(x->allow_tf32());
+    w_.u(x->split_tf32());
+    w_.u(x->is_prefetched());
+    break;
+  }
+  case INST_BARRIER:
+    w_.u(((barrier_inst*)i)->get_barrier_id());
+    w_.u(((barrier_inst*)i)->get_num_threads());
+    break;
+  case INST_ASYNC_WAIT:
+    w_.u(((async_wait_inst*)i)->get_N());
+    break;
+  case INST_PREFETCH_S:
+    w_.u(((prefetch_s_inst*)i)->get_inc());
+    break;
+  case INST_MAKE_RANGE:
+    w_.u(value_id((constant_int*)((make_range*)i)->get_first()));
+    w_.u(value_id((constant_int*)((make_range*)i)->get_last()));
+    break;
+  default:
+    if(auto *x = dynamic_cast<cast_inst*>(i))
+      w_.u(x->get_op());
+    break;
+  }
+  const auto& mds = i->get_metadatas();
+  w_.u(mds.size());
+  for(const auto& md: mds){
+    w_.u(md.first);
+    w_.u(md.second);
+  }
+  w_.end();
+}
+
+//-------------------------------
+// Reader
+//-------------------------------
+
+// stands for an instruction used before its definition
+class forward_ref: public value {
+public:
+  forward_ref(type *ty): value(ty) { }
+  void accept(visitor *v) { }
+};
+
+class deserializer {
+public:
+  deserializer(record_reader &r, builder &builder): r_(r), builder_(builder), ctx_(builder.get_context()) { }
+  module* read();
+
+private:
+  // reads the records that define types and constants, and returns
+  // the tag of the first one that does not (false at the end)
+  bool next(unsigned &tag);
+  void read_type();
+  void read_function();
+  void read_body();
+  instruction* read_instruction(unsigned id);
+  type* get_type(uint64_t id);
+  value* get_value(uint64_t id);
+  template<class T> T* get_value(uint64_t id);
+  void define(value *v);
+  void error(const std::string& msg) { throw std::runtime_error("invalid Triton-IR bitcode: " + msg); }
+
+private:
+  record_reader &r_;
+  builder &builder_;
+  context &ctx_;
+  std::unique_ptr<module> mod_;
+  std::vector<type*> types_;
+  std::vector<value*> values_;
+  std::map<uint64_t, forward_ref*> forward_;
+};
+
+type* deserializer::get_type(uint64_t id) {
+  if(id >= types_.size())
+    error("undefined type " + std::to_string(id));
+  return types_[id];
+}
+
+value* deserializer::get_value(uint64_t id) {
+  if(id < values_.size())
+    return values_[id];
+  auto it = forward_.find(id);
+  if(it == forward_.end())
+    error("undefined value " + std::to_string(id));
+  return it->second;
+}
+
+template<class T>
+T* deserializer::get_value(uint64_t id) {
+  T* ret = dynamic_cast<T*>(get_value(id));
+  if(!ret)
+    error("unexpected kind of value " + std::to_string(id));
+  return ret;
+}
+
+void deserializer::define(value *v) {
+  auto it = forward_.find(values_.size());
+  if(it != forward_.end()){
+    if(it->second->get_type() != v->get_type())
+      error("value " + std::to_string(it->first) + " was declared with another type");
+    it->second->replace_all_uses_with(v);
+    delete it->second;
+    forward_.erase(it);
+  }
+  values_.push_back(v);
+}
+
+bool deserializer::next(unsigned &tag) {
+  while(r_.tag(tag)){
+    switch(tag){
+    case TAG_TYPE:
+      read_type();
+      break;
+    case TAG_CONST_INT: {
+      type *ty = get_type(r_.u());
+      define(constant_int::get(ty, r_.u()));
+      break;
+    }
+    case TAG_CONST_FP: {
+      type *ty = get_type(r_.u());
+      define(constant_fp::get(ty, r_.real()));
+      break;
+    }
+    case TAG_UNDEF:
+      define(undef_value::get(get_type(r_.u())));
+      break;
+    default:
+      return true;
+    }
+    r_.end();
+  }
+  return false;
+}
+
+void deserializer::read_type() {
+  unsigned id = r_.u();
+  type *ty = nullptr;
+  switch(id){
+  case type::VoidTyID: ty = type::get_void_ty(ctx_); break;
+  case type::FP8TyID: ty = type::get_fp8_ty(ctx_); break;
+  case type::FP16TyID: ty = type::get_fp16_ty(ctx_); break;
+  case type::BF16TyID: ty = type::get_bf16_ty(ctx_); break;
+  case type::FP32TyID: ty = type::get_fp32_ty(ctx_); break;
+  case type::FP64TyID: ty = type::get_fp64_ty(ctx_); break;
+  case type::LabelTyID: ty = type::get_label_ty(ctx_); break;
+  case type::IntegerTyID: {
+    unsigned bitwidth = r_.u();
+    switch(bitwidth){
+    case 1: ty = type::get_int1_ty(ctx_); break;
+    case 8: ty = type::get_int8_ty(ctx_); break;
+    case 16: ty = type::get_int16_ty(ctx_); break;
+    case 32: ty = type::get_int32_ty(ctx_); break;
+    case 64: ty = type::get_int64_ty(ctx_); break;
+    case 128: ty = type::get_int128_ty(ctx_); break;
+    default: error("unsupported integer width " + std::to_string(bitwidth));
+    }
+    break;
+  }
+  case type::PointerTyID: {
+    type *elt = get_type(r_.u());
+    ty = pointer_type::get(elt, r_.u());
+    break;
+  }
+  case type::BlockTyID: {
+    type *elt = get_type(r_.u());
+    type::block_shapes_t shapes(r_.u());
+    for(unsigned& shape: shapes)
+      shape = r_.u();
+    ty = block_type::get(elt, shapes);
+    break;
+  }
+  case type::FunctionTyID: {
+    size_t n = r_.u();
+    if(n == 0)
+      error("function type without return type");
+    type *ret_ty = get_type(r_.u());
+    std::vector<type*> param_tys;
+    for(size_t i = 1; i < n; i++)
+      param_tys.push_back(get_type(r_.u()));
+    ty = function_type::get(ret_ty, param_tys);
+    break;
+  }
+  case type::StructTyID: {
+    bool is_packed = r_.u();
+    std::vector<type*> tys(r_.u());
+    for(type*& elt: tys)
+      elt = get_type(r_.u());
+    if(tys.empty())
+      error("empty struct type");
+    ty = struct_type::get(tys, is_packed);
+    break;
+  }
+  default:
+    error("unsupported type id " + std::to_string(id));
+  }
+  types_.push_back(ty);
+}
+
+void deserializer::read_function() {
+  std::string name = r_.str();
+  type *ty = get_type(r_.u());
+  if(ty->get_type_id() != type::FunctionTyID)
+    error("function " + name + " does not have a function type");
+  function *fn = mod_->get_or_insert_function(name, (function_type*)ty);
+  fn->set_is_kernel(r_.u());
+  fn->set_schedule(r_.u());
+  for(argument *arg: fn->args())
+    arg->set_name(r_.str());
+  size_t n_attrs = r_.u();
+  for(size_t i = 0; i < n_attrs; i++){
+    unsigned arg_id = r_.u();
+    attribute_kind_t kind = (attribute_kind_t)r_.u();
+    fn->add_attr(arg_id, attribute(kind, r_.u()));
+  }
+  define(fn);
+  for(argument *arg: fn->args())
+    define(arg);
+}
+
+void deserializer::read_body() {
+  function *fn = get_value<function>(r_.u());
+  size_t n_blocks = r_.u();
+  size_t n_forward = r_.u();
+  if(r_.u() != values_.size())
+    error("misnumbered body of " + fn->get_name());
+  r_.end();
+  unsigned tag;
+  for(size_t i = 0; i < n_forward; i++){
+    if(!next(tag) || tag != TAG_FORWARD)
+      error("expected forward declarations in the body of " + fn->get_name());
+    uint64_t id = r_.u();
+    forward_[id] = new forward_ref(get_type(r_.u()));
+    r_.end();
+  }
+  std::vector<std::pair<basic_block*, size_t>> blocks;
+  for(size_t i = 0; i < n_blocks; i++){
+    if(!next(tag) || tag != TAG_BLOCK)
+      error("expected the blocks of " + fn->get_name());
+    basic_block *block = basic_block::create(ctx_, r_.str(), fn);
+    blocks.push_back({block, r_.u()});
+    r_.end();
+    define(block);
+  }
+  for(const auto& it: blocks)
+  for(size_t i = 0; i < it.second; i++){
+    if(!next(tag) || tag < INST_BEGIN || tag >= TAG_MODULE)
+      error("expected an instruction in " + fn->get_name());
+    instruction *inst = read_instruction(tag);
+    r_.end();
+    it.first->append_instruction(inst);
+    define(inst);
+  }
+  if(!forward_.empty())
+    error("value " + std::to_string(forward_.begin()->first) + " is used but never defined");
+}
+
+instruction* deserializer::read_instruction(unsigned id) {
+  type *ty = get_type(r_.u());
+  std::string name = r_.str();
+  std::vector<value*> ops(r_.u());
+  for(value*& op: ops)
+    op = get_value(r_.u());
+  auto op = [&](size_t i) {
+    if(i >= ops.size())
+      error("missing operands");
+    return ops[i];
+  };
+  auto block = [&](size_t i) {
+    basic_block *ret = dynamic_cast<basic_block*>(op(i));
+    if(!ret)
+      error("operand " + std::to_string(i) + " is not a block");
+    return ret;
+  };
+  instruction *ret = nullptr;
+  switch(id){
+  case INST_CALL:
+    ret = call_inst::create(get_value<function>(r_.u()), ops, name);
+    break;
+  case INST_LAUNCH: {
+    size_t n_values = r_.u();
+    if(ops.size() != n_values + 5)
+      error("unexpected number of launch operands");
+    std::vector<value*> values(ops.begin() + 1, ops.begin() + 1 + n_values);
+    std::vector<value*> grid(ops.begin() + 1 + n_values, ops.begin() + 4 + n_values);
+    function *fn = dynamic_cast<function*>(ops[0]);
+    if(!fn)
+      error("launch of a value that is not a function");
+    ret = launch_inst::create(fn, values, grid, ops.back(), name);
+    break;
+  }
+  case INST_PHI: {
+    phi_node *phi = phi_node::create(ty, ops.size(), name);
+    for(value *v: ops)
+      phi->add_incoming(v, get_value<basic_block>(r_.u()));
+    ret = phi;
+    break;
+  }
+  case INST_BINOP: {
+    binary_op_t bin_op = (binary_op_t)r_.u();
+    binary_operator *x = binary_operator::create(bin_op, op(0), op(1), name);
+    x->set_has_no_unsigned_wrap(r_.u());
+    x->set_has_no_signed_wrap(r_.u());
+    x->set_fdiv_ieee_rounding(r_.u());
+    ret = x;
+    break;
+  }
+  case INST_GETELEMENTPTR:
+    ret = getelementptr_inst::create(op(0), std::vector<value*>(ops.begin() + 1, ops.end()), name);
+    break;
+  case INST_SELECT: ret = select_inst::create(op(0), op(1), op(2), name); break;
+  case INST_SQRT: ret = sqrt_inst::create(op(0), name); break;
+  case INST_ICMP: ret = icmp_inst::create((cmp_pred_t)r_.u(), op(0), op(1), name); break;
+  case INST_FCMP: ret = fcmp_inst::create((cmp_pred_t)r_.u(), op(0), op(1), name); break;
+  case INST_RETURN: ret = return_inst::create(ctx_, ops.empty() ? nullptr : op(0)); break;
+  case INST_COND_BRANCH: ret = branch_inst::create(op(2), block(0), block(1)); break;
+  case INST_UNCOND_BRANCH: ret = branch_inst::create(block(0)); break;
+  case INST_UNMASKED_LOAD:
+  case INST_MASKED_LOAD:
+  case INST_MASKED_LOAD_ASYNC: {
+    auto cache = (load_inst::CACHE_MODIFIER)r_.u();
+    auto eviction = (load_inst::EVICTION_POLICY)r_.u();
+    bool is_volatile = r_.u();
+    if(id == INST_UNMASKED_LOAD)
+      ret = unmasked_load_inst::create(op(0), cache, eviction, is_volatile, name);
+    else if(id == INST_MASKED_LOAD)
+      ret = masked_load_inst::create(op(0), op(1), op(2), cache, eviction, is_volatile, name);
+    else
+      ret = masked_load_async_inst::create(op(0), op(1), op(2), cache, eviction, name);
+    // operands of the tile of the load
+    size_t num_load_ops = id == INST_UNMASKED_LOAD ? 1 : 3;
+    if(ops.size() > num_load_ops){
+      if((ops.size() - num_load_ops) % 3 != 1)
+        error("invalid tile operands");
+      ((load_inst*)ret)->set_tile(std::vector<value*>(ops.begin() + num_load_ops, ops.end()));
+    }
+    break;
+  }
+  case INST_UNMASKED_STORE: ret = unmasked_store_inst::create(op(0), op(1), name); break;
+  case INST_MASKED_STORE: ret = masked_store_inst::create(op(0), op(1), op(2), name); break;
+  case INST_EXTRACT_VALUE: ret = extract_value_inst::create(op(0), r_.u(), name); break;
+  case INST_INSERT_VALUE: ret = insert_value_inst::create(op(0), op(1), r_.u(), name); break;
+  case INST_RESHAPE: ret = reshape_inst::create(op(0), ty->get_block_shapes(), name); break;
+  case INST_SPLAT: ret = splat_inst::create(op(0), ty->get_block_shapes(), name); break;
+  case INST_BROADCAST: ret = broadcast_inst::create(op(0), ty->get_block_shapes(), name); break;
+  case INST_CAT: ret = cat_inst::create(op(0), op(1), name); break;
+  case INST_DOWNCAST: ret = downcast_inst::create(op(0), name); break;
+  case INST_GET_PROGRAM_ID: ret = get_program_id_inst::create(ctx_, r_.u(), name); break;
+  case INST_GET_NUM_PROGRAMS: ret = get_num_programs_inst::create(ctx_, r_.u(), name); break;
+  case INST_ATOMIC_CAS: {
+    auto *x = (atomic_inst*)atomic_cas_inst::create(op(0), op(1), op(2), name);
+    x->set_scope((mem_scope_t)r_.u());
+    ret = x;
+    break;
+  }
+  case INST_ATOMIC_RMW: {
+    auto rmw_op = (atomic_rmw_op_t)r_.u();
+    auto *x = (atomic_inst*)atomic_rmw_inst::create(rmw_op, op(0), op(1), op(2), name);
+    x->set_scope((mem_scope_t)r_.u());
+    ret = x;
+    break;
+  }
+  case INST_UMULHI: ret = umulhi_inst::create(op(0), op(1), name); break;
+  case INST_PHILOX: {
+    unsigned n_rounds = r_.u();
+    unsigned word = r_.u();
+    bool to_float = r_.u();
+    ret = philox_inst::create(op(0), op(1), op(2), n_rounds, word, to_float, name);
+    break;
+  }
+  case INST_MATH: {
+    std::string fn = r_.str();
+    if(ops.empty())
+      error("missing operands");
+    ret = math_inst::create(fn, ops, name);
+    break;
+  }
+  case INST_EXP: ret = exp_inst::create(op(0), name); break;
+  case INST_COS: ret = cos_inst::create(op(0), name); break;
+  case INST_SIN: ret = sin_inst::create(op(0), name); break;
+  case INST_LOG: ret = log_inst::create(op(0), name); break;
+  case INST_TRANS: {
+    std::vector<int> perm(r_.u());
+    for(int& p: perm)
+      p = r_.u();
+    ret = trans_inst::create(op(0), perm, name);
+    break;
+  }
+  case INST_REDUCE: {
+    auto reduce_op = (reduce_inst::op_t)r_.u();
+    ret = reduce_inst::create(op(0), reduce_op, r_.u(), name);
+    break;
+  }
+  case INST_SCAN: {
+    auto scan_op = (reduce_inst::op_t)r_.u();
+    unsigned axis = r_.u();
+    ret = scan_inst::create(op(0), scan_op, axis, r_.u(), name);
+    break;
+  }
+  case INST_DOT: {
+    bool allow_tf32 = r_.u();
+    dot_inst *x = ops.size() == 4 ? (dot_inst*)dot_inst::create_sparse(op(0), op(3), op(1), op(2), name)
+                                  : (dot_inst*)dot_inst::create(op(0), op(1), op(2), false, false, allow_tf32, name);
+    x->set_split_tf32(r_.u());
+    x->set_prefetched(r_.u());
+    ret = x;
+    break;
+  }
+  case INST_COPY_TO_SHARED: ret = copy_to_shared_inst::create(op(0), name); break;
+  case INST_COPY_FROM_SHARED: ret = copy_from_shared_inst::create(op(0), name); break;
+  case INST_CVT_LAYOUT: ret = cvt_layout_inst::create(op(0), name); break;
+  case INST_BARRIER: {
+    int barrier_id = r_.u();
+    int num_threads = r_.u();
+    ret = num_threads ? barrier_inst::create_named(ctx_, barrier_id, num_threads, name)
+                      : barrier_inst::create(ctx_, name);
+    break;
+  }
+  case INST_ASYNC_WAIT: ret = async_wait_inst::create(ctx_, r_.u(), name); break;
+  case INST_PREFETCH_S: ret = prefetch_s_inst::create(ctx_, op(0), r_.u(), name); break;
+  case INST_MAKE_RANGE: {
+    constant_int *first = get_value<constant_int>(r_.u());
+    ret = make_range::create(first, get_value<constant_int>(r_.u()));
+    break;
+  }
+  case INST_CLOCK: ret = clock_inst::create(ctx_, name); break;
+  case INST_GLOBALTIMER: ret = globaltimer_inst::create(ctx_, name); break;
+  case INST_GRID_SYNC: ret = grid_sync_inst::create(ctx_, name); break;
+  case INST_FENCE: ret = fence_inst::create(ctx_, (mem_scope_t)r_.u(), name); break;
+  default:
+    if(id >= INST_CAST_TRUNC && id <= INST_CAST_ADDR_SPACE_CAST){
+      ret = cast_inst::create((cast_op_t)r_.u(), op(0), ty, name);
+      break;
+    }
+    error("unsupported instruction " + tag_names().at(id));
+  }
+  if(ret->get_id() != id)
+    error("instruction " + tag_names().at(id) + " was read as " + ret->repr());
+  // calls keep the return type their function had when they were created
+  if(ret->get_type() != ty && id != INST_CALL && id != INST_LAUNCH)
+    error("unexpected type " + ty->repr() + " for " + ret->repr());
+  if(!name.empty())
+    ret->set_name(name);
+  size_t n_mds = r_.u();
+  for(size_t i = 0; i < n_mds; i++){
+    auto kind = (metadata::kind_t)r_.u();
+    ret->set_metadata(kind, r_.u());
+  }
+  return ret;
+}
+
+module* deserializer::read() {
+  unsigned tag;
+  if(!next(tag) || tag != TAG_MODULE)
+    error("expected a module record");
+  uint64_t version = r_.u();
+  if(version != bitcode_version)
+    throw std::runtime_error("Triton-IR bitcode version " + std::to_string(version) +
+                             " is not supported (expected " + std::to_string(bitcode_version) + ")");
+  mod_.reset(new module(r_.str(), builder_));
+  mod_->set_llvm_opt(r_.str());
+  mod_->set_shared_padding(r_.u() != 0);
+  mod_->set_fast_math(r_.u() != 0);
+  mod_->set_raster(r_.u());
+  mod_->set_persistent(r_.u() != 0);
+  mod_->set_horizontal(r_.u() != 0);
+  r_.end();
+  while(next(tag)){
+    switch(tag){
+    case TAG_SOURCE_FILE:
+      mod_->add_source_file(r_.str());
+      break;
+    case TAG_METADATA: {
+      std::string name = r_.str();
+      auto kind = (metadata::kind_t)r_.u();
+      mod_->add_metadata(name, {kind, (unsigned)r_.u()});
+      break;
+    }
+    case TAG_ALLOC: {
+      type *ty = get_type(r_.u());
+      constant_int *size = get_value<constant_int>(r_.u());
+      std::string name = r_.str();
+      std::vector<constant*> init(r_.u());
+      for(constant *&x: init)
+        x = get_value<constant>(r_.u());
+      alloc_const *alloc = new alloc_const(ty, size, name, init);
+      mod_->add_alloc(alloc);
+      define(alloc);
+      break;
+    }
+    case TAG_FUNCTION:
+      read_function();
+      break;
+    case TAG_BODY:
+      read_body();
+      continue;
+    default:
+      error("unexpected record " + tag_names().at(tag));
+    }
+    r_.end();
+  }
+  return mod_.release();
+}
+
+}
+
+//-------------------------------
+// External interface
+//-------------------------------
+
+std::string write_bitcode(module &mod) {
+  binary_writer writer;
+  serializer(mod, writer).write();
+  return writer.get();
+}
+
+module* read_bitcode(std::string_view data, builder &builder) {
+  binary_reader reader(data);
+  return deserializer(reader, builder).read();
+}
+
+std::string write_text(module &mod) {
+  text_writer writer;
+  serializer(mod, writer).write();
+  return writer.get();
+}
+
+module* parse_text(std::string_view text, builder &builder) {
+  text_reader reader(text);
+  return deserializer(reader, builder).read();
+}
+
+}
+}
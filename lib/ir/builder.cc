@@ -1,18 +1,22 @@
 #include <bits/types/clock_t.h>
 #include <string>
+#include <stdexcept>
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include "triton/ir/basic_block.h"
 #include "triton/ir/builder.h"
 #include "triton/ir/constant.h"
+#include "triton/ir/function.h"
 #include "triton/ir/instructions.h"
+#include "triton/ir/module.h"
 #include "triton/ir/type.h"
 
 namespace triton{
 namespace ir{
 
 builder::builder(context &ctx):
-  ctx_(ctx), block_(nullptr) {}
+  ctx_(ctx), block_(nullptr), loc_file_(0), loc_line_(0), loc_column_(0) {}
 
 //===----------------------------------------------------------------------===//
 //                               utilities
@@ -26,6 +30,7 @@ void builder::set_insert_point(instruction* i){
   block_ = i->get_parent();
   auto it = std::find(block_->begin(), block_->end(), i);
   set_insert_point(it);
+  set_loc(i);
 }
 
 
@@ -33,6 +38,7 @@ void builder::set_insert_point_after(instruction* i){
   block_ = i->get_parent();
   auto it = std::find(block_->begin(), block_->end(), i);
   set_insert_point(++it);
+  set_loc(i);
 }
 
 
@@ -41,6 +47,22 @@ void builder::set_insert_point(basic_block *block){
   insert_point_ = block->end();
 }
 
+void builder::set_loc(unsigned file, unsigned line, unsigned column){
+  loc_file_ = file;
+  loc_line_ = line;
+  loc_column_ = column;
+}
+
+// instructions created by transformations are attributed to
+// the instructions they replace
+void builder::set_loc(instruction* i){
+  const auto& mds = i->get_metadatas();
+  auto line = mds.find(metadata::line);
+  if(line == mds.end() || line->second == 0)
+    return;
+  set_loc(i->get_metadata(metadata::file), line->second, i->get_metadata(metadata::column));
+}
+
 
 //===----------------------------------------------------------------------===//
 //                               convenience functions
@@ -67,6 +89,17 @@ value *builder::get_range(int32_t _lo, int32_t _hi) {
   return insert(make_range::create(lo, hi));
 }
 
+value *builder::get_constant_table(type *ty, const std::vector<constant*> &values) {
+  module *mod = block_->get_parent()->get_parent();
+  for(alloc_const *alloc: mod->allocs())
+    if(alloc->get_type()->get_pointer_element_ty() == ty && alloc->get_init() == values)
+      return alloc;
+  std::string name = "__triton_table_" + std::to_string(mod->allocs().size());
+  alloc_const *alloc = new alloc_const(ty, (constant_int*)get_int32(values.size()), name, values);
+  mod->add_alloc(alloc);
+  return alloc;
+}
+
 type *builder::get_void_ty()
 { return type::get_void_ty(ctx_); }
 
@@ -101,6 +134,240 @@ type *builder::get_double_ty()
 { return type::get_fp64_ty(ctx_); }
 
 
+//===----------------------------------------------------------------------===//
+//                               constant folding
+//===----------------------------------------------------------------------===//
+
+// scalar constant held by `v`, or broadcast by a splat of `v`
+template<class T>
+static T* get_constant(value *v) {
+  if(auto *splat = dynamic_cast<splat_inst*>(v))
+    v = splat->get_operand(0);
+  return dynamic_cast<T*>(v);
+}
+
+static uint64_t zext(uint64_t v, unsigned bits) {
+  return bits >= 64 ? v : v & ((1ULL << bits) - 1);
+}
+
+static int64_t sext(uint64_t v, unsigned bits) {
+  if(bits >= 64)
+    return v;
+  uint64_t sign = 1ULL << (bits - 1);
+  return (int64_t)((zext(v, bits) ^ sign) - sign);
+}
+
+// only fp32 and fp64 constants are folded, as fp16 and bf16 would need their own rounding
+static bool is_foldable_fp(type *ty) {
+  return ty->is_fp32_ty() || ty->is_fp64_ty();
+}
+
+static double round_to(type *ty, double v) {
+  return ty->is_fp32_ty() ? (double)(float)v : v;
+}
+
+value *builder::splat_like(value *cst, value *like) {
+  if(!like->get_type()->is_block_ty())
+    return cst;
+  return create_splat(cst, like->get_type()->get_block_shapes());
+}
+
+value *builder::fold_binop(binary_op_t op, value *lhs, value *rhs) {
+  type *ty = lhs->get_type()->get_scalar_ty();
+  if(ty->is_integer_ty()){
+    unsigned bits = ty->get_integer_bitwidth();
+    constant_int *a = get_constant<constant_int>(lhs);
+    constant_int *b = get_constant<constant_int>(rhs);
+    if(a && b){
+      uint64_t x = zext(a->get_value(), bits), y = zext(b->get_value(), bits);
+      int64_t sx = sext(x, bits), sy = sext(y, bits);
+      uint64_t r;
+      switch(op){
+        case binary_op_t::Add: r = x + y; break;
+        case binary_op_t::Sub: r = x - y; break;
+        case binary_op_t::Mul: r = x * y; break;
+        case binary_op_t::And: r = x & y; break;
+        case binary_op_t::Or: r = x | y; break;
+        case binary_op_t::Xor: r = x ^ y; break;
+        case binary_op_t::Shl: if(y >= bits) return nullptr; r = x << y; break;
+        case binary_op_t::LShr: if(y >= bits) return nullptr; r = x >> y; break;
+        case binary_op_t::AShr: if(y >= bits) return nullptr; r = sx >> y; break;
+        case binary_op_t::UDiv: if(y == 0) return nullptr; r = x / y; break;
+        case binary_op_t::URem: if(y == 0) return nullptr; r = x % y; break;
+        case binary_op_t::SDiv:
+        case binary_op_t::SRem:
+          // division by zero and overflow are left to the target
+          if(y == 0 || (sy == -1 && sx == sext(1ULL << (bits - 1), bits)))
+            return nullptr;
+          r = op == binary_op_t::SDiv ? sx / sy : sx % sy;
+          break;
+        default: return nullptr;
+      }
+      return splat_like(constant_int::get(ty, zext(r, bits)), lhs);
+    }
+    // identities
+    if(b && zext(b->get_value(), bits) == 0){
+      switch(op){
+        case binary_op_t::Add: case binary_op_t::Sub:
+        case binary_op_t::Or: case binary_op_t::Xor:
+        case binary_op_t::Shl: case binary_op_t::LShr: case binary_op_t::AShr:
+          return lhs;
+        case binary_op_t::Mul: case binary_op_t::And:
+          return rhs;
+        default: break;
+      }
+    }
+    if(b && zext(b->get_value(), bits) == 1){
+      switch(op){
+        case binary_op_t::Mul: case binary_op_t::UDiv: case binary_op_t::SDiv:
+          return lhs;
+        default: break;
+      }
+    }
+    if(a && zext(a->get_value(), bits) == 0){
+      switch(op){
+        case binary_op_t::Add: case binary_op_t::Or: case binary_op_t::Xor:
+          return rhs;
+        case binary_op_t::Mul: case binary_op_t::And:
+          return lhs;
+        default: break;
+      }
+    }
+    if(a && zext(a->get_value(), bits) == 1 && op == binary_op_t::Mul)
+      return rhs;
+    return nullptr;
+  }
+  if(is_foldable_fp(ty)){
+    constant_fp *a = get_constant<constant_fp>(lhs);
+    constant_fp *b = get_constant<constant_fp>(rhs);
+    if(!a || !b)
+      return nullptr;
+    double r;
+    switch(op){
+      case binary_op_t::FAdd: r = a->get_value() + b->get_value(); break;
+      case binary_op_t::FSub: r = a->get_value() - b->get_value(); break;
+      case binary_op_t::FMul: r = a->get_value() * b->get_value(); break;
+      default: return nullptr;
+    }
+    return splat_like(constant_fp::get(ty, round_to(ty, r)), lhs);
+  }
+  return nullptr;
+}
+
+value *builder::fold_cast(cast_op_t op, value *src, type *dst_ty) {
+  type *src_ty = src->get_type()->get_scalar_ty();
+  type *ty = dst_ty->get_scalar_ty();
+  if(constant_int *a = get_constant<constant_int>(src)){
+    unsigned src_bits = src_ty->get_integer_bitwidth();
+    uint64_t x = zext(a->get_value(), src_bits);
+    switch(op){
+      case cast_op_t::Trunc:
+      case cast_op_t::ZExt:
+        return splat_like(constant_int::get(ty, zext(x, ty->get_integer_bitwidth())), src);
+      case cast_op_t::SExt:
+        return splat_like(constant_int::get(ty, zext(sext(x, src_bits), ty->get_integer_bitwidth())), src);
+      case cast_op_t::BitCast:
+        if(!ty->is_integer_ty() || ty->get_integer_bitwidth() != src_bits)
+          return nullptr;
+        return splat_like(constant_int::get(ty, x), src);
+      case cast_op_t::SIToFP:
+        if(!is_foldable_fp(ty))
+          return nullptr;
+        return splat_like(constant_fp::get(ty, round_to(ty, (double)sext(x, src_bits))), src);
+      case cast_op_t::UIToFP:
+        if(!is_foldable_fp(ty))
+          return nullptr;
+        return splat_like(constant_fp::get(ty, round_to(ty, (double)x)), src);
+      default:
+        return nullptr;
+    }
+  }
+  if(constant_fp *a = get_constant<constant_fp>(src)){
+    if(!is_foldable_fp(src_ty))
+      return nullptr;
+    double x = a->get_value();
+    switch(op){
+      case cast_op_t::FPExt:
+      case cast_op_t::FPTrunc:
+        if(!is_foldable_fp(ty))
+          return nullptr;
+        return splat_like(constant_fp::get(ty, round_to(ty, x)), src);
+      case cast_op_t::FPToSI:
+      case cast_op_t::FPToUI: {
+        // out-of-range conversions are left to the target
+        unsigned bits = ty->get_integer_bitwidth();
+        bool is_signed = op == cast_op_t::FPToSI;
+        double lo = is_signed ? -std::ldexp(1., bits - 1) : 0.;
+        double hi = is_signed ? std::ldexp(1., bits - 1) : std::ldexp(1., bits);
+        if(!(x > lo - 1 && x < hi))
+          return nullptr;
+        uint64_t r = is_signed ? (uint64_t)(int64_t)x : (uint64_t)x;
+        return splat_like(constant_int::get(ty, zext(r, bits)), src);
+      }
+      default:
+        return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+value *builder::fold_cmp(cmp_pred_t pred, value *lhs, value *rhs) {
+  type *ty = lhs->get_type()->get_scalar_ty();
+  bool r;
+  if(ty->is_integer_ty()){
+    constant_int *a = get_constant<constant_int>(lhs);
+    constant_int *b = get_constant<constant_int>(rhs);
+    if(!a || !b)
+      return nullptr;
+    unsigned bits = ty->get_integer_bitwidth();
+    uint64_t x = zext(a->get_value(), bits), y = zext(b->get_value(), bits);
+    int64_t sx = sext(x, bits), sy = sext(y, bits);
+    switch(pred){
+      case ICMP_EQ:  r = x == y; break;
+      case ICMP_NE:  r = x != y; break;
+      case ICMP_UGT: r = x > y; break;
+      case ICMP_UGE: r = x >= y; break;
+      case ICMP_ULT: r = x < y; break;
+      case ICMP_ULE: r = x <= y; break;
+      case ICMP_SGT: r = sx > sy; break;
+      case ICMP_SGE: r = sx >= sy; break;
+      case ICMP_SLT: r = sx < sy; break;
+      case ICMP_SLE: r = sx <= sy; break;
+      default: return nullptr;
+    }
+  }
+  else if(is_foldable_fp(ty)){
+    constant_fp *a = get_constant<constant_fp>(lhs);
+    constant_fp *b = get_constant<constant_fp>(rhs);
+    if(!a || !b)
+      return nullptr;
+    double x = a->get_value(), y = b->get_value();
+    bool uno = std::isnan(x) || std::isnan(y);
+    switch(pred){
+      case FCMP_FALSE: r = false; break;
+      case FCMP_OEQ: r = !uno && x == y; break;
+      case FCMP_OGT: r = !uno && x > y; break;
+      case FCMP_OGE: r = !uno && x >= y; break;
+      case FCMP_OLT: r = !uno && x < y; break;
+      case FCMP_OLE: r = !uno && x <= y; break;
+      case FCMP_ONE: r = !uno && x != y; break;
+      case FCMP_ORD: r = !uno; break;
+      case FCMP_UNO: r = uno; break;
+      case FCMP_UEQ: r = uno || x == y; break;
+      case FCMP_UGT: r = uno || x > y; break;
+      case FCMP_UGE: r = uno || x >= y; break;
+      case FCMP_ULT: r = uno || x < y; break;
+      case FCMP_ULE: r = uno || x <= y; break;
+      case FCMP_UNE: r = uno || x != y; break;
+      case FCMP_TRUE: r = true; break;
+      default: return nullptr;
+    }
+  }
+  else
+    return nullptr;
+  return splat_like(get_int1(r), lhs);
+}
+
 //===----------------------------------------------------------------------===//
 //                               terminator instructions
 //===----------------------------------------------------------------------===//
@@ -140,10 +407,19 @@ DEFINE_CAST_INSTR(fp_ext, cast_op_t::FPExt)
 DEFINE_CAST_INSTR(fp_trunc, cast_op_t::FPTrunc)
 
 value* builder::create_cast(cast_op_t op, value *v, type *dst_ty){
+  if(value *folded = fold_cast(op, v, dst_ty))
+    return folded;
   return insert(cast_inst::create(op, v, dst_ty));
 }
 
 value* builder::create_int_cast(value *src, type *dst_ty, bool is_signed){
+  unsigned src_bits = src->get_type()->get_scalar_ty()->get_integer_bitwidth();
+  unsigned dst_bits = dst_ty->get_scalar_ty()->get_integer_bitwidth();
+  cast_op_t op = (src_bits == dst_bits ? cast_op_t::BitCast :
+                   (src_bits > dst_bits ? cast_op_t::Trunc :
+                   (is_signed           ? cast_op_t::SExt : cast_op_t::ZExt)));
+  if(value *folded = fold_cast(op, src, dst_ty))
+    return folded;
   return insert(cast_inst::create_integer_cast(src, dst_ty, is_signed));
 }
 
@@ -174,6 +450,8 @@ value* builder::create_launch(function* fn, const std::vector<value*>& args, con
 
 #define DEFINE_BINARY_FLOAT(SUFFIX, OPCODE)\
   value *builder::create_ ## SUFFIX(value *lhs, value *rhs){\
+    if(value *folded = fold_binop(OPCODE, lhs, rhs))\
+      return folded;\
     return insert(binary_operator::create(OPCODE, lhs, rhs));\
   }
 
@@ -193,6 +471,8 @@ DEFINE_BINARY_FLOAT(fsub, binary_op_t::FSub)
 value* builder::create_insert_nuwnswb_binop(binary_op_t op, value *lhs,
                                             value *rhs,
                                             bool has_nuw, bool has_nsw) {
+  if(value *folded = fold_binop(op, lhs, rhs))
+    return folded;
   binary_operator* result = insert(binary_operator::create(op, lhs, rhs));
   if (has_nuw) result->set_has_no_unsigned_wrap();
   if (has_nsw) result->set_has_no_signed_wrap();
@@ -240,6 +520,8 @@ value* builder::create_gep(value *ptr, const std::vector<value*>& idx_list){
 //===----------------------------------------------------------------------===//
 
 value *builder::create_icmp(cmp_pred_t pred, value *lhs, value *rhs){
+  if(value *folded = fold_cmp(pred, lhs, rhs))
+    return folded;
   return insert(icmp_inst::create(pred, lhs, rhs));
 }
 
@@ -268,6 +550,8 @@ DEFINE_ICMP_INSTR(NE, cmp_pred_t::ICMP_NE)
 //===----------------------------------------------------------------------===//
 
 value *builder::create_fcmp(cmp_pred_t pred, value *lhs, value *rhs){
+  if(value *folded = fold_cmp(pred, lhs, rhs))
+    return folded;
   return insert(fcmp_inst::create(pred, lhs, rhs));
 }
 
@@ -308,6 +592,20 @@ value *builder::create_masked_load(value *ptr, value *mask, value *false_value,
   return insert(masked_load_inst::create(ptr, mask, false_value, cache, eviction, is_volatile));
 }
 
+value *builder::create_tile_load(value *ptr, value *mask, value *false_value, value *base, const std::vector<value*>& shape,
+                                 const std::vector<value*>& strides, const std::vector<value*>& offsets,
+                                 load_inst::CACHE_MODIFIER cache, load_inst::EVICTION_POLICY eviction, bool is_volatile){
+  if(shape.size() != strides.size() || shape.size() != offsets.size())
+    throw std::runtime_error("tiles need a shape, a stride and an offset per dimension");
+  masked_load_inst *ret = masked_load_inst::create(ptr, mask, false_value, cache, eviction, is_volatile);
+  std::vector<value*> tile = {base};
+  tile.insert(tile.end(), shape.begin(), shape.end());
+  tile.insert(tile.end(), strides.begin(), strides.end());
+  tile.insert(tile.end(), offsets.begin(), offsets.end());
+  ret->set_tile(tile);
+  return insert(ret);
+}
+
 value *builder::create_masked_store(value *ptr, value *val, value *mask){
   return insert(masked_store_inst::create(ptr, val, mask));
 }
@@ -351,8 +649,10 @@ value *builder::create_downcast(value *arg) {
 
 //
 
-value *builder::create_atomic_rmw(ir::atomic_rmw_op_t op, value *ptr, value *val, value *msk){
-  return insert(atomic_rmw_inst::create(op, ptr, val, msk));
+value *builder::create_atomic_rmw(ir::atomic_rmw_op_t op, value *ptr, value *val, value *msk, mem_scope_t scope){
+  auto *ret = (atomic_rmw_inst*)atomic_rmw_inst::create(op, ptr, val, msk);
+  ret->set_scope(scope);
+  return insert(ret);
 }
 
 #define DEFINE_ATOMIC_RMW_INSTR(SUFFIX, OPCODE)\
@@ -380,6 +680,14 @@ value *builder::create_globaltimer() {
   return insert(globaltimer_inst::create(ctx_));
 }
 
+value *builder::create_grid_sync() {
+  return insert(grid_sync_inst::create(ctx_));
+}
+
+value *builder::create_fence(mem_scope_t scope) {
+  return insert(fence_inst::create(ctx_, scope));
+}
+
 //===----------------------------------------------------------------------===//
 //                               built-in instructions
 //===----------------------------------------------------------------------===//
@@ -392,8 +700,10 @@ value *builder::create_get_num_programs(unsigned axis) {
   return insert(get_num_programs_inst::create(ctx_, axis));
 }
 
-value *builder::create_atomic_cas(value *ptr, value *cmp, value *val){
-  return insert(atomic_cas_inst::create(ptr, cmp, val));
+value *builder::create_atomic_cas(value *ptr, value *cmp, value *val, mem_scope_t scope){
+  auto *ret = (atomic_cas_inst*)atomic_cas_inst::create(ptr, cmp, val);
+  ret->set_scope(scope);
+  return insert(ret);
 }
 
 
@@ -413,8 +723,14 @@ value *builder::create_log(value *arg){
   return insert(log_inst::create(arg));
 }
 
-value *builder::create_dot(value *A, value *B, value *C, bool allow_tf32) {
-  return insert(dot_inst::create_nn(A, B, C, allow_tf32));
+value *builder::create_dot(value *A, value *B, value *C, bool allow_tf32, bool split_tf32) {
+  auto* dot = static_cast<dot_inst*>(dot_inst::create_nn(A, B, C, allow_tf32));
+  dot->set_split_tf32(split_tf32);
+  return insert(dot);
+}
+
+value *builder::create_sparse_dot(value *A, value *E, value *B, value *C) {
+  return insert(dot_inst::create_sparse(A, E, B, C));
 }
 
 value *builder::create_trans(value *A, const std::vector<int>& perm) {
@@ -429,7 +745,15 @@ value *builder::create_reduce(value *A, reduce_inst::op_t op, unsigned axis) {
   return insert(reduce_inst::create(A, op, axis));
 }
 
+value *builder::create_scan(value *A, reduce_inst::op_t op, unsigned axis, bool exclusive) {
+  return insert(scan_inst::create(A, op, axis, exclusive));
+}
+
 value *builder::create_select(value *pred, value *if_value, value *else_value){
+  if(if_value == else_value)
+    return if_value;
+  if(constant_int *cond = get_constant<constant_int>(pred))
+    return cond->get_value() & 1 ? if_value : else_value;
   return insert(select_inst::create(pred, if_value, else_value));
 }
 
@@ -441,6 +765,14 @@ value *builder::create_umulhi(value *lhs, value *rhs) {
   return insert(umulhi_inst::create(lhs, rhs));
 }
 
+value *builder::create_philox(value *offset, value *k0, value *k1, unsigned n_rounds, unsigned word, bool to_float) {
+  return insert(philox_inst::create(offset, k0, k1, n_rounds, word, to_float));
+}
+
+value *builder::create_math(const std::string &fn, const std::vector<value*> &args) {
+  return insert(math_inst::create(fn, args));
+}
+
 value *builder::create_copy_to_shared(value *arg) {
   return insert(copy_to_shared_inst::create(arg));
 }
@@ -458,6 +790,10 @@ value *builder::create_barrier(const std::string &name) {
   return insert(barrier_inst::create(ctx_));
 }
 
+value *builder::create_named_barrier(int id, int num_threads) {
+  return insert(barrier_inst::create_named(ctx_, id, num_threads));
+}
+
 value *builder::create_async_wait(int N) {
   return insert(async_wait_inst::create(ctx_, N));
 }
@@ -108,9 +108,22 @@ global_object::global_object(type *ty, unsigned num_ops,
 
 
 /* alloc const */
-alloc_const::alloc_const(type *ty, constant_int *size, const std::string &name)
-  : global_object(ty, 1, global_value::external, name, 4) {
+alloc_const::alloc_const(type *ty, constant_int *size, const std::string &name,
+                         const std::vector<constant*> &init)
+  : global_object(ty, 1 + init.size(), global_value::external, name, 4) {
+  if(!init.empty() && init.size() != size->get_value())
+    throw std::runtime_error("the initializer of " + name + " does not have " +
+                             std::to_string(size->get_value()) + " elements");
   set_operand(0, size);
+  for(size_t i = 0; i < init.size(); i++)
+    set_operand(1 + i, init[i]);
+}
+
+std::vector<constant*> alloc_const::get_init() const {
+  std::vector<constant*> ret;
+  for(size_t i = 1; i < get_num_operands(); i++)
+    ret.push_back((constant*)get_operand(i));
+  return ret;
 }
 
 
@@ -1,10 +1,51 @@
+#include <algorithm>
+#include <cstddef>
 #include "triton/ir/context_impl.h"
 #include "triton/ir/context.h"
 #include "triton/ir/type.h"
+#include "triton/ir/value.h"
 
 namespace triton{
 namespace ir{
 
+//===----------------------------------------------------------------------===//
+//                               value arena
+//===----------------------------------------------------------------------===//
+
+value_arena::~value_arena() {
+  for(auto it = values_.rbegin(); it != values_.rend(); it++)
+    static_cast<value*>(*it)->~value();
+}
+
+void* value_arena::allocate(size_t size) {
+  const size_t align = alignof(std::max_align_t);
+  size = (size + align - 1) / align * align;
+  char* ret;
+  if(size > slab_size / 4){
+    // large values get a slab of their own, and the current one stays open
+    slabs_.emplace_back(new char[size]);
+    ret = slabs_.back().get();
+  }
+  else{
+    if(size > left_){
+      slabs_.emplace_back(new char[slab_size]);
+      cur_ = slabs_.back().get();
+      left_ = slab_size;
+    }
+    ret = cur_;
+    cur_ += size;
+    left_ -= size;
+  }
+  values_.push_back(ret);
+  return ret;
+}
+
+void value_arena::release(void* ptr) {
+  auto it = std::find(values_.rbegin(), values_.rend(), ptr);
+  if(it != values_.rend())
+    values_.erase(std::next(it).base());
+}
+
 //===----------------------------------------------------------------------===//
 //                               context implementation
 //===----------------------------------------------------------------------===//
@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <iostream>
 #include "triton/ir/context.h"
+#include "triton/ir/context_impl.h"
 #include "triton/ir/basic_block.h"
 #include "triton/ir/instructions.h"
 #include "triton/ir/constant.h"
@@ -25,6 +26,14 @@ instruction::instruction(type *ty, value_id_t ity, unsigned num_ops,
   }
 }
 
+void* instruction::operator new(size_t size, context &ctx) {
+  return ctx.p_impl->values.allocate(size);
+}
+
+void instruction::operator delete(void *ptr, context &ctx) {
+  ctx.p_impl->values.release(ptr);
+}
+
 void instruction::erase_from_parent() {
   parent_->erase(this);
   for(ir::value* op: ops())
@@ -77,7 +86,7 @@ void phi_node::add_incoming(value *v, basic_block *block){
 
 // Factory methods
 phi_node* phi_node::create(type *ty, unsigned num_reserved, const std::string &name, instruction *next){
-  return new phi_node(ty, num_reserved, name, next);
+  return new (ty->get_context()) phi_node(ty, num_reserved, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -93,7 +102,7 @@ call_inst::call_inst(ir::function* fn, const std::vector<ir::value*>& values, co
 }
 
 call_inst* call_inst::create(ir::function* fn, const std::vector<ir::value*>& values, const std::string &name, instruction *next) {
-  return new call_inst(fn, values, name, next);
+  return new (fn->get_fn_type()->get_context()) call_inst(fn, values, name, next);
 }
 
 
@@ -123,14 +132,14 @@ ir::function* launch_inst::get_fn() {
 
 std::vector<ir::value*> launch_inst::get_values() {
   std::vector<ir::value*> ret;
-  for(int i = val_begin; i < val_end; i++)
+  for(unsigned i = val_begin; i < val_end; i++)
     ret.push_back(get_operand(i));
   return ret;
 }
 
 std::vector<ir::value*> launch_inst::get_grid() {
   std::vector<ir::value*> ret;
-  for(int i = grid_begin; i < grid_end; i++)
+  for(unsigned i = grid_begin; i < grid_end; i++)
     ret.push_back(get_operand(i));
   return ret;
 }
@@ -141,7 +150,7 @@ ir::value* launch_inst::get_num_warps() {
 
 
 launch_inst* launch_inst::create(ir::function *fn, const std::vector<ir::value *> &values, const std::vector<ir::value *> &grid, ir::value *num_warps, const std::string &name, instruction *next) {
- return new launch_inst(fn, values, grid, num_warps, name, next);
+ return new (fn->get_fn_type()->get_context()) launch_inst(fn, values, grid, num_warps, name, next);
 }
 
 
@@ -207,7 +216,7 @@ binary_operator::binary_operator(binary_op_t op, value *lhs, value *rhs, type *t
 binary_operator *binary_operator::create(binary_op_t op, value *lhs, value *rhs, const std::string &name, instruction *next){
   assert(lhs->get_type() == rhs->get_type() &&
          "Cannot create binary operator with two operands of differing type!");
-  return new binary_operator(op, lhs, rhs, lhs->get_type(), name, next);
+  return new (lhs->get_type()->get_context()) binary_operator(op, lhs, rhs, lhs->get_type(), name, next);
 }
 
 //binary_operator *binary_operator::create_fneg(value *arg, const std::string &name, instruction *next){
@@ -299,7 +308,7 @@ icmp_inst* icmp_inst::create(cmp_pred_t pred, value *lhs, value *rhs, const std:
   assert(is_int_predicate(pred));
   assert(lhs->get_type() == rhs->get_type());
   type *res_ty = make_cmp_result_type(lhs->get_type());
-  return new icmp_inst(res_ty, pred, lhs, rhs, name, next);
+  return new (res_ty->get_context()) icmp_inst(res_ty, pred, lhs, rhs, name, next);
 }
 
 // fcmp_inst
@@ -310,7 +319,7 @@ fcmp_inst::fcmp_inst(type *ty, cmp_pred_t pred,
 fcmp_inst* fcmp_inst::create(cmp_pred_t pred, value *lhs, value *rhs, const std::string &name, instruction *next){
   assert(is_fp_predicate(pred));
   type *res_ty = make_cmp_result_type(lhs->get_type());
-  return new fcmp_inst(res_ty, pred, lhs, rhs, name, next);
+  return new (res_ty->get_context()) fcmp_inst(res_ty, pred, lhs, rhs, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -353,20 +362,21 @@ bool cast_inst::is_valid(cast_op_t op, value *arg, type *ty) {
 cast_inst *cast_inst::create(cast_op_t op, value *arg, type *ty, const std::string &name, instruction *next){
   assert(is_valid(op, arg, ty) && "Invalid cast!");
   // Construct and return the appropriate CastInst subclass
+  context &ctx = ty->get_context();
   switch (op) {
-  case cast_op_t::Trunc:         return new trunc_inst           (ty, arg, name, next);
-  case cast_op_t::ZExt:          return new z_ext_inst           (ty, arg, name, next);
-  case cast_op_t::SExt:          return new s_ext_inst           (ty, arg, name, next);
-  case cast_op_t::FPTrunc:       return new fp_trunc_inst        (ty, arg, name, next);
-  case cast_op_t::FPExt:         return new fp_ext_inst          (ty, arg, name, next);
-  case cast_op_t::UIToFP:        return new ui_to_fp_inst        (ty, arg, name, next);
-  case cast_op_t::SIToFP:        return new si_to_fp_inst        (ty, arg, name, next);
-  case cast_op_t::FPToUI:        return new fp_to_ui_inst        (ty, arg, name, next);
-  case cast_op_t::FPToSI:        return new fp_to_si_inst        (ty, arg, name, next);
-  case cast_op_t::PtrToInt:      return new ptr_to_int_inst      (ty, arg, name, next);
-  case cast_op_t::IntToPtr:      return new int_to_ptr_inst      (ty, arg, name, next);
-  case cast_op_t::BitCast:       return new bit_cast_inst        (ty, arg, name, next);
-  case cast_op_t::AddrSpaceCast: return new addr_space_cast_inst (ty, arg, name, next);
+  case cast_op_t::Trunc:         return new (ctx) trunc_inst           (ty, arg, name, next);
+  case cast_op_t::ZExt:          return new (ctx) z_ext_inst           (ty, arg, name, next);
+  case cast_op_t::SExt:          return new (ctx) s_ext_inst           (ty, arg, name, next);
+  case cast_op_t::FPTrunc:       return new (ctx) fp_trunc_inst        (ty, arg, name, next);
+  case cast_op_t::FPExt:         return new (ctx) fp_ext_inst          (ty, arg, name, next);
+  case cast_op_t::UIToFP:        return new (ctx) ui_to_fp_inst        (ty, arg, name, next);
+  case cast_op_t::SIToFP:        return new (ctx) si_to_fp_inst        (ty, arg, name, next);
+  case cast_op_t::FPToUI:        return new (ctx) fp_to_ui_inst        (ty, arg, name, next);
+  case cast_op_t::FPToSI:        return new (ctx) fp_to_si_inst        (ty, arg, name, next);
+  case cast_op_t::PtrToInt:      return new (ctx) ptr_to_int_inst      (ty, arg, name, next);
+  case cast_op_t::IntToPtr:      return new (ctx) int_to_ptr_inst      (ty, arg, name, next);
+  case cast_op_t::BitCast:       return new (ctx) bit_cast_inst        (ty, arg, name, next);
+  case cast_op_t::AddrSpaceCast: return new (ctx) addr_space_cast_inst (ty, arg, name, next);
   default: throw std::runtime_error("unreachable");
   }
 }
@@ -395,19 +405,19 @@ return_inst::return_inst(context &ctx, value *ret_val, instruction *next)
 }
 
 return_inst *return_inst::create(context &ctx, value *ret_val, instruction *next){
-  return new return_inst(ctx, ret_val, next);
+  return new (ctx) return_inst(ctx, ret_val, next);
 }
 
 
 // branch_inst
 branch_inst* branch_inst::create(basic_block *dst, instruction *next) {
   assert(dst && "Branch destination may not be null!");
-  return new uncond_branch_inst(dst, next);
+  return new (dst->get_context()) uncond_branch_inst(dst, next);
 }
 
 branch_inst* branch_inst::create(value *cond, basic_block *if_dst, basic_block *else_dst, instruction *next) {
   assert(cond->get_type()->is_integer_ty(1) && "May only branch on boolean predicates!");
-  return new cond_branch_inst(if_dst, else_dst, cond, next);
+  return new (cond->get_type()->get_context()) cond_branch_inst(if_dst, else_dst, cond, next);
 }
 
 // uncond_branch_inst
@@ -485,7 +495,7 @@ type *getelementptr_inst::get_indexed_type(type *ty, const std::vector<value *>
 
 getelementptr_inst *getelementptr_inst::create(value *ptr, const std::vector<value *> &idx, const std::string &name, instruction *next) {
   type *pointee_ty = ((pointer_type*)(ptr->get_type()->get_scalar_ty()))->get_element_ty();
-  return new getelementptr_inst(pointee_ty, ptr, idx, name, next);
+  return new (ptr->get_type()->get_context()) getelementptr_inst(pointee_ty, ptr, idx, name, next);
 }
 
 
@@ -500,9 +510,22 @@ io_inst::io_inst(type *ty, value_id_t id, unsigned num_ops, const std::string &n
 
 // load_inst
 load_inst::load_inst(value *ptr, value_id_t id, unsigned num_ops, load_inst::CACHE_MODIFIER cache, EVICTION_POLICY eviction, bool is_volatile, const std::string &name, instruction *next)
-  : io_inst(get_pointee_type(ptr->get_type()), id, num_ops, name, next), cache_(cache), eviction_(eviction), is_volatile_(is_volatile)
+  : io_inst(get_pointee_type(ptr->get_type()), id, num_ops, name, next), cache_(cache), eviction_(eviction), is_volatile_(is_volatile),
+    num_load_ops_(num_ops)
 { }
 
+void load_inst::set_tile(const std::vector<value*>& tile) {
+  assert(get_num_operands() == num_load_ops_ && "load already has a tile");
+  assert(tile.size() % 3 == 1 && "tiles have a base, and a shape, strides and offsets per dimension");
+  resize_ops(num_load_ops_ + tile.size());
+  for(size_t k = 0; k < tile.size(); k++)
+    set_operand(num_load_ops_ + k, tile[k]);
+}
+
+std::vector<value*> load_inst::get_tile() const {
+  return std::vector<value*>(ops().begin() + num_load_ops_, ops().begin() + get_num_operands());
+}
+
 // load
 type *load_inst::get_pointee_type(type *ty) {
   type *scalar_ty = ty->get_scalar_ty();
@@ -519,7 +542,7 @@ unmasked_load_inst::unmasked_load_inst(value *ptr, load_inst::CACHE_MODIFIER cac
 }
 
 unmasked_load_inst* unmasked_load_inst::create(value *ptr, load_inst::CACHE_MODIFIER cache, load_inst::EVICTION_POLICY eviction, bool is_volatile, const std::string &name, instruction *next) {
-  return new unmasked_load_inst(ptr, cache, eviction, is_volatile, name, next);
+  return new (ptr->get_type()->get_context()) unmasked_load_inst(ptr, cache, eviction, is_volatile, name, next);
 }
 
 // masked load
@@ -536,7 +559,7 @@ masked_load_inst* masked_load_inst::create(value *ptr, value *mask, value *false
                                            load_inst::CACHE_MODIFIER cache, load_inst::EVICTION_POLICY eviction,
                                            bool is_volatile,
                                            const std::string &name, instruction *next) {
-  return new masked_load_inst(ptr, mask, false_value, cache, eviction, is_volatile, name, next);
+  return new (ptr->get_type()->get_context()) masked_load_inst(ptr, mask, false_value, cache, eviction, is_volatile, name, next);
 }
 
 // masked load async
@@ -552,7 +575,7 @@ masked_load_async_inst::masked_load_async_inst(value *ptr, value *mask, value *f
 masked_load_async_inst* masked_load_async_inst::create(value *ptr, value *mask, value *false_value,
                                            load_inst::CACHE_MODIFIER cache, EVICTION_POLICY eviction,
                                            const std::string &name, instruction *next) {
-  return new masked_load_async_inst(ptr, mask, false_value, cache, eviction, name, next);
+  return new (ptr->get_type()->get_context()) masked_load_async_inst(ptr, mask, false_value, cache, eviction, name, next);
 }
 
 // store
@@ -571,7 +594,7 @@ unmasked_store_inst::unmasked_store_inst(value *ptr, value *val,
 
 unmasked_store_inst* unmasked_store_inst::create(value *ptr, value *val,
                                                  const std::string &name, instruction *next) {
-  return new unmasked_store_inst(ptr, val, name, next);
+  return new (ptr->get_type()->get_context()) unmasked_store_inst(ptr, val, name, next);
 }
 
 // masked store
@@ -584,7 +607,7 @@ masked_store_inst::masked_store_inst(value *ptr, value *val, value *mask,
 }
 
 masked_store_inst* masked_store_inst::create(value *ptr, value *val, value *mask, const std::string &name, instruction *next)  {
-  return new masked_store_inst(ptr, val, mask, name, next);
+  return new (ptr->get_type()->get_context()) masked_store_inst(ptr, val, mask, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -600,7 +623,7 @@ insert_value_inst::insert_value_inst(value *val, value *elt, size_t idx, const s
 }
 
 insert_value_inst* insert_value_inst::create(value *val, value *elt, size_t idx, const std::string& name, instruction *next){
-  return new insert_value_inst(val, elt, idx, name, next);
+  return new (val->get_type()->get_context()) insert_value_inst(val, elt, idx, name, next);
 }
 
 
@@ -612,7 +635,7 @@ extract_value_inst::extract_value_inst(value *val, size_t idx, const std::string
 }
 
 extract_value_inst* extract_value_inst::create(value *val, size_t idx, const std::string& name, instruction *next){
-  return new extract_value_inst(val, idx, name, next);
+  return new (val->get_type()->get_context()) extract_value_inst(val, idx, name, next);
 }
 
 
@@ -631,7 +654,7 @@ cat_inst::cat_inst(value *x, value *y, const std::string &name, instruction *nex
 }
 
 instruction* cat_inst::create(value *lhs, value *rhs, const std::string &name, instruction *next) {
-  return new cat_inst(lhs, rhs, name, next);
+  return new (lhs->get_type()->get_context()) cat_inst(lhs, rhs, name, next);
 }
 
 // retile
@@ -646,7 +669,7 @@ retile_inst::retile_inst(value *arg, value_id_t id, const type::block_shapes_t &
 
 instruction* reshape_inst::create(value *arg, const type::block_shapes_t &shapes,
                                   const std::string &name, instruction *next) {
-  return new reshape_inst(arg, INST_RESHAPE, shapes, name, next);
+  return new (arg->get_type()->get_context()) reshape_inst(arg, INST_RESHAPE, shapes, name, next);
 }
 
 
@@ -654,20 +677,20 @@ instruction* reshape_inst::create(value *arg, const type::block_shapes_t &shapes
 
 instruction* splat_inst::create(value *arg, const type::block_shapes_t &shapes,
                                   const std::string &name, instruction *next) {
-  return new splat_inst(arg, INST_SPLAT, shapes, name, next);
+  return new (arg->get_type()->get_context()) splat_inst(arg, INST_SPLAT, shapes, name, next);
 }
 
 // broadcast
 
 instruction* broadcast_inst::create(value *arg, const type::block_shapes_t &shapes,
                                   const std::string &name, instruction *next) {
-  return new broadcast_inst(arg, INST_BROADCAST, shapes, name, next);
+  return new (arg->get_type()->get_context()) broadcast_inst(arg, INST_BROADCAST, shapes, name, next);
 }
 
 // downcast
 
 instruction* downcast_inst::create(value *arg, const std::string &name, instruction *next) {
-  return new downcast_inst(arg->get_type()->get_scalar_ty(), INST_DOWNCAST, arg, name, next);
+  return new (arg->get_type()->get_context()) downcast_inst(arg->get_type()->get_scalar_ty(), INST_DOWNCAST, arg, name, next);
 }
 
 
@@ -678,11 +701,13 @@ instruction* downcast_inst::create(value *arg, const std::string &name, instruct
 //===----------------------------------------------------------------------===//
 
 dot_inst::dot_inst(value *A, value *B, value *C, TransT AT, TransT BT, bool allow_tf32,
-                         const std::string &name, instruction *next)
-    : builtin_inst(C->get_type(), INST_DOT, 3, name, next) {
+                         const std::string &name, instruction *next, value *E)
+    : builtin_inst(C->get_type(), INST_DOT, E ? 4 : 3, name, next) {
   set_operand(0, A);
   set_operand(1, B);
   set_operand(2, C);
+  if(E)
+    set_operand(3, E);
   allow_tf32_ = allow_tf32;
 }
 
@@ -691,27 +716,32 @@ instruction *dot_inst::create(value *A, value *B, value *C,
                               const std::string &name, instruction *next) {
   TransT OPA = AT ? Trans : NoTrans;
   TransT OPB = BT ? Trans : NoTrans;
-  return new dot_inst(A, B, C, OPA, OPB, allow_tf32, name, next);
+  return new (A->get_type()->get_context()) dot_inst(A, B, C, OPA, OPB, allow_tf32, name, next);
+}
+
+instruction *dot_inst::create_sparse(value *A, value *E, value *B, value *C,
+                                     const std::string &name, instruction *next) {
+  return new (A->get_type()->get_context()) dot_inst(A, B, C, NoTrans, NoTrans, true, name, next, E);
 }
 
 instruction *dot_inst::create_nn(value *A, value *B, value *C, bool allow_tf32,
                                  const std::string &name, instruction *next) {
-  return new dot_inst(A, B, C, NoTrans, NoTrans, allow_tf32, name, next);
+  return new (A->get_type()->get_context()) dot_inst(A, B, C, NoTrans, NoTrans, allow_tf32, name, next);
 }
 
 instruction *dot_inst::create_nt(value *A, value *B, value *C, bool allow_tf32,
                                  const std::string &name, instruction *next) {
-  return new dot_inst(A, B, C, NoTrans, Trans, allow_tf32, name, next);
+  return new (A->get_type()->get_context()) dot_inst(A, B, C, NoTrans, Trans, allow_tf32, name, next);
 }
 
 instruction *dot_inst::create_tn(value *A, value *B, value *C, bool allow_tf32,
                                  const std::string &name, instruction *next) {
-  return new dot_inst(A, B, C, Trans, NoTrans, allow_tf32, name, next);
+  return new (A->get_type()->get_context()) dot_inst(A, B, C, Trans, NoTrans, allow_tf32, name, next);
 }
 
 instruction *dot_inst::create_tt(value *A, value *B, value *C, bool allow_tf32,
                                  const std::string &name, instruction *next) {
-  return new dot_inst(A, B, C, Trans, Trans, allow_tf32, name, next);
+  return new (A->get_type()->get_context()) dot_inst(A, B, C, Trans, Trans, allow_tf32, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -751,7 +781,7 @@ trans_inst::trans_inst(value *arg, const std::vector<int> &perm, const std::stri
 }
 
 instruction* trans_inst::create(value *arg, const std::vector<int> &perm, const std::string &name, instruction *next) {
-  return new trans_inst(arg, perm, name, next);
+  return new (arg->get_type()->get_context()) trans_inst(arg, perm, name, next);
 }
 
 const std::vector<int> trans_inst::get_perm() const {
@@ -768,7 +798,7 @@ sqrt_inst::sqrt_inst(value *arg, const std::string &name, instruction *next)
 }
 
 instruction* sqrt_inst::create(value *arg, const std::string &name, instruction *next) {
-  return new sqrt_inst(arg, name, next);
+  return new (arg->get_type()->get_context()) sqrt_inst(arg, name, next);
 }
 
 //===----------------------------------------------------------------------===//
@@ -785,16 +815,22 @@ std::string reduce_inst::to_str(op_t op) {
     case FSUB: return "-";
     case FMAX: return "fmax";
     case FMIN: return "fmin";
+    case ARGMAX: return "argimax";
+    case ARGMIN: return "argimin";
+    case ARGFMAX: return "argfmax";
+    case ARGFMIN: return "argfmin";
     default: break;
   }
   assert(false);
   return "";
 }
 
-type* reduce_inst::get_res_type(value *arg, unsigned axis) {
+type* reduce_inst::get_res_type(value *arg, op_t op, unsigned axis) {
   ir::block_type::block_shapes_t shapes = arg->get_type()->get_block_shapes();
   shapes.erase(shapes.begin() + axis);
   type *scalar_ty = arg->get_type()->get_scalar_ty();
+  if(op >= ARGMAX)
+    scalar_ty = type::get_int32_ty(scalar_ty->get_context());
   if(shapes.empty())
 //    shapes.push_back(1);
     return scalar_ty;
@@ -802,14 +838,32 @@ type* reduce_inst::get_res_type(value *arg, unsigned axis) {
 }
 
 reduce_inst::reduce_inst(value *arg, op_t op, unsigned axis, const std::string &name, instruction *next)
-  : builtin_inst(get_res_type(arg, axis), INST_REDUCE, 1, name, next),
+  : builtin_inst(get_res_type(arg, op, axis), INST_REDUCE, 1, name, next),
     op_(op),
     axis_(axis){
   set_operand(0, arg);
 }
 
 instruction* reduce_inst::create(value *arg, op_t op, unsigned axis, const std::string &name, instruction *next) {
-  return new reduce_inst(arg, op, axis, name, next);
+  return new (arg->get_type()->get_context()) reduce_inst(arg, op, axis, name, next);
+}
+
+//===----------------------------------------------------------------------===//
+//                               scan instructions
+//===----------------------------------------------------------------------===//
+
+scan_inst::scan_inst(value *arg, reduce_inst::op_t op, unsigned axis, bool exclusive,
+                     const std::string &name, instruction *next)
+  : builtin_inst(arg->get_type(), INST_SCAN, 1, name, next),
+    axis_(axis),
+    op_(op),
+    exclusive_(exclusive){
+  set_operand(0, arg);
+}
+
+instruction* scan_inst::create(value *arg, reduce_inst::op_t op, unsigned axis, bool exclusive,
+                               const std::string &name, instruction *next) {
+  return new (arg->get_type()->get_context()) scan_inst(arg, op, axis, exclusive, name, next);
 }
 
 
@@ -825,7 +879,7 @@ select_inst::select_inst(value *pred, value *if_value, value *else_value, const
 }
 
 instruction* select_inst::create(value *pred, value *if_value, value *else_value, const std::string &name, instruction *next) {
-  return new select_inst(pred, if_value, else_value, name, next);
+  return new (pred->get_type()->get_context()) select_inst(pred, if_value, else_value, name, next);
 }
 //===----------------------------------------------------------------------===//
 //                               builtin instructions
@@ -839,7 +893,7 @@ get_program_id_inst::get_program_id_inst(type *ty, unsigned axis, const std::str
 }
 
 instruction* get_program_id_inst::create(context &ctx, unsigned axis, const std::string &name, instruction *next) {
-  return new get_program_id_inst(type::get_int32_ty(ctx), axis, name, next);
+  return new (ctx) get_program_id_inst(type::get_int32_ty(ctx), axis, name, next);
 }
 
 // get_num_program
@@ -849,7 +903,7 @@ get_num_programs_inst::get_num_programs_inst(type *ty, unsigned axis, const std:
 }
 
 instruction* get_num_programs_inst::create(context &ctx, unsigned axis, const std::string &name, instruction *next) {
-  return new get_num_programs_inst(type::get_int32_ty(ctx), axis, name, next);
+  return new (ctx) get_num_programs_inst(type::get_int32_ty(ctx), axis, name, next);
 }
 
 // atomic_rmw
@@ -862,7 +916,7 @@ atomic_rmw_inst::atomic_rmw_inst(atomic_rmw_op_t op, value *ptr, value *val, val
 }
 
 instruction* atomic_rmw_inst::create(atomic_rmw_op_t op, value *ptr, value *val, value *msk, const std::string &name, instruction *next) {
-  return new atomic_rmw_inst(op, ptr, val, msk, name, next);
+  return new (ptr->get_type()->get_context()) atomic_rmw_inst(op, ptr, val, msk, name, next);
 }
 
 
@@ -876,7 +930,7 @@ atomic_cas_inst::atomic_cas_inst(value *ptr, value *cmp, value *val, const std::
 }
 
 instruction* atomic_cas_inst::create(value *ptr, value *cmp, value *val, const std::string &name, instruction *next) {
-  return new atomic_cas_inst(ptr, cmp, val, name, next);
+  return new (ptr->get_type()->get_context()) atomic_cas_inst(ptr, cmp, val, name, next);
 }
 
 
@@ -889,7 +943,47 @@ umulhi_inst::umulhi_inst(value *lhs, value *rhs, const std::string &name, instru
 }
 
 instruction* umulhi_inst::create(value *lhs, value *rhs, const std::string &name, instruction *next) {
-  return new umulhi_inst(lhs, rhs, name, next);
+  return new (lhs->get_type()->get_context()) umulhi_inst(lhs, rhs, name, next);
+}
+
+
+// philox
+
+static type* philox_result_type(type *ty, bool to_float){
+  if(!to_float)
+    return ty;
+  type* fp32_ty = type::get_fp32_ty(ty->get_context());
+  if(block_type* tile_ty = dynamic_cast<block_type*>(ty))
+    return block_type::get_same_shapes(fp32_ty, tile_ty);
+  return fp32_ty;
+}
+
+philox_inst::philox_inst(value *offset, value *k0, value *k1, unsigned n_rounds, unsigned word, bool to_float,
+                         const std::string &name, instruction *next)
+  : builtin_inst(philox_result_type(offset->get_type(), to_float), INST_PHILOX, 3, name, next),
+    n_rounds_(n_rounds), word_(word), to_float_(to_float) {
+  set_operand(0, offset);
+  set_operand(1, k0);
+  set_operand(2, k1);
+}
+
+instruction* philox_inst::create(value *offset, value *k0, value *k1, unsigned n_rounds, unsigned word, bool to_float,
+                                 const std::string &name, instruction *next) {
+  return new (offset->get_type()->get_context()) philox_inst(offset, k0, k1, n_rounds, word, to_float, name, next);
+}
+
+
+// math
+
+math_inst::math_inst(const std::string &fn, const std::vector<value*> &args, const std::string &name, instruction *next)
+  : builtin_inst(args.at(0)->get_type(), INST_MATH, args.size(), name, next), fn_(fn) {
+  for(size_t i = 0; i < args.size(); i++)
+    set_operand(i, args[i]);
+}
+
+instruction* math_inst::create(const std::string &fn, const std::vector<value*> &args, const std::string &name,
+                               instruction *next) {
+  return new (args.at(0)->get_type()->get_context()) math_inst(fn, args, name, next);
 }
 
 
@@ -901,7 +995,7 @@ exp_inst::exp_inst(value *val, const std::string &name, instruction *next)
 }
 
 instruction* exp_inst::create(value *val, const std::string& name, instruction *next) {
-  return new exp_inst(val, name, next);
+  return new (val->get_type()->get_context()) exp_inst(val, name, next);
 }
 
 // cos
@@ -911,7 +1005,7 @@ cos_inst::cos_inst(value *val, const std::string &name, instruction *next)
 }
 
 instruction* cos_inst::create(value *val, const std::string& name, instruction *next) {
-  return new cos_inst(val, name, next);
+  return new (val->get_type()->get_context()) cos_inst(val, name, next);
 }
 
 // sin
@@ -921,7 +1015,7 @@ sin_inst::sin_inst(value *val, const std::string &name, instruction *next)
 }
 
 instruction* sin_inst::create(value *val, const std::string& name, instruction *next) {
-  return new sin_inst(val, name, next);
+  return new (val->get_type()->get_context()) sin_inst(val, name, next);
 }
 
 
@@ -933,7 +1027,7 @@ log_inst::log_inst(value *val, const std::string &name, instruction *next)
 }
 
 instruction* log_inst::create(value *val, const std::string& name, instruction *next) {
-  return new log_inst(val, name, next);
+  return new (val->get_type()->get_context()) log_inst(val, name, next);
 }
 
 
@@ -943,39 +1037,46 @@ instruction* log_inst::create(value *val, const std::string& name, instruction *
 
 // cvt_scanline
 cvt_layout_inst* cvt_layout_inst::create(value *arg, const std::string &name, instruction *next) {
-  return new cvt_layout_inst(arg->get_type(), INST_CVT_LAYOUT, arg, name, next);
+  return new (arg->get_type()->get_context()) cvt_layout_inst(arg->get_type(), INST_CVT_LAYOUT, arg, name, next);
 }
 
 // copy to shared
 copy_to_shared_inst* copy_to_shared_inst::create(value *arg, const std::string &name,
                                                  instruction *next) {
-  return new copy_to_shared_inst(arg->get_type(), INST_COPY_TO_SHARED, arg, name, next);
+  return new (arg->get_type()->get_context()) copy_to_shared_inst(arg->get_type(), INST_COPY_TO_SHARED, arg, name, next);
 }
 
 // copy from shared
 copy_from_shared_inst* copy_from_shared_inst::create(value *arg, const std::string &name,
                                                  instruction *next) {
-  return new copy_from_shared_inst(arg->get_type(), INST_COPY_FROM_SHARED, arg, name, next);
+  return new (arg->get_type()->get_context()) copy_from_shared_inst(arg->get_type(), INST_COPY_FROM_SHARED, arg, name, next);
 }
 
 // barrier
-barrier_inst::barrier_inst(context &ctx, const std::string &name, instruction *next)
-  : instruction(type::get_void_ty(ctx), INST_BARRIER, 0, name, next) { }
+barrier_inst::barrier_inst(context &ctx, int id, int num_threads, const std::string &name, instruction *next)
+  : instruction(type::get_void_ty(ctx), INST_BARRIER, 0, name, next), id_(id), num_threads_(num_threads) { }
 
 barrier_inst* barrier_inst::create(context &ctx, const std::string &name, instruction *next) {
-  return new barrier_inst(ctx, name, next);
+  return new (ctx) barrier_inst(ctx, 0, 0, name, next);
+}
+
+barrier_inst* barrier_inst::create_named(context &ctx, int id, int num_threads, const std::string &name,
+                                         instruction *next) {
+  if(num_threads <= 0 || num_threads % 32 != 0)
+    throw std::runtime_error("named barriers synchronize a positive multiple of 32 threads");
+  return new (ctx) barrier_inst(ctx, id, num_threads, name, next);
 }
 
 async_wait_inst::async_wait_inst(context &ctx, int N, const std::string &name, instruction *next)
   : instruction(type::get_void_ty(ctx), INST_ASYNC_WAIT, 0, name, next), N_(N) { }
 
 async_wait_inst* async_wait_inst::create(context &ctx, int N, const std::string &name, instruction *next) {
-  return new async_wait_inst(ctx, N, name, next);
+  return new (ctx) async_wait_inst(ctx, N, name, next);
 }
 
 // prefetch_s
 prefetch_s_inst *prefetch_s_inst::create(context &ctx, value *arg, int inc, const std::string &name, instruction *next) {
-  return new prefetch_s_inst(ctx, arg, inc, name, next);
+  return new (ctx) prefetch_s_inst(ctx, arg, inc, name, next);
 }
 
 // global timer
@@ -983,7 +1084,23 @@ globaltimer_inst::globaltimer_inst(context &ctx, const std::string &name, instru
   : instruction(type::get_int64_ty(ctx), INST_GLOBALTIMER, 0, name, next) { }
 
 globaltimer_inst* globaltimer_inst::create(context &ctx, const std::string &name, instruction *next) {
-  return new globaltimer_inst(ctx, name, next);
+  return new (ctx) globaltimer_inst(ctx, name, next);
+}
+
+// grid sync
+grid_sync_inst::grid_sync_inst(context &ctx, const std::string &name, instruction *next)
+  : instruction(type::get_void_ty(ctx), INST_GRID_SYNC, 0, name, next) { }
+
+grid_sync_inst* grid_sync_inst::create(context &ctx, const std::string &name, instruction *next) {
+  return new (ctx) grid_sync_inst(ctx, name, next);
+}
+
+// fence
+fence_inst::fence_inst(context &ctx, mem_scope_t scope, const std::string &name, instruction *next)
+  : instruction(type::get_void_ty(ctx), INST_FENCE, 0, name, next), scope_(scope) { }
+
+fence_inst* fence_inst::create(context &ctx, mem_scope_t scope, const std::string &name, instruction *next) {
+  return new (ctx) fence_inst(ctx, scope, name, next);
 }
 
 // clock
@@ -991,7 +1108,7 @@ clock_inst::clock_inst(context &ctx, const std::string &name, instruction *next)
   : instruction(type::get_int64_ty(ctx), INST_CLOCK, 0, name, next) { }
 
 clock_inst* clock_inst::create(context &ctx, const std::string &name, instruction *next) {
-  return new clock_inst(ctx, name, next);
+  return new (ctx) clock_inst(ctx, name, next);
 }
 
 
@@ -1004,7 +1121,7 @@ make_range *make_range::create(constant_int *first, constant_int *last) {
   assert(first->get_type() == last->get_type());
 //  assert(((constant_int*)first)->get_value() == 0);
   type *ty = block_type::get(first->get_type(), {(unsigned)last->get_value() - (unsigned)first->get_value()});
-  return new make_range(ty, first, last);
+  return new (ty->get_context()) make_range(ty, first, last);
 }
 
 const constant_int* make_range::get_first() const {
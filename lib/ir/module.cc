@@ -22,6 +22,15 @@ function *module::get_or_insert_function(const std::string &name, function_type
   return fn;
 }
 
+/* source files */
+unsigned module::add_source_file(const std::string& path) {
+  auto it = std::find(source_files_.begin(), source_files_.end(), path);
+  if(it != source_files_.end())
+    return it - source_files_.begin() + 1;
+  source_files_.push_back(path);
+  return source_files_.size();
+}
+
 
 }
 }
@@ -1,8 +1,11 @@
+#include <algorithm>
+#include <iterator>
 #include <stack>
 #include <iostream>
 #include "triton/ir/utils.h"
 #include "triton/ir/basic_block.h"
 #include "triton/ir/function.h"
+#include "triton/ir/instructions.h"
 #include "triton/ir/module.h"
 
 namespace triton{
@@ -43,6 +46,37 @@ std::vector<basic_block*> cfg::reverse_post_order(function* fn) {
   return result;
 }
 
+std::map<basic_block*, std::set<basic_block*>> cfg::dominators(function* fn) {
+  std::vector<basic_block*> blocks = reverse_post_order(fn);
+  std::map<basic_block*, std::set<basic_block*>> dom;
+  std::set<basic_block*> all(blocks.begin(), blocks.end());
+  for(basic_block* block: blocks)
+    dom[block] = block->get_predecessors().empty() ? std::set<basic_block*>{block} : all;
+  // iterate to a fixed point
+  bool changed = true;
+  while(changed){
+    changed = false;
+    for(basic_block* block: blocks){
+      std::vector<basic_block*> preds = block->get_predecessors();
+      if(preds.empty())
+        continue;
+      std::set<basic_block*> new_dom = dom[preds[0]];
+      for(size_t n = 1; n < preds.size(); n++){
+        std::set<basic_block*> tmp;
+        std::set_intersection(new_dom.begin(), new_dom.end(), dom[preds[n]].begin(), dom[preds[n]].end(),
+                              std::inserter(tmp, tmp.begin()));
+        new_dom = tmp;
+      }
+      new_dom.insert(block);
+      if(new_dom != dom[block]){
+        dom[block] = new_dom;
+        changed = true;
+      }
+    }
+  }
+  return dom;
+}
+
 void for_each_instruction(module &mod, const std::function<void (instruction *)> &do_work) {
   for(ir::function *fn: mod.get_function_list())
   for(ir::basic_block *block: cfg::reverse_post_order(fn))
@@ -64,5 +98,34 @@ void for_each_value(module &mod, const std::function<void (value *)> &do_work) {
   }
 }
 
+static void get_bases(value* v, std::set<value*>& bases, std::set<value*>& seen) {
+  if(!seen.insert(v).second)
+    return;
+  if(auto* x = dynamic_cast<getelementptr_inst*>(v))
+    return get_bases(x->get_pointer_operand(), bases, seen);
+  if(auto* x = dynamic_cast<retile_inst*>(v))
+    return get_bases(x->get_operand(0), bases, seen);
+  if(auto* x = dynamic_cast<cast_inst*>(v))
+  if(x->get_operand(0)->get_type()->get_scalar_ty()->is_pointer_ty())
+    return get_bases(x->get_operand(0), bases, seen);
+  if(auto* x = dynamic_cast<phi_node*>(v)){
+    for(unsigned n = 0; n < x->get_num_incoming(); n++)
+      get_bases(x->get_incoming_value(n), bases, seen);
+    return;
+  }
+  if(auto* x = dynamic_cast<select_inst*>(v)){
+    get_bases(x->get_if_value_op(), bases, seen);
+    get_bases(x->get_else_value_op(), bases, seen);
+    return;
+  }
+  bases.insert(v);
+}
+
+std::set<value*> get_bases(value* v) {
+  std::set<value*> bases, seen;
+  get_bases(v, bases, seen);
+  return bases;
+}
+
 }
 }
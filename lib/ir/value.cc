@@ -9,6 +9,34 @@ namespace ir{
 
 class type;
 
+//===----------------------------------------------------------------------===//
+//                               use list
+//===----------------------------------------------------------------------===//
+
+use_list& use_list::operator=(const use_list& other) {
+  if(this == &other)
+    return *this;
+  clear();
+  for(user* u: other)
+    push_back(u);
+  return *this;
+}
+
+void use_list::push_back(user* u) {
+  pos_[u].push_back(users_.insert(users_.end(), u));
+}
+
+bool use_list::erase(user* u) {
+  auto it = pos_.find(u);
+  if(it == pos_.end())
+    return false;
+  users_.erase(it->second.back());
+  it->second.pop_back();
+  if(it->second.empty())
+    pos_.erase(it);
+  return true;
+}
+
 //===----------------------------------------------------------------------===//
 //                               value class
 //===----------------------------------------------------------------------===//
@@ -21,11 +49,8 @@ void value::add_use(user *arg) {
   users_.push_back(arg);
 }
 
-value::users_t::iterator value::erase_use(user *arg){
-  auto it = std::find(users_.begin(), users_.end(), arg);
-  if(it == users_.end())
-    return it;
-  return users_.erase(it);
+bool value::erase_use(user *arg){
+  return users_.erase(arg);
 }
 
 // TODO: automatic naming scheme + update symbol table
@@ -34,9 +59,9 @@ void value::set_name(const std::string &name){
 }
 
 void value::replace_all_uses_with(value *target){
-  for (auto it = users_.begin(); it != users_.end(); ) {
-    it = (*it)->replace_uses_of_with(this, target);
-  }
+  // each call rewires all the operands of a user, and drops one of its uses
+  while(!users_.empty())
+    users_.front()->replace_uses_of_with(this, target);
 }
 
 
@@ -67,13 +92,13 @@ unsigned user::get_num_hidden() const {
   return num_hidden_;
 }
 
-value::users_t::iterator user::replace_uses_of_with(value *before, value *after) {
+void user::replace_uses_of_with(value *before, value *after) {
   for(size_t i = 0; i < ops_.size(); i++)
     if(ops_[i] == before){
       ops_[i] = after;
       after->add_use(this);
     }
-  return before->erase_use(this);
+  before->erase_use(this);
 }
 
 
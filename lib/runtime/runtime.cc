@@ -0,0 +1,218 @@
+#include "triton/runtime/runtime.h"
+#include "triton/driver/dispatch.h"
+#include "triton/driver/llvm.h"
+#include "triton/tools/sys/getenv.hpp"
+#include "triton/tools/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace triton{
+namespace runtime{
+
+namespace drv = triton::driver;
+
+/* ------------------------ */
+//         Loading          //
+/* ------------------------ */
+
+static uint64_t cu_get_function(uint64_t module, const std::string& name, size_t shared_mem, int64_t device,
+                                int carveout){
+  CUfunction fun;
+  drv::dispatch::cuModuleGetFunction(&fun, (CUmodule)module, name.c_str());
+  // split of the L1/shared memory of multiprocessors chosen by the compiler
+  if(carveout >= 0)
+    drv::dispatch::cuFuncSetAttribute(fun, CU_FUNC_ATTRIBUTE_PREFERRED_SHARED_MEMORY_CARVEOUT, carveout);
+  // set dynamic shared memory if necessary
+  int shared_optin;
+  drv::dispatch::cuDeviceGetAttribute(&shared_optin, CU_DEVICE_ATTRIBUTE_MAX_SHARED_MEMORY_PER_BLOCK_OPTIN, device);
+  if(shared_mem > 49152 && shared_optin > 49152){
+    if(carveout < 0)
+      drv::dispatch::cuFuncSetCacheConfig(fun, CU_FUNC_CACHE_PREFER_SHARED);
+    int shared_static;
+    drv::dispatch::cuFuncGetAttribute(&shared_static, CU_FUNC_ATTRIBUTE_SHARED_SIZE_BYTES, fun);
+    drv::dispatch::cuFuncSetAttribute(fun, CU_FUNC_ATTRIBUTE_MAX_DYNAMIC_SHARED_SIZE_BYTES, shared_optin - shared_static);
+  }
+  return (uint64_t)fun;
+}
+
+static uint64_t hip_get_function(uint64_t module, const std::string& name, size_t shared_mem, int64_t device){
+  hipFunction_t fun;
+  drv::dispatch::hipModuleGetFunction(&fun, (hipModule_t)module, name.c_str());
+  // kernels may use all the LDS of a workgroup (64 KB on CDNA GPUs) as dynamic shared memory
+  int shared_max;
+  drv::dispatch::hipDeviceGetAttribute(&shared_max, hipDeviceAttributeMaxSharedMemoryPerBlock, device);
+  if(shared_mem > 49152 && shared_max > 49152)
+    drv::dispatch::hipFuncSetAttribute(fun, hipFuncAttributeMaxDynamicSharedMemorySize, shared_max);
+  return (uint64_t)fun;
+}
+
+uint64_t load_module(backend_t backend, std::string_view image){
+  if(backend == CUDA){
+    CUmodule mod;
+    drv::dispatch::cuModuleLoadData(&mod, image.data());
+    return (uint64_t)mod;
+  }
+  if(backend == ROCM)
+    // HSA-CO -> hipModule
+    return (uint64_t)drv::amdgpu_to_hipmodule(std::string(image));
+  throw std::runtime_error("host kernels are loaded with load_binary");
+}
+
+uint64_t get_function(backend_t backend, uint64_t module, const std::string& name, size_t shared_mem, int64_t device,
+                      int carveout){
+  if(backend == CUDA)
+    return cu_get_function(module, name, shared_mem, device, carveout);
+  if(backend == ROCM)
+    return hip_get_function(module, name, shared_mem, device);
+  throw std::runtime_error("host kernels are loaded with load_binary");
+}
+
+static std::tuple<uint64_t, uint64_t> host_load_binary(const std::string& name, std::string_view llir){
+  drv::host_launch_t fun;
+  uint64_t mod = drv::host_load(std::string(llir), name, fun);
+  return std::make_tuple(mod, (uint64_t)fun);
+}
+
+std::tuple<uint64_t, uint64_t> load_binary(backend_t backend, const std::string& name, std::string_view image,
+                                           size_t shared_mem, int64_t device, int carveout){
+  if(backend == HOST)
+    return host_load_binary(name, image);
+  uint64_t module = load_module(backend, image);
+  return std::make_tuple(module, get_function(backend, module, name, shared_mem, device, carveout));
+}
+
+void unload_binary(backend_t backend, uint64_t module){
+  if(backend == CUDA)
+    drv::dispatch::cuModuleUnload((CUmodule)module);
+  if(backend == ROCM)
+    drv::dispatch::hipModuleUnload((hipModule_t)module);
+  // host modules live as long as their JIT
+}
+
+/* ------------------------ */
+//         Registry         //
+/* ------------------------ */
+
+void module_registry::clear(){
+  std::lock_guard<std::mutex> lock(mutex_);
+  for(auto& it: kernels_)
+    unload_binary(it.second.backend, it.second.module);
+  kernels_.clear();
+}
+
+const kernel_t* module_registry::find(const std::string& key, int64_t device){
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = kernels_.find({key, device});
+  return it == kernels_.end() ? nullptr : &it->second;
+}
+
+const kernel_t& module_registry::load(const std::string& key, int64_t device, backend_t backend, const std::string& name,
+                                      std::string_view image, size_t shared_mem, int num_threads){
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = kernels_.find({key, device});
+  if(it != kernels_.end())
+    return it->second;
+  uint64_t module, function;
+  std::tie(module, function) = load_binary(backend, name, image, shared_mem, device);
+  kernel_t& ret = kernels_[{key, device}];
+  ret = {backend, module, function, shared_mem, num_threads};
+  return ret;
+}
+
+size_t module_registry::size(){
+  std::lock_guard<std::mutex> lock(mutex_);
+  return kernels_.size();
+}
+
+/* ------------------------ */
+//         Launching        //
+/* ------------------------ */
+
+static void host_enqueue(uint64_t function, unsigned grid_0, unsigned grid_1, unsigned grid_2,
+                         const void* params){
+  // program instances are distributed over one worker per core (pinned to
+  // the NUMA nodes of the machine with TRITON_PIN_WORKERS=1), which claim
+  // contiguous chunks of program ids. The calling thread participates, so
+  // launches are synchronous
+  static size_t n_workers = std::max<unsigned>(1, std::thread::hardware_concurrency());
+  static ThreadPool pool(n_workers - 1, tools::getenv("TRITON_PIN_WORKERS") == "1");
+  drv::host_launch_t fn = (drv::host_launch_t)function;
+  char* args = (char*)params;
+  int64_t n_programs = (int64_t)grid_0*grid_1*grid_2;
+  pool.parallel_for(n_programs, [&](int64_t begin, int64_t end){
+    for(int64_t pid = begin; pid < end; pid++)
+      fn(args, pid % grid_0, (pid / grid_0) % grid_1, pid / (grid_0*grid_1),
+         grid_0, grid_1, grid_2);
+  })->wait();
+}
+
+void launch(backend_t backend, uint64_t function, uint64_t stream, unsigned grid_0, unsigned grid_1, unsigned grid_2,
+            unsigned block_0, unsigned block_1, unsigned block_2, const void* params, size_t params_size, size_t shared_mem){
+  if((uint64_t)grid_0*grid_1*grid_2 == 0)
+    return;
+  if(backend == HOST){
+    host_enqueue(function, grid_0, grid_1, grid_2, params);
+    return;
+  }
+  if(backend == CUDA){
+    void *config[] = {
+        CU_LAUNCH_PARAM_BUFFER_POINTER, (void*)params,
+        CU_LAUNCH_PARAM_BUFFER_SIZE,    &params_size,
+        CU_LAUNCH_PARAM_END
+    };
+    drv::dispatch::cuLaunchKernel((CUfunction)function, grid_0, grid_1, grid_2,
+                                  block_0, block_1, block_2,
+                                  shared_mem, (CUstream)stream, nullptr, config);
+    return;
+  }
+  void *config[] = {
+      HIP_LAUNCH_PARAM_BUFFER_POINTER, (void*)params,
+      HIP_LAUNCH_PARAM_BUFFER_SIZE,    &params_size,
+      HIP_LAUNCH_PARAM_END
+  };
+  drv::dispatch::hipModuleLaunchKernel((hipFunction_t)function, grid_0, grid_1, grid_2,
+                                       block_0, block_1, block_2,
+                                       shared_mem, (hipStream_t)stream, nullptr, config);
+}
+
+// allocation ranges seen so far, by base address
+static std::mutex ranges_mutex;
+static std::map<uint64_t, size_t> ranges;
+
+size_t pointer_range_size(uint64_t addr){
+  if(addr == 0)
+    return 0;
+  static const bool cached = tools::getenv("TRITON_CACHE_POINTER_RANGES") != "0";
+  if(cached){
+    std::lock_guard<std::mutex> lock(ranges_mutex);
+    auto it = ranges.upper_bound(addr);
+    if(it != ranges.begin() && addr < std::prev(it)->first + std::prev(it)->second)
+      return std::prev(it)->second;
+  }
+  CUdeviceptr base;
+  size_t size;
+  drv::dispatch::cuMemGetAddressRange_v2(&base, &size, (CUdeviceptr)addr);
+  if(cached){
+    std::lock_guard<std::mutex> lock(ranges_mutex);
+    // the ranges the new one overlaps have been freed
+    auto first = ranges.lower_bound(base);
+    if(first != ranges.begin() && std::prev(first)->first + std::prev(first)->second > base)
+      first = std::prev(first);
+    ranges.erase(first, ranges.lower_bound(base + size));
+    ranges[base] = size;
+  }
+  return size;
+}
+
+void clear_pointer_ranges(){
+  std::lock_guard<std::mutex> lock(ranges_mutex);
+  ranges.clear();
+}
+
+}
+}
@@ -0,0 +1,209 @@
+"""
+Roofline report of the operators of Triton and of their cuBLAS/CUTLASS/PyTorch
+counterparts. Every case is placed on the roofline of the current device, so that
+results compare across devices, and against per-architecture baselines
+(`baselines/sm<cc>.json`) so that regressions show up as deltas of the fraction of
+the speed of light they reach.
+
+    python bench/roofline.py                  # report, compared to the baselines
+    python bench/roofline.py --record         # (re)record the baselines of this device
+"""
+import argparse
+import json
+import os
+import sys
+
+import torch
+
+import triton
+import triton.language as tl
+from triton.testing import get_arch, roofline
+
+DTYPES = {'float16': torch.float16, 'bfloat16': torch.bfloat16, 'float32': torch.float32, 'int8': torch.int8}
+
+
+#######################
+# Cases
+#######################
+
+
+def matmul_cases(cc):
+    shapes = [
+        # square
+        (512, 512, 512), (1024, 1024, 1024), (2048, 2048, 2048), (4096, 4096, 4096), (8192, 8192, 8192),
+        # tall-skinny
+        (16, 4096, 4096), (16, 8192, 8192), (64, 4096, 4096), (64, 8192, 8192), (4096, 64, 4096),
+        # transformer training
+        (2048, 12288, 3072), (2048, 3072, 12288),
+    ]
+    dtypes = ['float16'] + (['bfloat16', 'float32', 'int8'] if cc >= 80 else [])
+    return [('matmul', (M, N, K), dtype) for M, N, K in shapes for dtype in dtypes]
+
+
+def bench_matmul(shape, dtype, provider, warmup, rep):
+    M, N, K = shape
+    dtype = DTYPES[dtype]
+    if dtype == torch.int8:
+        a = torch.randint(-128, 127, (M, K), dtype=dtype, device='cuda')
+        b = torch.randint(-128, 127, (N, K), dtype=dtype, device='cuda').t()
+    else:
+        a = torch.randn((M, K), dtype=dtype, device='cuda')
+        b = torch.randn((K, N), dtype=dtype, device='cuda')
+    fn = {'triton': lambda: triton.ops.matmul(a, b),
+          'cublas': lambda: torch.matmul(a, b),
+          'cutlass': lambda: triton.testing.cutlass_matmul(a, b)}[provider]
+    ms = triton.testing.do_bench(fn, warmup=warmup, rep=rep, percentiles=None)
+    nbytes = (M * K + K * N + M * N) * a.element_size()
+    return roofline(ms, flops=2. * M * N * K, nbytes=nbytes, dtype=dtype)
+
+
+def elementwise_cases(cc):
+    return [('add', (N,), 'float16') for N in [1024 * 256, 1024 * 1024, 1024 * 4096, 1024 * 16384, 1024 * 65536]]
+
+
+def bench_add(shape, dtype, provider, warmup, rep):
+    N, = shape
+    x = torch.randn(N, dtype=DTYPES[dtype], device='cuda')
+    y = torch.randn_like(x)
+    z = torch.empty_like(x)
+    fn = {'triton': lambda: _add[(triton.cdiv(N, 1024),)](x, y, z, N, BLOCK_SIZE=1024),
+          'torch': lambda: torch.add(x, y, out=z)}[provider]
+    ms = triton.testing.do_bench(fn, warmup=warmup, rep=rep, percentiles=None)
+    return roofline(ms, flops=N, nbytes=3 * N * x.element_size(), dtype=x.dtype, tensor_cores=False)
+
+
+def cross_entropy_cases(cc):
+    return [('cross_entropy', (4096, N), 'float16') for N in [1024, 4096, 16384, 32768]]
+
+
+def bench_cross_entropy(shape, dtype, provider, warmup, rep):
+    M, N = shape
+    x = torch.randn(M, N, dtype=DTYPES[dtype], device='cuda')
+    idx = torch.randint(0, N, (M,), device='cuda')
+    op = {'triton': triton.ops.cross_entropy,
+          'torch': torch.nn.CrossEntropyLoss(reduction='none')}[provider]
+    ms = triton.testing.do_bench(lambda: op(x, idx), warmup=warmup, rep=rep, percentiles=None)
+    # exp, sum and log of every element
+    return roofline(ms, flops=3 * M * N, nbytes=x.numel() * x.element_size(), dtype=x.dtype, tensor_cores=False)
+
+
+@triton.jit
+def _add(X, Y, Z, N, BLOCK_SIZE: tl.constexpr):
+    offsets = tl.program_id(0) * BLOCK_SIZE + tl.arange(0, BLOCK_SIZE)
+    mask = offsets < N
+    x = tl.load(X + offsets, mask=mask)
+    y = tl.load(Y + offsets, mask=mask)
+    tl.store(Z + offsets, x + y, mask=mask)
+
+
+# operator -> (cases, benchmark, providers)
+SUITE = {
+    'matmul': (matmul_cases, bench_matmul, ['triton', 'cublas', 'cutlass']),
+    'add': (elementwise_cases, bench_add, ['triton', 'torch']),
+    'cross_entropy': (cross_entropy_cases, bench_cross_entropy, ['triton', 'torch']),
+}
+
+
+#######################
+# Baselines
+#######################
+
+
+def case_key(op, shape, dtype, provider):
+    return f"{op}/{'x'.join(map(str, shape))}/{dtype}/{provider}"
+
+
+def load_baselines(path):
+    if not os.path.exists(path):
+        return {}
+    with open(path) as f:
+        return json.load(f)['results']
+
+
+def save_baselines(path, results):
+    os.makedirs(os.path.dirname(path) or '.', exist_ok=True)
+    device = torch.cuda.get_device_name()
+    results = {key: {'roofline_frac': r['roofline_frac'], 'tflops_frac': r['tflops_frac'], 'gbps_frac': r['gbps_frac']}
+               for key, r in sorted(results.items())}
+    with open(path, 'w') as f:
+        json.dump({'device': device, 'results': results}, f, indent=2)
+
+
+#######################
+# Report
+#######################
+
+
+def run(names='', providers=None, baselines_dir=None, record=False, tolerance=0.05, warmup=25, rep=100,
+        save_path=None):
+    """
+    Runs the cases of the operators whose name contains :code:`names`, prints one line per case
+    and returns the keys of the cases whose fraction of the speed of light dropped by more than
+    :code:`tolerance` (absolute) below the baseline of the architecture of the device.
+    """
+    arch = get_arch()
+    cc = int(arch[2:])
+    baselines_dir = baselines_dir or os.path.join(os.path.dirname(os.path.realpath(__file__)), 'baselines')
+    baseline_path = os.path.join(baselines_dir, f'{arch}.json')
+    baselines = {} if record else load_baselines(baseline_path)
+    results, regressions = {}, []
+    print(f'{torch.cuda.get_device_name()} ({arch}): {triton.testing.get_dram_gbps():.0f} GB/s DRAM')
+    print(f"{'case':<48}{'ms':>10}{'TFLOPS':>9}{'GB/s':>9}{'%TFLOPS':>9}{'%GB/s':>8}{'%SOL':>7}{'delta':>8}")
+    for op, (cases, bench, op_providers) in SUITE.items():
+        if names and names not in op:
+            continue
+        for _, shape, dtype in cases(cc):
+            for provider in op_providers:
+                if providers and provider not in providers:
+                    continue
+                key = case_key(op, shape, dtype, provider)
+                try:
+                    r = bench(shape, dtype, provider, warmup, rep)
+                except Exception as e:
+                    # providers without the case, e.g. CUTLASS without its library or
+                    # cuBLAS without int8 GEMMs in PyTorch
+                    print(f'{key:<48}{"skipped":>10} ({type(e).__name__})')
+                    continue
+                results[key] = r
+                delta = ''
+                if key in baselines:
+                    d = r['roofline_frac'] - baselines[key]['roofline_frac']
+                    delta = f'{d:+.1%}'
+                    if d < -tolerance:
+                        regressions.append(key)
+                        delta += ' !'
+                print(f"{key:<48}{r['ms']:>10.4f}{r['tflops']:>9.1f}{r['gbps']:>9.0f}"
+                      f"{r['tflops_frac']:>9.1%}{r['gbps_frac']:>8.1%}{r['roofline_frac']:>7.1%}{delta:>8}")
+    if save_path:
+        os.makedirs(save_path, exist_ok=True)
+        with open(os.path.join(save_path, f'roofline-{arch}.json'), 'w') as f:
+            json.dump(results, f, indent=2)
+    if record:
+        save_baselines(baseline_path, {**load_baselines(baseline_path), **results})
+        print(f'recorded {len(results)} baselines in {baseline_path}')
+    elif not baselines:
+        print(f'no baselines for {arch} in {baselines_dir}: record them with --record')
+    return regressions
+
+
+def main(args):
+    parser = argparse.ArgumentParser(description="Run the roofline benchmark suite.")
+    parser.add_argument("-n", "--names", type=str, default='', required=False)
+    parser.add_argument("-p", "--providers", type=str, nargs='*', default=None, required=False)
+    parser.add_argument("-b", "--baselines-dir", type=str, default=None, required=False)
+    parser.add_argument("-r", "--result-dir", type=str, default=None, required=False)
+    parser.add_argument("--record", action='store_true')
+    parser.add_argument("--tolerance", type=float, default=0.05, required=False)
+    args = parser.parse_args(args)
+    regressions = run(args.names, args.providers, args.baselines_dir, args.record, args.tolerance,
+                      save_path=args.result_dir)
+    if regressions:
+        print(f'{len(regressions)} regression(s) beyond {args.tolerance:.0%} of the speed of light:')
+        for key in regressions:
+            print(f'  {key}')
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -35,9 +35,13 @@ def main(args):
     parser = argparse.ArgumentParser(description="Run the benchmark suite.")
     parser.add_argument("-r", "--result-dir", type=str, default='results', required=False)
     parser.add_argument("-n", "--names", type=str, default='', required=False)
+    parser.add_argument("--roofline", action='store_true', help="also run the roofline suite (see roofline.py)")
     parser.set_defaults(feature=False)
     args = parser.parse_args(args)
     run_all(args.result_dir, args.names)
+    if args.roofline:
+        import roofline
+        roofline.run(args.names, save_path=args.result_dir)
 
 
 if __name__ == '__main__':
@@ -119,8 +119,7 @@ const Operation *autotune(int M, int N, int K,
   for (const Operation *op : operations) {
     auto fn = [&]() { run(M, N, K, lda, ldb, ldc, ldd, ptr_A, ptr_B, ptr_C, ptr_D,
                           alpha, beta, scalar_mode, op, stream); };
-    triton::driver::cu_stream tt_stream((CUstream)stream, false);
-    double ms = triton::tools::bench(fn, &tt_stream, 10, 25);
+    double ms = triton::tools::bench(fn, (CUstream)stream, 10, 25);
     if (ms < best_ms) {
       best_ms = ms;
       best = op;
@@ -1,119 +1,198 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
-#ifdef _OPENMP
-#include <omp.h>
-#endif
+#include "triton/tools/thread_pool.h"
 
-// row-major 3d tensor
-class tensor_3d {
+// row-major 2d tensor holding the layout of one head
+class tensor_2d {
 public:
-  tensor_3d(int size_0, int size_1, int size_2, int *data = nullptr) : data_(size_0 * size_1 * size_2, 0) {
+  tensor_2d(int size_0, int size_1, const int *data = nullptr) : data_(size_0 * size_1, 0), stride_0_(size_1) {
     if (data)
       std::copy(data, data + data_.size(), data_.begin());
-    stride_0_ = size_1 * size_2;
-    stride_1_ = size_2;
-    stride_2_ = 1;
   }
 
-  int &operator()(int i, int j, int k) {
-    return data_[i * stride_0_ + j * stride_1_ + k];
+  int &operator()(int i, int j) {
+    return data_[i * stride_0_ + j];
   }
 
 private:
   std::vector<int> data_;
   int stride_0_;
-  int stride_1_;
-  int stride_2_;
 };
 
-std::vector<int> segment_blocks(tensor_3d &layout, tensor_3d &idx, int max_width, int H, int M, int N) {
-  tensor_3d tmp(H, M, N);
-  std::vector<int> current(H, 0);
-  int num = 0;
-  std::vector<int> lut(H * M * N * 4);
-  for (size_t h = 0; h < H; h++) {
-    // surrounding indices
-    std::vector<int> ii_left(max_width, -1);
-    std::vector<std::vector<int>> ii_top(max_width, std::vector<int>(N, -1));
-    // start the dynamic programming algorithm
-    for (size_t m = 0; m < M; m++) {
-      for (size_t n = 0; n < N; n++) {
-        int v = layout(h, m, n);
-        if (v == 0)
-          continue;
-        int n_left = ii_left[max_width - 1];
-        int m_top = ii_top[max_width - 1][n];
-        int top = (m_top >= 0) ? tmp(h, m_top, n) : 0;
-        int left = (n_left >= 0) ? tmp(h, m, n_left) : 0;
-        int topleft = (m_top >= 0 && n_left >= 0) ? tmp(h, m_top, n_left) : 0;
-        int width = std::min(left, std::min(top, topleft)) + 1;
-        // reset width if blocks cannot be
-        // packed together (i.e., there's a 1 "in the middle")
-        for (int nn = n_left + 1; nn < n; nn++)
-          if (ii_top[max_width - 1][nn] > ii_top[max_width - 1][n])
-            width = 1;
-        tmp(h, m, n) = width;
-        // update n_left ring buffer
-        for (int k = 0; k < max_width - 1; k++)
-          ii_left[k] = ii_left[k + 1];
-        ii_left[max_width - 1] = n;
-        // update ii_top ring buffer
-        for (int k = 0; k < max_width - 1; k++)
-          ii_top[k][n] = ii_top[k + 1][n];
-        ii_top[max_width - 1][n] = m;
-        // block is too small -- skip
-        if (width != max_width)
-          continue;
-        // retained blocks are set to zeros
-        for (size_t km = 0; km < max_width; km++)
-          for (size_t kn = 0; kn < max_width; kn++) {
-            int mm = ii_top[km][n];
-            int nn = ii_left[kn];
-            if (mm < 0 || nn < 0)
-              continue;
-            layout(h, mm, nn) = 0;
-            tmp(h, mm, nn) = 0;
-            lut[num++] = (int)h;
-            lut[num++] = (int)mm;
-            lut[num++] = (int)nn;
-            lut[num++] = idx(h, mm, nn);
-          }
-      }
+// super-blocks of width `max_width` in head `h`, whose non-zero blocks
+// are numbered from `idx`; retained blocks are removed from `layout`
+std::vector<int> segment_blocks(tensor_2d &layout, tensor_2d &idx, int max_width, int h, int M, int N) {
+  tensor_2d tmp(M, N);
+  std::vector<int> lut;
+  // surrounding indices
+  std::vector<int> ii_left(max_width, -1);
+  std::vector<std::vector<int>> ii_top(max_width, std::vector<int>(N, -1));
+  // start the dynamic programming algorithm
+  for (int m = 0; m < M; m++) {
+    for (int n = 0; n < N; n++) {
+      int v = layout(m, n);
+      if (v == 0)
+        continue;
+      int n_left = ii_left[max_width - 1];
+      int m_top = ii_top[max_width - 1][n];
+      int top = (m_top >= 0) ? tmp(m_top, n) : 0;
+      int left = (n_left >= 0) ? tmp(m, n_left) : 0;
+      int topleft = (m_top >= 0 && n_left >= 0) ? tmp(m_top, n_left) : 0;
+      int width = std::min(left, std::min(top, topleft)) + 1;
+      // reset width if blocks cannot be
+      // packed together (i.e., there's a 1 "in the middle")
+      for (int nn = n_left + 1; nn < n; nn++)
+        if (ii_top[max_width - 1][nn] > ii_top[max_width - 1][n])
+          width = 1;
+      tmp(m, n) = width;
+      // update n_left ring buffer
+      for (int k = 0; k < max_width - 1; k++)
+        ii_left[k] = ii_left[k + 1];
+      ii_left[max_width - 1] = n;
+      // update ii_top ring buffer
+      for (int k = 0; k < max_width - 1; k++)
+        ii_top[k][n] = ii_top[k + 1][n];
+      ii_top[max_width - 1][n] = m;
+      // block is too small -- skip
+      if (width != max_width)
+        continue;
+      // retained blocks are set to zeros
+      for (int km = 0; km < max_width; km++)
+        for (int kn = 0; kn < max_width; kn++) {
+          int mm = ii_top[km][n];
+          int nn = ii_left[kn];
+          if (mm < 0 || nn < 0)
+            continue;
+          layout(mm, nn) = 0;
+          tmp(mm, nn) = 0;
+          lut.insert(lut.end(), {h, mm, nn, idx(mm, nn)});
+        }
     }
   }
-  lut.resize(num);
   return lut;
 }
 
-typedef std::pair<int, pybind11::array_t<int>> lut_t;
+// for each width: the concatenated lut of all heads, and the offsets
+// of the entries of each head in it (CSR-style)
+typedef std::vector<std::tuple<int, std::vector<int>, std::vector<int>>> luts_t;
+
+static luts_t compute_luts(const int *layout, int H, int M, int N, int start_width) {
+  std::vector<int> widths;
+  for (int max_width = start_width; max_width > 0; max_width /= 2)
+    widths.push_back(max_width);
+  // non-zero blocks are numbered in row-major order across heads
+  std::vector<int> offsets(H + 1, 0);
+  for (int h = 0; h < H; h++)
+    offsets[h + 1] = offsets[h] + (int)std::count_if(layout + (int64_t)h * M * N, layout + (int64_t)(h + 1) * M * N,
+                                                      [](int v) { return v != 0; });
+  // heads are independent, and are distributed over one worker per core;
+  // the calling thread participates
+  std::vector<std::vector<std::vector<int>>> head_luts(H);
+  auto work = [&](int64_t begin, int64_t end) {
+    for (int64_t h = begin; h < end; h++) {
+      tensor_2d head(M, N, layout + (int64_t)h * M * N);
+      tensor_2d idx(M, N);
+      int current = offsets[h];
+      for (int m = 0; m < M; m++)
+        for (int n = 0; n < N; n++)
+          if (head(m, n) != 0)
+            idx(m, n) = current++;
+      for (int max_width : widths)
+        head_luts[h].push_back(segment_blocks(head, idx, max_width, h, M, N));
+    }
+  };
+  static size_t n_workers = std::max<unsigned>(1, std::thread::hardware_concurrency());
+  static ThreadPool pool(n_workers - 1);
+  pool.parallel_for(H, work, 1)->wait();
+  // gather
+  luts_t ret;
+  for (size_t w = 0; w < widths.size(); w++) {
+    std::vector<int> lut;
+    std::vector<int> head_offsets(H + 1, 0);
+    for (int h = 0; h < H; h++) {
+      lut.insert(lut.end(), head_luts[h][w].begin(), head_luts[h][w].end());
+      head_offsets[h + 1] = lut.size() / 4;
+    }
+    if (lut.empty())
+      continue;
+    ret.emplace_back(widths[w], std::move(lut), std::move(head_offsets));
+  }
+  return ret;
+}
+
+// process-wide cache of luts, keyed by the hash of the layout and the parameters of the
+// decomposition. Entries keep their layout, so that colliding layouts are told apart
+typedef std::tuple<uint64_t, int, int, int, int> lut_key_t;
+struct lut_entry_t {
+  std::vector<int> layout;
+  std::shared_ptr<const luts_t> luts;
+};
+static std::mutex lut_cache_mutex;
+static std::map<lut_key_t, lut_entry_t> lut_cache;
+static const size_t lut_cache_max_size = 256;
+
+static uint64_t hash_layout(const int *layout, int64_t size) {
+  // FNV-1a
+  uint64_t ret = 14695981039346656037ull;
+  const unsigned char *bytes = (const unsigned char *)layout;
+  for (int64_t i = 0; i < size * (int64_t)sizeof(int); i++)
+    ret = (ret ^ bytes[i]) * 1099511628211ull;
+  return ret;
+}
+
+typedef std::tuple<int, pybind11::array_t<int>, pybind11::array_t<int>> lut_t;
 
 std::vector<lut_t> superblock(uintptr_t LAYOUT, int H, int M, int N, int start_width) {
+  const int *layout = (const int *)LAYOUT;
+  std::shared_ptr<const luts_t> luts;
+  {
+    pybind11::gil_scoped_release release;
+    int64_t size = (int64_t)H * M * N;
+    lut_key_t key(hash_layout(layout, size), H, M, N, start_width);
+    {
+      std::lock_guard<std::mutex> lock(lut_cache_mutex);
+      auto it = lut_cache.find(key);
+      if (it != lut_cache.end() && std::equal(layout, layout + size, it->second.layout.begin()))
+        luts = it->second.luts;
+    }
+    if (!luts) {
+      luts = std::make_shared<const luts_t>(compute_luts(layout, H, M, N, start_width));
+      std::lock_guard<std::mutex> lock(lut_cache_mutex);
+      if (lut_cache.size() >= lut_cache_max_size)
+        lut_cache.clear();
+      // a colliding layout replaces the entry of the previous one
+      lut_cache[key] = lut_entry_t{std::vector<int>(layout, layout + size), luts};
+    }
+  }
   std::vector<lut_t> ret;
-  int current = 0;
-  tensor_3d layout(H, M, N, (int *)LAYOUT);
-  tensor_3d idx(H, M, N);
-  for (int64_t h = 0; h < H; h++)
-    for (int64_t m = 0; m < M; m++)
-      for (int64_t n = 0; n < N; n++) {
-        if (layout(h, m, n) == 0)
-          continue;
-        idx(h, m, n) = current++;
-      }
-  // create lut
-  for (int max_width = start_width; max_width > 0; max_width /= 2) {
-    auto lut = segment_blocks(layout, idx, max_width, H, M, N);
-    if (lut.size() == 0)
-      continue;
-    ret.push_back(std::make_pair(max_width, pybind11::array_t<int>(lut.size(), lut.data())));
+  for (const auto &lut : *luts) {
+    const std::vector<int> &data = std::get<1>(lut);
+    const std::vector<int> &offsets = std::get<2>(lut);
+    ret.emplace_back(std::get<0>(lut), pybind11::array_t<int>(data.size(), data.data()),
+                     pybind11::array_t<int>(offsets.size(), offsets.data()));
   }
   return ret;
 }
 
+void superblock_cache_clear() {
+  std::lock_guard<std::mutex> lock(lut_cache_mutex);
+  lut_cache.clear();
+}
+
 void init_superblocking(pybind11::module &m) {
-  m.def("superblock", &superblock, "super-blocking for block-sparse matrix multiplication");
-}
\ No newline at end of file
+  m.def("superblock", &superblock,
+        "super-blocking for block-sparse matrix multiplication. Returns, for each width, "
+        "the (head, row, col, idx) entries of its super-blocks and the offsets of each head in them");
+  m.def("superblock_cache_clear", &superblock_cache_clear, "drops the luts cached by superblock");
+}
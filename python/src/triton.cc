@@ -2,11 +2,17 @@
 #include "triton/codegen/target.h"
 #include "triton/driver/error.h"
 #include "triton/driver/llvm.h"
+#include "triton/ir/bitcode.h"
 #include "triton/ir/builder.h"
 #include "triton/ir/enums.h"
 #include "triton/ir/function.h"
 #include "triton/ir/module.h"
 #include "triton/ir/print.h"
+#include "triton/runtime/runtime.h"
+#include "triton/tools/sys/getenv.hpp"
+#include "triton/tools/thread_pool.h"
+#include <chrono>
+#include <deque>
 #include <optional>
 #include <pybind11/buffer_info.h>
 #include <pybind11/functional.h>
@@ -18,6 +24,8 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include "llvm/IR/Module.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Verifier.h"
@@ -25,6 +33,7 @@
 namespace py = pybind11;
 namespace ir = triton::ir;
 namespace drv = triton::driver;
+namespace rt = triton::runtime;
 
 
 /*****************************************************************************/
@@ -45,11 +54,40 @@ int hipGetInfo(hipDevice_t device) {
   return res;
 }
 
-enum backend_t {
-  HOST,
-  CUDA,
-  ROCM,
-};
+using rt::backend_t;
+using rt::HOST;
+using rt::CUDA;
+using rt::ROCM;
+
+// GCN architecture of an AMD `device`, with its target features (e.g., "gfx90a:sramecc+:xnack-").
+// Queried once per device
+const std::string& hip_arch(int64_t device) {
+  static std::mutex mutex;
+  static std::map<int64_t, std::string> archs;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = archs.find(device);
+  if(it != archs.end())
+    return it->second;
+  hipDeviceProp_t prop;
+  drv::dispatch::hipGetDeviceProperties(&prop, device);
+  return archs[device] = prop.gcnArchName;
+}
+
+// Compute capability of `device`, as it appears in the keys of binaries (e.g., "8-0"),
+// or its GCN architecture on AMD GPUs. Queried once per device
+const std::string& device_arch(int64_t device) {
+  static std::mutex mutex;
+  static std::map<int64_t, std::string> archs;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = archs.find(device);
+  if(it != archs.end())
+    return it->second;
+  if(!drv::dispatch::cuinit())
+    return archs[device] = hip_arch(device);
+  int major = cuGetInfo<CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MAJOR>(device);
+  int minor = cuGetInfo<CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MINOR>(device);
+  return archs[device] = std::to_string(major) + "-" + std::to_string(minor);
+}
 
 void cu_enable_peer_access(uint64_t peer_ptr){
   CUcontext context;
@@ -59,48 +97,19 @@ void cu_enable_peer_access(uint64_t peer_ptr){
   } catch (drv::exception::cuda::peer_access_already_enabled) {}
 }
 
-void host_enqueue(uint64_t stream, uint64_t kernel,
-                  uint64_t grid_0, uint64_t grid_1, uint64_t grid_2,
-                  uint64_t block_0, uint64_t block_1, uint64_t block_2,
-                  void* args_ptr, size_t args_size, int64_t shared_mem){
-  throw std::runtime_error("unsupported");
-// auto hst = kernel->module()->hst();
-// hst_->futures->reserve(hst_->futures->size() + grid[0]*grid[1]*grid[2]);
-// char* params = new char[args_size];
-// std::memcpy((void*)params, (void*)args, args_size);
-// for(size_t i = 0; i < grid[0]; i++)
-//   for(size_t j = 0; j < grid[1]; j++)
-//     for(size_t k = 0; k < grid[2]; k++)
-//       hst_->futures->emplace_back(hst_->pool->enqueue(hst->fn, (char**)params, int32_t(i), int32_t(j), int32_t(k)));
-}
-
-void cu_enqueue(uint64_t stream, uint64_t kernel,
-                uint64_t grid_0, uint64_t grid_1, uint64_t grid_2,
-                uint64_t block_0, uint64_t block_1, uint64_t block_2,
-                void* args_ptr, size_t args_size, int64_t shared_mem){
-  void *config[] = {
-      CU_LAUNCH_PARAM_BUFFER_POINTER, (void*)args_ptr,
-      CU_LAUNCH_PARAM_BUFFER_SIZE,    &args_size,
-      CU_LAUNCH_PARAM_END
-  };
-  drv::dispatch::cuLaunchKernel((CUfunction)kernel, grid_0, grid_1, grid_2, 
-                                block_0, block_1, block_2, 
-                                shared_mem, (CUstream)stream, nullptr, config);
-}
-
-void hip_enqueue(uint64_t stream, uint64_t kernel,
-                uint64_t grid_0, uint64_t grid_1, uint64_t grid_2,
-                uint64_t block_0, uint64_t block_1, uint64_t block_2,
-                void* args_ptr, size_t args_size, int64_t shared_mem) {
-  void *config[] = {
-      HIP_LAUNCH_PARAM_BUFFER_POINTER, (void*)args_ptr,
-      HIP_LAUNCH_PARAM_BUFFER_SIZE,    &args_size,
-      HIP_LAUNCH_PARAM_END
-  };
-  drv::dispatch::hipModuleLaunchKernel((hipFunction_t)kernel, grid_0, grid_1, grid_2, 
-                                block_0, block_1, block_2, 
-                                shared_mem, (hipStream_t)stream, nullptr, config);
+// NVML handle of a CUDA device, found through its PCI bus id so that
+// device numbers follow CUDA_VISIBLE_DEVICES
+void nvml_check(nvmlReturn_t res, const std::string& what) {
+  if(res != NVML_SUCCESS)
+    throw std::runtime_error(what + ": " + drv::dispatch::nvmlErrorString(res));
+}
 
+nvmlDevice_t nvml_device(uint64_t device) {
+  char bus_id[32];
+  drv::dispatch::cuDeviceGetPCIBusId(bus_id, sizeof(bus_id), (CUdevice)device);
+  nvmlDevice_t ret;
+  nvml_check(drv::dispatch::nvmlDeviceGetHandleByPciBusId_v2(bus_id, &ret), "cannot find the NVML device");
+  return ret;
 }
 
 long pow2_divisor(long N){
@@ -129,135 +138,872 @@ std::string dtype_cache_key_part(const py::object& dtype) {
   }
 }
 
-size_t get_pointer_range_size(uint64_t addr){
-  if(addr == 0)
-    return 0;
-  size_t size;
-  drv::dispatch::cuPointerGetAttribute(&size, CU_POINTER_ATTRIBUTE_RANGE_SIZE, (CUdeviceptr)addr);
-  return size;
+// Launch
+
+// Each argument is specialized according to a 64-bit code:
+// bits [0, 4) hold the kind of the argument, bits [4, 8) the base-2 log of
+// the power-of-two divisibility of integers and pointers (or `unspecialized`),
+// and bits [8, 64) a kind-specific payload: the interned dtype of tensors and
+// the hash of constexpr values.
+enum arg_kind_t : uint64_t {
+  ARG_NONE,
+  ARG_ONE,
+  ARG_INT32,
+  ARG_UINT32,
+  ARG_INT64,
+  ARG_UINT64,
+  ARG_FLOAT32,
+  ARG_BOOL,
+  ARG_TENSOR,
+  ARG_CONSTEXPR
+};
+
+const uint64_t unspecialized = 0xF;
+
+inline uint64_t make_arg_code(arg_kind_t kind, uint64_t log2_div = 0, uint64_t payload = 0) {
+  return kind | (log2_div << 4) | (payload << 8);
+}
+inline arg_kind_t arg_code_kind(uint64_t code) { return (arg_kind_t)(code & 0xF); }
+inline uint64_t arg_code_log2_div(uint64_t code) { return (code >> 4) & 0xF; }
+inline uint64_t arg_code_payload(uint64_t code) { return code >> 8; }
+// the payload of tensors is their interned dtype, and whether they alias no other tensor
+inline uint64_t tensor_payload(uint64_t dtype, bool noalias) { return (dtype << 1) | noalias; }
+inline uint64_t tensor_dtype(uint64_t code) { return arg_code_payload(code) >> 1; }
+inline bool tensor_noalias(uint64_t code) { return arg_code_payload(code) & 1; }
+
+inline uint64_t log2_pow2_divisor(long N){
+  uint64_t ret = 0;
+  for(long div = pow2_divisor(N); div > 1; div >>= 1)
+    ret++;
+  return ret;
 }
 
-// Launch
-void parse_args(py::list& args, py::list do_not_specialize, const std::string& func_key, py::list& arg_names,
-                std::string& cache_key, std::string& params, size_t& params_size, py::dict constants,
-                int num_warps, int num_stages) {
-    size_t len = PyList_Size(args.ptr());
-    params.reserve(8*len); // 8 max bytes by argument
-    char* params_ptr = &params[0];
-    cache_key = func_key;
-    cache_key += "-" + std::to_string(num_warps);
-    cache_key += "-" + std::to_string(num_stages);
-    cache_key += "-";
-    for(int i = 0; i < len; i++){
-      cache_key += "_";
-      py::int_ py_i = py::int_(i);
-      bool specialize = !do_not_specialize.contains(py_i);
-      py::object arg = args[i];
-      auto arg_ptr = arg.ptr();
+inline uint64_t hash_combine(uint64_t seed, uint64_t v){
+  return seed ^ (v + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+// dtypes are interned on first use so that tensor arguments are
+// specialized by id. References are kept so that ids are never recycled
+struct dtype_table {
+  std::map<PyObject*, uint64_t> ids;
+  std::vector<std::string> names;
+};
+
+dtype_table& interned_dtypes() {
+  static dtype_table ret;
+  return ret;
+}
+
+uint64_t intern_dtype(PyObject* dtype) {
+  dtype_table& table = interned_dtypes();
+  auto it = table.ids.find(dtype);
+  if(it != table.ids.end())
+    return it->second;
+  table.names.push_back(dtype_cache_key_part(py::reinterpret_borrow<py::object>(dtype)));
+  Py_INCREF(dtype);
+  return table.ids.emplace(dtype, table.names.size() - 1).first->second;
+}
+
+const std::string& interned_dtype_name(uint64_t id) {
+  return interned_dtypes().names.at(id);
+}
+
+// Storage for the parsed arguments of a launch. Buffers are reused
+// across launches so that steady-state launches do not allocate. Hidden, like
+// the pybind11 types of its fields
+struct __attribute__((visibility("hidden"))) launch_buffers {
+  std::vector<uint64_t> codes;
+  std::vector<py::object> constexprs;
+  rt::arg_packer params;
+  std::vector<std::pair<size_t, long>> storages;
+
+  void clear() {
+    codes.clear();
+    constexprs.clear();
+    params.clear();
+    storages.clear();
+  }
+};
+
+// How the arguments of a kernel are parsed. Whether each argument is specialized is
+// computed on the first launch, and the kind of each argument is recorded along with its
+// Python type, so that launches with arguments of the same types as the previous ones
+// neither look attributes up nor search `do_not_specialize` and `strides` to parse them
+class __attribute__((visibility("hidden"))) arg_parser {
+public:
+  enum kind_t : uint8_t { INT, FLOAT, BOOL, TENSOR, CONSTEXPR, NONE };
+  struct slot {
+    py::object type;
+    kind_t kind;
+    bool specialize;
+    bool is_stride;
+  };
+
+public:
+  slot& get(size_t i, PyObject* arg) {
+    slot& ret = slots_[i];
+    if((PyObject*)Py_TYPE(arg) != ret.type.ptr()){
+      ret.kind = classify(arg, i);
+      // the type is kept alive, so that it cannot be confused with another one at its address
+      ret.type = py::reinterpret_borrow<py::object>((PyObject*)Py_TYPE(arg));
+    }
+    return ret;
+  }
+
+  void init(size_t n_args, py::list& do_not_specialize, py::list& strides) {
+    if(slots_.size() == n_args)
+      return;
+    slots_.assign(n_args, slot());
+    for(size_t i = 0; i < n_args; i++){
+      slots_[i].specialize = !do_not_specialize.contains(py::int_(i));
+      slots_[i].is_stride = slots_[i].specialize && strides.contains(py::int_(i));
+    }
+  }
+
+private:
+  static kind_t classify(PyObject* arg, size_t i) {
+    if(PyLong_Check(arg))
+      return INT;
+    if(PyFloat_Check(arg))
+      return FLOAT;
+    if(PyBool_Check(arg))
+      return BOOL;
+    if(arg == Py_None)
+      return NONE;
+    py::handle h(arg);
+    if(py::hasattr(h, "data_ptr"))
+      return TENSOR;
+    if(py::hasattr(h, "value"))
+      return CONSTEXPR;
+    std::string ty_str = h.attr("__class__").attr("__name__").cast<std::string>();
+    std::string err_msg = "Received type '" + ty_str + "' for argument " + std::to_string(i) + "."
+                          + " Only int, float, bool, torch.Tensor, and triton.language.constexpr are supported.";
+    throw std::runtime_error(err_msg);
+  }
+
+private:
+  std::vector<slot> slots_;
+};
+
+// calls method `name` of `obj` without arguments, with `name` interned once
+inline py::object call_method(PyObject* obj, const char* name, PyObject*& interned) {
+  if(!interned)
+    interned = PyUnicode_InternFromString(name);
+  PyObject* ret = PyObject_CallMethodObjArgs(obj, interned, nullptr);
+  if(!ret)
+    throw py::error_already_set();
+  return py::reinterpret_steal<py::object>(ret);
+}
+
+inline py::object get_attr(PyObject* obj, const char* name, PyObject*& interned) {
+  if(!interned)
+    interned = PyUnicode_InternFromString(name);
+  PyObject* ret = PyObject_GetAttr(obj, interned);
+  if(!ret)
+    throw py::error_already_set();
+  return py::reinterpret_steal<py::object>(ret);
+}
 
+// Parses `args` into argument codes, constexpr values and packed kernel parameters.
+// Integers in `strides` are only specialized on being 1 and on being multiples of 16.
+// Host pointers have no known allocation range
+void parse_args(py::list& args, arg_parser& parser, launch_buffers& buffers, bool host) {
+    static PyObject *s_data_ptr, *s_dtype, *s_storage_offset, *s_element_size, *s_value;
+    size_t len = PyList_GET_SIZE(args.ptr());
+    std::vector<uint64_t>& codes = buffers.codes;
+    rt::arg_packer& params = buffers.params;
+    buffers.clear();
+    params.reserve(len);
+    // (index in `codes`, start of storage) of tensor arguments
+    std::vector<std::pair<size_t, long>>& storages = buffers.storages;
+    for(size_t i = 0; i < len; i++){
+      PyObject* arg_ptr = PyList_GET_ITEM(args.ptr(), i);
+      const arg_parser::slot& slot = parser.get(i, arg_ptr);
+      bool specialize = slot.specialize;
+      bool is_stride = slot.is_stride;
+      switch(slot.kind){
       // argument is `long`
-      if(PyLong_Check(arg_ptr)){
+      case arg_parser::INT: {
         int overflow;
         long long value = PyLong_AsLongLongAndOverflow(arg_ptr, &overflow);
         // values equal to 1 are specialized
         if(specialize && (value == 1)){
-          cache_key += "1";
-          continue;
+          codes.push_back(make_arg_code(ARG_ONE));
+          break;
         }
         // int32, uint32, int64, and uint64 have different kernels
+        arg_kind_t kind;
         if (!overflow && -0x8000'0000LL <= value && value <= 0x7FFF'FFFFLL) {
-          cache_key += "int32";
-          params_ptr = (char*)(((uintptr_t)params_ptr + 3) & (-4));
-          std::memcpy(params_ptr, &value, 4);
-          params_ptr += 4;
+          kind = ARG_INT32;
+          params.add_int32(value);
         } else if (!overflow && 0x8000'0000LL <= value && value <= 0xFFFF'FFFFLL) {
-          cache_key += "uint32";
-          params_ptr = (char*)(((uintptr_t)params_ptr + 3) & (-4));
-          std::memcpy(params_ptr, &value, 4);
-          params_ptr += 4;
+          kind = ARG_UINT32;
+          params.add_uint32(value);
         } else if (!overflow) {
-          cache_key += "int64";
-          params_ptr = (char*)(((uintptr_t)params_ptr + 7) & (-8));
-          std::memcpy(params_ptr, &value, 8);
-          params_ptr += 8;
+          kind = ARG_INT64;
+          params.add_int64(value);
         } else {
           if (PyErr_Occurred()) {
             throw std::logic_error("An error occurred?");
           }
           unsigned long long unsigned_value = PyLong_AsUnsignedLongLong(arg_ptr);
           if (PyErr_Occurred()) {
-            throw std::runtime_error("integer overflow in argument: " + std::string(py::str(arg)));
+            throw std::runtime_error("integer overflow in argument: " + std::string(py::str(py::handle(arg_ptr))));
           }
-          cache_key += "uint64";
-          params_ptr = (char*)(((uintptr_t)params_ptr + 7) & (-8));
-          std::memcpy(params_ptr, &unsigned_value, 8);
-          params_ptr += 8;
+          kind = ARG_UINT64;
+          params.add_uint64(unsigned_value);
+          value = (long long)unsigned_value;
         }
-        if(!specialize)
-          continue;
         // values divisible by small powers of 2 are specialized
-        cache_key += "[multipleof(";
-        cache_key += std::to_string(pow2_divisor(value));
-        cache_key += ")]";
-        continue;
+        uint64_t log2_div = !specialize ? unspecialized :
+                            is_stride   ? (value % 16 == 0 ? 4 : 0) : log2_pow2_divisor(value);
+        codes.push_back(make_arg_code(kind, log2_div));
+        break;
       }
       // argument is `float`
-      if(PyFloat_Check(arg_ptr)){
-        cache_key += "float32";
+      case arg_parser::FLOAT: {
         float value = PyFloat_AsDouble(arg_ptr);
-        params_ptr = (char*)(((uintptr_t)params_ptr + 3) & (-4));
-        std::memcpy(params_ptr, &value, 4);
-        params_ptr += 4;
-        continue;
+        params.add_float(value);
+        codes.push_back(make_arg_code(ARG_FLOAT32));
+        break;
       }
       // argument is `bool`
-      if(PyBool_Check(arg_ptr)){
-        cache_key += "bool";
+      case arg_parser::BOOL: {
         bool value =  arg_ptr == Py_True ? true : false;
-        std::memcpy(params_ptr, &value, 1);
-        params_ptr += 1;
-        continue;
+        params.add_bool(value);
+        codes.push_back(make_arg_code(ARG_BOOL));
+        break;
       }
       // argument is tensor
-      if(py::hasattr(arg, "data_ptr")){
-        py::object data_ptr = arg.attr("data_ptr")();
-        long value = data_ptr.cast<long>();
-        params_ptr = (char*)(((uintptr_t)params_ptr + 7) & (-8));
-        // copy param
-        std::memcpy(params_ptr, &value, 8);
-        params_ptr += 8;
-        // udpate cache key
-        cache_key += dtype_cache_key_part(arg.attr("dtype"));
-        cache_key += "*";
-        cache_key += "[multipleof(";
-        size_t range_size = get_pointer_range_size(value);
-        cache_key += std::to_string(std::min(pow2_divisor(value), pow2_divisor(range_size)));
-        cache_key += ")]";
-        continue;
+      case arg_parser::TENSOR: {
+        long value = PyLong_AsLong(call_method(arg_ptr, "data_ptr", s_data_ptr).ptr());
+        params.add_pointer(value);
+        // specialize on dtype and alignment
+        size_t range_size = host ? 0 : rt::pointer_range_size(value);
+        uint64_t log2_div = std::min(log2_pow2_divisor(value), log2_pow2_divisor(range_size));
+        py::object dtype = get_attr(arg_ptr, "dtype", s_dtype);
+        // tensors that do not share a storage do not alias. The storage of
+        // objects without `storage_offset` is unknown
+        long storage = value;
+        if(!s_storage_offset)
+          s_storage_offset = PyUnicode_InternFromString("storage_offset");
+        PyObject* offset = PyObject_CallMethodObjArgs(arg_ptr, s_storage_offset, nullptr);
+        if(!offset){
+          PyErr_Clear();
+          storage = 0;
+        }
+        else{
+          long n_offset = PyLong_AsLong(offset);
+          Py_DECREF(offset);
+          if(n_offset != 0)
+            storage -= n_offset * PyLong_AsLong(call_method(arg_ptr, "element_size", s_element_size).ptr());
+        }
+        storages.push_back({codes.size(), storage});
+        codes.push_back(make_arg_code(ARG_TENSOR, log2_div, tensor_payload(intern_dtype(dtype.ptr()), false)));
+        break;
       }
       // argument is `constexpr`
-      if(py::hasattr(arg, "value")){
-        py::object value = arg.attr("value");
-        py::object name = arg_names[i];
-        constants[name] = value;
-        py::object repr = py::repr(value);
-        const char* start = (const char*)PyUnicode_1BYTE_DATA(repr.ptr());
-        size_t len = PyUnicode_GET_LENGTH(repr.ptr());
-        cache_key += std::string(start, len);
-        continue;
+      case arg_parser::CONSTEXPR: {
+        py::object value = get_attr(arg_ptr, "value", s_value);
+        Py_hash_t hash = PyObject_Hash(value.ptr());
+        if(hash == -1)
+          PyErr_Clear();
+        uint64_t payload = hash_combine((uint64_t)hash, (uint64_t)Py_TYPE(value.ptr())) >> 8;
+        codes.push_back(make_arg_code(ARG_CONSTEXPR, 0, payload));
+        buffers.constexprs.push_back(value);
+        break;
+      }
+      case arg_parser::NONE:
+        codes.push_back(make_arg_code(ARG_NONE));
+        break;
+      }
+    }
+  for(size_t i = 0; i < storages.size(); i++){
+    bool noalias = !host && storages[i].second != 0;
+    for(size_t j = 0; j < storages.size() && noalias; j++)
+      noalias = i == j || (storages[j].second != 0 && storages[j].second != storages[i].second);
+    if(noalias)
+      codes[storages[i].first] |= make_arg_code(ARG_NONE, 0, 1);
+  }
+}
+
+// Human-readable cache key, used for persistent caching and cache hooks.
+// Only built when a binary is not found in the launch cache
+std::string cache_key_str(const launch_buffers& buffers, const std::string& func_key, int num_warps, int num_stages) {
+  std::string cache_key = func_key;
+  cache_key += "-" + std::to_string(num_warps);
+  cache_key += "-" + std::to_string(num_stages);
+  cache_key += "-";
+  size_t constexpr_idx = 0;
+  for(uint64_t code: buffers.codes){
+    cache_key += "_";
+    arg_kind_t kind = arg_code_kind(code);
+    uint64_t log2_div = arg_code_log2_div(code);
+    std::string divisibility = "[multipleof(" + std::to_string(1 << log2_div) + ")]";
+    switch(kind){
+      case ARG_NONE: cache_key += "None"; break;
+      case ARG_ONE: cache_key += "1"; break;
+      case ARG_INT32: cache_key += "int32"; break;
+      case ARG_UINT32: cache_key += "uint32"; break;
+      case ARG_INT64: cache_key += "int64"; break;
+      case ARG_UINT64: cache_key += "uint64"; break;
+      case ARG_FLOAT32: cache_key += "float32"; break;
+      case ARG_BOOL: cache_key += "bool"; break;
+      case ARG_TENSOR:
+        cache_key += interned_dtype_name(tensor_dtype(code)) + "*" + divisibility;
+        if(tensor_noalias(code))
+          cache_key += "[noalias]";
+        break;
+      case ARG_CONSTEXPR: {
+        py::object repr = py::repr(buffers.constexprs[constexpr_idx++]);
+        cache_key += repr.cast<std::string>();
+        break;
+      }
+    }
+    bool is_int = kind >= ARG_INT32 && kind <= ARG_UINT64;
+    if(is_int && log2_div != unspecialized)
+      cache_key += divisibility;
+  }
+  return cache_key;
+}
+
+// Compile-time constants passed to grid functions
+py::dict get_constants(const launch_buffers& buffers, py::list& arg_names) {
+  py::dict constants;
+  size_t constexpr_idx = 0;
+  for(size_t i = 0; i < buffers.codes.size(); i++)
+    if(arg_code_kind(buffers.codes[i]) == ARG_CONSTEXPR)
+      constants[arg_names[i]] = buffers.constexprs[constexpr_idx++];
+  return constants;
+}
+
+// Tensor maps of the TMA copies of a kernel (see `generator::init_tma`), which are
+// encoded from the packed parameters of each launch and appended to them
+struct tensor_map_spec {
+  // constant `value`, or parameter of `bytes` bytes at `offset` in the packed parameters
+  struct operand {
+    int64_t value;
+    size_t offset;
+    size_t bytes;
+  };
+  operand base;
+  uint32_t elt_bytes;
+  uint32_t swizzle;
+  // of the contiguous dimension first
+  cuuint32_t box[2];
+  operand shape[2];
+  // of the other dimension, in elements
+  operand stride;
+};
+
+std::vector<tensor_map_spec> parse_tensor_maps(const std::string& text) {
+  auto operand = [&](const std::string& str) {
+    tensor_map_spec::operand ret = {0, 0, 0};
+    size_t colon = str.find(':');
+    if(str.size() > 1 && str[0] == 'c')
+      ret.value = std::stoll(str.substr(1));
+    else if(str.size() > 1 && str[0] == 'p' && colon != std::string::npos){
+      ret.offset = std::stoull(str.substr(1, colon - 1));
+      ret.bytes = std::stoull(str.substr(colon + 1));
+    }
+    else
+      throw std::runtime_error("invalid operand of tensor map: " + str);
+    return ret;
+  };
+  std::vector<tensor_map_spec> ret;
+  std::istringstream lines(text);
+  std::string line;
+  while(std::getline(lines, line)){
+    if(line.empty())
+      continue;
+    std::istringstream fields(line);
+    std::string base, shape_0, shape_1, stride;
+    tensor_map_spec spec;
+    fields >> base >> spec.elt_bytes >> spec.swizzle >> spec.box[0] >> spec.box[1] >> shape_0 >> shape_1 >> stride;
+    if(fields.fail())
+      throw std::runtime_error("invalid tensor map: " + line);
+    spec.base = operand(base);
+    spec.shape[0] = operand(shape_0);
+    spec.shape[1] = operand(shape_1);
+    spec.stride = operand(stride);
+    ret.push_back(spec);
+  }
+  return ret;
+}
+
+int64_t tensor_map_operand(const tensor_map_spec::operand& op, const rt::arg_packer& params) {
+  if(op.bytes == 0)
+    return op.value;
+  if(op.offset + op.bytes > params.size() || (op.bytes != 4 && op.bytes != 8))
+    throw std::runtime_error("operand of tensor map out of the parameters of the kernel");
+  if(op.bytes == 4){
+    int32_t ret;
+    std::memcpy(&ret, params.data() + op.offset, 4);
+    return ret;
+  }
+  int64_t ret;
+  std::memcpy(&ret, params.data() + op.offset, 8);
+  return ret;
+}
+
+// Tensor maps are read by kernels from global memory. Each distinct one is copied once per
+// device, to a slot of a slab that is never freed, as launches still running and launch
+// graphs that recorded it may read it at any later time
+class tensor_map_pool {
+public:
+  static tensor_map_pool& get() {
+    static tensor_map_pool ret;
+    return ret;
+  }
+
+  // device address of a copy of `map`, made on `stream`, or synchronously while launches
+  // are recorded into a graph, which may be replayed on any stream
+  uint64_t address(const CUtensorMap& map, int64_t device, uint64_t stream, bool sync) {
+    std::pair<int64_t, std::string> key = {device, std::string((const char*)&map, sizeof(map))};
+    auto it = slots_.find(key);
+    if(it != slots_.end())
+      return it->second;
+    slab& current = slabs_[device];
+    if(current.used == slab_size){
+      drv::dispatch::cuMemAlloc_v2(&current.base, slab_size*sizeof(CUtensorMap));
+      current.used = 0;
+    }
+    CUdeviceptr ret = current.base + current.used++*sizeof(CUtensorMap);
+    if(sync)
+      drv::dispatch::cuMemcpyHtoD_v2(ret, &map, sizeof(map));
+    else
+      drv::dispatch::cuMemcpyHtoDAsync_v2(ret, &map, sizeof(map), (CUstream)stream);
+    slots_.emplace(key, ret);
+    return ret;
+  }
+
+private:
+  static constexpr size_t slab_size = 512;
+  struct slab {
+    CUdeviceptr base = 0;
+    size_t used = slab_size;
+  };
+  std::map<int64_t, slab> slabs_;
+  std::map<std::pair<int64_t, std::string>, uint64_t> slots_;
+};
+
+// appends the tensor maps of the TMA copies of a kernel to its parameters. Tensors with
+// no element are described as one zero, which all the elements of tiles are out of
+void add_tensor_maps(const std::vector<tensor_map_spec>& tensor_maps, rt::arg_packer& params,
+                     int64_t device, uint64_t stream, bool sync) {
+  static const CUtensorMap zeros = {};
+  const CUtensorMapDataType dtypes[] = {CU_TENSOR_MAP_DATA_TYPE_UINT8, CU_TENSOR_MAP_DATA_TYPE_UINT16,
+                                        CU_TENSOR_MAP_DATA_TYPE_UINT32, CU_TENSOR_MAP_DATA_TYPE_UINT64};
+  tensor_map_pool& pool = tensor_map_pool::get();
+  std::vector<uint64_t> addresses;
+  for(const tensor_map_spec& spec: tensor_maps){
+    int64_t base = tensor_map_operand(spec.base, params);
+    int64_t shape_0 = tensor_map_operand(spec.shape[0], params);
+    int64_t shape_1 = tensor_map_operand(spec.shape[1], params);
+    int64_t stride = tensor_map_operand(spec.stride, params);
+    if(shape_0 < 0 || shape_1 < 0 || stride <= 0)
+      throw std::runtime_error("TMA copies need non-negative shapes and positive strides, got shape (" +
+                               std::to_string(shape_1) + ", " + std::to_string(shape_0) + ") and stride " +
+                               std::to_string(stride) + " (set TRITON_DISABLE_TMA=1 to use cp.async)");
+    cuuint64_t dims[2] = {(cuuint64_t)shape_0, (cuuint64_t)shape_1};
+    cuuint64_t strides[1] = {(cuuint64_t)stride * spec.elt_bytes};
+    if(shape_0 == 0 || shape_1 == 0){
+      base = pool.address(zeros, device, stream, sync);
+      dims[0] = dims[1] = 1;
+      strides[0] = 16;
+    }
+    cuuint32_t elt_strides[2] = {1, 1};
+    unsigned log2_bytes = spec.elt_bytes == 1 ? 0 : spec.elt_bytes == 2 ? 1 : spec.elt_bytes == 4 ? 2 : 3;
+    CUtensorMap map;
+    try{
+      drv::dispatch::cuTensorMapEncodeTiled(&map, dtypes[log2_bytes], 2, (void*)base, dims, strides, spec.box,
+                                            elt_strides, CU_TENSOR_MAP_INTERLEAVE_NONE, (CUtensorMapSwizzle)spec.swizzle,
+                                            CU_TENSOR_MAP_L2_PROMOTION_L2_128B, CU_TENSOR_MAP_FLOAT_OOB_FILL_NONE);
+    }
+    catch(const std::exception& e){
+      throw std::runtime_error("could not encode the tensor map of a TMA copy of shape (" + std::to_string(shape_1) +
+                               ", " + std::to_string(shape_0) + ") and stride " + std::to_string(stride) +
+                               " (set TRITON_DISABLE_TMA=1 to use cp.async): " + e.what());
+    }
+    addresses.push_back(pool.address(map, device, stream, sync));
+  }
+  // operands are read before any tensor map is appended
+  for(uint64_t address: addresses)
+    params.add_uint64(address);
+}
+
+// Kernels that call `grid_sync` count the programs that arrived at their barriers in a
+// counter appended to their parameters, which each barrier leaves ready for the next launch,
+// whatever its grid. Launches on a stream run one after the other, so each stream of a device
+// has its own counter, and concurrent launches on different streams do not mix their
+// arrivals. Launches recorded into a graph get their own counter, as graphs may be replayed
+// on any stream, so replays of one graph must not overlap. Counters are zeroed when their
+// slab is allocated, and never freed, as launches still running and graphs may use them
+class grid_barrier_pool {
+public:
+  static grid_barrier_pool& get() {
+    static grid_barrier_pool ret;
+    return ret;
+  }
+
+  uint64_t address(backend_t backend, int64_t device, uint64_t stream, bool capturing) {
+    std::pair<int64_t, uint64_t> key = {device, stream};
+    auto it = counters_.find(key);
+    if(!capturing && it != counters_.end())
+      return it->second;
+    slab& current = slabs_[device];
+    if(current.used == slab_size){
+      static const uint32_t zeros[slab_size] = {};
+      if(backend == CUDA){
+        CUdeviceptr base;
+        drv::dispatch::cuMemAlloc_v2(&base, sizeof(zeros));
+        drv::dispatch::cuMemcpyHtoD_v2(base, zeros, sizeof(zeros));
+        current.base = base;
       }
-      std::string ty_str = arg.attr("__class__").attr("__name__").cast<std::string>();
-      if(ty_str == "NoneType"){
-        cache_key += "None";
+      else{
+        hipDeviceptr_t base;
+        drv::dispatch::hipMalloc(&base, sizeof(zeros));
+        drv::dispatch::hipMemcpyHtoD(base, zeros, sizeof(zeros));
+        current.base = (uint64_t)base;
+      }
+      current.used = 0;
+    }
+    uint64_t ret = current.base + current.used++*sizeof(uint32_t);
+    if(!capturing)
+      counters_.emplace(key, ret);
+    return ret;
+  }
+
+private:
+  static constexpr size_t slab_size = 1024;
+  struct slab {
+    uint64_t base = 0;
+    size_t used = slab_size;
+  };
+  std::map<int64_t, slab> slabs_;
+  std::map<std::pair<int64_t, uint64_t>, uint64_t> counters_;
+};
+
+// Binaries indexed by argument codes, so that launches that hit
+// the cache neither build a string key nor allocate memory
+class __attribute__((visibility("hidden"))) launch_cache {
+public:
+  struct entry {
+    std::vector<uint64_t> codes;
+    std::vector<py::object> constexprs;
+    py::object func_key;
+    int num_warps;
+    int num_stages;
+    int64_t device;
+    py::object bin;
+    backend_t backend;
+    uint64_t kernel;
+    uint64_t shared_mem;
+    int num_threads;
+    // programs that fit on the device at once, for kernels that call
+    // `grid_sync` (0 otherwise)
+    uint64_t max_programs;
+    // programs persistent kernels run on, and the counter they claim
+    // their tiles from (0 for other kernels)
+    uint64_t persistent_programs;
+    uint64_t tile_counter;
+    // tensor maps of TMA copies, appended to the arguments
+    std::vector<tensor_map_spec> tensor_maps;
+    // whether the counter of `grid_sync` barriers is appended after them
+    bool grid_sync;
+    // time of the last launch, in seconds of the monotonic clock
+    double last_use;
+  };
+
+  static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+public:
+  static uint64_t hash(const launch_buffers& buffers, PyObject* func_key, int num_warps, int num_stages, int64_t device){
+    uint64_t ret = (uint64_t)PyObject_Hash(func_key);
+    ret = hash_combine(ret, num_warps);
+    ret = hash_combine(ret, num_stages);
+    ret = hash_combine(ret, device);
+    for(uint64_t code: buffers.codes)
+      ret = hash_combine(ret, code);
+    return ret;
+  }
+
+  entry* find(uint64_t hash, const launch_buffers& buffers, PyObject* func_key, int num_warps, int num_stages,
+             int64_t device){
+    auto range = entries_.equal_range(hash);
+    for(auto it = range.first; it != range.second; it++){
+      entry& e = it->second;
+      if(e.num_warps != num_warps || e.num_stages != num_stages || e.device != device || e.codes != buffers.codes)
         continue;
+      if(PyUnicode_Compare(e.func_key.ptr(), func_key) != 0)
+        continue;
+      // constexpr codes only hold a hash of their value
+      bool same_constexprs = true;
+      for(size_t i = 0; i < e.constexprs.size() && same_constexprs; i++){
+        PyObject* lhs = e.constexprs[i].ptr();
+        PyObject* rhs = buffers.constexprs[i].ptr();
+        int eq = Py_TYPE(lhs) == Py_TYPE(rhs) ? PyObject_RichCompareBool(lhs, rhs, Py_EQ) : 0;
+        if(eq == -1)
+          PyErr_Clear();
+        same_constexprs = eq == 1;
       }
-      std::string err_msg = "Received type '" + ty_str + "' for argument " + std::to_string(i) + "."
-                            + " Only int, float, bool, torch.Tensor, and triton.language.constexpr are supported.";
-      throw std::runtime_error(err_msg);
+      if(same_constexprs)
+        return &e;
     }
-  params_size = (std::ptrdiff_t)(params_ptr - &params[0]);
+    return nullptr;
+  }
+
+  // binaries are shared by the devices of an architecture, and
+  // loaded on each of them on their first launch there
+  entry* insert(uint64_t hash, const launch_buffers& buffers, PyObject* func_key, int num_warps, int num_stages,
+                int64_t device, py::object bin){
+    entry e;
+    e.codes = buffers.codes;
+    e.constexprs = buffers.constexprs;
+    e.func_key = py::reinterpret_borrow<py::object>(func_key);
+    e.num_warps = num_warps;
+    e.num_stages = num_stages;
+    e.device = device;
+    e.bin = bin;
+    e.backend = py::cast<backend_t>(bin.attr("bin").attr("backend"));
+    e.kernel = py::cast<uint64_t>(bin.attr("kernel_for")(device));
+    e.shared_mem = py::cast<uint64_t>(bin.attr("shared_mem"));
+    e.num_threads = py::cast<int>(bin.attr("bin").attr("num_threads"));
+    e.max_programs = e.backend == CUDA ? py::cast<uint64_t>(bin.attr("max_programs")(device)) : 0;
+    e.persistent_programs = e.backend == CUDA ? py::cast<uint64_t>(bin.attr("persistent_programs")(device)) : 0;
+    e.tile_counter = e.persistent_programs ? py::cast<uint64_t>(bin.attr("tile_counter")(device)) : 0;
+    if(e.backend == CUDA)
+      e.tensor_maps = parse_tensor_maps(py::cast<std::string>(bin.attr("tensor_maps")));
+    e.grid_sync = py::cast<bool>(bin.attr("grid_sync"));
+    e.last_use = now();
+    return &entries_.emplace(hash, std::move(e))->second;
+  }
+
+  // removes the entries of binary `bin` (e.g., once a specialized binary
+  // replaces the generic one it was launched with), so that the next
+  // launches look their binary up again
+  size_t erase(py::object bin){
+    size_t ret = 0;
+    for(auto it = entries_.begin(); it != entries_.end();){
+      if(it->second.bin.is(bin)){
+        it = entries_.erase(it);
+        ret++;
+      }
+      else
+        it++;
+    }
+    return ret;
+  }
+
+  // time of the last launch of binary `bin`, or 0 if it has none
+  double last_use(py::object bin) const {
+    double ret = 0;
+    for(const auto& it: entries_)
+      if(it.second.bin.is(bin))
+        ret = std::max(ret, it.second.last_use);
+    return ret;
+  }
+
+  size_t size() const { return entries_.size(); }
+  void clear() { entries_.clear(); }
+
+public:
+  // the arguments of the kernel the binaries are launched for
+  arg_parser parser;
+
+private:
+  std::unordered_multimap<uint64_t, entry> entries_;
+};
+
+// Parses `args` into `buffers`, and returns the entry of their binary in `index`, which is
+// compiled first if it is not in `bin_cache`. Returns nullptr when `add_to_cache` reports
+// that nothing should be launched (e.g., while a batch of compilations is collected)
+launch_cache::entry* find_binary(py::list& args, py::list& do_not_specialize, py::list& strides, py::str& func_key,
+                                 int64_t device, py::dict& bin_cache, launch_cache& index, long num_warps,
+                                 long num_stages, py::function& add_to_cache, launch_buffers& buffers) {
+  // parse arguments to compute argument codes, compile-time constants and packed kernel arguments
+  index.parser.init(PyList_GET_SIZE(args.ptr()), do_not_specialize, strides);
+  parse_args(args, index.parser, buffers, device < 0);
+  // get cached binary
+  uint64_t hash = launch_cache::hash(buffers, func_key.ptr(), num_warps, num_stages, device);
+  launch_cache::entry* cached = index.find(hash, buffers, func_key.ptr(), num_warps, num_stages, device);
+  if(cached){
+    cached->last_use = launch_cache::now();
+    return cached;
+  }
+  // binaries are specific to the architecture of their device
+  std::string func = func_key;
+  if(device >= 0)
+    func += "cc" + device_arch(device);
+  py::str key(cache_key_str(buffers, func, num_warps, num_stages));
+  if(!bin_cache.contains(key)) {
+    py::bool_ noop = add_to_cache(key, args, device, num_warps, num_stages);
+    if(noop)
+      return nullptr;
+  }
+  return index.insert(hash, buffers, func_key.ptr(), num_warps, num_stages, device, bin_cache[key]);
+}
+
+// `grid` is a sequence of up to 3 sizes, or a function of the constants of the launch that returns one
+void get_grid(py::handle grid, const launch_buffers& buffers, py::list& arg_names,
+              unsigned& grid_0, unsigned& grid_1, unsigned& grid_2) {
+  py::sequence seq;
+  if(!PySequence_Check(grid.ptr()))
+    seq = grid(get_constants(buffers, arg_names));
+  else
+    seq = py::reinterpret_borrow<py::sequence>(grid);
+  int size = seq.size();
+  grid_0 = py::cast<int>(seq[0]);
+  grid_1 = size < 2 ? 1 : py::cast<int>(seq[1]);
+  grid_2 = size < 3 ? 1 : py::cast<int>(seq[2]);
+}
+
+// kernels that call `grid_sync` would hang if some of their programs waited for others
+// to be scheduled
+void check_grid(const launch_cache::entry& cached, unsigned grid_0, unsigned grid_1, unsigned grid_2) {
+  uint64_t num_programs = (uint64_t)grid_0 * grid_1 * grid_2;
+  if(cached.max_programs && num_programs > cached.max_programs)
+    throw std::runtime_error("grid of " + std::to_string(num_programs) + " programs calls grid_sync, but only " +
+                             std::to_string(cached.max_programs) + " fit on the device at once");
 }
 
+// persistent kernels take their tile counter and the sizes of their logical grid as
+// hidden arguments, and run on at most as many programs as fit on the device at once
+void persist(const launch_cache::entry& cached, rt::arg_packer& params,
+             unsigned& grid_0, unsigned& grid_1, unsigned& grid_2) {
+  if(!cached.persistent_programs)
+    return;
+  params.add_uint64(cached.tile_counter);
+  params.add_uint32(grid_0);
+  params.add_uint32(grid_1);
+  params.add_uint32(grid_2);
+  uint64_t num_tiles = (uint64_t)grid_0 * grid_1 * grid_2;
+  grid_0 = std::min(num_tiles, cached.persistent_programs);
+  grid_1 = 1;
+  grid_2 = 1;
+}
+
+// Kernel launches recorded into a CUDA graph, in issue order.
+// Launches are serialized, as they would be on a single stream.
+// Packed parameters are kept so that tensor pointers can be
+// remapped when the graph is replayed. Only the launches of the
+// thread that began the capture are recorded
+class launch_graph {
+public:
+  struct node {
+    CUgraphNode handle;
+    CUDA_KERNEL_NODE_PARAMS params;
+    std::string captured_args;
+    std::string args;
+    size_t args_size;
+    void* extra[5];
+    std::vector<size_t> ptr_offsets;
+    // tensor maps hold the pointers of the launch they were encoded for
+    bool tensor_maps;
+  };
+
+  // graph that the launches of the calling thread are recorded into, if any
+  static launch_graph*& capturing() {
+    static thread_local launch_graph* ret = nullptr;
+    return ret;
+  }
+
+public:
+  ~launch_graph() { reset(); }
+
+  void begin() {
+    if(capturing())
+      throw std::runtime_error("a thread cannot capture several launch graphs at once");
+    reset();
+    drv::dispatch::cuGraphCreate(&graph_, 0);
+    capturing() = this;
+    capturing_ = &capturing();
+  }
+
+  void end() {
+    if(capturing() != this)
+      throw std::runtime_error("launch graph is not being captured");
+    capturing() = nullptr;
+    capturing_ = nullptr;
+    drv::dispatch::cuGraphInstantiate_v2(&exec_, graph_, nullptr, nullptr, 0);
+  }
+
+  void record(uint64_t kernel, int grid_0, int grid_1, int grid_2, int block_0, uint64_t shared_mem,
+              const char* args, size_t args_size, const std::vector<size_t>& ptr_offsets, bool tensor_maps) {
+    nodes_.emplace_back();
+    node& n = nodes_.back();
+    n.tensor_maps = tensor_maps;
+    n.captured_args = std::string(args, args_size);
+    n.args = n.captured_args;
+    n.args_size = args_size;
+    n.ptr_offsets = ptr_offsets;
+    n.extra[0] = CU_LAUNCH_PARAM_BUFFER_POINTER;
+    n.extra[1] = (void*)n.args.data();
+    n.extra[2] = CU_LAUNCH_PARAM_BUFFER_SIZE;
+    n.extra[3] = &n.args_size;
+    n.extra[4] = CU_LAUNCH_PARAM_END;
+    n.params = {(CUfunction)kernel, (unsigned)grid_0, (unsigned)grid_1, (unsigned)grid_2,
+                (unsigned)block_0, 1, 1, (unsigned)shared_mem, nullptr, n.extra};
+    CUgraphNode* deps = nodes_.size() > 1 ? &nodes_[nodes_.size() - 2].handle : nullptr;
+    drv::dispatch::cuGraphAddKernelNode(&n.handle, graph_, deps, deps ? 1 : 0, &n.params);
+  }
+
+  // `remap` maps tensor pointers used when the graph was captured to
+  // the ones to use for this replay; other pointers are left as captured
+  void replay(uint64_t stream, const std::map<uint64_t, uint64_t>& remap) {
+    if(!exec_)
+      throw std::runtime_error("launch graph must be captured before it is replayed");
+    for(node& n: nodes_){
+      bool changed = false;
+      for(size_t off: n.ptr_offsets){
+        uint64_t ptr;
+        std::memcpy(&ptr, &n.captured_args[off], 8);
+        auto it = remap.find(ptr);
+        if(it != remap.end())
+          ptr = it->second;
+        if(std::memcmp(&ptr, &n.args[off], 8) == 0)
+          continue;
+        if(n.tensor_maps)
+          throw std::runtime_error("launches of kernels with TMA copies cannot be replayed with other tensors");
+        std::memcpy(&n.args[off], &ptr, 8);
+        changed = true;
+      }
+      // the executable graph holds its own copy of the parameters
+      if(changed)
+        drv::dispatch::cuGraphExecKernelNodeSetParams(exec_, n.handle, &n.params);
+    }
+    drv::dispatch::cuGraphLaunch(exec_, (CUstream)stream);
+  }
+
+  size_t size() const { return nodes_.size(); }
+
+private:
+  void reset() {
+    // graphs may be destroyed by another thread than the capturing one,
+    // which then holds the gil
+    if(capturing_ && *capturing_ == this)
+      *capturing_ = nullptr;
+    capturing_ = nullptr;
+    if(exec_)
+      drv::dispatch::cuGraphExecDestroy(exec_);
+    if(graph_)
+      drv::dispatch::cuGraphDestroy(graph_);
+    exec_ = nullptr;
+    graph_ = nullptr;
+    nodes_.clear();
+  }
+
+private:
+  CUgraph graph_ = nullptr;
+  CUgraphExec exec_ = nullptr;
+  // `capturing()` of the thread that captures the graph
+  launch_graph** capturing_ = nullptr;
+  // nodes hold the parameters the driver points to, so are never moved
+  std::deque<node> nodes_;
+};
+
 //
 
 void init_triton_runtime(py::module &&m) {
@@ -282,66 +1028,186 @@ void init_triton_runtime(py::module &&m) {
   );
 
   // get range size for the given pointer
-  m.def("get_pointer_range_size", &get_pointer_range_size);
+  m.def("get_pointer_range_size", &rt::pointer_range_size);
+  m.def("clear_pointer_ranges", &rt::clear_pointer_ranges);
+
+  // specializes host binaries
+  m.def("host_cpu_name", &drv::host_cpu_name);
+
+
+  py::class_<launch_cache>(m, "launch_cache")
+      .def(py::init<>())
+      .def("__len__", &launch_cache::size)
+      .def("erase", &launch_cache::erase)
+      .def("last_use", &launch_cache::last_use)
+      .def("clear", &launch_cache::clear);
 
+  py::class_<launch_graph>(m, "launch_graph")
+      .def(py::init<>())
+      .def("__len__", &launch_graph::size)
+      .def("begin", &launch_graph::begin)
+      .def("end", &launch_graph::end)
+      .def("replay", &launch_graph::replay, py::call_guard<py::gil_scoped_release>());
 
   // cache key
-  m.def("launch", [](py::list args, py::list do_not_specialize, const std::string& func_key, py::list& arg_names, 
-                     py::object device, py::int_ stream, py::dict bin_cache, py::int_ num_warps, py::int_ num_stages, 
-                     py::function add_to_cache, py::object grid){
-    // parse arguments to compute cache key, compile-time constants and packed kernel arguments
+  m.def("launch", [](py::list args, py::list do_not_specialize, py::list strides, py::str func_key, py::list& arg_names,
+                     py::object device, py::int_ stream, py::dict bin_cache, launch_cache& index,
+                     py::int_ num_warps, py::int_ num_stages, py::function add_to_cache, py::object grid){
+    // launches may be issued re-entrantly (e.g., from a cache hook),
+    // in which case they get their own buffers
+    static thread_local launch_buffers reused_buffers;
+    static thread_local bool reused_buffers_in_use = false;
+    launch_buffers local_buffers;
+    bool reuse = !reused_buffers_in_use;
+    launch_buffers& buffers = reuse ? reused_buffers : local_buffers;
+    reused_buffers_in_use = true;
+    struct release_t {
+      launch_buffers& buffers; bool reuse;
+      ~release_t() { buffers.clear(); if(reuse) reused_buffers_in_use = false; }
+    } release{buffers, reuse};
     long _num_warps = PyLong_AsLong(num_warps.ptr());
     long _num_stages = PyLong_AsLong(num_stages.ptr());
-    std::string cache_key;
-    std::string params;
-    size_t params_size;
-    py::dict constants;
-    parse_args(args, do_not_specialize, func_key, arg_names, cache_key, params, params_size, constants, _num_warps, _num_stages);
-
-    // get cached binary
-    py::str key(cache_key);
-    py::bool_ noop = false;
-    if(!bin_cache.contains(key)) {
-      noop = add_to_cache(key, args, device, num_warps, num_stages);
-    }
-    if (noop)
+    int64_t _device = PyLong_AsLong(device.ptr());
+    launch_cache::entry* cached = find_binary(args, do_not_specialize, strides, func_key, _device, bin_cache, index,
+                                              _num_warps, _num_stages, add_to_cache, buffers);
+    if(!cached)
       return (py::object)py::none();
-    py::object bin = bin_cache[key];
-
-    // get grid
-    py::sequence seq;
-    if(!PySequence_Check(grid.ptr()))
-      seq = grid(constants);
-    else
-      seq = grid;
-    int size = seq.size();
-    int grid_0 = py::cast<int>(seq[0]);
-    int grid_1 = size < 2 ? 1 : py::cast<int>(seq[1]);
-    int grid_2 = size < 3 ? 1 : py::cast<int>(seq[2]);
-
-    // enqueue
-    uint64_t kernel = py::cast<uint64_t>(bin.attr("kernel"));
-    uint64_t shared_mem = py::cast<uint64_t>(bin.attr("shared_mem"));
-
-    // actually launch
-    void *config[] = {
-        CU_LAUNCH_PARAM_BUFFER_POINTER, params.data(),
-        CU_LAUNCH_PARAM_BUFFER_SIZE, &params_size,
-        CU_LAUNCH_PARAM_END
-    };
+    py::object bin = cached->bin;
+    unsigned grid_0, grid_1, grid_2;
+    get_grid(grid, buffers, arg_names, grid_0, grid_1, grid_2);
+    check_grid(*cached, grid_0, grid_1, grid_2);
+    persist(*cached, buffers.params, grid_0, grid_1, grid_2);
     uint64_t _stream = PyLong_AsLong(stream.ptr());
-    if(grid_0*grid_1*grid_2 > 0) {
+    bool capturing = cached->backend != HOST && launch_graph::capturing();
+    add_tensor_maps(cached->tensor_maps, buffers.params, _device, _stream, capturing);
+    if(cached->grid_sync)
+      buffers.params.add_uint64(grid_barrier_pool::get().address(cached->backend, _device, _stream, capturing));
+
+    // enqueue. Entries may be updated by other threads
+    // once the gil is released
+    rt::kernel_t kernel = {cached->backend, 0, cached->kernel, cached->shared_mem, cached->num_threads};
+    const rt::arg_packer& params = buffers.params;
+    if(capturing) {
+      if(grid_0*grid_1*grid_2 > 0)
+        launch_graph::capturing()->record(kernel.function, grid_0, grid_1, grid_2, kernel.num_threads, kernel.shared_mem,
+                                          params.data(), params.size(), params.ptr_offsets(),
+                                          !cached->tensor_maps.empty());
+    }
+    else {
       // release the gil in case the enqueue blocks
       // cuda will block if too many ops are enqueued
       py::gil_scoped_release allow_threads;
-      drv::dispatch::cuLaunchKernel((CUfunction)kernel, grid_0, grid_1, grid_2, 
-                                    _num_warps*32, 1, 1, shared_mem, (CUstream)_stream, 
-                                     nullptr, config);
-   }
+      rt::launch(kernel, _stream, grid_0, grid_1, grid_2, params);
+    }
     return bin;
   });
 
-  m.def("cc", [](backend_t backend, uint64_t device) -> int {
+  // Launches a kernel once per list of arguments in `arg_lists`, on the grid of the same
+  // index in `grids`. Arguments are all parsed and their binaries looked up first, with
+  // their parameters packed one after the other in an arena, then the kernels are enqueued
+  // in one loop, without the gil. Returns the binary of each launch (None for no-ops)
+  m.def("launch_many", [](py::list arg_lists, py::list grids, py::list do_not_specialize, py::list strides,
+                          py::str func_key, py::list& arg_names, py::int_ device, py::int_ stream,
+                          py::dict bin_cache, launch_cache& index, py::int_ num_warps, py::int_ num_stages,
+                          py::function add_to_cache){
+    struct pending_launch {
+      rt::kernel_t kernel;
+      unsigned grid[3];
+      size_t offset;
+      size_t size;
+    };
+    size_t n = arg_lists.size();
+    if(grids.size() != n)
+      throw std::invalid_argument("launch_many expects one grid per list of arguments");
+    long _num_warps = PyLong_AsLong(num_warps.ptr());
+    long _num_stages = PyLong_AsLong(num_stages.ptr());
+    int64_t _device = PyLong_AsLong(device.ptr());
+    uint64_t _stream = PyLong_AsLong(stream.ptr());
+    std::vector<pending_launch> pending;
+    pending.reserve(n);
+    std::string arena;
+    launch_buffers buffers;
+    py::list bins(n);
+    for(size_t i = 0; i < n; i++){
+      buffers.clear();
+      py::list args = arg_lists[i].cast<py::list>();
+      launch_cache::entry* cached = find_binary(args, do_not_specialize, strides, func_key, _device, bin_cache, index,
+                                                _num_warps, _num_stages, add_to_cache, buffers);
+      if(!cached){
+        bins[i] = py::none();
+        continue;
+      }
+      bins[i] = cached->bin;
+      pending_launch p;
+      p.kernel = {cached->backend, 0, cached->kernel, cached->shared_mem, cached->num_threads};
+      get_grid(py::object(grids[i]), buffers, arg_names, p.grid[0], p.grid[1], p.grid[2]);
+      check_grid(*cached, p.grid[0], p.grid[1], p.grid[2]);
+      persist(*cached, buffers.params, p.grid[0], p.grid[1], p.grid[2]);
+      bool capturing = p.kernel.backend != HOST && launch_graph::capturing();
+      add_tensor_maps(cached->tensor_maps, buffers.params, _device, _stream, capturing);
+      if(cached->grid_sync)
+        buffers.params.add_uint64(grid_barrier_pool::get().address(cached->backend, _device, _stream, capturing));
+      const rt::arg_packer& params = buffers.params;
+      if(capturing) {
+        if(p.grid[0]*p.grid[1]*p.grid[2] > 0)
+          launch_graph::capturing()->record(p.kernel.function, p.grid[0], p.grid[1], p.grid[2], p.kernel.num_threads,
+                                            p.kernel.shared_mem, params.data(), params.size(), params.ptr_offsets(),
+                                            !cached->tensor_maps.empty());
+        continue;
+      }
+      // parameters are aligned as the driver expects their buffer to be
+      p.offset = (arena.size() + 15) & ~size_t(15);
+      p.size = params.size();
+      arena.resize(p.offset + p.size);
+      std::memcpy(&arena[p.offset], params.data(), p.size);
+      pending.push_back(p);
+    }
+    py::gil_scoped_release allow_threads;
+    for(const pending_launch& p: pending)
+      rt::launch(p.kernel.backend, p.kernel.function, _stream, p.grid[0], p.grid[1], p.grid[2], p.kernel.num_threads, 1, 1,
+                 arena.data() + p.offset, p.size, p.kernel.shared_mem);
+    return bins;
+  });
+
+  // ordinal of the device of the calling thread's current context, or -1 when it has
+  // none (e.g., before PyTorch first uses the device on this thread) or on ROCm
+  m.def("current_device", [](backend_t backend) -> int64_t {
+    if(backend != CUDA)
+      return -1;
+    CUcontext ctx;
+    drv::dispatch::cuCtxGetCurrent(&ctx);
+    if(!ctx)
+      return -1;
+    CUdevice device;
+    drv::dispatch::cuCtxGetDevice(&device);
+    return device;
+  });
+  // makes the primary context of `device` current on the calling thread. Before CUDA 12,
+  // `torch.cuda.device` only selects the device of the runtime: the driver keeps the
+  // previous context current until the runtime is next used on this thread.
+  // Contexts stay retained for the lifetime of the process, as PyTorch's do
+  m.def("set_current_device", [](backend_t backend, int64_t device) {
+    if(backend != CUDA)
+      return;
+    static std::mutex mutex;
+    static std::map<int64_t, CUcontext> retained;
+    CUcontext ctx;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = retained.find(device);
+      if(it == retained.end()){
+        CUdevice dev;
+        drv::dispatch::cuDeviceGet(&dev, device);
+        drv::dispatch::cuDevicePrimaryCtxRetain(&ctx, dev);
+        retained[device] = ctx;
+      }
+      else
+        ctx = it->second;
+    }
+    drv::dispatch::cuCtxSetCurrent(ctx);
+  });
+
+  m.def("cc", [](backend_t backend, int64_t device) -> int {
     if (backend == CUDA) {
       CUdevice dev = (CUdevice)device;
       int major = cuGetInfo<CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MAJOR>(dev);
@@ -352,9 +1218,10 @@ void init_triton_runtime(py::module &&m) {
   });
 
   // query maximum shared memory
-  m.def("max_shared_memory", [](backend_t backend, uint64_t device) {
+  m.def("max_shared_memory", [](backend_t backend, int64_t device) {
+      // host kernels carve their shared memory out of the worker's stack
       if (backend == HOST)
-        return 0;
+        return 1 << 20;
       if(backend == CUDA) 
         return cuGetInfo<CU_DEVICE_ATTRIBUTE_MAX_SHARED_MEMORY_PER_BLOCK_OPTIN>(device);
       if(backend == ROCM)
@@ -387,22 +1254,81 @@ void init_triton_runtime(py::module &&m) {
     return -1;
   });
 
+  // counter of the `grid_sync` barriers of the kernels launched on `stream`
+  m.def("grid_barrier", [](backend_t backend, int64_t device, uint64_t stream) {
+    return grid_barrier_pool::get().address(backend, device, stream, false);
+  });
+
+  // resources of a multiprocessor shared by its resident blocks (CUDA only)
+  m.def("sm_resources", [](backend_t backend, uint64_t device) {
+    std::map<std::string, int> ret;
+    if (backend != CUDA)
+      return ret;
+    ret["shared"] = cuGetInfo<CU_DEVICE_ATTRIBUTE_MAX_SHARED_MEMORY_PER_MULTIPROCESSOR>(device);
+    ret["reserved_shared_per_block"] = cuGetInfo<CU_DEVICE_ATTRIBUTE_RESERVED_SHARED_MEMORY_PER_BLOCK>(device);
+    ret["threads"] = cuGetInfo<CU_DEVICE_ATTRIBUTE_MAX_THREADS_PER_MULTIPROCESSOR>(device);
+    ret["registers"] = cuGetInfo<CU_DEVICE_ATTRIBUTE_MAX_REGISTERS_PER_MULTIPROCESSOR>(device);
+    ret["blocks"] = cuGetInfo<CU_DEVICE_ATTRIBUTE_MAX_BLOCKS_PER_MULTIPROCESSOR>(device);
+    return ret;
+  });
+
+  // clocks (in MHz), power (in W), temperature (in C) and clock throttle reasons
+  // of a device, read from NVML; what the device does not report is left out
+  m.def("gpu_state", [](backend_t backend, uint64_t device) {
+    std::map<std::string, double> ret;
+    if(backend != CUDA)
+      return ret;
+    nvmlDevice_t dev = nvml_device(device);
+    unsigned val;
+    unsigned long long reasons;
+    if(drv::dispatch::nvmlDeviceGetClockInfo(dev, NVML_CLOCK_SM, &val) == NVML_SUCCESS)
+      ret["sm_clock"] = val;
+    if(drv::dispatch::nvmlDeviceGetClockInfo(dev, NVML_CLOCK_MEM, &val) == NVML_SUCCESS)
+      ret["mem_clock"] = val;
+    if(drv::dispatch::nvmlDeviceGetMaxClockInfo(dev, NVML_CLOCK_SM, &val) == NVML_SUCCESS)
+      ret["max_sm_clock"] = val;
+    if(drv::dispatch::nvmlDeviceGetMaxClockInfo(dev, NVML_CLOCK_MEM, &val) == NVML_SUCCESS)
+      ret["max_mem_clock"] = val;
+    if(drv::dispatch::nvmlDeviceGetPowerUsage(dev, &val) == NVML_SUCCESS)
+      ret["power"] = val * 1e-3;
+    if(drv::dispatch::nvmlDeviceGetTemperature(dev, NVML_TEMPERATURE_GPU, &val) == NVML_SUCCESS)
+      ret["temperature"] = val;
+    if(drv::dispatch::nvmlDeviceGetCurrentClocksThrottleReasons(dev, &reasons) == NVML_SUCCESS)
+      ret["throttle_reasons"] = reasons;
+    return ret;
+  });
+
+  // pins the SM and memory clocks of a device (usually requires root): application
+  // clocks, and locked SM clocks where the device supports them
+  m.def("lock_clocks", [](backend_t backend, uint64_t device, unsigned sm_clock, unsigned mem_clock) {
+    if(backend != CUDA)
+      throw std::runtime_error("clocks can only be locked on CUDA devices");
+    nvmlDevice_t dev = nvml_device(device);
+    nvml_check(drv::dispatch::nvmlDeviceSetApplicationsClocks(dev, mem_clock, sm_clock), "cannot set application clocks");
+    nvmlReturn_t res = drv::dispatch::nvmlDeviceSetGpuLockedClocks(dev, sm_clock, sm_clock);
+    if(res != NVML_ERROR_NOT_SUPPORTED)
+      nvml_check(res, "cannot lock SM clocks");
+  });
+  m.def("reset_clocks", [](backend_t backend, uint64_t device) {
+    if(backend != CUDA)
+      return;
+    nvmlDevice_t dev = nvml_device(device);
+    nvml_check(drv::dispatch::nvmlDeviceResetApplicationsClocks(dev), "cannot reset application clocks");
+    nvmlReturn_t res = drv::dispatch::nvmlDeviceResetGpuLockedClocks(dev);
+    if(res != NVML_ERROR_NOT_SUPPORTED)
+      nvml_check(res, "cannot reset SM clocks");
+  });
+
   // enqueue
   m.def("enqueue", [](backend_t backend, uint64_t stream, uint64_t kernel,
                       uint64_t grid_0, uint64_t grid_1, uint64_t grid_2,
                       uint64_t block_0, uint64_t block_1, uint64_t block_2,
                       const std::string &args, int64_t shared_mem){
-    void* args_ptr = (void*)args.data();
-    size_t args_size = args.size();
     // release the gil in case the enqueue blocks
     // cuda will block if too many ops are enqueued
     py::gil_scoped_release allow_threads;
-    if(backend == HOST)
-      host_enqueue(stream, kernel, grid_0, grid_1, grid_2, block_0, block_1, block_2, args_ptr, args_size, shared_mem);
-    if(backend == CUDA)
-      cu_enqueue(stream, kernel, grid_0, grid_1, grid_2, block_0, block_1, block_2, args_ptr, args_size, shared_mem);
-    if(backend == ROCM)
-      hip_enqueue(stream, kernel, grid_0, grid_1, grid_2, block_0, block_1, block_2, args_ptr, args_size, shared_mem);
+    rt::launch(backend, kernel, stream, grid_0, grid_1, grid_2, block_0, block_1, block_2,
+               args.data(), args.size(), shared_mem);
   });
 
   
@@ -417,129 +1343,486 @@ typedef std::map<std::string, py::object> asm_map_t;
 // Load provided assembly code into driver
 // --------------------------------------- 
 
-// CUDA
-std::tuple<uint64_t, uint64_t> cu_load_binary(const std::string& name, asm_map_t &asm_map, size_t n_shared_bytes, uint64_t dev){
-  // load assembly
-  std::string assembly;
+// Assembly is `str`, `bytes` or a buffer such as a view of the on-disk cache.
+// The returned view is valid as long as `obj` is alive
+std::string_view asm_view(const py::object& obj){
+  if(PyUnicode_Check(obj.ptr())){
+    Py_ssize_t size;
+    const char* data = PyUnicode_AsUTF8AndSize(obj.ptr(), &size);
+    return std::string_view(data, size);
+  }
+  if(PyBytes_Check(obj.ptr()))
+    return std::string_view(PyBytes_AS_STRING(obj.ptr()), PyBytes_GET_SIZE(obj.ptr()));
+  py::buffer_info info = py::reinterpret_borrow<py::buffer>(obj).request();
+  return std::string_view((const char*)info.ptr, info.size * info.itemsize);
+}
+
+// the image of the binary that the driver loads
+std::string_view load_image(backend_t backend, asm_map_t &asm_map){
+  if(backend == HOST)
+    return asm_view(asm_map["llir"]);
+  if(backend == ROCM)
+    return asm_view(asm_map["hsaco"]);
   if(asm_map.find("cubin") != asm_map.end())
-    assembly = py::cast<std::string>(asm_map["cubin"]);
-  else
-    assembly = py::cast<std::string>(asm_map["ptx"]);
-  // create driver handles
-  CUfunction fun;
-  CUmodule mod;
-  drv::dispatch::cuModuleLoadData(&mod, assembly.c_str());
-  drv::dispatch::cuModuleGetFunction(&fun, mod, name.c_str());
-  // set dynamic shared memory if necessary
-  int shared_optin;
-  drv::dispatch::cuDeviceGetAttribute(&shared_optin, CU_DEVICE_ATTRIBUTE_MAX_SHARED_MEMORY_PER_BLOCK_OPTIN, dev);
-  if(n_shared_bytes > 49152 && shared_optin > 49152){
-    drv::dispatch::cuFuncSetCacheConfig(fun, CU_FUNC_CACHE_PREFER_SHARED);
-    int shared_total, shared_static;
-    int n_spills, n_reg;
-    drv::dispatch::cuDeviceGetAttribute(&shared_total, CU_DEVICE_ATTRIBUTE_MAX_SHARED_MEMORY_PER_MULTIPROCESSOR, dev);
-    drv::dispatch::cuFuncGetAttribute(&shared_static, CU_FUNC_ATTRIBUTE_SHARED_SIZE_BYTES, fun);
-    drv::dispatch::cuFuncGetAttribute(&n_spills, CU_FUNC_ATTRIBUTE_LOCAL_SIZE_BYTES,  fun);
-    drv::dispatch::cuFuncGetAttribute(&n_reg, CU_FUNC_ATTRIBUTE_NUM_REGS, fun);
-    drv::dispatch::cuFuncSetAttribute(fun, CU_FUNC_ATTRIBUTE_MAX_DYNAMIC_SHARED_SIZE_BYTES, shared_optin - shared_static);
-  }
-  return std::make_tuple((uint64_t)mod, (uint64_t)fun);
-}
-
-// ROCM
-std::tuple<uint64_t, uint64_t> hip_load_binary(const std::string& name, asm_map_t &asm_map, size_t n_shared_bytes, uint64_t dev){
-  py::bytes _assembly = asm_map["hsaco"];
-  std::string assembly = py::cast<std::string>(_assembly);
-  // HSA-CO -> hipModule
-  hipModule_t mod = drv::amdgpu_to_hipmodule(assembly);
-  // Handle to the kernel
-  hipFunction_t fun;
-  drv::dispatch::hipModuleGetFunction(&fun, mod, name.c_str());
-  // record asm
-  return std::make_tuple((uint64_t)mod, (uint64_t)fun);
+    return asm_view(asm_map["cubin"]);
+  return asm_view(asm_map["ptx"]);
+}
+
+// resources used by a loaded kernel, and the number of its blocks that fit on a multiprocessor
+py::dict cu_kernel_resources(uint64_t kernel, int num_threads, size_t n_shared_bytes){
+  CUfunction fun = (CUfunction)kernel;
+  int n_regs, n_local, n_shared_static, carveout, max_ctas;
+  drv::dispatch::cuFuncGetAttribute(&n_regs, CU_FUNC_ATTRIBUTE_NUM_REGS, fun);
+  drv::dispatch::cuFuncGetAttribute(&n_local, CU_FUNC_ATTRIBUTE_LOCAL_SIZE_BYTES, fun);
+  drv::dispatch::cuFuncGetAttribute(&n_shared_static, CU_FUNC_ATTRIBUTE_SHARED_SIZE_BYTES, fun);
+  drv::dispatch::cuFuncGetAttribute(&carveout, CU_FUNC_ATTRIBUTE_PREFERRED_SHARED_MEMORY_CARVEOUT, fun);
+  drv::dispatch::cuOccupancyMaxActiveBlocksPerMultiprocessor(&max_ctas, fun, num_threads, n_shared_bytes);
+  py::dict ret;
+  ret["n_regs"] = n_regs;
+  ret["n_spill_bytes"] = n_local;
+  ret["n_shared_static"] = n_shared_static;
+  ret["n_shared_dynamic"] = n_shared_bytes;
+  ret["carveout"] = carveout;
+  ret["max_ctas_per_sm"] = max_ctas;
+  return ret;
 }
 
 // --------------------------------------- 
 // Compile Triton-IR to assembly
 // --------------------------------------- 
 
-// CUDA
-std::tuple<std::string, asm_map_t, int> cu_compile_ttir(const std::string& name, ir::module &ir, 
-                                                               uint64_t device, int num_warps, int num_stages,
-                                                               asm_map_t &asm_map){
+// assembly produced by the compiler, before conversion to Python objects.
+// This lets compilation run on any thread without holding the GIL
+typedef std::map<std::string, std::string> asm_str_map_t;
+
+// binaries found in `images` are not copied again
+asm_map_t to_py_asm_map(const asm_str_map_t& asm_str_map,
+                        std::unordered_map<std::string_view, py::object>* images = nullptr){
+  asm_map_t asm_map;
+  for(const auto& it: asm_str_map){
+    if((it.first == "cubin" || it.first == "hsaco") && images){
+      auto found = images->find(it.second);
+      if(found == images->end())
+        found = images->emplace(it.second, py::bytes(it.second)).first;
+      asm_map[it.first] = found->second;
+    }
+    else if(it.first == "cubin" || it.first == "hsaco")
+      asm_map[it.first] = py::bytes(it.second);
+    else
+      asm_map[it.first] = py::cast(it.second);
+  }
+  return asm_map;
+}
 
-  int n_shared_bytes;
-  py::gil_scoped_release allow_threads;
-  llvm::LLVMContext ctx;
-  // device properties
+py::dict to_py_ptxas_info(const drv::ptxas_info& info){
+  py::dict ret;
+  ret["n_regs"] = info.n_regs;
+  ret["n_spill_stores"] = info.n_spill_stores;
+  ret["n_spill_loads"] = info.n_spill_loads;
+  ret["n_stack_frame"] = info.n_stack_frame;
+  ret["n_shared_static"] = info.n_shared_static;
+  ret["log"] = info.log;
+  return ret;
+}
+
+// per-pass statistics are reported in `asm_map["pass_stats"]` when TRITON_PASS_STATS is set
+std::string* pass_stats(asm_str_map_t &asm_map){
+  if(triton::tools::getenv("TRITON_PASS_STATS").empty())
+    return nullptr;
+  return &asm_map["pass_stats"];
+}
+
+// wall-clock time of a compilation stage, appended to `asm_map["stage_times"]` as a
+// "<stage> <microseconds>" line when TRITON_PASS_STATS is set
+class stage_timer {
+public:
+  stage_timer(asm_str_map_t &asm_map, const std::string& name)
+    : asm_map_(asm_map), name_(name), start_(std::chrono::steady_clock::now()) {}
+  ~stage_timer() {
+    if(triton::tools::getenv("TRITON_PASS_STATS").empty())
+      return;
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start_).count();
+    asm_map_["stage_times"] += name_ + " " + std::to_string(us) + "\n";
+  }
+
+private:
+  asm_str_map_t &asm_map_;
+  std::string name_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// LLVM pipeline to run before code generation; TRITON_LLVM_OPT overrides the kernel's
+static std::string llvm_pipeline(ir::module &ir){
+  std::string ret = triton::tools::getenv("TRITON_LLVM_OPT");
+  return ret.empty() ? ir.get_llvm_opt() : ret;
+}
+
+// CUDA
+size_t cu_compute_capability(uint64_t device){
   CUdevice dev = (CUdevice)device;
   size_t major = cuGetInfo<CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MAJOR>(dev);
   size_t minor = cuGetInfo<CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MINOR>(dev);
-  size_t cc = major*10 + minor;
-  int version;
-  std::string ptxas_path = drv::path_to_ptxas(version);
-  // Triton-IR -> NVPTX LLVM-IR
+  return major*10 + minor;
+}
+
+// Triton-IR -> NVPTX LLVM-IR, also recorded in `asm_map["llir"]`
+std::unique_ptr<llvm::Module> cu_ttir_to_llir(ir::module &ir, llvm::LLVMContext &ctx, size_t cc,
+                                              int num_warps, int num_stages,
+                                              asm_str_map_t &asm_map, int &n_shared_bytes){
   triton::codegen::nvidia_cu_target target(cc);
-  auto llvm = triton::codegen::add_passes_to_emit_bin(ir, ctx, &target, cc, num_warps, num_stages, n_shared_bytes);
+  std::unique_ptr<llvm::Module> llvm;
+  {
+    stage_timer timer(asm_map, "ttir_to_llir");
+    llvm = triton::codegen::add_passes_to_emit_bin(ir, ctx, &target, cc, num_warps, num_stages, n_shared_bytes,
+                                                   pass_stats(asm_map), &asm_map["codegen_stats"]);
+  }
   std::string tmp;
   llvm::raw_string_ostream llir(tmp);
   llir << *llvm;
   llir.flush();
-  asm_map["llir"] = py::cast(tmp);
+  asm_map["llir"] = tmp;
+  // tensor maps of TMA copies, one per line, which the launcher encodes
+  if(llvm::NamedMDNode* tensor_maps = llvm->getNamedMetadata("triton.tensor_maps")){
+    std::string text;
+    for(llvm::MDNode* tensor_map: tensor_maps->operands())
+      text += llvm::cast<llvm::MDString>(tensor_map->getOperand(0))->getString().str() + "\n";
+    asm_map["tensor_maps"] = text;
+  }
+  // kernels that call `grid_sync` take the counter of their barriers after their arguments
+  if(llvm->getNamedMetadata("triton.grid_sync"))
+    asm_map["grid_sync"] = "1";
+  return llvm;
+}
+
+// LLVM-IR -> PTX -> cubin
+void cu_llir_to_cubin(llvm::Module* llvm, const std::string& pipeline, size_t cc,
+                      const std::string& ptxas_path, int ptxas_version,
+                      asm_str_map_t &asm_map, drv::ptxas_info &info){
   // LLVM-IR -> PTX
-  std::string ptx = drv::llir_to_ptx(llvm.get(), cc, version);
-  asm_map["ptx"] = py::cast(ptx);
+  std::string ptx, opt_report;
+  {
+    stage_timer timer(asm_map, "llir_to_ptx");
+    ptx = drv::llir_to_ptx(llvm, cc, ptxas_version, pipeline, &opt_report);
+  }
+  if(!opt_report.empty())
+    asm_map["llvm_opt"] = opt_report;
+  asm_map["ptx"] = ptx;
   // PTX -> Binary
-  std::string cubin = drv::ptx_to_cubin(ptx, ptxas_path, cc);
-  if(!cubin.empty()){
-    py::bytes bytes(cubin);
-    asm_map["cubin"] = bytes;
+  std::string cubin;
+  {
+    stage_timer timer(asm_map, "ptx_to_cubin");
+    cubin = drv::ptx_to_cubin(ptx, ptxas_path, cc, &info);
+  }
+  if(!cubin.empty())
+    asm_map["cubin"] = cubin;
+}
+
+int cu_compile_ttir(ir::module &ir, size_t cc, int num_warps, int num_stages,
+                    const std::string& ptxas_path, int ptxas_version,
+                    asm_str_map_t &asm_map, drv::ptxas_info &info){
+  int n_shared_bytes;
+  drv::llvm_context_ptr ctx = drv::get_llvm_context();
+  auto llvm = cu_ttir_to_llir(ir, *ctx, cc, num_warps, num_stages, asm_map, n_shared_bytes);
+  cu_llir_to_cubin(llvm.get(), llvm_pipeline(ir), cc, ptxas_path, ptxas_version, asm_map, info);
+  return n_shared_bytes;
+}
+
+// Links the LLVM-IR already recorded in `asm_maps` into one module that is lowered to
+// PTX and assembled once. Every kernel gets the whole PTX and cubin, the part of the
+// ptxas log that is about it, and its name in the linked module in `names`
+void cu_link_llir_to_cubin(const std::vector<asm_str_map_t*>& asm_maps, std::vector<std::string*>& names,
+                           const std::vector<drv::ptxas_info*>& infos, const std::string& pipeline, size_t cc,
+                           const std::string& ptxas_path, int ptxas_version){
+  std::vector<std::string> llirs, fn_names;
+  for(size_t i = 0; i < asm_maps.size(); i++){
+    llirs.push_back((*asm_maps[i])["llir"]);
+    fn_names.push_back(*names[i]);
+  }
+  drv::llvm_context_ptr ctx = drv::get_llvm_context();
+  asm_str_map_t asm_map;
+  drv::ptxas_info info;
+  {
+    std::unique_ptr<llvm::Module> llvm = drv::link_llir(llirs, fn_names, *ctx);
+    cu_llir_to_cubin(llvm.get(), pipeline, cc, ptxas_path, ptxas_version, asm_map, info);
+  }
+  for(size_t i = 0; i < asm_maps.size(); i++){
+    for(const auto& it: asm_map)
+      (*asm_maps[i])[it.first] += it.second;
+    *names[i] = fn_names[i];
+    drv::parse_ptxas_info(drv::ptxas_function_log(info.log, fn_names[i]), *infos[i]);
   }
-  return std::make_tuple(name, asm_map, n_shared_bytes);
 }
 
 // HIP
-std::tuple<std::string, asm_map_t, int> hip_compile_ttir(const std::string& name, ir::module &ir, 
-                                                                uint64_t device, int num_warps, int num_stages, 
-                                                                asm_map_t &asm_map){
-  llvm::LLVMContext ctx;
-  // Triton-IR -> NVPTX LLVM-IR
-  triton::codegen::amd_cl_target target;
+// Kernels are compiled for the GCN architecture `gcn_arch`, or for the one of `device` if it is empty
+int hip_compile_ttir(ir::module &ir, uint64_t device, const std::string& gcn_arch, int num_warps, int num_stages,
+                     asm_str_map_t &asm_map){
+  drv::llvm_context_ptr ctx = drv::get_llvm_context();
+  // Triton-IR -> AMDGPU LLVM-IR
+  const std::string& arch = gcn_arch.empty() ? hip_arch(device) : gcn_arch;
+  // 64KB of LDS per workgroup on every GCN/CDNA architecture
+  int max_shared = gcn_arch.empty() ? hipGetInfo<hipDeviceAttributeMaxSharedMemoryPerBlock>(device) : 65536;
+  triton::codegen::amd_cl_target target(drv::amdgpu_target(arch).first, max_shared);
   int n_shared_bytes;
-  auto llvm = triton::codegen::add_passes_to_emit_bin(ir, ctx, &target, 70, num_warps, num_stages, n_shared_bytes);
+  auto llvm = triton::codegen::add_passes_to_emit_bin(ir, *ctx, &target, 0, num_warps, num_stages, n_shared_bytes,
+                                                      pass_stats(asm_map), &asm_map["codegen_stats"]);
   std::string tmp;
   llvm::raw_string_ostream llir(tmp);
   llir << *llvm;
   llir.flush();
-  asm_map["llir"] = py::cast(tmp);
+  asm_map["llir"] = tmp;
+  if(llvm->getNamedMetadata("triton.grid_sync"))
+    asm_map["grid_sync"] = "1";
   // LLVM-IR -> HSA-CO
-  std::string path = drv::llir_to_amdgpu(llvm.get(), "gfx908");
-  asm_map["hsaco"] = py::cast(path);
-  return std::make_tuple(name, asm_map, n_shared_bytes);
+  std::string opt_report;
+  asm_map["hsaco"] = drv::llir_to_amdgpu(llvm.get(), arch, llvm_pipeline(ir), &opt_report);
+  if(!opt_report.empty())
+    asm_map["llvm_opt"] = opt_report;
+  return n_shared_bytes;
+}
+
+// HOST
+int host_compile_ttir(ir::module &ir, int num_warps, int num_stages, asm_str_map_t &asm_map){
+  drv::llvm_context_ptr ctx = drv::get_llvm_context();
+  // Triton-IR -> host LLVM-IR
+  triton::codegen::cpu_target target;
+  int n_shared_bytes;
+  auto llvm = triton::codegen::add_passes_to_emit_bin(ir, *ctx, &target, 0, num_warps, num_stages, n_shared_bytes,
+                                                      pass_stats(asm_map), &asm_map["codegen_stats"]);
+  std::string name = ir.get_function_list()[0]->get_name();
+  asm_map["llir"] = drv::llir_to_host(llvm.get(), name);
+  return n_shared_bytes;
+}
+
+// CUDA kernels are compiled for the compute capability `cc`, else for the architecture `arch`
+// (e.g., "sm_80"), else for the one of `device`. AMD kernels are compiled for the GCN
+// architecture `arch`, or for the one of `device` if it is empty
+int compile_ttir(backend_t backend, ir::module &ir, int64_t device, int num_warps, int num_stages,
+                 const std::string& ptxas_path, int ptxas_version,
+                 asm_str_map_t &asm_map, drv::ptxas_info &info, size_t cc = 0,
+                 const std::string& arch = ""){
+  // record asm as we generate
+  std::ostringstream ttir;
+  ir.print(ttir);
+  asm_map["ttir"] = ttir.str();
+  if(backend == CUDA){
+    if(!cc)
+      cc = arch.empty() ? cu_compute_capability(device) : drv::nvidia_cc(arch);
+    return cu_compile_ttir(ir, cc, num_warps, num_stages, ptxas_path, ptxas_version, asm_map, info);
+  }
+  if(backend == ROCM)
+    return hip_compile_ttir(ir, device, arch, num_warps, num_stages, asm_map);
+  if(backend == HOST)
+    return host_compile_ttir(ir, num_warps, num_stages, asm_map);
+  throw std::runtime_error("unsupported backend");
+}
+
+// Compiles `modules` into a few cubins: each module is lowered to LLVM-IR concurrently,
+// then the LLVM-IR of those that share an LLVM pipeline is linked into one module per
+// thread of `pool`, so that LLVM code generation and ptxas run once per chunk of kernels
+// rather than once per kernel. Chunks that fail to compile are compiled again one
+// module at a time, so that a failure only affects its own module
+void cu_compile_ttir_linked(const std::vector<ir::module*>& modules, uint64_t device,
+                            const std::vector<int>& num_warps, const std::vector<int>& num_stages,
+                            const std::string& ptxas_path, int ptxas_version, CUcontext cu_ctx,
+                            ThreadPool& pool, size_t n_threads, std::vector<std::string>& names,
+                            std::vector<asm_str_map_t>& asm_maps, std::vector<drv::ptxas_info>& infos,
+                            std::vector<int>& n_shared_bytes, std::vector<char>& success){
+  size_t n_modules = modules.size();
+  size_t cc = cu_compute_capability(device);
+  // Triton-IR -> LLVM-IR
+  std::vector<std::future<void>> futures;
+  for(size_t i = 0; i < n_modules; i++)
+    futures.push_back(pool.enqueue([&, i](){
+      std::ostringstream ttir;
+      modules[i]->print(ttir);
+      asm_maps[i]["ttir"] = ttir.str();
+      drv::llvm_context_ptr ctx = drv::get_llvm_context();
+      cu_ttir_to_llir(*modules[i], *ctx, cc, num_warps[i], num_stages[i], asm_maps[i], n_shared_bytes[i]);
+    }));
+  // modules are linked with those that have the same pipeline and math mode
+  std::map<std::pair<std::string, bool>, std::vector<size_t>> groups;
+  for(size_t i = 0; i < n_modules; i++){
+    try{
+      futures[i].get();
+      groups[{llvm_pipeline(*modules[i]), modules[i]->get_fast_math()}].push_back(i);
+    }
+    catch(const std::exception&){ }
+  }
+  // LLVM-IR -> cubin
+  auto compile = [&](const std::vector<size_t>& chunk, const std::string& pipeline){
+    std::vector<asm_str_map_t*> chunk_asm_maps;
+    std::vector<std::string*> chunk_names;
+    std::vector<drv::ptxas_info*> chunk_infos;
+    for(size_t i: chunk){
+      chunk_asm_maps.push_back(&asm_maps[i]);
+      chunk_names.push_back(&names[i]);
+      chunk_infos.push_back(&infos[i]);
+    }
+    cu_link_llir_to_cubin(chunk_asm_maps, chunk_names, chunk_infos, pipeline, cc, ptxas_path, ptxas_version);
+    for(size_t i: chunk)
+      success[i] = true;
+  };
+  futures.clear();
+  for(const auto& it: groups){
+    const std::string& pipeline = it.first.first;
+    const std::vector<size_t>& group = it.second;
+    size_t chunk_size = (group.size() + n_threads - 1) / n_threads;
+    for(size_t begin = 0; begin < group.size(); begin += chunk_size){
+      std::vector<size_t> chunk(group.begin() + begin, group.begin() + std::min(begin + chunk_size, group.size()));
+      futures.push_back(pool.enqueue([&, chunk](){
+        // the CUDA context is per-thread state
+        if(cu_ctx)
+          drv::dispatch::cuCtxSetCurrent(cu_ctx);
+        try{
+          compile(chunk, pipeline);
+        }
+        catch(const std::exception&){
+          if(chunk.size() > 1)
+            for(size_t i: chunk)
+              try{ compile({i}, pipeline); } catch(const std::exception&){ }
+        }
+      }));
+    }
+  }
+  for(std::future<void>& future: futures)
+    future.get();
 }
 
 void init_triton_codegen(py::module &&m) {
   m.def(
-      "compile_ttir", [](backend_t backend, ir::module &ir, uint64_t device, int num_warps, int num_stages) {
+      "compile_ttir", [](backend_t backend, ir::module &ir, int64_t device, int num_warps, int num_stages, size_t cc,
+                         const std::string& arch) {
         std::string name = ir.get_function_list()[0]->get_name();
-        // record asm as we generate
-        asm_map_t asm_map;
-        std::ostringstream ttir;
-        ir.print(ttir);
-        asm_map["ttir"] = py::cast(ttir.str());
-        llvm::LLVMContext ctx;
-        if(backend == CUDA)
-          return cu_compile_ttir(name, ir, device, num_warps, num_stages, asm_map);
-        if(backend == ROCM)
-          return hip_compile_ttir(name, ir, device, num_warps, num_stages, asm_map);
-      }, py::return_value_policy::take_ownership);
-  m.def("load_binary", [](backend_t backend, const std::string& name, asm_map_t &asm_map, size_t n_shared_bytes, uint64_t dev){
-	py::gil_scoped_release allow_threads;
+        asm_str_map_t asm_map;
+        drv::ptxas_info info;
+        int n_shared_bytes;
+        {
+          py::gil_scoped_release allow_threads;
+          std::string ptxas_path;
+          int version = 0;
+          if(backend == CUDA)
+            ptxas_path = drv::ptx_assembler(version);
+          n_shared_bytes = compile_ttir(backend, ir, device, num_warps, num_stages, ptxas_path, version, asm_map, info, cc, arch);
+        }
+        return std::make_tuple(name, to_py_asm_map(asm_map), n_shared_bytes, to_py_ptxas_info(info));
+      }, py::arg("backend"), py::arg("ir"), py::arg("device"), py::arg("num_warps"), py::arg("num_stages"),
+      py::arg("cc") = 0, py::arg("arch") = "", py::return_value_policy::take_ownership);
+  // parsers of the architecture names accepted by compile_ttir; they raise ValueError
+  // on malformed names
+  m.def("amdgpu_target", &drv::amdgpu_target);
+  m.def("nvidia_cc", &drv::nvidia_cc);
+  // compiles independent modules concurrently on a pool of `num_threads` threads.
+  // With `link`, CUDA kernels are assembled together into a few cubins (see
+  // `cu_compile_ttir_linked`), and the asm of the kernels of a cubin share its
+  // `bytes` object. Modules that fail to compile are returned as `None`
+  m.def(
+      "compile_ttir_batch", [](backend_t backend, std::vector<ir::module*> modules, int64_t device,
+                               std::vector<int> num_warps, std::vector<int> num_stages, int num_threads,
+                               bool link) {
+        size_t n_modules = modules.size();
+        if(num_warps.size() != n_modules || num_stages.size() != n_modules)
+          throw std::runtime_error("compile_ttir_batch: expected one num_warps and num_stages per module");
+        std::vector<std::string> names;
+        for(ir::module* ir: modules)
+          names.push_back(ir->get_function_list()[0]->get_name());
+        std::vector<asm_str_map_t> asm_maps(n_modules);
+        std::vector<drv::ptxas_info> infos(n_modules);
+        std::vector<int> n_shared_bytes(n_modules);
+        std::vector<char> success(n_modules, false);
+        {
+          py::gil_scoped_release allow_threads;
+          // state shared by all compilations is initialized once, on this thread
+          drv::init_llvm();
+          std::string ptxas_path;
+          int version = 0;
+          CUcontext cu_ctx = nullptr;
+          if(backend == CUDA){
+            ptxas_path = drv::ptx_assembler(version);
+            drv::dispatch::cuCtxGetCurrent(&cu_ctx);
+          }
+          size_t n_threads = std::max<size_t>(1, std::min<size_t>(num_threads, n_modules));
+          ThreadPool pool(n_threads);
+          if(link && backend == CUDA)
+            cu_compile_ttir_linked(modules, device, num_warps, num_stages, ptxas_path, version, cu_ctx,
+                                   pool, n_threads, names, asm_maps, infos, n_shared_bytes, success);
+          else{
+            std::vector<std::future<int>> futures;
+            for(size_t i = 0; i < n_modules; i++)
+              futures.push_back(pool.enqueue([&, i](){
+                // the CUDA context is per-thread state
+                if(cu_ctx)
+                  drv::dispatch::cuCtxSetCurrent(cu_ctx);
+                return compile_ttir(backend, *modules[i], device, num_warps[i], num_stages[i],
+                                    ptxas_path, version, asm_maps[i], infos[i]);
+              }));
+            for(size_t i = 0; i < n_modules; i++){
+              try{
+                n_shared_bytes[i] = futures[i].get();
+                success[i] = true;
+              }
+              catch(const std::exception&){ }
+            }
+          }
+        }
+        py::list ret;
+        std::unordered_map<std::string_view, py::object> images;
+        for(size_t i = 0; i < n_modules; i++){
+          if(success[i])
+            ret.append(py::make_tuple(names[i], to_py_asm_map(asm_maps[i], &images), n_shared_bytes[i],
+                                      to_py_ptxas_info(infos[i])));
+          else
+            ret.append(py::none());
+        }
+        return ret;
+      });
+  // the GIL is released once assembly has been read from `asm_map`
+  m.def("load_binary", [](backend_t backend, const std::string& name, asm_map_t &asm_map, size_t n_shared_bytes, int64_t dev,
+                          int carveout){
+        std::string_view image = load_image(backend, asm_map);
+        py::gil_scoped_release allow_threads;
+        return rt::load_binary(backend, name, image, n_shared_bytes, dev, carveout);
+      }, py::return_value_policy::take_ownership, py::arg("backend"), py::arg("name"), py::arg("asm_map"),
+      py::arg("n_shared_bytes"), py::arg("dev"), py::arg("carveout") = -1);
+  m.def("unload_binary", &rt::unload_binary);
+  // for binaries that share their image: loads it once, then each of their kernels
+  m.def("load_module", [](backend_t backend, asm_map_t &asm_map){
+        std::string_view image = load_image(backend, asm_map);
+        py::gil_scoped_release allow_threads;
+        return rt::load_module(backend, image);
+      });
+  m.def("get_function", [](backend_t backend, uint64_t module, const std::string& name, size_t n_shared_bytes, int64_t dev,
+                           int carveout){
+        py::gil_scoped_release allow_threads;
+        return rt::get_function(backend, module, name, n_shared_bytes, dev, carveout);
+      }, py::arg("backend"), py::arg("module"), py::arg("name"), py::arg("n_shared_bytes"), py::arg("dev"),
+      py::arg("carveout") = -1);
+  // only CUDA kernels report their resources
+  m.def("kernel_resources", [](backend_t backend, uint64_t kernel, int num_threads, size_t n_shared_bytes){
         if(backend == CUDA)
-          return cu_load_binary(name, asm_map, n_shared_bytes, dev);
-        if(backend == ROCM)
-          return hip_load_binary(name, asm_map, n_shared_bytes, dev);
-      }, py::return_value_policy::take_ownership);
+          return cu_kernel_resources(kernel, num_threads, n_shared_bytes);
+        return py::dict();
+      });
+  // overwrites the global variable `name` of a loaded CUDA module with `value`
+  m.def("set_global", [](backend_t backend, uint64_t module, const std::string& name, const std::string& value){
+        if(backend != CUDA)
+          throw std::runtime_error("set_global: only CUDA modules have globals");
+        CUdeviceptr ptr;
+        size_t size;
+        drv::dispatch::cuModuleGetGlobal_v2(&ptr, &size, (CUmodule)module, name.c_str());
+        if(size != value.size())
+          throw std::runtime_error("set_global: " + name + " has " + std::to_string(size) + " bytes");
+        drv::dispatch::cuMemcpyHtoD_v2(ptr, value.data(), size);
+      });
+  // device address of the global variable `name` of a loaded CUDA module
+  m.def("global_address", [](backend_t backend, uint64_t module, const std::string& name) -> uint64_t {
+        if(backend != CUDA)
+          throw std::runtime_error("global_address: only CUDA modules have globals");
+        CUdeviceptr ptr;
+        size_t size;
+        drv::dispatch::cuModuleGetGlobal_v2(&ptr, &size, (CUmodule)module, name.c_str());
+        return ptr;
+      });
 }
 
 
@@ -570,7 +1853,11 @@ void init_triton_ir(py::module &&m) {
       .value("MAX", ir::reduce_inst::MAX)
       .value("FMIN", ir::reduce_inst::FMIN)
       .value("FMAX", ir::reduce_inst::FMAX)
-      .value("XOR", ir::reduce_inst::XOR);
+      .value("XOR", ir::reduce_inst::XOR)
+      .value("ARGMIN", ir::reduce_inst::ARGMIN)
+      .value("ARGMAX", ir::reduce_inst::ARGMAX)
+      .value("ARGFMIN", ir::reduce_inst::ARGFMIN)
+      .value("ARGFMAX", ir::reduce_inst::ARGFMAX);
   
   py::enum_<ir::atomic_rmw_op_t>(m, "ATOMIC_OP")
       .value("ADD", ir::atomic_rmw_op_t::Add)
@@ -584,6 +1871,10 @@ void init_triton_ir(py::module &&m) {
       .value("UMIN", ir::atomic_rmw_op_t::UMin)
       .value("UMAX", ir::atomic_rmw_op_t::UMax);
 
+  py::enum_<ir::mem_scope_t>(m, "MEM_SCOPE")
+      .value("GPU", ir::mem_scope_t::GPU)
+      .value("SYS", ir::mem_scope_t::SYS);
+
   py::class_<ir::context>(m, "context")
       .def(py::init<>());
 
@@ -591,15 +1882,21 @@ void init_triton_ir(py::module &&m) {
       .def("multiple_of", [](ir::value *self, int val) {
         if (auto *instr = dynamic_cast<ir::instruction*>(self)) {
           instr->set_metadata(ir::metadata::multiple_of, val);
-        } else
+        } else if (!dynamic_cast<ir::constant*>(self))
+          // the alignment of constants is known
           throw std::runtime_error("multiple_of");
       })
       .def("max_contiguous", [](ir::value *self, int val) {
         if (auto *instr = dynamic_cast<ir::instruction*>(self)) {
           instr->set_metadata(ir::metadata::max_contiguous, val);
-        } else
+        } else if (!dynamic_cast<ir::constant*>(self))
+          // the alignment of constants is known
           throw std::runtime_error("max_contiguous");
       })
+      .def("set_inline_hint", [](ir::value *self, unsigned hint) {
+        if (auto *call = dynamic_cast<ir::call_inst*>(self))
+          call->set_metadata(ir::metadata::inline_hint, hint);
+      })
       .def("set_fdiv_ieee_rounding", [](ir::value *self, bool val) {
         if (auto *instr = dynamic_cast<ir::binary_operator*>(self))
           instr->set_fdiv_ieee_rounding(val);
@@ -611,12 +1908,16 @@ void init_triton_ir(py::module &&m) {
           return true;
         return false;
       })
+      // values belong to their context, never to Python
       .def("ops", [](ir::value *self) {
         if (auto *instr = dynamic_cast<ir::instruction*>(self)) {
           return instr->ops();
         }
         throw std::runtime_error("cannot use ops()");
-      })
+      }, ret::reference)
+      .def_property_readonly("users", [](ir::value *self) {
+        return std::vector<ir::value*>(self->get_users().begin(), self->get_users().end());
+      }, ret::reference)
       .def("replace_all_uses_with", &ir::value::replace_all_uses_with)
       .def("erase_from_parent", [](ir::value *self) {
         if (auto *instr = dynamic_cast<ir::instruction*>(self))
@@ -730,8 +2031,26 @@ void init_triton_ir(py::module &&m) {
               instr->set_metadata(it->second.first, it->second.second);
             }
     })
+      .def("add_source_file", &ir::module::add_source_file)
+      .def("set_llvm_opt", &ir::module::set_llvm_opt)
+      .def("set_shared_padding", &ir::module::set_shared_padding)
+      .def("set_fast_math", &ir::module::set_fast_math)
+      .def("set_raster", &ir::module::set_raster)
+      .def("set_persistent", &ir::module::set_persistent)
+      .def("set_horizontal", &ir::module::set_horizontal)
+      .def("bitcode", [](ir::module *self) { return py::bytes(ir::write_bitcode(*self)); })
+      .def("text", &ir::write_text)
       .def_property_readonly("builder", &ir::module::get_builder, ret::reference);
 
+  // modules read back belong to Python, and keep their builder alive
+  m.def("read_bitcode", [](py::bytes data, ir::builder &builder) {
+    std::string buf = data;
+    return ir::read_bitcode(buf, builder);
+  }, ret::take_ownership, py::keep_alive<0, 2>());
+  m.def("parse_text", [](const std::string &text, ir::builder &builder) {
+    return ir::parse_text(text, builder);
+  }, ret::take_ownership, py::keep_alive<0, 2>());
+
   using eattr = ir::attribute_kind_t;
   py::enum_<eattr>(m, "attribute_kind")
       .value("readonly", eattr::readonly)
@@ -750,6 +2069,7 @@ void init_triton_ir(py::module &&m) {
       .def_property_readonly("args", &ir::function::args)
       .def_property_readonly("attrs", &ir::function::attrs)
       .def("set_is_kernel", &ir::function::set_is_kernel)
+      .def("set_schedule", &ir::function::set_schedule)
       .def("add_attr", &ir::function::add_attr)
       .def("has_attr", &ir::function::has_attr)
       .def("get_attrs", &ir::function::get_attributes);
@@ -784,6 +2104,9 @@ void init_triton_ir(py::module &&m) {
       .def("ret", &ir::builder::create_ret, ret::reference)
       // insertion block/point, insert points are represented as (*bb, *instr)
       .def("get_insert_block", &ir::builder::get_insert_block, ret::reference)
+      // source location of the next instructions, as (file, line, column)
+      .def("get_loc", &ir::builder::get_loc)
+      .def("set_loc", (void (ir::builder::*)(unsigned, unsigned, unsigned)) & ir::builder::set_loc)
       .def("set_insert_block", (void (ir::builder::*)(ir::basic_block *)) & ir::builder::set_insert_point)
       .def("get_insert_point", [](ir::builder *self) {
         ir::basic_block *bb = self->get_insert_block();
@@ -812,6 +2135,16 @@ void init_triton_ir(py::module &&m) {
       .def("get_float16", &ir::builder::get_float16, ret::reference)
       .def("get_float32", &ir::builder::get_float32, ret::reference)
       .def("get_range", &ir::builder::get_range, ret::reference)
+      .def("get_constant_table", [](ir::builder *self, ir::type *ty, py::list values) -> ir::value* {
+        std::vector<ir::constant*> csts;
+        for(py::handle v: values){
+          if(ty->is_integer_ty())
+            csts.push_back(ir::constant_int::get(ty, v.cast<uint64_t>()));
+          else
+            csts.push_back(ir::constant_fp::get(ty, v.cast<double>()));
+        }
+        return self->get_constant_table(ty, csts);
+      }, ret::reference)
       // Types
       .def("get_void_ty", &ir::builder::get_void_ty, ret::reference)
       .def("get_int1_ty", &ir::builder::get_int1_ty, ret::reference)
@@ -907,6 +2240,7 @@ void init_triton_ir(py::module &&m) {
       .def("create_load", &ir::builder::create_load, ret::reference)
       .def("create_store", &ir::builder::create_store, ret::reference)
       .def("create_masked_load", &ir::builder::create_masked_load, ret::reference)
+      .def("create_tile_load", &ir::builder::create_tile_load, ret::reference)
       .def("create_masked_store", &ir::builder::create_masked_store, ret::reference)
       // Block instruction
       .def("create_splat", &ir::builder::create_splat, ret::reference)
@@ -914,11 +2248,15 @@ void init_triton_ir(py::module &&m) {
       .def("create_cat", &ir::builder::create_cat, ret::reference)
       .def("create_broadcast", &ir::builder::create_broadcast, ret::reference)
       // atomic
-      .def("create_atomic_cas", &ir::builder::create_atomic_cas, ret::reference)
-      .def("create_atomic_rmw", &ir::builder::create_atomic_rmw, ret::reference)
+      .def("create_atomic_cas", &ir::builder::create_atomic_cas, ret::reference,
+           py::arg("ptr"), py::arg("cmp"), py::arg("val"), py::arg("scope") = ir::mem_scope_t::GPU)
+      .def("create_atomic_rmw", &ir::builder::create_atomic_rmw, ret::reference,
+           py::arg("op"), py::arg("ptr"), py::arg("val"), py::arg("msk"), py::arg("scope") = ir::mem_scope_t::GPU)
       // Utilities
       .def("create_clock", &ir::builder::create_clock, ret::reference)
       .def("create_globaltimer", &ir::builder::create_globaltimer, ret::reference)
+      .def("create_grid_sync", &ir::builder::create_grid_sync, ret::reference)
+      .def("create_fence", &ir::builder::create_fence, ret::reference)
 
       // Built-in instruction
       .def("create_get_program_id", &ir::builder::create_get_program_id, ret::reference)
@@ -928,9 +2266,11 @@ void init_triton_ir(py::module &&m) {
       .def("create_sin", &ir::builder::create_sin, ret::reference)
       .def("create_log", &ir::builder::create_log, ret::reference)
       .def("create_dot", &ir::builder::create_dot, ret::reference)
+      .def("create_sparse_dot", &ir::builder::create_sparse_dot, ret::reference)
       .def("create_trans", &ir::builder::create_trans, ret::reference)
       .def("create_sqrt", &ir::builder::create_sqrt, ret::reference)
       .def("create_reduce", &ir::builder::create_reduce, ret::reference)
+      .def("create_scan", &ir::builder::create_scan, ret::reference)
       .def("create_select", &ir::builder::create_select, ret::reference)
       // struct
       .def("insert_value", &ir::builder::create_insert_value, ret::reference)
@@ -938,10 +2278,13 @@ void init_triton_ir(py::module &&m) {
       // Intrinsics
       // These have no place in the IR, and hopefully they can be removed at some point
       .def("create_umulhi", &ir::builder::create_umulhi, ret::reference)
+      .def("create_philox", &ir::builder::create_philox, ret::reference)
+      .def("create_math", &ir::builder::create_math, ret::reference)
       .def("create_copy_to_shared", &ir::builder::create_copy_to_shared, ret::reference)
       .def("create_masked_load_async", &ir::builder::create_masked_load_async, ret::reference)
       .def("create_copy_from_shared", &ir::builder::create_copy_from_shared, ret::reference)
       .def("create_barrier", &ir::builder::create_barrier, ret::reference)
+      .def("create_named_barrier", &ir::builder::create_named_barrier, ret::reference)
       .def("create_async_wait", &ir::builder::create_async_wait, ret::reference)
       .def("create_prefetch_s", &ir::builder::create_prefetch_s, ret::reference);
 }
@@ -0,0 +1,146 @@
+import json
+import os
+import statistics
+import time
+
+import pytest
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+
+#######################
+# Utilities
+#######################
+
+# measured compile times, in ms, per corpus entry and stage. Run with
+# TRITON_UPDATE_COMPILE_TIMES=1 to record the timings of the current machine
+BASELINES_PATH = os.path.join(os.path.dirname(__file__), 'compile_time.json')
+# time of a stage may grow by this factor, plus a fixed slack for short stages
+TOLERANCE = 1.25
+SLACK_MS = 2.
+
+
+def capture(fn):
+    ''' runs `fn` and returns the (kernel, compile arguments) of every kernel it compiles '''
+    compiles = []
+
+    def hook(key, repr, fn, compile, is_manual_warmup, already_compiled):
+        compiles.append((fn, compile))
+        return False
+    prev_hook = triton.code_gen.JITFunction.cache_hook
+    triton.code_gen.JITFunction.cache_hook = hook
+    try:
+        fn()
+    finally:
+        triton.code_gen.JITFunction.cache_hook = prev_hook
+    return compiles
+
+
+def compile_times(fn, compile):
+    ''' compiles a kernel again from its source, and returns the time of each stage in ms '''
+    start = time.perf_counter()
+    context, generator = fn._generate_ttir(compile['arg_types'], compile['attributes'], compile['constants'])
+    frontend = time.perf_counter()
+    backend = triton.code_gen._backend(compile['device'])
+    _, asm, _, _ = _triton.code_gen.compile_ttir(backend, generator.module, compile['device'],
+                                                 compile['num_warps'], compile['num_stages'])
+    end = time.perf_counter()
+    times = {'frontend': (frontend - start) * 1e3, 'total': (end - start) * 1e3}
+    for line in asm.get('stage_times', '').splitlines():
+        stage, us = line.split()
+        times[stage] = float(us) * 1e-3
+    # first table of the pass statistics: one row per run of a pass
+    for line in asm['pass_stats'].split('\n\n')[0].splitlines()[1:]:
+        name, us = line.split()[:2]
+        if us != 'skipped':
+            times['pass.' + name] = times.get('pass.' + name, 0.) + float(us) * 1e-3
+    return times
+
+
+#######################
+# Corpus
+#######################
+
+
+def _matmul():
+    a = torch.randn((512, 512), device='cuda', dtype=torch.float16)
+    kernel = triton.ops._matmul.kernel
+    configs = kernel.configs
+    kernel.configs = [triton.Config({'BLOCK_M': 128, 'BLOCK_N': 128, 'BLOCK_K': 32, 'SPLIT_K': 1}, num_stages=4, num_warps=4)]
+    try:
+        triton.ops.matmul(a, a)
+    finally:
+        kernel.configs = configs
+
+
+def _blocksparse(mode):
+    layout = torch.tril(torch.ones((2, 8, 8), dtype=torch.int64))
+    op = triton.ops.blocksparse.matmul(layout, 32, mode, device='cuda')
+    dense = torch.randn((1, 2, 256, 256), device='cuda', dtype=torch.float16)
+    sparse = torch.randn((1, int(layout.sum()), 32, 32), device='cuda', dtype=torch.float16)
+    a, b = {'sdd': (dense, dense), 'dsd': (sparse, dense), 'dds': (dense, sparse)}[mode]
+    return lambda: op(a, b)
+
+
+def _softmax():
+    layout = torch.tril(torch.ones((2, 8, 8), dtype=torch.int64))
+    op = triton.ops.blocksparse.softmax(layout, 32, device='cuda')
+    x = torch.randn((1, int(layout.sum()), 32, 32), device='cuda', dtype=torch.float16, requires_grad=True)
+    op(x).backward(torch.ones_like(x))
+
+
+def _cross_entropy():
+    x = torch.randn((128, 1024), device='cuda', dtype=torch.float16, requires_grad=True)
+    idx = torch.randint(0, 1024, (128,), device='cuda')
+    triton.ops.cross_entropy(x, idx).backward(torch.ones(128, device='cuda', dtype=torch.float16))
+
+
+corpus = {
+    'matmul': _matmul,
+    'blocksparse_sdd': lambda: _blocksparse('sdd')(),
+    'blocksparse_dsd': lambda: _blocksparse('dsd')(),
+    'blocksparse_dds': lambda: _blocksparse('dds')(),
+    'softmax': _softmax,
+    'cross_entropy': _cross_entropy,
+}
+
+_captured = dict()
+
+
+@pytest.mark.parametrize('name', list(corpus.keys()))
+def test_compile_time(name, monkeypatch):
+    # compile from scratch, with a disabled persistent cache
+    monkeypatch.setenv('TRITON_CACHE_DIR', '')
+    monkeypatch.setenv('TRITON_PASS_STATS', '1')
+    if name not in _captured:
+        _captured[name] = capture(corpus[name])
+    compiles = _captured[name]
+    assert len(compiles) > 0, f'{name} did not compile any kernel'
+    # median of a few replays of all the compilations of the entry
+    runs = []
+    for _ in range(5):
+        total = dict()
+        for fn, compile in compiles:
+            for stage, ms in compile_times(fn, compile).items():
+                total[stage] = total.get(stage, 0.) + ms
+        runs.append(total)
+    times = {stage: statistics.median(run.get(stage, 0.) for run in runs) for stage in runs[0]}
+    baselines = dict()
+    if os.path.exists(BASELINES_PATH):
+        with open(BASELINES_PATH) as f:
+            baselines = json.load(f)
+    if os.environ.get('TRITON_UPDATE_COMPILE_TIMES', '') == '1':
+        baselines[name] = {stage: round(ms, 3) for stage, ms in sorted(times.items())}
+        with open(BASELINES_PATH, 'w') as f:
+            json.dump(baselines, f, indent=2, sort_keys=True)
+        return
+    if name not in baselines:
+        pytest.skip(f'no baseline for {name}; run with TRITON_UPDATE_COMPILE_TIMES=1 to record one')
+    # stages are guarded individually; passes are only reported
+    report = '\n'.join(f'{stage:24} {ms:10.3f} ms (baseline {baselines[name].get(stage, float("nan")):10.3f} ms)'
+                       for stage, ms in sorted(times.items()))
+    for stage in ['frontend', 'ttir_to_llir', 'llir_to_ptx', 'ptx_to_cubin', 'total']:
+        ref = baselines[name].get(stage)
+        if ref is not None:
+            assert times[stage] <= ref * TOLERANCE + SLACK_MS, f'{name}: {stage} regressed\n{report}'
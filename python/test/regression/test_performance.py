@@ -1,27 +1,28 @@
-import subprocess
-import sys
-
 import pytest
 import torch
 
 import triton
 import triton.language as tl
-from triton.testing import get_dram_gbps, get_max_tensorcore_tflops
+from triton.testing import get_dram_gbps, get_max_tensorcore_tflops, nvsmi
+
+
+def _device_name():
+    # reference numbers are per device: others are covered by bench/roofline.py
+    if not torch.cuda.is_available():
+        return None
+    name = torch.cuda.get_device_name().lower()
+    return next((device for device in ['v100', 'a100'] if device in name), None)
+
 
-DEVICE_NAME = 'v100'
+DEVICE_NAME = _device_name()
 
 #######################
 # Utilities
 #######################
 
 
-def nvsmi(attrs):
-    attrs = ','.join(attrs)
-    cmd = ['nvidia-smi', '-i', '0', '--query-gpu=' + attrs, '--format=csv,noheader,nounits']
-    out = subprocess.check_output(cmd)
-    ret = out.decode(sys.stdout.encoding).split(',')
-    ret = [int(x) for x in ret]
-    return ret
+# measurements are discarded if the clocks move by more than this during a benchmark
+MAX_CLOCK_DRIFT = 0.01
 
 
 #######################
@@ -79,7 +80,7 @@ matmul_data = {
 
 @pytest.mark.parametrize('M, N, K, dtype_str',
                          [(M, N, K, dtype_str)
-                          for M, N, K in matmul_data[DEVICE_NAME].keys()
+                          for M, N, K in matmul_data.get(DEVICE_NAME, {}).keys()
                           for dtype_str in ['float16']])
 def test_matmul(M, N, K, dtype_str):
     if dtype_str in ['float32', 'int8'] and DEVICE_NAME != 'a100':
@@ -99,7 +100,7 @@ def test_matmul(M, N, K, dtype_str):
         a = torch.randn((M, K), dtype=dtype, device='cuda')
         b = torch.randn((K, N), dtype=dtype, device='cuda')
     fn = lambda: triton.ops.matmul(a, b)
-    ms = triton.testing.do_bench(fn, percentiles=None, warmup=25, rep=1000)
+    ms = triton.testing.do_bench(fn, percentiles=None, warmup=25, rep=1000, max_clock_drift=MAX_CLOCK_DRIFT)
     cur_gpu_perf = 2. * M * N * K / ms * 1e-9
     cur_gpu_util = cur_gpu_perf / max_gpu_perf
     triton.testing.assert_almost_equal(cur_gpu_util, ref_gpu_util, decimal=2)
@@ -145,7 +146,7 @@ elementwise_data = {
 }
 
 
-@pytest.mark.parametrize('N', elementwise_data[DEVICE_NAME].keys())
+@pytest.mark.parametrize('N', elementwise_data.get(DEVICE_NAME, {}).keys())
 def test_elementwise(N):
     torch.manual_seed(0)
     ref_gpu_util = elementwise_data[DEVICE_NAME][N]
@@ -158,7 +159,7 @@ def test_elementwise(N):
     y = torch.randn_like(z)
     grid = lambda args: (triton.cdiv(N, args['BLOCK_SIZE']), )
     fn = lambda: _add[grid](x, y, z, N, BLOCK_SIZE=1024)
-    ms = triton.testing.do_bench(fn, percentiles=None, warmup=25, rep=250)
+    ms = triton.testing.do_bench(fn, percentiles=None, warmup=25, rep=250, max_clock_drift=MAX_CLOCK_DRIFT)
     cur_gpu_perf = 3. * N * z.element_size() / ms * 1e-6
     cur_gpu_util = cur_gpu_perf / max_gpu_perf
     triton.testing.assert_almost_equal(cur_gpu_util, ref_gpu_util, decimal=2)
@@ -1,5 +1,7 @@
 # flake8: noqa: F821,F841
+import inspect
 import itertools
+import os
 import re
 from typing import Optional, Union
 
@@ -260,6 +262,26 @@ def test_floordiv(dtype_x, dtype_y, device='cuda'):
     _test_binary(dtype_x, dtype_y, expr, numpy_expr, device=device)
 
 
+def test_bin_op_f16x2(device='cuda'):
+    # fp16 arithmetic runs on pairs of values held by the same thread
+    @triton.jit
+    def kernel(X, Y, Z, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        x = tl.load(X + off)
+        y = tl.load(Y + off)
+        z = x * y - x
+        tl.store(Z + off, tl.where(z > x, z, x + y))
+
+    x = torch.randn(1024, dtype=torch.float16, device=device)
+    y = torch.randn(1024, dtype=torch.float16, device=device)
+    z = torch.empty_like(x)
+    pgm = kernel[(1,)](x, y, z, BLOCK=1024)
+    ref = x * y - x
+    ref = torch.where(ref > x, ref, x + y)
+    triton.testing.assert_almost_equal(z, ref)
+    assert 'f16x2' in pgm.asm['ptx']
+
+
 # ---------------
 # test bitwise ops
 # ---------------
@@ -359,6 +381,38 @@ def test_math_op(expr, device='cuda'):
     _test_unary('float32', f'tl.{expr}(x)', f'np.{expr}(x) ', device=device)
 
 
+@pytest.mark.parametrize("dtype_str, expr, fast_math", [
+    (dtype_str, expr, fast_math)
+    for dtype_str in ['float16', 'float32', 'float64']
+    for expr in ['erf', 'tanh', 'rsqrt', 'pow']
+    for fast_math in [False, True]
+])
+def test_library_math_op(dtype_str, expr, fast_math, device='cuda'):
+    # erf, tanh, rsqrt and pow are linked from libdevice
+    @triton.jit
+    def kernel(Z, X, Y, SIZE: tl.constexpr):
+        off = tl.arange(0, SIZE)
+        x = tl.load(X + off)
+        y = tl.load(Y + off)
+        z = GENERATE_TEST_HERE
+        tl.store(Z + off, z)
+
+    args = {'erf': 'x', 'tanh': 'x', 'rsqrt': 'x', 'pow': 'x, y'}[expr]
+    kernel = patch_kernel(kernel, {'GENERATE_TEST_HERE': f'tl.{expr}({args})'})
+    kernel.fast_math = fast_math
+    dtype = getattr(torch, dtype_str)
+    x = torch.rand(128, dtype=dtype, device=device) + 0.1
+    y = torch.randn(128, dtype=dtype, device=device)
+    z = torch.empty_like(x)
+    pgm = kernel[(1,)](z, x, y, SIZE=128)
+    ref = {'erf': torch.erf, 'tanh': torch.tanh, 'rsqrt': torch.rsqrt, 'pow': torch.pow}[expr]
+    ref = ref(*[v.float() if dtype == torch.float16 else v for v in [x, y][:len(args.split(','))]])
+    approx = fast_math or dtype == torch.float16
+    torch.testing.assert_close(z, ref.to(dtype), rtol=1e-2 if approx else 1e-5, atol=1e-3 if approx else 1e-6)
+    if fast_math and expr == 'tanh' and dtype == torch.float16 and torch.cuda.get_device_capability()[0] >= 8:
+        assert 'tanh.approx.f16x2' in pgm.asm['ptx']
+
+
 # ----------------
 # test indexing
 # ----------------
@@ -514,6 +568,64 @@ def test_atomic_rmw(op, dtype_x_str, mode, device='cuda'):
         np.testing.assert_allclose(z_ref, to_numpy(z_tri), rtol=0.01)
 
 
+@pytest.mark.parametrize("dtype_str, n_cols, group", [
+    (dtype, n_cols, group)
+    for dtype in ['float32', 'float16', 'int32']
+    for n_cols in [64, 256]
+    for group in [1, 4, 16]
+])
+def test_atomic_add_scatter(dtype_str, n_cols, group, device='cuda'):
+    # the result of the atomics is unused, and `group` consecutive columns
+    # accumulate into the same address
+    @triton.jit
+    def kernel(X, Z, N, BLOCK: tl.constexpr, GROUP: tl.constexpr):
+        pid = tl.program_id(0)
+        off = tl.arange(0, BLOCK)
+        x = tl.load(X + pid * BLOCK + off)
+        tl.atomic_add(Z + off // GROUP, x, mask=off < N)
+
+    n_rows = 8
+    n_valid = n_cols - 3
+    rs = RandomState(17)
+    x = numpy_random((n_rows, n_cols), dtype_str=dtype_str, rs=rs)
+    if dtype_str == 'int32':
+        x = x % 128
+    z = np.zeros((n_cols // group,), dtype=x.dtype)
+    x_tri = to_triton(x, device=device)
+    z_tri = to_triton(z, device=device)
+    kernel[(n_rows,)](x_tri, z_tri, n_valid, BLOCK=n_cols, GROUP=group)
+    x_ref = x.astype(np.float64)
+    x_ref[:, n_valid:] = 0
+    z_ref = x_ref.sum(axis=0).reshape(-1, group).sum(axis=1)
+    rtol = 1e-2 if dtype_str == 'float16' else 1e-4
+    np.testing.assert_allclose(z_ref, to_numpy(z_tri).astype(np.float64), rtol=rtol, atol=rtol)
+
+
+@pytest.mark.parametrize("use_result", [False, True])
+def test_atomic_add_bf16(use_result, device='cuda'):
+    # atom.add.bf16 needs sm_90: earlier targets loop on a compare-and-swap
+    @triton.jit
+    def kernel(X, Z, Old, BLOCK: tl.constexpr, USE_RESULT: tl.constexpr):
+        pid = tl.program_id(0)
+        off = tl.arange(0, BLOCK)
+        old = tl.atomic_add(Z + off, tl.load(X + pid * BLOCK + off))
+        if USE_RESULT:
+            tl.store(Old + pid * BLOCK + off, old)
+
+    n_programs, BLOCK = 16, 128
+    # integers are exact in bfloat16 up to 256, whatever the order of the additions
+    x = torch.randint(-4, 5, (n_programs, BLOCK), device=device).to(torch.bfloat16)
+    z = torch.zeros(BLOCK, dtype=torch.bfloat16, device=device)
+    old = torch.empty_like(x)
+    kernel[(n_programs,)](x, z, old, BLOCK=BLOCK, USE_RESULT=use_result)
+    assert torch.equal(z, x.float().sum(0).to(torch.bfloat16))
+    if use_result:
+        # the additions to each address form a chain from 0 to the final value
+        before = torch.cat([old.float(), z.float()[None, :]]).sort(0).values
+        after = torch.cat([torch.zeros_like(z.float())[None, :], old.float() + x.float()]).sort(0).values
+        assert torch.equal(before, after)
+
+
 # ---------------
 # test cast
 # ---------------
@@ -589,6 +701,32 @@ def test_f8_f16_roundtrip():
     assert torch.all(f8_tensor == f8_output_tensor)
 
 
+@pytest.mark.parametrize("dtype_z, BLOCK, num_warps", [
+    (dtype_z, BLOCK, num_warps)
+    for dtype_z in ['float16', 'bfloat16', 'float8']
+    for BLOCK, num_warps in [(32, 1), (64, 1), (1024, 4)]
+])
+def test_cast_block(dtype_z, BLOCK, num_warps, device='cuda'):
+    # values are converted by pairs or by 4, whatever the number that each thread holds
+    @triton.jit
+    def kernel(X, Z, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        tl.store(Z + off, tl.load(X + off))
+
+    x = torch.rand(BLOCK, device=device) * 3 - 1.5
+    if dtype_z == 'float8':
+        z = torch.empty(BLOCK, dtype=torch.int8, device=device)
+        kernel[(1,)](x, triton.reinterpret(z, tl.float8), BLOCK=BLOCK, num_warps=num_warps)
+        y = torch.empty(BLOCK, dtype=torch.float16, device=device)
+        kernel[(1,)](triton.reinterpret(z, tl.float8), y, BLOCK=BLOCK, num_warps=num_warps)
+        # 3 bits of mantissa
+        assert torch.all((y.float() - x).abs() <= x.abs() / 16 + 2**-9)
+    else:
+        z = torch.empty(BLOCK, dtype=getattr(torch, dtype_z), device=device)
+        kernel[(1,)](x, z, BLOCK=BLOCK, num_warps=num_warps)
+        assert torch.equal(z, x.to(z.dtype))
+
+
 def test_f16_to_f8_rounding():
     """Takes all float16s, converts them to float8 and back to float16. Checks that the absolute
     error is the minimum over all float8.
@@ -676,6 +814,34 @@ def test_reduce1d(dtype_str, shape, device='cuda'):
     np.testing.assert_allclose(z_ref, to_numpy(z_tri), rtol=0.01)
 
 
+@pytest.mark.parametrize("op, shape, upcast", [
+    (op, shape, upcast)
+    for op in ['sum', 'max', 'min']
+    for shape in [32, 128, 1024]
+    for upcast in [False, True]
+])
+def test_reduce1d_fp16(op, shape, upcast, device='cuda'):
+    # fp16 partials are shuffled in pairs unless the input is explicitly upcast
+    @triton.jit
+    def kernel(X, Z, BLOCK: tl.constexpr, OP: tl.constexpr, UPCAST: tl.constexpr):
+        x = tl.load(X + tl.arange(0, BLOCK))
+        if UPCAST:
+            x = x.to(tl.float32)
+        if OP == 'sum':
+            z = tl.sum(x, axis=0)
+        if OP == 'max':
+            z = tl.max(x, axis=0)
+        if OP == 'min':
+            z = tl.min(x, axis=0)
+        tl.store(Z, z)
+
+    x = torch.randn(shape, dtype=torch.float16, device=device)
+    z = torch.empty(1, dtype=torch.float32 if upcast else torch.float16, device=device)
+    kernel[(1,)](x, z, BLOCK=shape, OP=op, UPCAST=upcast)
+    z_ref = getattr(torch, op)(x.float())
+    triton.testing.assert_almost_equal(z[0].float(), z_ref, decimal=0 if op == 'sum' and not upcast else 2)
+
+
 @pytest.mark.parametrize("dtype_str, shape, axis", [
     (dtype, (1, 1024), 1) for dtype in ['float32', 'uint32']
 ])
@@ -699,6 +865,96 @@ def test_reduce2d(dtype_str, shape, axis, device='cuda'):
     # compare
     np.testing.assert_allclose(z_ref, to_numpy(z_tri), rtol=0.01)
 
+
+@pytest.mark.parametrize("op, dtype_str, shape, axis", [
+    (op, dtype, shape, axis)
+    for op in ['argmin', 'argmax']
+    for dtype in ['float32', 'float16', 'int32']
+    for shape, axis in [((1024,), 0), ((32, 64), 1), ((64, 32), 0)]
+])
+def test_arg_reduce(op, dtype_str, shape, axis, device='cuda'):
+    @triton.jit
+    def kernel(X, Z, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, AXIS: tl.constexpr, OP: tl.constexpr):
+        range_m = tl.arange(0, BLOCK_M)
+        range_n = tl.arange(0, BLOCK_N)
+        if BLOCK_M == 1:
+            x = tl.load(X + range_n)
+        else:
+            x = tl.load(X + range_m[:, None] * BLOCK_N + range_n[None, :])
+        if OP == 'argmin':
+            z = tl.argmin(x, axis=AXIS)
+        if OP == 'argmax':
+            z = tl.argmax(x, axis=AXIS)
+        if BLOCK_M == 1:
+            tl.store(Z, z)
+        elif AXIS == 1:
+            tl.store(Z + range_m, z)
+        else:
+            tl.store(Z + range_n, z)
+
+    shape_2d = shape if len(shape) == 2 else (1, shape[0])
+    rs = RandomState(17)
+    # few distinct values, so that ties pick the first index
+    x = (numpy_random(shape, dtype_str='int32', rs=rs) % 16).astype(dtype_str)
+    x_tri = to_triton(x, device=device)
+    z_tri = to_triton(np.empty((shape_2d[1 - axis] if len(shape) == 2 else 1,), dtype=np.int32), device=device)
+    kernel[(1,)](x_tri, z_tri, BLOCK_M=shape_2d[0], BLOCK_N=shape_2d[1], AXIS=axis, OP=op)
+    z_ref = np.reshape(getattr(np, op)(x, axis=axis), (-1,)).astype(np.int32)
+    np.testing.assert_equal(z_ref, to_numpy(z_tri))
+
+
+@pytest.mark.parametrize("num_stages", [1, 2, 4])
+def test_reduce_loop_pipelined(num_stages, device='cuda'):
+    # loads that feed reductions and elementwise math are prefetched in registers
+    @triton.jit
+    def kernel(X, Z, N, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        x_ptrs = X + off
+        acc = tl.zeros((BLOCK,), dtype=tl.float32)
+        for n in range(0, N, BLOCK):
+            x = tl.load(x_ptrs, mask=off < N - n, other=0.)
+            acc += x * x
+            x_ptrs += BLOCK
+        tl.store(Z, tl.sum(acc, axis=0))
+
+    x = torch.randn(4000, dtype=torch.float32, device=device)
+    z = torch.empty(1, dtype=torch.float32, device=device)
+    kernel[(1,)](x, z, x.numel(), BLOCK=256, num_stages=num_stages)
+    triton.testing.assert_almost_equal(z, (x * x).sum())
+
+
+@pytest.mark.parametrize("dtype_str, shape, axis, exclusive", [
+    (dtype, shape, axis, exclusive)
+    for dtype in ['float32', 'int32']
+    for shape, axis in [((1024,), 0), ((32, 64), 1), ((64, 32), 0), ((8, 512), 1)]
+    for exclusive in [False, True]
+])
+def test_cumsum(dtype_str, shape, axis, exclusive, device='cuda'):
+    @triton.jit
+    def kernel(X, Z, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, AXIS: tl.constexpr, EXCLUSIVE: tl.constexpr):
+        range_m = tl.arange(0, BLOCK_M)
+        range_n = tl.arange(0, BLOCK_N)
+        offs = range_m[:, None] * BLOCK_N + range_n[None, :]
+        x = tl.load(X + offs)
+        tl.store(Z + offs, tl.cumsum(x, axis=AXIS, exclusive=EXCLUSIVE))
+
+    shape_2d = shape if len(shape) == 2 else (1, shape[0])
+    axis_2d = axis if len(shape) == 2 else 1
+    rs = RandomState(17)
+    x = numpy_random(shape_2d, dtype_str=dtype_str, rs=rs)
+    if dtype_str == 'int32':
+        x = x % 64
+    # numpy result
+    z_ref = np.cumsum(x, axis=axis_2d).astype(x.dtype)
+    if exclusive:
+        z_ref = z_ref - x
+    # triton result
+    x_tri = to_triton(x, device=device)
+    z_tri = to_triton(np.empty_like(x), device=device)
+    kernel[(1,)](x_tri, z_tri, BLOCK_M=shape_2d[0], BLOCK_N=shape_2d[1], AXIS=axis_2d, EXCLUSIVE=exclusive)
+    # compare
+    np.testing.assert_allclose(z_ref, to_numpy(z_tri), rtol=1e-3, atol=1e-2)
+
 # ---------------
 # test permute
 # ---------------
@@ -824,6 +1080,176 @@ def test_dot(epilogue, allow_tf32, dtype, device='cuda'):
         assert 'mma.sync.aligned.m16n8k8.row.col.f32.tf32.tf32.f32' not in ptx
     elif dtype == 'int8':
         assert 'mma.sync.aligned.m16n8k32.row.col.satfinite.s32.s8.s8.s32' in ptx
+    if dtype == 'float16' and cc >= 90:
+        # fp16 accumulators are staged in shared memory by stmatrix, transposed for column-major outputs
+        stmatrix = [line for line in ptx.splitlines() if 'stmatrix.sync.aligned' in line]
+        assert stmatrix
+        assert all(('.trans' in line) == (epilogue == 'trans') for line in stmatrix)
+
+
+@pytest.mark.parametrize("trans_a, trans_b", [(False, False), (False, True), (True, False), (True, True)])
+def test_dot_fma_swizzle(trans_a, trans_b, device='cuda'):
+    # fp32 dots without tf32 read their operands with FMAs; operands that are read
+    # along their strided dimension are swizzled in shared memory
+    @triton.jit
+    def kernel(X, stride_xm, stride_xk, Y, stride_yk, stride_yn, Z):
+        off_m = tl.arange(0, 64)
+        off_n = tl.arange(0, 64)
+        off_k = tl.arange(0, 32)
+        x = tl.load(X + off_m[:, None] * stride_xm + off_k[None, :] * stride_xk)
+        y = tl.load(Y + off_k[:, None] * stride_yk + off_n[None, :] * stride_yn)
+        z = tl.dot(x, y, allow_tf32=False)
+        tl.store(Z + off_m[:, None] * 64 + off_n[None, :], z)
+
+    x = torch.randn((32, 64), device=device).t() if trans_a else torch.randn((64, 32), device=device)
+    y = torch.randn((64, 32), device=device).t() if trans_b else torch.randn((32, 64), device=device)
+    z = torch.empty((64, 64), device=device)
+    kernel[(1,)](x, x.stride(0), x.stride(1), y, y.stride(0), y.stride(1), z)
+    triton.testing.assert_almost_equal(z, torch.matmul(x, y), decimal=3)
+
+
+@pytest.mark.parametrize("M, N, K", [(64, 64, 8), (16, 64, 8), (64, 8, 32)])
+def test_dot_fma_fp16(M, N, K, device='cuda'):
+    # fp16 tiles smaller than an mma instruction are multiplied with FMAs
+    @triton.jit
+    def kernel(X, Y, Z, M: tl.constexpr, N: tl.constexpr, K: tl.constexpr):
+        off_m = tl.arange(0, M)
+        off_n = tl.arange(0, N)
+        off_k = tl.arange(0, K)
+        x = tl.load(X + off_m[:, None] * K + off_k[None, :])
+        y = tl.load(Y + off_k[:, None] * N + off_n[None, :])
+        tl.store(Z + off_m[:, None] * N + off_n[None, :], tl.dot(x, y))
+
+    x = torch.randn((M, K), dtype=torch.float16, device=device)
+    y = torch.randn((K, N), dtype=torch.float16, device=device)
+    z = torch.empty((M, N), dtype=torch.float32, device=device)
+    kernel[(1,)](x, y, z, M=M, N=N, K=K)
+    triton.testing.assert_almost_equal(z, torch.matmul(x.float(), y.float()), decimal=2)
+
+
+@pytest.mark.parametrize("M, N, K", [(64, 64, 64), (128, 64, 32), (16, 64, 8)])
+def test_dot_acc_fp16(M, N, K, device='cuda'):
+    # tensor cores or FMAs (for tiles smaller than an instruction), accumulating in fp16
+    @triton.jit
+    def kernel(X, Y, Z, M: tl.constexpr, N: tl.constexpr, K: tl.constexpr):
+        off_m = tl.arange(0, M)
+        off_n = tl.arange(0, N)
+        off_k = tl.arange(0, K)
+        x = tl.load(X + off_m[:, None] * K + off_k[None, :])
+        y = tl.load(Y + off_k[:, None] * N + off_n[None, :])
+        z = tl.dot(x, y, acc_dtype=tl.float16)
+        z += tl.dot(x, y, acc_dtype=tl.float16)
+        tl.store(Z + off_m[:, None] * N + off_n[None, :], z)
+
+    x = torch.randn((M, K), dtype=torch.float16, device=device) / 4
+    y = torch.randn((K, N), dtype=torch.float16, device=device) / 4
+    z = torch.empty((M, N), dtype=torch.float16, device=device)
+    kernel[(1,)](x, y, z, M=M, N=N, K=K)
+    triton.testing.assert_almost_equal(z.float(), 2 * torch.matmul(x.float(), y.float()), decimal=2)
+
+
+def test_dot_acc_fp16_requires_fp16():
+    @triton.jit
+    def kernel(X, Z):
+        off = tl.arange(0, 32)
+        x = tl.load(X + off[:, None] * 32 + off[None, :])
+        tl.store(Z + off[:, None] * 32 + off[None, :], tl.dot(x, x, acc_dtype=tl.float16))
+
+    x = torch.randn((32, 32), dtype=torch.float32, device='cuda')
+    with pytest.raises(triton.code_gen.CompilationError):
+        kernel[(1,)](x, torch.empty_like(x))
+
+
+@pytest.mark.parametrize("arch, mfma", [('gfx90a', True), ('gfx908', True), ('gfx906', False)])
+def test_dot_mfma(arch, mfma):
+    # compiled for an AMD GPU of architecture `arch`, without a device
+    @triton.jit
+    def kernel(X, Y, Z, M: tl.constexpr, N: tl.constexpr, K: tl.constexpr):
+        off_m = tl.arange(0, M)
+        off_n = tl.arange(0, N)
+        off_k = tl.arange(0, K)
+        x = tl.load(X + off_m[:, None] * K + off_k[None, :])
+        y = tl.load(Y + off_k[:, None] * N + off_n[None, :])
+        tl.store(Z + off_m[:, None] * N + off_n[None, :], tl.dot(x, y))
+
+    arg_types = [('ptr', 'f16'), ('ptr', 'f16'), ('ptr', 'f32')]
+    _, generator = kernel._generate_ttir(arg_types, {0: 16, 1: 16, 2: 16}, {3: 64, 4: 64, 5: 64})
+    backend = _triton.runtime.backend.ROCM
+    _, asm, _, _ = _triton.code_gen.compile_ttir(backend, generator.module, 0, 4, 1, arch=arch)
+    assert ('llvm.amdgcn.mfma.f32.32x32x8f16' in asm['llir']) == mfma
+
+
+def test_amdgpu_link():
+    # the relocatable object of a gfx90a kernel is linked (in-process, when built with lld)
+    # into a shared HSA code object, without a device
+    @triton.jit(llvm_opt='fast')
+    def kernel(X, Y, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        tl.store(Y + off, tl.load(X + off) + 1)
+
+    arg_types = [('ptr', 'f32'), ('ptr', 'f32')]
+    _, generator = kernel._generate_ttir(arg_types, {0: 16, 1: 16}, {2: 64})
+    backend = _triton.runtime.backend.ROCM
+    name, asm, _, _ = _triton.code_gen.compile_ttir(backend, generator.module, 0, 4, 1, arch='gfx90a')
+    hsaco = bytes(asm['hsaco'])
+    # ELF shared object (ET_DYN) for EM_AMDGPU, which exports the kernel
+    assert hsaco[:4] == b'\x7fELF'
+    assert int.from_bytes(hsaco[16:18], 'little') == 3
+    assert int.from_bytes(hsaco[18:20], 'little') == 224
+    assert name.encode() in hsaco
+    assert asm['llvm_opt'] and asm['llvm_opt'] != asm['llir']
+
+
+@pytest.mark.parametrize("backend_name", ['ROCM', 'CUDA'])
+def test_reduce_shuffles(backend_name):
+    # butterflies within a warp exchange registers: through DPP and ds_swizzle
+    # on AMD GPUs (without a device), and through shfl.sync on NVIDIA GPUs
+    @triton.jit
+    def kernel(X, Z, BLOCK: tl.constexpr):
+        tl.store(Z, tl.sum(tl.load(X + tl.arange(0, BLOCK)), axis=0))
+
+    arg_types = [('ptr', 'f32'), ('ptr', 'f32')]
+    _, generator = kernel._generate_ttir(arg_types, {0: 16, 1: 16}, {2: 1024})
+    backend = getattr(_triton.runtime.backend, backend_name)
+    if backend_name == 'ROCM':
+        _, asm, _, _ = _triton.code_gen.compile_ttir(backend, generator.module, 0, 4, 1, arch='gfx90a')
+        assert 'llvm.amdgcn.update.dpp' in asm['llir']
+        assert 'llvm.amdgcn.ds.swizzle' in asm['llir']
+    else:
+        _, asm, _, _ = _triton.code_gen.compile_ttir(backend, generator.module, 0, 4, 1, arch='sm_80')
+        assert 'shfl.sync.bfly' in asm['ptx']
+
+
+@pytest.mark.parametrize("arch, target", [
+    ('gfx906', ('gfx906', '')),
+    ('gfx90a', ('gfx90a', '')),
+    ('gfx1030', ('gfx1030', '')),
+    ('gfx90a:xnack+', ('gfx90a', '+xnack')),
+    ('gfx90a:sramecc+:xnack-', ('gfx90a', '+sramecc,-xnack')),
+    # malformed
+    ('', None), ('gfx', None), ('gfx9', None), ('GFX90A', None), ('gfx90a:', None),
+    ('gfx90a:xnack', None), ('gfx90a:+xnack', None), ('gfx90a:sramecc+:', None), ('sm_80', None),
+])
+def test_amdgpu_arch(arch, target):
+    if target is None:
+        with pytest.raises(ValueError):
+            _triton.code_gen.amdgpu_target(arch)
+    else:
+        assert _triton.code_gen.amdgpu_target(arch) == target
+
+
+@pytest.mark.parametrize("arch, cc", [
+    ('sm_70', 70), ('sm_80', 80), ('sm_90', 90),
+    # malformed
+    ('', None), ('sm_', None), ('sm80', None), ('sm_8', None), ('sm_08', None),
+    ('sm_80a', None), ('compute_80', None), ('gfx90a', None),
+])
+def test_nvidia_arch(arch, cc):
+    if cc is None:
+        with pytest.raises(ValueError):
+            _triton.code_gen.nvidia_cc(arch)
+    else:
+        assert _triton.code_gen.nvidia_cc(arch) == cc
 
 
 def test_dot_without_load():
@@ -840,6 +1266,139 @@ def test_dot_without_load():
     out = torch.ones((32, 32), dtype=torch.float32, device="cuda")
     kernel[(1,)](out)
 
+
+def test_dot_disjoint_shared_buffers(device='cuda'):
+    # `w` is written to shared memory while the buffers of `x` and `y`, just read by the
+    # first dot, are still live: it cannot overlap them, so it needs no barrier
+    @triton.jit
+    def kernel(X, Y, Z, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        idx = off[:, None] * BLOCK + off[None, :]
+        x = tl.load(X + idx)
+        y = tl.load(Y + idx)
+        z = tl.dot(x, y)
+        w = z.to(tl.float16)
+        z += tl.dot(w, y) + tl.dot(x, w)
+        tl.store(Z + idx, z)
+
+    if torch.cuda.get_device_capability()[0] < 8:
+        pytest.skip("requires mma.sync (sm80+)")
+    x = torch.randn((32, 32), dtype=torch.float16, device=device)
+    y = torch.randn((32, 32), dtype=torch.float16, device=device)
+    z = torch.empty((32, 32), dtype=torch.float32, device=device)
+    pgm = kernel[(1,)](x, y, z, BLOCK=32)
+    z_ref = torch.matmul(x.float(), y.float())
+    w_ref = z_ref.half().float()
+    z_ref += torch.matmul(w_ref, y.float()) + torch.matmul(x.float(), w_ref)
+    triton.testing.assert_almost_equal(z, z_ref, decimal=1)
+    # the first dot and the store of `w` to shared memory run between the same two barriers
+    sections = re.split(r'\bbar(?:rier)?\.sync\b', pgm.asm['ptx'])
+    assert any('mma.sync' in section and 'st.shared' in section for section in sections)
+
+
+def test_named_barrier():
+    # named barriers only wait for their number of threads
+    context = _triton.ir.context()
+    builder = _triton.ir.builder(context)
+    module = _triton.ir.module('', builder)
+    fn_ty = _triton.ir.type.make_function(builder.get_void_ty(), [])
+    fn = module.get_or_insert_function('kernel', fn_ty)
+    builder.set_insert_block(_triton.ir.basic_block.create(context, 'entry', fn))
+    builder.create_named_barrier(3, 64)
+    builder.create_barrier('')
+    builder.create_ret_void()
+    backend = _triton.runtime.backend.CUDA
+    _, asm, _, _ = _triton.code_gen.compile_ttir(backend, module, 0, 4, 1, cc=80)
+    assert re.search(r'\bbar(rier)?\.sync\s+3, 64;', asm['ptx'])
+    assert re.search(r'\bbar(rier)?\.sync\s+0;', asm['ptx'])
+    # and are a positive multiple of warps
+    with pytest.raises(RuntimeError):
+        builder.create_named_barrier(1, 48)
+
+
+@triton.jit
+def _two_dots(A, B, C, D, Z, K, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr,
+              SHARED: tl.constexpr):
+    rm = tl.arange(0, BLOCK_M)
+    rn = tl.arange(0, BLOCK_N)
+    rk = tl.arange(0, BLOCK_K)
+    a_ptrs = A + rm[:, None] * K + rk[None, :]
+    b_ptrs = B + rk[:, None] * BLOCK_N + rn[None, :]
+    c_ptrs = C + rm[:, None] * K + rk[None, :]
+    d_ptrs = D + rk[:, None] * BLOCK_N + rn[None, :]
+    acc0 = tl.zeros((BLOCK_M, BLOCK_N), dtype=tl.float32)
+    acc1 = tl.zeros((BLOCK_M, BLOCK_N), dtype=tl.float32)
+    for k in range(0, K, BLOCK_K):
+        a = tl.load(a_ptrs)
+        c = a if SHARED else tl.load(c_ptrs)
+        acc0 += tl.dot(a, tl.load(b_ptrs))
+        acc1 += tl.dot(c, tl.load(d_ptrs))
+        a_ptrs += BLOCK_K
+        b_ptrs += BLOCK_K * BLOCK_N
+        c_ptrs += BLOCK_K
+        d_ptrs += BLOCK_K * BLOCK_N
+    tl.store(Z + rm[:, None] * BLOCK_N + rn[None, :], acc0 + acc1)
+
+
+@pytest.mark.parametrize("BLOCK_M, BLOCK_N, SHARED, n_prefetched", [
+    (64, 64, False, 2),
+    # the operand of both dots is prefetched once, by the first one
+    (64, 64, True, 1),
+    # the accumulators take all the registers of a thread
+    (128, 256, False, 0),
+])
+def test_dot_prefetch(BLOCK_M, BLOCK_N, SHARED, n_prefetched):
+    # dots of the same loop prefetch the next k-slice of their operands within
+    # a register budget (compiled for sm_80, without a device)
+    arg_types = [('ptr', 'f16')] * 4 + [('ptr', 'f32'), ('scalar', 'i32')]
+    attributes = {i: 16 for i in range(5)}
+    constants = {6: BLOCK_M, 7: BLOCK_N, 8: 32, 9: SHARED}
+    _, generator = _two_dots._generate_ttir(arg_types, attributes, constants)
+    backend = _triton.runtime.backend.CUDA
+    _triton.code_gen.compile_ttir(backend, generator.module, 0, 4, 2, cc=80)
+    # each prefetched dot loads both of its operands before and in the loop
+    lines = generator.module.text().splitlines()
+    assert sum(line.startswith('prefetch_s') for line in lines) == 4 * n_prefetched
+
+
+def test_dot_index_epilogue():
+    # index arithmetic shared by the accumulator and a store is recomputed
+    # in the layout of the store rather than converted
+    @triton.jit
+    def kernel(X, Y, Z, I):
+        offs = tl.arange(0, 32)
+        idx = offs[:, None] * 32 + offs[None, :]
+        x = tl.load(X + idx)
+        y = tl.load(Y + idx)
+        z = tl.dot(x, y) + idx.to(tl.float32)
+        tl.store(Z + idx, z)
+        tl.store(I + idx, idx)
+
+    x = torch.randn((32, 32), dtype=torch.float16, device='cuda')
+    y = torch.randn((32, 32), dtype=torch.float16, device='cuda')
+    z = torch.empty((32, 32), dtype=torch.float32, device='cuda')
+    i = torch.empty((32, 32), dtype=torch.int32, device='cuda')
+    kernel[(1,)](x, y, z, i)
+    ref_i = torch.arange(32 * 32, dtype=torch.int32, device='cuda').reshape(32, 32)
+    ref_z = torch.matmul(x.float(), y.float()) + ref_i.float()
+    triton.testing.assert_almost_equal(z, ref_z, decimal=2)
+    assert torch.equal(i, ref_i)
+
+@pytest.mark.parametrize("num_warps", [1, 4])
+def test_strided_store(num_warps):
+    # the layout conversion before the store stays within a warp for one warp
+    @triton.jit
+    def kernel(X, Z):
+        offs = tl.arange(0, 32)
+        x = tl.load(X + offs[:, None] * 32 + offs[None, :])
+        tl.store(Z + offs[:, None] * 64 + offs[None, :] * 2, x + 1.)
+
+    x = torch.randn((32, 32), dtype=torch.float32, device='cuda')
+    z = torch.zeros((32, 64), dtype=torch.float32, device='cuda')
+    kernel[(1,)](x, z, num_warps=num_warps)
+    triton.testing.assert_almost_equal(z[:, ::2], x + 1.)
+    assert torch.all(z[:, 1::2] == 0)
+
 # ---------------
 # test arange
 # ---------------
@@ -937,6 +1496,495 @@ def test_load_cache_modifier(cache):
         assert 'ld.global.ca' in ptx
         assert 'ld.global.cg' not in ptx
 
+
+@pytest.mark.parametrize("N", [1024, 1000, 1001])
+def test_masked_load_store_vectorization(N):
+    # masked accesses are vectorized as long as the mask is provably
+    # constant over each vector
+    src = torch.randn(N, device='cuda')
+    dst = torch.zeros(1024, device='cuda')
+
+    @triton.jit
+    def _kernel(dst, src, N, BLOCK: tl.constexpr):
+        offsets = tl.arange(0, BLOCK)
+        x = tl.load(src + offsets, mask=offsets < N, other=-1.)
+        tl.store(dst + offsets, x, mask=offsets < N)
+
+    pgm = _kernel[(1,)](dst, src, N, BLOCK=1024)
+    assert torch.equal(dst[:N], src)
+    assert torch.all(dst[N:] == 0)
+    ptx = pgm.asm['ptx']
+    if N % 16 == 0:
+        assert 'ld.global.v4' in ptx
+    if N % 2 == 1:
+        assert 'ld.global.v4' not in ptx
+
+
+@pytest.mark.parametrize("stride", [128, 120, 37])
+def test_gather_rows_vectorization(stride):
+    # rows gathered through data-dependent indices stay contiguous
+    src = torch.randn(256, stride, device='cuda')
+    idx = torch.randint(0, 256, (64,), dtype=torch.int32, device='cuda')
+    dst = torch.empty(64, 32, device='cuda')
+
+    @triton.jit
+    def _kernel(dst, src, idx, stride, N, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr):
+        off_m = tl.arange(0, BLOCK_M)
+        off_n = tl.arange(0, BLOCK_N)
+        rows = tl.load(idx + off_m)
+        x = tl.gather_rows(src, rows, off_n, stride, off_m < N)
+        tl.store(dst + off_m[:, None] * BLOCK_N + off_n[None, :], x)
+
+    pgm = _kernel[(1,)](dst, src, idx, stride, 60, BLOCK_M=64, BLOCK_N=32)
+    assert torch.equal(dst[:60], src[idx[:60].long(), :32])
+    assert torch.all(dst[60:] == 0)
+    ptx = pgm.asm['ptx']
+    if stride % 16 == 0:
+        assert 'ld.global.v4' in ptx
+    if stride % 2 == 1:
+        assert 'ld.global.v4' not in ptx
+
+
+def test_grid_sync(device='cuda'):
+    # each program reads what its neighbour wrote before the barrier
+    @triton.jit
+    def _kernel(X, Y, BLOCK: tl.constexpr):
+        pid = tl.program_id(0)
+        off = tl.arange(0, BLOCK)
+        tl.store(X + pid * BLOCK + off, pid + off)
+        tl.grid_sync()
+        other = (pid + 1) % tl.num_programs(0)
+        tl.store(Y + pid * BLOCK + off, tl.load(X + other * BLOCK + off))
+
+    num_sm = torch.cuda.get_device_properties(device).multi_processor_count
+    x = torch.empty(num_sm * 128, dtype=torch.int32, device=device)
+    y = torch.empty_like(x)
+    for _ in range(3):
+        _kernel[(num_sm,)](x, y, BLOCK=128)
+        assert torch.equal(y, torch.roll(x, -128))
+    with pytest.raises(RuntimeError, match="grid_sync"):
+        _kernel[(num_sm * 1000,)](x, y, BLOCK=128)
+
+
+def test_grid_sync_streams(device='cuda'):
+    # launches on two streams at once arrive at their own barriers
+    @triton.jit
+    def _kernel(X, Y, N_ITERS, BLOCK: tl.constexpr):
+        pid = tl.program_id(0)
+        off = tl.arange(0, BLOCK)
+        for i in range(N_ITERS):
+            tl.store(X + pid * BLOCK + off, pid + off + i)
+            tl.grid_sync()
+            other = (pid + 1) % tl.num_programs(0)
+            tl.store(Y + pid * BLOCK + off, tl.load(X + other * BLOCK + off))
+            tl.grid_sync()
+
+    num_programs = max(1, torch.cuda.get_device_properties(device).multi_processor_count // 2)
+    xs = [torch.empty(num_programs * 128, dtype=torch.int32, device=device) for _ in range(2)]
+    ys = [torch.empty_like(x) for x in xs]
+    streams = [torch.cuda.Stream() for _ in range(2)]
+    for x, y, stream in zip(xs, ys, streams):
+        with torch.cuda.stream(stream):
+            _kernel[(num_programs,)](x, y, 100, BLOCK=128)
+    torch.cuda.synchronize()
+    for x, y in zip(xs, ys):
+        assert torch.equal(y, torch.roll(x, -128))
+
+
+def test_grid_sync_counter():
+    # the counter of the barriers is a parameter of the kernel, after its arguments
+    @triton.jit
+    def _kernel(X, BLOCK: tl.constexpr):
+        off = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        tl.store(X + off, off)
+        tl.grid_sync()
+
+    _, generator = _kernel._generate_ttir([('ptr', 'i32')], {0: 16}, {1: 128})
+    backend = _triton.runtime.backend.CUDA
+    _, asm, _, _ = _triton.code_gen.compile_ttir(backend, generator.module, 0, 4, 1, cc=80)
+    assert asm['grid_sync'] == '1'
+    assert re.search(r'define void @\w+\(i32 addrspace\(1\)\* [^,]*, i32 addrspace\(1\)\* [^,)]*\)', asm['llir'])
+    assert '__triton_grid_barrier' not in asm['llir']
+
+
+@pytest.mark.parametrize("scope", ["gpu", "sys"])
+def test_memory_scope(scope, device='cuda'):
+    # the last program to arrive sees the writes of all the others
+    @triton.jit
+    def _kernel(X, Count, Out, SCOPE: tl.constexpr):
+        pid = tl.program_id(0)
+        tl.store(X + pid, pid + 1)
+        tl.fence(scope=SCOPE)
+        if tl.atomic_add(Count, 1, scope=SCOPE) == tl.num_programs(0) - 1:
+            tl.fence(scope=SCOPE)
+            total = tl.sum(tl.load(X + tl.arange(0, 64), volatile=True), axis=0)
+            tl.atomic_cas(Out, 0, total, scope=SCOPE)
+
+    x = torch.zeros(64, dtype=torch.int32, device=device)
+    count = torch.zeros(1, dtype=torch.int32, device=device)
+    out = torch.zeros(1, dtype=torch.int32, device=device)
+    pgm = _kernel[(64,)](x, count, out, SCOPE=scope)
+    assert out.item() == 64 * 65 // 2
+    ptx = pgm.asm['ptx']
+    assert ('membar.sys' in ptx) == (scope == 'sys')
+    assert ('atom.global.sys' in ptx) == (scope == 'sys')
+    with pytest.raises(ValueError, match="scope"):
+        _kernel[(64,)](x, count, out, SCOPE='cta')
+
+
+@pytest.mark.parametrize("dtype_str", ['int8', 'int32', 'uint32', 'float16', 'float32', 'float64'])
+def test_constant_table(dtype_str, device='cuda'):
+    # tables are read with uniform (scalar) and divergent (block) indices
+    @triton.jit
+    def _kernel(Idx, Out, Scalar, VALUES: tl.constexpr, DTYPE: tl.constexpr, BLOCK: tl.constexpr):
+        table = tl.constant_table(VALUES, DTYPE)
+        offs = tl.arange(0, BLOCK)
+        tl.store(Out + offs, tl.load(table + tl.load(Idx + offs)))
+        tl.store(Scalar + tl.program_id(0), tl.load(table + tl.program_id(0)))
+
+    rs = RandomState(17)
+    values = numpy_random(37, dtype_str=dtype_str, rs=rs)
+    table = tuple(v.item() for v in values)
+    idx = torch.tensor(rs.randint(0, len(table), 128), dtype=torch.int32, device=device)
+    out = to_triton(np.empty(128, dtype=values.dtype), device=device)
+    scalar = to_triton(np.empty(len(table), dtype=values.dtype), device=device)
+    pgm = _kernel[(len(table),)](idx, out, scalar, VALUES=table, DTYPE=getattr(tl, dtype_str), BLOCK=128)
+    np.testing.assert_equal(to_numpy(out), values[to_numpy(idx)])
+    np.testing.assert_equal(to_numpy(scalar), values)
+    assert 'ld.const' in pgm.asm['ptx']
+
+
+def test_constant_table_errors(device='cuda'):
+    @triton.jit
+    def _store(Out, VALUES: tl.constexpr):
+        tl.store(tl.constant_table(VALUES, tl.float32), tl.load(Out))
+
+    @triton.jit
+    def _load(Out, VALUES: tl.constexpr):
+        tl.store(Out, tl.load(tl.constant_table(VALUES, tl.float32)))
+
+    out = torch.zeros(1, dtype=torch.float32, device=device)
+    with pytest.raises(ValueError, match="constant table"):
+        _store[(1,)](out, VALUES=(1.,))
+    with pytest.raises(ValueError, match="constant memory"):
+        _load[(1,)](out, VALUES=(1.,) * (16 * 1024 + 1))
+
+
+@pytest.mark.parametrize("grid", [(1, 1), (7, 5), (64, 3), (3, 200), (37, 41)])
+def test_raster(grid, device='cuda'):
+    # grouped program ids are a permutation of those of the grid
+    @triton.jit(raster='grouped')
+    def _kernel(Count, N):
+        tl.atomic_add(Count + tl.program_id(1) * N + tl.program_id(0), 1)
+
+    count = torch.zeros(grid[0] * grid[1], dtype=torch.int32, device=device)
+    _kernel[grid](count, grid[0])
+    assert torch.all(count == 1)
+    with pytest.raises(ValueError, match="raster"):
+        triton.jit(raster='hilbert')(_kernel.fn)
+
+
+@pytest.mark.parametrize("raster", [None, 'grouped'])
+def test_persistent(raster, device='cuda'):
+    # each tile of the grid is run once, by fewer programs, and early
+    # returns move on to the next tile
+    @triton.jit(persistent=True, raster=raster)
+    def _kernel(Count, N, BLOCK: tl.constexpr):
+        pid = tl.program_id(1) * tl.num_programs(0) + tl.program_id(0)
+        if pid % 3 == 0:
+            return
+        off = tl.arange(0, BLOCK)
+        tl.atomic_add(Count + pid * BLOCK + off, 1 + off * 0)
+
+    grid = (97, 61)
+    count = torch.zeros(grid[0] * grid[1] * 128, dtype=torch.int32, device=device)
+    for _ in range(2):
+        count.zero_()
+        _kernel[grid](count, grid[0], BLOCK=128)
+        pid = torch.arange(grid[0] * grid[1], device=device).repeat_interleave(128)
+        assert torch.all(count == (pid % 3 != 0).int())
+    for binary in _kernel.bin_cache.values():
+        assert binary.persistent_programs(binary.device) < grid[0] * grid[1]
+
+
+@pytest.mark.parametrize("dtype_str", ['float16', 'float32'])
+def test_staged_store(dtype_str, device='cuda'):
+    # tiles stored in a loop are written by bulk copies of their rows on sm_90,
+    # including tiles that are partially masked by rows
+    @triton.jit(persistent=True)
+    def _kernel(Y, X, M, N, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr):
+        rm = tl.program_id(0) * BLOCK_M + tl.arange(0, BLOCK_M)
+        rn = tl.program_id(1) * BLOCK_N + tl.arange(0, BLOCK_N)
+        x = tl.load(X + rm[:, None] * N + rn[None, :], mask=rm[:, None] < M)
+        tl.store(Y + rm[:, None] * N + rn[None, :], x * 2, mask=rm[:, None] < M)
+
+    M, N = 1000, 512
+    x = torch.randn((M, N), dtype=getattr(torch, dtype_str), device=device)
+    y = torch.zeros_like(x)
+    grid = (triton.cdiv(M, 64), N // 64)
+    for _ in range(2):
+        _kernel[grid](y, x, M, N, BLOCK_M=64, BLOCK_N=64)
+        assert torch.equal(y, x * 2)
+    if torch.cuda.get_device_capability()[0] >= 9:
+        binary = next(iter(_kernel.bin_cache.values()))
+        assert 'cp.async.bulk.global.shared::cta' in binary.asm['ptx']
+
+
+@triton.jit
+def _polynomial(x):
+    return x * x + 3 * x + 1
+
+
+@pytest.mark.parametrize("inline", [True, False])
+def test_outlined_call(inline, device='cuda'):
+    # calls that are not inlined pass the values of blocks held by each thread
+    @triton.jit
+    def _kernel(X, Y, INLINE: tl.constexpr, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        x = tl.load(X + off)
+        y = _polynomial(x, _inline=INLINE)
+        y = _polynomial(y, _inline=INLINE)
+        tl.store(Y + off, y)
+
+    x = torch.rand(256, device=device)
+    y = torch.empty_like(x)
+    pgm = _kernel[(1,)](x, y, INLINE=inline, BLOCK=256)
+    ref = x * x + 3 * x + 1
+    triton.testing.assert_almost_equal(y, ref * ref + 3 * ref + 1)
+    assert ('call.uni' in pgm.asm['ptx']) != inline
+
+
+@triton.jit
+def _launched(X, N, BLOCK: tl.constexpr):
+    off = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+    tl.store(X + off, off, mask=off < N)
+
+
+def test_launch(device='cuda'):
+    # the number of programs of the child is only known on the device
+    @triton.jit
+    def _kernel(X, Count, BLOCK: tl.constexpr):
+        n = tl.load(Count)
+        tl.launch(_launched, [(n + BLOCK - 1) // BLOCK], [X, n, BLOCK])
+
+    x = torch.full((1000,), -1, dtype=torch.int32, device=device)
+    count = torch.tensor([700], dtype=torch.int32, device=device)
+    pgm = _kernel[(1,)](x, count, BLOCK=128)
+    torch.cuda.synchronize()
+    assert torch.equal(x[:700], torch.arange(700, dtype=torch.int32, device=device))
+    assert torch.all(x[700:] == -1)
+    assert 'cudaLaunchDeviceV2' in pgm.asm['ptx']
+
+
+def test_masked_load_store_in_bounds():
+    # masks that value ranges prove true everywhere are dropped,
+    # along with the fallback values of the loads
+    src = torch.randn(1024, device='cuda')
+    dst = torch.zeros(1024, device='cuda')
+
+    @triton.jit
+    def _kernel(dst, src, BLOCK: tl.constexpr):
+        offsets = tl.arange(0, BLOCK)
+        in_bounds = (offsets < BLOCK) & (offsets % 256 >= 0)
+        x = tl.load(src + offsets, mask=in_bounds, other=-1.)
+        tl.store(dst + offsets, x, mask=offsets <= BLOCK - 1)
+
+    pgm = _kernel[(1,)](dst, src, BLOCK=1024)
+    assert torch.equal(dst, src)
+    assert '@!' not in pgm.asm['ptx']
+
+@pytest.mark.parametrize("in_place", [False, True])
+def test_load_read_only(in_place):
+    # loads from tensors that the kernel never writes and that alias no
+    # other argument go through the non-coherent cache
+    src = torch.randn(128, device='cuda')
+    dst = src if in_place else torch.empty(128, device='cuda')
+
+    @triton.jit
+    def _kernel(dst, src):
+        offsets = tl.arange(0, 128)
+        x = tl.load(src + offsets)
+        tl.store(dst + offsets, x + 1)
+
+    ref = src + 1
+    pgm = _kernel[(1,)](dst, src)
+    triton.testing.assert_almost_equal(dst, ref)
+    ptx = pgm.asm['ptx']
+    if in_place:
+        assert 'ld.global.nc' not in ptx
+    else:
+        assert 'ld.global.nc' in ptx
+    # views of the same storage may alias
+    x = torch.randn(256, device='cuda')
+    pgm = _kernel[(1,)](x[128:], x[:128])
+    assert 'ld.global.nc' not in pgm.asm['ptx']
+
+
+def test_line_info():
+    # instructions are attributed to the lines of the kernel they come from
+    @triton.jit
+    def _kernel(dst, src):
+        offsets = tl.arange(0, 128)
+        x = tl.load(src + offsets)
+        tl.store(dst + offsets, tl.exp(x))
+
+    src = torch.randn(128, device='cuda')
+    dst = torch.empty(128, device='cuda')
+    pgm = _kernel[(1,)](dst, src)
+    ptx = pgm.asm['ptx']
+    files = re.findall(r'\.file\s+(\d+)\s+"([^"]+)"', ptx)
+    file_id = [id for id, path in files if path.endswith(os.path.basename(__file__))]
+    assert len(file_id) == 1
+    lines = {int(line) for line in re.findall(rf'\.loc\s+{file_id[0]}\s+(\d+)', ptx)}
+    src_lines, start = inspect.getsourcelines(_kernel.fn)
+    store_line = start + next(i for i, line in enumerate(src_lines) if 'tl.store' in line)
+    assert store_line in lines
+    assert all(start < line < start + len(src_lines) for line in lines)
+
+
+@pytest.mark.parametrize("num_warps", [1, 4])
+def test_schedule(num_warps):
+    # scheduled and unscheduled kernels compute the same values
+    def kernel(X, Y, Z, BLOCK: tl.constexpr):
+        offsets = tl.arange(0, BLOCK)
+        x = tl.load(X + offsets)
+        a = tl.exp(x) * 2.
+        y = tl.load(Y + offsets)
+        b = a + y
+        tl.store(Z + offsets, b)
+        w = tl.load(X + BLOCK + offsets)
+        tl.store(Z + BLOCK + offsets, tl.sum(w * b, axis=0) + offsets)
+
+    x = torch.randn(2048, device='cuda')
+    y = torch.randn(1024, device='cuda')
+    outs = []
+    for schedule in [True, False]:
+        z = torch.empty(2048, device='cuda')
+        triton.jit(kernel, schedule=schedule)[(1,)](x, y, z, BLOCK=1024, num_warps=num_warps)
+        outs.append(z)
+    b = torch.exp(x[:1024]) * 2. + y
+    triton.testing.assert_almost_equal(outs[0][:1024], b)
+    triton.testing.assert_almost_equal(outs[0], outs[1])
+
+
+@pytest.mark.parametrize("N", [0, 1, 7])
+def test_licm(N):
+    # invariant pointer increments and index arithmetic are hoisted out of the loop;
+    # divisions by values that may be zero are not
+    @triton.jit
+    def _kernel(X, Z, stride, div, N, BLOCK: tl.constexpr):
+        offsets = tl.arange(0, BLOCK)
+        acc = tl.zeros([BLOCK], dtype=tl.float32)
+        ptrs = X + offsets
+        for i in range(0, N):
+            acc += tl.load(ptrs)
+            ptrs += stride * BLOCK
+            if div != 0:
+                acc += (offsets // div).to(tl.float32)
+        tl.store(Z + offsets, acc)
+
+    BLOCK = 128
+    x = torch.randn(8 * BLOCK, device='cuda')
+    z = torch.empty(BLOCK, device='cuda')
+    _kernel[(1,)](x, z, 1, 0, N, BLOCK=BLOCK)
+    ref = x.reshape(8, BLOCK)[:N].sum(0)
+    triton.testing.assert_almost_equal(z, ref)
+
+
+def test_cse():
+    # repeated expressions are computed once; expressions that only
+    # look alike are kept apart
+    @triton.jit
+    def _kernel(X, Z, BLOCK: tl.constexpr):
+        pid = tl.program_id(0)
+        x = tl.load(X + pid * BLOCK + tl.arange(0, BLOCK))
+        y = tl.load(X + pid * BLOCK + tl.arange(0, BLOCK))
+        a = x * 2. + tl.arange(0, BLOCK)
+        b = y * 2. - tl.arange(0, BLOCK)
+        c = x * 2. + tl.arange(0, BLOCK)
+        tl.store(Z + pid * BLOCK + tl.arange(0, BLOCK), a * b + c)
+
+    BLOCK = 128
+    x = torch.randn(4 * BLOCK, device='cuda')
+    z = torch.empty_like(x)
+    _kernel[(4,)](x, z, BLOCK=BLOCK)
+    r = torch.arange(BLOCK, device='cuda').repeat(4)
+    a = x * 2. + r
+    triton.testing.assert_almost_equal(z, a * (x * 2. - r) + a)
+
+
+def test_constant_folding():
+    # arithmetic on constants and identities is folded as the kernel is built
+    @triton.jit
+    def _kernel(Z, BLOCK: tl.constexpr):
+        offsets = tl.arange(0, BLOCK)
+        zeros = tl.zeros([BLOCK], dtype=tl.int32)
+        c = (zeros + 3) * (zeros + 2) - 1
+        z = (offsets * 1 + 0) * c
+        z = tl.where(c < 0, -z, z)
+        tl.store(Z + offsets, z.to(tl.float32) * 0.5)
+
+    BLOCK = 128
+    z = torch.empty(BLOCK, device='cuda')
+    pgm = _kernel[(1,)](z, BLOCK=BLOCK)
+    ref = torch.arange(BLOCK, device='cuda', dtype=torch.float32) * 2.5
+    triton.testing.assert_almost_equal(z, ref)
+    assert re.search(r'\bmul\b', pgm.asm['ttir']) is None
+
+
+def test_load_l2_prefetch(monkeypatch):
+    if torch.cuda.get_device_capability()[0] < 8:
+        pytest.skip("L2 prefetch hints are only used on sm80+")
+    monkeypatch.setenv('TRITON_L2_PREFETCH', '128')
+    src = torch.randn(128, device='cuda')
+    dst = torch.empty(128, device='cuda')
+
+    @triton.jit
+    def _kernel(dst, src):
+        offsets = tl.arange(0, 128)
+        tl.store(dst + offsets, tl.load(src + offsets))
+
+    pgm = _kernel[(1,)](dst, src)
+    assert '.L2::128B' in pgm.asm['ptx']
+    triton.testing.assert_almost_equal(dst, src)
+
+
+@pytest.mark.parametrize("M, N, K, tma", [(128, 128, 256, True), (200, 144, 304, True), (200, 144, 304, False),
+                                          (200, 136, 300, True)])
+def test_load_tile(M, N, K, tma, monkeypatch):
+    # tiles loaded in a pipelined loop are zero out of the bounds of their tensor; on sm_90 they
+    # are copied by the TMA when the rows of their tensor are 16-byte aligned
+    if torch.cuda.get_device_capability()[0] < 8:
+        pytest.skip("tiles are only copied asynchronously on sm80+")
+    if not tma:
+        monkeypatch.setenv('TRITON_DISABLE_TMA', '1')
+
+    @triton.jit
+    def _kernel(C, A, B, M, N, K, stride_am, stride_bk, stride_cm,
+                BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr):
+        pid_m = tl.program_id(0)
+        pid_n = tl.program_id(1)
+        acc = tl.zeros((BLOCK_M, BLOCK_N), dtype=tl.float32)
+        for k in range(0, K, BLOCK_K):
+            a = tl.load_tile(A, (M, K), (stride_am, 1), (pid_m * BLOCK_M, k), (BLOCK_M, BLOCK_K))
+            b = tl.load_tile(B, (K, N), (stride_bk, 1), (k, pid_n * BLOCK_N), (BLOCK_K, BLOCK_N))
+            acc += tl.dot(a, b)
+        rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+        rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+        mask = (rm < M)[:, None] & (rn < N)[None, :]
+        tl.store(C + rm[:, None] * stride_cm + rn[None, :], acc.to(tl.float16), mask=mask)
+
+    a = torch.randn((M, K), dtype=torch.float16, device='cuda')
+    b = torch.randn((K, N), dtype=torch.float16, device='cuda')
+    c = torch.empty((M, N), dtype=torch.float16, device='cuda')
+    grid = (triton.cdiv(M, 64), triton.cdiv(N, 64))
+    pgm = _kernel[grid](c, a, b, M, N, K, a.stride(0), b.stride(0), c.stride(0),
+                        BLOCK_M=64, BLOCK_N=64, BLOCK_K=32, num_stages=3)
+    triton.testing.assert_almost_equal(c, torch.matmul(a, b), decimal=1)
+    aligned = K % 8 == 0 and N % 8 == 0
+    if torch.cuda.get_device_capability()[0] >= 9:
+        assert ('cp.async.bulk.tensor' in pgm.asm['ptx']) == (tma and aligned)
+
 # ---------------
 # test store
 # ---------------
@@ -949,6 +1997,29 @@ def test_load_cache_modifier(cache):
 # test for
 # ---------------
 
+@pytest.mark.parametrize("N", [16, 200, 201, 211])
+def test_for_unroll(N):
+    # loops with constant trip counts are unrolled fully, or by a factor that
+    # divides their trip count (none for 211)
+    @triton.jit
+    def _kernel(Z, X, N: tl.constexpr, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        acc = tl.zeros([BLOCK], dtype=tl.float32)
+        ptrs = X + offs
+        for i in range(N):
+            acc = acc * 0.5 + tl.load(ptrs) + i
+            ptrs += BLOCK
+        tl.store(Z + offs, acc)
+
+    x = torch.randn((N, 128), device='cuda')
+    z = torch.empty(128, device='cuda')
+    _kernel[(1,)](z, x, N=N, BLOCK=128)
+    ref = torch.zeros(128, device='cuda')
+    for i in range(N):
+        ref = ref * 0.5 + x[i] + i
+    triton.testing.assert_almost_equal(z, ref)
+
+
 # ---------------
 # test while
 # ---------------
@@ -1057,3 +2128,39 @@ def stub(X, alpha, grid_0, grid_1, grid_2):
 #     stub[(1,)](x_tri, 3.14, n_pids, 1, 1)
 #     print(x_tri)
 #     # triton.testing.assert_almost_equal(x_ref, x_tri)
+
+
+# ---------------
+# test host backend
+# ---------------
+
+def test_host_add(device='cpu'):
+    @triton.jit
+    def kernel(X, Y, Z, N, BLOCK: tl.constexpr):
+        off = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        mask = off < N
+        x = tl.load(X + off, mask=mask)
+        y = tl.load(Y + off, mask=mask, other=1.)
+        tl.store(Z + off, x + tl.exp(y), mask=mask)
+
+    N = 1000
+    x = torch.randn(N, device=device)
+    y = torch.randn(N, device=device)
+    z = torch.empty(N, device=device)
+    kernel[(triton.cdiv(N, 128),)](x, y, z, N, BLOCK=128)
+    triton.testing.assert_almost_equal(z, x + torch.exp(y))
+
+
+def test_host_dot(device='cpu'):
+    @triton.jit
+    def kernel(X, Y, Z, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        x = tl.load(X + off[:, None] * BLOCK + off[None, :])
+        y = tl.load(Y + off[:, None] * BLOCK + off[None, :])
+        tl.store(Z + off[:, None] * BLOCK + off[None, :], tl.dot(x, y))
+
+    x = torch.randn((16, 16), device=device)
+    y = torch.randn((16, 16), device=device)
+    z = torch.empty((16, 16), device=device)
+    kernel[(1,)](x, y, z, BLOCK=16)
+    triton.testing.assert_almost_equal(z, torch.matmul(x, y))
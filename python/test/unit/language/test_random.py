@@ -134,6 +134,34 @@ def test_randint(size, seed, device='cuda'):
     out_ref = [gen.random_raw()[0] for _ in out_tri]
     assert out_tri == out_ref
 
+
+@pytest.mark.parametrize('seed', [0, 42, 0xdeadbeefcafeb0ba])
+def test_randint4x(seed, device='cuda'):
+    @triton.jit
+    def kernel(X, Y, seed, BLOCK: tl.constexpr):
+        offset = tl.arange(0, BLOCK)
+        r0, r1, r2, r3 = tl.randint4x(seed, offset)
+        u0, u1, u2, u3 = tl.rand4x(seed, offset)
+        tl.store(X + offset * 4 + 0, r0)
+        tl.store(X + offset * 4 + 1, r1)
+        tl.store(X + offset * 4 + 2, r2)
+        tl.store(X + offset * 4 + 3, r3)
+        tl.store(Y + offset * 4 + 0, u0)
+        tl.store(Y + offset * 4 + 1, u1)
+        tl.store(Y + offset * 4 + 2, u2)
+        tl.store(Y + offset * 4 + 3, u3)
+    x = torch.empty(4 * BLOCK, dtype=torch.int32, device=device)
+    y = torch.empty(4 * BLOCK, dtype=torch.float32, device=device)
+    kernel[(1,)](x, y, seed, BLOCK=BLOCK)
+    out_tri = x.cpu().numpy().astype(np.uint32).reshape(BLOCK, 4).tolist()
+    gen = CustomPhilox4x(seed, config=PHILOX_32)
+    out_ref = [gen.random_raw().tolist() for _ in out_tri]
+    assert out_tri == out_ref
+    # the float streams are the integer ones, converted
+    ref = x.cpu()
+    ref = torch.where(ref < 0, -ref - 1, ref).float() * 4.656613e-10
+    assert torch.equal(y.cpu(), ref)
+
 # test uniform PRNG
 
 
@@ -0,0 +1,47 @@
+import pytest
+import torch
+
+import triton
+
+
+@pytest.mark.parametrize("Z, H, N_CTX, D", [(2, 3, 256, 64), (1, 2, 197, 32), (2, 2, 128, 128)])
+@pytest.mark.parametrize("causal", [False, True])
+@pytest.mark.parametrize("varlen", [False, True])
+def test_op(Z, H, N_CTX, D, causal, varlen, dtype=torch.float16):
+    torch.manual_seed(20)
+    q, k, v = [torch.empty((Z, H, N_CTX, D), dtype=dtype, device="cuda").normal_(mean=0, std=.5).requires_grad_()
+               for _ in range(3)]
+    sm_scale = 0.3
+    dout = torch.randn_like(q)
+    seqlens = None
+    if varlen:
+        seqlens = torch.randint(1, N_CTX + 1, (Z,), device="cuda")
+        seqlens[0] = N_CTX
+    # reference implementation
+    p = torch.matmul(q, k.transpose(2, 3)).float() * sm_scale
+    cols = torch.arange(N_CTX, device="cuda")
+    mask = torch.ones((Z, 1, N_CTX, N_CTX), dtype=torch.bool, device="cuda")
+    if causal:
+        mask &= cols[:, None] >= cols[None, :]
+    if varlen:
+        mask &= (cols[None, :] < seqlens[:, None])[:, None, None, :]
+    p = torch.softmax(p.masked_fill(~mask, float("-inf")), dim=-1).half()
+    ref_out = torch.matmul(p, v)
+    if varlen:
+        rows = (cols[None, :] < seqlens[:, None])[:, None, :, None]
+        ref_out = ref_out * rows
+    ref_out.backward(dout)
+    ref_dv, v.grad = v.grad.clone(), None
+    ref_dk, k.grad = k.grad.clone(), None
+    ref_dq, q.grad = q.grad.clone(), None
+    # triton implementation
+    tri_out = triton.ops.attention(q, k, v, sm_scale, causal, seqlens)
+    tri_out.backward(dout)
+    tri_dv, v.grad = v.grad.clone(), None
+    tri_dk, k.grad = k.grad.clone(), None
+    tri_dq, q.grad = q.grad.clone(), None
+    # compare
+    triton.testing.assert_almost_equal(ref_out, tri_out)
+    triton.testing.assert_almost_equal(ref_dv, tri_dv)
+    triton.testing.assert_almost_equal(ref_dk, tri_dk)
+    triton.testing.assert_almost_equal(ref_dq, tri_dq)
@@ -9,7 +9,7 @@ import triton
 @pytest.mark.parametrize("TRANS_B", [False, True])
 @pytest.mark.parametrize("BLOCK", [16, 32, 64])
 @pytest.mark.parametrize("DTYPE", [torch.float16])
-def test_matmul(MODE, TRANS_A, TRANS_B, BLOCK, DTYPE, Z=3, H=2, M=512, N=384, K=256):
+def test_matmul(MODE, TRANS_A, TRANS_B, BLOCK, DTYPE, Z=3, H=2, M=512, N=384, K=256, LOAD_BALANCE=False):
     seed = 0
     torch.manual_seed(seed)
     is_sdd = MODE == "sdd"
@@ -30,6 +30,11 @@ def test_matmul(MODE, TRANS_A, TRANS_B, BLOCK, DTYPE, Z=3, H=2, M=512, N=384, K=
     layout = torch.randint(2, (H, shape[0] // BLOCK, shape[1] // BLOCK))
     layout[1, 2, :] = 0
     layout[1, :, 1] = 0
+    if LOAD_BALANCE:
+        # causal with global tokens
+        layout = torch.tril(torch.ones_like(layout))
+        layout[:, :, 0] = 1
+        layout[:, 0, :] = 1
     # create data
     a_ref, a_tri = triton.testing.make_pair(a_shape, alpha=.1)
     b_ref, b_tri = triton.testing.make_pair(b_shape, alpha=.1)
@@ -52,7 +57,8 @@ def test_matmul(MODE, TRANS_A, TRANS_B, BLOCK, DTYPE, Z=3, H=2, M=512, N=384, K=
     b_tri = do_sparsify(b_tri) if is_dds else b_tri
     a_tri.retain_grad()
     b_tri.retain_grad()
-    op = triton.ops.blocksparse.matmul(layout, BLOCK, MODE, trans_a=TRANS_A, trans_b=TRANS_B, device="cuda")
+    op = triton.ops.blocksparse.matmul(layout, BLOCK, MODE, trans_a=TRANS_A, trans_b=TRANS_B, device="cuda",
+                                       load_balance=LOAD_BALANCE)
     c_tri = triton.testing.catch_oor(lambda: op(a_tri, b_tri), pytest)
     triton.testing.catch_oor(lambda: c_tri.backward(dc_tri), pytest)
     da_tri = a_tri.grad
@@ -63,6 +69,13 @@ def test_matmul(MODE, TRANS_A, TRANS_B, BLOCK, DTYPE, Z=3, H=2, M=512, N=384, K=
     triton.testing.assert_almost_equal(db_ref, db_tri)
 
 
+@pytest.mark.parametrize("MODE", ["sdd", "dds", "dsd"])
+@pytest.mark.parametrize("TRANS_A", [False, True])
+@pytest.mark.parametrize("LOAD_BALANCE", [True, 3])
+def test_matmul_load_balance(MODE, TRANS_A, LOAD_BALANCE):
+    test_matmul(MODE, TRANS_A, False, 32, torch.float16, LOAD_BALANCE=LOAD_BALANCE)
+
+
 configs = [
     (16, 256),
     (32, 576),
@@ -114,6 +127,33 @@ def test_softmax(BLOCK, WIDTH, is_dense, Z=2, H=2, is_causal=True, scale=0.4):
     triton.testing.assert_almost_equal(da_tri, da_ref)
 
 
+@pytest.mark.parametrize("BLOCK, WIDTH", configs[:2])
+def test_softmax_dropout(BLOCK, WIDTH, Z=2, H=3, scale=0.4, p=0.25, seed=17):
+    torch.random.manual_seed(0)
+    layout = torch.randint(2, (H, WIDTH // BLOCK, WIDTH // BLOCK))
+    layout[:, :, 0] = 1
+    op = triton.ops.blocksparse.softmax(layout, BLOCK, device="cuda")
+    a_shape = (Z, H, WIDTH, WIDTH)
+    _, a = triton.testing.make_pair(a_shape)
+    _, dout = triton.testing.make_pair(a_shape)
+    a = triton.testing.sparsify_tensor(a, layout, BLOCK).detach()
+    dout = triton.testing.sparsify_tensor(dout, layout, BLOCK)
+    # reference: no dropout, with the mask applied outside
+    a_ref = a.clone().requires_grad_()
+    out_ref = op(a_ref, scale=scale)
+    # triton
+    a_tri = a.clone().requires_grad_()
+    out_tri = op(a_tri, scale=scale, dropout_p=p, seed=seed)
+    keep = out_tri != 0
+    assert abs(1 - keep.float().mean().item() - p) < 0.02
+    assert torch.equal(keep, op(a, scale=scale, dropout_p=p, seed=seed) != 0)
+    triton.testing.assert_almost_equal(out_tri, torch.where(keep, out_ref / (1 - p), torch.zeros_like(out_ref)))
+    # the backward pass regenerates the same mask
+    out_tri.backward(dout)
+    out_ref.backward(torch.where(keep, dout / (1 - p), torch.zeros_like(dout)))
+    triton.testing.assert_almost_equal(a_tri.grad, a_ref.grad)
+
+
 @pytest.mark.parametrize("block", [16, 32, 64])
 @pytest.mark.parametrize("dtype", [torch.float16, torch.float32])
 def test_attention_fwd_bwd(
@@ -185,3 +225,30 @@ def triton_attention(
     w = sparse_softmax(w, scale=scale, is_causal=True)
     a = sparse_dot_dsd_nn(w, value)
     return a
+
+
+@pytest.mark.parametrize("BLOCK", [16, 32, 64])
+@pytest.mark.parametrize("TRANS", [False, True])
+def test_device_lut(BLOCK, TRANS, H=3, M=7, N=45):
+    from triton.ops.blocksparse.matmul import dsd_lut, sdd_lut
+    from triton.ops.blocksparse.softmax import _softmax
+    torch.manual_seed(0)
+    layout = torch.randint(2, (H, M, N))
+    layout[1, 2, :] = 0
+    layout[1, :, 1] = 0
+    # sdd
+    lut_ref, _ = sdd_lut(layout, BLOCK, "cuda")
+    lut_tri, _ = sdd_lut(layout.cuda(), BLOCK, "cuda")
+    assert torch.equal(lut_ref, lut_tri)
+    # dsd; entries past the actual increments are zeros
+    step = min(BLOCK, 32)
+    lut_ref, width_ref = dsd_lut(layout, BLOCK, step, TRANS, "cuda")
+    lut_tri, width_tri = dsd_lut(layout.cuda(), BLOCK, step, TRANS, "cuda")
+    assert width_ref == width_tri
+    assert torch.equal(lut_ref, lut_tri[:lut_ref.shape[0]])
+    assert not lut_tri[lut_ref.shape[0]:].any()
+    # softmax
+    lut_ref, maxlut_ref = _softmax.make_lut(layout, BLOCK, "cuda")
+    lut_tri, maxlut_tri = _softmax.make_lut(layout.cuda(), BLOCK, "cuda")
+    assert maxlut_ref == maxlut_tri
+    assert torch.equal(lut_ref, lut_tri[:lut_ref.shape[0]])
@@ -0,0 +1,37 @@
+import pytest
+import torch
+
+import triton
+
+requires_peers = pytest.mark.skipif(torch.cuda.device_count() < 2, reason="needs at least 2 GPUs")
+
+
+def _devices():
+    devices = list(range(torch.cuda.device_count()))
+    return [d for d in devices if all(d == p or torch.cuda.can_device_access_peer(d, p) for p in devices)]
+
+
+@requires_peers
+@pytest.mark.parametrize("N", [1, 1000, 1 << 20])
+@pytest.mark.parametrize("dtype", [torch.float16, torch.float32])
+def test_all_reduce(N, dtype):
+    torch.manual_seed(0)
+    devices = _devices()
+    comm = triton.ops.Communicator(devices)
+    # repeated calls reuse the flags of the previous ones
+    for _ in range(3):
+        xs = [torch.randn(N, dtype=dtype, device=f'cuda:{d}') for d in devices]
+        ref = sum(x.float().cpu() for x in xs)
+        for out in comm.all_reduce(xs):
+            torch.cuda.synchronize(out.device)
+            assert torch.allclose(out.float().cpu(), ref, rtol=1e-2, atol=1e-2)
+
+
+@requires_peers
+@pytest.mark.parametrize("shape", [(7,), (33, 129)])
+def test_all_gather(shape):
+    devices = _devices()
+    xs = [torch.randint(0, 1000, shape, dtype=torch.int32, device=f'cuda:{d}') for d in devices]
+    ref = torch.stack([x.cpu() for x in xs])
+    for out in triton.ops.all_gather(xs):
+        assert torch.equal(out.cpu(), ref)
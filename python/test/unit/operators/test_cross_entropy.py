@@ -33,3 +33,20 @@ def test_op(M, N, dtype, mode):
         th_y.backward(dy)
         th_dx = x.grad.clone()
         triton.testing.assert_almost_equal(th_dx, tt_dx)
+
+
+@pytest.mark.parametrize("M, N", [(64, 50257), (16, 131072)])
+@pytest.mark.parametrize("dtype", ['float16', 'float32'])
+def test_op_chunked(M, N, dtype):
+    dtype = {'float16': torch.float16, 'float32': torch.float32}[dtype]
+    x = torch.randn(M, N, dtype=dtype, device='cuda', requires_grad=True)
+    idx = torch.randint(N, (M,), dtype=torch.int64, device='cuda')
+    tt_y = triton.ops.cross_entropy(x, idx)
+    th_y = torch.nn.CrossEntropyLoss(reduction="none")(x.float(), idx).to(dtype)
+    triton.testing.assert_almost_equal(th_y, tt_y)
+    dy = torch.randn_like(tt_y)
+    tt_y.backward(dy)
+    tt_dx = x.grad.clone()
+    x.grad.zero_()
+    th_y.backward(dy)
+    triton.testing.assert_almost_equal(x.grad, tt_dx)
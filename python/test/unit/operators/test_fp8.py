@@ -0,0 +1,50 @@
+import pytest
+import torch
+
+import triton
+import triton.language as tl
+
+
+@triton.jit
+def _dequantize(X, Y, N, BLOCK: tl.constexpr):
+    off = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+    mask = off < N
+    tl.store(Y + off, tl.load(X + off, mask=mask), mask=mask)
+
+
+def dequantize(y):
+    out = torch.empty(y.shape, dtype=torch.float16, device=y.device)
+    _dequantize[(triton.cdiv(y.numel(), 1024),)](triton.reinterpret(y, tl.float8), out, y.numel(), BLOCK=1024)
+    return out.float()
+
+
+@pytest.mark.parametrize("M, N", [(128, 256), (107, 233), (1, 64)])
+@pytest.mark.parametrize("DTYPE", [torch.float16, torch.bfloat16, torch.float32])
+@pytest.mark.parametrize("transpose", [False, True])
+def test_quantize(M, N, DTYPE, transpose):
+    torch.manual_seed(0)
+    x = (torch.randn((M, N), device="cuda") * 3).to(DTYPE)
+    scale = torch.tensor([0.5], device="cuda")
+    # values of the previous steps are kept
+    amax = torch.tensor([0.25], device="cuda")
+    y, yt, amax = triton.ops.fp8_quantize(x, scale, amax, transpose=transpose)
+    assert amax.item() == max(x.float().abs().max().item(), 0.25)
+    ref = (x.float() * 0.5).clamp(-triton.ops.FP8_MAX, triton.ops.FP8_MAX)
+    # 3 bits of mantissa
+    assert torch.all((dequantize(y) - ref).abs() <= ref.abs() / 16 + 2**-9)
+    if transpose:
+        assert torch.equal(yt, y.t())
+    else:
+        assert yt is None
+
+
+def test_update_scale():
+    history = torch.tensor([4., 0., 1.], device="cuda")
+    scale = torch.tensor([1.], device="cuda")
+    triton.ops.fp8_update_scale(history, scale, margin=1)
+    assert scale.item() == triton.ops.FP8_MAX / 8
+    assert history.tolist() == [0., 4., 0.]
+    # a history without amax keeps the scale
+    history.zero_()
+    triton.ops.fp8_update_scale(history, scale)
+    assert scale.item() == triton.ops.FP8_MAX / 8
@@ -0,0 +1,37 @@
+import pytest
+import torch
+
+import triton
+
+
+@pytest.mark.parametrize("M, N", [(1151, 1024), (128, 8192), (64, 12345)])
+@pytest.mark.parametrize("dtype", [torch.float16, torch.float32])
+@pytest.mark.parametrize("mode", ["layer_norm", "rms_norm"])
+def test_op(M, N, dtype, mode, eps=1e-5):
+    torch.manual_seed(0)
+    weight = torch.rand((N,), dtype=dtype, device='cuda', requires_grad=True)
+    bias = torch.rand((N,), dtype=dtype, device='cuda', requires_grad=True)
+    x = -2.3 + 0.5 * torch.randn((M, N), dtype=dtype, device='cuda')
+    dy = .1 * torch.randn_like(x)
+    x.requires_grad_(True)
+    params = [x, weight, bias] if mode == "layer_norm" else [x, weight]
+    # forward pass
+    if mode == "layer_norm":
+        y_tri = triton.ops.layer_norm(x, weight, bias, eps)
+        y_ref = torch.nn.functional.layer_norm(x.float(), (N,), weight.float(), bias.float(), eps).to(dtype)
+    else:
+        y_tri = triton.ops.rms_norm(x, weight, eps)
+        xf = x.float()
+        y_ref = (xf * torch.rsqrt(xf.pow(2).mean(-1, keepdim=True) + eps) * weight.float()).to(dtype)
+    # backward pass
+    y_tri.backward(dy)
+    grads_tri = [p.grad.clone() for p in params]
+    for p in params:
+        p.grad = None
+    y_ref.backward(dy)
+    grads_ref = [p.grad.clone() for p in params]
+    # compare
+    triton.testing.assert_almost_equal(y_tri, y_ref)
+    triton.testing.assert_almost_equal(grads_tri[0], grads_ref[0])
+    for g_tri, g_ref in zip(grads_tri[1:], grads_ref[1:]):
+        triton.testing.assert_almost_equal(g_tri, g_ref, decimal=1)
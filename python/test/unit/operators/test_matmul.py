@@ -75,8 +75,8 @@ def test_op(BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K, NWARP, NSTAGE, M, N, K, AT, BT,
     torch.manual_seed(0)
     # nuke kernel decorators -- will set meta-parameters manually
     kwargs = {'BLOCK_M': BLOCK_M, 'BLOCK_N': BLOCK_N, 'BLOCK_K': BLOCK_K, 'SPLIT_K': SPLIT_K}
-    pre_hook = None if SPLIT_K == 1 else lambda nargs: nargs['C'].zero_()
-    configs = [triton.Config(kwargs=kwargs, num_warps=NWARP, num_stages=NSTAGE, pre_hook=pre_hook)]
+    # split-k slices accumulate in turn, without zeroing C first
+    configs = [triton.Config(kwargs=kwargs, num_warps=NWARP, num_stages=NSTAGE)]
     kernel = triton.ops._matmul.kernel
     decorators = kernel.kernel_decorators
     kernel.kernel_decorators = []
@@ -96,3 +96,228 @@ def test_op(BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K, NWARP, NSTAGE, M, N, K, AT, BT,
     th_c = torch.matmul(a, b)
     tt_c = triton.testing.catch_oor(lambda: triton.ops.matmul(a, b), pytest)
     triton.testing.assert_almost_equal(th_c, tt_c)
+
+
+@pytest.mark.parametrize(
+    "BLOCK_M, BLOCK_N, BLOCK_K, NUM_CTAS, M, N, K, DTYPE",
+    [
+        (64, 64, 32, NUM_CTAS, M, N, K, DTYPE)
+        for NUM_CTAS in [1, 3, 7]
+        for M, N, K in [(64, 64, 32), (192, 320, 160), (107, 233, 311)]
+        for DTYPE in ["float16", "float32"]
+    ]
+)
+def test_stream_k(BLOCK_M, BLOCK_N, BLOCK_K, NUM_CTAS, M, N, K, DTYPE):
+    torch.manual_seed(0)
+    # nuke kernel decorators -- will set meta-parameters manually
+    kwargs = {'BLOCK_M': BLOCK_M, 'BLOCK_N': BLOCK_N, 'BLOCK_K': BLOCK_K}
+    configs = [triton.Config(kwargs=kwargs, num_warps=4, num_stages=2)]
+    kernel = triton.ops._matmul.stream_k_kernel
+    decorators = kernel.kernel_decorators
+    kernel.kernel_decorators = []
+    triton.autotune(configs, [])(kernel)
+    kernel.kernel_decorators += decorators[1:]
+    DTYPE = {"float16": torch.float16, "float32": torch.float32}[DTYPE]
+    a = .1 * torch.randn((M, K), device="cuda", dtype=DTYPE)
+    b = .1 * torch.randn((K, N), device="cuda", dtype=DTYPE)
+    c = torch.empty((M, N), device="cuda", dtype=DTYPE)
+    # programs split tiles at arbitrary iterations, and fix up partial tiles
+    workspace = torch.empty((NUM_CTAS, BLOCK_M * BLOCK_N), device="cuda", dtype=torch.float32)
+    locks = torch.zeros(NUM_CTAS, device="cuda", dtype=torch.int32)
+    kernel[(NUM_CTAS,)](a, b, c, workspace, locks, M, N, K,
+                        a.stride(0), a.stride(1), b.stride(0), b.stride(1), c.stride(0), c.stride(1),
+                        GROUP_M=8, ACC_TYPE=triton.language.float32)
+    triton.testing.assert_almost_equal(torch.matmul(a, b), c)
+    # all flags are consumed
+    assert locks.sum().item() == 0
+    assert triton.ops.matmul_perf_model.select_schedule(a, b, M, N, K) in ['data_parallel', 'split_k', 'stream_k']
+
+
+@pytest.mark.parametrize("M, N, K", [(1, 4096, 4096), (3, 233, 311), (8, 512, 96)])
+@pytest.mark.parametrize("DTYPE", ["float16", "float32", "int8"])
+def test_skinny(M, N, K, DTYPE):
+    torch.manual_seed(0)
+    if DTYPE == "int8":
+        a = torch.randint(-8, 8, (M, K), device="cuda", dtype=torch.int8)
+        b = torch.randint(-8, 8, (K, N), device="cuda", dtype=torch.int8)
+        # int32 sums are truncated to the int8 output
+        th_c = torch.matmul(a.float(), b.float()).to(torch.int32).to(torch.int8)
+        ACC_TYPE = triton.language.int32
+    else:
+        DTYPE = {"float16": torch.float16, "float32": torch.float32}[DTYPE]
+        a = .1 * torch.randn((M, K), device="cuda", dtype=DTYPE)
+        b = .1 * torch.randn((K, N), device="cuda", dtype=DTYPE)
+        th_c = torch.matmul(a, b)
+        ACC_TYPE = triton.language.float32
+    # slices of K are reduced through the workspace, which keeps its counters at zero
+    c = torch.empty((M, N), device="cuda", dtype=a.dtype)
+    for _ in range(2):
+        tt_c = triton.ops._matmul._call_skinny(a, b, c, ACC_TYPE)
+        if DTYPE == "int8":
+            assert torch.equal(th_c, tt_c)
+        else:
+            triton.testing.assert_almost_equal(th_c, tt_c)
+    assert triton.ops.matmul_perf_model.select_schedule(a, b, M, N, K) in ['data_parallel', 'split_k', 'stream_k',
+                                                                           'skinny']
+
+
+def test_perf_model(tmp_path, monkeypatch):
+    model = triton.ops.matmul_perf_model
+    monkeypatch.setenv('TRITON_MATMUL_PERF_TABLE', str(tmp_path / 'table.json'))
+    model.calibration.cache_clear()
+    a = torch.empty((4096, 4096), device="cuda", dtype=torch.float16)
+    kwargs = {'BLOCK_M': 128, 'BLOCK_N': 128, 'BLOCK_K': 32, 'SPLIT_K': 1}
+    args = dict(num_warps=4, num_stages=3, A=a, B=a, C=None, M=4096, N=4096, K=4096, **kwargs)
+    raw = model.estimate_matmul_time(**args)
+    # fewer resident CTAs mean more waves
+    assert model.estimate_matmul_time(**args, resources={'max_ctas_per_sm': 1}) >= raw
+    # measurements slower than the model scale its estimates up
+    config = triton.Config(kwargs, num_warps=4, num_stages=3)
+    model.update_perf_table(dict(A=a, M=4096, N=4096, K=4096), {config: 2 * raw})
+    calibrated = model.estimate_matmul_time(**args)
+    model.calibration.cache_clear()
+    assert raw < calibrated <= 2 * raw * (1 + 1e-6)
+
+
+@pytest.mark.parametrize("M, N, K", [(256, 256, 128), (107, 233, 311)])
+def test_dequant(M, N, K):
+    torch.manual_seed(0)
+    a = torch.randint(-8, 8, (M, K), device="cuda", dtype=torch.int8)
+    b = torch.randint(-8, 8, (K, N), device="cuda", dtype=torch.int8)
+    scale_a = torch.rand(M, device="cuda", dtype=torch.float32)
+    scale_b = torch.rand(N, device="cuda", dtype=torch.float32)
+    # scales are applied by the epilogue of the integer matmul
+    th_c = torch.matmul(a.float(), b.float()) * scale_a[:, None] * scale_b[None, :]
+    tt_c = triton.testing.catch_oor(lambda: triton.ops.matmul(a, b, scale_a, scale_b), pytest)
+    assert tt_c.dtype == torch.float16
+    triton.testing.assert_almost_equal(th_c.half(), tt_c, decimal=1)
+
+
+@pytest.mark.parametrize("M, N, K, group_size", [(1, 256, 512, 128), (16, 512, 256, 64), (107, 233, 512, 128)])
+def test_int4(M, N, K, group_size):
+    torch.manual_seed(0)
+    a = torch.randn((M, K), device="cuda", dtype=torch.float16)
+    w = torch.randn((K, N), device="cuda", dtype=torch.float16)
+    b, scales = triton.ops.pack_int4(w, group_size)
+    # reference on the dequantized weights
+    q = torch.stack([(b >> (4 * i)) & 0xF for i in range(8)], dim=1).reshape(K, N)
+    w_ref = (q - 8).half() * scales.repeat_interleave(group_size, dim=0)
+    th_c = torch.matmul(a, w_ref)
+    tt_c = triton.ops.matmul_int4(a, b, scales, group_size)
+    triton.testing.assert_almost_equal(th_c, tt_c, decimal=1)
+
+
+@pytest.mark.parametrize("M, N, K, DTYPE", [(128, 128, 128, torch.float16), (107, 233, 320, torch.float16),
+                                             (256, 64, 64, torch.bfloat16)])
+def test_2_4(M, N, K, DTYPE):
+    cc = _triton.runtime.cc(_triton.runtime.backend.CUDA, torch.cuda.current_device())
+    if cc < 80:
+        pytest.skip("Only test sparse tensor cores on devices with sm >= 80")
+    torch.manual_seed(0)
+    w = torch.randn((M, K), device="cuda", dtype=DTYPE)
+    b = torch.randn((K, N), device="cuda", dtype=DTYPE)
+    a, meta = triton.ops.compress_2_4(w)
+    # reference on the matrix rebuilt from the values and their positions
+    words = meta.long() & 0xFFFFFFFF
+    nibbles = torch.stack([(words >> (4 * i)) & 0xF for i in range(8)], dim=-1).reshape(M, K // 4)
+    idx = torch.stack([nibbles & 0x3, nibbles >> 2], dim=-1)
+    assert torch.all(idx[..., 0] < idx[..., 1])
+    pruned = torch.zeros((M, K // 4, 4), device="cuda", dtype=DTYPE)
+    pruned.scatter_(-1, idx, a.reshape(M, K // 4, 2))
+    pruned = pruned.reshape(M, K)
+    assert torch.all((pruned != 0).reshape(M, K // 4, 4).sum(-1) <= 2)
+    th_c = torch.matmul(pruned.float(), b.float()).to(DTYPE)
+    tt_c = triton.ops.matmul_2_4(a, meta, b)
+    triton.testing.assert_almost_equal(th_c, tt_c, decimal=1)
+
+
+@pytest.mark.parametrize("M, N, K", [(256, 256, 256), (107, 233, 311)])
+def test_3xtf32(M, N, K):
+    cc = _triton.runtime.cc(_triton.runtime.backend.CUDA, torch.cuda.current_device())
+    if cc < 80:
+        pytest.skip("Only test tf32 on devices with sm >= 80")
+    torch.manual_seed(0)
+    a = torch.randn((M, K), device="cuda", dtype=torch.float32)
+    b = torch.randn((K, N), device="cuda", dtype=torch.float32)
+    th_c = torch.matmul(a.double(), b.double())
+    tf32_err = (triton.ops.matmul(a, b).double() - th_c).abs().max().item()
+    err = (triton.ops.matmul(a, b, precision='3xtf32').double() - th_c).abs().max().item()
+    # the remainders recover most of the bits that tf32 drops
+    assert err < tf32_err / 16
+    assert err < 1e-3
+
+
+@pytest.mark.parametrize("BATCH_A, BATCH_B, M, N, K", [(4, 4, 128, 128, 64), (3, 0, 107, 233, 311), (1, 5, 64, 96, 128)])
+def test_batched(BATCH_A, BATCH_B, M, N, K):
+    torch.manual_seed(0)
+    # a batch size of 0 stands for a 2D operand
+    a = torch.randn((BATCH_A, M, K) if BATCH_A else (M, K), device="cuda", dtype=torch.float16)
+    b = torch.randn((BATCH_B, K, N) if BATCH_B else (K, N), device="cuda", dtype=torch.float16)
+    th_c = torch.matmul(a, b)
+    tt_c = triton.testing.catch_oor(lambda: triton.ops.matmul(a, b), pytest)
+    assert tt_c.shape == th_c.shape
+    triton.testing.assert_almost_equal(th_c, tt_c)
+
+
+@pytest.mark.parametrize("SHAPES", [[(128, 128, 64)], [(64, 256, 128), (107, 233, 311), (1, 64, 32), (512, 16, 64)]])
+def test_grouped(SHAPES):
+    torch.manual_seed(0)
+    a = [torch.randn((M, K), device="cuda", dtype=torch.float16) for M, N, K in SHAPES]
+    b = [torch.randn((K, N), device="cuda", dtype=torch.float16) for M, N, K in SHAPES]
+    # non-contiguous operands are handled by their strides
+    b[0] = b[0].t().contiguous().t()
+    tt_c = triton.ops.grouped_matmul(a, b)
+    for x, y, z in zip(a, b, tt_c):
+        triton.testing.assert_almost_equal(torch.matmul(x, y), z)
+
+
+@pytest.mark.parametrize("ACTIVATION", [None, 'relu', 'gelu', 'silu'])
+@pytest.mark.parametrize("M, N, K", [(256, 256, 128), (107, 233, 311)])
+def test_epilogue(ACTIVATION, M, N, K):
+    torch.manual_seed(0)
+    a = torch.randn((M, K), device="cuda", dtype=torch.float16)
+    b = torch.randn((K, N), device="cuda", dtype=torch.float16)
+    bias = torch.randn((N,), device="cuda", dtype=torch.float16)
+    residual = torch.randn((M, N), device="cuda", dtype=torch.float16)
+    alpha = 0.5
+    # reference in float32
+    th_c = alpha * torch.matmul(a.float(), b.float()) + bias.float()
+    th_c = {None: lambda x: x, 'relu': torch.relu, 'silu': torch.nn.functional.silu,
+            'gelu': lambda x: torch.nn.functional.gelu(x, approximate='tanh')}[ACTIVATION](th_c)
+    th_c = th_c + residual.float()
+    tt_c = triton.testing.catch_oor(lambda: triton.ops.matmul(a, b, bias=bias, activation=ACTIVATION, residual=residual,
+                                                              alpha=alpha, out_dtype=torch.float32), pytest)
+    assert tt_c.dtype == torch.float32
+    triton.testing.assert_almost_equal(th_c, tt_c, decimal=1)
+
+
+@pytest.mark.parametrize("ACTIVATION", ['silu', 'gelu'])
+@pytest.mark.parametrize("SHAPE, K, N", [((256,), 128, 256), ((3, 37), 311, 233)])
+@pytest.mark.parametrize("DTYPE", [torch.float16, torch.bfloat16])
+def test_gated_mlp(ACTIVATION, SHAPE, K, N, DTYPE):
+    cc = _triton.runtime.cc(_triton.runtime.backend.CUDA, torch.cuda.current_device())
+    if cc < 80 and DTYPE == torch.bfloat16:
+        pytest.skip("Only test bfloat16 on devices with sm >= 80")
+    torch.manual_seed(0)
+    x = torch.randn((*SHAPE, K), device="cuda", dtype=DTYPE) / K**0.5
+    w_gate = torch.randn((K, N), device="cuda", dtype=DTYPE)
+    w_up = torch.randn((K, N), device="cuda", dtype=DTYPE)
+    # reference in float32
+    act = {'silu': torch.nn.functional.silu,
+           'gelu': lambda x: torch.nn.functional.gelu(x, approximate='tanh')}[ACTIVATION]
+    th_y = act(torch.matmul(x.float(), w_gate.float())) * torch.matmul(x.float(), w_up.float())
+    tt_y = triton.testing.catch_oor(lambda: triton.ops.gated_mlp(x, w_gate, w_up, activation=ACTIVATION), pytest)
+    assert tt_y.shape == (*SHAPE, N) and tt_y.dtype == DTYPE
+    triton.testing.assert_almost_equal(th_y.to(DTYPE), tt_y, decimal=1)
+
+
+@pytest.mark.parametrize("M, N, K", [(256, 256, 256), (107, 233, 311), (16, 1024, 512)])
+def test_acc_fp16(M, N, K):
+    torch.manual_seed(0)
+    a = torch.randn((M, K), device="cuda", dtype=torch.float16) / 4
+    b = torch.randn((K, N), device="cuda", dtype=torch.float16) / 4
+    th_c = torch.matmul(a.float(), b.float())
+    tt_c = triton.testing.catch_oor(lambda: triton.ops.matmul(a, b, acc_dtype=torch.float16), pytest)
+    assert tt_c.dtype == torch.float16
+    # sums are rounded to float16 at every step of k
+    assert (tt_c.float() - th_c).abs().max().item() <= 1e-3 * K ** 0.5 * th_c.abs().max().item()
@@ -0,0 +1,44 @@
+import pytest
+import torch
+
+import triton
+
+
+@pytest.mark.parametrize("B, H, H_KV, D, PAGE", [(3, 4, 4, 64, 16), (2, 8, 2, 128, 32), (5, 2, 1, 32, 16)])
+@pytest.mark.parametrize("num_splits", [None, 1, 3])
+def test_op(B, H, H_KV, D, PAGE, num_splits, dtype=torch.float16):
+    torch.manual_seed(20)
+    max_pages = 9
+    num_pages = B * max_pages + 4
+    q = torch.randn((B, H, D), dtype=dtype, device="cuda")
+    k_cache = torch.randn((num_pages, H_KV, PAGE, D), dtype=dtype, device="cuda")
+    v_cache = torch.randn((num_pages, H_KV, PAGE, D), dtype=dtype, device="cuda")
+    # pages of the sequences are scattered across the cache
+    block_tables = torch.randperm(num_pages, device="cuda")[:B * max_pages].view(B, max_pages).to(torch.int32)
+    seqlens = torch.randint(1, max_pages * PAGE + 1, (B,), dtype=torch.int32, device="cuda")
+    seqlens[0] = max_pages * PAGE
+    sm_scale = 0.3
+    # reference implementation
+    ref_out = torch.empty_like(q)
+    for b in range(B):
+        n = seqlens[b].item()
+        pages = block_tables[b, :triton.cdiv(n, PAGE)].long()
+        k = k_cache[pages].transpose(1, 2).reshape(-1, H_KV, D)[:n].float()
+        v = v_cache[pages].transpose(1, 2).reshape(-1, H_KV, D)[:n].float()
+        k = k.repeat_interleave(H // H_KV, dim=1)
+        v = v.repeat_interleave(H // H_KV, dim=1)
+        p = torch.softmax(torch.einsum("hd,nhd->hn", q[b].float(), k) * sm_scale, dim=-1)
+        ref_out[b] = torch.einsum("hn,nhd->hd", p, v).to(dtype)
+    # triton implementation
+    tri_out = triton.ops.paged_attention(q, k_cache, v_cache, block_tables, seqlens, sm_scale, num_splits)
+    triton.testing.assert_almost_equal(ref_out, tri_out)
+
+
+def test_empty_sequence():
+    q = torch.randn((2, 2, 32), dtype=torch.float16, device="cuda")
+    cache = torch.randn((4, 2, 16, 32), dtype=torch.float16, device="cuda")
+    block_tables = torch.arange(4, dtype=torch.int32, device="cuda").view(2, 2)
+    seqlens = torch.tensor([0, 20], dtype=torch.int32, device="cuda")
+    out = triton.ops.paged_attention(q, cache, cache, block_tables, seqlens, num_splits=2)
+    assert torch.all(out[0] == 0)
+    assert torch.all(torch.isfinite(out[1]))
@@ -0,0 +1,31 @@
+import pytest
+import torch
+
+import triton
+
+
+@pytest.mark.parametrize("SHAPE, DIMS", [
+    # NHWC <-> NCHW
+    ((2, 17, 19, 64), (0, 3, 1, 2)),
+    ((2, 64, 17, 19), (0, 2, 3, 1)),
+    # head split and merge
+    ((3, 129, 8, 64), (0, 2, 1, 3)),
+    ((3, 8, 129, 64), (0, 2, 1, 3)),
+    # matrices, ranks 1 and 6
+    ((333, 257), (1, 0)),
+    ((1000,), (0,)),
+    ((2, 3, 4, 5, 6, 7), (5, 3, 1, 0, 2, 4)),
+    ((2, 1, 4, 1, 33, 7), (4, 0, 5, 3, 2, 1)),
+])
+@pytest.mark.parametrize("DTYPE", [torch.float16, torch.float32, torch.int8])
+def test_op(SHAPE, DIMS, DTYPE):
+    torch.manual_seed(0)
+    x = torch.randint(-100, 100, SHAPE, device="cuda").to(DTYPE)
+    y = triton.ops.permute(x, DIMS)
+    assert y.is_contiguous()
+    assert torch.equal(y, x.permute(DIMS).contiguous())
+
+
+def test_strided():
+    x = torch.randn((64, 96, 48), device="cuda")[:, ::2, 8:40]
+    assert torch.equal(triton.ops.permute(x, (2, 0, 1)), x.permute(2, 0, 1).contiguous())
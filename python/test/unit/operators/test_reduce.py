@@ -0,0 +1,35 @@
+import pytest
+import torch
+
+import triton
+
+
+@pytest.mark.parametrize("M, N", [(1, 1 << 20), (4, 100003), (333, 4096), (2, 17)])
+@pytest.mark.parametrize("op", ["sum", "max", "argmax"])
+@pytest.mark.parametrize("dtype", [torch.float16, torch.float32])
+def test_op(M, N, op, dtype):
+    torch.manual_seed(0)
+    x = torch.randn((M, N), dtype=dtype, device='cuda')
+    ref = {'sum': lambda x: x.float().sum(-1).to(dtype),
+           'max': lambda x: x.max(-1)[0],
+           'argmax': lambda x: x.argmax(-1)}[op](x)
+    tri = triton.ops.reduce(x, op)
+    if op == 'argmax':
+        # ties are unlikely but rounding may pick an equal value
+        assert torch.equal(x.gather(1, tri[:, None]), x.gather(1, ref[:, None]))
+    elif op == 'max':
+        assert torch.equal(tri, ref)
+    else:
+        # long sums are compared in relative terms
+        assert torch.allclose(tri.float(), ref.float(), rtol=1e-2, atol=1e-1)
+
+
+@pytest.mark.parametrize("num_chunks", [1, 7, 64])
+def test_global(num_chunks):
+    torch.manual_seed(0)
+    x = torch.randn((17, 3, 1021), dtype=torch.float32, device='cuda')
+    x.view(-1)[12345] = 100.
+    # global reductions, repeated to check that the counters are reset
+    for _ in range(3):
+        assert triton.ops.reduce(x, 'argmax', dim=None, num_chunks=num_chunks).item() == 12345
+        assert torch.allclose(triton.ops.reduce(x * x, 'sum', dim=None, num_chunks=num_chunks), (x * x).sum(), rtol=1e-4)
@@ -0,0 +1,58 @@
+import ctypes
+import os
+import shutil
+import subprocess
+
+import pytest
+import torch
+
+import triton
+import triton.language as tl
+from triton.tools import aot
+
+
+@triton.jit
+def add_kernel(X, Y, Z, N, BLOCK: tl.constexpr):
+    offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+    mask = offs < N
+    tl.store(Z + offs, tl.load(X + offs, mask=mask) + tl.load(Y + offs, mask=mask), mask=mask)
+
+
+def test_parse_signature():
+    args = aot.parse_signature(add_kernel, "*fp32:16, *f32, *f32, i32:16, 256")
+    assert [a.kind for a in args] == ['ptr', 'ptr', 'ptr', 'scalar', 'constant']
+    assert args[0].type == 'f32' and args[0].divisibility == 16
+    assert args[4].value == 256
+    # parameters are packed as by the launcher
+    assert aot._pack(aot.parse_signature(add_kernel, "*f32, *f32, *f32, i32, 256")) == ([0, 8, 16, 24], 28)
+    with pytest.raises(ValueError):
+        aot.parse_signature(add_kernel, "*f32, *f32, *f32, i32, i32")
+
+
+def test_aot_launch(tmp_path):
+    cuda_home = os.environ.get('CUDA_HOME', '/usr/local/cuda')
+    cc = shutil.which('cc')
+    if cc is None or not os.path.exists(os.path.join(cuda_home, 'include', 'cuda.h')):
+        pytest.skip("a C compiler and the CUDA headers are required")
+    signatures = ["*f32:16, *f32:16, *f32:16, i32:16, 256", "*f32, *f32, *f32, i32, 256"]
+    header, source = aot.compile(add_kernel, signatures, 'add', str(tmp_path))
+    with open(header) as f:
+        text = f.read()
+    assert 'CUresult add_0(CUstream stream' in text
+    assert 'CUresult add(CUstream stream' in text
+    lib = str(tmp_path / 'libadd.so')
+    subprocess.check_call([cc, '-shared', '-fPIC', '-O2', f'-I{cuda_home}/include', source, '-o', lib, '-lcuda'])
+    add = ctypes.CDLL(lib)
+    torch.zeros(1, device='cuda')
+    assert add.add_load() == 0
+    for offset in [0, 1]:
+        N = 1000
+        x = torch.randn(N + offset, device='cuda')[offset:]
+        y = torch.randn(N + offset, device='cuda')[offset:]
+        z = torch.empty(N + offset, device='cuda')[offset:]
+        stream = torch.cuda.current_stream().cuda_stream
+        args = [ctypes.c_void_p(stream), ctypes.c_uint(triton.cdiv(N, 256)), ctypes.c_uint(1), ctypes.c_uint(1),
+                ctypes.c_uint64(x.data_ptr()), ctypes.c_uint64(y.data_ptr()), ctypes.c_uint64(z.data_ptr()), ctypes.c_int32(N)]
+        assert add.add(*args) == 0
+        triton.testing.assert_almost_equal(z, x + y)
+    assert add.add_unload() == 0
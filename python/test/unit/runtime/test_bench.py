@@ -0,0 +1,45 @@
+import torch
+
+import triton
+import triton.language as tl
+
+
+@triton.jit
+def add_one(X, Y, N, BLOCK: tl.constexpr):
+    off = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+    mask = off < N
+    tl.store(Y + off, tl.load(X + off, mask=mask) + 1, mask=mask)
+
+
+def test_do_bench_cupti():
+    N = 1 << 20
+    x = torch.randn(N, device='cuda')
+    y = torch.empty_like(x)
+    grid = (triton.cdiv(N, 1024),)
+
+    def fn():
+        add_one[grid](x, y, N, BLOCK=1024)
+        add_one[grid](y, x, N, BLOCK=1024)
+        # not a Triton kernel: filtered out
+        torch.add(x, 1, out=y)
+    timings = triton.testing.do_bench_cupti(fn, warmup=5, rep=20, kernels=[add_one])
+    assert list(timings.keys()) == ['add_one']
+    timing = timings['add_one']
+    assert timing.launches_per_call == 2
+    assert len(timing.binaries) == 1 and timing.binaries[0].bin.name == 'add_one'
+    median, lo, hi = timing.percentiles()
+    assert 0 < lo <= median <= hi
+
+
+def test_do_bench_clocks():
+    state = triton.testing.gpu_state()
+    assert 0 < state['sm_clock'] <= state['max_sm_clock']
+    assert 0 < state['mem_clock'] <= state['max_mem_clock']
+    x = torch.randn(1 << 20, device='cuda')
+    y = torch.empty_like(x)
+    fn = lambda: add_one[(1024,)](x, y, x.numel(), BLOCK=1024)
+    ms, clocks = triton.testing.do_bench(fn, percentiles=None, record_clocks=True)
+    assert ms > 0
+    assert set(clocks.keys()) == {'before', 'after', 'drift'}
+    assert clocks['drift'] >= 0
+    assert clocks['before']['sm_clock'] > 0 and clocks['after']['sm_clock'] > 0
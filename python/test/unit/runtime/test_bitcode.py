@@ -0,0 +1,59 @@
+import pytest
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+
+@triton.jit
+def softmax(Y, X, N, BLOCK: tl.constexpr):
+    row = tl.program_id(0)
+    off = tl.arange(0, BLOCK)
+    x = tl.load(X + row * N + off, mask=off < N, other=-float('inf'))
+    x = x - tl.max(x, axis=0)
+    num = tl.exp(x)
+    tl.store(Y + row * N + off, num / tl.sum(num, axis=0), mask=off < N)
+
+
+def _generate():
+    arg_types = [('ptr', 'f32'), ('ptr', 'f32'), ('scalar', 'i32'), ('scalar', 'i32')]
+    attributes = {0: 16, 1: 16}
+    return softmax._generate_ttir(arg_types, attributes, {3: 128})
+
+
+def test_roundtrip():
+    context, generator = _generate()
+    text = generator.module.text()
+    bitcode = generator.module.bitcode()
+    assert len(bitcode) < len(text)
+    builder = _triton.ir.builder(context)
+    from_bitcode = _triton.ir.read_bitcode(bitcode, builder)
+    from_text = _triton.ir.parse_text(text, builder)
+    assert from_bitcode.text() == text
+    assert from_text.text() == text
+    assert from_text.bitcode() == bitcode
+
+
+def test_compile_roundtrip():
+    context, generator = _generate()
+    device = torch.cuda.current_device()
+    backend = _triton.runtime.backend.CUDA
+    builder = _triton.ir.builder(context)
+    module = _triton.ir.read_bitcode(generator.module.bitcode(), builder)
+    _, ref, _, _ = _triton.code_gen.compile_ttir(backend, generator.module, device, 4, 2)
+    _, asm, _, _ = _triton.code_gen.compile_ttir(backend, module, device, 4, 2)
+    assert asm['ttir'] == ref['ttir']
+    assert asm['ptx'] == ref['ptx']
+
+
+def test_invalid():
+    context, generator = _generate()
+    builder = _triton.ir.builder(context)
+    text = generator.module.text()
+    with pytest.raises(RuntimeError, match="version"):
+        _triton.ir.parse_text(text.replace('module 4 ', 'module 1000 ', 1), builder)
+    with pytest.raises(RuntimeError, match="line 2"):
+        _triton.ir.parse_text(text.split('\n')[0] + '\nfoo\n', builder)
+    with pytest.raises(RuntimeError):
+        _triton.ir.read_bitcode(generator.module.bitcode()[:-3], builder)
@@ -1,6 +1,9 @@
+import json
 import os
 import re
 import shutil
+import threading
+import time
 
 import pytest
 import torch
@@ -68,6 +71,36 @@ def test_nested1_change():
     assert baseline != updated
 
 
+def test_callee_cache_key():
+    # functions hashed as dependencies first still depend on the compiler
+    JITFunction.cache_key.fget.cache_clear()
+    for fn in (kernel, function_1, function_2):
+        fn.hash = None
+    kernel.cache_key
+    assert function_2.cache_key.endswith(triton.code_gen.version_key())
+
+
+def test_version_key_memo():
+    reset_tmp_dir()
+    triton.code_gen.version_key.cache_clear()
+    key = triton.code_gen.version_key()
+    memo = os.path.join(tmpdir, 'version_key.json')
+    with open(memo) as f:
+        record = json.load(f)
+    assert record['key'] == key
+    # files that did not change are not hashed again
+    with open(memo, 'w') as f:
+        json.dump({'stamps': record['stamps'], 'key': 'memo'}, f)
+    triton.code_gen.version_key.cache_clear()
+    assert triton.code_gen.version_key() == 'memo'
+    # files that changed are
+    record['stamps'][0][-1] -= 1
+    with open(memo, 'w') as f:
+        json.dump({'stamps': record['stamps'], 'key': 'memo'}, f)
+    triton.code_gen.version_key.cache_clear()
+    assert triton.code_gen.version_key() == key
+
+
 def reset_tmp_dir():
     os.environ["TRITON_CACHE_DIR"] = tmpdir
     if os.path.exists(tmpdir):
@@ -130,3 +163,692 @@ def test_value_specialization(value: int, value_type: str, device='cuda') -> Non
     cache_str_match = re.match(r'_(\w+)\[multipleof\(\d+\)]_float32\*\[multipleof\(16\)\]', cache_str[-1])
     spec_type = None if cache_str_match is None else cache_str_match.group(1)
     assert spec_type == value_type
+
+
+def test_compile_batch():
+
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        tl.store(X, i + BLOCK)
+
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    with triton.code_gen.CompileBatch():
+        for BLOCK in [1, 2, 4]:
+            kernel[(1,)](x, 3, BLOCK=BLOCK)
+    # kernels are compiled but not launched
+    assert len(kernel.bin_cache) == 3
+    assert x.item() == 0
+    kernel[(1,)](x, 3, BLOCK=4)
+    assert len(kernel.bin_cache) == 3
+    assert x.item() == 7
+
+
+def test_compile_batch_other_thread():
+
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        tl.store(X, i + BLOCK)
+
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    y = torch.zeros(1, dtype=torch.int32, device='cuda')
+
+    def launch():
+        kernel[(1,)](y, 5, BLOCK=2)
+        torch.cuda.synchronize()
+
+    with triton.code_gen.CompileBatch():
+        kernel[(1,)](x, 3, BLOCK=1)
+        # a batch only collects the kernels of the thread that entered it
+        thread = threading.Thread(target=launch)
+        thread.start()
+        thread.join()
+        assert y.item() == 7
+    assert x.item() == 0
+
+
+def test_compile_batch_linked():
+
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        tl.store(X, i + BLOCK)
+
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    with triton.code_gen.CompileBatch(num_threads=1):
+        for BLOCK in [1, 2, 4]:
+            kernel[(1,)](x, 3, BLOCK=BLOCK)
+    # a single thread assembles and loads all of them at once
+    binaries = list(kernel.bin_cache.values())
+    assert len(binaries) == 3
+    assert len({bin.module for bin in binaries}) == 1
+    assert len({bin.bin.name for bin in binaries}) == 3
+    for BLOCK in [1, 2, 4]:
+        kernel[(1,)](x, 3, BLOCK=BLOCK)
+        assert x.item() == 3 + BLOCK
+
+
+def test_ttir_cache():
+
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        tl.store(X, i + BLOCK)
+
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    # the front-end runs once for all the configurations of a signature
+    for num_warps in [1, 2, 4]:
+        kernel[(1,)](x, 3, BLOCK=16, num_warps=num_warps)
+        assert x.item() == 19
+    assert len(kernel.bin_cache) == 3
+    assert len(kernel.ttir_cache) == 1
+    kernel[(1,)](x, 3, BLOCK=32)
+    assert len(kernel.ttir_cache) == 2
+    # and again once its source changes
+    kernel.src = kernel.src.replace('i + BLOCK', 'i - BLOCK')
+    assert len(kernel.ttir_cache) == 0
+
+
+def test_launch_cache():
+
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        tl.store(X, i + BLOCK)
+
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    for i in [2, 4, 2, 4]:
+        kernel[(1,)](x, i, BLOCK=16)
+    assert len(kernel.launch_cache) == 2
+    assert x.item() == 20
+    # constexprs are compared by type and value
+    kernel[(1,)](x, 4, BLOCK=True)
+    kernel[(1,)](x, 4, BLOCK=1)
+    assert len(kernel.launch_cache) == 4
+    assert len(kernel.bin_cache) == 4
+    assert x.item() == 5
+
+
+def test_launch_arg_types():
+
+    @triton.jit
+    def kernel(X, i):
+        tl.store(X, i)
+
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.float32, device='cuda')
+    # arguments are parsed according to the types they had on the previous launch,
+    # until they change
+    for i in [2, 2.5, 3, True, 4.5]:
+        kernel[(1,)](x, i)
+        assert x.item() == float(i)
+    with pytest.raises(RuntimeError, match="Received type 'str' for argument 1"):
+        kernel[(1,)](x, 'a')
+    kernel[(1,)](x, 5)
+    assert x.item() == 5
+
+
+def test_launch_many():
+
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        tl.store(X + offs, tl.load(X + offs) + i)
+
+    reset_tmp_dir()
+    xs = [torch.zeros(128, dtype=torch.float32, device='cuda') for _ in range(8)]
+    # two specializations of the kernel, each compiled once
+    arg_lists = [(x, i, 64 if i % 2 else 128) for i, x in enumerate(xs)]
+    bins = kernel.launch_many(arg_lists, [(1,)] * len(xs))
+    assert len(set(bins)) == 2
+    assert len(kernel.bin_cache) == 2
+    for i, x in enumerate(xs):
+        block = 64 if i % 2 else 128
+        assert torch.all(x[:block] == i) and torch.all(x[block:] == 0)
+    with pytest.raises(ValueError):
+        kernel.launch_many(arg_lists, [(1,)])
+
+
+def test_launch_fused():
+
+    @triton.jit
+    def kernel(X, Y, N, alpha, BLOCK: tl.constexpr):
+        offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        mask = offs < N
+        tl.store(Y + tl.program_id(1) * N + offs, tl.load(X + offs, mask=mask) * alpha + tl.program_id(1), mask=mask)
+
+    reset_tmp_dir()
+    sizes = [1000, 1, 4096, 0, 333]
+    xs = [torch.randn(n, dtype=torch.float32, device='cuda') for n in sizes]
+    ys = [torch.zeros(2 * n, dtype=torch.float32, device='cuda') for n in sizes]
+    arg_lists = [(x, y, n, 0.5 * i, 128) for i, (x, y, n) in enumerate(zip(xs, ys, sizes))]
+    # second axes of the grids are remapped too
+    grids = [lambda meta, n=n: (triton.cdiv(n, meta['BLOCK']), 2) for n in sizes]
+    kernel.launch_fused(arg_lists, grids)
+    assert len(kernel.bin_cache) == 1
+    for i, (x, y) in enumerate(zip(xs, ys)):
+        triton.testing.assert_almost_equal(y, torch.cat([x * 0.5 * i, x * 0.5 * i + 1]))
+    with pytest.raises(ValueError):
+        kernel.launch_fused(arg_lists[:2] + [(xs[0], ys[0], 1000, 1., 64)], [(1,)] * 3)
+    with pytest.raises(ValueError):
+        kernel.launch_fused(arg_lists, [(1,)])
+
+
+def test_launch_device():
+
+    @triton.jit
+    def kernel(X):
+        tl.store(X, 1)
+
+    reset_tmp_dir()
+    runtime = triton._C.libtriton.triton.runtime
+    for device in range(torch.cuda.device_count()):
+        with torch.cuda.device(device):
+            x = torch.zeros(1, device='cuda')
+            assert runtime.current_device(runtime.backend.CUDA) == device
+            kernel[(1,)](x)
+            assert x.item() == 1
+    # keys of binaries end their kernel's key with the compute capability of their device
+    cc = torch.cuda.get_device_capability()
+    assert all(f'cc{cc[0]}-{cc[1]}-' in key for key in kernel.bin_cache)
+
+
+def test_launch_device_without_allocation():
+    if torch.cuda.device_count() < 2:
+        pytest.skip("requires two GPUs")
+
+    @triton.jit
+    def kernel(X):
+        tl.store(X, 1)
+
+    reset_tmp_dir()
+    # before CUDA 12, nothing run by PyTorch in the block makes the context of device 1 current
+    xs = [torch.zeros(1, device=f'cuda:{device}') for device in range(2)]
+    torch.cuda.synchronize(0)
+    with torch.cuda.device(1):
+        kernel[(1,)](xs[1])
+        assert torch.cuda.current_device() == 1
+    assert xs[1].item() == 1
+    # tensors on another device than PyTorch's current one
+    kernel[(1,)](xs[1])
+    kernel[(1,)](xs[0])
+    assert torch.cuda.current_device() == 0
+    assert xs[0].item() == 1
+
+
+def test_pointer_range_size():
+    get_size = triton._C.libtriton.triton.runtime.get_pointer_range_size
+    x = torch.empty(1 << 20, dtype=torch.int8, device='cuda')
+    size = get_size(x.data_ptr())
+    assert size >= x.numel()
+    # pointers in a cached range, and after the cache is cleared
+    assert get_size(x.data_ptr() + 1000) == size
+    triton._C.libtriton.triton.runtime.clear_pointer_ranges()
+    assert get_size(x.data_ptr() + 1000) == size
+    assert get_size(0) == 0
+
+
+def test_stride_specialization():
+
+    @triton.jit(strides=['stride'])
+    def kernel(X, Y, stride, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        tl.store(Y + offs, tl.load(X + offs * stride))
+
+    reset_tmp_dir()
+    x = torch.arange(128 * 64, dtype=torch.float32, device='cuda')
+    y = torch.empty(64, device='cuda')
+    # strides are only specialized on being 1 or multiples of 16
+    for stride, n_bins in [(16, 1), (48, 1), (8, 2), (24, 2), (1, 3)]:
+        kernel[(1,)](x, y, stride, BLOCK=64)
+        assert torch.equal(y, x[::stride][:64])
+        assert len(kernel.bin_cache) == n_bins
+
+
+def test_ptxas_info():
+
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        tl.store(X, i + BLOCK)
+
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    kernel[(1,)](x, 3, BLOCK=1)
+    binary = list(kernel.bin_cache.values())[0].bin
+    assert binary.ptxas_info['n_regs'] > 0
+    assert binary.ptxas_info['n_spill_stores'] == 0
+    assert 'registers' in binary.ptxas_info['log']
+    resources = list(kernel.bin_cache.values())[0].resources
+    assert resources['n_regs'] > 0
+    assert resources['n_spill_bytes'] == 0
+    assert resources['max_ctas_per_sm'] >= 1
+
+
+def test_carveout():
+    # kernels without shared memory leave it all to L1
+    @triton.jit
+    def copy(Y, X, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        tl.store(Y + off, tl.load(X + off))
+
+    @triton.jit
+    def matmul(C, A, B, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        a = tl.load(A + off[:, None] * BLOCK + off[None, :])
+        b = tl.load(B + off[:, None] * BLOCK + off[None, :])
+        tl.store(C + off[:, None] * BLOCK + off[None, :], tl.dot(a, b))
+
+    x = torch.randn(64 * 64, dtype=torch.float16, device='cuda')
+    y = torch.empty_like(x)
+    copy[(1,)](y, x, BLOCK=1024)
+    matmul[(1,)](y, x, x, BLOCK=64)
+    for kernel, expected in [(copy, lambda c: c == 0), (matmul, lambda c: 0 < c <= 100)]:
+        binary = list(kernel.bin_cache.values())[0]
+        assert expected(binary.bin.carveout)
+        assert binary.resources['carveout'] == binary.bin.carveout
+
+
+def test_autotune_resource_prune():
+    benched = []
+
+    def prune(configs, binaries):
+        # every config is compiled before it is pruned
+        assert set(binaries) == set(configs)
+        return [config for config in configs if binaries[config].resources['max_ctas_per_sm'] >= 1][:1]
+
+    @triton.autotune(configs=[triton.Config({'BLOCK': 128}, num_warps=4),
+                              triton.Config({'BLOCK': 256}, num_warps=8)],
+                     key=['N'],
+                     prune_configs_by={'perf_model': None, 'top_k': None, 'resource_config_prune': prune})
+    @triton.jit
+    def kernel(X, N, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        tl.store(X + offs, tl.load(X + offs) + 1, mask=offs < N)
+
+    reset_tmp_dir()
+    x = torch.zeros(256, device='cuda')
+    kernel[(1,)](x, 256)
+    assert len(kernel.kernel.configs_timings) == 1
+
+
+def test_autotune_unload():
+
+    @triton.autotune(configs=[triton.Config({'BLOCK': 128}, num_warps=4),
+                              triton.Config({'BLOCK': 256}, num_warps=8)],
+                     key=['N'])
+    @triton.jit
+    def kernel(X, N, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        tl.store(X + offs, tl.load(X + offs) + 1, mask=offs < N)
+
+    reset_tmp_dir()
+    x = torch.zeros(256, device='cuda')
+    kernel[(1,)](x, 256)
+    # only the binary of the picked config stays loaded
+    binaries = list(kernel.bin_cache.values())
+    assert sorted(len(binary.modules) for binary in binaries) == [0, 1]
+    # and the others are loaded again when they are launched
+    for binary in binaries:
+        assert binary.resources['max_ctas_per_sm'] >= 1
+        assert len(binary.modules) == 1
+
+
+def test_autotune_store(tmp_path):
+
+    @triton.autotune(configs=[triton.Config({'BLOCK': 128}, num_warps=4),
+                              triton.Config({'BLOCK': 256}, num_warps=8)],
+                     key=['N'])
+    @triton.jit
+    def kernel(X, N, BLOCK: tl.constexpr):
+        offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        tl.store(X + offs, tl.load(X + offs) + 1, mask=offs < N)
+
+    reset_tmp_dir()
+    x = torch.zeros(1024, device='cuda')
+    kernel[(4,)](x, 1024)
+    tuner = kernel.kernel
+    best = tuner.best_config
+    # a new process finds the config without benchmarking
+    del tuner.configs_timings
+    tuner.cache.clear()
+    kernel[(4,)](x, 1024)
+    assert tuner.best_config is best
+    assert not hasattr(tuner, 'configs_timings')
+    # and so does a machine that imports the exported results
+    from triton.cache import TuningStore
+    path = str(tmp_path / 'tunings.json')
+    assert TuningStore.get(tmpdir).export(path) == 1
+    reset_tmp_dir()
+    tuner.cache.clear()
+    assert TuningStore.get(tmpdir).import_(path) == 1
+    kernel[(4,)](x, 1024)
+    assert tuner.best_config is best
+    assert not hasattr(tuner, 'configs_timings')
+
+
+@pytest.mark.parametrize("search", ['exhaustive', 'halving', 'model'])
+def test_autotune_search(search):
+    configs = [triton.Config({'BLOCK_M': m, 'BLOCK_N': n}, num_warps=w, num_stages=s)
+               for m in [16, 32, 64, 128, 256] for n in [16, 32, 64, 128] for w in [2, 4, 8] for s in [2, 3]]
+    best = triton.Config({'BLOCK_M': 64, 'BLOCK_N': 32}, num_warps=4, num_stages=3)
+    configs.append(best)
+    budgets = []
+
+    def bench(config, rep):
+        budgets.append(rep)
+        kw = config.kwargs
+        # configs with too large tiles run out of resources
+        if kw['BLOCK_M'] * kw['BLOCK_N'] > 8192:
+            return float('inf')
+        return 1 + abs(kw['BLOCK_M'] - 64) / 16 + abs(kw['BLOCK_N'] - 32) / 16 + \
+            abs(config.num_warps - 4) + abs(config.num_stages - 3) - (config is best) * 0.5
+
+    timings, picked = triton.search.get(search)(configs, bench)
+    assert timings[picked] < float('inf')
+    if search == 'exhaustive':
+        assert picked is best
+        assert sum(budgets) == 100 * len(configs)
+    else:
+        # the fastest config is found for a fraction of the benchmarking time
+        assert sum(budgets) < 0.5 * 100 * len(configs)
+    if search == 'halving':
+        assert picked is best
+
+
+def test_async_compile():
+
+    @triton.jit(async_compile=True)
+    def kernel(X, Y, N, BLOCK: tl.constexpr):
+        offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        tl.store(Y + offs, tl.load(X + offs, mask=offs < N) + 1, mask=offs < N)
+
+    def wait_compiled(n):
+        while len(kernel.compiled) < n:
+            time.sleep(0.01)
+
+    reset_tmp_dir()
+    x = torch.arange(1030, dtype=torch.float32, device='cuda')
+    y = torch.empty_like(x)
+    # without a generic binary, the first call compiles synchronously
+    kernel[(5,)](x, y, 1024, BLOCK=256)
+    assert len(kernel.bin_cache) == 1
+    triton.testing.assert_almost_equal(y[:1024], x[:1024] + 1)
+    # while the generic binary is compiled in the background
+    wait_compiled(1)
+    # new specializations are launched with it until they are compiled
+    ret = kernel[(5,)](x[1:], y[1:], 1029, BLOCK=256)
+    triton.testing.assert_almost_equal(y[1:], x[1:] + 1)
+    generic = [b for k, b in kernel.bin_cache.items() if 'multipleof' not in k][0]
+    assert ret.kernel == generic.kernel
+    wait_compiled(1)
+    ret = kernel[(5,)](x[1:], y[1:], 1029, BLOCK=256)
+    assert ret.kernel != generic.kernel
+    assert not kernel.compiled
+    assert len(kernel.bin_cache) == 3
+    triton.testing.assert_almost_equal(y[1:], x[1:] + 1)
+
+
+def test_shared_across_devices():
+
+    @triton.jit
+    def kernel(X, N, BLOCK: tl.constexpr):
+        offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        tl.store(X + offs, tl.load(X + offs, mask=offs < N) + 1, mask=offs < N)
+
+    devices = [i for i in range(torch.cuda.device_count())
+               if torch.cuda.get_device_capability(i) == torch.cuda.get_device_capability(0)]
+    if len(devices) < 2:
+        pytest.skip("requires two devices of the same architecture")
+    reset_tmp_dir()
+    xs = []
+    for device in devices:
+        with torch.cuda.device(device):
+            xs.append(torch.zeros(1000, device='cuda'))
+            kernel[(4,)](xs[-1], 1000, BLOCK=256)
+    # one compilation, loaded on each device
+    assert len(kernel.bin_cache) == 1
+    binary = list(kernel.bin_cache.values())[0]
+    assert sorted(binary.modules) == devices
+    for x in xs:
+        assert torch.all(x == 1)
+
+
+def test_compile_once(monkeypatch):
+
+    @triton.jit
+    def kernel(X, i):
+        tl.store(X, i)
+
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    kernel[(1,)](x, 2)
+    # another process that finds the binary in the cache under the
+    # compilation lock does not compile it
+    kernel.bin_cache.clear()
+    kernel.launch_cache.clear()
+
+    def compile(*args, **kwargs):
+        raise AssertionError("compiled twice")
+    monkeypatch.setattr(kernel, '_compile', compile)
+    kernel[(1,)](x, 3)
+    assert x.item() == 3
+    from triton.cache import CacheStore
+    store = CacheStore.get(tmpdir)
+    assert store.compile_lock('a') is store.compile_lock('a')
+
+
+def test_pass_stats(monkeypatch):
+
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        tl.store(X, i + BLOCK)
+
+    monkeypatch.setenv('TRITON_PASS_STATS', '1')
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    kernel[(1,)](x, 3, BLOCK=1)
+    stats = list(kernel.bin_cache.values())[0].asm['pass_stats']
+    for name in ['inliner', 'dce', 'peephole', 'coalesce', 'membar', 'isel']:
+        assert re.search(rf'^{name}\s', stats, re.MULTILINE)
+    # cleanups and analyses are not re-run on unchanged IR
+    assert re.search(r'^dce\s+skipped', stats, re.MULTILINE)
+    assert re.search(r'^shared memory: \d+ bytes allocated', stats, re.MULTILINE)
+
+
+def test_cache_store_eviction():
+    from triton.cache import CacheStore
+    reset_tmp_dir()
+    store = CacheStore(tmpdir, max_size=16 * 1024)
+    binary = triton.code_gen.Binary(None, 'kernel', {'ptx': '', 'cubin': bytes(1024)}, 0, 4)
+    for i in range(64):
+        store.put_binary(f'key-{i}', binary)
+    # least recently used entries are evicted first
+    assert store.get_binary('key-0') is None
+    cached = store.get_binary('key-63')
+    assert bytes(cached.asm['cubin']) == bytes(1024)
+    assert len(store) < 16
+    assert sum(os.path.getsize(os.path.join(tmpdir, f)) for f in os.listdir(tmpdir) if f.startswith('blobs')) < 64 * 1024
+
+
+@pytest.mark.parametrize('mode', ['lazy', 'none', 'eager'])
+def test_cache_store_ir(mode, monkeypatch):
+    from triton.cache import CacheStore
+    monkeypatch.setenv('TRITON_CACHE_IR', mode)
+    reset_tmp_dir()
+    store = CacheStore(tmpdir, max_size=1 << 20)
+    ptx = '.version 7.0\n' * 4096
+    binary = triton.code_gen.Binary(None, 'kernel', {'ptx': ptx, 'cubin': bytes(1024)}, 0, 4)
+    store.put_binary('key', binary)
+    cached = store.get_binary('key')
+    assert bytes(cached.asm['cubin']) == bytes(1024)
+    if mode == 'none':
+        assert 'ptx' not in cached.asm
+    else:
+        assert cached.asm['ptx'] == ptx
+        assert dict(cached.asm)['ptx'] == ptx
+    blobs = sum(os.path.getsize(os.path.join(tmpdir, f)) for f in os.listdir(tmpdir) if f.startswith('blobs'))
+    assert (blobs < 4096) == (mode != 'eager')
+
+
+def test_remote_cache(tmp_path):
+    from triton.cache import CacheStore, RemoteCache
+    remote = RemoteCache.get(str(tmp_path / 'remote'))
+    binary = triton.code_gen.Binary(None, 'kernel', {'ptx': '', 'cubin': bytes(1024)}, 0, 4)
+    writer = CacheStore(str(tmp_path / 'a'), max_size=1 << 20, remote=remote)
+    for sig in ['i32', 'i64']:
+        for num_warps in [4, 8]:
+            writer.put_binary(f'hash-80-{num_warps}-2-_{sig}', binary)
+    writer.put_binary('hash-70-4-2-_i32', binary)
+    # the binaries of a kernel are fetched with its first miss
+    reader = CacheStore(str(tmp_path / 'b'), max_size=1 << 20, remote=remote)
+    assert bytes(reader.get_binary('hash-80-4-2-_i32').asm['cubin']) == bytes(1024)
+    assert len(reader) == 4
+    assert reader.get_binary('hash-80-4-2-_f32') is None
+    assert len(reader) == 4
+    assert reader.get_binary('hash-70-4-2-_i32') is not None
+    assert len(reader) == 5
+
+
+def test_warp_specialize(monkeypatch):
+
+    @triton.jit
+    def kernel(X, Y, Z, K, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        x_ptrs = X + off[:, None] * K + off[None, :]
+        y_ptrs = Y + off[:, None] * BLOCK + off[None, :]
+        acc = tl.zeros((BLOCK, BLOCK), dtype=tl.float32)
+        for k in range(0, K, BLOCK):
+            acc += tl.dot(tl.load(x_ptrs), tl.load(y_ptrs))
+            x_ptrs += BLOCK
+            y_ptrs += BLOCK * BLOCK
+        tl.store(Z + off[:, None] * BLOCK + off[None, :], acc)
+
+    if torch.cuda.get_device_capability()[0] < 8:
+        pytest.skip("warp specialization requires asynchronous copies (sm80+)")
+    monkeypatch.setenv('TRITON_WARP_SPECIALIZE', '1')
+    reset_tmp_dir()
+    BLOCK, K = 64, 512
+    x = torch.randn((BLOCK, K), dtype=torch.float16, device='cuda')
+    y = torch.randn((K, BLOCK), dtype=torch.float16, device='cuda')
+    z = torch.empty((BLOCK, BLOCK), dtype=torch.float32, device='cuda')
+    kernel[(1,)](x, y, z, K, BLOCK=BLOCK, num_warps=4, num_stages=3)
+    binary = list(kernel.bin_cache.values())[0].bin
+    assert binary.num_threads == 2 * 4 * 32
+    # the loop is still pipelined through asynchronous copies, and both groups hand
+    # stages off through CTA-wide barriers
+    ptx = binary.asm['ptx']
+    assert 'cp.async' in ptx
+    assert re.search(r'\bbar(rier)?\.sync\s+0;', ptx)
+    triton.testing.assert_almost_equal(z, torch.matmul(x.float(), y.float()), decimal=1)
+
+
+def test_warp_specialize_unsplit(monkeypatch):
+    # without asynchronous copies, producers exit at entry: the barriers of the
+    # consumers are named barriers over their own threads
+
+    @triton.jit
+    def kernel(X, Z, BLOCK: tl.constexpr):
+        off = tl.arange(0, BLOCK)
+        x = tl.load(X + off[:, None] * BLOCK + off[None, :])
+        tl.store(Z + off, tl.sum(x, axis=0))
+
+    if torch.cuda.get_device_capability()[0] < 8:
+        pytest.skip("warp specialization requires asynchronous copies (sm80+)")
+    monkeypatch.setenv('TRITON_WARP_SPECIALIZE', '1')
+    reset_tmp_dir()
+    x = torch.randn((64, 64), dtype=torch.float32, device='cuda')
+    z = torch.empty((64,), dtype=torch.float32, device='cuda')
+    kernel[(1,)](x, z, BLOCK=64, num_warps=4)
+    binary = list(kernel.bin_cache.values())[0].bin
+    ptx = binary.asm['ptx']
+    assert re.search(r'\bbar(rier)?\.sync\s+1, 128;', ptx)
+    assert not re.search(r'\bbar(rier)?\.sync\s+0;', ptx)
+    triton.testing.assert_almost_equal(z, x.sum(0), decimal=4)
+
+
+def test_downgrade_on_oor(monkeypatch):
+
+    @triton.jit
+    def kernel(Y, A, B, K, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        a_ptrs = A + offs[:, None] * K + offs[None, :]
+        b_ptrs = B + offs[:, None] * BLOCK + offs[None, :]
+        acc = tl.zeros((BLOCK, BLOCK), dtype=tl.float32)
+        for k in range(0, K, BLOCK):
+            acc += tl.dot(tl.load(a_ptrs), tl.load(b_ptrs))
+            a_ptrs += BLOCK
+            b_ptrs += BLOCK * BLOCK
+        tl.store(Y + offs[:, None] * BLOCK + offs[None, :], acc)
+
+    reset_tmp_dir()
+    a = torch.randn((64, 256), dtype=torch.float16, device='cuda')
+    b = torch.randn((256, 64), dtype=torch.float16, device='cuda')
+    y = torch.empty((64, 64), dtype=torch.float32, device='cuda')
+    kernel[(1,)](y, a, b, 256, BLOCK=64, num_stages=1)
+    limit = list(kernel.bin_cache.values())[0].shared_mem
+    kernel.bin_cache.clear()
+    kernel.launch_cache.clear()
+    reset_tmp_dir()
+    monkeypatch.setattr(triton.code_gen._triton.runtime, 'max_shared_memory', lambda backend, device: limit)
+    # without the policy, the configuration does not fit
+    with pytest.raises(triton.code_gen.OutOfResources):
+        kernel[(1,)](y, a, b, 256, BLOCK=64, num_stages=4)
+    monkeypatch.setenv('TRITON_DOWNGRADE_ON_OOR', '1')
+    with pytest.warns(UserWarning, match="compiled with num_stages"):
+        kernel[(1,)](y, a, b, 256, BLOCK=64, num_stages=4)
+    assert list(kernel.bin_cache.values())[0].shared_mem <= limit
+    torch.testing.assert_close(y, torch.matmul(a.float(), b.float()), rtol=1e-2, atol=1e-2)
+
+
+def test_cache_limits():
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        tl.store(X, i)
+
+    reset_tmp_dir()
+    x = torch.empty(1, dtype=torch.int32, device='cuda')
+    for block in [16, 32, 64]:
+        kernel[(1,)](x, 1, BLOCK=block)
+    entries = kernel.cache_entries()
+    assert len(entries) == 3
+    assert all(e['host_bytes'] > 0 and e['device_bytes'] > 0 for e in entries)
+    first, second = entries[0]['key'], entries[1]['key']
+    kernel[(1,)](x, 1, BLOCK=16)
+    report = triton.code_gen.cache_report()
+    ours = [e['key'] for e in report['binaries'] if e['key'] in kernel.bin_cache]
+    # the binary of BLOCK=16 was launched last
+    assert ours == [second, entries[2]['key'], first]
+    assert report['host_bytes'] >= sum(e['host_bytes'] for e in entries)
+    try:
+        triton.code_gen.set_cache_limits(max_binaries=2)
+        # the least recently launched binaries of the process are evicted
+        assert len(triton.code_gen.cache_report()['binaries']) <= 2
+        assert first in kernel.bin_cache and second not in kernel.bin_cache
+        # evicted binaries are loaded again on their next launch
+        x.zero_()
+        for block in [16, 32, 64]:
+            kernel[(1,)](x, 2, BLOCK=block)
+        assert x.item() == 2
+    finally:
+        triton.code_gen.set_cache_limits()
+
+
+def test_codegen_stats():
+    @triton.jit
+    def kernel(Y, X, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        tl.store(Y + offs, tl.load(X + offs) + 1)
+
+    reset_tmp_dir()
+    x = torch.zeros(1024, dtype=torch.float32, device='cuda')
+    y = torch.empty_like(x)
+    kernel[(1,)](y, x, BLOCK=1024)
+    stats = list(kernel.bin_cache.values())[0].codegen_stats
+    assert [name for name, _ in stats['insts']][:1] == ['inliner']
+    assert stats['cvt_layout'] == 0
+    # aligned, contiguous fp32 accesses are vectorized by 4
+    assert [(io['vec'], io['bits']) for io in stats['loads']] == [(4, 32)]
+    assert [(io['vec'], io['bits']) for io in stats['stores']] == [(4, 32)]
+    assert stats['loads'][0]['line'] > 0
+    assert stats['pipeline']['pipelined'] == 0
@@ -0,0 +1,44 @@
+import os
+import threading
+import time
+
+import torch
+
+import triton
+import triton.language as tl
+from triton import compile_server
+
+
+@triton.jit
+def add_one(X, N, BLOCK: tl.constexpr):
+    off = tl.arange(0, BLOCK)
+    tl.store(X + off, tl.load(X + off, mask=off < N) + 1, mask=off < N)
+
+
+def test_compile(monkeypatch, tmp_path):
+    address = str(tmp_path / 'compile.sock')
+    monkeypatch.setenv('TRITON_COMPILE_SERVER', address)
+    monkeypatch.setenv('TRITON_CACHE_DIR', str(tmp_path / 'cache'))
+    x = torch.zeros(100, device='cuda')
+    add_one[(1,)](x, 100, BLOCK=128)
+    assert os.path.exists(address)
+    assert torch.all(x == 1)
+
+
+def test_deduplicate():
+    server = compile_server.Server('', 4, 600)
+    calls = []
+
+    def compile(request):
+        calls.append(request)
+        time.sleep(0.5)
+        return request[1]
+    server._compile = compile
+    results = []
+    threads = [threading.Thread(target=lambda: results.append(server.compile((b'ttir', i % 2)))) for i in range(8)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert len(calls) == 2
+    assert sorted(results) == [0] * 4 + [1] * 4
@@ -0,0 +1,72 @@
+import threading
+
+import torch
+
+import triton
+import triton.language as tl
+from triton.code_gen import CUDAGraph
+
+
+@triton.jit
+def add_one(X, Y, N, BLOCK: tl.constexpr):
+    off = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+    mask = off < N
+    tl.store(Y + off, tl.load(X + off, mask=mask) + 1, mask=mask)
+
+
+def test_replay():
+    N = 1000
+    grid = (triton.cdiv(N, 128),)
+    x = torch.randn(N, device='cuda')
+    y = torch.empty_like(x)
+    z = torch.empty_like(x)
+    # compile before capturing
+    add_one[grid](x, y, N, BLOCK=128)
+    y.zero_()
+    graph = CUDAGraph()
+    with graph:
+        add_one[grid](x, y, N, BLOCK=128)
+        add_one[grid](y, z, N, BLOCK=128)
+    assert len(graph) == 2
+    # nothing runs while capturing
+    assert torch.all(y == 0)
+    graph.replay()
+    torch.cuda.synchronize()
+    triton.testing.assert_almost_equal(z, x + 2)
+    # replay with a different input
+    x_next = torch.randn(N, device='cuda')
+    graph.replay({x: x_next})
+    torch.cuda.synchronize()
+    triton.testing.assert_almost_equal(z, x_next + 2)
+    # pointers that are not remapped revert to the captured ones
+    graph.replay()
+    torch.cuda.synchronize()
+    triton.testing.assert_almost_equal(z, x + 2)
+
+
+def test_capture_other_thread():
+    N = 1000
+    grid = (triton.cdiv(N, 128),)
+    x = torch.randn(N, device='cuda')
+    y = torch.zeros_like(x)
+    z = torch.zeros_like(x)
+    add_one[grid](x, y, N, BLOCK=128)
+    y.zero_()
+
+    def launch():
+        add_one[grid](x, z, N, BLOCK=128)
+        torch.cuda.synchronize()
+
+    graph = CUDAGraph()
+    with graph:
+        add_one[grid](x, y, N, BLOCK=128)
+        # only the launches of the capturing thread are recorded
+        thread = threading.Thread(target=launch)
+        thread.start()
+        thread.join()
+    assert len(graph) == 1
+    triton.testing.assert_almost_equal(z, x + 1)
+    assert torch.all(y == 0)
+    graph.replay()
+    torch.cuda.synchronize()
+    triton.testing.assert_almost_equal(y, x + 1)
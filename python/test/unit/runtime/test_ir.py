@@ -0,0 +1,142 @@
+import collections
+
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+
+def _function(arg_tys):
+    context = _triton.ir.context()
+    builder = _triton.ir.builder(context)
+    module = _triton.ir.module('', builder)
+    fn_ty = _triton.ir.type.make_function(builder.get_void_ty(), arg_tys(builder))
+    fn = module.get_or_insert_function('fn', fn_ty)
+    entry = _triton.ir.basic_block.create(context, 'entry', fn)
+    builder.set_insert_block(entry)
+    # the module only lives as long as its context
+    return (context, module), builder, fn
+
+
+def test_replace_all_uses_with_repeated_operand():
+    keep_alive, builder, fn = _function(lambda b: [b.get_int32_ty()] * 3)
+    x, y, z = fn.args
+    twice = builder.create_add(x, x)
+    once = builder.create_mul(x, y)
+    # one entry per use
+    assert x.users == [twice, twice, once]
+    x.replace_all_uses_with(z)
+    assert twice.ops() == [z, z]
+    assert once.ops() == [z, y]
+    assert x.users == []
+    assert z.users == [twice, twice, once]
+    # the users of `z` are still indexed per use
+    z.replace_all_uses_with(y)
+    assert twice.ops() == [y, y]
+    assert once.ops() == [y, y]
+    assert z.users == []
+    assert y.users == [once, twice, twice, once]
+
+
+def test_interning():
+    keep_alive, builder, fn = _function(lambda b: [])
+    i32 = builder.get_int32_ty()
+    f32 = builder.get_float_ty()
+    # types
+    assert _triton.ir.type.make_ptr(f32, 1) is _triton.ir.type.make_ptr(f32, 1)
+    assert _triton.ir.type.make_ptr(f32, 1) is not _triton.ir.type.make_ptr(f32, 3)
+    assert _triton.ir.type.make_block(f32, [16, 32]) is _triton.ir.type.make_block(f32, [16, 32])
+    assert _triton.ir.type.make_block(f32, [16, 32]) is not _triton.ir.type.make_block(f32, [32, 16])
+    assert _triton.ir.type.make_block(f32, [16, 32]) is not _triton.ir.type.make_block(i32, [16, 32])
+    assert _triton.ir.struct_type.get([i32, f32], True) is _triton.ir.struct_type.get([i32, f32], True)
+    assert _triton.ir.struct_type.get([i32, f32], True) is not _triton.ir.struct_type.get([f32, i32], True)
+    # constants
+    assert builder.get_int32(7) is builder.get_int32(7)
+    assert builder.get_int32(7) is not builder.get_int32(8)
+    assert builder.get_int32(7) is not builder.get_int64(7)
+    assert builder.get_float32(1.5) is builder.get_float32(1.5)
+    assert builder.get_float32(1.5) is not builder.get_float32(2.5)
+    assert _triton.ir.undef.get(i32) is _triton.ir.undef.get(i32)
+    assert _triton.ir.undef.get(i32) is not _triton.ir.undef.get(f32)
+    # types and constants are interned per context
+    other, other_builder, _ = _function(lambda b: [])
+    assert other_builder.get_int32(7) is not builder.get_int32(7)
+    assert _triton.ir.type.make_ptr(other_builder.get_float_ty(), 1) is not _triton.ir.type.make_ptr(f32, 1)
+
+
+@triton.jit
+def _redundant(X, Y, N, BLOCK: tl.constexpr):
+    off = tl.arange(0, BLOCK)
+    x = tl.load(X + off)
+    # each rewrite of `* 1` exposes the next one
+    y = x * 1 * 1 * 1 * 1
+    # dead as soon as built
+    (x + 3) * 5
+    # dead phi cycle through the loop
+    acc = tl.zeros([BLOCK], dtype=tl.int32)
+    for i in range(N):
+        acc += x
+    tl.store(Y + off, y)
+
+
+@triton.jit
+def _plain(X, Y, N, BLOCK: tl.constexpr):
+    off = tl.arange(0, BLOCK)
+    x = tl.load(X + off)
+    for i in range(N):
+        pass
+    tl.store(Y + off, x)
+
+
+def _instructions(module):
+    # number of instructions of each kind in the text of `module`
+    not_instructions = {'module', 'source_file', 'metadata', 'type', 'const_int', 'const_fp', 'undef',
+                        'alloc', 'function', 'body', 'forward', 'block'}
+    tags = [line.split(' ', 1)[0] for line in module.text().splitlines() if line and not line.startswith(';')]
+    return collections.Counter(tag for tag in tags if tag not in not_instructions)
+
+
+def test_peephole_and_dce_reach_a_fixpoint():
+    # one compilation of `_redundant` leaves nothing to rewrite and nothing dead:
+    # the same instructions as `_plain`
+    arg_types = [('ptr', 'i32'), ('ptr', 'i32'), ('scalar', 'i32')]
+    modules = []
+    for kernel in [_redundant, _plain]:
+        context, generator = kernel._generate_ttir(arg_types, {0: 16, 1: 16}, {3: 64})
+        _triton.code_gen.compile_ttir(_triton.runtime.backend.HOST, generator.module, -1, 4, 1)
+        modules.append((context, generator.module))
+    assert _instructions(modules[0][1]) == _instructions(modules[1][1])
+    # and computes the same
+    x = torch.randint(-100, 100, (64,), dtype=torch.int32)
+    y = torch.empty_like(x)
+    _redundant[(1,)](x, y, 5, BLOCK=64)
+    assert torch.equal(y, x)
+
+
+@triton.jit
+def _layouts(X, Y, Z, BLOCK: tl.constexpr):
+    off = tl.arange(0, BLOCK)
+    x = tl.load(X + off[:, None] * BLOCK + off[None, :])
+    y = tl.load(Y + off[:, None] * BLOCK + off[None, :])
+    # values of several layouts and axes, joined by broadcasts, reductions and a dot
+    z = tl.dot(x, y) + tl.sum(x, axis=1)[:, None] + tl.max(y, axis=0)[None, :]
+    tl.store(Z + off[:, None] * BLOCK + off[None, :], z)
+
+
+def test_axes_and_layouts_are_deterministic():
+    # classes of axes and layouts are numbered in program order, not by the address
+    # of their values: compiling the same kernel again gives the same code
+    arg_types = [('ptr', 'f32'), ('ptr', 'f32'), ('ptr', 'f32')]
+    asms = []
+    for _ in range(4):
+        context, generator = _layouts._generate_ttir(arg_types, {0: 16, 1: 16, 2: 16}, {3: 16})
+        _, asm, _, _ = _triton.code_gen.compile_ttir(_triton.runtime.backend.HOST, generator.module, -1, 4, 1)
+        asms.append(asm['llir'])
+    assert all(asm == asms[0] for asm in asms)
+    x = torch.randn((16, 16))
+    y = torch.randn((16, 16))
+    z = torch.empty((16, 16))
+    _layouts[(1,)](x, y, z, BLOCK=16)
+    ref = torch.matmul(x, y) + x.sum(1)[:, None] + y.max(0).values[None, :]
+    triton.testing.assert_almost_equal(z, ref)
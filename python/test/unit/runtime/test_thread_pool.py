@@ -0,0 +1,156 @@
+import threading
+
+import numpy as np
+import pytest
+import torch
+
+import triton
+import triton._C.libtriton as libtriton
+import triton.language as tl
+
+# host launches and the luts of `superblock` split their work over the same kind of
+# work-stealing pool: every program (resp. head) must run exactly once, whatever the
+# number of calling threads, and whichever worker steals which chunk
+
+
+@triton.jit
+def count_programs(Z, N, ROUNDS: tl.constexpr):
+    pid = tl.program_id(0)
+    for _ in range(ROUNDS):
+        tl.atomic_add(Z + pid % N, 1)
+
+
+@pytest.mark.parametrize("n_programs", [1, 7, 1000, 100003])
+def test_host_launch_runs_each_program_once(n_programs, device='cpu'):
+    N = 64
+    z = torch.zeros(N, dtype=torch.int32, device=device)
+    for _ in range(8):
+        count_programs[(n_programs,)](z, N, ROUNDS=2)
+    expected = torch.tensor([(n_programs - i + N - 1) // N for i in range(N)], dtype=torch.int32)
+    assert torch.equal(z, 16 * expected)
+
+
+def test_host_launch_concurrent_callers(device='cpu'):
+    n_threads, n_programs, N = 8, 20011, 128
+    zs = [torch.zeros(N, dtype=torch.int32, device=device) for _ in range(n_threads)]
+    # compile before launching from several threads
+    count_programs[(1,)](torch.zeros(N, dtype=torch.int32, device=device), N, ROUNDS=1)
+    errors = []
+
+    def run(z):
+        try:
+            for _ in range(4):
+                count_programs[(n_programs,)](z, N, ROUNDS=1)
+        except Exception as e:
+            errors.append(e)
+
+    threads = [threading.Thread(target=run, args=(z,)) for z in zs]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert not errors
+    expected = torch.tensor([(n_programs - i + N - 1) // N for i in range(N)], dtype=torch.int32)
+    for z in zs:
+        assert torch.equal(z, 4 * expected)
+
+
+def _superblock(layout, start_width):
+    H, M, N = layout.shape
+    layout = np.ascontiguousarray(layout, dtype=np.int32)
+    return [(width, lut.copy(), offsets.copy())
+            for width, lut, offsets in libtriton.superblock(layout.ctypes.data, H, M, N, start_width)]
+
+
+def _superblock_per_head(layout, start_width):
+    # the luts of each head computed alone, renumbered as if computed together
+    ret = dict()
+    n_blocks = 0
+    for h in range(layout.shape[0]):
+        for width, lut, _ in _superblock(layout[h:h + 1], start_width):
+            lut = lut.reshape(-1, 4)
+            lut[:, 0] = h
+            lut[:, 3] += n_blocks
+            ret.setdefault(width, []).append(lut)
+        n_blocks += int(np.count_nonzero(layout[h]))
+    return {width: np.concatenate(luts).reshape(-1) for width, luts in ret.items()}
+
+
+@pytest.mark.parametrize("H", [1, 3, 64, 509])
+def test_superblock_runs_each_head_once(H, M=24, N=24, start_width=8):
+    rs = np.random.RandomState(H)
+    layout = (rs.rand(H, M, N) < 0.6).astype(np.int32)
+    libtriton.superblock_cache_clear()
+    expected = _superblock_per_head(layout, start_width)
+    libtriton.superblock_cache_clear()
+    luts = _superblock(layout, start_width)
+    assert {width: lut for width, lut, _ in luts}.keys() == expected.keys()
+    for width, lut, offsets in luts:
+        np.testing.assert_array_equal(lut, expected[width])
+        # each head's entries are at its offsets
+        assert offsets[0] == 0 and offsets[-1] * 4 == len(lut)
+        heads = lut.reshape(-1, 4)[:, 0]
+        for h in range(H):
+            assert np.all(heads[offsets[h]:offsets[h + 1]] == h)
+
+
+def test_superblock_concurrent_callers(n_threads=8, n_rounds=16, H=97, M=16, N=16, start_width=4):
+    rs = np.random.RandomState(0)
+    layouts = [(rs.rand(H, M, N) < 0.5).astype(np.int32) for _ in range(n_threads)]
+    expected = [_superblock(layout, start_width) for layout in layouts]
+    errors = []
+
+    def run(i):
+        try:
+            for _ in range(n_rounds):
+                # the cache would hide the pool after the first round
+                libtriton.superblock_cache_clear()
+                luts = _superblock(layouts[i], start_width)
+                assert len(luts) == len(expected[i])
+                for (width, lut, offsets), (ref_width, ref_lut, ref_offsets) in zip(luts, expected[i]):
+                    assert width == ref_width
+                    np.testing.assert_array_equal(lut, ref_lut)
+                    np.testing.assert_array_equal(offsets, ref_offsets)
+        except Exception as e:
+            errors.append(e)
+
+    threads = [threading.Thread(target=run, args=(i,)) for i in range(n_threads)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert not errors, errors[0]
+
+
+def test_superblock_cache(H=5, M=16, N=16, start_width=4):
+    rs = np.random.RandomState(1)
+    layout = (rs.rand(H, M, N) < 0.5).astype(np.int32)
+    libtriton.superblock_cache_clear()
+    first = _superblock(layout, start_width)
+    # one (width, lut, head offsets) tuple per width that has super-blocks
+    assert len(first) > 0
+    for width, lut, offsets in first:
+        assert isinstance(width, int)
+        assert lut.dtype == np.int32 and len(lut) % 4 == 0
+        assert len(offsets) == H + 1 and offsets[-1] * 4 == len(lut)
+    # hits return the same luts, in arrays the caller may modify
+    layout = np.ascontiguousarray(layout)
+    hit = libtriton.superblock(layout.ctypes.data, H, M, N, start_width)
+    for (width, lut, offsets), (ref_width, ref_lut, ref_offsets) in zip(hit, first):
+        assert width == ref_width
+        np.testing.assert_array_equal(lut, ref_lut)
+        np.testing.assert_array_equal(offsets, ref_offsets)
+        lut[:] = -1
+    for (_, lut, _), (_, ref_lut, _) in zip(_superblock(layout, start_width), first):
+        np.testing.assert_array_equal(lut, ref_lut)
+    # another layout of the same shape is not served the cached luts
+    other = layout.copy()
+    other[0] = 1 - other[0]
+    luts = _superblock(other, start_width)
+    libtriton.superblock_cache_clear()
+    expected = _superblock(other, start_width)
+    assert len(luts) == len(expected)
+    for (width, lut, offsets), (ref_width, ref_lut, ref_offsets) in zip(luts, expected):
+        assert width == ref_width
+        np.testing.assert_array_equal(lut, ref_lut)
+        np.testing.assert_array_equal(offsets, ref_offsets)
@@ -0,0 +1,65 @@
+import json
+
+import torch
+
+import triton
+import triton.language as tl
+from triton.tools.trace import Tracer
+
+
+@triton.jit
+def row_sum(X, Y, N, BLOCK: tl.constexpr):
+    row = tl.program_id(0)
+    acc = tl.zeros([BLOCK], dtype=tl.float32)
+    for off in range(0, N, BLOCK):
+        cols = off + tl.arange(0, BLOCK)
+        acc += tl.load(X + row * N + cols, mask=cols < N, other=0.)
+    tl.store(Y + row, tl.sum(acc, 0))
+
+
+def test_trace(tmp_path):
+    M, N, BLOCK = 8, 4096, 256
+    x = torch.randn((M, N), device='cuda')
+    y = torch.empty(M, device='cuda')
+    with Tracer() as tracer:
+        row_sum[(M,)](x, y, N, BLOCK=BLOCK, num_warps=4)
+    torch.testing.assert_allclose(y, x.sum(1))
+    records = tracer.records()
+    assert tracer.dropped() == 0
+    assert {name for _, name, _, _, _, _ in records} == {'row_sum'}
+    # one entry and one exit per warp, and one loop record per iteration and warp
+    events = [event for _, _, _, _, _, event in records]
+    assert events.count(0) == M * 4
+    assert events.count(1) == M * 4
+    assert events.count(2) >= M * 4 * (N // BLOCK)
+    path = tmp_path / 'trace.json'
+    tracer.save(path)
+    with open(path) as f:
+        trace = json.load(f)['traceEvents']
+    assert sum(e['ph'] == 'B' for e in trace) == M * 4
+    assert sum(e['ph'] == 'i' and e['name'] == 'loop 0' for e in trace) == events.count(2)
+    # nothing is recorded outside of the tracer
+    row_sum[(M,)](x, y, N, BLOCK=BLOCK, num_warps=4)
+    torch.cuda.synchronize()
+    assert len(tracer.records()) == len(records)
+
+
+def test_program_timeline():
+    M, N, BLOCK = 64, 4096, 256
+    x = torch.randn((M, N), device='cuda')
+    y = torch.empty(M, device='cuda')
+    with Tracer(level=3) as tracer:
+        for _ in range(2):
+            row_sum[(M // 8, 8)](x, y, N, BLOCK=BLOCK, num_warps=4)
+    # only entries and exits are recorded
+    assert {event for *_, event in tracer.records()} == {0, 1}
+    programs = triton.testing.program_timeline(tracer, grid=(M // 8, 8))
+    assert len(programs) == 2 * M
+    assert sorted(p['coords'] for p in programs if p['launch'] == 0) == \
+        sorted((i, j, 0) for i in range(M // 8) for j in range(8))
+    assert all(p['start'] <= p['end'] for p in programs)
+    stats = triton.testing.sm_utilization(programs)
+    assert sum(sm['programs'] for sm in stats['sms'].values()) == 2 * M
+    assert 0 < stats['utilization'] <= 1
+    assert stats['imbalance'] >= 1
+    assert stats['durations'][0] <= stats['durations'][1] <= stats['durations'][2]
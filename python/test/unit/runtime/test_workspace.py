@@ -0,0 +1,53 @@
+import torch
+
+import triton
+import triton.language as tl
+
+
+@triton.jit
+def _count(Counters, Out, N):
+    # the last program to arrive reads the count, and resets the counter
+    count = tl.atomic_add(Counters, 1)
+    if count == N - 1:
+        tl.store(Out, count + 1)
+        tl.atomic_xchg(Counters, 0)
+
+
+def test_scope():
+    with triton.workspace.scope('cuda') as ws:
+        a = ws.empty((3, 5), torch.float16)
+        b = ws.empty(7, torch.int32)
+        assert a.shape == (3, 5) and a.dtype == torch.float16 and a.is_contiguous()
+        # allocations of a scope do not overlap, and are aligned
+        assert b.data_ptr() >= a.data_ptr() + a.numel() * a.element_size()
+        assert a.data_ptr() % 256 == 0 and b.data_ptr() % 256 == 0
+        with triton.workspace.scope('cuda') as inner:
+            c = inner.empty(7, torch.int32)
+            assert c.data_ptr() > b.data_ptr()
+    # later scopes of the stream reuse the memory
+    with triton.workspace.scope('cuda') as ws:
+        assert ws.empty((3, 5), torch.float16).data_ptr() == a.data_ptr()
+    # other streams have their own workspace
+    with torch.cuda.stream(torch.cuda.Stream()):
+        with triton.workspace.scope('cuda') as ws:
+            assert ws.empty((3, 5), torch.float16).data_ptr() != a.data_ptr()
+    # growing keeps the buffers in use valid
+    with triton.workspace.scope('cuda') as ws:
+        a = ws.empty(16, torch.float32)
+        a.fill_(1.)
+        big = ws.empty(1 << 22, torch.float32)
+        big.fill_(2.)
+        assert torch.all(a == 1.)
+
+
+def test_semaphores():
+    out = torch.zeros(1, dtype=torch.int32, device='cuda')
+    for n in [1, 100, 3]:
+        with triton.workspace.scope('cuda') as ws:
+            counters = ws.semaphores(4)
+            assert torch.all(counters == 0)
+            _count[(n,)](counters, out, n)
+        assert out.item() == n
+    assert sum(triton.workspace.memory_reserved().values()) > 0
+    triton.workspace.empty_cache()
+    assert triton.workspace.memory_reserved() == {}
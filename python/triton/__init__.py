@@ -11,4 +11,5 @@ from .code_gen import cdiv, next_power_of_2, jit, autotune, heuristics, \
 from . import language
 from . import code_gen
 from . import testing
+from . import workspace
 from . import ops
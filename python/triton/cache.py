@@ -0,0 +1,585 @@
+from __future__ import annotations
+
+import concurrent.futures
+import hashlib
+import json
+import mmap
+import os
+import pickle
+import struct
+import threading
+import time
+import urllib.error
+import urllib.request
+import warnings
+import zlib
+
+from filelock import FileLock
+
+# header: magic, generation of the blob file, end of the blob file, bytes held by live entries,
+# number of live entries
+_HEADER = struct.Struct('<8sQQQQ')
+_MAGIC = b'TRITONC2'
+# slot: md5 of the key, offset and size of its record in the blob file, last use (ns)
+_SLOT = struct.Struct('<16sQQQ')
+_LAST_USE = struct.Struct('<Q')
+_EMPTY = b'\x00' * 16
+_DELETED = b'\xff' * 16
+# record: md5 of the key, size of the pickled metadata, size of the raw payload
+_RECORD = struct.Struct('<16sQQ')
+
+
+def _digest(key):
+    return hashlib.md5(key.encode('utf-8')).digest()
+
+
+def _kernel_key(key):
+    # keys of binaries are the key of their kernel (hash of its source, dependencies and
+    # compiler, and device architecture) followed by their num_warps, num_stages and signature
+    return key.rsplit('-', 3)[0]
+
+
+class CacheStore:
+    """
+    On-disk store of compiled binaries, shared by all the processes that use the same
+    directory. Binaries are appended to a single blob file and found through an
+    open-addressing hash table held in a memory-mapped index file, so that lookups
+    neither list the directory nor open one file per kernel.
+
+    Writers serialize through a file lock (and a thread lock, for the background
+    compilations of `async_compile` kernels), and readers validate the records they
+    find against their key, so concurrent processes never observe partial entries.
+    When the live entries exceed `max_size` bytes, the least recently used ones are
+    evicted, and the blob file is compacted once most of it is dead.
+
+    Assembly stored as `bytes` (e.g., cubins) is returned as `memoryview`s of the
+    memory-mapped blob file, which `load_binary` hands to the driver without copies.
+
+    Next to binary images, the text of IRs is stored compressed, and decompressed when it
+    is first read (see `LazyAsm`). `TRITON_CACHE_IR=none` does not store it at all, and
+    `TRITON_CACHE_IR=eager` stores it uncompressed in the pickled metadata.
+
+    With `TRITON_REMOTE_CACHE` set to a directory or URL, binaries are also written to a
+    `RemoteCache`, and read from it on misses.
+    """
+    n_slots = 1 << 16
+    n_compile_locks = 64
+    stores = dict()
+
+    @staticmethod
+    def get(cache_dir):
+        if cache_dir not in CacheStore.stores:
+            max_size = int(os.environ.get('TRITON_CACHE_MAX_SIZE', 1 << 30))
+            remote = os.environ.get('TRITON_REMOTE_CACHE')
+            remote = RemoteCache.get(remote) if remote else None
+            CacheStore.stores[cache_dir] = CacheStore(cache_dir, max_size, remote)
+        return CacheStore.stores[cache_dir]
+
+    def __init__(self, cache_dir, max_size, remote=None):
+        os.makedirs(cache_dir, exist_ok=True)
+        self.cache_dir = cache_dir
+        self.max_size = max_size
+        # binaries missing from this store are looked up in `remote`, by kernel
+        self.remote = remote
+        self.fetched = set()
+        self.lock = FileLock(os.path.join(cache_dir, 'index.lock'))
+        self.thread_lock = threading.Lock()
+        self.compile_locks = dict()
+        index_path = os.path.join(cache_dir, 'index')
+        index_size = _HEADER.size + CacheStore.n_slots * _SLOT.size
+        with self.lock:
+            if not os.path.exists(index_path) or os.path.getsize(index_path) != index_size:
+                with open(index_path + '.tmp', 'wb') as f:
+                    f.write(_HEADER.pack(_MAGIC, 0, 0, 0, 0))
+                    f.truncate(index_size)
+                os.replace(index_path + '.tmp', index_path)
+        with open(index_path, 'r+b') as f:
+            self.index = mmap.mmap(f.fileno(), index_size)
+        self.blobs = None
+        self.blobs_generation = None
+
+    # index
+
+    def _header(self):
+        return _HEADER.unpack_from(self.index, 0)
+
+    def _set_header(self, generation, end, live, count):
+        _HEADER.pack_into(self.index, 0, _MAGIC, generation, end, live, count)
+
+    def _slot(self, i):
+        return _SLOT.unpack_from(self.index, _HEADER.size + i * _SLOT.size)
+
+    def _set_slot(self, i, digest, offset, size, last_use):
+        _SLOT.pack_into(self.index, _HEADER.size + i * _SLOT.size, digest, offset, size, last_use)
+
+    def _probe(self, digest):
+        # yields the slots that `digest` may occupy, in order
+        start = int.from_bytes(digest[:8], 'little') % CacheStore.n_slots
+        for i in range(CacheStore.n_slots):
+            yield (start + i) % CacheStore.n_slots
+
+    def _find(self, digest):
+        for i in self._probe(digest):
+            slot = self._slot(i)
+            if slot[0] == digest:
+                return i, slot
+            if slot[0] == _EMPTY:
+                return None, None
+        return None, None
+
+    # blobs
+
+    def _blobs_path(self, generation):
+        return os.path.join(self.cache_dir, f'blobs.{generation}')
+
+    def _map_blobs(self, generation, end):
+        if self.blobs is not None and self.blobs_generation == generation and len(self.blobs) >= end:
+            return self.blobs
+        # mappings of compacted blob files stay valid for the views handed out from them
+        with open(self._blobs_path(generation), 'rb') as f:
+            self.blobs = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        self.blobs_generation = generation
+        return self.blobs
+
+    # public interface
+
+    def get_binary(self, key):
+        binary = self._get_binary(key)
+        if binary is None and self.remote is not None and _kernel_key(key) not in self.fetched:
+            self._fetch(_kernel_key(key))
+            binary = self._get_binary(key)
+        return binary
+
+    def _fetch(self, kernel_key):
+        # a new machine gets all the binaries of a kernel (i.e., of all its signatures
+        # and configurations) with its first miss, rather than compiling them one by one
+        self.fetched.add(kernel_key)
+        try:
+            binaries = self.remote.get_binaries(kernel_key)
+        except Exception as e:
+            warnings.warn(f'could not read the remote kernel cache: {e}')
+            return
+        for key, binary in binaries.items():
+            if self._get_binary(key) is None:
+                self._put_binary(key, binary)
+
+    def _get_binary(self, key):
+        digest = _digest(key)
+        i, slot = self._find(digest)
+        if slot is None:
+            return None
+        _, offset, size, _ = slot
+        generation, end = self._header()[1:3]
+        try:
+            blobs = self._map_blobs(generation, offset + size)
+        except (FileNotFoundError, ValueError):
+            return None
+        if offset + size > len(blobs):
+            return None
+        record_digest, meta_size, payload_size = _RECORD.unpack_from(blobs, offset)
+        if record_digest != digest or _RECORD.size + meta_size + payload_size != size:
+            return None
+        meta_begin = offset + _RECORD.size
+        meta = pickle.loads(blobs[meta_begin:meta_begin + meta_size])
+        if meta['key'] != key:
+            return None
+        binary = meta['binary']
+        binary.asm = LazyAsm(binary.asm)
+        payload = memoryview(blobs)[meta_begin + meta_size:offset + size]
+        for name, begin, length, *compressed in meta['payload']:
+            value = payload[begin:begin + length]
+            binary.asm[name] = _CompressedText(value) if compressed and compressed[0] else value
+        # recency is only a hint for eviction, and is updated without locking
+        _LAST_USE.pack_into(self.index, _HEADER.size + i * _SLOT.size + _SLOT.size - _LAST_USE.size, time.time_ns())
+        return binary
+
+    def compile_lock(self, key):
+        """
+        Lock held while `key` is compiled, so that concurrent processes compile it only once.
+        Keys share a few lock files, so that they do not accumulate in the cache directory
+        """
+        stripe = _digest(key)[0] % CacheStore.n_compile_locks
+        if stripe not in self.compile_locks:
+            self.compile_locks[stripe] = FileLock(os.path.join(self.cache_dir, f'compile.{stripe}.lock'))
+        return self.compile_locks[stripe]
+
+    def put_binary(self, key, binary):
+        self._put_binary(key, binary)
+        if self.remote is not None:
+            try:
+                self.remote.put_binary(key, binary)
+            except Exception as e:
+                warnings.warn(f'could not write to the remote kernel cache: {e}')
+
+    def _put_binary(self, key, binary):
+        digest = _digest(key)
+        # raw assembly is stored out of the pickled metadata and, next to a binary image,
+        # so is compressed text (see `TRITON_CACHE_IR`)
+        asm = binary.asm
+        mode = os.environ.get('TRITON_CACHE_IR', 'lazy')
+        has_image = 'cubin' in asm or 'hsaco' in asm
+        payload = []
+        chunks = []
+        meta_asm = dict()
+        payload_size = 0
+        for name, value in dict.items(asm):
+            compressed = False
+            if isinstance(value, (str, _CompressedText)) and has_image and mode != 'eager':
+                if mode == 'none':
+                    continue
+                value = value.data if isinstance(value, _CompressedText) else zlib.compress(value.encode('utf-8'), 1)
+                compressed = True
+            if isinstance(value, (bytes, memoryview)):
+                payload.append((name, payload_size, len(value), compressed))
+                chunks.append(value)
+                payload_size += len(value)
+            else:
+                meta_asm[name] = str(value) if isinstance(value, _CompressedText) else value
+        binary.asm = meta_asm
+        try:
+            meta = pickle.dumps({'binary': binary, 'key': key, 'payload': payload})
+        finally:
+            binary.asm = asm
+        size = _RECORD.size + len(meta) + payload_size
+        with self.thread_lock, self.lock:
+            generation, end, live, count = self._header()[1:]
+            i, slot = self._find(digest)
+            if slot is not None:
+                self._delete(i)
+                live -= slot[2]
+                count -= 1
+            live, count = self._evict(live, count, size)
+            with open(self._blobs_path(generation), 'ab') as f:
+                f.seek(end)
+                f.truncate(end)
+                f.write(_RECORD.pack(digest, len(meta), payload_size))
+                f.write(meta)
+                for chunk in chunks:
+                    f.write(chunk)
+                f.flush()
+                os.fsync(f.fileno())
+            # the record is durable before the index points to it
+            self._insert(digest, end, size, time.time_ns())
+            self._set_header(generation, end + size, live + size, count + 1)
+            if end + size > 2 * (live + size) and end + size > self.max_size // 4:
+                self._compact()
+            self.index.flush()
+
+    def _delete(self, i):
+        _, offset, size, last_use = self._slot(i)
+        self._set_slot(i, _DELETED, offset, size, last_use)
+
+    def _insert(self, digest, offset, size, last_use):
+        for i in self._probe(digest):
+            if self._slot(i)[0] in (_EMPTY, _DELETED):
+                self._set_slot(i, digest, offset, size, last_use)
+                return
+        raise RuntimeError('kernel cache index is full')
+
+    def _live_slots(self):
+        ret = []
+        for i in range(CacheStore.n_slots):
+            slot = self._slot(i)
+            if slot[0] not in (_EMPTY, _DELETED):
+                ret.append((i, slot))
+        return ret
+
+    def _evict(self, live, count, size):
+        # the index is kept at most 3/4 full so that probe sequences stay short. The header
+        # counts live entries, so that the slots are only scanned when some must be evicted
+        max_entries = CacheStore.n_slots * 3 // 4
+        if live + size <= self.max_size and count < max_entries:
+            return live, count
+        live_slots = self._live_slots()
+        live_slots.sort(key=lambda x: x[1][3])
+        for i, slot in live_slots:
+            if live + size <= self.max_size and count < max_entries:
+                break
+            self._delete(i)
+            live -= slot[2]
+            count -= 1
+        return live, count
+
+    def _compact(self):
+        # copies live records to a new blob file, and rebuilds the index without tombstones
+        generation = self._header()[1]
+        old_path = self._blobs_path(generation)
+        new_path = self._blobs_path(generation + 1)
+        live_slots = self._live_slots()
+        offsets = []
+        with open(old_path, 'rb') as src, open(new_path, 'wb') as dst:
+            offset = 0
+            for i, (digest, old_offset, size, last_use) in live_slots:
+                src.seek(old_offset)
+                dst.write(src.read(size))
+                offsets.append((digest, offset, size, last_use))
+                offset += size
+            dst.flush()
+            os.fsync(dst.fileno())
+        self.index[_HEADER.size:] = bytes(CacheStore.n_slots * _SLOT.size)
+        for digest, new_offset, size, last_use in offsets:
+            self._insert(digest, new_offset, size, last_use)
+        self._set_header(generation + 1, offset, offset, len(offsets))
+        os.remove(old_path)
+
+    def __len__(self):
+        return self._header()[4]
+
+
+class _CompressedText:
+    """ text compressed with zlib, and decompressed by `LazyAsm` on first access """
+
+    def __init__(self, data):
+        self.data = data
+
+    def __str__(self):
+        return zlib.decompress(self.data).decode('utf-8')
+
+    # pickled as the text itself
+    def __reduce__(self):
+        return (str, (str(self),))
+
+
+class LazyAsm(dict):
+    """
+    Assembly of a binary read from a `CacheStore`. The text of its IRs (e.g., 'ttir', 'llir'
+    and 'ptx'), often much larger than the binary image, is only decompressed when read
+    """
+
+    def __getitem__(self, name):
+        value = dict.__getitem__(self, name)
+        if isinstance(value, _CompressedText):
+            value = str(value)
+            dict.__setitem__(self, name, value)
+        return value
+
+    def get(self, name, default=None):
+        return self[name] if name in self else default
+
+    def items(self):
+        return [(name, self[name]) for name in self.keys()]
+
+    def values(self):
+        return [self[name] for name in self.keys()]
+
+    # overriding iteration makes `dict(asm)` and `{**asm}` read values through `__getitem__`
+    def __iter__(self):
+        return iter(self.keys())
+
+
+class TuningStore:
+    """
+    On-disk record of the configurations picked by the autotuner, shared by all the
+    processes that use the same directory, so that a kernel is tuned for a given
+    device and key only once. Records are appended as lines of JSON to `autotune.jsonl`
+    under a file lock, and indexed in memory: lookups only read what was appended since
+    the previous one.
+
+    Records are keyed by the hash of the source of the kernel, the name and compute
+    capability of the device and the values of the autotuning key, so that they can be
+    exported from one machine and imported on others of the same kind.
+    """
+    stores = dict()
+
+    @staticmethod
+    def get(cache_dir):
+        if cache_dir not in TuningStore.stores:
+            TuningStore.stores[cache_dir] = TuningStore(cache_dir)
+        return TuningStore.stores[cache_dir]
+
+    def __init__(self, cache_dir):
+        os.makedirs(cache_dir, exist_ok=True)
+        self.path = os.path.join(cache_dir, 'autotune.jsonl')
+        self.lock = FileLock(os.path.join(cache_dir, 'autotune.lock'))
+        self.records = dict()
+        self.loaded_size = 0
+
+    @staticmethod
+    def _key(record):
+        return (record['kernel'], record['device'], record['key'])
+
+    def _load(self):
+        # reads the records appended since the last load
+        try:
+            size = os.path.getsize(self.path)
+        except FileNotFoundError:
+            size = 0
+        if size == self.loaded_size:
+            return
+        if size < self.loaded_size:
+            self.records, self.loaded_size = dict(), 0
+        with open(self.path, 'rb') as f:
+            f.seek(self.loaded_size)
+            data = f.read(size - self.loaded_size)
+        # a record being written by another process is read once it is complete
+        end = data.rfind(b'\n') + 1
+        for line in data[:end].splitlines():
+            try:
+                record = json.loads(line)
+                self.records[TuningStore._key(record)] = record
+            except (ValueError, KeyError):
+                continue
+        self.loaded_size += end
+
+    def lookup(self, kernel, device, key):
+        """ returns the record of `kernel` for `key` on `device`, if any """
+        self._load()
+        return self.records.get((kernel, device, key))
+
+    def add(self, records):
+        """ appends records, with keys 'kernel', 'device', 'key' and 'config' """
+        lines = b''.join(json.dumps(record, sort_keys=True).encode('utf-8') + b'\n' for record in records)
+        if not lines:
+            return
+        os.makedirs(os.path.dirname(self.path), exist_ok=True)
+        with self.lock:
+            with open(self.path, 'ab') as f:
+                f.write(lines)
+                f.flush()
+                os.fsync(f.fileno())
+        self._load()
+
+    def export(self, path, device=None):
+        """ writes the records (of `device` only, if given) to `path`, as JSON """
+        self._load()
+        records = [record for record in self.records.values() if device is None or record['device'] == device]
+        with open(path, 'w') as f:
+            json.dump(records, f, indent=1, sort_keys=True)
+        return len(records)
+
+    def import_(self, path):
+        """ adds the records exported to `path`; they override those with the same key """
+        with open(path) as f:
+            records = json.load(f)
+        self.add(records)
+        return len(records)
+
+
+class RemoteCache:
+    """
+    Store of compiled binaries shared by the machines of a fleet, behind the local
+    `CacheStore` of each. Binaries are content-addressed, as objects named by the md5 of
+    their key, and the binaries of each kernel are listed in a manifest, named by the md5
+    of the key of the kernel, so that they are all fetched at once.
+
+    Backends implement `read(names)`, which returns the objects found as a dict, and
+    `write(name, data)`, and are registered for the schemes of their URLs. Manifests are
+    updated without locks: concurrent updates may drop a few entries, which are then
+    compiled again, but never corrupt them.
+    """
+    schemes = dict()
+
+    @staticmethod
+    def register(scheme, cls):
+        RemoteCache.schemes[scheme] = cls
+
+    @staticmethod
+    def get(url):
+        scheme = url.split('://', 1)[0] if '://' in url else 'file'
+        if scheme not in RemoteCache.schemes:
+            raise ValueError(f'unsupported remote cache: {url}')
+        return RemoteCache.schemes[scheme](url)
+
+    def read(self, names):
+        raise NotImplementedError
+
+    def write(self, name, data):
+        raise NotImplementedError
+
+    def _manifest(self, kernel_key):
+        data = self.read(['manifest-' + _digest(kernel_key).hex()])
+        return set(pickle.loads(next(iter(data.values())))) if data else set()
+
+    def get_binaries(self, kernel_key):
+        """ returns the binaries of the kernel `kernel_key`, by key """
+        keys = sorted(self._manifest(kernel_key))
+        data = self.read([_digest(key).hex() for key in keys])
+        ret = dict()
+        for key in keys:
+            entry = data.get(_digest(key).hex())
+            if entry is None:
+                continue
+            entry = pickle.loads(zlib.decompress(entry))
+            if entry['key'] == key:
+                ret[key] = entry['binary']
+        return ret
+
+    def put_binary(self, key, binary):
+        asm = binary.asm
+        # assembly may be held in memory-mapped blob files
+        binary.asm = {name: bytes(value) if isinstance(value, memoryview) else value for name, value in asm.items()}
+        try:
+            data = zlib.compress(pickle.dumps({'key': key, 'binary': binary}), 1)
+        finally:
+            binary.asm = asm
+        self.write(_digest(key).hex(), data)
+        kernel_key = _kernel_key(key)
+        manifest = self._manifest(kernel_key)
+        if key not in manifest:
+            manifest.add(key)
+            self.write('manifest-' + _digest(kernel_key).hex(), pickle.dumps(sorted(manifest)))
+
+
+class FileSystemCache(RemoteCache):
+    """ remote cache in a directory of a shared file system (e.g., NFS) """
+
+    def __init__(self, url):
+        self.path = url[len('file://'):] if url.startswith('file://') else url
+        os.makedirs(self.path, exist_ok=True)
+
+    def read(self, names):
+        ret = dict()
+        for name in names:
+            try:
+                with open(os.path.join(self.path, name), 'rb') as f:
+                    ret[name] = f.read()
+            except FileNotFoundError:
+                continue
+        return ret
+
+    def write(self, name, data):
+        # readers only see complete objects
+        path = os.path.join(self.path, name)
+        tmp = f'{path}.{os.getpid()}.{threading.get_ident()}.tmp'
+        with open(tmp, 'wb') as f:
+            f.write(data)
+        os.replace(tmp, path)
+
+
+class HTTPCache(RemoteCache):
+    """
+    remote cache behind an HTTP server or object store that maps GET and PUT requests of
+    `<url>/<name>` to objects (e.g., an S3 bucket through presigned or public URLs). Reads
+    are issued concurrently, and `TRITON_REMOTE_CACHE_TOKEN` is sent as a bearer token
+    """
+    n_threads = 16
+
+    def __init__(self, url):
+        self.url = url.rstrip('/')
+        token = os.environ.get('TRITON_REMOTE_CACHE_TOKEN')
+        self.headers = {'Authorization': f'Bearer {token}'} if token else dict()
+
+    def _read(self, name):
+        request = urllib.request.Request(f'{self.url}/{name}', headers=self.headers)
+        try:
+            with urllib.request.urlopen(request) as response:
+                return response.read()
+        except urllib.error.HTTPError as e:
+            if e.code == 404:
+                return None
+            raise
+
+    def read(self, names):
+        with concurrent.futures.ThreadPoolExecutor(self.n_threads) as pool:
+            data = pool.map(self._read, names)
+            return {name: value for name, value in zip(names, data) if value is not None}
+
+    def write(self, name, data):
+        request = urllib.request.Request(f'{self.url}/{name}', data=data, method='PUT', headers=self.headers)
+        with urllib.request.urlopen(request):
+            pass
+
+
+RemoteCache.register('file', FileSystemCache)
+RemoteCache.register('http', HTTPCache)
+RemoteCache.register('https', HTTPCache)
@@ -2,27 +2,40 @@ from __future__ import annotations
 
 import ast
 import builtins
+import concurrent.futures
+import copy
 import functools
 import hashlib
 import inspect
+import json
 import os
-import pickle
+import re
+import shutil
+import struct
 import subprocess
 import sys
 import tempfile
 import textwrap
+import threading
 import time
 import warnings
+import weakref
 from typing import Dict, Set, Tuple, Union
 
 import torch
-from filelock import FileLock
 
 import triton
 import triton._C.libtriton.triton as _triton
+from . import compile_server
+from .cache import CacheStore, TuningStore, _CompressedText
+from .search import get as get_search_strategy
 from .tools.disasm import extract
 
-current_stream = lambda device: torch.cuda.current_stream(device).cuda_stream
+# PyTorch's current stream, without creating a torch.cuda.Stream when it can be avoided
+if hasattr(torch._C, '_cuda_getCurrentRawStream'):
+    current_stream = lambda device: torch._C._cuda_getCurrentRawStream(device)
+else:
+    current_stream = lambda device: torch.cuda.current_stream(device).cuda_stream
 
 
 def mangle_ty(ty):
@@ -206,15 +219,21 @@ class ValueConstructor:
 
 class CodeGenerator(ast.NodeVisitor):
 
-    def __init__(self, context, prototype, gscope, attributes, constants, prototypes=None, module=None, is_kernel=False):
+    def __init__(self, context, prototype, gscope, attributes, constants, prototypes=None, module=None, is_kernel=False, schedule=True,
+                 src_file=None, line_offset=0):
         self.prototypes = dict() if prototypes is None else prototypes
         self.builder = _triton.ir.builder(context)
         self.module = _triton.ir.module('', self.builder) if module is None else module
+        # instructions are attributed to the line of the node they are generated for,
+        # in the file of the function (`line_offset` is the line before its `def`)
+        self.src_file = 0 if src_file is None else self.module.add_source_file(src_file)
+        self.line_offset = line_offset
         self.prototype = prototype
         self.attributes = attributes
         self.constants = constants
         self.last_node = None
         self.is_kernel = is_kernel
+        self.schedule = schedule
 
         self.value_constructor = ValueConstructor(self.module, self.builder, gscope)
 
@@ -265,6 +284,7 @@ class CodeGenerator(ast.NodeVisitor):
         self.prototypes[fn_name] = self.prototype
         fn = self.module.get_or_insert_function(fn_name, self.prototype.to_ir(self.builder))
         fn.set_is_kernel(self.is_kernel)
+        fn.set_schedule(self.schedule)
         arg_values = []
         idx = 0
         for i, arg_name in enumerate(arg_names):
@@ -280,6 +300,8 @@ class CodeGenerator(ast.NodeVisitor):
                     attr = getattr(_triton.ir.attribute_kind, attr)
                     attr = _triton.ir.attribute(attr, self.attributes[i])
                     fn.add_attr(idx + 1, attr)
+                if i in self.attributes.get('noalias', []):
+                    fn.add_attr(idx + 1, _triton.ir.attribute(_triton.ir.attribute_kind.noalias, 0))
                 fn.args[idx].name = arg_name
                 arg_values.append(triton.language.tensor(fn.args[idx], self.prototype.param_types[idx]))
                 idx += 1
@@ -624,6 +646,11 @@ class CodeGenerator(ast.NodeVisitor):
 
         if isinstance(fn, JITFunction):
             from inspect import getcallargs
+            # `_inline=False` keeps the call, `_inline=True` always inlines it;
+            # by default, the compiler decides from the size of the callee
+            inline = kws.pop('_inline', None)
+            if isinstance(inline, triton.language.constexpr):
+                inline = inline.value
             args = getcallargs(fn.fn, *args, **kws)
             args = [args[name] for name in fn.arg_names]
             args = [arg if isinstance(arg, triton.language.tensor)
@@ -642,10 +669,13 @@ class CodeGenerator(ast.NodeVisitor):
                 ret_type = triton.language.void
                 prototype = triton.language.function_type(ret_type, arg_types)
                 gscope = sys.modules[fn.fn.__module__].__dict__
-                generator = CodeGenerator(self.builder.context, prototype, gscope, attributes, constants, prototypes=self.prototypes, module=self.module)
+                generator = CodeGenerator(self.builder.context, prototype, gscope, attributes, constants, prototypes=self.prototypes, module=self.module,
+                                          src_file=fn.src_file, line_offset=fn.line_offset)
                 generator.visit(fn.parse())
             symbol = self.module.get_function(fn_name)
             ret = self.builder.call(symbol, arg_vals)
+            if inline is not None:
+                ret.set_inline_hint(1 if inline else 2)
             if not ret.type.is_void():
                 ret = triton.language.tensor(ret, self.prototypes[fn_name].ret_type)
             return ret
@@ -656,26 +686,33 @@ class CodeGenerator(ast.NodeVisitor):
             args = [arg.value if isinstance(arg, triton.language.constexpr) else arg
                     for arg in args]
             ret = fn(*args, **kws)
-        # special case: dynamic parallelism
-        # in this case the core primitive returns a proxy
-        # if isinstance(ret, triton.language.core.LaunchProxy):
-        #     ret_type  = _triton.ir.type.get_void(self.builder.context)
-        #     arg_tys = [x.type for x in ret.args]
-        #     prototype = _triton.ir.type.make_function(ret_type, arg_tys)
-        #     gscope = sys.modules[ret.fn.fn.__module__].__dict__
-        #     constants = ret.constants
-        #     fn_name = mangle_fn(ret.fn.__name__, arg_tys, ret.constants)
-        #     # TODO: clean-up attributes handling in function
-        #     if not self.module.has_function(fn_name):
-        #         attributes = {i: list(arg.parent.get_attrs(arg))[0].value for i, arg in enumerate(ret.args) \
-        #                 if isinstance(arg, _triton.ir.argument) and arg.parent.has_attr(i + 1) }
-        #         generator = CodeGenerator(self.builder.context, prototype, gscope, attributes, constants, module=self.module, is_kernel=True)
-        #         generator.visit(ret.fn.parse())
-        #     symbol = self.module.get_function(fn_name)
-        #     # TODO: should ret.args not include any constants ?
-        #     ret = self.builder.launch(symbol, ret.args, ret.grid, ret.num_warps)
+        # device-side launch: the builtin returns a proxy, and the callee
+        # is generated as a kernel of this module
+        if isinstance(ret, triton.language.core.LaunchProxy):
+            fn = ret.fn
+            if not isinstance(fn, JITFunction):
+                raise TypeError(f"tl.launch expects a @triton.jit function, got {fn}")
+            args = ret.args
+            if len(args) != len(fn.arg_names):
+                raise TypeError(f"{fn.__name__} takes {len(fn.arg_names)} arguments, {len(args)} given to tl.launch")
+            args = [arg if isinstance(arg, triton.language.tensor)
+                    else triton.language.constexpr(arg) for arg in args]
+            constexprs = [i for i, arg in enumerate(args) if isinstance(arg, triton.language.constexpr)]
+            constants = {i: args[i] for i in constexprs}
+            arg_vals = [arg.handle for i, arg in enumerate(args) if i not in constexprs]
+            arg_types = [arg.type for i, arg in enumerate(args) if i not in constexprs]
+            fn_name = mangle_fn(fn.__name__, arg_types, constants)
+            if not self.module.has_function(fn_name):
+                prototype = triton.language.function_type(triton.language.void, arg_types)
+                gscope = sys.modules[fn.fn.__module__].__dict__
+                generator = CodeGenerator(self.builder.context, prototype, gscope, dict(), constants, prototypes=self.prototypes,
+                                          module=self.module, is_kernel=True, src_file=fn.src_file, line_offset=fn.line_offset)
+                generator.visit(fn.parse())
+            symbol = self.module.get_function(fn_name)
+            # the callee runs with the number of warps of the module
+            self.builder.launch(symbol, arg_vals, [x.handle for x in ret.grid], self.builder.get_int32(0))
+            return None
         return ret
-        # return fn(*args, **kws)
 
     def visit_Constant(self, node):
         return triton.language.constexpr(node.value)
@@ -703,12 +740,18 @@ class CodeGenerator(ast.NodeVisitor):
     def visit(self, node):
         if node is not None:
             self.last_node = node
+        loc = self.builder.get_loc()
+        if self.src_file and getattr(node, 'lineno', None) is not None:
+            self.builder.set_loc(self.src_file, self.line_offset + node.lineno, node.col_offset + 1)
         with warnings.catch_warnings():
             # The ast library added visit_Constant and deprecated some other
             # methods but we can't move to that without breaking Python 3.6 and 3.7.
             warnings.simplefilter("ignore", DeprecationWarning)  # python 3.9
             warnings.simplefilter("ignore", PendingDeprecationWarning)  # python 3.8
-            return super().visit(node)
+            ret = super().visit(node)
+        # the parent node may generate instructions of its own after its children
+        self.builder.set_loc(*loc)
+        return ret
 
     def generic_visit(self, node):
         typename = type(node).__name__
@@ -716,45 +759,216 @@ class CodeGenerator(ast.NodeVisitor):
 
 
 class Binary:
-    def __init__(self, backend, name, asm, shared_mem, num_warps):
+    def __init__(self, backend, name, asm, shared_mem, num_warps, ptxas_info=None, num_threads=None, carveout=-1,
+                 tensor_maps=''):
         self.backend = backend
         self.name = name
         self.asm = asm
         self.shared_mem = shared_mem
         self.num_warps = num_warps
+        # threads per block, which warp-specialized kernels double
+        self.num_threads = num_threads if num_threads is not None else num_warps * 32
+        # resources reported by `ptxas -v` (registers, spills, static smem) and its raw log
+        self.ptxas_info = ptxas_info if ptxas_info is not None else dict()
+        # percentage of the L1/shared memory of a multiprocessor to use as shared memory,
+        # or -1 for the driver's choice
+        self.carveout = carveout
+        # how the launcher encodes the tensor maps of the TMA copies of the kernel (sm90+),
+        # one per line, which it appends to the arguments (see `tensor_maps` in triton.cc)
+        self.tensor_maps = tensor_maps
 
 
 class LoadedBinary:
-    def __init__(self, device: int, bin: Binary):
-        module, kernel = _triton.code_gen.load_binary(bin.backend,
-                                                      bin.name,
-                                                      bin.asm,
-                                                      bin.shared_mem,
-                                                      device)
+    # binaries instrumented with TRITON_TRACE, and the function called on the new ones
+    # (see `triton.tools.trace.Tracer`)
+    traced = []
+    trace_hook = None
+
+    def __init__(self, device: int, bin: Binary, module=None):
         self.bin = bin
         self.asm = bin.asm
         self.sass = ''
-        self.module = module
-        self.kernel = kernel
         self.device = device
         self.shared_mem = bin.shared_mem
+        # binaries cached before TMA copies have no tensor maps
+        self.tensor_maps = getattr(bin, 'tensor_maps', '')
+        # binaries are compiled per architecture, and loaded on each device that shares it
+        # on their first launch there. `module` is the already loaded image of a binary
+        # compiled with others, which is not ours to unload
+        self.modules = dict()
+        self.owns_module = module is None
+        if module is not None:
+            self.modules[device] = (module, _triton.code_gen.get_function(bin.backend, module, bin.name, bin.shared_mem, device,
+                                                                          bin.carveout))
+        self._resources = None
+        # time of the last launch through `__call__` (the launcher tracks its own, see
+        # `JITFunction.cache_entries`), which is the time of creation until then
+        self.last_use = time.monotonic()
+        # kernels that call `tl.grid_sync` spin on a counter appended to their arguments,
+        # one per stream (see `grid_barrier_pool` in triton.cc)
+        self.grid_sync = 'grid_sync' in self.asm
+        # persistent kernels claim their tiles from a global counter
+        self.persistent = isinstance(self.asm.get('ptx'), str) and '__triton_tile_counter' in self.asm['ptx']
+        if isinstance(self.asm.get('ptx'), str) and '__triton_trace_buffer' in self.asm['ptx']:
+            LoadedBinary.traced.append(self)
+            if LoadedBinary.trace_hook is not None:
+                LoadedBinary.trace_hook(self)
+
+    @property
+    def module(self):
+        return self._load(self.device)[0]
+
+    @property
+    def kernel(self):
+        return self._load(self.device)[1]
+
+    @property
+    def resources(self):
+        # registers per thread, spilled bytes per thread, static and dynamic shared memory
+        # and resident blocks per multiprocessor, reported by the driver (CUDA only).
+        # `bin.ptxas_info` holds what ptxas reported at compile time
+        if self._resources is None:
+            bin = self.bin
+            self._resources = _triton.code_gen.kernel_resources(bin.backend, self.kernel, bin.num_threads, bin.shared_mem)
+        return self._resources
+
+    @property
+    def codegen_stats(self):
+        # decisions of code generation, or None for binaries cached without them (see
+        # `TRITON_CACHE_IR`): instructions after each pass that ran as (pass, count) pairs,
+        # layout conversions left in the kernel, barriers inserted to synchronize shared
+        # memory, its buffers, the vector width of each global load and store of a block,
+        # and how many of the loads of loops were pipelined, with how many stages
+        text = self.asm.get('codegen_stats')
+        if text is None:
+            return None
+        stats = dict(insts=[], cvt_layout=0, barriers=0, shared=[], loads=[], stores=[], pipeline=None)
+        for entry in text.splitlines():
+            record, *fields = entry.split()
+            if record == 'insts':
+                stats['insts'].append((fields[0], int(fields[1])))
+            elif record in ('cvt_layout', 'barriers'):
+                stats[record] = int(fields[0])
+            elif record == 'shared':
+                offset, size, stages, line = map(int, fields)
+                stats['shared'].append(dict(offset=offset, bytes=size, stages=stages, line=line))
+            elif record in ('load', 'store'):
+                line, vec, bits = map(int, fields)
+                stats[record + 's'].append(dict(line=line, vec=vec, bits=bits))
+            elif record == 'pipeline':
+                pipelined, candidates, stages = map(int, fields)
+                stats['pipeline'] = dict(pipelined=pipelined, candidates=candidates, stages=stages)
+        return stats
+
+    def _load(self, device):
+        if device not in self.modules:
+            bin = self.bin
+            # modules are loaded in the context of the current device
+            if device >= 0 and torch.cuda.current_device() != device:
+                with torch.cuda.device(device):
+                    ret = self._load(device)
+                # leaving the block may make the context of another device current
+                _triton.runtime.set_current_device(bin.backend, device)
+                return ret
+            self.modules[device] = _triton.code_gen.load_binary(bin.backend, bin.name, bin.asm, bin.shared_mem, device,
+                                                                bin.carveout)
+        return self.modules[device]
+
+    def kernel_for(self, device):
+        # modules are only loaded when first launched on a device
+        return self._load(device)[1]
+
+    def unload(self):
+        # unloads the modules of the binary, which are loaded again on its next launch;
+        # launch caches must not hold its kernels anymore (see `JITFunction.unload`)
+        for device, (module, _) in self.modules.items():
+            if device != self.device or self.owns_module:
+                _triton.code_gen.unload_binary(self.bin.backend, module)
+        self.modules = dict()
+        self.owns_module = True
+
+    def max_programs(self, device):
+        # the programs of a kernel that calls `tl.grid_sync` must all be resident at once,
+        # i.e., fit in one wave on the device. Returns 0 when there is no such limit
+        if not self.grid_sync or self.bin.backend != _triton.runtime.backend.CUDA:
+            return 0
+        bin = self.bin
+        resources = _triton.code_gen.kernel_resources(bin.backend, self.kernel_for(device), bin.num_threads, bin.shared_mem)
+        return resources['max_ctas_per_sm'] * _triton.runtime.num_sm(bin.backend, device)
+
+    def persistent_programs(self, device):
+        # persistent kernels run on as many programs as fit on the device at once, whatever
+        # their grid. Returns 0 for other kernels
+        if not self.persistent:
+            return 0
+        bin = self.bin
+        resources = _triton.code_gen.kernel_resources(bin.backend, self.kernel_for(device), bin.num_threads, bin.shared_mem)
+        return max(1, resources['max_ctas_per_sm']) * _triton.runtime.num_sm(bin.backend, device)
+
+    def tile_counter(self, device):
+        # address of the counter of a persistent kernel on `device`
+        return _triton.code_gen.global_address(self.bin.backend, self._load(device)[0], '__triton_tile_counter')
+
+    def host_bytes(self):
+        # bytes of host memory held by the assembly of the binary; the IRs read
+        # from a `CacheStore` count for their compressed size until they are read
+        size = 0
+        for value in dict.values(self.asm):
+            if isinstance(value, _CompressedText):
+                value = value.data
+            if isinstance(value, (str, bytes)):
+                size += len(value)
+        return size
+
+    def device_bytes(self):
+        # bytes of the images loaded on devices, one per device the binary was launched on
+        for name in ('cubin', 'hsaco', 'ptx'):
+            image = dict.get(self.asm, name)
+            if isinstance(image, (str, bytes)):
+                return len(image) * len(self.modules)
+        return 0
+
+    def spills(self):
+        return self.resources.get('n_spill_bytes', 0) > 0 or \
+            self.bin.ptxas_info.get('n_spill_stores', 0) > 0
 
     def __call__(self, stream, args, grid_0, grid_1=1, grid_2=1):
+        max_programs = self.max_programs(self.device)
+        if max_programs and grid_0 * grid_1 * grid_2 > max_programs:
+            raise RuntimeError(f"grid of {grid_0 * grid_1 * grid_2} programs calls grid_sync, "
+                               f"but only {max_programs} fit on the device at once")
+        if self.tensor_maps:
+            raise RuntimeError("kernels with TMA copies are launched with their tensor maps by the launcher, "
+                               "not from packed arguments")
+        if self.persistent:
+            # same hidden arguments and grid as `persist` in triton.cc
+            args += bytes(-len(args) % 8) + struct.pack('QIII', self.tile_counter(self.device), grid_0, grid_1, grid_2)
+            grid_0, grid_1, grid_2 = min(grid_0 * grid_1 * grid_2, self.persistent_programs(self.device)), 1, 1
+        if self.grid_sync:
+            args += bytes(-len(args) % 8) + struct.pack('Q', _triton.runtime.grid_barrier(self.bin.backend, self.device, stream))
+        self.last_use = time.monotonic()
         _triton.runtime.enqueue(self.bin.backend, stream, self.kernel,
                                 grid_0, grid_1, grid_2,
-                                self.bin.num_warps * 32, 1, 1,
+                                self.bin.num_threads, 1, 1,
                                 args, self.bin.shared_mem)
 
-    def get_sass(self, fun=None):
-        if self.sass:
+    def get_sass(self, fun=None, lineinfo=False):
+        '''
+        Returns the SASS of the kernel; with `lineinfo`, each group of instructions
+        is preceded by the source line it was generated for
+        '''
+        if self.sass and not lineinfo:
             return self.sass
         fd, path = tempfile.mkstemp()
         try:
             with open(fd, 'wb') as cubin:
                 cubin.write(self.asm['cubin'])
-            self.sass = extract(path, fun)
+            sass = extract(path, fun, lineinfo)
         finally:
             os.remove(path)
+        if lineinfo:
+            return sass
+        self.sass = sass
         self.asm['sass'] = self.sass
         return self.sass
 
@@ -788,6 +1002,147 @@ class OutOfResources(Exception):
         return (type(self), (self.required, self.limit, self.name))
 
 
+def _backend(device=0):
+    # kernels whose tensors all live in host memory are compiled for the CPU
+    if device < 0:
+        return _triton.runtime.backend.HOST
+    if torch.version.hip is None:
+        return _triton.runtime.backend.CUDA
+    return _triton.runtime.backend.ROCM
+
+
+def _warp_specialized(backend, cc):
+    # mirrors the code generator, which pairs each warp with a producer warp
+    # that issues its asynchronous copies to shared memory on sm80+
+    return backend == _triton.runtime.backend.CUDA and cc >= 80 and \
+        os.environ.get('TRITON_WARP_SPECIALIZE', '0') == '1'
+
+
+class CompileBatch:
+    """
+    Context manager that collects the compilations triggered by kernel calls made
+    inside of it, and compiles them concurrently when it exits. Kernels called
+    inside of the context are not launched.
+
+    .. highlight:: python
+    .. code-block:: python
+
+        with triton.code_gen.CompileBatch():
+            for BLOCK in [128, 256, 512]:
+                kernel[grid](x, y, BLOCK=BLOCK)
+
+    :param num_threads: the number of compilation threads. Defaults to the number of CPUs.
+    :type num_threads: int
+    :param link: whether CUDA kernels are linked into as many modules as there are threads,
+                 each of which is lowered to PTX, assembled and loaded once, rather than
+                 compiled one by one. Defaults to True.
+    :type link: bool
+    """
+    # batches only collect the kernels called by the thread that entered them
+    _local = threading.local()
+
+    @staticmethod
+    def active():
+        """ the batch entered by the current thread, if any """
+        return getattr(CompileBatch._local, 'batch', None)
+
+    def __init__(self, num_threads=None, link=True):
+        self.num_threads = os.cpu_count() if num_threads is None else num_threads
+        self.link = link
+        self.pending = dict()
+
+    def __enter__(self):
+        assert CompileBatch.active() is None, "compilation batches cannot be nested"
+        CompileBatch._local.batch = self
+        return self
+
+    def __exit__(self, type, value, traceback):
+        CompileBatch._local.batch = None
+        if type is None:
+            self.compile()
+
+    def add(self, fn, key, compile, store):
+        if (fn, key) in self.pending:
+            return
+        refs, module = fn._get_ttir(compile['arg_types'], compile['attributes'], compile['constants'])
+        self.pending[(fn, key)] = (refs, module, compile, store)
+
+    def compile(self):
+        devices = {compile['device'] for _, _, compile, _ in self.pending.values()}
+        for device in devices:
+            backend = _backend(device)
+            keys = [k for k, (_, _, compile, _) in self.pending.items() if compile['device'] == device]
+            modules = [self.pending[k][1] for k in keys]
+            num_warps = [self.pending[k][2]['num_warps'] for k in keys]
+            num_stages = [self.pending[k][2]['num_stages'] for k in keys]
+            results = _triton.code_gen.compile_ttir_batch(backend, modules, device, num_warps, num_stages,
+                                                          self.num_threads, self.link)
+            # linked kernels share their image, which is loaded once
+            loaded = dict()
+            for (fn, key), result in zip(keys, results):
+                # failures are left for the next regular call to report
+                if result is None:
+                    continue
+                _, _, compile, store = self.pending[(fn, key)]
+                name, asm, shared_mem, ptxas_info = result
+                try:
+                    binary = fn._make_binary(backend, name, asm, shared_mem, device, compile['num_warps'], ptxas_info)
+                except OutOfResources:
+                    continue
+                module = None
+                image = asm.get('cubin')
+                if self.link and isinstance(image, bytes):
+                    if id(image) not in loaded:
+                        loaded[id(image)] = _triton.code_gen.load_module(backend, asm)
+                    module = loaded[id(image)]
+                fn._add_to_cache(key, binary, device, store, module)
+        self.pending = dict()
+
+
+class CUDAGraph:
+    """
+    Records the kernels launched inside of it into a CUDA graph, which can then be
+    replayed with a single driver call. Kernels launched while capturing are not run,
+    and should be compiled (or autotuned) beforehand.
+
+    .. highlight:: python
+    .. code-block:: python
+
+        graph = triton.code_gen.CUDAGraph()
+        with graph:
+            for layer in layers:
+                kernel[grid](x, layer.weight, y)
+        graph.replay()
+        # tensors used at capture time can be swapped for others of the same layout
+        graph.replay({x: x_next, y: y_next})
+    """
+
+    def __init__(self):
+        self.graph = _triton.runtime.launch_graph()
+
+    def __enter__(self):
+        self.graph.begin()
+        return self
+
+    def __exit__(self, type, value, traceback):
+        self.graph.end()
+
+    def __len__(self):
+        return len(self.graph)
+
+    def replay(self, remap=None, stream=None):
+        """
+        :param remap: maps tensors (or pointers) used at capture time to the ones used by this
+            replay. Tensors that are not remapped are the ones used at capture time.
+        :param stream: stream to replay the graph on. Defaults to the current stream.
+        """
+        ptr = lambda x: x if isinstance(x, int) else x.data_ptr()
+        remap = {ptr(k): ptr(v) for k, v in (remap or dict()).items()}
+        if stream is None:
+            stream = current_stream(torch.cuda.current_device())
+        self.graph.replay(stream, remap)
+
+
 class Kernel:
 
     @staticmethod
@@ -883,6 +1238,13 @@ class Kernel:
             return 2
         return 1
 
+    @staticmethod
+    def _storage(arg):
+        # start of the storage of `arg`, or 0 when unknown
+        if not hasattr(arg, 'storage_offset'):
+            return 0
+        return arg.data_ptr() - arg.storage_offset() * arg.element_size()
+
     def __init__(self, fn):
         self.fn = fn
 
@@ -894,13 +1256,20 @@ class Kernel:
         for i, arg in enumerate(wargs):
             if i in self.fn.do_not_specialize:
                 continue
-            if isinstance(arg, int):
+            if isinstance(arg, int) and i in self.fn.strides:
+                attributes[i] = 16 if arg % 16 == 0 else 1
+            elif isinstance(arg, int):
                 attributes[i] = Kernel.pow2_divisor(arg)
             elif i in tensor_idxs:
                 addr = arg.data_ptr()
-                range_size = _triton.runtime.get_pointer_range_size(addr)
+                range_size = 0 if device_idx < 0 else _triton.runtime.get_pointer_range_size(addr)
                 attributes[i] = min(Kernel.pow2_divisor(addr),
                                     Kernel.pow2_divisor(range_size))
+        # tensors that share no storage with other tensors do not alias
+        if device_idx >= 0:
+            storages = {i: Kernel._storage(wargs[i]) for i in tensor_idxs}
+            attributes['noalias'] = [i for i, storage in storages.items()
+                                     if storage != 0 and all(j == i or (s != 0 and s != storage) for j, s in storages.items())]
         # transforms ints whose value is one into constants for just-in-time compilation
         constants = {i: arg for i, arg in enumerate(wargs) if isinstance(arg, int) and arg == 1 and i not in self.fn.do_not_specialize}
         constants.update({i: arg.value for i, arg in enumerate(wargs) if isinstance(arg, triton.language.constexpr)})
@@ -908,7 +1277,7 @@ class Kernel:
         arg_types = [Kernel._to_python_ir(arg) for i, arg in enumerate(wargs) if i not in constants]
         return self.fn._warmup(key, arg_types=arg_types, device=device_idx, attributes=attributes, constants=constants, num_warps=num_warps, num_stages=num_stages, is_manual_warmup=False)
 
-    def __call__(self, *wargs, grid, num_warps=4, num_stages=2, **kwargs):
+    def _bind(self, wargs, kwargs):
         # handle arguments passed by name
         kwargs = {self.fn.arg_names.index(name): value for name, value in kwargs.items()}
         wargs = list(wargs)
@@ -920,22 +1289,189 @@ class Kernel:
         for pos, _type in self.fn.annotations.items():
             assert _type == triton.language.constexpr, "only constexpr annotations are supported for now"
             wargs[pos] = _type(wargs[pos])
-        # check that tensors are on GPU.
-        for arg in wargs:
+        return wargs
+
+    def _target(self, wargs):
+        # device, cache key prefix and stream of a launch with arguments `wargs`
+        # check that tensors are either all on GPU or all on CPU.
+        tensors = [arg for arg in wargs if hasattr(arg, 'data_ptr')]
+        on_host = len(tensors) > 0 and not any(arg.is_cuda for arg in tensors)
+        if not on_host:
+            assert all(arg.is_cuda for arg in tensors), "All tensors must be on GPU!"
+        if on_host:
+            # host launches are synchronous and run on all cores
+            device = -1
+            cache_key = self.fn.cache_key + 'host-' + _triton.runtime.host_cpu_name()
+            stream = 0
+        else:
+            # the device of the tensor arguments, else PyTorch's current one; the launch appends
+            # its compute capability to the cache key when it looks a binary up
+            backend = _backend()
+            devices = {arg.device.index for arg in tensors if arg.device.index is not None}
+            device = devices.pop() if len(devices) == 1 else torch.cuda.current_device()
+            # the current context may still be another device's: before CUDA 12,
+            # `torch.cuda.device` only selects the device the runtime uses next
+            if _triton.runtime.current_device(backend) != device:
+                _triton.runtime.set_current_device(backend, device)
+            cache_key = self.fn.cache_key
+            if backend == _triton.runtime.backend.CUDA and os.environ.get('TRITON_WARP_SPECIALIZE', '0') == '1':
+                cache_key += 'ws'
+            if os.environ.get('TRITON_L2_PREFETCH', '') in ('64', '128', '256'):
+                cache_key += 'l2-' + os.environ['TRITON_L2_PREFETCH']
+            if os.environ.get('TRITON_DISABLE_TMA', '') == '1':
+                cache_key += 'notma'
+            if os.environ.get('TRITON_TRACE', '') in ('1', '2', '3'):
+                cache_key += 'trace-' + os.environ['TRITON_TRACE']
+            if os.environ.get('TRITON_LLVM_OPT', ''):
+                cache_key += 'opt-' + os.environ['TRITON_LLVM_OPT']
+            if os.environ.get('TRITON_INLINE_THRESHOLD', ''):
+                cache_key += 'inline-' + os.environ['TRITON_INLINE_THRESHOLD']
+            # binaries carry the line numbers of the source
+            if os.environ.get('TRITON_DISABLE_LINE_INFO', '') == '1':
+                cache_key += 'nolines'
+            else:
+                cache_key += f'line{self.fn.line_offset}'
+            # query current stream
+            stream = current_stream(device)
+        # binaries compiled in the background replace the ones launched meanwhile
+        if self.fn.compiled:
+            self.fn._swap_compiled(device)
+        return device, cache_key, stream
+
+    def __call__(self, *wargs, grid, num_warps=4, num_stages=2, **kwargs):
+        wargs = self._bind(wargs, kwargs)
+        device, cache_key, stream = self._target(wargs)
+        # kernels called while a batch of compilations is collected only
+        # populate the binary cache: nothing is enqueued
+        if CompileBatch.active() is not None:
+            grid = (0,)
+        return _triton.runtime.launch(wargs, self.fn.do_not_specialize, self.fn.strides, cache_key, self.fn.arg_names,
+                                      device, stream, self.fn.bin_cache, self.fn.launch_cache, num_warps, num_stages,
+                                      self.add_to_cache, grid)
+
+    def launch_many(self, arg_lists, grids, stream=None, num_warps=4, num_stages=2):
+        """
+        Launches the kernel once per list of positional arguments in `arg_lists`, on the
+        grid of the same index in `grids`, and returns the binaries launched. Arguments are
+        all parsed and their binaries looked up first, and the kernels are then enqueued in
+        one loop, with the GIL released. All the launches are on the device of the first one.
+        """
+        if len(arg_lists) != len(grids):
+            raise ValueError(f"{len(arg_lists)} argument lists were given for {len(grids)} grids")
+        if len(arg_lists) == 0:
+            return []
+        arg_lists = [self._bind(args, dict()) for args in arg_lists]
+        device, cache_key, current = self._target(arg_lists[0])
+        if stream is None:
+            stream = current
+        if CompileBatch.active() is not None:
+            grids = [(0,)] * len(grids)
+        return _triton.runtime.launch_many(arg_lists, grids, self.fn.do_not_specialize, self.fn.strides, cache_key,
+                                           self.fn.arg_names, device, stream, self.fn.bin_cache, self.fn.launch_cache,
+                                           num_warps, num_stages, self.add_to_cache)
+
+    @staticmethod
+    def _pack(wargs, constants):
+        # kernel parameters of a launch, packed as by `arg_packer` in triton.cc
+        formats = {'i32': 'i', 'u32': 'I', 'i64': 'q', 'u64': 'Q', 'f': 'f'}
+        params = bytearray()
+        for i, arg in enumerate(wargs):
+            if i in constants:
+                continue
             if hasattr(arg, 'data_ptr'):
-                assert arg.is_cuda, "All tensors must be on GPU!"
-        # set device (i.e., make sure torch has the context initialized)
-        device = torch.cuda.current_device()
-        torch.cuda.set_device(device)
-        # query compute capability
-        cc = torch.cuda.get_device_capability(device)
-        cc = str(cc[0]) + '-' + str(cc[1])
-        cache_key = self.fn.cache_key + cc
-        # query current stream
-        stream = current_stream(device)
-        return _triton.runtime.launch(wargs, self.fn.do_not_specialize, cache_key, self.fn.arg_names,
-                                      device, stream, self.fn.bin_cache, num_warps, num_stages, self.add_to_cache,
-                                      grid)
+                fmt, arg = 'Q', arg.data_ptr()
+            else:
+                fmt = formats[Kernel._type_name(arg)]
+            params += bytes(-len(params) % struct.calcsize(fmt)) + struct.pack(fmt, arg)
+        return params
+
+    def launch_fused(self, arg_lists, grids, num_warps=4, num_stages=2):
+        """
+        Runs the launches of the kernel with the lists of positional arguments in `arg_lists`,
+        on the grids of the same index in `grids`, as a single launch over the concatenation
+        of their grids, on the current stream. Each program reads the arguments of its launch
+        from a table in device memory (see `codegen::transform::horizontal`), and its program
+        ids are those of its launch. Launches must share their constexpr arguments, the
+        positions of their None arguments, and the types of the others; the kernel is
+        specialized for the alignment common to all of them. Returns the binary launched.
+        """
+        if len(arg_lists) != len(grids):
+            raise ValueError(f"{len(arg_lists)} argument lists were given for {len(grids)} grids")
+        if len(arg_lists) == 0:
+            return None
+        if self.fn.persistent:
+            raise ValueError("persistent kernels cannot be fused horizontally")
+        arg_lists = [self._bind(args, dict()) for args in arg_lists]
+        device, cache_key, stream = self._target(arg_lists[0])
+        if device < 0:
+            raise ValueError("only launches on GPUs can be fused horizontally")
+        # specialization shared by all the launches
+        constexprs = {i: arg.value for i, arg in enumerate(arg_lists[0]) if isinstance(arg, triton.language.constexpr)}
+        constants = dict(constexprs)
+        constants.update({i: None for i, arg in enumerate(arg_lists[0]) if arg is None})
+        arg_types = [Kernel._to_python_ir(arg) for i, arg in enumerate(arg_lists[0]) if i not in constants]
+        attributes = {i: 16 for i in range(len(arg_lists[0])) if i not in constants and i not in self.fn.do_not_specialize}
+        for wargs in arg_lists:
+            if any(repr(arg.value) != repr(constexprs[i]) if i in constexprs else (arg is None) != (i in constants)
+                   for i, arg in enumerate(wargs)):
+                raise ValueError("launches fused horizontally must have the same constexpr and None arguments")
+            if [Kernel._to_python_ir(arg) for i, arg in enumerate(wargs) if i not in constants] != arg_types:
+                raise ValueError("launches fused horizontally must have arguments of the same types")
+            for i in attributes:
+                arg = wargs[i]
+                if hasattr(arg, 'data_ptr'):
+                    addr = arg.data_ptr()
+                    range_size = _triton.runtime.get_pointer_range_size(addr)
+                    divisor = builtins.min(Kernel.pow2_divisor(addr), Kernel.pow2_divisor(range_size))
+                elif isinstance(arg, int) and i in self.fn.strides:
+                    divisor = 16 if arg % 16 == 0 else 1
+                elif isinstance(arg, int):
+                    divisor = Kernel.pow2_divisor(arg)
+                else:
+                    continue
+                attributes[i] = builtins.min(attributes[i], divisor)
+        attributes = {i: divisor for i, divisor in attributes.items()
+                      if not isinstance(arg_lists[0][i], float)}
+        attributes['horizontal'] = True
+        sig = '_'.join(repr(constants[i]) if i in constants else
+                       f"{name}{'*' if which == 'ptr' else ''}[multipleof({attributes.get(i, 1)})]"
+                       for i, (which, name) in zip([i for i in range(len(arg_lists[0])) if i not in constants], arg_types))
+        major, minor = torch.cuda.get_device_capability(device)
+        key = f"{cache_key}horizontal-cc{major}-{minor}-{num_warps}-{num_stages}-_{sig}"
+        if key not in self.fn.bin_cache:
+            noop = self.fn._warmup(key, arg_types=arg_types, device=device, attributes=attributes, constants=constants,
+                                   num_warps=num_warps, num_stages=num_stages, is_manual_warmup=True)
+            if noop:
+                return None
+        binary = self.fn.bin_cache[key]
+        # table of the launches with programs, and their parameters
+        meta = {self.fn.arg_names[i]: value for i, value in constexprs.items()}
+        rows = []
+        num_programs = 0
+        records = [Kernel._pack(wargs, constants) for wargs in arg_lists]
+        record_size = builtins.max(16, (builtins.max(len(r) for r in records) + 15) // 16 * 16)
+        params = bytearray()
+        for grid, record in zip(grids, records):
+            grid = tuple(grid(meta) if callable(grid) else grid) + (1, 1)
+            size = grid[0] * grid[1] * grid[2]
+            if size == 0:
+                continue
+            rows.append(struct.pack('iiii', num_programs, grid[0], grid[1], grid[2]))
+            params += record + bytes(record_size - len(record))
+            num_programs += size
+        if num_programs == 0:
+            return binary
+        if num_programs >= 2**31:
+            raise ValueError(f"launches fused horizontally have {num_programs} programs, more than a grid holds")
+        header = struct.pack('iiii', len(rows), record_size, 16 * (1 + len(rows)), 0)
+        table = header + b''.join(rows) + bytes(params)
+        with triton.workspace.scope(torch.device('cuda', device)) as ws:
+            table_dev = ws.empty(len(table), torch.uint8)
+            table_dev.copy_(torch.frombuffer(bytearray(table), dtype=torch.uint8), non_blocking=True)
+            # the arguments of the first launch, which are read from the table, and the table
+            args = records[0] + bytes(-len(records[0]) % 8) + struct.pack('Q', table_dev.data_ptr())
+            binary(stream, bytes(args), num_programs)
+        return binary
 
 
 class Launcher:
@@ -947,13 +1483,28 @@ class Launcher:
         return self.kernel(*wargs, **kwargs, grid=self.grid)
 
 
+def default_resource_config_prune(configs, binaries):
+    # configs without a binary are kept, so that their error is reported
+    def is_valid(config):
+        bin = binaries.get(config, None)
+        return bin is None or (not bin.spills() and bin.resources.get('max_ctas_per_sm', 1) > 0)
+    return [config for config in configs if is_valid(config)]
+
+
 class Autotuner:
-    def __init__(self, kernel, arg_names, configs, key, reset_to_zero, prune_configs_by: Dict = None):
+    def __init__(self, kernel, arg_names, configs, key, reset_to_zero, prune_configs_by: Dict = None, fn=None, search=None):
         '''
         :param prune_configs_by: a dict of functions that are used to prune configs, fields:
             'perf_model': performance model used to predicate running time with different configs, returns running time
             'top_k': number of configs to bench
             'prune_num_stages_by'(optional): a function used to prune num_stages. It take configs:List[Config] as its input, and returns pruned configs.
+            'resource_config_prune'(optional): a function used to prune compiled configs before benchmarking them. It takes
+                configs:List[Config] and binaries:Dict[Config, LoadedBinary] as its input, and returns pruned configs.
+                By default, configs that spill registers or cannot be launched are dropped.
+        :param fn: the tuned JIT function; when given, picked configs are persisted in the
+            tuning store of the kernel cache directory and reused by other processes
+        :param search: how the pruned configs are benchmarked (see `triton.search`): 'exhaustive' (default),
+            'halving', 'model', or a strategy object
         '''
         if not configs:
             self.configs = [Config(dict(), num_warps=4, num_stages=2)]
@@ -962,6 +1513,8 @@ class Autotuner:
         self.key_idx = [arg_names.index(k) for k in key]
         self.cache = dict()
         self.kernel = kernel
+        self.fn = fn
+        self.search = get_search_strategy(search)
         # hook to reset all required tensor to zeros before relaunching a kernel
         self.hook = lambda args: 0
         if reset_to_zero is not None:
@@ -975,14 +1528,16 @@ class Autotuner:
         # prune configs
         if prune_configs_by:
             perf_model, top_k = prune_configs_by['perf_model'], prune_configs_by['top_k']
-            if 'early_config_prune' in prune_configs_by:
-                early_config_prune = prune_configs_by['early_config_prune']
+            early_config_prune = prune_configs_by.get('early_config_prune', None)
+            resource_config_prune = prune_configs_by.get('resource_config_prune', default_resource_config_prune)
         else:
             perf_model, top_k, early_config_prune = None, None, None
+            resource_config_prune = default_resource_config_prune
         self.perf_model, self.configs_top_k = perf_model, top_k
         self.early_config_prune = early_config_prune
+        self.resource_config_prune = resource_config_prune
 
-    def _bench(self, *args, config, **meta):
+    def _bench(self, *args, config, rep=100, **meta):
         # check for conflicts, i.e. meta-parameters both provided
         # as kwargs and by the autotuner
         conflicts = meta.keys() & config.kwargs.keys()
@@ -999,12 +1554,76 @@ class Autotuner:
                 config.pre_hook(self.nargs)
             self.hook(args)
             self.kernel(*args, num_warps=config.num_warps, num_stages=config.num_stages, **current)
-        return triton.testing.do_bench(kernel_call)
+        # configs that cannot be compiled or launched are dropped by the search
+        try:
+            return triton.testing.do_bench(kernel_call, warmup=builtins.min(25, rep), rep=rep, percentiles=[0.5])[0]
+        except (OutOfResources, CompilationError):
+            return float('inf')
+
+    def _precompile(self, *args, configs, **meta):
+        # compile all configs together so that the benchmarks
+        # below only hit the binary cache
+        with CompileBatch():
+            for config in configs:
+                current = dict(meta, **config.kwargs)
+                self.kernel(*args, num_warps=config.num_warps, num_stages=config.num_stages, **current)
+
+    def _binaries(self, *args, configs, **meta):
+        # inside a batch, kernel calls return the binary they would launch
+        # once it is compiled, and nothing is enqueued
+        ret = dict()
+        with CompileBatch() as batch:
+            for config in configs:
+                current = dict(meta, **config.kwargs)
+                bin = self.kernel(*args, num_warps=config.num_warps, num_stages=config.num_stages, **current)
+                if bin is not None:
+                    ret[config] = bin
+            # kernels that failed to compile are left for the benchmarks to report
+            batch.pending = dict()
+        return ret
+
+    def _store(self):
+        # tuning results live next to the binaries
+        cache_dir = os.environ.get('TRITON_CACHE_DIR', '/tmp/triton/')
+        if self.fn is None or not cache_dir:
+            return None
+        return TuningStore.get(cache_dir)
+
+    @staticmethod
+    def _device(args):
+        if any(hasattr(arg, 'data_ptr') and not arg.is_cuda for arg in args):
+            return 'host/' + _triton.runtime.host_cpu_name()
+        device = torch.cuda.current_device()
+        cc = torch.cuda.get_device_capability(device)
+        return f'{torch.cuda.get_device_name(device)}/sm{cc[0]}{cc[1]}'
+
+    def _load(self, store, key, args):
+        # the stored config, if it is still among the tuned ones
+        record = store.lookup(self.fn.cache_key, Autotuner._device(args), repr(key))
+        if record is None:
+            return None
+        stored = record['config']
+        for config in self.configs:
+            if config.kwargs == stored['kwargs'] and config.num_warps == stored['num_warps'] \
+               and config.num_stages == stored['num_stages']:
+                return config
+        return None
+
+    def _save(self, store, key, args, config, ms):
+        store.add([{'kernel': self.fn.cache_key, 'device': Autotuner._device(args), 'key': repr(key),
+                    'name': self.fn.__name__, 'ms': ms,
+                    'config': {'kwargs': config.kwargs, 'num_warps': config.num_warps, 'num_stages': config.num_stages}}])
 
     def __call__(self, *args, **kwargs):
         self.nargs = dict(zip(self.arg_names, args))
         if len(self.configs) > 1:
-            key = tuple([args[i] for i in self.key_idx])
+            # constexprs given by keyword can be part of the key
+            key = tuple([args[i] if i < len(args) else kwargs.get(self.arg_names[i]) for i in self.key_idx])
+            store = self._store() if key not in self.cache else None
+            if store is not None:
+                config = self._load(store, key, args)
+                if config is not None:
+                    self.cache[key] = config
             if key not in self.cache:
                 # prune configs
                 pruned_configs = self.configs
@@ -1017,14 +1636,25 @@ class Autotuner:
                     if len(pruned_configs) > top_k:
                         est_timing = {config: self.perf_model(**self.nargs, **kwargs, **config.kwargs, num_stages=config.num_stages, num_warps=config.num_warps) for config in pruned_configs}
                         pruned_configs = sorted(est_timing.keys(), key=lambda x: est_timing[x])[:top_k]
+                binaries = dict()
+                if len(pruned_configs) > 1:
+                    self._precompile(*args, configs=pruned_configs, **kwargs)
+                    binaries = self._binaries(*args, configs=pruned_configs, **kwargs)
+                    pruned_configs = self.resource_config_prune(pruned_configs, binaries) or pruned_configs
                 bench_start = time.time()
-                timings = {config: self._bench(*args, config=config, **kwargs)
-                           for config in pruned_configs}
+                timings, best = self.search(pruned_configs,
+                                            lambda config, rep: self._bench(*args, config=config, rep=rep, **kwargs))
                 bench_end = time.time()
                 self.bench_time = bench_end - bench_start
-                self.cache[key] = builtins.min(timings, key=timings.get)
+                self.cache[key] = best
                 self.hook(args)
+                # the modules of the configs that lost are not kept on the device
+                if self.fn is not None:
+                    kept = binaries.get(best)
+                    self.fn.unload([bin for bin in binaries.values() if bin is not kept])
                 self.configs_timings = timings
+                if store is not None and timings[best] < float('inf'):
+                    self._save(store, key, args, best, timings[best])
             config = self.cache[key]
         else:
             config = self.configs[0]
@@ -1034,27 +1664,56 @@ class Autotuner:
         return self.kernel(*args, num_warps=config.num_warps, num_stages=config.num_stages, **kwargs, **config.kwargs)
 
 
+def _stamp(path):
+    # identity of a file, which changes whenever the file is rewritten or replaced
+    st = os.stat(path)
+    return [path, st.st_ino, st.st_size, st.st_mtime_ns]
+
+
 @functools.lru_cache()
 def version_key():
+    """
+    Hash of the compiler: of the frontend, of libtriton, of the language and of the version
+    of ptxas. It is kept in `TRITON_CACHE_DIR` along with the identity (inode, size and time
+    of modification) of these files, and only recomputed when one of them changes
+    """
     import pkgutil
-    contents = []
-    # frontend
-    with open(triton.code_gen.__file__, "rb") as f:
-        contents += [hashlib.md5(f.read()).hexdigest()]
-    # backend
-    with open(triton._C.libtriton.__file__, "rb") as f:
-        contents += [hashlib.md5(f.read()).hexdigest()]
-    # language
     language_path = os.path.join(*triton.__path__, 'language')
-    for lib in pkgutil.iter_modules([language_path]):
-        with open(lib.module_finder.find_spec(lib.name).origin, "rb") as f:
+    paths = [triton.code_gen.__file__, triton._C.libtriton.__file__]
+    paths += [lib.module_finder.find_spec(lib.name).origin for lib in pkgutil.iter_modules([language_path])]
+    ptxas = shutil.which('ptxas')
+    stamps = [_stamp(path) for path in paths] + ([_stamp(ptxas)] if ptxas else [])
+    cache_dir = os.environ.get('TRITON_CACHE_DIR', '/tmp/triton/')
+    memo = os.path.join(cache_dir, 'version_key.json') if cache_dir else None
+    if memo is not None:
+        try:
+            with open(memo) as f:
+                record = json.load(f)
+            if record['stamps'] == stamps:
+                return record['key']
+        except (OSError, ValueError, KeyError):
+            pass
+    contents = []
+    for path in paths:
+        with open(path, "rb") as f:
             contents += [hashlib.md5(f.read()).hexdigest()]
     # ptxas version
     try:
-        ptxas_version = hashlib.md5(subprocess.check_output(["ptxas", "--version"])).hexdigest()
+        ptxas_version = hashlib.md5(subprocess.check_output([ptxas, "--version"])).hexdigest()
     except Exception:
         ptxas_version = ''
-    return '-'.join(triton.__version__) + '-' + ptxas_version + '-' + '-'.join(contents)
+    key = '-'.join(triton.__version__) + '-' + ptxas_version + '-' + '-'.join(contents)
+    if memo is not None:
+        # written atomically, as processes that start together may all miss
+        try:
+            os.makedirs(cache_dir, exist_ok=True)
+            tmp = f'{memo}.{os.getpid()}.tmp'
+            with open(tmp, 'w') as f:
+                json.dump({'stamps': stamps, 'key': key}, f)
+            os.replace(tmp, memo)
+        except OSError:
+            pass
+    return key
 
 
 class DependenciesFinder(ast.NodeVisitor):
@@ -1065,7 +1724,11 @@ class DependenciesFinder(ast.NodeVisitor):
         self.globals = globals
 
     def visit_Name(self, node):
-        return self.globals.get(node.id, None)
+        ret = self.globals.get(node.id, None)
+        # global tuples may be compiled in, e.g., as constant tables
+        if isinstance(ret, tuple):
+            self.ret = hashlib.md5((self.ret + repr(ret)).encode("utf-8")).hexdigest()
+        return ret
 
     def visit_Attribute(self, node):
         lhs = self.visit(node.value)
@@ -1084,20 +1747,30 @@ class DependenciesFinder(ast.NodeVisitor):
         if func.__module__ and func.__module__.startswith('triton.'):
             return
         assert isinstance(func, triton.JITFunction)
-        if func.hash is None:
-            tree = ast.parse(func.src)
-            finder = DependenciesFinder(func.__globals__, func.src)
-            finder.visit(tree)
-            func.hash = finder.ret
-        self.ret = (self.ret + func.hash).encode("utf-8")
+        self.ret = (self.ret + func.dependencies_hash).encode("utf-8")
         self.ret = hashlib.md5(self.ret).hexdigest()
 
 
+def _cache_limit(name):
+    value = os.environ.get(name)
+    return int(value) if value else None
+
+
 class JITFunction:
 
     cache_hook = None
 
-    def __init__(self, fn, version=None, inline=True, do_not_specialize=None):
+    # kernels whose binaries `cache_report` lists and `set_cache_limits` caps
+    instances = weakref.WeakSet()
+    # caps on the binaries held by all the kernels of the process (None for no cap), beyond
+    # which the least recently launched ones are unloaded and dropped from their caches
+    cache_limits = dict(max_binaries=_cache_limit('TRITON_MAX_BINARIES'),
+                        max_host_bytes=_cache_limit('TRITON_MAX_BINARY_HOST_BYTES'),
+                        max_device_bytes=_cache_limit('TRITON_MAX_BINARY_DEVICE_BYTES'))
+    evict_lock = threading.RLock()
+
+    def __init__(self, fn, version=None, inline=True, do_not_specialize=None, strides=None, schedule=True,
+                 async_compile=False, llvm_opt=None, fast_math=False, raster=None, persistent=False):
         # information of wrapped function
         self.fn = fn
         self.module = fn.__module__
@@ -1108,11 +1781,42 @@ class JITFunction:
         self.version = version
         self.inline = inline
         self.src = textwrap.dedent(inspect.getsource(fn))
+        # location of the `def` of the function, for the line information of kernels
+        self.src_file = inspect.getsourcefile(fn)
+        self.line_offset = inspect.getsourcelines(fn)[1] - 1 + self.src[:self.src.find("def")].count('\n')
         self.src = self.src[self.src.find("def"):]
         self.do_not_specialize = [] if do_not_specialize is None else do_not_specialize
         self.do_not_specialize = [self.arg_names.index(arg) if isinstance(arg, str) else arg for arg in self.do_not_specialize]
+        # strides only need to be known to be 1 (contiguous) or multiples of 16 (aligned rows)
+        self.strides = [] if strides is None else strides
+        self.strides = [self.arg_names.index(arg) if isinstance(arg, str) else arg for arg in self.strides]
+        # whether the compiler may reorder instructions to reduce register pressure
+        self.schedule = schedule
+        # whether new specializations are compiled in the background
+        self.async_compile = async_compile or os.environ.get('TRITON_ASYNC_COMPILE', '0') == '1'
+        # LLVM pipeline run before code generation (e.g. "fast", "O3")
+        self.llvm_opt = llvm_opt
+        # whether math functions use the approximate, flush-to-zero forms of the target
+        self.fast_math = fast_math
+        # order in which program ids are assigned to the programs of the grid
+        if raster not in (None, 'grouped'):
+            raise ValueError(f"unknown raster order {raster!r} (expected None or 'grouped')")
+        self.raster = raster
+        # whether programs loop over the tiles of the grid (see `triton.jit`)
+        self.persistent = persistent
+        # keys being compiled in the background, and (key, binary, device, placeholder)
+        # tuples of the binaries compiled but not loaded yet
+        self.compiling = set()
+        self.compiled = []
+        self.compiled_lock = threading.Lock()
         # cache for callable driver objects (e.g. CUkernel)
         self.bin_cache = dict()
+        # index of `bin_cache` by argument signature, used by the launcher
+        self.launch_cache = _triton.runtime.launch_cache()
+        # bitcode of the Triton-IR generated for each signature and set of constants,
+        # shared by the configurations (num_warps, num_stages) compiled from it
+        self.ttir_cache = dict()
+        self.ttir_lock = threading.Lock()
         self.hash = None
         # JITFunction can be instantiated as kernel
         # when called with a grid using __getitem__
@@ -1128,17 +1832,34 @@ class JITFunction:
         self.__name__ = fn.__name__
         self.__globals__ = fn.__globals__
         self.__module__ = fn.__module__
+        JITFunction.instances.add(self)
 
     @property
-    @functools.lru_cache()
-    def cache_key(self):
-        # TODO : hash should be attribute of `self`
+    def dependencies_hash(self):
+        # hash of the source of the function and of the functions it calls, computed once
+        # per function, including when it is only called by other kernels
         if self.hash is None:
             dependencies_finder = DependenciesFinder(globals=self.__globals__, src=self.src)
             dependencies_finder.visit(self.parse())
-            self.hash = dependencies_finder.ret + version_key()
+            self.hash = dependencies_finder.ret
         return self.hash
 
+    @property
+    @functools.lru_cache()
+    def cache_key(self):
+        key = self.dependencies_hash + version_key()
+        if not self.schedule:
+            key += '-noschedule'
+        if self.llvm_opt:
+            key += '-opt' + self.llvm_opt
+        if self.fast_math:
+            key += '-fastmath'
+        if self.raster:
+            key += '-raster' + self.raster
+        if self.persistent:
+            key += '-persistent'
+        return key
+
     # we do not parse `src` in the constructor because
     # the user might want to monkey-patch self.src dynamically.
     # Some unit tests do this, for example.
@@ -1162,6 +1883,7 @@ class JITFunction:
         super(JITFunction, self).__setattr__(name, value)
         if name == 'src':
             self.hash = None
+            self.ttir_cache = dict()
             JITFunction.cache_key.fget.cache_clear()
 
     def _init_kernel(self):
@@ -1175,26 +1897,13 @@ class JITFunction:
         return self._warmup(**compile, is_manual_warmup=True)
 
     def _warmup(self, key, arg_types, device, attributes, constants, num_warps, num_stages, is_manual_warmup):
-        hashed_key = hashlib.md5(key.encode("utf-8")).hexdigest()
-
-        # create cache directory
+        # persistent cache
         cache_dir = os.environ.get('TRITON_CACHE_DIR', '/tmp/triton/')
-        if cache_dir:
-            os.makedirs(cache_dir, exist_ok=True)
-
-        if cache_dir:
-            bin_cache_path = os.path.join(cache_dir, hashed_key)
-            bin_lock_path = bin_cache_path + ".lock"
-        else:
-            bin_cache_path = None
-            bin_lock_path = None
+        store = CacheStore.get(cache_dir) if cache_dir else None
 
         binary = None
-        if bin_cache_path and os.path.exists(bin_cache_path):
-            assert bin_lock_path is not None
-            with FileLock(bin_lock_path):
-                with open(bin_cache_path, 'rb') as f:
-                    binary = pickle.load(f)["binary"]
+        if store is not None:
+            binary = store.get_binary(key)
 
         compile = dict(arg_types=arg_types, device=device, attributes=attributes, constants=constants, num_warps=num_warps, num_stages=num_stages)
         if JITFunction.cache_hook is not None:
@@ -1213,29 +1922,243 @@ class JITFunction:
                 return True
 
         if binary is None:
-            binary = self._compile(**compile)
-
-        if bin_cache_path:
-            assert bin_lock_path is not None
-            with FileLock(bin_lock_path):
-                with open(bin_cache_path + ".tmp", "wb") as f:
-                    pickle.dump({"binary": binary, "key": key}, f)
-                os.rename(bin_cache_path + ".tmp", bin_cache_path)
+            if CompileBatch.active() is not None:
+                CompileBatch.active().add(self, key, compile, store)
+                return True
+            if self.async_compile and not is_manual_warmup and self._compile_async(key, compile, store):
+                return False
+            binary = self._compile_once(key, compile, store)
 
-        self.bin_cache[key] = LoadedBinary(device, binary)
+        # the binary is in the persistent cache already
+        self._add_to_cache(key, binary, device, None)
         return False
 
-    def _compile(self, arg_types, device, attributes, constants, num_warps, num_stages):
+    def _compile_once(self, key, compile, store):
+        # processes that share the persistent cache (e.g., the ranks of a node) compile each
+        # kernel once per architecture: the others wait for it and load it from the cache
+        if store is None:
+            return self._compile_or_downgrade(key, **compile)
+        with store.compile_lock(key):
+            binary = store.get_binary(key)
+            if binary is None:
+                binary = self._compile_or_downgrade(key, **compile)
+                store.put_binary(key, binary)
+        return binary
+
+    def _add_to_cache(self, key, binary, device, store, module=None):
+        if store is not None:
+            store.put_binary(key, binary)
+
+        self.bin_cache[key] = LoadedBinary(device, binary, module)
+        JITFunction.enforce_cache_limits(keep=self.bin_cache[key])
+
+    # memory footprint
+
+    def cache_entries(self):
+        """
+        Returns a dict per binary in the cache of this kernel, with its key, the devices
+        it is loaded on, the bytes of host and device memory it holds, and the
+        `time.monotonic()` of its last launch
+        """
+        entries = []
+        for key, binary in list(self.bin_cache.items()):
+            last_use = builtins.max(binary.last_use, self.launch_cache.last_use(binary))
+            entries.append(dict(kernel=self.__name__, key=key, devices=sorted(binary.modules),
+                                host_bytes=binary.host_bytes(), device_bytes=binary.device_bytes(),
+                                last_use=last_use))
+        return entries
+
+    def evict(self, key):
+        """
+        Drops the binary of `key` from the cache of this kernel and unloads it from its
+        devices; it is compiled (or read from the persistent cache) again on its next launch
+        """
+        self.unload([self.bin_cache.pop(key)])
+
+    @staticmethod
+    def enforce_cache_limits(keep=None):
+        # evicts the least recently launched binaries of all kernels until those left fit in
+        # `cache_limits`. `keep` (the binary just added), traced binaries, and the binaries
+        # being compiled in the background and the generic ones they launch meanwhile
+        # (which share their modules) are never evicted
+        limits = JITFunction.cache_limits
+        if all(limit is None for limit in limits.values()):
+            return
+        with JITFunction.evict_lock:
+            entries = [(fn, entry) for fn in list(JITFunction.instances) for entry in fn.cache_entries()]
+            entries.sort(key=lambda e: e[1]['last_use'])
+            n_binaries = len(entries)
+            host_bytes = sum(entry['host_bytes'] for _, entry in entries)
+            device_bytes = sum(entry['device_bytes'] for _, entry in entries)
+
+            def over():
+                return (limits['max_binaries'] is not None and n_binaries > limits['max_binaries']) or \
+                       (limits['max_host_bytes'] is not None and host_bytes > limits['max_host_bytes']) or \
+                       (limits['max_device_bytes'] is not None and device_bytes > limits['max_device_bytes'])
+            for fn, entry in entries:
+                if not over():
+                    break
+                binary = fn.bin_cache.get(entry['key'])
+                if binary is None or binary is keep or binary in LoadedBinary.traced or entry['key'] in fn.compiling or \
+                   any(other is not binary and other.modules is binary.modules for other in fn.bin_cache.values()):
+                    continue
+                fn.evict(entry['key'])
+                n_binaries -= 1
+                host_bytes -= entry['host_bytes']
+                device_bytes -= entry['device_bytes']
+
+    # background compilation
+
+    compile_pool = None
+
+    @staticmethod
+    def _generic_key(key):
+        # key of the specialization that assumes nothing of the divisibility and aliasing
+        # of the arguments, so that it can run any call that shares their types and constants
+        return re.sub(r'\[multipleof\(\d+\)\]|\[noalias\]', '', key)
+
+    def _compile_async(self, key, compile, store):
+        # launches a generic binary while the specialization for `key` is compiled in the
+        # background. Returns False if there is none, in which case `key` is compiled by the
+        # caller and the generic binary in the background, for the next specializations
+        generic_key = JITFunction._generic_key(key)
+        generic_compile = dict(compile, attributes=dict())
+        generic = self.bin_cache.get(generic_key)
+        if generic is None and generic_key != key and store is not None:
+            binary = store.get_binary(generic_key)
+            if binary is not None:
+                generic = self.bin_cache[generic_key] = LoadedBinary(compile['device'], binary)
+        if generic is None or generic_key == key:
+            if generic_key != key:
+                self._submit(generic_key, generic_compile, store, None)
+            return False
+        # the launch index is later pointed from this placeholder to the new binary
+        placeholder = copy.copy(generic)
+        self.bin_cache[key] = placeholder
+        self._submit(key, compile, store, placeholder)
+        return True
+
+    def _submit(self, key, compile, store, placeholder):
+        if key in self.compiling:
+            return
+        self.compiling.add(key)
+        if JITFunction.compile_pool is None:
+            num_threads = int(os.environ.get('TRITON_ASYNC_COMPILE_THREADS', builtins.min(4, os.cpu_count())))
+            JITFunction.compile_pool = concurrent.futures.ThreadPoolExecutor(num_threads, thread_name_prefix='triton-compile')
+
+        def run():
+            try:
+                binary = self._compile_or_downgrade(key, **compile)
+            except (OutOfResources, CompilationError) as e:
+                # the generic binary keeps being launched
+                warnings.warn(f"background compilation of {self.__name__} failed: {e}")
+                return
+            if store is not None:
+                store.put_binary(key, binary)
+            with self.compiled_lock:
+                self.compiled.append((key, binary, compile['device'], placeholder))
+        JITFunction.compile_pool.submit(run)
+
+    def _swap_compiled(self, device):
+        # loads the binaries compiled in the background for `device`, and swaps them
+        # for their placeholders. This runs on the launching thread, so launches
+        # see either binary, and never a partially updated one
+        with self.compiled_lock:
+            ready = [c for c in self.compiled if c[2] == device]
+            self.compiled = [c for c in self.compiled if c[2] != device]
+        for key, binary, device, placeholder in ready:
+            loaded = LoadedBinary(device, binary)
+            self.bin_cache[key] = loaded
+            if placeholder is not None:
+                self.launch_cache.erase(placeholder)
+            self.compiling.discard(key)
+
+    # (fn, key, device) -> (num_stages, shared_padding) of the
+    # configurations downgraded to fit in the shared memory of their device
+    downgrades = dict()
+
+    def _compile(self, arg_types, device, attributes, constants, num_warps, num_stages, shared_padding=True):
+        refs, module = self._get_ttir(arg_types, attributes, constants)
+        backend = _backend(device)
+        if self.persistent and backend != _triton.runtime.backend.CUDA:
+            raise RuntimeError(f"{self.__name__}: persistent kernels are only supported on CUDA devices")
+        module.set_shared_padding(shared_padding)
+        # programs are grouped by waves of one program per SM
+        module.set_raster(max(0, _triton.runtime.num_sm(backend, device)) if self.raster else 0)
+        result = compile_server.compile_ttir(backend, module, device, num_warps, num_stages)
+        if result is None:
+            result = _triton.code_gen.compile_ttir(backend, module, device, num_warps, num_stages)
+        name, asm, shared_mem, ptxas_info = result
+        return self._make_binary(backend, name, asm, shared_mem, device, num_warps, ptxas_info)
+
+    def _compile_or_downgrade(self, key, arg_types, device, attributes, constants, num_warps, num_stages):
+        # with TRITON_DOWNGRADE_ON_OOR=1, configurations that do not fit in the shared memory
+        # of the device are compiled again with fewer pipeline stages, then also without
+        # padding the shared memory of layout conversions, until they fit
+        compile = dict(arg_types=arg_types, device=device, attributes=attributes, constants=constants,
+                       num_warps=num_warps)
+        downgrade_key = (self, key, device)
+        if downgrade_key in JITFunction.downgrades:
+            stages, padding = JITFunction.downgrades[downgrade_key]
+            return self._compile(**compile, num_stages=stages, shared_padding=padding)
+        try:
+            return self._compile(**compile, num_stages=num_stages)
+        except OutOfResources as e:
+            if os.environ.get('TRITON_DOWNGRADE_ON_OOR', '0') != '1' or e.name != "shared memory":
+                raise
+            error = e
+        candidates = [(stages, True) for stages in range(num_stages - 1, 0, -1)]
+        candidates += [(stages, False) for stages in range(num_stages, 0, -1)]
+        for stages, padding in candidates:
+            try:
+                binary = self._compile(**compile, num_stages=stages, shared_padding=padding)
+            except OutOfResources:
+                continue
+            JITFunction.downgrades[downgrade_key] = (stages, padding)
+            warnings.warn(f"{self.__name__} (num_warps={num_warps}, num_stages={num_stages}) needs "
+                          f"{error.required} bytes of shared memory, but device {device} has {error.limit}: "
+                          f"compiled with num_stages={stages}" + ("" if padding else " and no shared memory padding"))
+            return binary
+        raise error
+
+    def _get_ttir(self, arg_types, attributes, constants):
+        # the front-end only runs once per signature: compilation modifies modules in
+        # place, so the others get a copy of its output, read back from bitcode
+        key = lambda x: x.__name__ if isinstance(x, JITFunction) else (type(x).__name__, repr(x))
+        ttir_key = (tuple(arg_types), tuple(sorted((str(i), repr(attr)) for i, attr in attributes.items())),
+                    tuple((i, key(constants[i])) for i in sorted(constants)))
+        with self.ttir_lock:
+            bitcode = self.ttir_cache.get(ttir_key)
+        # modules only live as long as their context and builder, which are returned with them
+        if bitcode is None:
+            context, generator = self._generate_ttir(arg_types, attributes, constants)
+            with self.ttir_lock:
+                self.ttir_cache[ttir_key] = generator.module.bitcode()
+            return (context, generator), generator.module
+        context = _triton.ir.context()
+        builder = _triton.ir.builder(context)
+        return (context, builder), _triton.ir.read_bitcode(bitcode, builder)
+
+    def _generate_ttir(self, arg_types, attributes, constants):
         # create IR module
         context = _triton.ir.context()
         # get just-in-time proto-type of kernel
         arg_types = [Kernel._to_triton_ir(arg) for arg in arg_types]
+        # persistent kernels also take their tile counter and the
+        # sizes of their grid, which the launcher appends
+        if self.persistent:
+            arg_types += [triton.language.pointer_type(triton.language.int32, 1)] + [triton.language.int32] * 3
+        # horizontally fused kernels read their arguments from a table of launches (see `Kernel.launch_fused`)
+        horizontal = attributes.get('horizontal', False)
+        if horizontal:
+            arg_types += [triton.language.pointer_type(triton.language.int32, 1)]
         ret_type = triton.language.void
         prototype = triton.language.function_type(ret_type, arg_types)
         # generate Triton-IR
         # export symbols visible from self into code-generator object
         gscope = self.__globals__
-        generator = CodeGenerator(context, prototype, gscope=gscope, attributes=attributes, constants=constants, is_kernel=True)
+        generator = CodeGenerator(context, prototype, gscope=gscope, attributes=attributes, constants=constants, is_kernel=True,
+                                  schedule=self.schedule, src_file=self.src_file, line_offset=self.line_offset)
         try:
             generator.visit(self.parse())
         except Exception as e:
@@ -1243,20 +2166,78 @@ class JITFunction:
             if node is None or isinstance(e, (NotImplementedError, CompilationError)):
                 raise e
             raise CompilationError(self.src, node) from e
-        # Compile to machine code
-        if torch.version.hip is None:
-            backend = _triton.runtime.backend.CUDA
-        else:
-            backend = _triton.runtime.backend.ROCM
-        name, asm, shared_mem = _triton.code_gen.compile_ttir(backend, generator.module, device, num_warps, num_stages)
+        if self.llvm_opt:
+            generator.module.set_llvm_opt(self.llvm_opt)
+        generator.module.set_fast_math(self.fast_math)
+        generator.module.set_persistent(self.persistent)
+        generator.module.set_horizontal(horizontal)
+        # the module only lives as long as its context
+        return context, generator
+
+    def _make_binary(self, backend, name, asm, shared_mem, device, num_warps, ptxas_info=None):
         max_shared_memory = _triton.runtime.max_shared_memory(backend, device)
         if shared_mem > max_shared_memory:
             raise OutOfResources(shared_mem, max_shared_memory, "shared memory")
-        return Binary(backend, name, asm, shared_mem, num_warps)
+        num_threads = num_warps * 32
+        if _warp_specialized(backend, _triton.runtime.cc(backend, device)):
+            num_threads *= 2
+        carveout = JITFunction._carveout(backend, device, shared_mem, num_threads, ptxas_info or dict())
+        return Binary(backend, name, asm, shared_mem, num_warps, ptxas_info, num_threads, carveout,
+                      dict.get(asm, 'tensor_maps', ''))
+
+    @staticmethod
+    def _carveout(backend, device, shared_mem, num_threads, ptxas_info):
+        # the shared memory needed by as many blocks as threads and registers let reside
+        # on a multiprocessor, as a percentage of its L1/shared memory: the rest is L1
+        sm = _triton.runtime.sm_resources(backend, device)
+        if not sm:
+            return -1
+        blocks = builtins.min(sm['blocks'], sm['threads'] // num_threads)
+        n_regs = ptxas_info.get('n_regs', 0)
+        if n_regs:
+            # registers are allocated to warps in units of 256
+            regs_per_warp = (n_regs * 32 + 255) // 256 * 256
+            blocks = builtins.min(blocks, sm['registers'] // (regs_per_warp * (num_threads // 32)))
+        blocks = builtins.max(blocks, 1)
+        needed = blocks * (shared_mem + sm['reserved_shared_per_block']) if shared_mem else 0
+        return builtins.min(100, (100 * needed + sm['shared'] - 1) // sm['shared'])
+
+    def unload(self, binaries):
+        """
+        Unloads `binaries` of this kernel from their devices (e.g., the configs the
+        autotuner did not pick). They are loaded again if they are launched later, but
+        launch graphs captured with them must not be replayed anymore
+        """
+        for binary in binaries:
+            # traced binaries keep the globals of their module
+            if binary in LoadedBinary.traced:
+                continue
+            self.launch_cache.erase(binary)
+            binary.unload()
 
     def __getitem__(self, grid):
         return Launcher(self._init_kernel(), grid)
 
+    def launch_many(self, arg_lists, grids, stream=None, num_warps=4, num_stages=2):
+        """
+        Launches the kernel once per list of arguments in `arg_lists`, on the grid of the
+        same index in `grids` (see `Kernel.launch_many`)
+        """
+        kernel = self._init_kernel()
+        if not isinstance(kernel, Kernel):
+            raise TypeError("launch_many does not support autotuned kernels, or kernels with heuristics")
+        return kernel.launch_many(arg_lists, grids, stream=stream, num_warps=num_warps, num_stages=num_stages)
+
+    def launch_fused(self, arg_lists, grids, num_warps=4, num_stages=2):
+        """
+        Runs the launches of the kernel with the lists of arguments in `arg_lists`, on the grids
+        of the same index in `grids`, as a single launch (see `Kernel.launch_fused`)
+        """
+        kernel = self._init_kernel()
+        if not isinstance(kernel, Kernel):
+            raise TypeError("launch_fused does not support autotuned kernels, or kernels with heuristics")
+        return kernel.launch_fused(arg_lists, grids, num_warps=num_warps, num_stages=num_stages)
+
     def __repr__(self):
         return f"JITFunction({self.module}:{self.fn.__name__})"
 
@@ -1293,7 +2274,7 @@ class Config:
         return ', '.join(res)
 
 
-def autotune(configs, key, prune_configs_by=None, reset_to_zero=None):
+def autotune(configs, key, prune_configs_by=None, reset_to_zero=None, search=None):
     """
     Decorator for auto-tuning a :code:`triton.jit`'d function.
 
@@ -1324,12 +2305,24 @@ def autotune(configs, key, prune_configs_by=None, reset_to_zero=None):
         'perf_model': performance model used to predicate running time with different configs, returns running time
         'top_k': number of configs to bench
         'early_config_prune'(optional): a function used to do early prune (eg, num_stages). It take configs:List[Config] as its input, and returns pruned configs.
+        'resource_config_prune'(optional): a function used to prune compiled configs before benchmarking them. It takes
+            configs:List[Config] and binaries:Dict[Config, LoadedBinary] as its input, and returns pruned configs.
+            By default, configs that spill registers or cannot be launched are dropped.
     :param reset_to_zero: a list of argument names whose value will be reset to zero before evaluating any configs.
     :type reset_to_zero: list[str]
+    :param search: how the configs (left by :code:`prune_configs_by`) are benchmarked: :code:`'exhaustive'` (the
+        default) runs each of them for 100 ms, :code:`'halving'` runs all of them briefly and gives the fastest
+        ones a growing budget, and :code:`'model'` samples a subset guided by a Gaussian process fitted to the
+        timings so far. Configs that fail to compile or run out of resources are dropped. See :code:`triton.search`.
+    :type search: str or callable, optional
+
+    :note: The configs picked for each key are stored in :code:`TRITON_CACHE_DIR` along with the compiled
+           binaries, and reused by later processes on devices of the same kind. They can be moved between
+           machines with :code:`triton.cache.TuningStore.get(cache_dir).export(path)` and :code:`.import_(path)`.
     """
     def decorator(fn):
         def wrapper(kernel):
-            return Autotuner(kernel, fn.arg_names, configs, key, reset_to_zero, prune_configs_by)
+            return Autotuner(kernel, fn.arg_names, configs, key, reset_to_zero, prune_configs_by, fn=fn, search=search)
 
         fn.kernel_decorators.append(wrapper)
         return fn
@@ -1383,8 +2376,53 @@ def jit(*args, **kwargs):
            * arguments to this function,
            * other jit'd functions
 
+    :note: Calls to other jit'd functions are inlined, unless the copies of a callee would add
+           more than TRITON_INLINE_THRESHOLD (1024 by default) instructions to the kernel: its
+           calls are then compiled to calls of a device function. Call sites may force either
+           with :code:`f(x, _inline=True)` or :code:`f(x, _inline=False)`.
+
     :param fn: the function to be jit-compiled
     :type fn: Callable
+    :param strides: names or indices of integer arguments that are strides. They are
+                    specialized on being 1 and on being multiples of 16, rather than on
+                    all the powers of 2 that divide them, so that fewer kernels are compiled.
+    :type strides: list
+    :param schedule: whether instructions may be reordered to hide the latency of loads
+                     and reduce register pressure. Defaults to True.
+    :type schedule: bool
+    :param async_compile: whether new specializations are compiled in the background (also
+                          enabled by TRITON_ASYNC_COMPILE=1). Until they are ready, calls are
+                          launched with the binary compiled for the same argument types and
+                          constants without assumptions on the divisibility or aliasing of
+                          the arguments; only calls for which there is none yet compile
+                          synchronously. Defaults to False.
+    :type async_compile: bool
+    :param llvm_opt: LLVM pipeline to run on the generated LLVM-IR before code generation:
+                     "fast" (a short pipeline suited to Triton's output), "O1" to "O3", or a
+                     pipeline in the syntax of :code:`opt -passes=`. TRITON_LLVM_OPT overrides it
+                     for all kernels. The change in instruction count is reported in
+                     :code:`asm['llvm_opt']`. Defaults to None (no pipeline).
+    :type llvm_opt: str
+    :param fast_math: whether math functions use the approximate forms of the target, which
+                      flush fp32 denormals to zero: :code:`ex2.approx.ftz`, :code:`tanh.approx`,
+                      the fast paths of libdevice or ocml, and packed f16x2 instructions for fp16
+                      where they exist. Defaults to False.
+    :type fast_math: bool
+    :param raster: order of the program ids of the first two axes of the grid. With
+                   :code:`'grouped'`, programs are launched down groups of rows of the grid
+                   (see :code:`tl.swizzle2d`), chosen from the number of SMs of the device and
+                   the shape of the grid, so that the programs running at the same time work on
+                   a compact block of tiles whose inputs are reused from L2. Defaults to None
+                   (the launch order).
+    :type raster: str
+    :param persistent: whether the kernel is launched on as many programs as fit on the
+                       device at once, which loop over the tiles of the grid: each program
+                       claims the next tile from a counter in global memory when it starts
+                       the current one, and :code:`tl.program_id` and :code:`tl.num_programs`
+                       are those of its tile. Returns move on to the next tile. Launches of a
+                       persistent kernel on concurrent streams must not overlap, as they
+                       share the counter. CUDA only. Defaults to False.
+    :type persistent: bool
     """
     if args:
         assert len(args) == 1
@@ -1395,6 +2433,38 @@ def jit(*args, **kwargs):
             return JITFunction(fn, **kwargs)
         return decorator
 
+
+def cache_report():
+    """
+    Returns the memory held by the in-process caches of all jit'd kernels: a dict with the
+    list of their binaries (see :code:`JITFunction.cache_entries`) from the least to the most
+    recently launched, the totals of their host and device bytes, and the bytes of the
+    Triton-IR cached for new configurations of the kernels.
+    """
+    binaries = [entry for fn in list(JITFunction.instances) for entry in fn.cache_entries()]
+    binaries.sort(key=lambda entry: entry['last_use'])
+    ttir_bytes = sum(len(bitcode) for fn in list(JITFunction.instances) for bitcode in list(fn.ttir_cache.values())
+                     if isinstance(bitcode, bytes))
+    return dict(binaries=binaries,
+                host_bytes=sum(entry['host_bytes'] for entry in binaries),
+                device_bytes=sum(entry['device_bytes'] for entry in binaries),
+                ttir_bytes=ttir_bytes)
+
+
+def set_cache_limits(max_binaries=None, max_host_bytes=None, max_device_bytes=None):
+    """
+    Caps the binaries held by the in-process caches of all jit'd kernels (None for no cap):
+    their number, and the bytes of host memory held by their assembly and of device memory
+    held by their loaded images. The least recently launched binaries are unloaded from
+    their devices and dropped from the caches until the others fit, when the caps are set
+    and after each new binary. Evicted binaries are read again from the persistent cache
+    (or compiled) on their next launch. The caps default to TRITON_MAX_BINARIES,
+    TRITON_MAX_BINARY_HOST_BYTES and TRITON_MAX_BINARY_DEVICE_BYTES.
+    """
+    JITFunction.cache_limits = dict(max_binaries=max_binaries, max_host_bytes=max_host_bytes,
+                                    max_device_bytes=max_device_bytes)
+    JITFunction.enforce_cache_limits()
+
 ######
 
 # class ForwardDeclaration:
@@ -1438,6 +2508,13 @@ class TensorWrapper:
     def data_ptr(self):
         return self.base.data_ptr()
 
+    # offsets are in elements of the base tensor, so that the storage is the same
+    def storage_offset(self):
+        return self.base.storage_offset()
+
+    def element_size(self):
+        return self.base.element_size()
+
     def __str__(self) -> str:
         return f'TensorWrapper[{self.dtype}]({self.base})'
 
@@ -0,0 +1,172 @@
+"""
+Node-local compilation server.
+
+Processes that set `TRITON_COMPILE_SERVER` (to `1`, or to the path of a Unix socket)
+send the Triton-IR of the CUDA kernels they compile, as bitcode, to a server shared by
+all the processes of the node, which is started by the first of them and exits once it
+has been idle for `TRITON_COMPILE_SERVER_IDLE` seconds (10 minutes by default).
+Identical requests of several clients are compiled once, and compilations run on a
+pool of `TRITON_COMPILE_SERVER_THREADS` threads (all the cores by default), rather than
+on the cores of each process.
+
+Processes compile their kernels themselves whenever the server cannot be reached, and
+when they set `TRITON_LLVM_OPT`, `TRITON_INLINE_THRESHOLD`, `TRITON_PASS_STATS` or
+`TRITON_TRACE`, which the server would not see.
+"""
+from __future__ import annotations
+
+import concurrent.futures
+import hashlib
+import os
+import subprocess
+import sys
+import threading
+import time
+import warnings
+from multiprocessing.connection import Client, Listener
+
+from filelock import FileLock
+
+import triton._C.libtriton.triton as _triton
+
+_AUTHKEY = b'triton-compile-server'
+
+
+def _address():
+    address = os.environ.get('TRITON_COMPILE_SERVER', '')
+    if address in ('', '0'):
+        return None
+    if address == '1':
+        address = f'/tmp/triton-compile-{os.getuid()}.sock'
+    return address
+
+
+class Server:
+
+    def __init__(self, address, num_threads, idle_timeout):
+        self.address = address
+        self.idle_timeout = idle_timeout
+        self.pool = concurrent.futures.ThreadPoolExecutor(num_threads, thread_name_prefix='triton-compile')
+        # requests being compiled, by digest: duplicates wait for the first one
+        self.in_flight = dict()
+        self.lock = threading.Lock()
+        self.n_clients = 0
+        self.last_active = time.monotonic()
+
+    def _compile(self, request):
+        bitcode, backend, cc, num_warps, num_stages = request
+        context = _triton.ir.context()
+        module = _triton.ir.read_bitcode(bitcode, _triton.ir.builder(context))
+        backend = _triton.runtime.backend(backend)
+        return _triton.code_gen.compile_ttir(backend, module, 0, num_warps, num_stages, cc=cc)
+
+    def compile(self, request):
+        digest = hashlib.sha256(request[0] + repr(request[1:]).encode('utf-8')).digest()
+        with self.lock:
+            future = self.in_flight.get(digest)
+            if future is None:
+                future = self.in_flight[digest] = self.pool.submit(self._compile, request)
+                future.add_done_callback(lambda _: self._done(digest))
+        return future.result()
+
+    def _done(self, digest):
+        with self.lock:
+            del self.in_flight[digest]
+
+    def _serve_client(self, conn):
+        try:
+            while True:
+                try:
+                    request = conn.recv()
+                except EOFError:
+                    return
+                try:
+                    conn.send(('ok', self.compile(request)))
+                except Exception as e:
+                    conn.send(('error', str(e)))
+        finally:
+            conn.close()
+            with self.lock:
+                self.n_clients -= 1
+                self.last_active = time.monotonic()
+
+    def _exit_when_idle(self):
+        while True:
+            time.sleep(min(self.idle_timeout, 10))
+            with self.lock:
+                if self.n_clients == 0 and time.monotonic() - self.last_active > self.idle_timeout:
+                    break
+        os.unlink(self.address)
+        os._exit(0)
+
+    def serve(self):
+        if os.path.exists(self.address):
+            os.unlink(self.address)
+        listener = Listener(self.address, family='AF_UNIX', authkey=_AUTHKEY)
+        threading.Thread(target=self._exit_when_idle, daemon=True).start()
+        while True:
+            conn = listener.accept()
+            with self.lock:
+                self.n_clients += 1
+            threading.Thread(target=self._serve_client, args=(conn,), daemon=True).start()
+
+
+# each thread has its own connection, so that the compilations of a process run concurrently
+_local = threading.local()
+_disabled = False
+
+
+def _connect(address):
+    try:
+        return Client(address, family='AF_UNIX', authkey=_AUTHKEY)
+    except (FileNotFoundError, ConnectionRefusedError):
+        pass
+    # the first process to get here starts the server, and the others wait for it
+    with FileLock(address + '.lock'):
+        try:
+            return Client(address, family='AF_UNIX', authkey=_AUTHKEY)
+        except (FileNotFoundError, ConnectionRefusedError):
+            pass
+        subprocess.Popen([sys.executable, '-m', 'triton.compile_server', address],
+                         stdin=subprocess.DEVNULL, start_new_session=True)
+        for _ in range(100):
+            time.sleep(0.1)
+            try:
+                return Client(address, family='AF_UNIX', authkey=_AUTHKEY)
+            except (FileNotFoundError, ConnectionRefusedError):
+                pass
+    raise ConnectionError(f"could not start a compilation server at {address}")
+
+
+def compile_ttir(backend, module, device, num_warps, num_stages):
+    """
+    Compiles `module` on the compilation server, and returns what
+    `_triton.code_gen.compile_ttir` would, or None if it should be compiled in-process
+    """
+    global _disabled
+    address = _address()
+    if address is None or _disabled or backend != _triton.runtime.backend.CUDA:
+        return None
+    if any(os.environ.get(name) for name in ('TRITON_LLVM_OPT', 'TRITON_INLINE_THRESHOLD', 'TRITON_PASS_STATS',
+                                              'TRITON_TRACE')):
+        return None
+    request = (module.bitcode(), int(backend), _triton.runtime.cc(backend, device), num_warps, num_stages)
+    try:
+        if getattr(_local, 'conn', None) is None:
+            _local.conn = _connect(address)
+        _local.conn.send(request)
+        status, result = _local.conn.recv()
+    except (OSError, EOFError) as e:
+        warnings.warn(f"compilation server unavailable, compiling in-process: {e}")
+        _local.conn = None
+        _disabled = True
+        return None
+    if status == 'error':
+        raise RuntimeError(result)
+    return result
+
+
+if __name__ == '__main__':
+    num_threads = int(os.environ.get('TRITON_COMPILE_SERVER_THREADS', os.cpu_count()))
+    idle_timeout = float(os.environ.get('TRITON_COMPILE_SERVER_IDLE', 600))
+    Server(sys.argv[1], num_threads, idle_timeout).serve()
@@ -209,9 +209,11 @@ class pointer_type(dtype):
         self.name = self.__str__()
 
     def to_ir(self, builder: ir.builder) -> ir.pointer_type:
-        return ir.type.make_ptr(self.element_ty.to_ir(builder), 1)
+        return ir.type.make_ptr(self.element_ty.to_ir(builder), self.address_space)
 
     def __str__(self):
+        if self.address_space != 1:
+            return f'pointer<{self.element_ty}, {self.address_space}>'
         return f'pointer<{self.element_ty}>'
 
     def __repr__(self):
@@ -673,6 +675,31 @@ def arange(start, end, _builder=None):
     return semantic.arange(start, end, _builder)
 
 
+@builtin
+def constant_table(values, dtype, _builder=None):
+    """
+    Returns a pointer to a read-only table that holds :code:`values`, converted to :code:`dtype`.
+
+    On NVIDIA GPUs, the table is placed in constant memory, which the driver initializes when it
+    loads the kernel. Its loads go through the constant cache rather than L1 and L2: they are
+    fastest when the threads of a warp read the same element, as in :code:`tl.load(T + i)` for a
+    scalar :code:`i`. Tables of the same contents are shared by the functions of a kernel, and all
+    the tables of a kernel must fit in 64KB.
+
+    :param values: Elements of the table, known at compile time, e.g., a :code:`constexpr`
+        tuple or a global tuple of the module of the kernel
+    :type values: tuple of ints or floats
+    :param dtype: Data-type of the elements, e.g., :code:`tl.float32`
+    :type dtype: DType
+    """
+    values = _constexpr_to_value(values)
+    if not isinstance(values, (tuple, list)):
+        raise TypeError(f"values of a constant table must be a tuple, got {type(values).__name__}")
+    values = [_constexpr_to_value(v) for v in values]
+    dtype = _constexpr_to_value(dtype)
+    return semantic.constant_table(values, dtype, _builder)
+
+
 @builtin
 def zeros(shape, dtype, _builder=None):
     """
@@ -758,7 +785,7 @@ def reshape(input, shape, _builder=None):
 
 
 @builtin
-def dot(input, other, allow_tf32=True, _builder=None):
+def dot(input, other, allow_tf32=True, precision=None, acc_dtype=None, _builder=None):
     """
     Returns the matrix product of two blocks.
 
@@ -768,9 +795,39 @@ def dot(input, other, allow_tf32=True, _builder=None):
     :type input: 2D tensor of scalar-type in {:code:`float16`, :code:`bfloat16`, :code:`float32`}
     :param other: The second tensor to be multiplied.
     :type other: 2D tensor of scalar-type in {:code:`float16`, :code:`bfloat16`, :code:`float32`}
+    :param precision: :code:`"3xtf32"` recovers near-fp32 accuracy for :code:`float32` blocks by
+        splitting them into tf32 parts and remainders, multiplied with three tf32 tensor-core operations.
+    :param acc_dtype: The type of the result, in which products are accumulated: :code:`float32` (default,
+        or :code:`int32` for integer blocks), or :code:`float16` for :code:`float16` blocks, which halves the
+        registers of the accumulators at the cost of precision. With the tensor cores of GPUs with sm < 80,
+        :code:`float16` accumulators are only rounded to :code:`float16` between dots.
     """
     allow_tf32 = _constexpr_to_value(allow_tf32)
-    return semantic.dot(input, other, allow_tf32, _builder)
+    precision = _constexpr_to_value(precision)
+    acc_dtype = _constexpr_to_value(acc_dtype)
+    return semantic.dot(input, other, allow_tf32, _builder, precision=precision, acc_dtype=acc_dtype)
+
+
+@builtin
+def sparse_dot(input, meta, other, _builder=None):
+    """
+    Returns the matrix product of a block with 2:4 structured sparsity and a dense block,
+    computed by sparse tensor cores (NVIDIA GPUs with sm >= 80), in float32.
+
+    Every group of four consecutive elements of a row of the sparse block holds at most two
+    non-zeros, which :code:`input` stores in order, so that it has half of the columns of
+    the sparse block. Element :code:`(m, j)` of :code:`meta` gives the positions of the values
+    of row :code:`m` in columns :code:`32 j` to :code:`32 j + 31`: bits :code:`4 g` to
+    :code:`4 g + 3` hold the two 2-bit positions, in increasing order, in group :code:`g`.
+    :code:`triton.ops.compress_2_4` computes both from a dense matrix.
+
+    :param input: The compressed sparse block, of shape (M, K / 2).
+    :type input: 2D tensor of scalar-type in {:code:`float16`, :code:`bfloat16`}
+    :param meta: The positions of the values of :code:`input`, of shape (M, K / 32).
+    :type meta: 2D tensor of :code:`int32`
+    :param other: The dense block, of shape (K, N), with the scalar-type of :code:`input`.
+    """
+    return semantic.sparse_dot(input, meta, other, _builder)
 
 
 # -----------------------
@@ -807,6 +864,42 @@ def load(pointer, mask=None, other=None, cache_modifier="", eviction_policy="",
     return semantic.load(pointer, mask, other, cache_modifier, eviction_policy, volatile, _builder)
 
 
+def _to_tensors(xs, builder):
+    # tuples of tensors are structs
+    if isinstance(xs, tensor) and isinstance(xs.type, tuple_type):
+        tys = xs.type.element_types
+        return [tensor(builder.extract_value(xs.handle, i), ty) for i, ty in enumerate(tys)]
+    return [_to_tensor(x, builder) for x in xs]
+
+
+@builtin
+def load_tile(pointer, shape, strides, offsets, block_shape, cache_modifier="", eviction_policy="", _builder=None):
+    """
+    Return the block of shape :code:`block_shape` that starts at :code:`offsets` in the tensor of
+    shape :code:`shape` and strides :code:`strides` (in elements) at :code:`pointer`. Its elements past
+    the end of the tensor are zero.
+
+    It loads the same data as :code:`load` of the pointers and mask it spans, but describes the whole
+    tile to the compiler: on sm_90, 2D tiles of kernel arguments with a unit innermost stride that are
+    copied to shared memory (e.g., the operands of :code:`dot`) are loaded by the Tensor Memory Accelerator.
+
+    :param pointer: The base of the tensor.
+    :type pointer: Scalar of dtype=triton.PointerDType
+    :param shape: The size of each dimension of the tensor.
+    :param strides: The stride of each dimension of the tensor.
+    :param offsets: The non-negative index of the first element of the block along each dimension.
+    :param block_shape: The shape of the block.
+    :type block_shape: tuple of int
+    """
+    shape = _to_tensors(shape, _builder)
+    strides = _to_tensors(strides, _builder)
+    offsets = _to_tensors(offsets, _builder)
+    block_shape = [_constexpr_to_value(x) for x in block_shape]
+    cache_modifier = _constexpr_to_value(cache_modifier)
+    eviction_policy = _constexpr_to_value(eviction_policy)
+    return semantic.load_tile(pointer, shape, strides, offsets, block_shape, cache_modifier, eviction_policy, _builder)
+
+
 @builtin
 def store(pointer, value, mask=None, _builder=None):
     """
@@ -846,6 +939,10 @@ def _add_atomic_docstr(name):
     :type cmp: Block of dtype=`pointer.dtype.element_ty`
     :param val: The values to copy in case the expected value matches the contained value.
     :type val: Block of dtype=`pointer.dtype.element_ty`
+    :param scope: The threads that observe the atomic in order with the other memory accesses of the program:
+        :code:`"gpu"` (the default) for those of the device, :code:`"sys"` to also include the host and the
+        peer devices that access :code:`pointer`.
+    :type scope: str
     """
         func.__doc__ = docstr.format(name=name)
         return func
@@ -855,59 +952,67 @@ def _add_atomic_docstr(name):
 
 @builtin
 @_add_atomic_docstr("compare-and-swap")
-def atomic_cas(pointer, cmp, val, _builder=None):
+def atomic_cas(pointer, cmp, val, scope="gpu", _builder=None):
     cmp = _to_tensor(cmp, _builder)
-    val = _to_tensor(cmp, _builder)
-    return semantic.atomic_cas(pointer, cmp, val, _builder)
+    val = _to_tensor(val, _builder)
+    scope = _constexpr_to_value(scope)
+    return semantic.atomic_cas(pointer, cmp, val, scope, _builder)
 
 
 @builtin
 @_add_atomic_docstr("exchange")
-def atomic_xchg(pointer, val, mask=None, _builder=None):
+def atomic_xchg(pointer, val, mask=None, scope="gpu", _builder=None):
     val = _to_tensor(val, _builder)
-    return semantic.atomic_xchg(pointer, val, mask, _builder)
+    scope = _constexpr_to_value(scope)
+    return semantic.atomic_xchg(pointer, val, mask, scope, _builder)
 
 
 @builtin
 @_add_atomic_docstr("add")
-def atomic_add(pointer, val, mask=None, _builder=None):
+def atomic_add(pointer, val, mask=None, scope="gpu", _builder=None):
     val = _to_tensor(val, _builder)
-    return semantic.atomic_add(pointer, val, mask, _builder)
+    scope = _constexpr_to_value(scope)
+    return semantic.atomic_add(pointer, val, mask, scope, _builder)
 
 
 @builtin
 @_add_atomic_docstr("max")
-def atomic_max(pointer, val, mask=None, _builder=None):
+def atomic_max(pointer, val, mask=None, scope="gpu", _builder=None):
     val = _to_tensor(val, _builder)
-    return semantic.atomic_max(pointer, val, mask, _builder)
+    scope = _constexpr_to_value(scope)
+    return semantic.atomic_max(pointer, val, mask, scope, _builder)
 
 
 @builtin
 @_add_atomic_docstr("min")
-def atomic_min(pointer, val, mask=None, _builder=None):
+def atomic_min(pointer, val, mask=None, scope="gpu", _builder=None):
     val = _to_tensor(val, _builder)
-    return semantic.atomic_min(pointer, val, mask, _builder)
+    scope = _constexpr_to_value(scope)
+    return semantic.atomic_min(pointer, val, mask, scope, _builder)
 
 
 @builtin
 @_add_atomic_docstr("logical and")
-def atomic_and(pointer, val, mask=None, _builder=None):
+def atomic_and(pointer, val, mask=None, scope="gpu", _builder=None):
     val = _to_tensor(val, _builder)
-    return semantic.atomic_and(pointer, val, mask, _builder)
+    scope = _constexpr_to_value(scope)
+    return semantic.atomic_and(pointer, val, mask, scope, _builder)
 
 
 @builtin
 @_add_atomic_docstr("logical or")
-def atomic_or(pointer, val, mask=None, _builder=None):
+def atomic_or(pointer, val, mask=None, scope="gpu", _builder=None):
     val = _to_tensor(val, _builder)
-    return semantic.atomic_or(pointer, val, mask, _builder)
+    scope = _constexpr_to_value(scope)
+    return semantic.atomic_or(pointer, val, mask, scope, _builder)
 
 
 @builtin
 @_add_atomic_docstr("logical xor")
-def atomic_xor(pointer, val, mask=None, _builder=None):
+def atomic_xor(pointer, val, mask=None, scope="gpu", _builder=None):
     val = _to_tensor(val, _builder)
-    return semantic.atomic_xor(pointer, val, mask, _builder)
+    scope = _constexpr_to_value(scope)
+    return semantic.atomic_xor(pointer, val, mask, scope, _builder)
 
 
 # -----------------------
@@ -949,6 +1054,19 @@ def umulhi(x, y, _builder=None):
     return semantic.umulhi(x, y, _builder)
 
 
+@builtin
+def _philox(seed, offset, n_rounds, to_float=False, _builder=None):
+    """
+    Returns the four words of `n_rounds` rounds of Philox 4x32 on the counters (offset, 0, 0, 0)
+    and the key made of the halves of `seed`, as :code:`uint32` or, if :code:`to_float`, as
+    :code:`float32` in [0, 1). Used by :code:`triton.language.random`.
+    """
+    n_rounds = _constexpr_to_value(n_rounds)
+    to_float = _constexpr_to_value(to_float)
+    seed = _to_tensor(seed, _builder)
+    return semantic.philox(seed, offset, n_rounds, to_float, _builder)
+
+
 @builtin
 def fdiv(x, y, ieee_rounding=False, _builder=None):
     ieee_rounding = _constexpr_to_value(ieee_rounding)
@@ -1000,6 +1118,39 @@ def sqrt(x, _builder=None):
     return semantic.sqrt(x, _builder)
 
 
+@builtin
+@_add_math_1arg_docstr("error function")
+def erf(x, _builder=None):
+    return semantic.erf(x, _builder)
+
+
+@builtin
+@_add_math_1arg_docstr("hyperbolic tangent")
+def tanh(x, _builder=None):
+    return semantic.tanh(x, _builder)
+
+
+@builtin
+@_add_math_1arg_docstr("reciprocal square root")
+def rsqrt(x, _builder=None):
+    return semantic.rsqrt(x, _builder)
+
+
+@builtin
+def pow(x, y, _builder=None):
+    """
+    Computes the element-wise power :code:`x ** y`
+
+    :param x: the base
+    :type x: Block
+    :param y: the exponent
+    :type y: Block
+    """
+    x = _to_tensor(x, _builder)
+    y = _to_tensor(y, _builder)
+    return semantic.pow(x, y, _builder)
+
+
 # -----------------------
 # Reductions
 # -----------------------
@@ -1033,6 +1184,20 @@ def min(input, axis, _builder=None):
     return semantic.min(input, axis, _builder)
 
 
+@builtin
+@_add_reduction_docstr("index of the maximum")
+def argmax(input, axis, _builder=None):
+    axis = _constexpr_to_value(axis)
+    return semantic.argmax(input, axis, _builder)
+
+
+@builtin
+@_add_reduction_docstr("index of the minimum")
+def argmin(input, axis, _builder=None):
+    axis = _constexpr_to_value(axis)
+    return semantic.argmin(input, axis, _builder)
+
+
 @builtin
 @_add_reduction_docstr("sum")
 def sum(input, axis, _builder=None):
@@ -1046,6 +1211,20 @@ def xor_sum(input, axis, _builder=None):
     axis = _constexpr_to_value(axis)
     return semantic.xor_sum(input, axis, _builder)
 
+
+@builtin
+def cumsum(input, axis, exclusive=False, _builder=None):
+    """
+    Returns the cumulative sum of the elements of the :code:`input` tensor along the provided :code:`axis`
+
+    :param input: the input values
+    :param axis: the dimension along which the scan should be done
+    :param exclusive: if True, the sum at each position excludes the element at that position
+    """
+    axis = _constexpr_to_value(axis)
+    exclusive = _constexpr_to_value(exclusive)
+    return semantic.cumsum(input, axis, exclusive, _builder)
+
 # -----------------------
 # Utilities
 # -----------------------
@@ -1060,6 +1239,37 @@ def globaltimer(_builder=None):
 def clock(_builder=None):
     return semantic.clock(_builder)
 
+
+@builtin
+def grid_sync(_builder=None):
+    """
+    Waits until all the programs of the grid have reached this point, and makes the
+    memory writes of each of them visible to the others.
+
+    All the programs of the grid must be resident on the device at once: launching
+    more programs than fit in one wave raises an error. Launches on different streams
+    have their own barrier, but may only run concurrently if all their programs fit on
+    the device together; replays of a launch graph must not overlap.
+    """
+    return semantic.grid_sync(_builder)
+
+
+@builtin
+def fence(scope="gpu", _builder=None):
+    """
+    Orders the memory accesses of each thread of the program before the fence with those after
+    it, as observed by the threads of :code:`scope`.
+
+    With :code:`scope="sys"`, writes made before the fence, including writes to the memory of
+    peer devices, are visible to the host and to the peer devices before any atomic issued
+    after it, such as one that signals a peer that the data is ready.
+
+    :param scope: :code:`"gpu"` (the default) or :code:`"sys"`.
+    :type scope: str
+    """
+    scope = _constexpr_to_value(scope)
+    return semantic.fence(scope, _builder)
+
 # -----------------------
 # Internal for debugging
 # -----------------------
@@ -1195,6 +1405,29 @@ def swizzle2d(i, j, size_i, size_j, size_g):
     return new_i, new_j
 
 
+@triton.jit
+def gather_rows(pointer, rows, cols, stride, mask):
+    """
+    Loads the columns :code:`cols` of the rows :code:`rows` of a row-major matrix,
+    as a block of shape :code:`(rows.shape[0], cols.shape[0])`, e.g., to look up
+    embeddings or paged KV-cache blocks.
+
+    Each gathered row is known to be contiguous, so the loads are vectorized along
+    :code:`cols` whenever :code:`pointer` and :code:`stride` are suitably aligned.
+
+    :param pointer: the first element of the matrix
+    :param rows: the indices of the rows to load
+    :type rows: Block
+    :param cols: the contiguous indices of the columns to load, e.g., :code:`arange(0, BLOCK)`
+    :type cols: Block
+    :param stride: the distance, in elements, between consecutive rows
+    :param mask: the rows to load; the others are filled with zeros
+    :type mask: Block of triton.int1
+    """
+    ptrs = pointer + (rows[:, None] * stride + cols[None, :])
+    return load(ptrs, mask=mask[:, None], other=0)
+
+
 @triton.jit
 def zeros_like(input):
     return zeros(input.shape, input.dtype)
@@ -1203,21 +1436,41 @@ def zeros_like(input):
 # -----------------------
 
 
-# class LaunchProxy:
+class LaunchProxy:
+    """
+    Device-side launch of `fn`, which the code generator compiles as a kernel of the
+    same module and replaces by a `launch` instruction
+    """
 
-#     def __init__(self, fn, args, constants, grid, num_warps) -> None:
-#         self.args = args
-#         self.grid = grid
-#         self.constants = constants
-#         self.num_warps = num_warps
-#         self.fn = fn
+    def __init__(self, fn, args, grid) -> None:
+        self.fn = fn
+        self.args = args
+        self.grid = grid
 
 
-# @builtin
-# def launch(fn, args, grid, num_warps=None, _builder=None):
-#     constants = {i: x for i, x in enumerate(args) if isinstance(x, constexpr)}
-#     args = [_to_ir(x, builder=_builder) for x in args if not isinstance(x, constexpr)]
-#     grid = [_to_ir(x, builder=_builder) for x in grid]
-#     if num_warps is None:
-#         num_warps = _to_ir(4, builder=_builder)
-#     return LaunchProxy(fn, args, constants, grid, num_warps)
+@builtin
+def launch(fn, grid, args, _builder=None):
+    """
+    Launches the :code:`triton.jit`'d function :code:`fn` from the device, on a grid of
+    up to three dimensions computed by the program, e.g.
+    :code:`tl.launch(kernel, [n], [X, n, BLOCK])`.
+
+    The first program of the caller enqueues the launch, and the child kernel runs once
+    the caller has completed, with the same number of warps and shared memory, which
+    must not exceed 48KB. Only supported on NVIDIA GPUs, where the binary is linked
+    against the CUDA device runtime.
+
+    :param fn: the kernel to launch
+    :param grid: the number of programs along each axis
+    :type grid: list of scalar integers
+    :param args: the arguments of :code:`fn`, tensors or :code:`constexpr`
+    :type args: list
+    """
+    if len(grid) > 3:
+        raise ValueError(f"launch grids have up to 3 dimensions, got {len(grid)}")
+    grid = [_to_tensor(x, _builder) for x in grid]
+    grid += [_to_tensor(1, _builder)] * (3 - len(grid))
+    if any(x.type.is_block() for x in grid):
+        raise ValueError("launch grids are made of scalars")
+    grid = [semantic.cast(x, int32, _builder) for x in grid]
+    return LaunchProxy(fn, list(args), grid)
@@ -68,9 +68,8 @@ def randint4x(seed, offset, n_rounds: tl.constexpr = N_ROUNDS_DEFAULT):
     :param seed: The seed for generating random numbers.
     :param offsets: The offsets to generate random numbers for.
     """
-    # _0 = tl.zeros(offset.shape, offset.dtype)
-    _0 = offset * 0
-    return philox(seed, offset, _0, _0, _0, n_rounds)
+    c0, c1, c2, c3 = tl._philox(seed, offset, n_rounds)
+    return c0, c1, c2, c3
 
 
 # -------------------
@@ -106,8 +105,8 @@ def rand(seed, offset, n_rounds: tl.constexpr = N_ROUNDS_DEFAULT):
     :param offsets: The offsets to generate random numbers for.
     """
     offset = offset.to(tl.uint32, bitcast=True)
-    source = randint(seed, offset, n_rounds)
-    return uint32_to_uniform_float(source)
+    u, _, _, _ = tl._philox(seed, offset, n_rounds, True)
+    return u
 
 
 @triton.jit
@@ -120,11 +119,7 @@ def rand4x(seed, offsets, n_rounds: tl.constexpr = N_ROUNDS_DEFAULT):
     :param offsets: The offsets to generate random numbers for.
     """
     offsets = offsets.to(tl.uint32, bitcast=True)
-    i1, i2, i3, i4 = randint4x(seed, offsets, n_rounds)
-    u1 = uint32_to_uniform_float(i1)
-    u2 = uint32_to_uniform_float(i2)
-    u3 = uint32_to_uniform_float(i3)
-    u4 = uint32_to_uniform_float(i4)
+    u1, u2, u3, u4 = tl._philox(seed, offsets, n_rounds, True)
     return u1, u2, u3, u4
 
 # -------------------
@@ -150,9 +145,8 @@ def randn(seed, offset, n_rounds: tl.constexpr = N_ROUNDS_DEFAULT):
     :param seed: The seed for generating random numbers.
     :param offsets: The offsets to generate random numbers for.
     """
-    i1, i2, _, _ = randint4x(seed, offset, n_rounds)
-    u1 = uint32_to_uniform_float(i1)
-    u2 = uint32_to_uniform_float(i2)
+    offset = offset.to(tl.uint32, bitcast=True)
+    u1, u2, _, _ = tl._philox(seed, offset, n_rounds, True)
     n1, _ = pair_uniform_to_normal(u1, u2)
     return n1
 
@@ -15,6 +15,12 @@ class IncompatibleTypeErrorimpl(Exception):
         super(IncompatibleTypeErrorimpl, self).__init__(self.message)
 
 
+# address space of constant tables
+CONSTANT_ADDRESS_SPACE = 4
+# bytes of the constant memory that a kernel can use
+CONSTANT_MEMORY_SIZE = 64 * 1024
+
+
 # ===----------------------------------------------------------------------===##
 # Programming Model
 # ===----------------------------------------------------------------------===##
@@ -446,6 +452,27 @@ def zeros(shape: List[int], dtype: tl.dtype, builder: ir.builder) -> tl.tensor:
     ret_ty = tl.block_type(dtype, shape)
     return tl.tensor(builder.create_splat(_0, shape), ret_ty)
 
+
+def constant_table(values: List, dtype: tl.dtype, builder: ir.builder) -> tl.tensor:
+    if not values:
+        raise ValueError("constant tables cannot be empty")
+    if dtype.is_fp8() or not (dtype.is_int() or dtype.is_floating()):
+        raise ValueError(f"constant tables of {dtype} are not supported")
+    # booleans are stored as bytes, as in global memory
+    elt_ty = tl.int8 if dtype.is_bool() else dtype
+    if len(values) * elt_ty.primitive_bitwidth // 8 > CONSTANT_MEMORY_SIZE:
+        raise ValueError(f"a constant table of {len(values)} {dtype} does not fit in constant memory")
+    if dtype.is_int():
+        # two's complement, truncated to the width of the elements
+        values = [int(v) & ((1 << elt_ty.int_bitwidth) - 1) for v in values]
+    else:
+        values = [float(v) for v in values]
+    table = builder.get_constant_table(elt_ty.to_ir(builder), values)
+    ptr = tl.tensor(table, tl.pointer_type(elt_ty, CONSTANT_ADDRESS_SPACE))
+    if elt_ty != dtype:
+        ptr = cast(ptr, tl.pointer_type(dtype, CONSTANT_ADDRESS_SPACE), builder)
+    return ptr
+
 # ===----------------------------------------------------------------------===//
 #                               Shape Manipulation
 # ===----------------------------------------------------------------------===//
@@ -635,6 +662,8 @@ def cast(input: tl.tensor,
         return tl.tensor(builder.create_int_to_ptr(input.handle, dst_ty.to_ir(builder)), dst_ty)
     # Ptr . Ptr
     if src_sca_ty.is_ptr() and dst_sca_ty.is_ptr():
+        if src_sca_ty.address_space != dst_sca_ty.address_space:
+            raise ValueError(f'cannot cast {src_sca_ty} to {dst_sca_ty}: they point to different memories')
         return tl.tensor(builder.create_bitcast(input.handle, dst_ty.to_ir(builder)), dst_ty)
     # * . Bool
     if dst_sca_ty.is_bool():
@@ -651,6 +680,30 @@ def cast(input: tl.tensor,
 # ===----------------------------------------------------------------------===//
 
 
+def _str_to_cache_modifier(cache_modifier: str) -> ir.CACHE_MODIFIER:
+    cache = ir.CACHE_MODIFIER.NONE  # default
+    if cache_modifier:
+        if cache_modifier == ".ca":
+            cache = ir.CACHE_MODIFIER.CA
+        elif cache_modifier == ".cg":
+            cache = ir.CACHE_MODIFIER.CG
+        else:
+            raise ValueError(f"Cache modifier {cache_modifier} not supported")
+    return cache
+
+
+def _str_to_eviction_policy(eviction_policy: str) -> ir.EVICTION_POLICY:
+    eviction = ir.EVICTION_POLICY.NORMAL  # default
+    if eviction_policy:
+        if eviction_policy == "evict_last":
+            eviction = ir.EVICTION_POLICY.EVICT_LAST
+        elif eviction_policy == "evict_first":
+            eviction = ir.EVICTION_POLICY.EVICT_FIRST
+        else:
+            raise ValueError(f"Eviction policy {eviction_policy} not supported")
+    return eviction
+
+
 def load(ptr: tl.tensor,
          mask: Optional[tl.tensor],
          other: Optional[tl.tensor],
@@ -676,25 +729,8 @@ def load(ptr: tl.tensor,
         ptr_ty = tl.pointer_type(elt_ty, ptr_ty.address_space)
         ptr = cast(ptr, ptr_ty, builder)
 
-    # cache modifier
-    cache = ir.CACHE_MODIFIER.NONE  # default
-    if cache_modifier:
-        if cache_modifier == ".ca":
-            cache = ir.CACHE_MODIFIER.CA
-        elif cache_modifier == ".cg":
-            cache = ir.CACHE_MODIFIER.CG
-        else:
-            raise ValueError(f"Cache modifier {cache_modifier} not supported")
-
-    # eviction policy
-    eviction = ir.EVICTION_POLICY.NORMAL  # default
-    if eviction_policy:
-        if eviction_policy == "evict_last":
-            eviction = ir.EVICTION_POLICY.EVICT_LAST
-        elif eviction_policy == "evict_first":
-            eviction = ir.EVICTION_POLICY.EVICT_FIRST
-        else:
-            raise ValueError(f"Eviction policy {eviction_policy} not supported")
+    cache = _str_to_cache_modifier(cache_modifier)
+    eviction = _str_to_eviction_policy(eviction_policy)
 
     if ptr.type.is_block():
         shape = ptr.type.get_block_shapes()
@@ -721,12 +757,51 @@ def load(ptr: tl.tensor,
                      dst_ty)
 
 
+def load_tile(base: tl.tensor,
+              shape: List[tl.tensor],
+              strides: List[tl.tensor],
+              offsets: List[tl.tensor],
+              block_shape: List[int],
+              cache_modifier: str,
+              eviction_policy: str,
+              builder: ir.builder) -> tl.tensor:
+    if base.type.is_block() or not base.type.is_ptr():
+        raise ValueError("Base of load_tile must be a scalar pointer, not " + base.type.__repr__())
+    rank = len(block_shape)
+    if rank == 0 or len(shape) != rank or len(strides) != rank or len(offsets) != rank:
+        raise ValueError("load_tile needs a shape, a stride and an offset per dimension of the block")
+    elt_ty = base.type.element_ty
+    if elt_ty == tl.int1:
+        raise ValueError("load_tile does not support tensors of int1")
+    # pointers and bounds of the elements of the block, whose indices along
+    # each dimension are broadcast along the others
+    ptr = base
+    mask = None
+    for d in range(rank):
+        idx = add(arange(0, block_shape[d], builder), offsets[d], builder)
+        idx = reshape(idx, [block_shape[d] if k == d else 1 for k in range(rank)], builder)
+        ptr = add(ptr, mul(idx, strides[d], builder), builder)
+        in_bounds = less_than(idx, shape[d], builder)
+        mask = in_bounds if mask is None else and_(mask, in_bounds, builder)
+    ptr = broadcast_impl_shape(ptr, block_shape, builder)
+    mask = broadcast_impl_shape(mask, block_shape, builder)
+    other = zeros(block_shape, elt_ty, builder)
+    cache = _str_to_cache_modifier(cache_modifier)
+    eviction = _str_to_eviction_policy(eviction_policy)
+    return tl.tensor(builder.create_tile_load(ptr.handle, mask.handle, other.handle, base.handle,
+                                              [x.handle for x in shape], [x.handle for x in strides],
+                                              [x.handle for x in offsets], cache, eviction, False),
+                     tl.block_type(elt_ty, block_shape))
+
+
 def store(ptr: tl.tensor,
           val: tl.tensor,
           mask: Optional[tl.tensor],
           builder: ir.builder) -> tl.tensor:
     if not ptr.type.scalar.is_ptr():
         raise ValueError("Pointer argument of store instruction is " + ptr.type.__repr__())
+    if ptr.type.scalar.address_space == CONSTANT_ADDRESS_SPACE:
+        raise ValueError("Cannot store to a constant table")
     if ptr.type.is_block():
         val = broadcast_impl_shape(val, ptr.type.get_block_shapes(), builder)
     if mask:
@@ -752,12 +827,23 @@ def store(ptr: tl.tensor,
 #########
 
 
+def _str_to_mem_scope(scope: str) -> ir.MEM_SCOPE:
+    if scope == "gpu":
+        return ir.MEM_SCOPE.GPU
+    if scope == "sys":
+        return ir.MEM_SCOPE.SYS
+    raise ValueError(f"Memory scope {scope} not supported")
+
+
 def atomic_cas(ptr: tl.tensor,
                cmp: tl.tensor,
                val: tl.tensor,
+               scope: str,
                builder: ir.builder) -> tl.tensor:
     # TODO: type checking
-    return tl.tensor(builder.create_atomic_cas(ptr.handle, cmp.handle, val.handle), val.type)
+    if ptr.type.scalar.address_space == CONSTANT_ADDRESS_SPACE:
+        raise ValueError("Cannot update a constant table atomically")
+    return tl.tensor(builder.create_atomic_cas(ptr.handle, cmp.handle, val.handle, _str_to_mem_scope(scope)), val.type)
 
 
 def atom_red_typechecking_impl(ptr: tl.tensor,
@@ -766,6 +852,8 @@ def atom_red_typechecking_impl(ptr: tl.tensor,
                                builder: ir.builder) -> Tuple[tl.tensor, tl.tensor, tl.tensor]:
     if not ptr.type.scalar.is_ptr():
         raise ValueError("Pointer argument of store instruction is " + ptr.type.__repr__())
+    if ptr.type.scalar.address_space == CONSTANT_ADDRESS_SPACE:
+        raise ValueError("Cannot update a constant table atomically")
     if ptr.type.is_block():
         if mask:
             mask = broadcast_impl_shape(mask, ptr.type.get_block_shapes(), builder)
@@ -785,8 +873,10 @@ def atom_red_typechecking_impl(ptr: tl.tensor,
 def atomic_max(ptr: tl.tensor,
                val: tl.tensor,
                mask: tl.tensor,
+               scope: str,
                builder: ir.builder) -> tl.tensor:
     ptr, val, mask = atom_red_typechecking_impl(ptr, val, mask, builder)
+    scope = _str_to_mem_scope(scope)
     sca_ty = val.type.scalar
     # direct call to atomic_max for integers
     if sca_ty.is_int():
@@ -794,13 +884,15 @@ def atomic_max(ptr: tl.tensor,
             return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.MAX,
                                                        ptr.handle,
                                                        val.handle,
-                                                       mask.handle),
+                                                       mask.handle,
+                                                       scope),
                              val.type)
         else:
             return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.UMAX,
                                                        ptr.handle,
                                                        val.handle,
-                                                       mask.handle),
+                                                       mask.handle,
+                                                       scope),
                              val.type)
     # for float
     # return atomic_smax(i_ptr, i_val) if val >= 0
@@ -809,16 +901,18 @@ def atomic_max(ptr: tl.tensor,
     i_ptr = bitcast(ptr, tl.pointer_type(tl.int32, 1), builder)
     pos = greater_equal(val, tl.tensor(ir.constant_float.get(sca_ty.to_ir(builder), 0), sca_ty), builder)
     neg = less_than(val, tl.tensor(ir.constant_float.get(sca_ty.to_ir(builder), 0), sca_ty), builder)
-    pos_ret = tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.MAX, i_ptr.handle, i_val.handle, and_(mask, pos, builder).handle), i_val.type)
-    neg_ret = tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.UMIN, i_ptr.handle, i_val.handle, and_(mask, neg, builder).handle), i_val.type)
+    pos_ret = tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.MAX, i_ptr.handle, i_val.handle, and_(mask, pos, builder).handle, scope), i_val.type)
+    neg_ret = tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.UMIN, i_ptr.handle, i_val.handle, and_(mask, neg, builder).handle, scope), i_val.type)
     return where(pos, pos_ret, neg_ret, builder)
 
 
 def atomic_min(ptr: tl.tensor,
                val: tl.tensor,
                mask: tl.tensor,
+               scope: str,
                builder: ir.builder) -> tl.tensor:
     ptr, val, mask = atom_red_typechecking_impl(ptr, val, mask, builder)
+    scope = _str_to_mem_scope(scope)
     sca_ty = val.type.scalar
     # direct call to atomic_min for integers
     if sca_ty.is_int():
@@ -826,13 +920,15 @@ def atomic_min(ptr: tl.tensor,
             return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.MIN,
                                                        ptr.handle,
                                                        val.handle,
-                                                       mask.handle),
+                                                       mask.handle,
+                                                       scope),
                              val.type)
         else:
             return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.UMIN,
                                                        ptr.handle,
                                                        val.handle,
-                                                       mask.handle),
+                                                       mask.handle,
+                                                       scope),
                              val.type)
     # for float
     # return atomic_smin(i_ptr, i_val) if val >= 0
@@ -844,12 +940,14 @@ def atomic_min(ptr: tl.tensor,
     pos_ret = tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.MIN,
                                                   i_ptr.handle,
                                                   i_val.handle,
-                                                  and_(mask, pos, builder).handle),
+                                                  and_(mask, pos, builder).handle,
+                                                  scope),
                         i_val.type)
     neg_ret = tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.UMAX,
                                                   i_ptr.handle,
                                                   i_val.handle,
-                                                  and_(mask, neg, builder).handle),
+                                                  and_(mask, neg, builder).handle,
+                                                  scope),
                         i_val.type)
     return where(pos, pos_ret, neg_ret, builder)
 
@@ -857,43 +955,53 @@ def atomic_min(ptr: tl.tensor,
 def atomic_add(ptr: tl.tensor,
                val: tl.tensor,
                mask: tl.tensor,
+               scope: str,
                builder: ir.builder) -> tl.tensor:
     ptr, val, mask = atom_red_typechecking_impl(ptr, val, mask, builder)
+    scope = _str_to_mem_scope(scope)
     sca_ty = val.type.scalar
     op = ir.ATOMIC_OP.FADD if sca_ty.is_floating() else ir.ATOMIC_OP.ADD
-    return tl.tensor(builder.create_atomic_rmw(op, ptr.handle, val.handle, mask.handle), val.type)
+    return tl.tensor(builder.create_atomic_rmw(op, ptr.handle, val.handle, mask.handle, scope), val.type)
 
 
 def atomic_and(ptr: tl.tensor,
                val: tl.tensor,
                mask: tl.tensor,
+               scope: str,
                builder: ir.builder) -> tl.tensor:
     ptr, val, mask = atom_red_typechecking_impl(ptr, val, mask, builder)
-    return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.AND, ptr.handle, val.handle, mask.handle), val.type)
+    scope = _str_to_mem_scope(scope)
+    return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.AND, ptr.handle, val.handle, mask.handle, scope), val.type)
 
 
 def atomic_or(ptr: tl.tensor,
               val: tl.tensor,
               mask: tl.tensor,
+              scope: str,
               builder: ir.builder) -> tl.tensor:
     ptr, val, mask = atom_red_typechecking_impl(ptr, val, mask, builder)
-    return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.OR, ptr.handle, val.handle, mask.handle), val.type)
+    scope = _str_to_mem_scope(scope)
+    return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.OR, ptr.handle, val.handle, mask.handle, scope), val.type)
 
 
 def atomic_xor(ptr: tl.tensor,
                val: tl.tensor,
                mask: tl.tensor,
+               scope: str,
                builder: ir.builder) -> tl.tensor:
     ptr, val, mask = atom_red_typechecking_impl(ptr, val, mask, builder)
-    return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.XOR, ptr.handle, val.handle, mask.handle), val.type)
+    scope = _str_to_mem_scope(scope)
+    return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.XOR, ptr.handle, val.handle, mask.handle, scope), val.type)
 
 
 def atomic_xchg(ptr: tl.tensor,
                 val: tl.tensor,
                 mask: tl.tensor,
+                scope: str,
                 builder: ir.builder) -> tl.tensor:
     ptr, val, mask = atom_red_typechecking_impl(ptr, val, mask, builder)
-    return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.XCHG, ptr.handle, val.handle, mask.handle), val.type)
+    scope = _str_to_mem_scope(scope)
+    return tl.tensor(builder.create_atomic_rmw(ir.ATOMIC_OP.XCHG, ptr.handle, val.handle, mask.handle, scope), val.type)
 
 # ===----------------------------------------------------------------------===//
 #                               Linear Algebra
@@ -903,9 +1011,29 @@ def atomic_xchg(ptr: tl.tensor,
 def dot(lhs: tl.tensor,
         rhs: tl.tensor,
         allow_tf32: bool,
-        builder: ir.builder) -> tl.tensor:
+        builder: ir.builder,
+        precision: str = None,
+        acc_dtype: tl.dtype = None) -> tl.tensor:
     assert lhs.type.is_block() and rhs.type.is_block()
-    if lhs.type.scalar.is_int():
+    assert precision in [None, '3xtf32'], f"unsupported dot precision {precision}"
+    split_tf32 = precision == '3xtf32'
+    if split_tf32:
+        assert lhs.type.scalar.is_fp32() and rhs.type.scalar.is_fp32(), "3xtf32 requires float32 operands"
+        allow_tf32 = True
+    # the fp8 format of this tree is not the e4m3 format of fp8 tensor cores: fp8 operands are multiplied in fp16
+    if lhs.type.scalar.is_fp8():
+        lhs = cast(lhs, tl.float16, builder)
+    if rhs.type.scalar.is_fp8():
+        rhs = cast(rhs, tl.float16, builder)
+    if acc_dtype not in [None, tl.float32, tl.int32, tl.float16]:
+        raise ValueError(f"dot accumulates in float32, int32 or float16 (got {acc_dtype})")
+    if acc_dtype == tl.float16 and (not lhs.type.scalar.is_fp16() or not rhs.type.scalar.is_fp16()):
+        raise ValueError(f"float16 accumulators require float16 operands "
+                         f"(got {lhs.type.scalar} and {rhs.type.scalar})")
+    if acc_dtype == tl.float16:
+        _0 = builder.get_float16(0)
+        ret_scalar_ty = tl.float16
+    elif lhs.type.scalar.is_int():
         _0 = builder.get_int32(0)
         ret_scalar_ty = tl.int32
     else:
@@ -915,10 +1043,34 @@ def dot(lhs: tl.tensor,
     N = rhs.type.shape[1]
     _0 = builder.create_splat(_0, [M, N])
     ret_ty = tl.block_type(ret_scalar_ty, [M, N])
-    return tl.tensor(builder.create_dot(lhs.handle, rhs.handle, _0, allow_tf32),
+    return tl.tensor(builder.create_dot(lhs.handle, rhs.handle, _0, allow_tf32, split_tf32),
                      ret_ty)
 
 
+def sparse_dot(lhs: tl.tensor,
+               meta: tl.tensor,
+               rhs: tl.tensor,
+               builder: ir.builder) -> tl.tensor:
+    assert lhs.type.is_block() and rhs.type.is_block() and meta.type.is_block()
+    if lhs.type.scalar not in [tl.float16, tl.bfloat16] or rhs.type.scalar != lhs.type.scalar:
+        raise ValueError(f"sparse dot requires float16 or bfloat16 blocks of the same type "
+                         f"(got {lhs.type.scalar} and {rhs.type.scalar})")
+    M, K = lhs.type.shape[0], 2 * lhs.type.shape[1]
+    N = rhs.type.shape[1]
+    if rhs.type.shape[0] != K:
+        raise ValueError(f"the compressed blocks of sparse dot hold half of the rows of the other "
+                         f"operand (got {lhs.type.shape} and {rhs.type.shape})")
+    # one instruction multiplies 16x32 blocks by 32x8 ones
+    if M < 16 or N < 16 or K < 32:
+        raise ValueError(f"sparse dot requires blocks of at least 16x32 by 32x16 (got {M}x{K} by {K}x{N})")
+    if meta.type.scalar != tl.int32 or meta.type.shape != [M, K // 32]:
+        raise ValueError(f"the metadata of sparse dot must be an int32 block of shape {[M, K // 32]} "
+                         f"(got {meta.type})")
+    _0 = builder.create_splat(builder.get_float32(0), [M, N])
+    ret_ty = tl.block_type(tl.float32, [M, N])
+    return tl.tensor(builder.create_sparse_dot(lhs.handle, meta.handle, rhs.handle, _0), ret_ty)
+
+
 # ===----------------------------------------------------------------------===//
 #                               Indexing
 # ===----------------------------------------------------------------------===//
@@ -964,14 +1116,17 @@ def reduce_impl(input: tl.tensor, axis: int, builder: ir.builder, name: str,
     for i, s in enumerate(shape):
         if i != axis:
             ret_shape.append(s)
+    # arg reductions return the index of the extreme element
+    if name in ("argmin", "argmax"):
+        scalar_ty = tl.int32
     if len(ret_shape) == 0:
         res_ty = scalar_ty
     else:
         res_ty = tl.block_type(scalar_ty, ret_shape)
 
-    if scalar_ty.is_floating():
+    if input.type.scalar.is_floating():
         return tl.tensor(builder.create_reduce(input.handle, FLOAT_OP, axis), res_ty)
-    elif scalar_ty.is_int():
+    elif input.type.scalar.is_int():
         return tl.tensor(builder.create_reduce(input.handle, INT_OP, axis), res_ty)
     assert False
 
@@ -984,6 +1139,14 @@ def max(input: tl.tensor, axis: int, builder: ir.builder) -> tl.tensor:
     return reduce_impl(input, axis, builder, "max", ir.REDUCE_OP.FMAX, ir.REDUCE_OP.MAX)
 
 
+def argmin(input: tl.tensor, axis: int, builder: ir.builder) -> tl.tensor:
+    return reduce_impl(input, axis, builder, "argmin", ir.REDUCE_OP.ARGFMIN, ir.REDUCE_OP.ARGMIN)
+
+
+def argmax(input: tl.tensor, axis: int, builder: ir.builder) -> tl.tensor:
+    return reduce_impl(input, axis, builder, "argmax", ir.REDUCE_OP.ARGFMAX, ir.REDUCE_OP.ARGMAX)
+
+
 def sum(input: tl.tensor, axis: int, builder: ir.builder) -> tl.tensor:
     return reduce_impl(input, axis, builder, "sum", ir.REDUCE_OP.FADD, ir.REDUCE_OP.ADD)
 
@@ -995,6 +1158,23 @@ def xor_sum(input: tl.tensor, axis: int, builder: ir.builder) -> tl.tensor:
     return reduce_impl(input, axis, builder, "sum", ir.REDUCE_OP.XOR, ir.REDUCE_OP.XOR)
 
 
+def cumsum(input: tl.tensor, axis: int, exclusive: bool, builder: ir.builder) -> tl.tensor:
+    # integers are accumulated in (at least) 32-bits, like reductions
+    if input.type.scalar.is_int() and input.type.scalar.int_bitwidth <= 32:
+        input = cast(input, tl.int32, builder)
+    if not input.type.is_block():
+        raise ValueError("cumsum expects a tensor")
+    if axis < 0 or axis >= len(input.type.shape):
+        raise ValueError(f"invalid axis {axis} for a tensor of rank {len(input.type.shape)}")
+    if input.type.scalar.is_floating():
+        op = ir.REDUCE_OP.FADD
+    elif input.type.scalar.is_int():
+        op = ir.REDUCE_OP.ADD
+    else:
+        raise ValueError(f"cumsum does not support {input.type.scalar}")
+    return tl.tensor(builder.create_scan(input.handle, op, axis, exclusive), input.type)
+
+
 # -----------------------
 # Utilities
 # -----------------------
@@ -1004,7 +1184,15 @@ def clock(builder: ir.builder) -> tl.tensor:
 
 
 def globaltimer(builder: ir.builder) -> tl.tensor:
-    return tl.tensor(builder.create_globaltimer, tl.int64)
+    return tl.tensor(builder.create_globaltimer(), tl.int64)
+
+
+def grid_sync(builder: ir.builder) -> tl.tensor:
+    return tl.tensor(builder.create_grid_sync(), tl.void)
+
+
+def fence(scope: str, builder: ir.builder) -> tl.tensor:
+    return tl.tensor(builder.create_fence(_str_to_mem_scope(scope)), tl.void)
 
 
 # ===----------------------------------------------------------------------===
@@ -1016,6 +1204,26 @@ def umulhi(x: tl.tensor, y: tl.tensor, builder: ir.builder) -> tl.tensor:
     return tl.tensor(builder.create_umulhi(x.handle, y.handle), x.type)
 
 
+def philox(seed: tl.tensor, offset: tl.tensor, n_rounds: int, to_float: bool,
+           builder: ir.builder) -> Tuple[tl.tensor, tl.tensor, tl.tensor, tl.tensor]:
+    if not offset.dtype.is_int() or offset.dtype.primitive_bitwidth != 32:
+        raise ValueError(f"Philox offsets must be 32-bit integers, got {offset.dtype}")
+    if seed.type.is_block() or not seed.dtype.is_int():
+        raise ValueError(f"Philox seeds must be integer scalars, got {seed.type}")
+    # the key is the low and high halves of the seed
+    seed = cast(seed, tl.uint64, builder)
+    k0 = cast(seed, tl.uint32, builder)
+    k1 = cast(lshr(seed, tl.tensor(builder.get_int64(32), tl.uint64), builder), tl.uint32, builder)
+    if offset.type.is_block():
+        k0 = broadcast_impl_shape(k0, offset.type.get_block_shapes(), builder)
+        k1 = broadcast_impl_shape(k1, offset.type.get_block_shapes(), builder)
+    ret_ty = offset.type
+    if to_float:
+        ret_ty = tl.block_type(tl.float32, offset.type.get_block_shapes()) if offset.type.is_block() else tl.float32
+    return tuple(tl.tensor(builder.create_philox(offset.handle, k0.handle, k1.handle, n_rounds, word, to_float), ret_ty)
+                 for word in range(4))
+
+
 def exp(x: tl.tensor, builder: ir.builder) -> tl.tensor:
     return tl.tensor(builder.create_exp(x.handle), x.type)
 
@@ -1036,6 +1244,32 @@ def sqrt(x: tl.tensor, builder: ir.builder) -> tl.tensor:
     return tl.tensor(builder.create_sqrt(x.handle), x.type)
 
 
+def math(fn: str, args: List[tl.tensor], builder: ir.builder) -> tl.tensor:
+    dtype = args[0].dtype
+    if dtype.is_fp16() or dtype.is_fp32() or dtype.is_fp64():
+        return tl.tensor(builder.create_math(fn, [arg.handle for arg in args]), args[0].type)
+    # other types are computed in fp32, and floating-point results cast back
+    ret = math(fn, [cast(arg, tl.float32, builder) for arg in args], builder)
+    return cast(ret, dtype, builder) if dtype.is_floating() else ret
+
+
+def erf(x: tl.tensor, builder: ir.builder) -> tl.tensor:
+    return math("erf", [x], builder)
+
+
+def tanh(x: tl.tensor, builder: ir.builder) -> tl.tensor:
+    return math("tanh", [x], builder)
+
+
+def rsqrt(x: tl.tensor, builder: ir.builder) -> tl.tensor:
+    return math("rsqrt", [x], builder)
+
+
+def pow(x: tl.tensor, y: tl.tensor, builder: ir.builder) -> tl.tensor:
+    x, y = binary_op_type_checking_impl(x, y, builder)
+    return math("pow", [x, y], builder)
+
+
 ##
 
 def multiple_of(x: tl.tensor, value: int) -> tl.tensor:
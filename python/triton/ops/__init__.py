@@ -1,5 +1,15 @@
 # flake8: noqa: F401
 #from .conv import _conv, conv
 from . import blocksparse
+from .attention import _attention, attention
+from .collective import Communicator, all_gather, all_reduce
 from .cross_entropy import _cross_entropy, cross_entropy
-from .matmul import _matmul, matmul
+from .fp8 import FP8_MAX, fp8_quantize, fp8_update_scale
+from .gated_mlp import gated_mlp
+from .layer_norm import _norm, layer_norm, rms_norm
+from .matmul import _matmul, grouped_matmul, matmul
+from .matmul_2_4 import compress_2_4, matmul_2_4
+from .matmul_int4 import matmul_int4, pack_int4
+from .paged_attention import paged_attention
+from .permute import permute
+from .reduce import reduce
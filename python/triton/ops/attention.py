@@ -0,0 +1,309 @@
+import torch
+
+import triton
+import triton.language as tl
+
+# ********************************************************
+# --------------------------------------------------------
+# Fused attention
+# The scores of a block of queries are computed one block
+# of keys at a time, and normalized with an online softmax,
+# so that they are never written to memory.
+# The backward pass recomputes them from the log-sum-exp
+# of each row
+# --------------------------------------------------------
+# ********************************************************
+
+
+@triton.jit
+def _fwd_kernel(
+    Q, K, V, Out, L, SEQLENS, sm_scale,
+    stride_qz, stride_qh, stride_qm, stride_qk,
+    stride_kz, stride_kh, stride_kn, stride_kk,
+    stride_vz, stride_vh, stride_vn, stride_vk,
+    stride_oz, stride_oh, stride_om, stride_ok,
+    H, N_CTX,
+    BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_DMODEL: tl.constexpr,
+    IS_CAUSAL: tl.constexpr
+):
+    start_m = tl.program_id(0)
+    off_hz = tl.program_id(1)
+    off_z = off_hz // H
+    off_h = off_hz % H
+    seqlen = N_CTX
+    if SEQLENS is not None:
+        seqlen = tl.load(SEQLENS + off_z)
+    offs_m = start_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    offs_n = tl.arange(0, BLOCK_N)
+    offs_d = tl.arange(0, BLOCK_DMODEL)
+    Q += off_z * stride_qz + off_h * stride_qh
+    K += off_z * stride_kz + off_h * stride_kh
+    V += off_z * stride_vz + off_h * stride_vh
+    q = tl.load(Q + offs_m[:, None] * stride_qm + offs_d[None, :] * stride_qk,
+                mask=offs_m[:, None] < seqlen, other=0.)
+    # running maximum and sum of the exponentials of each row
+    m_i = tl.zeros([BLOCK_M], dtype=tl.float32) - float("inf")
+    l_i = tl.zeros([BLOCK_M], dtype=tl.float32)
+    acc = tl.zeros([BLOCK_M, BLOCK_DMODEL], dtype=tl.float32)
+    end_n = seqlen
+    if IS_CAUSAL:
+        end_n = tl.minimum(seqlen, (start_m + 1) * BLOCK_M)
+    for start_n in range(0, end_n, BLOCK_N):
+        cols = start_n + offs_n
+        # scores; keys are loaded transposed
+        k = tl.load(K + cols[None, :] * stride_kn + offs_d[:, None] * stride_kk,
+                    mask=cols[None, :] < seqlen, other=0.)
+        qk = tl.dot(q, k) * sm_scale
+        valid = cols[None, :] < seqlen
+        if IS_CAUSAL:
+            valid = valid & (offs_m[:, None] >= cols[None, :])
+        qk = tl.where(valid, qk, float("-inf"))
+        # online softmax
+        m_new = tl.maximum(m_i, tl.max(qk, 1))
+        alpha = tl.exp(m_i - m_new)
+        p = tl.exp(qk - m_new[:, None])
+        l_i = l_i * alpha + tl.sum(p, 1)
+        acc = acc * alpha[:, None]
+        v = tl.load(V + cols[:, None] * stride_vn + offs_d[None, :] * stride_vk,
+                    mask=cols[:, None] < seqlen, other=0.)
+        acc += tl.dot(p.to(V.dtype.element_ty), v)
+        m_i = m_new
+    acc = acc / l_i[:, None]
+    # padding rows are zeros
+    acc = tl.where(offs_m[:, None] < seqlen, acc, 0.)
+    tl.store(L + off_hz * N_CTX + offs_m, m_i + tl.log(l_i), mask=offs_m < N_CTX)
+    Out += off_z * stride_oz + off_h * stride_oh
+    tl.store(Out + offs_m[:, None] * stride_om + offs_d[None, :] * stride_ok,
+             acc.to(Out.dtype.element_ty), mask=offs_m[:, None] < N_CTX)
+
+
+@triton.jit
+def _bwd_preprocess(
+    Out, DO, Delta,
+    stride_oz, stride_oh, stride_om, stride_ok,
+    stride_doz, stride_doh, stride_dom, stride_dok,
+    H, N_CTX,
+    BLOCK_M: tl.constexpr, BLOCK_DMODEL: tl.constexpr
+):
+    start_m = tl.program_id(0)
+    off_hz = tl.program_id(1)
+    off_z = off_hz // H
+    off_h = off_hz % H
+    offs_m = start_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    offs_d = tl.arange(0, BLOCK_DMODEL)
+    mask = offs_m[:, None] < N_CTX
+    o = tl.load(Out + off_z * stride_oz + off_h * stride_oh + offs_m[:, None] * stride_om + offs_d[None, :] * stride_ok,
+                mask=mask, other=0.).to(tl.float32)
+    do = tl.load(DO + off_z * stride_doz + off_h * stride_doh + offs_m[:, None] * stride_dom + offs_d[None, :] * stride_dok,
+                 mask=mask, other=0.).to(tl.float32)
+    tl.store(Delta + off_hz * N_CTX + offs_m, tl.sum(o * do, 1), mask=offs_m < N_CTX)
+
+
+@triton.jit
+def _bwd_kernel_dk_dv(
+    Q, K, V, DO, DK, DV, L, Delta, SEQLENS, sm_scale,
+    stride_qz, stride_qh, stride_qm, stride_qk,
+    stride_kz, stride_kh, stride_kn, stride_kk,
+    stride_vz, stride_vh, stride_vn, stride_vk,
+    stride_doz, stride_doh, stride_dom, stride_dok,
+    H, N_CTX,
+    BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_DMODEL: tl.constexpr,
+    IS_CAUSAL: tl.constexpr
+):
+    start_n = tl.program_id(0)
+    off_hz = tl.program_id(1)
+    off_z = off_hz // H
+    off_h = off_hz % H
+    seqlen = N_CTX
+    if SEQLENS is not None:
+        seqlen = tl.load(SEQLENS + off_z)
+    offs_n = start_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    offs_m = tl.arange(0, BLOCK_M)
+    offs_d = tl.arange(0, BLOCK_DMODEL)
+    Q += off_z * stride_qz + off_h * stride_qh
+    K += off_z * stride_kz + off_h * stride_kh
+    V += off_z * stride_vz + off_h * stride_vh
+    DO += off_z * stride_doz + off_h * stride_doh
+    k = tl.load(K + offs_n[:, None] * stride_kn + offs_d[None, :] * stride_kk,
+                mask=offs_n[:, None] < seqlen, other=0.)
+    v = tl.load(V + offs_n[:, None] * stride_vn + offs_d[None, :] * stride_vk,
+                mask=offs_n[:, None] < seqlen, other=0.)
+    dk = tl.zeros([BLOCK_N, BLOCK_DMODEL], dtype=tl.float32)
+    dv = tl.zeros([BLOCK_N, BLOCK_DMODEL], dtype=tl.float32)
+    # queries that attend to this block of keys
+    begin_m = 0
+    if IS_CAUSAL:
+        begin_m = start_n * BLOCK_N // BLOCK_M * BLOCK_M
+    for start_m in range(begin_m, seqlen, BLOCK_M):
+        rows = start_m + offs_m
+        # transposed scores and probabilities
+        qt = tl.load(Q + rows[None, :] * stride_qm + offs_d[:, None] * stride_qk,
+                     mask=rows[None, :] < seqlen, other=0.)
+        lse = tl.load(L + off_hz * N_CTX + rows, mask=rows < seqlen, other=0.)
+        pt = tl.exp(tl.dot(k, qt) * sm_scale - lse[None, :])
+        valid = (rows[None, :] < seqlen) & (offs_n[:, None] < seqlen)
+        if IS_CAUSAL:
+            valid = valid & (rows[None, :] >= offs_n[:, None])
+        pt = tl.where(valid, pt, 0.)
+        do = tl.load(DO + rows[:, None] * stride_dom + offs_d[None, :] * stride_dok,
+                     mask=rows[:, None] < seqlen, other=0.)
+        dv += tl.dot(pt.to(DO.dtype.element_ty), do)
+        # gradient of the scores
+        dot_t = tl.load(DO + rows[None, :] * stride_dom + offs_d[:, None] * stride_dok,
+                        mask=rows[None, :] < seqlen, other=0.)
+        delta = tl.load(Delta + off_hz * N_CTX + rows, mask=rows < seqlen, other=0.)
+        dst = pt * (tl.dot(v, dot_t) - delta[None, :]) * sm_scale
+        q = tl.load(Q + rows[:, None] * stride_qm + offs_d[None, :] * stride_qk,
+                    mask=rows[:, None] < seqlen, other=0.)
+        dk += tl.dot(dst.to(Q.dtype.element_ty), q)
+    mask = offs_n[:, None] < N_CTX
+    DK += off_z * stride_kz + off_h * stride_kh
+    DV += off_z * stride_vz + off_h * stride_vh
+    tl.store(DK + offs_n[:, None] * stride_kn + offs_d[None, :] * stride_kk, dk.to(DK.dtype.element_ty), mask=mask)
+    tl.store(DV + offs_n[:, None] * stride_vn + offs_d[None, :] * stride_vk, dv.to(DV.dtype.element_ty), mask=mask)
+
+
+@triton.jit
+def _bwd_kernel_dq(
+    Q, K, V, DO, DQ, L, Delta, SEQLENS, sm_scale,
+    stride_qz, stride_qh, stride_qm, stride_qk,
+    stride_kz, stride_kh, stride_kn, stride_kk,
+    stride_vz, stride_vh, stride_vn, stride_vk,
+    stride_doz, stride_doh, stride_dom, stride_dok,
+    H, N_CTX,
+    BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_DMODEL: tl.constexpr,
+    IS_CAUSAL: tl.constexpr
+):
+    start_m = tl.program_id(0)
+    off_hz = tl.program_id(1)
+    off_z = off_hz // H
+    off_h = off_hz % H
+    seqlen = N_CTX
+    if SEQLENS is not None:
+        seqlen = tl.load(SEQLENS + off_z)
+    offs_m = start_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    offs_n = tl.arange(0, BLOCK_N)
+    offs_d = tl.arange(0, BLOCK_DMODEL)
+    Q += off_z * stride_qz + off_h * stride_qh
+    K += off_z * stride_kz + off_h * stride_kh
+    V += off_z * stride_vz + off_h * stride_vh
+    DO += off_z * stride_doz + off_h * stride_doh
+    q = tl.load(Q + offs_m[:, None] * stride_qm + offs_d[None, :] * stride_qk,
+                mask=offs_m[:, None] < seqlen, other=0.)
+    do = tl.load(DO + offs_m[:, None] * stride_dom + offs_d[None, :] * stride_dok,
+                 mask=offs_m[:, None] < seqlen, other=0.)
+    lse = tl.load(L + off_hz * N_CTX + offs_m, mask=offs_m < seqlen, other=0.)
+    delta = tl.load(Delta + off_hz * N_CTX + offs_m, mask=offs_m < seqlen, other=0.)
+    dq = tl.zeros([BLOCK_M, BLOCK_DMODEL], dtype=tl.float32)
+    end_n = seqlen
+    if IS_CAUSAL:
+        end_n = tl.minimum(seqlen, (start_m + 1) * BLOCK_M)
+    for start_n in range(0, end_n, BLOCK_N):
+        cols = start_n + offs_n
+        kt = tl.load(K + cols[None, :] * stride_kn + offs_d[:, None] * stride_kk,
+                     mask=cols[None, :] < seqlen, other=0.)
+        p = tl.exp(tl.dot(q, kt) * sm_scale - lse[:, None])
+        valid = (offs_m[:, None] < seqlen) & (cols[None, :] < seqlen)
+        if IS_CAUSAL:
+            valid = valid & (offs_m[:, None] >= cols[None, :])
+        p = tl.where(valid, p, 0.)
+        vt = tl.load(V + cols[None, :] * stride_vn + offs_d[:, None] * stride_vk,
+                     mask=cols[None, :] < seqlen, other=0.)
+        ds = p * (tl.dot(do, vt) - delta[:, None]) * sm_scale
+        k = tl.load(K + cols[:, None] * stride_kn + offs_d[None, :] * stride_kk,
+                    mask=cols[:, None] < seqlen, other=0.)
+        dq += tl.dot(ds.to(K.dtype.element_ty), k)
+    DQ += off_z * stride_qz + off_h * stride_qh
+    tl.store(DQ + offs_m[:, None] * stride_qm + offs_d[None, :] * stride_qk, dq.to(DQ.dtype.element_ty),
+             mask=offs_m[:, None] < N_CTX)
+
+
+class _attention(torch.autograd.Function):
+
+    BLOCK = 64
+
+    @staticmethod
+    def forward(ctx, q, k, v, sm_scale, causal, seqlens):
+        # gradients are allocated with the strides of the inputs
+        q, k, v = q.contiguous(), k.contiguous(), v.contiguous()
+        # shape constraints
+        Z, H, N_CTX, D = q.shape
+        if k.shape != q.shape or v.shape != q.shape:
+            raise ValueError(f"q, k and v must have the same shape (got {q.shape}, {k.shape}, {v.shape})")
+        if D not in {16, 32, 64, 128}:
+            raise ValueError(f"head dimension must be 16, 32, 64 or 128 (got {D})")
+        if sm_scale is None:
+            sm_scale = D ** -0.5
+        if seqlens is not None:
+            seqlens = seqlens.to(device=q.device, dtype=torch.int32).contiguous()
+        BLOCK = _attention.BLOCK
+        num_warps = 4 if D <= 64 else 8
+        o = torch.empty_like(q)
+        L = torch.empty((Z * H, N_CTX), device=q.device, dtype=torch.float32)
+        grid = (triton.cdiv(N_CTX, BLOCK), Z * H)
+        _fwd_kernel[grid](
+            q, k, v, o, L, seqlens, sm_scale,
+            q.stride(0), q.stride(1), q.stride(2), q.stride(3),
+            k.stride(0), k.stride(1), k.stride(2), k.stride(3),
+            v.stride(0), v.stride(1), v.stride(2), v.stride(3),
+            o.stride(0), o.stride(1), o.stride(2), o.stride(3),
+            H, N_CTX,
+            BLOCK_M=BLOCK, BLOCK_N=BLOCK, BLOCK_DMODEL=D,
+            IS_CAUSAL=causal, num_warps=num_warps, num_stages=2,
+        )
+        ctx.save_for_backward(q, k, v, o, L, seqlens)
+        ctx.sm_scale = sm_scale
+        ctx.causal = causal
+        ctx.num_warps = num_warps
+        return o
+
+    @staticmethod
+    def backward(ctx, do):
+        q, k, v, o, L, seqlens = ctx.saved_tensors
+        Z, H, N_CTX, D = q.shape
+        BLOCK = _attention.BLOCK
+        dq = torch.empty_like(q)
+        dk = torch.empty_like(k)
+        dv = torch.empty_like(v)
+        delta = torch.empty_like(L)
+        grid = (triton.cdiv(N_CTX, BLOCK), Z * H)
+        _bwd_preprocess[grid](
+            o, do, delta,
+            o.stride(0), o.stride(1), o.stride(2), o.stride(3),
+            do.stride(0), do.stride(1), do.stride(2), do.stride(3),
+            H, N_CTX,
+            BLOCK_M=BLOCK, BLOCK_DMODEL=D,
+        )
+        args = (
+            q.stride(0), q.stride(1), q.stride(2), q.stride(3),
+            k.stride(0), k.stride(1), k.stride(2), k.stride(3),
+            v.stride(0), v.stride(1), v.stride(2), v.stride(3),
+            do.stride(0), do.stride(1), do.stride(2), do.stride(3),
+            H, N_CTX,
+        )
+        # gradients are written by the program that owns their rows, so that
+        # no atomics are needed
+        _bwd_kernel_dk_dv[grid](
+            q, k, v, do, dk, dv, L, delta, seqlens, ctx.sm_scale, *args,
+            BLOCK_M=BLOCK, BLOCK_N=BLOCK, BLOCK_DMODEL=D,
+            IS_CAUSAL=ctx.causal, num_warps=ctx.num_warps, num_stages=1,
+        )
+        _bwd_kernel_dq[grid](
+            q, k, v, do, dq, L, delta, seqlens, ctx.sm_scale, *args,
+            BLOCK_M=BLOCK, BLOCK_N=BLOCK, BLOCK_DMODEL=D,
+            IS_CAUSAL=ctx.causal, num_warps=ctx.num_warps, num_stages=1,
+        )
+        return dq, dk, dv, None, None, None
+
+
+def attention(q, k, v, sm_scale=None, causal=False, seqlens=None):
+    """
+    Computes softmax(q @ k^T * sm_scale) @ v for tensors of shape (Z, H, N_CTX, D),
+    without materializing the N_CTX x N_CTX scores.
+
+    :param sm_scale: scale of the scores; defaults to 1 / sqrt(D)
+    :param causal: if True, queries only attend to keys at the same or earlier positions
+    :param seqlens: optional tensor of Z sequence lengths; keys past the length of their
+        sequence are ignored, and the outputs and gradients of padding positions are zeros
+    """
+    return _attention.apply(q, k, v, sm_scale, causal, seqlens)
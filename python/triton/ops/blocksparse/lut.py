@@ -0,0 +1,154 @@
+import torch
+
+import triton
+import triton.language as tl
+
+# ********************************************************
+# --------------------------------------------------------
+# On-device look-up table generation
+# Block-sparse layouts are viewed as H x S segments of E
+# blocks each (rows or columns of the layout). Segments
+# are counted, offset through a prefix sum and scattered
+# into a list of (head, segment, index) entries, so that
+# layouts that live on the GPU never go through the host
+# --------------------------------------------------------
+# ********************************************************
+
+
+@triton.jit
+def _lut_counts(
+    LAYOUT, stride_lh, stride_ls, stride_le,
+    COUNTS, S, E,
+    BLOCK: tl.constexpr
+):
+    sid = tl.program_id(0)
+    h = sid // S
+    s = sid % S
+    LAYOUT += h * stride_lh + s * stride_ls
+    count = 0
+    for start in range(0, E, BLOCK):
+        offs_e = start + tl.arange(0, BLOCK)
+        mask = tl.load(LAYOUT + offs_e * stride_le, mask=offs_e < E, other=0) != 0
+        count += tl.sum(mask.to(tl.int32), 0)
+    tl.store(COUNTS + sid, count)
+
+
+@triton.jit
+def _lut_offsets(
+    COUNTS, OFFSETS, n,
+    BLOCK: tl.constexpr
+):
+    # exclusive prefix sum of the counts; the total goes to OFFSETS[n]
+    carry = 0
+    for start in range(0, n, BLOCK):
+        offs = start + tl.arange(0, BLOCK)
+        counts = tl.load(COUNTS + offs, mask=offs < n, other=0)
+        tl.store(OFFSETS + offs, carry + tl.cumsum(counts, 0, exclusive=True), mask=offs < n)
+        carry += tl.sum(counts, 0)
+    tl.store(OFFSETS + n, carry)
+
+
+@triton.jit
+def _lut_scatter(
+    LAYOUT, stride_lh, stride_ls, stride_le,
+    OFFSETS, S, E,
+    ENTRIES,
+    RANK, stride_rh, stride_rs, stride_re,
+    BLOCK: tl.constexpr
+):
+    sid = tl.program_id(0)
+    h = sid // S
+    s = sid % S
+    LAYOUT += h * stride_lh + s * stride_ls
+    current = tl.load(OFFSETS + sid)
+    for start in range(0, E, BLOCK):
+        offs_e = start + tl.arange(0, BLOCK)
+        mask = tl.load(LAYOUT + offs_e * stride_le, mask=offs_e < E, other=0) != 0
+        mask = mask & (offs_e < E)
+        pos = current + tl.cumsum(mask.to(tl.int32), 0, exclusive=True)
+        # (head, segment, index) of each non-zero block
+        if ENTRIES is not None:
+            tl.store(ENTRIES + pos * 3 + 0, h + 0 * offs_e, mask=mask)
+            tl.store(ENTRIES + pos * 3 + 1, s + 0 * offs_e, mask=mask)
+            tl.store(ENTRIES + pos * 3 + 2, offs_e, mask=mask)
+        # position of each non-zero block in the traversal
+        if RANK is not None:
+            tl.store(RANK + h * stride_rh + s * stride_rs + offs_e * stride_re, pos, mask=mask)
+        current += tl.sum(mask.to(tl.int32), 0)
+
+
+def segments(layout, trans):
+    """
+    Returns the number of segments per head, the number of blocks per segment, and
+    the strides of a `layout` traversed along its rows (trans=False), or along its
+    columns (trans=True)
+    """
+    H, M, N = layout.shape
+    if trans:
+        return N, M, (layout.stride(0), layout.stride(2), layout.stride(1))
+    return M, N, (layout.stride(0), layout.stride(1), layout.stride(2))
+
+
+def device_lut(layout, trans=False, entries=True, rank=None):
+    """
+    Computes on the device of `layout` the number of non-zero blocks of each segment,
+    their offsets and, if `entries` is True, the (head, segment, index) of each
+    non-zero block, in the order of the traversal. `entries` is sized for a dense
+    layout, so that no synchronization with the host is needed; only its first
+    `offsets[-1]` rows are meaningful. If given, `rank` receives the position of each
+    non-zero block in the traversal, at its coordinates in the layout.
+    """
+    H = layout.shape[0]
+    S, E, strides = segments(layout, trans)
+    device = layout.device
+    counts = torch.empty(H * S, dtype=torch.int32, device=device)
+    offsets = torch.empty(H * S + 1, dtype=torch.int32, device=device)
+    BLOCK = min(max(triton.next_power_of_2(E), 16), 1024)
+    _lut_counts[(H * S,)](layout, *strides, counts, S, E, BLOCK=BLOCK)
+    _lut_offsets[(1,)](counts, offsets, H * S, BLOCK=1024, num_warps=4)
+    ret = None
+    if entries or rank is not None:
+        if entries:
+            ret = torch.empty((H * S * E, 3), dtype=torch.int32, device=device)
+        rank_strides = (1, 1, 1)
+        if rank is not None:
+            rank_strides = (rank.stride(0), rank.stride(2), rank.stride(1)) if trans else rank.stride()
+        _lut_scatter[(H * S,)](layout, *strides, offsets, S, E, ret, rank, *rank_strides, BLOCK=BLOCK)
+    return counts, offsets, ret
+
+
+@triton.jit
+def _dsd_lut_incs(
+    ENTRIES, NUM_BLOCKS,
+    RANK, stride_rh, stride_rs, stride_re,
+    INCS, block, step, a_step,
+    DIV: tl.constexpr, BLOCK: tl.constexpr
+):
+    n = tl.load(NUM_BLOCKS)
+    offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+    mask = offs < n
+    h = tl.load(ENTRIES + offs * 3 + 0, mask=mask, other=0)
+    s = tl.load(ENTRIES + offs * 3 + 1, mask=mask, other=0)
+    e = tl.load(ENTRIES + offs * 3 + 2, mask=mask, other=0)
+    has_prev = mask & (offs > 0)
+    prev_h = tl.load(ENTRIES + offs * 3 - 3, mask=has_prev, other=-1)
+    prev_s = tl.load(ENTRIES + offs * 3 - 2, mask=has_prev, other=-1)
+    prev_e = tl.load(ENTRIES + offs * 3 - 1, mask=has_prev, other=0)
+    # the first increment of each reduction is actually the offset
+    same = (prev_h == h) & (prev_s == s)
+    # dense input pointer increments
+    b_idx = e * block
+    b_inc = tl.where(same, b_idx - prev_e * block - (DIV - 1) * step, b_idx)
+    # sparse input pointer increments, in the row-major order of the blocks
+    a_idx = tl.load(RANK + h * stride_rh + s * stride_rs + e * stride_re, mask=mask, other=0)
+    prev_a_idx = tl.load(RANK + prev_h * stride_rh + prev_s * stride_rs + prev_e * stride_re,
+                         mask=same, other=0)
+    a_inc = tl.where(same, (a_idx - prev_a_idx) * block * block - (DIV - 1) * a_step, a_idx)
+    # the remaining steps of a block move by a constant amount
+    offs_d = tl.arange(0, DIV)
+    is_head = (offs[:, None] * 0 + offs_d[None, :]) == 0
+    b_incs = tl.where(is_head, b_inc[:, None], step)
+    a_incs = tl.where(is_head, a_inc[:, None], a_step)
+    pincs = INCS + (offs[:, None] * DIV + offs_d[None, :]) * 2
+    tl.store(pincs + 0, b_incs, mask=mask[:, None])
+    tl.store(pincs + 1, a_incs, mask=mask[:, None])
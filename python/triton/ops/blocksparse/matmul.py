@@ -3,6 +3,8 @@ import torch
 import triton
 import triton.language as tl
 
+from .lut import _dsd_lut_incs, device_lut
+
 # ********************************************************
 # --------------------------------------------------------
 # Sparse = Dense x Dense (SDD)
@@ -116,6 +118,11 @@ def sdd_matmul(a, b, trans_a, trans_b, trans_c, spdims, block, lut, widths, out=
 
 
 def sdd_lut(layout, block, device):
+    if layout.is_cuda:
+        # the number of blocks sets the shape of the output
+        _, offsets, entries = device_lut(layout)
+        lut = entries[:int(offsets[-1])]
+        return lut.to(device), None
     lut = layout.nonzero(as_tuple=False).to(device).int()
     lut = lut.contiguous()
     return lut, None
@@ -135,7 +142,7 @@ def _dsd_kernel(
     stride_zc, stride_hc, stride_cm, stride_cn,
     DS0, DS1, lut,
     TILE_M: tl.constexpr, TILE_N: tl.constexpr, TILE_K: tl.constexpr,
-    GROUP_SIZE_M: tl.constexpr, BLOCK: tl.constexpr
+    GROUP_SIZE_M: tl.constexpr, BLOCK: tl.constexpr, ATOMIC: tl.constexpr
 ):
     # ------------ #
     # - Prologue - #
@@ -200,10 +207,16 @@ def _dsd_kernel(
         + pidz * stride_zc \
         + offs_cm[:, None] * stride_cm \
         + offs_cn[None, :] * stride_cn
-    tl.store(pc, c, mask=offs_cn[None, :] < DS0)
+    # partial results of split rows are accumulated
+    if ATOMIC:
+        tl.atomic_add(pc, c, mask=offs_cn[None, :] < DS0)
+    else:
+        tl.store(pc, c, mask=offs_cn[None, :] < DS0)
 
 
 def dsd_matmul(a, b, trans_a, trans_b, trans_c, spdims, block, lut, width, out=None):
+    # look-up tables that split rows come with their chunk size
+    width, chunk = width if isinstance(width, tuple) else (width, None)
     if a.stride(2) != 1 and a.stride(3) != 1:
         a = a.contiguous()
     if b.stride(2) != 1 and b.stride(3) != 1:
@@ -224,24 +237,33 @@ def dsd_matmul(a, b, trans_a, trans_b, trans_c, spdims, block, lut, width, out=N
     else:
         assert out.shape == (CS0, CS1, CS2, CS3)
         c = out
+    # split rows are accumulated in float32
+    atomic = chunk is not None
+    if atomic:
+        acc = c.zero_() if dtype == torch.float32 else torch.zeros(c.shape, dtype=torch.float32, device=a.device)
+    else:
+        acc = c
+    if width == 0:
+        return c
     # meta-parameter heuristics
     TILE_N = 128
     # compute output
     grid = lambda meta: [triton.cdiv(BS3, meta['TILE_N']), width, BS0]
     _dsd_kernel[grid](
-        a, b, c,
+        a, b, acc,
         a.stride(0), a.stride(1), a.stride(3 if trans_a else 2), a.stride(2 if trans_a else 3),
         b.stride(0), b.stride(1), b.stride(3 if trans_b else 2), b.stride(2 if trans_b else 3),
-        c.stride(0), c.stride(1), c.stride(3 if trans_c else 2), c.stride(2 if trans_c else 3),
+        acc.stride(0), acc.stride(1), acc.stride(3 if trans_c else 2), acc.stride(2 if trans_c else 3),
         BS3, AS1, lut,
         TILE_M=block, TILE_N=TILE_N, TILE_K=min(block, 32), BLOCK=block, num_stages=4,
-        num_warps=4, GROUP_SIZE_M=4,
+        num_warps=4, GROUP_SIZE_M=4, ATOMIC=atomic,
     )
-    # exit()
+    if acc is not c:
+        c.copy_(acc)
     return c
 
 
-def dsd_lut(layout, block, step, trans, device):
+def dsd_lut(layout, block, step, trans, device, chunk=None):
     """
     Generates the look-up table for incrementing pointers in the DSD/DDS matmul.
     Example (BLOCK=32, STEP=16)
@@ -264,10 +286,26 @@ def dsd_lut(layout, block, step, trans, device):
     [0, 16, 96, 112] <- row 0
     [32, 48, 64, 80]  <- row 1
     [0, 16, 64, 80]   <- row 2
+
+    Layouts that live on the GPU get their look-up table computed on device.
+
+    If `chunk` is given, rows longer than `chunk` blocks are split in several
+    reductions, whose partial results are accumulated atomically, so that irregular
+    layouts give each program a similar amount of work; empty rows are dropped.
     """
+    if layout.is_cuda and chunk is None:
+        return dsd_lut_device(layout, block, step, trans, device)
     sizes = torch.sum(layout, 2 if trans else 1)
     head_id, col_id = torch.ones_like(sizes).nonzero(as_tuple=True)
     sizes = sizes.flatten()
+    if chunk is not None:
+        num_chunks = (sizes + chunk - 1) // chunk
+        head_id = head_id.repeat_interleave(num_chunks)
+        col_id = col_id.repeat_interleave(num_chunks)
+        segment_id = torch.arange(sizes.numel(), device=layout.device).repeat_interleave(num_chunks)
+        start = torch.cumsum(num_chunks, 0) - num_chunks
+        chunk_id = torch.arange(segment_id.numel(), device=layout.device) - start[segment_id]
+        sizes = torch.clamp(sizes[segment_id] - chunk_id * chunk, max=chunk)
     segments = sizes * step
     # pointer increments
     if trans:
@@ -335,8 +373,44 @@ def dsd_lut(layout, block, step, trans, device):
     lut = torch.cat((header, incs))
     lut = lut.type(torch.int32).to(device)
     # create locks
+    if chunk is not None:
+        return lut, (width, chunk)
     return lut, width
 
+
+def dsd_lut_device(layout, block, step, trans, device):
+    # same look-up table as above, built on device without synchronizing with
+    # the host. The increments are sized for a dense layout, and are followed by
+    # zeros, which accomodate pre-fetching inside the kernel
+    H, M, N = layout.shape
+    div = block // step
+    # blocks of A are numbered in row-major order
+    rank = torch.empty((H, M, N), dtype=torch.int32, device=layout.device)
+    if trans:
+        sizes, offsets, entries = device_lut(layout, rank=rank)
+    else:
+        device_lut(layout, entries=False, rank=rank)
+        sizes, offsets, entries = device_lut(layout, trans=True)
+    num_segments = sizes.shape[0]
+    width = num_segments
+    num_blocks = offsets[-1:]
+    # create header
+    head_id = torch.arange(H, device=layout.device).repeat_interleave(num_segments // H)
+    col_id = torch.arange(num_segments // H, device=layout.device).repeat(H)
+    offsets = torch.minimum(offsets[:-1], num_blocks - 1) * 2 * div + 4 * width
+    segments = sizes * step * div
+    header = torch.stack((offsets, segments, col_id.int(), head_id.int()), dim=1).view(-1)
+    # create increments
+    lut = torch.zeros(4 * width + 2 * div * H * M * N + 20, dtype=torch.int32, device=layout.device)
+    lut[:4 * width] = header
+    rank_strides = rank.stride() if trans else (rank.stride(0), rank.stride(2), rank.stride(1))
+    a_step = step if trans else step * block
+    BLOCK = 128
+    grid = (triton.cdiv(H * M * N, BLOCK),)
+    _dsd_lut_incs[grid](entries, num_blocks, rank, *rank_strides, lut[4 * width:], block, step, a_step,
+                        DIV=div, BLOCK=BLOCK)
+    return lut.to(device), width
+
 # -----------------------------
 # Dense = Dense x Sparse (DDS)
 # -----------------------------
@@ -400,9 +474,32 @@ class _matmul(torch.autograd.Function):
             None, None, None, None, None, dout
 
 
+def balanced_chunk(layout):
+    """
+    Returns the number of blocks per reduction that evens out the work of the rows and
+    columns of `layout`, or None if they are balanced enough already
+    """
+    chunk = None
+    for dim in [1, 2]:
+        sizes = layout.sum(dim).flatten()
+        sizes = sizes[sizes > 0]
+        if sizes.numel() == 0:
+            continue
+        mean = max(1, int(sizes.float().mean().ceil()))
+        if 2 * int(sizes.max()) > 3 * mean:
+            chunk = mean if chunk is None else min(chunk, mean)
+    return chunk
+
+
 class matmul:
+    """
+    Block-sparse matrix multiplication. With `load_balance`, the long rows (or columns)
+    of irregular layouts are split in chunks of similar size, processed by different
+    programs and accumulated atomically. `load_balance` may also be the number of
+    non-zero blocks per chunk.
+    """
 
-    def __init__(self, layout, block, mode, device, trans_a=False, trans_b=False, trans_c=False):
+    def __init__(self, layout, block, mode, device, trans_a=False, trans_b=False, trans_c=False, load_balance=False):
         if mode not in ['sdd', 'dsd', 'dds']:
             raise NotImplementedError('Supported modes are: sdd, dsd, dds')
         self.block = block
@@ -413,17 +510,22 @@ class matmul:
         self.layout = layout
         self.spdims = layout.shape
         step = min(block, 32)
+        chunk = None
+        if load_balance is True:
+            chunk = balanced_chunk(layout)
+        elif load_balance:
+            chunk = int(load_balance)
         if self.mode == 'sdd':
             self.c_lut, self.c_width = sdd_lut(layout, block, device)
-            self.da_lut, self.da_width = dsd_lut(layout, block, step, True, device)
-            self.db_lut, self.db_width = dsd_lut(layout, block, step, False, device)
+            self.da_lut, self.da_width = dsd_lut(layout, block, step, True, device, chunk)
+            self.db_lut, self.db_width = dsd_lut(layout, block, step, False, device, chunk)
         if self.mode == 'dsd':
-            self.c_lut, self.c_width = dsd_lut(layout, block, step, not self.trans_a, device)
+            self.c_lut, self.c_width = dsd_lut(layout, block, step, not self.trans_a, device, chunk)
             self.da_lut, self.da_width = sdd_lut(layout, block, device)
-            self.db_lut, self.db_width = dsd_lut(layout, block, step, self.trans_a, device)
+            self.db_lut, self.db_width = dsd_lut(layout, block, step, self.trans_a, device, chunk)
         if self.mode == 'dds':
-            self.c_lut, self.c_width = dsd_lut(layout, block, step, self.trans_b, device)
-            self.da_lut, self.da_width = dsd_lut(layout, block, step, not self.trans_b, device)
+            self.c_lut, self.c_width = dsd_lut(layout, block, step, self.trans_b, device, chunk)
+            self.da_lut, self.da_width = dsd_lut(layout, block, step, not self.trans_b, device, chunk)
             self.db_lut, self.db_width = sdd_lut(layout, block, device)
 
     def __call__(self, a, b, out=None):
@@ -3,6 +3,8 @@ import torch
 import triton
 import triton.language as tl
 
+from .lut import device_lut
+
 
 def num_warps(n):
     if n <= 128:
@@ -21,9 +23,11 @@ def _blocksparse_softmax_fwd(
     Out, A, stride_xz, LUT,
     R, extent, stride_zr, stride_hr,  # relative attention
     scale, is_causal,
+    Y, dropout_p, seed,  # dropout
     ROW_SIZE: tl.constexpr,
     BLOCK_SIZE: tl.constexpr,
     IS_DENSE: tl.constexpr,
+    DROPOUT: tl.constexpr,
 ):
     h = tl.program_id(0)
     m = tl.program_id(1)
@@ -67,6 +71,12 @@ def _blocksparse_softmax_fwd(
     out = tl.where((ns > m) & is_causal, -float("inf"), out)
     # computation
     out = tl.softmax(out)
+    # apply dropout; the probabilities are kept for the backward pass,
+    # which draws the same mask from the same offsets
+    if DROPOUT:
+        tl.store(Y + off_a + lane_n, out, mask=mask)
+        keep = tl.rand(seed, off_a + lane_n) > dropout_p
+        out = tl.where(keep, out / (1 - dropout_p), 0.)
     # write-back
     tl.store(Out + off_a + lane_n, out, mask=mask)
 
@@ -80,9 +90,11 @@ def _blocksparse_softmax_bwd(
     LUT,
     DR, extent, stride_zr, stride_hr, stride_er,
     is_causal,
+    dropout_p, seed,
     ROW_SIZE: tl.constexpr,
     BLOCK_SIZE: tl.constexpr,
     IS_DENSE: tl.constexpr,
+    DROPOUT: tl.constexpr,
 ):
     h = tl.program_id(0)
     m = tl.program_id(1)
@@ -114,6 +126,10 @@ def _blocksparse_softmax_bwd(
     a = a.to(tl.float32)
     dout = tl.load(DOuts + lane_n, mask=mask, other=0.0)
     dout = dout.to(tl.float32)
+    # regenerate the dropout mask
+    if DROPOUT:
+        keep = tl.rand(seed, z * stride_zout + off_mn + lane_n) > dropout_p
+        dout = tl.where(keep, dout / (1 - dropout_p), 0.)
     # compute
     da = a * (dout - tl.sum(a * dout, 0))
     da = tl.where((ns > m) & is_causal, 0., da)
@@ -134,6 +150,8 @@ def _blocksparse_softmax_bwd(
 class _softmax(torch.autograd.Function):
     @staticmethod
     def make_lut(layout, block, device):
+        if layout.is_cuda:
+            return _softmax.make_lut_device(layout, block, device)
         _empty = torch.tensor([], dtype=torch.int64, device=layout.device)
         sizes = _empty.clone()
         # sizes along rows
@@ -149,10 +167,21 @@ class _softmax(torch.autograd.Function):
         lut = torch.cat((header, columns)).type(torch.int32).to(device)
         return lut, int(total_sizes.max())
 
+    @staticmethod
+    def make_lut_device(layout, block, device):
+        # same look-up table as above, built on device; the block indices
+        # are sized for a dense layout
+        sizes, offsets, entries = device_lut(layout)
+        header = torch.stack((sizes, offsets[:-1]), dim=1).view(-1)
+        lut = torch.cat((header, entries[:, 2]))
+        # the row size is a compile-time constant of the kernels
+        return lut.to(device), int(sizes.max()) * block
+
     @staticmethod
     def forward(
         ctx, a, scale, rel_logits, is_causal,
-        spdims, block, lut, maxlut, is_dense
+        spdims, block, lut, maxlut, is_dense,
+        dropout_p, seed
     ):
         if scale is not None and isinstance(scale, torch.Tensor):
             assert scale.device.type == "cpu"
@@ -163,19 +192,23 @@ class _softmax(torch.autograd.Function):
         rel_strides = (1, 1, 1, 1) if rel_logits is None else rel_logits.stride()
         # enqueue kernel
         out = torch.empty_like(a)
+        # probabilities before dropout
+        probs = torch.empty_like(a) if dropout_p > 0 else out
         _blocksparse_softmax_fwd[grid](
             out, a, a.stride(0), lut,
             rel_logits, rel_shape[-1], rel_strides[0], rel_strides[1],  # relative attn
             scale,
             is_causal,
+            probs, dropout_p, seed,
             BLOCK_SIZE=block,
             ROW_SIZE=triton.next_power_of_2(maxlut),
             IS_DENSE=is_dense,
+            DROPOUT=dropout_p > 0,
             num_warps=num_warps(maxlut)
         )
         # save to context
         # ctx.mark_dirty(x)
-        ctx.save_for_backward(out, lut)
+        ctx.save_for_backward(probs, lut)
         ctx.spdims = spdims
         ctx.block = block
         ctx.maxlut = maxlut
@@ -185,6 +218,8 @@ class _softmax(torch.autograd.Function):
         ctx.rel_dtype = a.dtype
         ctx.is_dense = is_dense
         ctx.is_causal = is_causal
+        ctx.dropout_p = dropout_p
+        ctx.seed = seed
         return out
 
     @staticmethod
@@ -207,9 +242,11 @@ class _softmax(torch.autograd.Function):
             lut,
             dr, ctx.rel_shape[-1], ctx.rel_strides[0], ctx.rel_strides[1], ctx.rel_strides[2],
             ctx.is_causal,
+            ctx.dropout_p, ctx.seed,
             BLOCK_SIZE=ctx.block,
             ROW_SIZE=triton.next_power_of_2(ctx.maxlut),
             IS_DENSE=ctx.is_dense,
+            DROPOUT=ctx.dropout_p > 0,
             num_warps=num_warps(ctx.maxlut)
         )
         return (da, None, None, dr, None,
@@ -229,11 +266,22 @@ class softmax:
         self.lut, self.maxlut = _softmax.make_lut(self.layout, self.block, device)
         self.is_dense = is_dense
 
-    def __call__(self, a, *, scale=1.0, rel_logits=None, is_causal=False):
+    def __call__(self, a, *, scale=1.0, rel_logits=None, is_causal=False, dropout_p=0.0, seed=None):
+        """
+        Computes the softmax of the rows of `a`. Elements of the result are zeroed with
+        probability `dropout_p`, and the others are scaled by 1 / (1 - dropout_p). The mask
+        is drawn on the fly from `seed`, which defaults to a draw from torch's generator,
+        and is never stored.
+        """
         if rel_logits is not None and rel_logits.dtype != a.dtype:
             raise ValueError("relative position embedding must be %s" % a.dtype)
+        if not 0 <= dropout_p < 1:
+            raise ValueError(f"dropout probability must be in [0, 1), got {dropout_p}")
+        if seed is None:
+            seed = int(torch.randint(2**31, (1,))) if dropout_p > 0 else 0
         a = _softmax.apply(
             a, scale, rel_logits, is_causal,
             self.spdims, self.block, self.lut, self.maxlut, self.is_dense,
+            dropout_p, seed,
         )
         return a
@@ -0,0 +1,157 @@
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+# ********************************************************
+# --------------------------------------------------------
+# Collectives over peer-to-peer memory
+# The GPUs of a process exchange data without any
+# communication library: each program reads its chunks
+# from the memory of every peer, after a handshake on
+# flags in the peers' memory. Program p of each rank sets
+# its arrival flag on every peer, waits until program p
+# of every peer has arrived, reads, and then waits until
+# every peer is done reading before it returns, so that
+# inputs can be reused once the kernel is over. Flags hold
+# the epoch of the last call, and need no reset
+# --------------------------------------------------------
+# ********************************************************
+
+
+@triton.jit
+def _signal(Flags, FlagPtrs, offset, epoch, WORLD: tl.constexpr):
+    # writes before the signal are visible to the peers that see it
+    tl.fence(scope='sys')
+    for q in range(WORLD):
+        flags = tl.load(FlagPtrs + q).to(Flags.dtype)
+        tl.atomic_xchg(flags + offset, epoch, scope='sys')
+
+
+@triton.jit
+def _wait(Flags, epoch, stride, WORLD: tl.constexpr):
+    for q in range(WORLD):
+        while tl.atomic_cas(Flags + q * stride, epoch, epoch, scope='sys') != epoch:
+            pass
+    tl.fence(scope='sys')
+
+
+@triton.jit
+def _collective(InPtrs, Out, FlagPtrs, Flags, rank, N, epoch,
+                OP: tl.constexpr, WORLD: tl.constexpr, BLOCK: tl.constexpr):
+    pid = tl.program_id(0)
+    num_programs = tl.num_programs(0)
+    # flags of the arrivals, then of the departures, of program `pid` of each rank
+    _signal(Flags, FlagPtrs, rank * num_programs + pid, epoch, WORLD)
+    _wait(Flags + pid, epoch, num_programs, WORLD)
+    cols = tl.arange(0, BLOCK)
+    for off in range(pid * BLOCK, N, num_programs * BLOCK):
+        offs = off + cols
+        mask = offs < N
+        if OP == 'all_reduce':
+            acc = tl.zeros([BLOCK], dtype=tl.float32)
+            for q in range(WORLD):
+                X = tl.load(InPtrs + q).to(Out.dtype)
+                acc += tl.load(X + offs, mask=mask, other=0., cache_modifier='.cg').to(tl.float32)
+            tl.store(Out + offs, acc.to(Out.dtype.element_ty), mask=mask)
+        else:
+            for q in range(WORLD):
+                X = tl.load(InPtrs + q).to(Out.dtype)
+                x = tl.load(X + offs, mask=mask, cache_modifier='.cg')
+                tl.store(Out + q * N + offs, x, mask=mask)
+    _signal(Flags, FlagPtrs, (WORLD + rank) * num_programs + pid, epoch, WORLD)
+    _wait(Flags + WORLD * num_programs + pid, epoch, num_programs, WORLD)
+
+
+class Communicator:
+    """
+    Collectives between the GPUs `devices` of this process, which must all be able to access
+    the memory of each other. Calls take one tensor per device, in the order of `devices`, and
+    run one kernel per device on its current stream; these kernels wait for each other, so
+    the streams must not wait on work that is queued after them.
+    """
+
+    def __init__(self, devices, num_programs=None):
+        self.devices = [torch.device('cuda', d) if isinstance(d, int) else torch.device(d) for d in devices]
+        self.world = len(self.devices)
+        for d in self.devices:
+            for p in self.devices:
+                if d != p and not torch.cuda.can_device_access_peer(d.index, p.index):
+                    raise RuntimeError(f"{d} cannot access the memory of {p}")
+        # every program spins on flags, so all of them must be resident at once
+        if num_programs is None:
+            num_programs = min(_triton.runtime.num_sm(_triton.runtime.backend.CUDA, d.index) for d in self.devices)
+        self.num_programs = num_programs
+        self.flags = [torch.zeros(2 * self.world * num_programs, dtype=torch.int32, device=d) for d in self.devices]
+        self.flag_ptrs = [torch.tensor([f.data_ptr() for f in self.flags], dtype=torch.int64, device=d)
+                          for d in self.devices]
+        for d in self.devices:
+            with torch.cuda.device(d):
+                for f in self.flags:
+                    if f.device != d:
+                        _triton.runtime.enable_peer_access(_triton.runtime.backend.CUDA, f.data_ptr())
+        self.epoch = 0
+
+    def _call(self, tensors, outs, op):
+        if len(tensors) != self.world:
+            raise ValueError(f"expected {self.world} tensors, one per device, got {len(tensors)}")
+        for x, d in zip(tensors, self.devices):
+            if x.device != d or x.shape != tensors[0].shape or x.dtype != tensors[0].dtype or not x.is_contiguous():
+                raise ValueError("tensors must be contiguous, on their devices, with the same shape and dtype")
+        # flags are compared for equality, and 0 is the value they start with
+        self.epoch = self.epoch % (2**31 - 1) + 1
+        N = tensors[0].numel()
+        BLOCK = 1024
+        for rank, d in enumerate(self.devices):
+            with torch.cuda.device(d):
+                for x in tensors:
+                    if x.device != d:
+                        _triton.runtime.enable_peer_access(_triton.runtime.backend.CUDA, x.data_ptr())
+                in_ptrs = torch.tensor([x.data_ptr() for x in tensors], dtype=torch.int64, device=d)
+                _collective[(self.num_programs,)](in_ptrs, outs[rank], self.flag_ptrs[rank], self.flags[rank],
+                                                  rank, N, self.epoch, OP=op, WORLD=self.world, BLOCK=BLOCK,
+                                                  num_warps=4)
+        return outs
+
+    def all_reduce(self, tensors):
+        """
+        Returns, on each device, the sum of `tensors`, accumulated in float32
+        """
+        if not tensors[0].dtype.is_floating_point:
+            raise ValueError("only floating-point tensors can be reduced")
+        outs = [torch.empty_like(x) for x in tensors]
+        return self._call(tensors, outs, 'all_reduce')
+
+    def all_gather(self, tensors):
+        """
+        Returns, on each device, `tensors` stacked along a new first dimension
+        """
+        outs = [torch.empty((self.world,) + tuple(x.shape), dtype=x.dtype, device=x.device) for x in tensors]
+        return self._call(tensors, outs, 'all_gather')
+
+
+_communicators = dict()
+
+
+def _communicator(tensors):
+    devices = tuple(x.device for x in tensors)
+    if devices not in _communicators:
+        _communicators[devices] = Communicator(devices)
+    return _communicators[devices]
+
+
+def all_reduce(tensors):
+    """
+    Sums `tensors`, one per GPU of this process, and returns the result on each of these GPUs.
+    The GPUs read each other's inputs through peer-to-peer memory accesses.
+    """
+    return _communicator(tensors).all_reduce(tensors)
+
+
+def all_gather(tensors):
+    """
+    Stacks `tensors`, one per GPU of this process, and returns the result on each of these GPUs.
+    The GPUs read each other's inputs through peer-to-peer memory accesses.
+    """
+    return _communicator(tensors).all_gather(tensors)
@@ -23,6 +23,11 @@ def num_warps(N):
     return 16
 
 
+# rows longer than this are streamed in chunks of CHUNK_SIZE columns
+MAX_BLOCK = 8192
+CHUNK_SIZE = 4096
+
+
 @triton.heuristics({'num_warps': lambda nargs: num_warps(nargs['N'])})
 @triton.heuristics({'BLOCK': lambda nargs: next_power_of_2(nargs['N'])})
 @triton.jit
@@ -68,6 +73,56 @@ def _backward(PROBS, IDX, DPROBS, N, BLOCK: tl.constexpr):
     tl.store(PROBS, din.to(tl.float16), mask=cols < N)
 
 
+# ---------------------------------------------
+# Chunked variant for large vocabularies:
+# rows are streamed in BLOCK-sized pieces, with
+# an online maximum and sum of exponentials, and
+# only the log-sum-exp of each row is kept for
+# the backward pass
+# ---------------------------------------------
+
+
+@triton.jit
+def _forward_chunked(LOGITS, IDX, LOSS, LSE, N, BLOCK: tl.constexpr):
+    row = tl.program_id(0)
+    cols = tl.arange(0, BLOCK)
+    LOGITS = LOGITS + row * N
+    m = tl.zeros([BLOCK], dtype=tl.float32) - float('inf')
+    s = tl.zeros([BLOCK], dtype=tl.float32)
+    for start in range(0, N, BLOCK):
+        logits = tl.load(LOGITS + start + cols, mask=start + cols < N, other=-float('inf'))
+        logits = logits.to(tl.float32)
+        # every column tracks its own maximum, and columns are merged at the end
+        m_new = tl.maximum(m, logits)
+        # columns that have only seen padding stay at zero
+        m_safe = tl.where(m_new == -float('inf'), 0., m_new)
+        s = s * tl.exp(m - m_safe) + tl.exp(logits - m_safe)
+        m = m_new
+    m_row = tl.max(m, 0)
+    lse = m_row + tl.log(tl.sum(s * tl.exp(m - m_row), 0))
+    idx = tl.load(IDX + row)
+    logit = tl.load(LOGITS + idx).to(tl.float32)
+    tl.store(LSE + row, lse)
+    tl.store(LOSS + row, lse - logit)
+
+
+@triton.jit
+def _backward_chunked(LOGITS, LSE, IDX, DLOSS, DLOGITS, N, BLOCK: tl.constexpr):
+    row = tl.program_id(0)
+    cols = tl.arange(0, BLOCK)
+    idx = tl.load(IDX + row)
+    lse = tl.load(LSE + row)
+    dout = tl.load(DLOSS + row)
+    LOGITS = LOGITS + row * N
+    DLOGITS = DLOGITS + row * N
+    for start in range(0, N, BLOCK):
+        mask = start + cols < N
+        logits = tl.load(LOGITS + start + cols, mask=mask, other=0.)
+        probs = tl.exp(logits.to(tl.float32) - lse)
+        din = (probs - (start + cols == idx)) * dout
+        tl.store(DLOGITS + start + cols, din.to(DLOGITS.dtype.element_ty), mask=mask)
+
+
 class _cross_entropy(torch.autograd.Function):
     @classmethod
     def forward(cls, ctx, logits, indices):
@@ -78,8 +133,14 @@ class _cross_entropy(torch.autograd.Function):
         n_cols = logits.shape[-1]
         # run the kernel
         result = torch.empty_like(indices, dtype=dtype, device=device)
-        neg_logprobs = torch.empty_like(logits, dtype=dtype, device=device)
         grid = lambda opt: (logits.numel() // n_cols, )
+        ctx.chunked = n_cols > MAX_BLOCK
+        if ctx.chunked:
+            lse = torch.empty(logits.numel() // n_cols, dtype=torch.float32, device=device)
+            _forward_chunked[grid](logits, indices, result, lse, n_cols, BLOCK=CHUNK_SIZE, num_warps=8)
+            ctx.save_for_backward(logits, lse, indices)
+            return result
+        neg_logprobs = torch.empty_like(logits, dtype=dtype, device=device)
         _forward[grid](logits, neg_logprobs, indices, result, n_cols)
         # save for backward
         ctx.save_for_backward(neg_logprobs, indices)
@@ -91,7 +152,16 @@ class _cross_entropy(torch.autograd.Function):
         so we initialize the gradient as neg_logprobs, so we can just exponentiate
         to get p[k], which is most of what we need...  neg_logprobs will be
         modified in place to become the gradient we want
+
+        In the chunked variant, p[k] is recomputed from the logits and the log-sum-exp
         """
+        if ctx.chunked:
+            logits, lse, indices = ctx.saved_tensors
+            n_cols = logits.shape[-1]
+            dlogits = torch.empty_like(logits)
+            grid = lambda opt: (logits.numel() // n_cols, )
+            _backward_chunked[grid](logits, lse, indices, dneg_logprobs, dlogits, n_cols, BLOCK=CHUNK_SIZE, num_warps=8)
+            return dlogits, None
         # load saved tensors
         neg_logprobs, indices = ctx.saved_tensors
         # run the kernel
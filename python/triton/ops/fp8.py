@@ -0,0 +1,107 @@
+import torch
+
+import triton
+import triton.language as tl
+
+# largest finite value of tl.float8, whose exponent holds the
+# 4 low-order bits of that of float16
+FP8_MAX = 1.875
+
+
+# ********************************************************
+# --------------------------------------------------------
+# FP8 quantization with delayed scaling
+# Tensors are cast with the scale of the previous step, and
+# the amax that sets the scale of the next step is reduced
+# in the same pass: each program folds the maximum of its
+# tile into the global one with a single atomic
+# --------------------------------------------------------
+# ********************************************************
+
+
+@triton.jit
+def _quantize_kernel(
+    X, Y, YT, Scale, Amax,
+    M, N,
+    stride_xm, stride_xn,
+    stride_ym, stride_yn,
+    stride_ytn, stride_ytm,
+    BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr,
+    TRANSPOSE: tl.constexpr, FP8_MAX: tl.constexpr
+):
+    pid_m = tl.program_id(0)
+    pid_n = tl.program_id(1)
+    rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    mask = (rm < M)[:, None] & (rn < N)[None, :]
+    x = tl.load(X + rm[:, None] * stride_xm + rn[None, :] * stride_xn, mask=mask, other=0.).to(tl.float32)
+    scale = tl.load(Scale)
+    # values past the range of float8 saturate
+    y = tl.minimum(tl.maximum(x * scale, -FP8_MAX), FP8_MAX).to(Y.dtype.element_ty)
+    tl.store(Y + rm[:, None] * stride_ym + rn[None, :] * stride_yn, y, mask=mask)
+    if TRANSPOSE:
+        tl.store(YT + rn[None, :] * stride_ytn + rm[:, None] * stride_ytm, y, mask=mask)
+    # amax is non-negative, so its bits are ordered like int32s
+    amax = tl.max(tl.max(tl.abs(x), 1), 0)
+    tl.atomic_max(Amax.to(tl.pointer_type(tl.int32)), amax.to(tl.int32, bitcast=True))
+
+
+def fp8_quantize(x, scale, amax=None, transpose=False):
+    """
+    Casts `x * scale` to float8 in one pass, saturating at FP8_MAX, and reduces the
+    maximum of |x| into `amax`, as in the delayed scaling of FP8 training.
+
+    :param x: tensor of float16, bfloat16 or float32, read as a (M, N) matrix whose
+        rows are its last dimension
+    :param scale: float32 tensor of one element, usually computed from the amax of
+        the previous steps by `fp8_update_scale`
+    :param amax: float32 tensor of one element, that receives the maximum of its value
+        and of |x|; a zero one is allocated when None
+    :param transpose: also returns the (N, M) transpose of the result, as needed by
+        the other operand of the backward GEMMs
+    :return: the float8 bits as int8 tensors of the shape of `x` and its transpose,
+        read by kernels through `triton.reinterpret(y, tl.float8)`, and `amax`
+    """
+    if x.dtype not in [torch.float16, torch.bfloat16, torch.float32]:
+        raise ValueError(f"fp8_quantize expects a float16, bfloat16 or float32 tensor (got {x.dtype})")
+    if not torch.is_tensor(scale):
+        scale = torch.tensor([scale], dtype=torch.float32, device=x.device)
+    if amax is None:
+        amax = torch.zeros(1, dtype=torch.float32, device=x.device)
+    if scale.dtype != torch.float32 or amax.dtype != torch.float32:
+        raise ValueError("scale and amax must be float32 tensors")
+    N = x.shape[-1] if x.dim() > 0 else 1
+    x2 = x.reshape(-1, N)
+    M = x2.shape[0]
+    y = torch.empty(x.shape, dtype=torch.int8, device=x.device)
+    y2 = y.view(M, N)
+    yt = torch.empty((N, M), dtype=torch.int8, device=x.device) if transpose else None
+    # the transposed copy goes through shared memory, which square tiles use best
+    BLOCK_M, BLOCK_N = (64, 64) if transpose else (32, 128)
+    grid = (triton.cdiv(M, BLOCK_M), triton.cdiv(N, BLOCK_N))
+    _quantize_kernel[grid](
+        x2, triton.reinterpret(y2, tl.float8), triton.reinterpret(yt, tl.float8) if transpose else None,
+        scale, amax,
+        M, N,
+        x2.stride(0), x2.stride(1),
+        y2.stride(0), y2.stride(1),
+        yt.stride(0) if transpose else 0, yt.stride(1) if transpose else 0,
+        BLOCK_M=BLOCK_M, BLOCK_N=BLOCK_N,
+        TRANSPOSE=transpose, FP8_MAX=FP8_MAX, num_warps=4,
+    )
+    return y, yt, amax
+
+
+def fp8_update_scale(amax_history, scale, margin=0):
+    """
+    Updates `scale` in place from the maximum of `amax_history`, so that it maps that
+    maximum to FP8_MAX / 2 ** margin, and rolls the history to make room for the amax of
+    the next step in `amax_history[0]`, which is zeroed. Scales are left unchanged while
+    the history has no non-zero amax. Nothing is copied back to the host.
+    """
+    amax = amax_history.max()
+    new_scale = FP8_MAX / amax / 2 ** margin
+    scale.copy_(torch.where((amax > 0) & torch.isfinite(amax), new_scale, scale))
+    amax_history.copy_(torch.roll(amax_history, 1, dims=0))
+    amax_history[0].zero_()
+    return scale
@@ -0,0 +1,122 @@
+import torch
+
+import triton
+import triton.language as tl
+
+# activations of the gate: SwiGLU and GeGLU
+GATED_ACTIVATIONS = ['silu', 'gelu']
+
+
+# ********************************************************
+# --------------------------------------------------------
+# Gated MLP up-projection
+# act(x @ W_gate) * (x @ W_up) in one kernel: both products
+# accumulate in the same K-loop from the same tile of x, and
+# the gate is applied in the epilogue, so neither product is
+# written to DRAM
+# --------------------------------------------------------
+# ********************************************************
+
+
+@triton.heuristics({
+    'EVEN_K': lambda args: args['K'] % args['BLOCK_K'] == 0,
+})
+@triton.autotune(
+    configs=[
+        # two accumulators per program: tiles are half those of `matmul._kernel`
+        triton.Config({'BLOCK_M': 128, 'BLOCK_N': 128, 'BLOCK_K': 32}, num_stages=3, num_warps=8),
+        triton.Config({'BLOCK_M': 128, 'BLOCK_N': 64, 'BLOCK_K': 32}, num_stages=4, num_warps=4),
+        triton.Config({'BLOCK_M': 64, 'BLOCK_N': 128, 'BLOCK_K': 32}, num_stages=4, num_warps=4),
+        triton.Config({'BLOCK_M': 64, 'BLOCK_N': 64, 'BLOCK_K': 64}, num_stages=4, num_warps=4),
+        triton.Config({'BLOCK_M': 32, 'BLOCK_N': 64, 'BLOCK_K': 64}, num_stages=5, num_warps=2),
+        triton.Config({'BLOCK_M': 16, 'BLOCK_N': 128, 'BLOCK_K': 64}, num_stages=5, num_warps=4),
+    ],
+    key=['M', 'N', 'K', 'ACTIVATION'],
+)
+@triton.jit
+def _kernel(X, WGate, WUp, Y, M, N, K,
+            stride_xm, stride_xk,
+            stride_gk, stride_gn,
+            stride_uk, stride_un,
+            stride_ym, stride_yn,
+            ACTIVATION: tl.constexpr,
+            BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr,
+            GROUP_M: tl.constexpr, EVEN_K: tl.constexpr):
+    pid = tl.program_id(0)
+    grid_m = (M + BLOCK_M - 1) // BLOCK_M
+    grid_n = (N + BLOCK_N - 1) // BLOCK_N
+    # re-order program ID for better L2 performance
+    width = GROUP_M * grid_n
+    group_id = pid // width
+    group_size = min(grid_m - group_id * GROUP_M, GROUP_M)
+    pid_m = group_id * GROUP_M + (pid % group_size)
+    pid_n = (pid % width) // (group_size)
+    rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    ram = tl.max_contiguous(tl.multiple_of(rm % M, BLOCK_M), BLOCK_M)
+    rbn = tl.max_contiguous(tl.multiple_of(rn % N, BLOCK_N), BLOCK_N)
+    rk = tl.arange(0, BLOCK_K)
+    X = X + (ram[:, None] * stride_xm + rk[None, :] * stride_xk)
+    WGate = WGate + (rk[:, None] * stride_gk + rbn[None, :] * stride_gn)
+    WUp = WUp + (rk[:, None] * stride_uk + rbn[None, :] * stride_un)
+    gate = tl.zeros((BLOCK_M, BLOCK_N), dtype=tl.float32)
+    up = tl.zeros((BLOCK_M, BLOCK_N), dtype=tl.float32)
+    # the tile of x is loaded once and feeds both dots
+    k_rem = K
+    for k in range(K, BLOCK_K - 1, -BLOCK_K):
+        x = tl.load(X)
+        gate += tl.dot(x, tl.load(WGate))
+        up += tl.dot(x, tl.load(WUp))
+        X += BLOCK_K * stride_xk
+        WGate += BLOCK_K * stride_gk
+        WUp += BLOCK_K * stride_uk
+        k_rem -= BLOCK_K
+    if not EVEN_K:
+        if k_rem > 0:
+            x = tl.load(X, mask=rk[None, :] < k_rem, other=0.)
+            gate += tl.dot(x, tl.load(WGate, mask=rk[:, None] < k_rem, other=0.))
+            up += tl.dot(x, tl.load(WUp, mask=rk[:, None] < k_rem, other=0.))
+    if ACTIVATION == 'silu':
+        gate = gate * tl.sigmoid(gate)
+    if ACTIVATION == 'gelu':
+        # tanh approximation; 0.5 * (1 + tanh(u)) = sigmoid(2u)
+        gate = gate * tl.sigmoid(1.5957691216057308 * (gate + 0.044715 * gate * gate * gate))
+    y = (gate * up).to(Y.dtype.element_ty)
+    # rematerialize rm and rn to save registers
+    rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    Y = Y + (rm[:, None] * stride_ym + rn[None, :] * stride_yn)
+    mask = (rm < M)[:, None] & (rn < N)[None, :]
+    tl.store(Y, y, mask=mask)
+
+
+def gated_mlp(x, w_gate, w_up, activation='silu'):
+    """
+    Returns `activation(x @ w_gate) * (x @ w_up)`, the up-projection of a gated MLP
+    (SwiGLU for 'silu', GeGLU for 'gelu', with the tanh approximation), in one kernel.
+
+    :param x: float16, bfloat16 or float32 tensor of shape (..., K)
+    :param w_gate: (K, N) weights of the gate, of the type of `x`
+    :param w_up: (K, N) weights of the up-projection, of the type of `x`
+    :return: tensor of shape (..., N) and of the type of `x`
+    """
+    assert activation in GATED_ACTIVATIONS, f"unsupported activation {activation}"
+    assert x.dtype in [torch.float16, torch.bfloat16, torch.float32], f"unsupported type {x.dtype}"
+    assert w_gate.dtype == x.dtype and w_up.dtype == x.dtype, "weights must have the type of x"
+    assert w_gate.dim() == 2 and w_gate.shape == w_up.shape, "w_gate and w_up must be (K, N) matrices"
+    K, N = w_gate.shape
+    assert x.shape[-1] == K, "incompatible dimensions"
+    x2 = x.reshape(-1, K)
+    # handle non-contiguous inputs if necessary
+    if x2.stride(0) > 1 and x2.stride(1) > 1:
+        x2 = x2.contiguous()
+    M = x2.shape[0]
+    y = torch.empty((M, N), device=x.device, dtype=x.dtype)
+    grid = lambda META: (triton.cdiv(M, META['BLOCK_M']) * triton.cdiv(N, META['BLOCK_N']),)
+    _kernel[grid](x2, w_gate, w_up, y, M, N, K,
+                  x2.stride(0), x2.stride(1),
+                  w_gate.stride(0), w_gate.stride(1),
+                  w_up.stride(0), w_up.stride(1),
+                  y.stride(0), y.stride(1),
+                  activation, GROUP_M=8)
+    return y.reshape(*x.shape[:-1], N)
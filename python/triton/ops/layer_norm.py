@@ -0,0 +1,230 @@
+import torch
+
+import triton
+import triton.language as tl
+
+from .cross_entropy import num_warps
+
+# rows longer than this are processed in several chunks
+MAX_BLOCK = 8192
+
+
+def block_size(N):
+    return min(triton.next_power_of_2(N), MAX_BLOCK)
+
+
+# ---------------------------------------------
+# Forward pass
+# Statistics are computed in a single pass with
+# Welford's algorithm: every lane keeps its own
+# count, mean and sum of squared deviations, and
+# lanes are merged at the end of the row
+# ---------------------------------------------
+
+
+@triton.heuristics({'num_warps': lambda nargs: num_warps(nargs['N'])})
+@triton.heuristics({'BLOCK_SIZE': lambda nargs: block_size(nargs['N'])})
+@triton.jit
+def _norm_fwd(X, Y, W, B, Mean, Rstd, stride, N, eps,
+              IS_RMS: tl.constexpr, BLOCK_SIZE: tl.constexpr):
+    row = tl.program_id(0)
+    cols = tl.arange(0, BLOCK_SIZE)
+    X += row * stride
+    Y += row * stride
+    count = tl.zeros([BLOCK_SIZE], dtype=tl.float32)
+    mean = tl.zeros([BLOCK_SIZE], dtype=tl.float32)
+    m2 = tl.zeros([BLOCK_SIZE], dtype=tl.float32)
+    for off in range(0, N, BLOCK_SIZE):
+        mask = off + cols < N
+        x = tl.load(X + off + cols, mask=mask, other=0.).to(tl.float32)
+        if IS_RMS:
+            m2 += x * x
+        else:
+            count += tl.where(mask, 1., 0.)
+            delta = x - mean
+            mean += tl.where(mask, delta / tl.maximum(count, 1.), 0.)
+            m2 += tl.where(mask, delta * (x - mean), 0.)
+    if IS_RMS:
+        mean_row = 0.
+        var = tl.sum(m2, axis=0) / N
+    else:
+        mean_row = tl.sum(count * mean, axis=0) / N
+        dev = mean - mean_row
+        var = tl.sum(m2 + count * dev * dev, axis=0) / N
+    rstd = 1 / tl.sqrt(var + eps)
+    if Mean is not None:
+        tl.store(Mean + row, mean_row)
+    tl.store(Rstd + row, rstd)
+    # normalize, scale and shift
+    for off in range(0, N, BLOCK_SIZE):
+        mask = off + cols < N
+        x = tl.load(X + off + cols, mask=mask, other=0.).to(tl.float32)
+        w = tl.load(W + off + cols, mask=mask, other=0.).to(tl.float32)
+        y = (x - mean_row) * rstd * w
+        if B is not None:
+            y += tl.load(B + off + cols, mask=mask, other=0.).to(tl.float32)
+        tl.store(Y + off + cols, y.to(Y.dtype.element_ty), mask=mask)
+
+
+# ---------------------------------------------
+# Backward pass
+# Rows are processed in parallel. Each program
+# adds its contribution to the weight gradients
+# into one of GROUP_SIZE_M partial buffers,
+# guarded by a spin lock; the first program of
+# each buffer overwrites it, so buffers need no
+# zeroing. The buffers are summed by a second
+# kernel, which resets their counts of programs
+# ---------------------------------------------
+
+
+@triton.heuristics({'num_warps': lambda nargs: num_warps(nargs['N'])})
+@triton.heuristics({'BLOCK_SIZE': lambda nargs: block_size(nargs['N'])})
+@triton.jit
+def _norm_bwd_dx(DX, DY, DW, DB, X, W, Mean, Rstd, Lock, stride, N,
+                 IS_RMS: tl.constexpr, GROUP_SIZE_M: tl.constexpr, BLOCK_SIZE: tl.constexpr):
+    row = tl.program_id(0)
+    cols = tl.arange(0, BLOCK_SIZE)
+    X += row * stride
+    DY += row * stride
+    DX += row * stride
+    mean = 0.
+    if Mean is not None:
+        mean = tl.load(Mean + row)
+    rstd = tl.load(Rstd + row)
+    # dx = (w * dy - (xhat * c1 + c2)) * rstd
+    c1 = 0.
+    c2 = 0.
+    for off in range(0, N, BLOCK_SIZE):
+        mask = off + cols < N
+        x = tl.load(X + off + cols, mask=mask, other=0.).to(tl.float32)
+        dy = tl.load(DY + off + cols, mask=mask, other=0.).to(tl.float32)
+        w = tl.load(W + off + cols, mask=mask, other=0.).to(tl.float32)
+        xhat = tl.where(mask, (x - mean) * rstd, 0.)
+        c1 += tl.sum(xhat * w * dy, axis=0)
+        c2 += tl.sum(w * dy, axis=0)
+    c1 = c1 / N
+    c2 = c2 / N
+    if IS_RMS:
+        c2 = 0.
+    # partial weight gradients
+    lock_id = row % GROUP_SIZE_M
+    Lock += lock_id
+    Count = Lock + GROUP_SIZE_M
+    DW += lock_id * N
+    if DB is not None:
+        DB += lock_id * N
+    while tl.atomic_cas(Lock, 0, 1) == 1:
+        pass
+    count = tl.load(Count, volatile=True)
+    for off in range(0, N, BLOCK_SIZE):
+        mask = off + cols < N
+        x = tl.load(X + off + cols, mask=mask, other=0.).to(tl.float32)
+        dy = tl.load(DY + off + cols, mask=mask, other=0.).to(tl.float32)
+        w = tl.load(W + off + cols, mask=mask, other=0.).to(tl.float32)
+        xhat = tl.where(mask, (x - mean) * rstd, 0.)
+        dx = (w * dy - (xhat * c1 + c2)) * rstd
+        tl.store(DX + off + cols, dx.to(DX.dtype.element_ty), mask=mask)
+        # partial sums of other SMs are read from L2
+        mask_acc = mask & (count > 0)
+        dw = tl.load(DW + off + cols, mask=mask_acc, other=0., cache_modifier='.cg')
+        tl.store(DW + off + cols, dw + dy * xhat, mask=mask)
+        if DB is not None:
+            db = tl.load(DB + off + cols, mask=mask_acc, other=0., cache_modifier='.cg')
+            tl.store(DB + off + cols, db + dy, mask=mask)
+    tl.store(Count, count + 1)
+    # release lock
+    tl.atomic_xchg(Lock, 0)
+
+
+@triton.jit
+def _norm_bwd_dwdb(DW, DB, FINAL_DW, FINAL_DB, Count, M, N,
+                   BLOCK_SIZE_M: tl.constexpr, BLOCK_SIZE_N: tl.constexpr):
+    # only the first M partial buffers were written
+    pid = tl.program_id(0)
+    cols = pid * BLOCK_SIZE_N + tl.arange(0, BLOCK_SIZE_N)
+    dw = tl.zeros((BLOCK_SIZE_M, BLOCK_SIZE_N), dtype=tl.float32)
+    db = tl.zeros((BLOCK_SIZE_M, BLOCK_SIZE_N), dtype=tl.float32)
+    for i in range(0, M, BLOCK_SIZE_M):
+        rows = i + tl.arange(0, BLOCK_SIZE_M)
+        mask = (rows[:, None] < M) & (cols[None, :] < N)
+        offs = rows[:, None] * N + cols[None, :]
+        dw += tl.load(DW + offs, mask=mask, other=0.)
+        if DB is not None:
+            db += tl.load(DB + offs, mask=mask, other=0.)
+    tl.store(FINAL_DW + cols, tl.sum(dw, axis=0), mask=cols < N)
+    if DB is not None:
+        tl.store(FINAL_DB + cols, tl.sum(db, axis=0), mask=cols < N)
+    # ready for the next launch
+    if pid == 0:
+        for i in range(0, M, BLOCK_SIZE_M):
+            rows = i + tl.arange(0, BLOCK_SIZE_M)
+            tl.store(Count + rows, 0, mask=rows < M)
+
+
+def group_size_m(N):
+    # number of partial buffers for the weight gradients
+    if N <= 1024:
+        return 256
+    if N <= 4096:
+        return 128
+    if N <= 8192:
+        return 96
+    return 64
+
+
+class _norm(torch.autograd.Function):
+
+    @staticmethod
+    def forward(ctx, x, weight, bias, eps, is_rms):
+        N = x.shape[-1]
+        if weight.shape != (N,) or (bias is not None and bias.shape != (N,)):
+            raise ValueError(f"weight and bias must have shape ({N},)")
+        # rows of the input and of the output share their stride
+        x_arg = x.reshape(-1, N).contiguous()
+        M = x_arg.shape[0]
+        y = torch.empty((M, N), dtype=x.dtype, device=x.device)
+        mean = None if is_rms else torch.empty((M,), dtype=torch.float32, device=x.device)
+        rstd = torch.empty((M,), dtype=torch.float32, device=x.device)
+        _norm_fwd[(M,)](x_arg, y, weight, bias, mean, rstd, x_arg.stride(0), N, eps, IS_RMS=is_rms)
+        ctx.save_for_backward(x_arg, weight, bias, mean, rstd)
+        ctx.is_rms = is_rms
+        ctx.x_shape = x.shape
+        return y.view(x.shape)
+
+    @staticmethod
+    def backward(ctx, dy):
+        x, w, b, mean, rstd = ctx.saved_tensors
+        M, N = x.shape
+        GROUP_SIZE_M = group_size_m(N)
+        dy = dy.reshape(M, N).contiguous()
+        dx = torch.empty_like(dy)
+        dw = torch.empty((N,), dtype=w.dtype, device=w.device)
+        db = None if b is None else torch.empty((N,), dtype=b.dtype, device=b.device)
+        with triton.workspace.scope(x.device) as ws:
+            # locks, then counts of the programs that wrote each partial buffer
+            locks = ws.semaphores(2 * GROUP_SIZE_M)
+            _dw = ws.empty((GROUP_SIZE_M, N), torch.float32)
+            _db = None if b is None else ws.empty((GROUP_SIZE_M, N), torch.float32)
+            _norm_bwd_dx[(M,)](dx, dy, _dw, _db, x, w, mean, rstd, locks, x.stride(0), N,
+                               IS_RMS=ctx.is_rms, GROUP_SIZE_M=GROUP_SIZE_M)
+            # accumulate partial sums in a separate kernel
+            grid = lambda meta: [triton.cdiv(N, meta['BLOCK_SIZE_N'])]
+            _norm_bwd_dwdb[grid](_dw, _db, dw, db, locks[GROUP_SIZE_M:], min(M, GROUP_SIZE_M), N,
+                                 BLOCK_SIZE_M=32, BLOCK_SIZE_N=128)
+        return dx.view(ctx.x_shape), dw, db, None, None
+
+
+def layer_norm(x, weight, bias=None, eps=1e-5):
+    """
+    Normalizes the last dimension of `x` to zero mean and unit variance, then scales it by
+    `weight` and shifts it by `bias`.
+    """
+    return _norm.apply(x, weight, bias, eps, False)
+
+
+def rms_norm(x, weight, eps=1e-6):
+    """
+    Divides the last dimension of `x` by its root mean square, then scales it by `weight`.
+    """
+    return _norm.apply(x, weight, None, eps, True)
@@ -1,12 +1,14 @@
 import torch
 
 import triton
+import triton._C.libtriton.triton as _triton
 import triton.language as tl
-from .matmul_perf_model import early_config_prune, estimate_matmul_time
+from .matmul_perf_model import (early_config_prune, estimate_matmul_time, resource_config_prune, select_schedule,
+                                skinny_config)
 
 
-def init_to_zero(name):
-    return lambda nargs: nargs[name].zero_()
+# activations that can be fused into the epilogue of `_kernel`
+ACTIVATIONS = [None, 'relu', 'gelu', 'silu']
 
 
 def get_configs_io_bound():
@@ -22,7 +24,7 @@ def get_configs_io_bound():
                     # split_k
                     for split_k in [2, 4, 8, 16]:
                         configs.append(triton.Config({'BLOCK_M': block_m, 'BLOCK_N': block_n, 'BLOCK_K': block_k, 'SPLIT_K': split_k},
-                                                     num_stages=num_stages, num_warps=num_warps, pre_hook=init_to_zero('C')))
+                                                     num_stages=num_stages, num_warps=num_warps))
     return configs
 
 
@@ -52,25 +54,37 @@ def get_configs_io_bound():
         triton.Config({'BLOCK_M': 128, 'BLOCK_N': 32, 'BLOCK_K': 64, 'SPLIT_K': 1}, num_stages=4, num_warps=4),
         triton.Config({'BLOCK_M': 64, 'BLOCK_N': 32, 'BLOCK_K': 64, 'SPLIT_K': 1}, num_stages=5, num_warps=2),
     ] + get_configs_io_bound(),
-    key=['M', 'N', 'K'],
+    key=['M', 'N', 'K', 'ACTIVATION', 'ACC_TYPE'],
     prune_configs_by={
         'early_config_prune': early_config_prune,
         'perf_model': estimate_matmul_time,
-        'top_k': 10
+        'top_k': 10,
+        'resource_config_prune': resource_config_prune,
     },
 )
 @triton.jit
-def _kernel(A, B, C, M, N, K,
+def _kernel(A, B, C, ScaleA, ScaleB, Locks, M, N, K,
             stride_am, stride_ak,
             stride_bk, stride_bn,
             stride_cm, stride_cn,
+            stride_az, stride_bz, stride_cz,
+            Bias, Residual, stride_rm, stride_rn, stride_rz, alpha,
+            ACTIVATION: tl.constexpr,
             BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr,
             GROUP_M: tl.constexpr, SPLIT_K: tl.constexpr, EVEN_K: tl.constexpr,
-            ACC_TYPE: tl.constexpr
+            ACC_TYPE: tl.constexpr, SCALE_A: tl.constexpr, SCALE_B: tl.constexpr,
+            SPLIT_TF32: tl.constexpr
             ):
     # matrix multiplication
     pid = tl.program_id(0)
     pid_z = tl.program_id(1)
+    # strided batches
+    pid_batch = tl.program_id(2)
+    A += pid_batch * stride_az
+    B += pid_batch * stride_bz
+    C += pid_batch * stride_cz
+    if Residual is not None:
+        Residual += pid_batch * stride_rz
     grid_m = (M + BLOCK_M - 1) // BLOCK_M
     grid_n = (N + BLOCK_N - 1) // BLOCK_N
     # re-order program ID for better L2 performance
@@ -89,62 +103,450 @@ def _kernel(A, B, C, M, N, K,
     A = A + (ram[:, None] * stride_am + rk[None, :] * stride_ak)
     B = B + (rk[:, None] * stride_bk + rbn[None, :] * stride_bn)
     acc = tl.zeros((BLOCK_M, BLOCK_N), dtype=ACC_TYPE)
-    for k in range(K, 0, -BLOCK_K * SPLIT_K):
-        if EVEN_K:
-            a = tl.load(A)
-            b = tl.load(B)
+    # only the last iteration can be partial: the main loop runs without masks
+    # while the whole block of k is in range, and the rest is peeled
+    k_rem = K
+    for k in range(K, (pid_z + 1) * BLOCK_K - 1, -BLOCK_K * SPLIT_K):
+        a = tl.load(A)
+        b = tl.load(B)
+        if SPLIT_TF32:
+            acc += tl.dot(a, b, precision='3xtf32')
         else:
-            a = tl.load(A, mask=rk[None, :] < k, other=0.)
-            b = tl.load(B, mask=rk[:, None] < k, other=0.)
-        acc += tl.dot(a, b)
+            acc += tl.dot(a, b, acc_dtype=ACC_TYPE)
         A += BLOCK_K * SPLIT_K * stride_ak
         B += BLOCK_K * SPLIT_K * stride_bk
-    acc = acc.to(C.dtype.element_ty)
+        k_rem -= BLOCK_K * SPLIT_K
+    if not EVEN_K:
+        if k_rem > 0:
+            a = tl.load(A, mask=rk[None, :] < k_rem, other=0.)
+            b = tl.load(B, mask=rk[:, None] < k_rem, other=0.)
+            if SPLIT_TF32:
+                acc += tl.dot(a, b, precision='3xtf32')
+            else:
+                acc += tl.dot(a, b, acc_dtype=ACC_TYPE)
     # rematerialize rm and rn to save registers
     rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
     rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
-    C = C + (rm[:, None] * stride_cm + rn[None, :] * stride_cn)
+    # dequantize with per-row scales of A and per-column scales of B
+    if SCALE_A:
+        acc = acc.to(tl.float32) * tl.load(ScaleA + rm, mask=rm < M, other=0.)[:, None]
+    if SCALE_B:
+        acc = acc.to(tl.float32) * tl.load(ScaleB + rn, mask=rn < N, other=0.)[None, :]
+    # fused epilogue: alpha * acc + bias, activation, then residual addition.
+    # With split-k, only the first slice adds the bias and the residual, and no
+    # config can be picked with an activation (see `early_config_prune`)
+    if alpha is not None:
+        acc = acc.to(tl.float32) * alpha
+    if Bias is not None:
+        if pid_z == 0:
+            acc = acc.to(tl.float32) + tl.load(Bias + rn, mask=rn < N, other=0.).to(tl.float32)[None, :]
+    if ACTIVATION == 'relu':
+        acc = tl.where(acc > 0, acc, 0.)
+    if ACTIVATION == 'gelu':
+        # tanh approximation; 0.5 * (1 + tanh(u)) = sigmoid(2u)
+        acc = acc.to(tl.float32)
+        acc = acc * tl.sigmoid(1.5957691216057308 * (acc + 0.044715 * acc * acc * acc))
+    if ACTIVATION == 'silu':
+        acc = acc.to(tl.float32)
+        acc = acc * tl.sigmoid(acc)
     mask = (rm < M)[:, None] & (rn < N)[None, :]
-    # handles write-back with reduction-splitting
+    if Residual is not None:
+        if pid_z == 0:
+            R = Residual + (rm[:, None] * stride_rm + rn[None, :] * stride_rn)
+            acc = acc.to(tl.float32) + tl.load(R, mask=mask, other=0.).to(tl.float32)
+    acc = acc.to(C.dtype.element_ty)
+    C = C + (rm[:, None] * stride_cm + rn[None, :] * stride_cn)
+    # handles write-back with reduction-splitting: the slices of a tile add their
+    # partial sums to C in order, each one after the previous one has raised the
+    # tile's lock, so C needs no zeroing and results are deterministic. Slices are
+    # scheduled in order, so the ones waited for are running or done, and the last
+    # one brings the lock back to 0 for the next launch
     if SPLIT_K == 1:
         tl.store(C, acc, mask=mask)
     else:
-        tl.atomic_add(C, acc, mask=mask)
+        Lock = Locks + pid_batch * tl.num_programs(0) + pid
+        while tl.atomic_cas(Lock, pid_z, pid_z) != pid_z:
+            pass
+        if pid_z > 0:
+            acc += tl.load(C, mask=mask, other=0., cache_modifier='.cg')
+        tl.store(C, acc, mask=mask)
+        tl.atomic_xchg(Lock, (pid_z + 1) % SPLIT_K)
+
+
+@triton.heuristics({
+    'EVEN_K': lambda args: args['K'] % args['BLOCK_K'] == 0,
+})
+@triton.autotune(
+    configs=[
+        triton.Config({'BLOCK_M': 128, 'BLOCK_N': 128, 'BLOCK_K': 32}, num_stages=4, num_warps=4),
+        triton.Config({'BLOCK_M': 128, 'BLOCK_N': 64, 'BLOCK_K': 32}, num_stages=4, num_warps=4),
+        triton.Config({'BLOCK_M': 64, 'BLOCK_N': 128, 'BLOCK_K': 32}, num_stages=4, num_warps=4),
+        triton.Config({'BLOCK_M': 64, 'BLOCK_N': 64, 'BLOCK_K': 64}, num_stages=4, num_warps=4),
+    ],
+    key=['M', 'N', 'K'],
+)
+@triton.jit
+def _kernel_stream_k(A, B, C, Workspace, Locks, M, N, K,
+                     stride_am, stride_ak,
+                     stride_bk, stride_bn,
+                     stride_cm, stride_cn,
+                     BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr,
+                     GROUP_M: tl.constexpr, EVEN_K: tl.constexpr,
+                     ACC_TYPE: tl.constexpr
+                     ):
+    # persistent programs split the iterations of all tiles evenly, so that
+    # no SM idles during a partial last wave. A program whose range starts in
+    # the middle of a tile publishes its partial sum in `Workspace`, and the
+    # program that starts the tile adds it before writing C back
+    pid = tl.program_id(0)
+    num_ctas = tl.num_programs(0)
+    grid_m = (M + BLOCK_M - 1) // BLOCK_M
+    grid_n = (N + BLOCK_N - 1) // BLOCK_N
+    iters_per_tile = (K + BLOCK_K - 1) // BLOCK_K
+    total_iters = grid_m * grid_n * iters_per_tile
+    iters_per_cta = total_iters // num_ctas
+    extra_iters = total_iters % num_ctas
+    start = pid * iters_per_cta + min(pid, extra_iters)
+    end = (pid + 1) * iters_per_cta + min(pid + 1, extra_iters)
+    rw = tl.arange(0, BLOCK_M)[:, None] * BLOCK_N + tl.arange(0, BLOCK_N)[None, :]
+    while start < end:
+        tile_id = start // iters_per_tile
+        tile_begin = tile_id * iters_per_tile
+        tile_end = tile_begin + iters_per_tile
+        seg_end = min(end, tile_end)
+        # re-order tiles for better L2 performance
+        width = GROUP_M * grid_n
+        group_id = tile_id // width
+        group_size = min(grid_m - group_id * GROUP_M, GROUP_M)
+        pid_m = group_id * GROUP_M + (tile_id % group_size)
+        pid_n = (tile_id % width) // (group_size)
+        rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+        rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+        ram = tl.max_contiguous(tl.multiple_of(rm % M, BLOCK_M), BLOCK_M)
+        rbn = tl.max_contiguous(tl.multiple_of(rn % N, BLOCK_N), BLOCK_N)
+        rk = tl.arange(0, BLOCK_K)
+        k_begin = (start - tile_begin) * BLOCK_K
+        A_ptrs = A + (ram[:, None] * stride_am + (k_begin + rk)[None, :] * stride_ak)
+        B_ptrs = B + ((k_begin + rk)[:, None] * stride_bk + rbn[None, :] * stride_bn)
+        acc = tl.zeros((BLOCK_M, BLOCK_N), dtype=ACC_TYPE)
+        for k in range(K - k_begin, K - (seg_end - tile_begin) * BLOCK_K, -BLOCK_K):
+            if EVEN_K:
+                a = tl.load(A_ptrs)
+                b = tl.load(B_ptrs)
+            else:
+                a = tl.load(A_ptrs, mask=rk[None, :] < k, other=0.)
+                b = tl.load(B_ptrs, mask=rk[:, None] < k, other=0.)
+            acc += tl.dot(a, b)
+            A_ptrs += BLOCK_K * stride_ak
+            B_ptrs += BLOCK_K * stride_bk
+        if start != tile_begin:
+            # the store is visible to other programs before the flag is raised
+            tl.store(Workspace + pid * BLOCK_M * BLOCK_N + rw, acc)
+            tl.atomic_cas(Locks + pid, 0, 1)
+        else:
+            # programs that cover the rest of the tile start right after this one
+            peer = pid + 1
+            peer_start = seg_end
+            while peer_start < tile_end:
+                while tl.atomic_cas(Locks + peer, 1, 0) != 1:
+                    pass
+                acc += tl.load(Workspace + peer * BLOCK_M * BLOCK_N + rw, cache_modifier='.cg')
+                peer_start = (peer + 1) * iters_per_cta + min(peer + 1, extra_iters)
+                peer += 1
+            out = acc.to(C.dtype.element_ty)
+            C_ptrs = C + (rm[:, None] * stride_cm + rn[None, :] * stride_cn)
+            mask = (rm < M)[:, None] & (rn < N)[None, :]
+            tl.store(C_ptrs, out, mask=mask)
+        start = seg_end
+
+
+@triton.jit
+def _kernel_skinny(A, B, C, Partials, Locks, M, N, K, K_PER_SPLIT,
+                   stride_am, stride_ak,
+                   stride_bk, stride_bn,
+                   stride_cm, stride_cn,
+                   BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr,
+                   SPLIT_K: tl.constexpr, EVEN_K: tl.constexpr,
+                   ACC_TYPE: tl.constexpr
+                   ):
+    # products of a few rows are bound by the reads of B. Program (n, z) reads
+    # slice z of K of a strip of columns of B once, along its rows, and all the
+    # rows of A and C fit in one tile, too narrow for tensor cores: `dot` runs
+    # on FMAs, or dp4a for int8. Slices publish their partial sums in `Partials`,
+    # and the last one of a strip to arrive adds them in order and writes C back
+    pid_n = tl.program_id(0)
+    pid_z = tl.program_id(1)
+    rm = tl.arange(0, BLOCK_M)
+    rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    ram = rm % M
+    rbn = tl.max_contiguous(tl.multiple_of(rn % N, BLOCK_N), BLOCK_N)
+    rk = tl.arange(0, BLOCK_K)
+    k_begin = pid_z * K_PER_SPLIT
+    A = A + (ram[:, None] * stride_am + (k_begin + rk)[None, :] * stride_ak)
+    B = B + ((k_begin + rk)[:, None] * stride_bk + rbn[None, :] * stride_bn)
+    acc = tl.zeros((BLOCK_M, BLOCK_N), dtype=ACC_TYPE)
+    # masks along K are uniform along the rows of B, whose loads stay vectorized
+    for k in range(min(K_PER_SPLIT, K - k_begin), 0, -BLOCK_K):
+        if EVEN_K:
+            a = tl.load(A)
+            b = tl.load(B)
+        else:
+            a = tl.load(A, mask=rk[None, :] < k, other=0.)
+            b = tl.load(B, mask=rk[:, None] < k, other=0.)
+        acc += tl.dot(a, b)
+        A += BLOCK_K * stride_ak
+        B += BLOCK_K * stride_bk
+    mask = (rm < M)[:, None] & (rn < N)[None, :]
+    C = C + (rm[:, None] * stride_cm + rn[None, :] * stride_cn)
+    if SPLIT_K == 1:
+        tl.store(C, acc.to(C.dtype.element_ty), mask=mask)
+    else:
+        rp = rm[:, None] * N + rn[None, :]
+        tl.store(Partials + pid_z * M * N + rp, acc, mask=mask)
+        # the partial sum is visible to other programs before the count is raised,
+        # and the last slice brings it back to 0 for the next launch
+        if tl.atomic_add(Locks + pid_n, 1) == SPLIT_K - 1:
+            acc = tl.zeros((BLOCK_M, BLOCK_N), dtype=ACC_TYPE)
+            for z in range(0, SPLIT_K):
+                acc += tl.load(Partials + z * M * N + rp, mask=mask, other=0., cache_modifier='.cg')
+            tl.store(C, acc.to(C.dtype.element_ty), mask=mask)
+            tl.atomic_xchg(Locks + pid_n, 0)
+
+
+@triton.jit
+def _kernel_grouped(A0, B0, C0, Ptrs, Sizes, Strides, G,
+                    BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr,
+                    ACC_TYPE: tl.constexpr
+                    ):
+    # persistent programs walk the tiles of all problems in order, and take
+    # every num_ctas-th of them. Problem g multiplies the matrices whose
+    # addresses are Ptrs[g, :], with shapes Sizes[g, :] = (M, N, K) and strides
+    # Strides[g, :] = (am, ak, bk, bn, cm, cn); A0, B0 and C0 only give their types
+    pid = tl.program_id(0)
+    num_ctas = tl.num_programs(0)
+    tile = pid
+    tile_begin = 0
+    g = 0
+    while g < G:
+        M = tl.load(Sizes + g * 3 + 0)
+        N = tl.load(Sizes + g * 3 + 1)
+        K = tl.load(Sizes + g * 3 + 2)
+        grid_n = (N + BLOCK_N - 1) // BLOCK_N
+        tile_end = tile_begin + (M + BLOCK_M - 1) // BLOCK_M * grid_n
+        while tile < tile_end:
+            pid_m = (tile - tile_begin) // grid_n
+            pid_n = (tile - tile_begin) % grid_n
+            A = tl.load(Ptrs + g * 3 + 0).to(A0.dtype)
+            B = tl.load(Ptrs + g * 3 + 1).to(B0.dtype)
+            C = tl.load(Ptrs + g * 3 + 2).to(C0.dtype)
+            stride_am = tl.load(Strides + g * 6 + 0)
+            stride_ak = tl.load(Strides + g * 6 + 1)
+            stride_bk = tl.load(Strides + g * 6 + 2)
+            stride_bn = tl.load(Strides + g * 6 + 3)
+            stride_cm = tl.load(Strides + g * 6 + 4)
+            stride_cn = tl.load(Strides + g * 6 + 5)
+            rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+            rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+            rk = tl.arange(0, BLOCK_K)
+            A = A + ((rm % M)[:, None] * stride_am + rk[None, :] * stride_ak)
+            B = B + (rk[:, None] * stride_bk + (rn % N)[None, :] * stride_bn)
+            acc = tl.zeros((BLOCK_M, BLOCK_N), dtype=ACC_TYPE)
+            for k in range(K, 0, -BLOCK_K):
+                a = tl.load(A, mask=rk[None, :] < k, other=0.)
+                b = tl.load(B, mask=rk[:, None] < k, other=0.)
+                acc += tl.dot(a, b)
+                A += BLOCK_K * stride_ak
+                B += BLOCK_K * stride_bk
+            C = C + (rm[:, None] * stride_cm + rn[None, :] * stride_cn)
+            mask = (rm < M)[:, None] & (rn < N)[None, :]
+            tl.store(C, acc.to(C0.dtype.element_ty), mask=mask)
+            tile += num_ctas
+        tile_begin = tile_end
+        g += 1
 
 
 class _matmul(torch.autograd.Function):
     kernel = _kernel
-
-    _locks = dict()
+    stream_k_kernel = _kernel_stream_k
+    skinny_kernel = _kernel_skinny
+    grouped_kernel = _kernel_grouped
 
     @staticmethod
-    def _call(a, b):
+    def _call(a, b, scale_a=None, scale_b=None, precision=None,
+              bias=None, activation=None, residual=None, alpha=None, out_dtype=None, acc_dtype=None):
         device = a.device
         # handle non-contiguous inputs if necessary
-        if a.stride(0) > 1 and a.stride(1) > 1:
+        if a.stride(-2) > 1 and a.stride(-1) > 1:
             a = a.contiguous()
-        if b.stride(0) > 1 and b.stride(1) > 1:
+        if b.stride(-2) > 1 and b.stride(-1) > 1:
             b = b.contiguous()
         # checks constraints
-        assert a.shape[1] == b.shape[0], "incompatible dimensions"
-        M, K = a.shape
-        _, N = b.shape
-        # allocates output
-        c = torch.empty((M, N), device=device, dtype=a.dtype)
-        # accumulator types
+        assert a.shape[-1] == b.shape[-2], "incompatible dimensions"
+        assert a.dim() in [2, 3] and b.dim() in [2, 3], "inputs must be matrices or batches of matrices"
+        M, K = a.shape[-2:]
+        N = b.shape[-1]
+        # strided batches; 2D operands are broadcast over the batch
+        batched = a.dim() == 3 or b.dim() == 3
+        batch = max(a.shape[0] if a.dim() == 3 else 1, b.shape[0] if b.dim() == 3 else 1)
+        assert a.dim() == 2 or a.shape[0] in [1, batch], "incompatible batch dimensions"
+        assert b.dim() == 2 or b.shape[0] in [1, batch], "incompatible batch dimensions"
+        stride_az = a.stride(0) if a.dim() == 3 and a.shape[0] > 1 else 0
+        stride_bz = b.stride(0) if b.dim() == 3 and b.shape[0] > 1 else 0
+        scaled = scale_a is not None or scale_b is not None
+        assert not (batched and scaled), "batched matmuls cannot be dequantized"
+        split_tf32 = precision == '3xtf32'
+        assert precision in [None, '3xtf32'], f"unsupported precision {precision}"
+        assert not split_tf32 or a.dtype == torch.float32, "3xtf32 requires float32 inputs"
+        if scale_a is not None:
+            assert scale_a.shape == (M,), "scale_a must hold one scale per row of a"
+        if scale_b is not None:
+            assert scale_b.shape == (N,), "scale_b must hold one scale per column of b"
+        assert activation in ACTIVATIONS, f"unsupported activation {activation}"
+        if bias is not None:
+            assert bias.shape == (N,), "bias must hold one value per column of the output"
+        # allocates output; dequantized integer products are returned in float16
+        dtype = torch.float16 if scaled and not a.dtype.is_floating_point else a.dtype
+        dtype = dtype if out_dtype is None else out_dtype
+        c = torch.empty((batch, M, N) if batched else (M, N), device=device, dtype=dtype)
+        if residual is not None:
+            assert residual.shape == c.shape, "residual must have the shape of the output"
+        epilogue = bias is not None or activation is not None or residual is not None or alpha is not None
+        # accumulator types; float16 products may accumulate in float16, in half of the
+        # registers, so that larger tiles fit
         ACC_TYPE = tl.float32 if a.dtype in [torch.float16, torch.bfloat16, torch.float32] else tl.int32
+        assert acc_dtype in [None, torch.float32, torch.int32, torch.float16], f"unsupported acc_dtype {acc_dtype}"
+        if acc_dtype == torch.float16:
+            assert a.dtype == torch.float16 and b.dtype == torch.float16, "float16 accumulators require float16 inputs"
+            ACC_TYPE = tl.float16
+        schedule = 'data_parallel'
+        if not batched and not scaled and not split_tf32 and not epilogue and dtype == a.dtype \
+                and ACC_TYPE != tl.float16:
+            schedule = select_schedule(a, b, M, N, K)
+        # products of a few rows read B once, on CUDA cores
+        if schedule == 'skinny':
+            return _matmul._call_skinny(a, b, c, ACC_TYPE)
+        # persistent stream-k schedule, when partial waves would leave too many SMs idle
+        if schedule == 'stream_k':
+            num_ctas = _triton.runtime.num_sm(_triton.runtime.backend.CUDA, device.index)
+            acc_dtype = torch.float32 if ACC_TYPE == tl.float32 else torch.int32
+            with triton.workspace.scope(device) as ws:
+                # partial tiles, large enough for the biggest tile of `_kernel_stream_k`, and
+                # flags, which are lowered again by the programs that consume them
+                workspace = ws.empty((num_ctas, 128 * 128), acc_dtype)
+                locks = ws.semaphores(num_ctas)
+                _kernel_stream_k[(num_ctas,)](a, b, c, workspace, locks, M, N, K,
+                                              a.stride(0), a.stride(1),
+                                              b.stride(0), b.stride(1),
+                                              c.stride(0), c.stride(1),
+                                              GROUP_M=8, ACC_TYPE=ACC_TYPE)
+            return c
         # launch kernel
-        grid = lambda META: (triton.cdiv(M, META['BLOCK_M']) * triton.cdiv(N, META['BLOCK_N']), META['SPLIT_K'])
-        _kernel[grid](a, b, c, M, N, K,
-                      a.stride(0), a.stride(1),
-                      b.stride(0), b.stride(1),
-                      c.stride(0), c.stride(1),
-                      GROUP_M=8, ACC_TYPE=ACC_TYPE)
+        grid = lambda META: (triton.cdiv(M, META['BLOCK_M']) * triton.cdiv(N, META['BLOCK_N']), META['SPLIT_K'], batch)
+        with triton.workspace.scope(device) as ws:
+            # one lock per tile for split-k configs, whose blocks are at least 16x16
+            locks = ws.semaphores(triton.cdiv(M, 16) * triton.cdiv(N, 16) * batch)
+            # unused scales point to the output
+            _kernel[grid](a, b, c, c if scale_a is None else scale_a, c if scale_b is None else scale_b, locks, M, N, K,
+                          a.stride(-2), a.stride(-1),
+                          b.stride(-2), b.stride(-1),
+                          c.stride(-2), c.stride(-1),
+                          stride_az, stride_bz, c.stride(0) if batched else 0,
+                          bias, residual,
+                          *((0, 0, 0) if residual is None else (residual.stride(-2), residual.stride(-1),
+                                                                residual.stride(0) if batched else 0)),
+                          alpha, activation,
+                          GROUP_M=8, ACC_TYPE=ACC_TYPE,
+                          SCALE_A=scale_a is not None, SCALE_B=scale_b is not None,
+                          SPLIT_TF32=split_tf32)
+        return c
+
+    @staticmethod
+    def _call_skinny(a, b, c, ACC_TYPE):
+        M, K = a.shape
+        N = b.shape[1]
+        BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K = skinny_config(a, M, N, K)
+        # slices of K are whole blocks, and none is empty
+        k_per_split = triton.cdiv(triton.cdiv(K, SPLIT_K), BLOCK_K) * BLOCK_K
+        split_k = triton.cdiv(K, k_per_split)
+        grid = (triton.cdiv(N, BLOCK_N), split_k)
+        acc_dtype = torch.float32 if ACC_TYPE == tl.float32 else torch.int32
+        with triton.workspace.scope(a.device) as ws:
+            partials = ws.empty((split_k, M, N), acc_dtype) if split_k > 1 else None
+            locks = ws.semaphores(grid[0]) if split_k > 1 else None
+            _kernel_skinny[grid](a, b, c, partials, locks, M, N, K, k_per_split,
+                                 a.stride(0), a.stride(1),
+                                 b.stride(0), b.stride(1),
+                                 c.stride(0), c.stride(1),
+                                 BLOCK_M=BLOCK_M, BLOCK_N=BLOCK_N, BLOCK_K=BLOCK_K,
+                                 SPLIT_K=split_k, EVEN_K=K % BLOCK_K == 0, ACC_TYPE=ACC_TYPE,
+                                 num_warps=4, num_stages=4)
         return c
 
     @staticmethod
-    def forward(ctx, a, b):
-        return _matmul._call(a, b)
+    def _call_grouped(a, b, block_m=64, block_n=64, block_k=32, num_warps=4, num_stages=2):
+        assert len(a) == len(b), "grouped matmuls need as many left as right operands"
+        if len(a) == 0:
+            return []
+        device = a[0].device
+        dtype = a[0].dtype
+        assert all(x.dtype == dtype for x in a + b), "all operands must have the same type"
+        assert all(x.device == device for x in a + b), "all operands must be on the same device"
+        c = []
+        ptrs, sizes, strides = [], [], []
+        for x, y in zip(a, b):
+            assert x.dim() == 2 and y.dim() == 2 and x.shape[1] == y.shape[0], "incompatible dimensions"
+            z = torch.empty((x.shape[0], y.shape[1]), device=device, dtype=dtype)
+            c.append(z)
+            ptrs += [x.data_ptr(), y.data_ptr(), z.data_ptr()]
+            sizes += [x.shape[0], y.shape[1], x.shape[1]]
+            strides += [x.stride(0), x.stride(1), y.stride(0), y.stride(1), z.stride(0), z.stride(1)]
+        # problem descriptors
+        ptrs = torch.tensor(ptrs, dtype=torch.int64, device=device)
+        sizes = torch.tensor(sizes, dtype=torch.int32, device=device)
+        strides = torch.tensor(strides, dtype=torch.int64, device=device)
+        ACC_TYPE = tl.float32 if dtype in [torch.float16, torch.bfloat16, torch.float32] else tl.int32
+        num_tiles = sum(triton.cdiv(x.shape[0], block_m) * triton.cdiv(y.shape[1], block_n) for x, y in zip(a, b))
+        num_ctas = _triton.runtime.num_sm(_triton.runtime.backend.CUDA, device.index)
+        grid = (max(1, min(num_ctas, num_tiles)),)
+        _kernel_grouped[grid](a[0], b[0], c[0], ptrs, sizes, strides, len(a),
+                              BLOCK_M=block_m, BLOCK_N=block_n, BLOCK_K=block_k, ACC_TYPE=ACC_TYPE,
+                              num_warps=num_warps, num_stages=num_stages)
+        return c
+
+    @staticmethod
+    def forward(ctx, a, b, scale_a=None, scale_b=None, precision=None,
+                bias=None, activation=None, residual=None, alpha=None, out_dtype=None, acc_dtype=None):
+        return _matmul._call(a, b, scale_a, scale_b, precision, bias, activation, residual, alpha, out_dtype,
+                             acc_dtype)
+
+
+def matmul(a, b, scale_a=None, scale_b=None, precision=None,
+           bias=None, activation=None, residual=None, alpha=None, out_dtype=None, acc_dtype=None):
+    """
+    Returns `a @ b`, optionally dequantized with per-row scales of `a` and per-column
+    scales of `b`. float32 inputs are multiplied in tf32, or, with `precision="3xtf32"`,
+    with three tf32 products that recover near-fp32 accuracy. 3D operands are
+    multiplied as strided batches of matrices, and 2D operands are broadcast over
+    the batch. Products of up to 8 rows, as in decoding, may run on CUDA cores
+    instead of tensor cores, with K split across programs so that B is streamed
+    at the bandwidth of the whole GPU.
+
+    An epilogue is fused into the kernel and computes
+    `activation(alpha * (a @ b) + bias) + residual`, in `out_dtype`, where `bias` holds
+    one value per output column, `activation` is one of None, 'relu', 'gelu' (tanh
+    approximation) and 'silu', and `residual` has the shape of the output.
+
+    With `acc_dtype=torch.float16`, float16 products accumulate in float16 tensor-core
+    registers, which halves their number and lets the autotuner afford larger tiles, for
+    latency-critical inference that tolerates the rounding of the sums.
+    """
+    return _matmul.apply(a, b, scale_a, scale_b, precision, bias, activation, residual, alpha, out_dtype,
+                         acc_dtype)
 
 
-matmul = _matmul.apply
+def grouped_matmul(a, b):
+    """
+    Returns `[x @ y for x, y in zip(a, b)]`, computed by a single persistent
+    launch that walks the tiles of all the problems.
+    """
+    return _matmul._call_grouped(list(a), list(b))
@@ -0,0 +1,102 @@
+import torch
+
+import triton
+import triton.language as tl
+
+
+def compress_2_4(w):
+    """
+    Prunes the float16 or bfloat16 (M, K) matrix `w` to 2:4 structured sparsity, keeping the
+    two elements of largest magnitude in every group of four consecutive elements of a row.
+    Returns the kept values, of shape (M, K // 2), and their positions, as an int32 tensor of
+    shape (M, K // 32) in the format of `tl.sparse_dot`
+    """
+    M, K = w.shape
+    assert K % 32 == 0, "K must be a multiple of 32"
+    groups = w.reshape(M, K // 4, 4)
+    idx = groups.abs().topk(2, dim=-1).indices.sort(dim=-1).values
+    values = torch.gather(groups, -1, idx).reshape(M, K // 2)
+    nibbles = (idx[..., 0] | (idx[..., 1] << 2)).reshape(M, K // 32, 8)
+    shifts = 4 * torch.arange(8, device=w.device, dtype=torch.int64)
+    words = (nibbles << shifts).sum(dim=-1)
+    # words with the top bit set are negative as int32
+    words = torch.where(words >= 2**31, words - 2**32, words)
+    return values.contiguous(), words.to(torch.int32)
+
+
+@triton.autotune(
+    configs=[
+        triton.Config({'BLOCK_M': 128, 'BLOCK_N': 128, 'BLOCK_K': 64}, num_stages=3, num_warps=8),
+        triton.Config({'BLOCK_M': 64, 'BLOCK_N': 128, 'BLOCK_K': 64}, num_stages=3, num_warps=4),
+        triton.Config({'BLOCK_M': 64, 'BLOCK_N': 64, 'BLOCK_K': 64}, num_stages=4, num_warps=4),
+    ],
+    key=['M', 'N', 'K'],
+)
+@triton.jit
+def _kernel(A, E, B, C, M, N, K,
+            stride_am, stride_ak,
+            stride_em, stride_ek,
+            stride_bk, stride_bn,
+            stride_cm, stride_cn,
+            BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr,
+            GROUP_M: tl.constexpr):
+    # blocks of the sparse matrix hold BLOCK_K // 2 values per row, and their
+    # positions in BLOCK_K // 32 words of metadata
+    pid = tl.program_id(0)
+    grid_m = (M + BLOCK_M - 1) // BLOCK_M
+    grid_n = (N + BLOCK_N - 1) // BLOCK_N
+    # re-order program ID for better L2 performance
+    width = GROUP_M * grid_n
+    group_id = pid // width
+    group_size = min(grid_m - group_id * GROUP_M, GROUP_M)
+    pid_m = group_id * GROUP_M + (pid % group_size)
+    pid_n = (pid % width) // (group_size)
+    rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    ram = tl.max_contiguous(tl.multiple_of(rm % M, BLOCK_M), BLOCK_M)
+    rbn = tl.max_contiguous(tl.multiple_of(rn % N, BLOCK_N), BLOCK_N)
+    rka = tl.arange(0, BLOCK_K // 2)
+    rke = tl.arange(0, BLOCK_K // 32)
+    rk = tl.arange(0, BLOCK_K)
+    A = A + (ram[:, None] * stride_am + rka[None, :] * stride_ak)
+    E = E + (ram[:, None] * stride_em + rke[None, :] * stride_ek)
+    B = B + (rk[:, None] * stride_bk + rbn[None, :] * stride_bn)
+    acc = tl.zeros((BLOCK_M, BLOCK_N), dtype=tl.float32)
+    for k in range(K, 0, -BLOCK_K):
+        # the padding of the metadata keeps the first two positions of every group
+        a = tl.load(A, mask=rka[None, :] < k // 2, other=0.)
+        e = tl.load(E, mask=rke[None, :] < k // 32, other=0x44444444)
+        b = tl.load(B, mask=rk[:, None] < k, other=0.)
+        acc += tl.sparse_dot(a, e, b)
+        A += (BLOCK_K // 2) * stride_ak
+        E += (BLOCK_K // 32) * stride_ek
+        B += BLOCK_K * stride_bk
+    acc = acc.to(C.dtype.element_ty)
+    # rematerialize rm and rn to save registers
+    rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    C = C + (rm[:, None] * stride_cm + rn[None, :] * stride_cn)
+    mask = (rm < M)[:, None] & (rn < N)[None, :]
+    tl.store(C, acc, mask=mask)
+
+
+def matmul_2_4(a, meta, b):
+    """
+    Multiplies the 2:4 sparse matrix compressed by `compress_2_4` into `a` and `meta`
+    by the dense matrix `b`, on the sparse tensor cores of NVIDIA GPUs with sm >= 80
+    """
+    M, K = a.shape[0], 2 * a.shape[1]
+    assert b.shape[0] == K, "incompatible dimensions"
+    assert K % 32 == 0, "K must be a multiple of 32"
+    assert a.dtype == b.dtype and a.dtype in [torch.float16, torch.bfloat16]
+    assert meta.dtype == torch.int32 and meta.shape == (M, K // 32)
+    N = b.shape[1]
+    c = torch.empty((M, N), device=a.device, dtype=a.dtype)
+    grid = lambda META: (triton.cdiv(M, META['BLOCK_M']) * triton.cdiv(N, META['BLOCK_N']),)
+    _kernel[grid](a, meta, b, c, M, N, K,
+                  a.stride(0), a.stride(1),
+                  meta.stride(0), meta.stride(1),
+                  b.stride(0), b.stride(1),
+                  c.stride(0), c.stride(1),
+                  GROUP_M=8)
+    return c
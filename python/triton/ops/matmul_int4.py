@@ -0,0 +1,101 @@
+import torch
+
+import triton
+import triton.language as tl
+
+
+def pack_int4(w, group_size=128):
+    """
+    Quantizes the (K, N) matrix `w` to 4 bits, with one float16 scale per column
+    and group of `group_size` rows. Returns the packed weights, as an int32 tensor
+    of shape (K // 8, N) whose word (i, n) holds rows 8 i to 8 i + 7 of column n
+    from its lowest nibble up, and the scales, of shape (K // group_size, N).
+    """
+    K, N = w.shape
+    assert K % group_size == 0 and group_size % 8 == 0, "K must be a multiple of group_size"
+    w = w.float().reshape(K // group_size, group_size, N)
+    scales = (w.abs().amax(dim=1) / 7).clamp(min=1e-8)
+    q = torch.clamp(torch.round(w / scales[:, None, :]) + 8, 0, 15).to(torch.int32).reshape(K // 8, 8, N)
+    packed = torch.zeros((K // 8, N), device=w.device, dtype=torch.int32)
+    for i in range(8):
+        packed |= q[:, i, :] << (4 * i)
+    return packed, scales.half()
+
+
+@triton.autotune(
+    configs=[
+        triton.Config({'BLOCK_M': 16, 'BLOCK_N': 64, 'BLOCK_K': 64}, num_stages=3, num_warps=4),
+        triton.Config({'BLOCK_M': 16, 'BLOCK_N': 128, 'BLOCK_K': 32}, num_stages=3, num_warps=4),
+        triton.Config({'BLOCK_M': 64, 'BLOCK_N': 64, 'BLOCK_K': 32}, num_stages=3, num_warps=4),
+        triton.Config({'BLOCK_M': 128, 'BLOCK_N': 128, 'BLOCK_K': 32}, num_stages=3, num_warps=8),
+    ],
+    key=['M', 'N', 'K'],
+)
+@triton.jit
+def _kernel(A, B, Scales, C, M, N, K,
+            stride_am, stride_ak,
+            stride_bk, stride_bn,
+            stride_sk, stride_sn,
+            stride_cm, stride_cn,
+            GROUP_SIZE: tl.constexpr,
+            BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr,
+            GROUP_M: tl.constexpr):
+    # weights stay packed in global memory, and are unpacked to float16 in registers,
+    # right before the dot. The 8 rows of a word are loaded by the same warp, so
+    # each word is only read from DRAM once
+    pid = tl.program_id(0)
+    grid_m = (M + BLOCK_M - 1) // BLOCK_M
+    grid_n = (N + BLOCK_N - 1) // BLOCK_N
+    # re-order program ID for better L2 performance
+    width = GROUP_M * grid_n
+    group_id = pid // width
+    group_size = min(grid_m - group_id * GROUP_M, GROUP_M)
+    pid_m = group_id * GROUP_M + (pid % group_size)
+    pid_n = (pid % width) // (group_size)
+    rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    ram = tl.max_contiguous(tl.multiple_of(rm % M, BLOCK_M), BLOCK_M)
+    rbn = tl.max_contiguous(tl.multiple_of(rn % N, BLOCK_N), BLOCK_N)
+    rk = tl.arange(0, BLOCK_K)
+    A = A + (ram[:, None] * stride_am + rk[None, :] * stride_ak)
+    B = B + ((rk // 8)[:, None] * stride_bk + rbn[None, :] * stride_bn)
+    Scales = Scales + rbn * stride_sn
+    shifts = (rk % 8) * 4
+    acc = tl.zeros((BLOCK_M, BLOCK_N), dtype=tl.float32)
+    for k in range(0, K, BLOCK_K):
+        a = tl.load(A)
+        b = (tl.load(B) >> shifts[:, None]) & 0xF
+        scales = tl.load(Scales + (k // GROUP_SIZE) * stride_sk)
+        b = (b - 8).to(tl.float16) * scales[None, :]
+        acc += tl.dot(a, b)
+        A += BLOCK_K * stride_ak
+        B += (BLOCK_K // 8) * stride_bk
+    acc = acc.to(C.dtype.element_ty)
+    # rematerialize rm and rn to save registers
+    rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    C = C + (rm[:, None] * stride_cm + rn[None, :] * stride_cn)
+    mask = (rm < M)[:, None] & (rn < N)[None, :]
+    tl.store(C, acc, mask=mask)
+
+
+def matmul_int4(a, b, scales, group_size=128):
+    """
+    Multiplies the float16 matrix `a` by weights packed with `pack_int4`
+    """
+    M, K = a.shape
+    assert b.shape[0] * 8 == K, "incompatible dimensions"
+    assert b.dtype == torch.int32 and a.dtype == torch.float16
+    assert K % group_size == 0 and scales.shape[0] == K // group_size
+    # blocks of k never straddle two groups of scales
+    assert group_size % 64 == 0, "group_size must be a multiple of 64"
+    N = b.shape[1]
+    c = torch.empty((M, N), device=a.device, dtype=a.dtype)
+    grid = lambda META: (triton.cdiv(M, META['BLOCK_M']) * triton.cdiv(N, META['BLOCK_N']),)
+    _kernel[grid](a, b, scales, c, M, N, K,
+                  a.stride(0), a.stride(1),
+                  b.stride(0), b.stride(1),
+                  scales.stride(0), scales.stride(1),
+                  c.stride(0), c.stride(1),
+                  GROUP_SIZE=group_size, GROUP_M=8)
+    return c
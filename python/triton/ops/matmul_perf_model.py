@@ -1,9 +1,13 @@
+import functools
 import heapq
+import json
+import os
 
 import torch
 
 import triton
 import triton._C.libtriton.triton as _triton
+import triton.language as tl
 from triton.testing import get_dram_gbps, get_max_simd_tflops, get_max_tensorcore_tflops
 
 
@@ -26,53 +30,147 @@ def get_simd_tflops(backend, device, num_ctas, num_warps, dtype):
 def get_tflops(backend, device, num_ctas, num_warps, dtype):
     cc = _triton.runtime.cc(backend, device)
     if cc < 80 and dtype == torch.float32:
-        return get_simd_tflops()
+        return get_simd_tflops(backend, device, num_ctas, num_warps, dtype)
     return get_tensorcore_tflops(backend, device, num_ctas, num_warps, dtype)
 
 
-def estimate_matmul_time(
-    # backend, device,
-    num_warps, num_stages,
-    A, B, C,
-    M, N, K,
-    BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K,
-    debug=False, **kwargs
-):
-    ''' return estimated running time in ms
-          = max(compute, loading) + store '''
+def get_active_dram_gbps(backend, device, num_ctas):
+    ''' return the DRAM bandwidth in GB/s that `num_ctas` programs can draw '''
+    active_cta_ratio_bw1 = min(1, num_ctas / 32)  # 32 active ctas are enough to saturate
+    active_cta_ratio_bw2 = max(min(1, (num_ctas - 32) / (108 - 32)), 0)  # 32-108, remaining 5%
+    return get_dram_gbps(backend, device) * (active_cta_ratio_bw1 * 0.95 + active_cta_ratio_bw2 * 0.05)
+
+
+def estimate_occupancy(backend, device, num_warps, num_stages, BLOCK_M, BLOCK_N, BLOCK_K, dtsize, resources=None,
+                       acc_size=4):
+    ''' return the number of CTAs resident on a multiprocessor, as reported in the
+        `resources` of the compiled kernel when available '''
+    if resources and resources.get('max_ctas_per_sm', 0) > 0:
+        return resources['max_ctas_per_sm']
+    cc = _triton.runtime.cc(backend, device)
+    # shared memory holds the pipeline stages of both operands
+    smem = (BLOCK_M + BLOCK_N) * BLOCK_K * num_stages * dtsize
+    by_smem = _triton.runtime.max_shared_memory(backend, device) // max(smem, 1)
+    # accumulators (of `acc_size` bytes) dominate register usage, plus operands and addresses
+    regs = min(255, BLOCK_M * BLOCK_N * acc_size // 4 // (num_warps * 32) + 64)
+    by_regs = 65536 // (regs * num_warps * 32)
+    max_warps = {75: 32, 86: 48, 89: 48}.get(cc, 64)
+    return max(1, min(by_smem, by_regs, max_warps // num_warps, 32))
+
+
+def estimate_dram_traffic(backend, device, M, N, K, BLOCK_M, BLOCK_N, SPLIT_K, ctas_per_wave, dtsize, GROUP_M=8):
+    ''' return the bytes loaded from DRAM and from L2 by the programs of a matmul.
+        Programs are rasterized in groups of GROUP_M rows of tiles, so that the programs of a wave
+        share the panels of A and B they load as long as these fit in L2 '''
+    num_cta_m = triton.cdiv(M, BLOCK_M)
+    num_cta_n = triton.cdiv(N, BLOCK_N)
+    # every program loads a panel of A and a panel of B
+    total = (num_cta_n * M + num_cta_m * N) * K * dtsize
+    compulsory = (M + N) * K * dtsize
+    # panels touched by a wave (of tiles, over all the slices of K)
+    tiles_per_wave = max(1, ctas_per_wave // SPLIT_K)
+    rows = min(GROUP_M, num_cta_m, tiles_per_wave)
+    cols = min(num_cta_n, triton.cdiv(tiles_per_wave, rows))
+    unique = (rows * BLOCK_M + cols * BLOCK_N) * K * dtsize
+    num_waves = triton.cdiv(num_cta_m * num_cta_n, rows * cols)
+    l2_size = _triton.runtime.l2_cache_size(backend, device)
+    hit_ratio = 1. if unique <= l2_size else l2_size / unique
+    dram = num_waves * unique + (total - num_waves * unique) * (1 - hit_ratio)
+    dram = min(total, max(compulsory, dram))
+    return dram, total - dram
+
+
+_perf_table_path = os.path.join(os.path.dirname(__file__), 'matmul_perf_table.json')
+
+
+def load_perf_table(path=None):
+    ''' return the measured matmul timings stored at `path` (by default, $TRITON_MATMUL_PERF_TABLE
+        or matmul_perf_table.json next to this file), keyed by device name '''
+    path = path or os.environ.get('TRITON_MATMUL_PERF_TABLE', _perf_table_path)
+    if not os.path.exists(path):
+        return dict()
+    with open(path) as f:
+        return json.load(f)
+
+
+def update_perf_table(named_args, timings, path=None):
+    ''' record the `timings` of an Autotuner (its `configs_timings`) for the matmul called with `named_args` '''
+    path = path or os.environ.get('TRITON_MATMUL_PERF_TABLE', _perf_table_path)
+    table = load_perf_table(path)
+    entries = table.setdefault(torch.cuda.get_device_name(), [])
+    A = named_args['A']
+    for config, ms in timings.items():
+        ms = ms[0] if isinstance(ms, (list, tuple)) else ms
+        # configs that could not run
+        if ms == float('inf'):
+            continue
+        entries.append(dict(M=named_args['M'], N=named_args['N'], K=named_args['K'], dtype=str(A.dtype),
+                            num_warps=config.num_warps, num_stages=config.num_stages, ms=ms, **config.kwargs))
+    with open(path, 'w') as f:
+        json.dump(table, f)
+    calibration.cache_clear()
+
+
+@functools.lru_cache()
+def calibration(device_name):
+    ''' return factors that scale the (compute, load) times of the model to the medians of the
+        measurements of compute-bound and of memory-bound entries of the perf table '''
+    ratios = {True: [], False: []}
+    dtypes = {str(dtype): dtype for dtype in [torch.float16, torch.bfloat16, torch.float32, torch.int8]}
+    for e in load_perf_table().get(device_name, []):
+        if e['dtype'] not in dtypes:
+            continue
+        A = torch.empty(0, dtype=dtypes[e['dtype']])
+        times = _estimate_matmul_times(e['num_warps'], e['num_stages'], A, e['M'], e['N'], e['K'],
+                                       e['BLOCK_M'], e['BLOCK_N'], e['BLOCK_K'], e.get('SPLIT_K', 1))
+        compute_ms, load_ms, store_ms = times
+        predicted = max(compute_ms, load_ms) + store_ms
+        if predicted > 0:
+            ratios[compute_ms >= load_ms].append(e['ms'] / predicted)
+    median = lambda x: sorted(x)[len(x) // 2] if x else 1.
+    return median(ratios[True]), median(ratios[False])
+
+
+def _estimate_matmul_times(num_warps, num_stages, A, M, N, K, BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K,
+                           STREAM_K=False, resources=None, debug=False, acc_size=4):
     backend = _triton.runtime.backend.CUDA
     device = torch.cuda.current_device()
     dtype = A.dtype
     dtsize = A.element_size()
 
+    num_sm = _triton.runtime.num_sm(backend, device)
     num_cta_m = triton.cdiv(M, BLOCK_M)
     num_cta_n = triton.cdiv(N, BLOCK_N)
     num_cta_k = SPLIT_K
     num_ctas = num_cta_m * num_cta_n * num_cta_k
+    num_tiles = num_ctas
+    # CTAs that run concurrently
+    occupancy = estimate_occupancy(backend, device, num_warps, num_stages, BLOCK_M, BLOCK_N, BLOCK_K, dtsize, resources,
+                                   acc_size)
+    ctas_per_wave = num_sm * occupancy
+    if STREAM_K:
+        num_ctas = num_sm
 
     # If the input is smaller than the block size
     M, N = max(M, BLOCK_M), max(N, BLOCK_N)
 
     # time to compute
     total_ops = 2 * M * N * K / (1024 * 1024 * 1024)  # GOPS
-    tput = get_tflops(backend, device, num_ctas, num_warps, dtype)
+    tput = get_tflops(backend, device, min(num_ctas, ctas_per_wave), num_warps, dtype)
     compute_ms = total_ops / tput
+    # multiprocessors idle during the last, partial wave of a data-parallel grid
+    if not STREAM_K and num_ctas > ctas_per_wave:
+        num_waves = triton.cdiv(num_ctas, ctas_per_wave)
+        compute_ms *= num_waves * ctas_per_wave / num_ctas
 
     # time to load data
-    num_sm = _triton.runtime.num_sm(backend, device)
     active_cta_ratio = min(1, num_ctas / num_sm)
-    active_cta_ratio_bw1 = min(1, num_ctas / 32)  # 32 active ctas are enough to saturate
-    active_cta_ratio_bw2 = max(min(1, (num_ctas - 32) / (108 - 32)), 0)  # 32-108, remaining 5%
-    dram_bw = get_dram_gbps(backend, device) * (active_cta_ratio_bw1 * 0.95 + active_cta_ratio_bw2 * 0.05)  # in GB/s
+    dram_bw = get_active_dram_gbps(backend, device, num_ctas)
     l2_bw = dram_bw * 4  # rough estimation (should be 4.7 for A100?)
-    # assume 80% of (following) loads are in L2 cache
-    load_a_dram = M * K * dtsize * (1 + 0.2 * (num_cta_n - 1))
-    load_a_l2 = M * K * dtsize * 0.8 * (num_cta_n - 1)
-    load_b_dram = N * K * dtsize * (1 + 0.2 * (num_cta_m - 1))
-    load_b_l2 = N * K * dtsize * 0.8 * (num_cta_m - 1)
-    # total
-    total_dram = (load_a_dram + load_b_dram) / (1024 * 1024)  # MB
-    total_l2 = (load_a_l2 + load_b_l2) / (1024 * 1024)
+    dram, l2 = estimate_dram_traffic(backend, device, M, N, K, BLOCK_M, BLOCK_N, SPLIT_K,
+                                     min(num_ctas, ctas_per_wave), dtsize)
+    total_dram = dram / (1024 * 1024)  # MB
+    total_l2 = l2 / (1024 * 1024)
     # loading time in ms
     load_ms = total_dram / dram_bw + total_l2 / l2_bw
 
@@ -84,18 +182,110 @@ def estimate_matmul_time(
     else:
         reduce_bw = store_bw
         store_ms = store_c_dram / reduce_bw
-        # c.zero_()
-        zero_ms = M * N * 2 / (1024 * 1024) / store_bw
-        store_ms += zero_ms
+        # slices after the first read back the partial sum of the previous one
+        store_ms += M * N * dtsize * (SPLIT_K - 1) / (1024 * 1024) / dram_bw
+    if STREAM_K and num_tiles % num_sm != 0:
+        # every program may publish one fp32 partial tile, which is read back once
+        fixup_mb = num_sm * BLOCK_M * BLOCK_N * 4 * 2 / (1024 * 1024)
+        store_ms += fixup_mb / l2_bw
+    if debug:
+        print(f'compute time: {compute_ms}ms, loading time: {load_ms}ms, store time: {store_ms}ms, '
+              f'Activate CTAs: {active_cta_ratio*100}%, CTAs per SM: {occupancy}, '
+              f'L2 hit rate: {100 * l2 / max(dram + l2, 1)}%')
+    return compute_ms, load_ms, store_ms
+
+
+def estimate_matmul_time(
+    # backend, device,
+    num_warps, num_stages,
+    A, B, C,
+    M, N, K,
+    BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K,
+    debug=False, STREAM_K=False, resources=None, **kwargs
+):
+    ''' return estimated running time in ms
+          = max(compute, loading) + store
+        Compute accounts for the waves of CTAs that fit on the GPU, given the `resources` of the compiled
+        kernel when known, and loads for the reuse of operands in L2 between the CTAs of a wave.
+        Both are scaled by factors calibrated against the measurements of the perf table.
+        `STREAM_K` estimates the persistent schedule of `_kernel_stream_k` '''
+    acc_size = 2 if kwargs.get('ACC_TYPE') == tl.float16 else 4
+    compute_ms, load_ms, store_ms = _estimate_matmul_times(num_warps, num_stages, A, M, N, K,
+                                                           BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K,
+                                                           STREAM_K=STREAM_K, resources=resources, debug=debug,
+                                                           acc_size=acc_size)
+    compute_scale, load_scale = calibration(torch.cuda.get_device_name())
+    total_time_ms = max(compute_ms * compute_scale, load_ms * load_scale) + store_ms * load_scale
+    if debug:
+        print(f'Total time: {total_time_ms}ms')
+    return total_time_ms
+
 
-    total_time_ms = max(compute_ms, load_ms) + store_ms
+# products with at most this many rows may use the skinny kernel of `matmul`
+SKINNY_M = 8
+
+
+def skinny_config(A, M, N, K):
+    ''' return the (BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K) of the skinny kernel of `matmul`: all the rows
+        in one tile, 16KB tiles of B, and enough slices of K for two waves, each at least 4 blocks deep '''
+    dtsize = A.element_size()
+    num_sm = _triton.runtime.num_sm(_triton.runtime.backend.CUDA, torch.cuda.current_device())
+    BLOCK_M = max(4, triton.next_power_of_2(M))
+    BLOCK_N = 128 if dtsize == 4 else 256
+    BLOCK_K = 16384 // (BLOCK_N * dtsize)
+    SPLIT_K = max(1, min(triton.cdiv(2 * num_sm, triton.cdiv(N, BLOCK_N)), K // (4 * BLOCK_K), 64))
+    return BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K
+
+
+def estimate_skinny_time(A, M, N, K, BLOCK_M, BLOCK_N, BLOCK_K, SPLIT_K, num_warps=4, debug=False):
+    ''' return estimated running time in ms of the skinny kernel of `matmul`, which reads B once
+        and multiplies on CUDA cores: FMAs, or dp4a for int8, on every row of its tiles '''
+    backend = _triton.runtime.backend.CUDA
+    device = torch.cuda.current_device()
+    dtsize = A.element_size()
+    num_ctas = triton.cdiv(N, BLOCK_N) * SPLIT_K
+    ops_per_fma = 4 if A.dtype == torch.int8 else 1
+    tput = get_simd_tflops(backend, device, num_ctas, num_warps, torch.float32) * ops_per_fma
+    compute_ms = 2 * BLOCK_M * N * K / (1024 * 1024 * 1024) / tput
+    # A and B come from DRAM once, and every strip of columns reads A again from L2
+    dram_bw = get_active_dram_gbps(backend, device, num_ctas)
+    dram = (N + M) * K * dtsize / (1024 * 1024)
+    l2 = triton.cdiv(N, BLOCK_N) * M * K * dtsize / (1024 * 1024)
+    load_ms = dram / dram_bw + l2 / (dram_bw * 4)
+    # slices write their 32-bit partial sums, which the last one reads back from L2
+    store_ms = M * N * dtsize / (1024 * 1024) / (dram_bw * 0.6)
+    if SPLIT_K > 1:
+        store_ms += 2 * SPLIT_K * M * N * 4 / (1024 * 1024) / (dram_bw * 4)
+    compute_scale, load_scale = calibration(torch.cuda.get_device_name())
+    total_time_ms = max(compute_ms * compute_scale, load_ms * load_scale) + store_ms * load_scale
     if debug:
-        print(f'Total time: {total_time_ms}ms, compute time: {compute_ms}ms, '
-              f'loading time: {load_ms}ms, store time: {store_ms}ms, '
-              f'Activate CTAs: {active_cta_ratio*100}%')
+        print(f'compute time: {compute_ms}ms, loading time: {load_ms}ms, store time: {store_ms}ms, '
+              f'Total time: {total_time_ms}ms')
     return total_time_ms
 
 
+def select_schedule(A, B, M, N, K, BLOCK_M=128, BLOCK_N=128, BLOCK_K=32, num_warps=4, num_stages=4):
+    ''' return the tile schedule of `matmul` estimated to be the fastest:
+          "data_parallel", "split_k", "stream_k" or "skinny" '''
+    backend = _triton.runtime.backend.CUDA
+    device = torch.cuda.current_device()
+    args = dict(num_warps=num_warps, num_stages=num_stages, A=A, B=B, C=None, M=M, N=N, K=K,
+                BLOCK_M=BLOCK_M, BLOCK_N=BLOCK_N, BLOCK_K=BLOCK_K)
+    times = {'data_parallel': estimate_matmul_time(**args, SPLIT_K=1)}
+    # split-k slices accumulate into C in turn
+    split_ks = [split_k for split_k in [2, 4, 8, 16] if K >= BLOCK_K * split_k]
+    if A.dtype in [torch.float16, torch.float32] and split_ks:
+        times['split_k'] = min(estimate_matmul_time(**args, SPLIT_K=split_k) for split_k in split_ks)
+    # stream-k only helps when tiles do not fill whole waves
+    num_tiles = triton.cdiv(M, BLOCK_M) * triton.cdiv(N, BLOCK_N)
+    if num_tiles % _triton.runtime.num_sm(backend, device) != 0:
+        times['stream_k'] = estimate_matmul_time(**args, SPLIT_K=1, STREAM_K=True)
+    # a few rows waste most of each tensor core instruction, and are bound by the reads of B
+    if M <= SKINNY_M and A.dtype in [torch.float16, torch.float32, torch.int8]:
+        times['skinny'] = estimate_skinny_time(A, M, N, K, *skinny_config(A, M, N, K), num_warps=num_warps)
+    return min(times, key=times.get)
+
+
 def early_config_prune(configs, named_args):
     backend = _triton.runtime.backend.CUDA
     device = torch.cuda.current_device()
@@ -116,8 +306,10 @@ def early_config_prune(configs, named_args):
             pruned_configs.append(config)
     configs = pruned_configs
 
-    # Some dtypes do not allow atomic_add
-    if dtype not in [torch.float16, torch.float32]:
+    # split-k is only tuned for float16 and float32, and activations do not distribute
+    # over partial sums
+    if dtype not in [torch.float16, torch.float32] or named_args['C'].dtype not in [torch.float16, torch.float32] \
+            or named_args.get('ACTIVATION') is not None:
         configs = [config for config in configs if config.kwargs['SPLIT_K'] == 1]
 
     # group configs by (BLOCK_M,_N,_K, SPLIT_K, num_warps)
@@ -155,3 +347,17 @@ def early_config_prune(configs, named_args):
             random_config.num_stages = 2
             pruned_configs.append(random_config)
     return pruned_configs
+
+
+def resource_config_prune(configs, binaries):
+    ''' drop compiled configs that spill registers, and configs whose resident warps
+        cannot keep the 4 schedulers of a multiprocessor busy, unless no other config can '''
+    configs = triton.code_gen.default_resource_config_prune(configs, binaries)
+
+    def is_busy(config):
+        bin = binaries.get(config, None)
+        if bin is None or 'max_ctas_per_sm' not in bin.resources:
+            return True
+        return bin.resources['max_ctas_per_sm'] * config.num_warps >= 4
+    busy_configs = [config for config in configs if is_busy(config)]
+    return busy_configs if busy_configs else configs
@@ -0,0 +1,170 @@
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+# ********************************************************
+# --------------------------------------------------------
+# Decode attention over a paged KV-cache
+# Each sequence has one query token, and its keys and
+# values are stored in pages of the cache, listed by its
+# row of the block table. Long sequences are split across
+# programs: each one computes the softmax of its pages,
+# and a second kernel merges the splits by the log-sum-exp
+# of their scores
+# --------------------------------------------------------
+# ********************************************************
+
+
+@triton.jit
+def _split_kernel(
+    Q, K, V, BlockTables, SeqLens, Out, PartialOut, PartialLse, sm_scale,
+    stride_qb, stride_qh,
+    stride_kp, stride_kh, stride_kt,
+    stride_vp, stride_vh, stride_vt,
+    stride_tb, stride_ob, stride_oh,
+    H, GROUP, PAGES_PER_SPLIT,
+    BLOCK_DMODEL: tl.constexpr, PAGE: tl.constexpr, NUM_SPLITS: tl.constexpr
+):
+    off_bh = tl.program_id(0)
+    split = tl.program_id(1)
+    off_b = off_bh // H
+    off_h = off_bh % H
+    # query heads share the key and value heads of their group
+    off_kvh = off_h // GROUP
+    seqlen = tl.load(SeqLens + off_b)
+    offs_t = tl.arange(0, PAGE)
+    offs_d = tl.arange(0, BLOCK_DMODEL)
+    q = tl.load(Q + off_b * stride_qb + off_h * stride_qh + offs_d).to(tl.float32) * sm_scale
+    # running maximum, sum of the exponentials and output of each position of the pages,
+    # which are only reduced across positions once all the pages of the split are read
+    m_i = tl.zeros([PAGE], dtype=tl.float32) - 1e30
+    l_i = tl.zeros([PAGE], dtype=tl.float32)
+    acc = tl.zeros([PAGE, BLOCK_DMODEL], dtype=tl.float32)
+    start = split * PAGES_PER_SPLIT
+    end = tl.minimum(start + PAGES_PER_SPLIT, (seqlen + PAGE - 1) // PAGE)
+    for p in range(start, end):
+        page = tl.load(BlockTables + off_b * stride_tb + p).to(tl.int64)
+        cols = p * PAGE + offs_t
+        valid = cols < seqlen
+        # pages are read one contiguous row per position
+        k = tl.load(K + page * stride_kp + off_kvh * stride_kh + offs_t[:, None] * stride_kt + offs_d[None, :],
+                    mask=valid[:, None], other=0.)
+        s = tl.sum(k.to(tl.float32) * q[None, :], 1)
+        s = tl.where(valid, s, float("-inf"))
+        # online softmax
+        m_new = tl.maximum(m_i, s)
+        alpha = tl.exp(m_i - m_new)
+        prob = tl.exp(s - m_new)
+        l_i = l_i * alpha + prob
+        v = tl.load(V + page * stride_vp + off_kvh * stride_vh + offs_t[:, None] * stride_vt + offs_d[None, :],
+                    mask=valid[:, None], other=0.)
+        acc = acc * alpha[:, None] + prob[:, None] * v.to(tl.float32)
+        m_i = m_new
+    m = tl.max(m_i, 0)
+    scale = tl.exp(m_i - m)
+    l = tl.sum(l_i * scale, 0)
+    # splits past the end of their sequence have no scores
+    has_scores = l > 0
+    o = tl.sum(acc * scale[:, None], 0) / tl.where(has_scores, l, 1.)
+    if NUM_SPLITS == 1:
+        tl.store(Out + off_b * stride_ob + off_h * stride_oh + offs_d, o.to(Out.dtype.element_ty))
+    else:
+        tl.store(PartialOut + (off_bh * NUM_SPLITS + split) * BLOCK_DMODEL + offs_d, o)
+        tl.store(PartialLse + off_bh * NUM_SPLITS + split, tl.where(has_scores, m + tl.log(l), float("-inf")))
+
+
+@triton.jit
+def _merge_kernel(
+    PartialOut, PartialLse, Out,
+    stride_ob, stride_oh,
+    H,
+    BLOCK_DMODEL: tl.constexpr, NUM_SPLITS: tl.constexpr, BLOCK_SPLITS: tl.constexpr
+):
+    off_bh = tl.program_id(0)
+    off_b = off_bh // H
+    off_h = off_bh % H
+    offs_s = tl.arange(0, BLOCK_SPLITS)
+    offs_d = tl.arange(0, BLOCK_DMODEL)
+    mask = offs_s < NUM_SPLITS
+    lse = tl.load(PartialLse + off_bh * NUM_SPLITS + offs_s, mask=mask, other=float("-inf"))
+    # weights of the splits; sequences without any score have none
+    m = tl.maximum(tl.max(lse, 0), -1e30)
+    w = tl.exp(lse - m)
+    denom = tl.sum(w, 0)
+    o = tl.load(PartialOut + (off_bh * NUM_SPLITS + offs_s[:, None]) * BLOCK_DMODEL + offs_d[None, :],
+                mask=mask[:, None], other=0.)
+    o = tl.sum(o * w[:, None], 0) / tl.where(denom > 0, denom, 1.)
+    tl.store(Out + off_b * stride_ob + off_h * stride_oh + offs_d, o.to(Out.dtype.element_ty))
+
+
+def _num_splits(num_heads, max_pages, device):
+    # enough programs for two waves, without splits shorter than 4 pages
+    num_sm = _triton.runtime.num_sm(_triton.runtime.backend.CUDA, device.index)
+    return max(1, min(triton.cdiv(2 * num_sm, num_heads), triton.cdiv(max_pages, 4)))
+
+
+def paged_attention(q, k_cache, v_cache, block_tables, seqlens, sm_scale=None, num_splits=None):
+    """
+    Computes softmax(q @ k^T * sm_scale) @ v for one query token per sequence, with the keys
+    and values of the sequences stored in pages of a cache, as in the decode step of LLM serving.
+
+    :param q: queries, of shape (B, H, D)
+    :param k_cache: pages of keys, of shape (num_pages, H_KV, PAGE, D), where H is a multiple of
+        H_KV: query head h reads key head h // (H // H_KV). D and PAGE must be powers of two
+    :param v_cache: pages of values, of the same shape as `k_cache`
+    :param block_tables: int32 tensor of shape (B, max_pages): position t of sequence b is at
+        position t % PAGE of page block_tables[b, t // PAGE]
+    :param seqlens: int32 tensor of the B numbers of cached tokens of the sequences
+    :param sm_scale: scale of the scores; defaults to 1 / sqrt(D)
+    :param num_splits: number of programs that share each sequence, whose results are merged
+        by a second kernel; by default, enough to fill the GPU
+    """
+    B, H, D = q.shape
+    num_pages, H_KV, PAGE, _ = k_cache.shape
+    if v_cache.shape != k_cache.shape or k_cache.shape[3] != D:
+        raise ValueError(f"k_cache and v_cache must have shape (num_pages, H_KV, PAGE, {D}) "
+                         f"(got {k_cache.shape} and {v_cache.shape})")
+    if H % H_KV != 0:
+        raise ValueError(f"the number of query heads ({H}) must be a multiple of that of key heads ({H_KV})")
+    if D & (D - 1) or D < 16 or PAGE & (PAGE - 1) or PAGE < 16:
+        raise ValueError(f"head dimension and page size must be powers of two >= 16 (got {D} and {PAGE})")
+    if block_tables.shape[0] != B or seqlens.shape != (B,):
+        raise ValueError("block_tables and seqlens must have one row per sequence")
+    if sm_scale is None:
+        sm_scale = D ** -0.5
+    # rows of pages are read as vectors
+    q = q if q.stride(2) == 1 else q.contiguous()
+    k_cache = k_cache if k_cache.stride(3) == 1 else k_cache.contiguous()
+    v_cache = v_cache if v_cache.stride(3) == 1 else v_cache.contiguous()
+    block_tables = block_tables.to(dtype=torch.int32)
+    seqlens = seqlens.to(dtype=torch.int32).contiguous()
+    max_pages = max(block_tables.shape[1], 1)
+    if num_splits is None:
+        num_splits = _num_splits(B * H, max_pages, q.device)
+    pages_per_split = triton.cdiv(max_pages, num_splits)
+    num_splits = triton.cdiv(max_pages, pages_per_split)
+    out = torch.empty_like(q)
+    num_warps = 4 if D <= 128 else 8
+    with triton.workspace.scope(q.device) as ws:
+        partial_out = ws.empty((B * H, num_splits, D), torch.float32) if num_splits > 1 else None
+        partial_lse = ws.empty((B * H, num_splits), torch.float32) if num_splits > 1 else None
+        _split_kernel[(B * H, num_splits)](
+            q, k_cache, v_cache, block_tables, seqlens, out, partial_out, partial_lse, sm_scale,
+            q.stride(0), q.stride(1),
+            k_cache.stride(0), k_cache.stride(1), k_cache.stride(2),
+            v_cache.stride(0), v_cache.stride(1), v_cache.stride(2),
+            block_tables.stride(0), out.stride(0), out.stride(1),
+            H, H // H_KV, pages_per_split,
+            BLOCK_DMODEL=D, PAGE=PAGE, NUM_SPLITS=num_splits, num_warps=num_warps,
+        )
+        if num_splits > 1:
+            _merge_kernel[(B * H,)](
+                partial_out, partial_lse, out,
+                out.stride(0), out.stride(1),
+                H,
+                BLOCK_DMODEL=D, NUM_SPLITS=num_splits, BLOCK_SPLITS=max(16, triton.next_power_of_2(num_splits)),
+                num_warps=4,
+            )
+    return out
@@ -0,0 +1,110 @@
+import torch
+
+import triton
+import triton.language as tl
+
+# axes of the batch of tiles, after those of the tile
+MAX_BATCH_DIMS = 4
+
+
+# ********************************************************
+# --------------------------------------------------------
+# Permutation of the axes of a tensor
+# Programs copy 2D tiles spanned by the axis that is
+# contiguous in the input and by the one that is contiguous
+# in the output. Tiles are loaded along the first and
+# stored along the second, with 128-bit accesses on both
+# sides: the layout conversion in between goes through
+# swizzled shared memory
+# --------------------------------------------------------
+# ********************************************************
+
+
+@triton.jit
+def _kernel(X, Y, size_0, size_1,
+            stride_x0, stride_x1, stride_y0, stride_y1,
+            size_b0, size_b1, size_b2, size_b3,
+            stride_xb0, stride_xb1, stride_xb2, stride_xb3,
+            stride_yb0, stride_yb1, stride_yb2, stride_yb3,
+            BLOCK_0: tl.constexpr, BLOCK_1: tl.constexpr):
+    pid = tl.program_id(0)
+    grid_0 = (size_0 + BLOCK_0 - 1) // BLOCK_0
+    grid_1 = (size_1 + BLOCK_1 - 1) // BLOCK_1
+    # consecutive programs copy neighbouring tiles of the same batch
+    pid_b = pid // (grid_0 * grid_1)
+    pid_t = pid % (grid_0 * grid_1)
+    pid_0 = pid_t // grid_1
+    pid_1 = pid_t % grid_1
+    # offsets of the batch, whose last axis is the fastest
+    i3 = pid_b % size_b3
+    pid_b = pid_b // size_b3
+    i2 = pid_b % size_b2
+    pid_b = pid_b // size_b2
+    i1 = pid_b % size_b1
+    i0 = pid_b // size_b1
+    X += i0 * stride_xb0 + i1 * stride_xb1 + i2 * stride_xb2 + i3 * stride_xb3
+    Y += i0 * stride_yb0 + i1 * stride_yb1 + i2 * stride_yb2 + i3 * stride_yb3
+    r0 = pid_0 * BLOCK_0 + tl.arange(0, BLOCK_0)
+    r1 = pid_1 * BLOCK_1 + tl.arange(0, BLOCK_1)
+    mask = (r0 < size_0)[:, None] & (r1 < size_1)[None, :]
+    x = tl.load(X + r0[:, None] * stride_x0 + r1[None, :] * stride_x1, mask=mask)
+    tl.store(Y + r0[:, None] * stride_y0 + r1[None, :] * stride_y1, x, mask=mask)
+
+
+def _coalesce(axes):
+    """
+    Merges the (size, input stride, output stride) of consecutive axes of the output
+    that are also consecutive, in the same order, in the input, and drops axes of size 1
+    """
+    axes = [a for a in axes if a[0] > 1]
+    merged = []
+    for size, stride_x, stride_y in axes:
+        if merged:
+            outer_size, outer_x, outer_y = merged[-1]
+            if outer_x == size * stride_x and outer_y == size * stride_y:
+                merged[-1] = (outer_size * size, stride_x, stride_y)
+                continue
+        merged.append((size, stride_x, stride_y))
+    return merged
+
+
+def permute(x, dims):
+    """
+    Returns `x.permute(dims).contiguous()`, for tensors of rank at most 6.
+    The axes that stay consecutive in the same order are merged, and the copy is
+    tiled over the axis of unit stride in `x` and the one of the result.
+    """
+    dims = [d % x.dim() for d in dims] if x.dim() > 0 else list(dims)
+    assert sorted(dims) == list(range(x.dim())), f"{dims} is not a permutation of the axes of x"
+    assert x.dim() <= 2 + MAX_BATCH_DIMS, "permute supports tensors of rank at most 6"
+    y = torch.empty([x.shape[d] for d in dims], dtype=x.dtype, device=x.device)
+    if y.numel() == 0:
+        return y
+    # axes in the order of the output, outermost first
+    axes = _coalesce([(x.shape[d], x.stride(d), y.stride(i)) for i, d in enumerate(dims)])
+    if not axes:
+        axes = [(1, 1, 1)]
+    # the tile spans the axis that is contiguous in y and the one with the smallest stride in x
+    axis_1 = len(axes) - 1
+    axis_0 = min(range(len(axes)), key=lambda i: (axes[i][1], -axes[i][0]))
+    if axis_0 == axis_1:
+        # the innermost axis is kept: tiles of rows, both copied along their rows
+        others = [i for i in range(len(axes)) if i != axis_1]
+        axis_0 = max(others, key=lambda i: axes[i][0]) if others else None
+    tile_0 = axes[axis_0] if axis_0 is not None else (1, 0, 0)
+    tile_1 = axes[axis_1]
+    batch = [axes[i] for i in range(len(axes)) if i not in [axis_0, axis_1]]
+    batch = [(1, 0, 0)] * (MAX_BATCH_DIMS - len(batch)) + batch
+    num_batches = 1
+    for size, _, _ in batch:
+        num_batches *= size
+    # 64 elements of 16 bits or more, or 128 bytes, per row of a tile
+    BLOCK = 128 if x.element_size() == 1 else 64
+    BLOCK_0 = min(BLOCK, triton.next_power_of_2(tile_0[0]))
+    BLOCK_1 = min(BLOCK, triton.next_power_of_2(tile_1[0]))
+    grid = (triton.cdiv(tile_0[0], BLOCK_0) * triton.cdiv(tile_1[0], BLOCK_1) * num_batches,)
+    _kernel[grid](x, y, tile_0[0], tile_1[0],
+                  tile_0[1], tile_1[1], tile_0[2], tile_1[2],
+                  *[b[0] for b in batch], *[b[1] for b in batch], *[b[2] for b in batch],
+                  BLOCK_0=BLOCK_0, BLOCK_1=BLOCK_1, num_warps=4)
+    return y
@@ -0,0 +1,122 @@
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+# ********************************************************
+# --------------------------------------------------------
+# Split reductions
+# Rows too long for one program are cut into chunks that
+# are reduced by different programs. Each program writes
+# its partial result to a workspace and increments the
+# counter of its row; the last program to arrive reduces
+# the partials and resets the counter
+# --------------------------------------------------------
+# ********************************************************
+
+OPS = ['sum', 'max', 'argmax']
+
+
+@triton.jit
+def _split_reduce(X, Out, Partials, PartialIdx, Counters, stride_xm, N, CHUNK,
+                  OP: tl.constexpr, BLOCK: tl.constexpr, NUM_CHUNKS: tl.constexpr):
+    row = tl.program_id(0)
+    chunk = tl.program_id(1)
+    num_chunks = tl.num_programs(1)
+    X += row * stride_xm
+    start = chunk * CHUNK
+    end = min(start + CHUNK, N)
+    cols = tl.arange(0, BLOCK)
+    # per-lane reduction of the chunk
+    if OP == 'sum':
+        acc = tl.zeros([BLOCK], dtype=tl.float32)
+    else:
+        acc = tl.zeros([BLOCK], dtype=tl.float32) - float('inf')
+        idx = tl.zeros([BLOCK], dtype=tl.int32) + start
+    for off in range(start, end, BLOCK):
+        offs = off + cols
+        if OP == 'sum':
+            acc += tl.load(X + offs, mask=offs < end, other=0.).to(tl.float32)
+        else:
+            x = tl.load(X + offs, mask=offs < end, other=-float('inf')).to(tl.float32)
+            # lanes keep their first maximum
+            update = x > acc
+            acc = tl.where(update, x, acc)
+            idx = tl.where(update, offs, idx)
+    # partial result of the chunk
+    Partials += row * num_chunks
+    PartialIdx += row * num_chunks
+    if OP == 'sum':
+        tl.store(Partials + chunk, tl.sum(acc, 0))
+    else:
+        part = tl.max(acc, 0)
+        tl.store(Partials + chunk, part)
+        if OP == 'argmax':
+            tl.store(PartialIdx + chunk, tl.min(tl.where(acc == part, idx, N), 0))
+    # the partials are visible to other programs before the counter is incremented
+    count = tl.atomic_add(Counters + row, 1)
+    if count == num_chunks - 1:
+        offs_c = tl.arange(0, NUM_CHUNKS)
+        mask = offs_c < num_chunks
+        if OP == 'sum':
+            parts = tl.load(Partials + offs_c, mask=mask, other=0.)
+            tl.store(Out + row, tl.sum(parts, 0).to(Out.dtype.element_ty))
+        else:
+            parts = tl.load(Partials + offs_c, mask=mask, other=-float('inf'))
+            res = tl.max(parts, 0)
+            if OP == 'max':
+                tl.store(Out + row, res.to(Out.dtype.element_ty))
+            else:
+                # chunks are ordered, so the first maximum has the smallest index
+                parts_idx = tl.load(PartialIdx + offs_c, mask=mask, other=N)
+                res_idx = tl.min(tl.where(parts == res, parts_idx, N), 0)
+                tl.store(Out + row, res_idx.to(Out.dtype.element_ty))
+        # ready for the next launch
+        tl.atomic_xchg(Counters + row, 0)
+
+
+class _reduce:
+
+    @staticmethod
+    def _call(x, op, num_chunks=None):
+        M, N = x.shape
+        device = x.device
+        BLOCK = min(triton.next_power_of_2(N), 1024)
+        # enough programs to fill the GPU a few times, but no chunk smaller than a block
+        if num_chunks is None:
+            num_sm = _triton.runtime.num_sm(_triton.runtime.backend.CUDA, device.index)
+            num_chunks = triton.cdiv(4 * num_sm, M)
+        num_chunks = max(1, min(num_chunks, triton.cdiv(N, BLOCK), 1024))
+        CHUNK = triton.cdiv(triton.cdiv(N, num_chunks), BLOCK) * BLOCK
+        num_chunks = triton.cdiv(N, CHUNK)
+        out = torch.empty(M, dtype=torch.int64 if op == 'argmax' else x.dtype, device=device)
+        # arrival counters are reset by the programs that finish each row
+        with triton.workspace.scope(device) as ws:
+            partials = ws.empty((M, num_chunks), torch.float32)
+            partial_idx = ws.empty((M, num_chunks), torch.int32) if op == 'argmax' else partials
+            counters = ws.semaphores(M)
+            _split_reduce[(M, num_chunks)](x, out, partials, partial_idx, counters, x.stride(0), N, CHUNK,
+                                           OP=op, BLOCK=BLOCK, NUM_CHUNKS=max(triton.next_power_of_2(num_chunks), 16),
+                                           num_warps=4 if BLOCK <= 512 else 8)
+        return out
+
+
+def reduce(x, op, dim=-1, num_chunks=None):
+    """
+    Reduces `x` along its last dimension, or entirely if `dim` is None, with `op` among
+    'sum', 'max' and 'argmax'. Long rows are split into `num_chunks` chunks (by default,
+    enough to fill the GPU) reduced by different programs, and the last program of
+    each row combines the partial results, in the order of the chunks.
+    """
+    if op not in OPS:
+        raise ValueError(f"unsupported reduction {op}")
+    if not x.dtype.is_floating_point:
+        raise ValueError("only floating-point tensors can be reduced")
+    if dim is None:
+        return _reduce._call(x.reshape(1, -1).contiguous(), op, num_chunks)[0]
+    if dim not in [-1, x.dim() - 1]:
+        raise ValueError("only the last dimension can be reduced")
+    N = x.shape[-1]
+    out = _reduce._call(x.reshape(-1, N).contiguous(), op, num_chunks)
+    return out.view(x.shape[:-1])
@@ -0,0 +1,163 @@
+import math
+import random
+
+import torch
+
+# ********************************************************
+# --------------------------------------------------------
+# Search strategies of the autotuner
+# A strategy is called with the candidate configs and a
+# `bench(config, rep)` function that returns the running
+# time of `config` in ms, measured over about `rep` ms, or
+# `inf` when it cannot run (e.g., out of resources). It
+# returns the timings it measured and the best config
+# --------------------------------------------------------
+# ********************************************************
+
+
+class Exhaustive:
+    """ benchmarks every config with the full budget """
+
+    def __init__(self, rep=100):
+        self.rep = rep
+
+    def __call__(self, configs, bench):
+        timings = {config: bench(config, self.rep) for config in configs}
+        return timings, min(timings, key=timings.get)
+
+
+class SuccessiveHalving:
+    """
+    Benchmarks every config with a budget of `min_rep` ms, keeps the fastest `1 / eta` of
+    them and benchmarks them again with `eta` times the budget, until `max_rep` ms or a
+    single config remain. Configs that cannot run are dropped after the first round.
+    """
+
+    def __init__(self, eta=3, min_rep=4, max_rep=100):
+        assert eta > 1
+        self.eta = eta
+        self.min_rep = min_rep
+        self.max_rep = max_rep
+
+    def __call__(self, configs, bench):
+        timings = dict()
+        candidates = list(configs)
+        rep = self.min_rep
+        while True:
+            rep = min(rep, self.max_rep)
+            timed = {config: bench(config, rep) for config in candidates}
+            timings.update(timed)
+            candidates = sorted((c for c in candidates if timed[c] < math.inf), key=timed.get)
+            if len(candidates) <= 1 or rep >= self.max_rep:
+                break
+            candidates = candidates[:max(1, len(candidates) // self.eta)]
+            rep *= self.eta
+        if not candidates:
+            return timings, configs[0]
+        return timings, candidates[0]
+
+
+def _features(configs):
+    # numeric meta-parameters on a log scale (block sizes and alike are powers of two),
+    # and the rank of other values among those the parameter takes
+    names = sorted(set(name for config in configs for name in config.kwargs))
+
+    def is_numeric(value):
+        return isinstance(value, (int, float)) and not isinstance(value, bool)
+    categories = {name: sorted(set(repr(c.kwargs.get(name)) for c in configs
+                                   if not is_numeric(c.kwargs.get(name)))) for name in names}
+    ret = []
+    for config in configs:
+        row = []
+        for name in names:
+            value = config.kwargs.get(name)
+            if is_numeric(value):
+                row.append(math.log2(value) if value > 0 else float(value))
+            else:
+                row.append(float(categories[name].index(repr(value))))
+        row.append(math.log2(config.num_warps))
+        row.append(float(config.num_stages))
+        ret.append(row)
+    return ret
+
+
+class ModelGuided:
+    """
+    Benchmarks `n_samples` configs: `n_init` random ones, then, one at a time, the config
+    with the largest expected improvement under a Gaussian process fitted to the logarithm
+    of the running times measured so far (on the log2 of the numeric meta-parameters,
+    warps and stages). The best of them is re-benchmarked with the full budget.
+    """
+
+    def __init__(self, n_samples=16, n_init=4, rep=25, max_rep=100, lengthscale=1., noise=1e-2, seed=0):
+        self.n_samples = n_samples
+        self.n_init = n_init
+        self.rep = rep
+        self.max_rep = max_rep
+        self.lengthscale = lengthscale
+        self.noise = noise
+        self.seed = seed
+
+    def _posterior(self, x, y, x_new):
+        # GP with a RBF kernel on standardized features and targets
+        def kernel(a, b):
+            return torch.exp(-0.5 * torch.cdist(a, b) ** 2 / self.lengthscale ** 2)
+        k = kernel(x, x) + self.noise * torch.eye(len(x), dtype=x.dtype)
+        k_new = kernel(x_new, x)
+        chol = torch.linalg.cholesky(k)
+        alpha = torch.cholesky_solve(y[:, None], chol)
+        mean = (k_new @ alpha)[:, 0]
+        v = torch.cholesky_solve(k_new.t(), chol)
+        var = (1. - (k_new * v.t()).sum(1)).clamp_min(1e-9)
+        return mean, var.sqrt()
+
+    def __call__(self, configs, bench):
+        configs = list(configs)
+        if len(configs) <= self.n_samples:
+            return Exhaustive(self.max_rep)(configs, bench)
+        rng = random.Random(self.seed)
+        features = torch.tensor(_features(configs), dtype=torch.float64)
+        std = features.std(0)
+        features = (features - features.mean(0)) / torch.where(std > 0, std, torch.ones_like(std))
+        timings = dict()
+        sampled = rng.sample(range(len(configs)), min(self.n_init, len(configs)))
+        for i in sampled:
+            timings[configs[i]] = bench(configs[i], self.rep)
+        while len(sampled) < self.n_samples:
+            valid = [i for i in sampled if timings[configs[i]] < math.inf]
+            remaining = [i for i in range(len(configs)) if i not in sampled]
+            if len(valid) < 2:
+                i = rng.choice(remaining)
+            else:
+                y = torch.tensor([math.log(timings[configs[i]]) for i in valid], dtype=torch.float64)
+                # configs that cannot run look slower than every other one
+                failed = [i for i in sampled if timings[configs[i]] == math.inf]
+                obs = valid + failed
+                y = torch.cat([y, torch.full((len(failed),), y.max().item() + 1., dtype=torch.float64)])
+                y_mean, y_std = y.mean(), y.std().clamp_min(1e-6)
+                mean, sigma = self._posterior(features[obs], (y - y_mean) / y_std, features[remaining])
+                best = ((y[:len(valid)].min() - y_mean) / y_std).item()
+                # expected improvement (of a minimization)
+                z = (best - mean) / sigma
+                normal = torch.distributions.Normal(torch.zeros((), dtype=torch.float64), torch.ones((), dtype=torch.float64))
+                ei = (best - mean) * normal.cdf(z) + sigma * torch.exp(normal.log_prob(z))
+                i = remaining[int(torch.argmax(ei))]
+            sampled.append(i)
+            timings[configs[i]] = bench(configs[i], self.rep)
+        best = min(timings, key=timings.get)
+        if timings[best] < math.inf and self.max_rep > self.rep:
+            timings[best] = bench(best, self.max_rep)
+        return timings, best
+
+
+def get(search):
+    """ strategy named by `search` ('exhaustive', 'halving' or 'model'), or `search` itself """
+    if search is None or search == 'exhaustive':
+        return Exhaustive()
+    if search == 'halving':
+        return SuccessiveHalving()
+    if search == 'model':
+        return ModelGuided()
+    if callable(search):
+        return search
+    raise ValueError(f"unknown autotuning search strategy {search}")
@@ -1,3 +1,4 @@
+import contextlib
 import os
 import subprocess
 import sys
@@ -105,7 +106,42 @@ def allclose(x, y, tol=1e-2):
     return err <= tol
 
 
+def gpu_state(device=None):
+    """
+    Returns the current SM and memory clocks (`sm_clock`, `mem_clock`, in MHz), their maxima
+    (`max_sm_clock`, `max_mem_clock`), the power draw (`power`, in W), the temperature
+    (`temperature`, in C) and the clock throttle reasons (`throttle_reasons`, a bitmask of
+    NVML's `nvmlClocksThrottleReason*`) of a CUDA device, as reported by NVML.
+    """
+    device = torch.cuda.current_device() if device is None else device
+    return _triton.runtime.gpu_state(_triton.runtime.backend.CUDA, device)
+
+
+@contextlib.contextmanager
+def set_gpu_clock(sm_clock, mem_clock, device=None):
+    """
+    Locks the SM and memory clocks (in MHz) of a CUDA device in its scope, and yields its
+    state. Locking clocks usually requires root privileges.
+    """
+    device = torch.cuda.current_device() if device is None else device
+    backend = _triton.runtime.backend.CUDA
+    _triton.runtime.lock_clocks(backend, device, sm_clock, mem_clock)
+    try:
+        yield gpu_state(device)
+    finally:
+        _triton.runtime.reset_clocks(backend, device)
+
+
+# nvidia-smi queries answered by NVML
+_NVSMI_ATTRS = {'clocks.current.sm': 'sm_clock', 'clocks.current.memory': 'mem_clock',
+                'clocks.max.sm': 'max_sm_clock', 'clocks.max.memory': 'max_mem_clock',
+                'power.draw': 'power', 'temperature.gpu': 'temperature'}
+
+
 def nvsmi(attrs):
+    if all(attr in _NVSMI_ATTRS for attr in attrs):
+        state = gpu_state(0)
+        return [int(state[_NVSMI_ATTRS[attr]]) for attr in attrs]
     attrs = ','.join(attrs)
     cmd = ['nvidia-smi', '-i', '0', '--query-gpu=' + attrs, '--format=csv,noheader,nounits']
     out = subprocess.check_output(cmd)
@@ -114,7 +150,28 @@ def nvsmi(attrs):
     return ret
 
 
-def do_bench(fn, warmup=25, rep=100, grad_to_none=None, percentiles=[0.5, 0.2, 0.8], record_clocks=False):
+class ClockDriftError(RuntimeError):
+    """
+    Raised by :code:`do_bench` when the clocks of the device moved during a benchmark
+    by more than :code:`max_clock_drift`
+    """
+
+    def __init__(self, clocks, max_clock_drift):
+        self.clocks = clocks
+        super().__init__(f"SM clock drifted from {clocks['before'].get('sm_clock')} to {clocks['after'].get('sm_clock')} MHz"
+                         f" during the benchmark (maximum drift: {max_clock_drift:.1%})")
+
+
+def _clock_drift(before, after):
+    drift = 0.
+    for key in ['sm_clock', 'mem_clock']:
+        if before.get(key) and key in after:
+            drift = max(drift, abs(after[key] - before[key]) / before[key])
+    return drift
+
+
+def do_bench(fn, warmup=25, rep=100, grad_to_none=None, percentiles=[0.5, 0.2, 0.8], record_clocks=False,
+             max_clock_drift=None):
     """
     Benchmark the runtime of the provided function. By default, return the median runtime of :code:`fn` along with
     the 20-th and 80-th performance percentile.
@@ -129,6 +186,12 @@ def do_bench(fn, warmup=25, rep=100, grad_to_none=None, percentiles=[0.5, 0.2, 0
     :type grad_to_none: torch.tensor, optional
     :param percentiles: Performance percentile to return in addition to the median.
     :type percentiles: list[float]
+    :param record_clocks: Also return the state of the device (see :code:`gpu_state`) at the start and at the
+        end of the benchmark, as a dict with keys :code:`before`, :code:`after` and :code:`drift`
+    :type record_clocks: bool
+    :param max_clock_drift: Raise :code:`ClockDriftError` if the SM or memory clock moved by more than this
+        fraction during the benchmark
+    :type max_clock_drift: float, optional
     """
 
     # Estimate the runtime of the function
@@ -154,6 +217,10 @@ def do_bench(fn, warmup=25, rep=100, grad_to_none=None, percentiles=[0.5, 0.2, 0
     # Warm-up
     for _ in range(n_warmup):
         fn()
+    # the device is busy with the warm-up, at the clocks of the benchmark
+    check_clocks = record_clocks or max_clock_drift is not None
+    if check_clocks:
+        before = gpu_state()
     # Benchmark
     for i in range(n_repeat):
         # we don't want `fn` to accumulate gradient values
@@ -169,13 +236,201 @@ def do_bench(fn, warmup=25, rep=100, grad_to_none=None, percentiles=[0.5, 0.2, 0
         fn()
         end_event[i].record()
     # Record clocks
+    # sampled while the device still runs the last repetitions
+    if check_clocks:
+        after = gpu_state()
+        clocks = {'before': before, 'after': after, 'drift': _clock_drift(before, after)}
+        if max_clock_drift is not None and clocks['drift'] > max_clock_drift:
+            raise ClockDriftError(clocks, max_clock_drift)
     torch.cuda.synchronize()
     times = torch.tensor([s.elapsed_time(e) for s, e in zip(start_event, end_event)])
     if percentiles:
-        percentiles = torch.quantile(times, torch.tensor(percentiles)).tolist()
-        return tuple(percentiles)
+        ret = tuple(torch.quantile(times, torch.tensor(percentiles)).tolist())
     else:
-        return torch.mean(times).item()
+        ret = torch.mean(times).item()
+    return (ret, clocks) if record_clocks else ret
+
+
+class KernelTiming:
+    """
+    Device times of the launches of one kernel, recorded by :code:`do_bench_cupti`.
+    :code:`binaries` holds the loaded binaries with the name of the kernel among those
+    of the JIT functions given to :code:`do_bench_cupti`, with their resources.
+    """
+
+    def __init__(self, name, times, launches_per_call, binaries):
+        self.name = name
+        self.times = times
+        self.launches_per_call = launches_per_call
+        self.binaries = binaries
+
+    def percentiles(self, percentiles=[0.5, 0.2, 0.8]):
+        return tuple(torch.quantile(self.times, torch.tensor(percentiles)).tolist())
+
+    def __repr__(self):
+        return f"KernelTiming({self.name}: {self.percentiles([0.5])[0]:.4f} ms x {self.launches_per_call:g})"
+
+
+def do_bench_cupti(fn, warmup=25, rep=100, grad_to_none=None, kernels=None):
+    """
+    Benchmark the kernels launched by :code:`fn` with the CUPTI activity API, through the
+    CUDA profiler of torch. Unlike :code:`do_bench`, each kernel is timed on its own, from
+    its start to its end on the device, without the overhead of events. Returns a dict
+    that maps the name of each kernel to its :code:`KernelTiming`.
+
+    :param fn: Function to benchmark
+    :type fn: Callable
+    :param warmup: Warmup time (in ms)
+    :type warmup: int
+    :param rep: Repetition time (in ms)
+    :type rep: int
+    :param grad_to_none: Reset the gradient of the provided tensor to None
+    :type grad_to_none: torch.tensor, optional
+    :param kernels: JIT functions among which the kernels are looked up; if given, other
+                    kernels are not reported
+    :type kernels: list[triton.JITFunction], optional
+    """
+    from torch.autograd import DeviceType
+    from torch.profiler import ProfilerActivity, profile
+
+    def device_events(prof):
+        return [e for e in prof.events() if e.device_type == DeviceType.CUDA]
+    # number of calls, as in `do_bench`
+    estimate_ms = do_bench(lambda: fn(), warmup=0, rep=0, percentiles=None)
+    n_warmup = max(1, int(warmup / estimate_ms))
+    n_repeat = max(1, int(rep / estimate_ms))
+    cache = torch.empty(int(256e6), dtype=torch.int8, device='cuda')
+    # kernels that flush the L2 cache are not reported
+    with profile(activities=[ProfilerActivity.CUDA]) as prof:
+        cache.zero_()
+        torch.cuda.synchronize()
+    ignored = set(e.name for e in device_events(prof))
+    for _ in range(n_warmup):
+        fn()
+    with profile(activities=[ProfilerActivity.CUDA]) as prof:
+        for _ in range(n_repeat):
+            if grad_to_none is not None:
+                for x in grad_to_none:
+                    x.grad = None
+            cache.zero_()
+            fn()
+        torch.cuda.synchronize()
+    times = dict()
+    for e in device_events(prof):
+        if e.name not in ignored:
+            times.setdefault(e.name, []).append(e.time_range.elapsed_us() * 1e-3)
+    # binaries of the given kernels, by name
+    binaries = dict()
+    for kernel in kernels or []:
+        for binary in kernel.bin_cache.values():
+            binaries.setdefault(binary.bin.name, []).append(binary)
+    return {name: KernelTiming(name, torch.tensor(ts), len(ts) / n_repeat, binaries.get(name, []))
+            for name, ts in times.items() if kernels is None or name in binaries}
+
+
+def program_timeline(tracer, grid=None):
+    """
+    Returns the programs of the kernels traced by :code:`tracer` (a
+    :code:`triton.tools.trace.Tracer`, preferably of level 3) as dicts, in the order they
+    started. Each has the name of its kernel, the index of its launch among those of the
+    kernel, its linear index in the grid and, if :code:`grid` is given, its coordinates in it,
+    the SM it ran on, and the :code:`%globaltimer` (in ns) of the entry of its first warp and
+    of the exit of its last one. Program indices are those of the launch, which differ from
+    :code:`tl.program_id` for persistent kernels and kernels with a raster order.
+
+    :param grid: grid of the launches, to compute the coordinates of the programs
+    :type grid: tuple[int], optional
+    """
+    # the k-th entry and exit of a warp are those of the k-th launch of its kernel
+    entries, exits = dict(), dict()
+    for ts, name, cta, sm, warp, event in tracer.records():
+        if event == 0:
+            entries.setdefault((name, cta, warp), []).append((ts, sm))
+        elif event == 1:
+            exits.setdefault((name, cta, warp), []).append(ts)
+    programs = dict()
+    for (name, cta, warp), starts in entries.items():
+        ends = exits.get((name, cta, warp), [])
+        for launch, ((start, sm), end) in enumerate(zip(starts, ends)):
+            program = programs.setdefault((name, launch, cta), dict(kernel=name, launch=launch, pid=cta, sm=sm,
+                                                                   start=start, end=end))
+            program['start'] = min(program['start'], start)
+            program['end'] = max(program['end'], end)
+    ret = sorted(programs.values(), key=lambda p: p['start'])
+    if grid is not None:
+        grid = tuple(grid) + (1,) * (3 - len(grid))
+        for p in ret:
+            p['coords'] = (p['pid'] % grid[0], p['pid'] // grid[0] % grid[1], p['pid'] // (grid[0] * grid[1]))
+    return ret
+
+
+def sm_utilization(programs, num_sms=None):
+    """
+    Statistics of the load balance of :code:`programs` (see :code:`program_timeline`) across
+    SMs, from the start of the first program to the end of the last one (the span). For each
+    SM: its number of programs, the time during which it ran at least one (busy), the sum of
+    the durations of its programs (work), and its utilization (busy / span). Overall: the
+    mean utilization over :code:`num_sms` SMs (by default, those that ran a program), the
+    imbalance (the most work of an SM over the mean), the durations of programs (min, mean,
+    max), and the tail (the time the last SM kept running after the first one was done).
+    """
+    if not programs:
+        return None
+    t0 = min(p['start'] for p in programs)
+    span = max(p['end'] for p in programs) - t0
+    sms = dict()
+    for p in sorted(programs, key=lambda p: p['start']):
+        sm = sms.setdefault(p['sm'], dict(programs=0, busy=0, work=0, first=p['start'], last=p['end'], _until=t0))
+        sm['programs'] += 1
+        sm['work'] += p['end'] - p['start']
+        # union of the intervals of the programs of the SM
+        sm['busy'] += max(0, p['end'] - max(p['start'], sm['_until']))
+        sm['_until'] = max(sm['_until'], p['end'])
+        sm['last'] = max(sm['last'], p['end'])
+    for sm in sms.values():
+        del sm['_until']
+        sm['utilization'] = sm['busy'] / span if span else 1.
+    num_sms = num_sms or len(sms)
+    work = [sm['work'] for sm in sms.values()] + [0] * max(0, num_sms - len(sms))
+    durations = [p['end'] - p['start'] for p in programs]
+    lasts = [sm['last'] for sm in sms.values()]
+    return dict(span=span, sms=sms,
+                utilization=sum(sm['utilization'] for sm in sms.values()) / num_sms,
+                imbalance=max(work) / (sum(work) / len(work)) if sum(work) else 1.,
+                durations=(min(durations), sum(durations) / len(durations), max(durations)),
+                tail=max(lasts) - min(lasts))
+
+
+def plot_sm_timeline(programs, path=None):
+    """
+    Draws the occupancy of the SMs by :code:`programs` (see :code:`program_timeline`): a row
+    per SM, with a lane per program resident at the same time and a bar per program.
+    Saves the figure to :code:`path` if given, and returns it.
+    """
+    import matplotlib.pyplot as plt
+    t0 = min(p['start'] for p in programs)
+    sms = sorted(set(p['sm'] for p in programs))
+    # programs of an SM go to the first lane that is free when they start
+    lanes = {sm: [] for sm in sms}
+    bars = {sm: [] for sm in sms}
+    for p in sorted(programs, key=lambda p: p['start']):
+        ends = lanes[p['sm']]
+        lane = next((i for i, end in enumerate(ends) if end <= p['start']), len(ends))
+        if lane == len(ends):
+            ends.append(0)
+        ends[lane] = p['end']
+        bars[p['sm']].append((lane, (p['start'] - t0) * 1e-3, (p['end'] - p['start']) * 1e-3))
+    depth = max(1, max(len(lanes[sm]) for sm in sms))
+    fig, ax = plt.subplots(figsize=(12, max(2, 0.25 * len(sms))))
+    for row, sm in enumerate(sms):
+        for lane, start, duration in bars[sm]:
+            ax.broken_barh([(start, duration)], (row + lane / depth, 1 / depth), edgecolor='white', linewidth=0.2)
+    ax.set_yticks([row + 0.5 for row in range(len(sms))])
+    ax.set_yticklabels([f'SM {sm}' for sm in sms])
+    ax.set_xlabel('time (us)')
+    if path:
+        fig.savefig(path)
+    return fig
 
 
 class Benchmark:
@@ -383,3 +638,40 @@ def get_max_simd_tflops(dtype: torch.dtype, backend=None, device=None):
             raise RuntimeError("dtype not supported")
     tflops = num_subcores * clock_rate * ops_per_sub_core * 1e-9
     return tflops
+
+
+def get_arch(backend=None, device=None):
+    ''' return the architecture of the device, e.g. `sm80`, which keys per-device reference numbers '''
+    if not backend:
+        backend = _triton.runtime.backend.CUDA
+    if not device:
+        device = torch.cuda.current_device()
+    return f"sm{_triton.runtime.cc(backend, device)}"
+
+
+def roofline(ms, flops=0, nbytes=0, dtype=torch.float16, tensor_cores=True, backend=None, device=None):
+    """
+    Places a runtime of :code:`ms` milliseconds for :code:`flops` operations on
+    :code:`nbytes` bytes of DRAM traffic on the roofline of the device. Returns a dict of
+    the achieved :code:`tflops` and :code:`gbps`, their fractions :code:`tflops_frac` of
+    the peak of the tensor cores (or of the SIMD units when :code:`tensor_cores` is False
+    or the tensor cores don't support :code:`dtype`) and :code:`gbps_frac` of the DRAM
+    bandwidth, and :code:`roofline_frac`, the fraction of the speed of light: the time the
+    bound resource needs at its peak over :code:`ms`.
+    """
+    max_tflops = None
+    if tensor_cores:
+        try:
+            max_tflops = get_max_tensorcore_tflops(dtype, backend, device)
+        except (AssertionError, RuntimeError):
+            pass
+    if max_tflops is None and dtype in [torch.float16, torch.bfloat16, torch.float32]:
+        max_tflops = get_max_simd_tflops(dtype, backend, device)
+    max_gbps = get_dram_gbps(backend, device)
+    tflops = flops / ms * 1e-9
+    gbps = nbytes / ms * 1e-6
+    tflops_frac = tflops / max_tflops if max_tflops else 0.
+    gbps_frac = gbps / max_gbps
+    return {'ms': ms, 'tflops': tflops, 'gbps': gbps,
+            'tflops_frac': tflops_frac, 'gbps_frac': gbps_frac,
+            'roofline_frac': max(tflops_frac, gbps_frac)}
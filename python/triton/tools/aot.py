@@ -0,0 +1,371 @@
+"""
+Ahead-of-time compilation of Triton kernels into C sources that embed their
+binaries (cubins, or hsaco code objects on ROCm), with typed launch functions
+that need neither Python nor the Triton runtime::
+
+    python -m triton.tools.aot kernels.py:add_kernel -n add -o out/ \\
+        -s "*f32:16, *f32:16, *f32:16, i32:16, 1024" \\
+        -s "*f32, *f32, *f32, i32, 1024"
+
+Each signature lists the arguments of the kernel, in order:
+
+* `*<dtype>` for a tensor (e.g., `*f16`, `*bf16`, `*f32`, `*i32`),
+* `i32`, `u32`, `i64`, `u64` or `fp32` for a scalar,
+* a literal (e.g., `1024`, `1`, `0.5`, `True`) for a compile-time constant, which
+  constexpr arguments must be.
+
+Tensors and integers may carry a `:N` suffix (N is 2, 4, 8 or 16) that lets the
+compiler assume, as the JIT does when it specializes, that integers are multiples
+of N and that the address and allocation size of tensors are multiples of N bytes.
+
+This generates `add.h` and `add.c`, declaring, for the i-th signature::
+
+    CUresult add_<i>(CUstream stream, unsigned int grid_0, unsigned int grid_1,
+                     unsigned int grid_2, <arguments that are not constants>);
+
+which packs its arguments exactly as `triton.code_gen.Kernel` does. When all the
+signatures have the same non-constant arguments (i.e., they only differ in their
+assumptions), `add(...)` launches the first of them, in the order given, whose
+assumptions hold. `add_load()` loads the binaries in the current context, and
+must be called before any launch; `add_unload()` unloads them.
+"""
+
+import argparse
+import importlib.util
+import os
+import sys
+
+import triton
+import triton._C.libtriton.triton as _triton
+
+# scalar types: (type code of the JIT, C type, size and alignment in the packed parameters)
+_SCALARS = {
+    'i32': ('i32', 'int32_t', 4),
+    'u32': ('u32', 'uint32_t', 4),
+    'i64': ('i64', 'int64_t', 8),
+    'u64': ('u64', 'uint64_t', 8),
+    'fp32': ('f', 'float', 4),
+}
+_DTYPES = {'fp16': 'f16', 'bf16': 'bf16', 'fp32': 'f32', 'fp64': 'f64', 'fp8': 'f8'}
+_DIVISIBILITIES = [1, 2, 4, 8, 16]
+
+
+class Arg:
+    def __init__(self, name, kind, type=None, divisibility=1, value=None):
+        # kind is 'ptr', 'scalar' or 'constant'
+        self.name = name
+        self.kind = kind
+        self.type = type
+        self.divisibility = divisibility
+        self.value = value
+
+
+def _literal(text):
+    if text in ('True', 'False'):
+        return text == 'True'
+    try:
+        return int(text, 0)
+    except ValueError:
+        return float(text)
+
+
+def parse_signature(fn, signature):
+    """ parses the signature of `fn` (see the documentation of this module) into `Arg`s """
+    parts = [part.strip() for part in signature.split(',')]
+    if len(parts) != len(fn.arg_names):
+        raise ValueError(f"{fn.__name__} takes {len(fn.arg_names)} arguments but signature '{signature}' has {len(parts)}")
+    ret = []
+    for i, (name, part) in enumerate(zip(fn.arg_names, parts)):
+        type, _, div = part.partition(':')
+        divisibility = int(div) if div else 1
+        if divisibility not in _DIVISIBILITIES:
+            raise ValueError(f"divisibility of {name} must be one of {_DIVISIBILITIES}")
+        if type.startswith('*'):
+            dtype = _DTYPES.get(type[1:], type[1:])
+            ret.append(Arg(name, 'ptr', dtype, divisibility))
+        elif type in _SCALARS:
+            ret.append(Arg(name, 'scalar', type, divisibility))
+        else:
+            try:
+                value = _literal(type)
+            except ValueError:
+                raise ValueError(f"invalid type '{part}' for argument {name}") from None
+            ret.append(Arg(name, 'constant', value=value))
+        if i in fn.constexprs and ret[-1].kind != 'constant':
+            raise ValueError(f"constexpr argument {name} must be given a value")
+    return ret
+
+
+def _pack(args):
+    # offsets of the non-constant arguments in the parameter buffer, and its size,
+    # laid out as `parse_args` in triton.cc does
+    offsets = []
+    offset = 0
+    for arg in args:
+        if arg.kind == 'constant':
+            continue
+        size = 8 if arg.kind == 'ptr' else _SCALARS[arg.type][2]
+        offset = (offset + size - 1) // size * size
+        offsets.append(offset)
+        offset += size
+    return offsets, offset
+
+
+class Variant:
+    """ a compiled signature of a kernel """
+
+    def __init__(self, fn, signature, num_warps=4, num_stages=2, device=0):
+        self.fn = fn
+        self.signature = signature
+        self.args = parse_signature(fn, signature)
+        self.num_warps = num_warps
+        self.num_stages = num_stages
+        # same specialization as `Kernel.add_to_cache`
+        attributes = {i: arg.divisibility for i, arg in enumerate(self.args) if arg.kind != 'constant'}
+        constants = {i: arg.value for i, arg in enumerate(self.args) if arg.kind == 'constant'}
+        arg_types = [(arg.kind, _SCALARS[arg.type][0] if arg.kind == 'scalar' else arg.type)
+                     for arg in self.args if arg.kind != 'constant']
+        self.binary = fn._compile(arg_types, device, attributes, constants, num_warps, num_stages)
+        self.offsets, self.params_size = _pack(self.args)
+
+    @property
+    def params(self):
+        return [arg for arg in self.args if arg.kind != 'constant']
+
+    def image(self):
+        # what the driver loads: the cubin, or the (null-terminated) PTX when there is none
+        asm = self.binary.asm
+        if 'hsaco' in asm:
+            return bytes(asm['hsaco'])
+        if 'cubin' in asm:
+            return bytes(asm['cubin'])
+        return asm['ptx'].encode('utf-8') + b'\0'
+
+    def conditions(self):
+        # assumptions made on the arguments, as C expressions
+        ret = []
+        for arg in self.params:
+            if arg.divisibility == 1:
+                continue
+            if arg.kind == 'ptr':
+                ret.append(f'_triton_pointer_divisible({arg.name}, {arg.divisibility})')
+            else:
+                ret.append(f'({arg.name} % {arg.divisibility} == 0)')
+        return ret
+
+
+def _c_params(variant, rocm):
+    ptr = 'hipDeviceptr_t' if rocm else 'CUdeviceptr'
+    return ', '.join(f'{ptr if arg.kind == "ptr" else _SCALARS[arg.type][1]} {arg.name}' for arg in variant.params)
+
+
+def _prototype(name, variant, rocm):
+    stream, result = ('hipStream_t', 'hipError_t') if rocm else ('CUstream', 'CUresult')
+    params = _c_params(variant, rocm)
+    return f'{result} {name}({stream} stream, unsigned int grid_0, unsigned int grid_1, unsigned int grid_2' + \
+           (f', {params})' if params else ')')
+
+
+def _bytes(data, indent='  '):
+    data = bytes(data)
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append(indent + ' '.join(f'0x{b:02x},' for b in data[i:i + 16]))
+    return '\n'.join(lines)
+
+
+def generate(name, variants):
+    """ returns the header and the source of the launch functions of `variants` """
+    rocm = variants[0].binary.backend == _triton.runtime.backend.ROCM
+    api = dict(
+        include='#include <hip/hip_runtime_api.h>' if rocm else '#include <cuda.h>',
+        result='hipError_t' if rocm else 'CUresult',
+        success='hipSuccess' if rocm else 'CUDA_SUCCESS',
+        module='hipModule_t' if rocm else 'CUmodule',
+        function='hipFunction_t' if rocm else 'CUfunction',
+        ptr='hipDeviceptr_t' if rocm else 'CUdeviceptr',
+    )
+    same_params = all([(a.kind, a.type, a.name) for a in v.params] ==
+                      [(a.kind, a.type, a.name) for a in variants[0].params] for v in variants)
+
+    # header
+    h = [f'/* {name}: launch functions of {variants[0].fn.__name__}, generated by triton.tools.aot */',
+         '#pragma once',
+         '',
+         api['include'],
+         '#include <stdint.h>',
+         '',
+         '#ifdef __cplusplus',
+         'extern "C" {',
+         '#endif',
+         '',
+         '/* loads the kernels in the current context */',
+         f'{api["result"]} {name}_load(void);',
+         f'{api["result"]} {name}_unload(void);',
+         '']
+    for i, v in enumerate(variants):
+        h.append(f'/* {v.signature}; num_warps={v.num_warps}, num_stages={v.num_stages} */')
+        h.append(_prototype(f'{name}_{i}', v, rocm) + ';')
+    if same_params:
+        h += ['',
+              '/* launches the first of the signatures above whose assumptions hold */',
+              _prototype(name, variants[0], rocm) + ';']
+    h += ['',
+          '#ifdef __cplusplus',
+          '}',
+          '#endif',
+          '']
+
+    # source
+    c = ['/* generated by triton.tools.aot: do not edit */',
+         f'#include "{name}.h"',
+         '',
+         '#include <string.h>',
+         '']
+    for i, v in enumerate(variants):
+        c += [f'static const unsigned char {name}_{i}_image[] = {{',
+              _bytes(v.image()),
+              '};']
+    c += ['',
+          f'static {api["module"]} {name}_modules[{len(variants)}];',
+          f'static {api["function"]} {name}_functions[{len(variants)}];',
+          '',
+          f'{api["result"]} {name}_load(void) {{',
+          f'  {api["result"]} err;']
+    for i, v in enumerate(variants):
+        if rocm:
+            c += [f'  if ((err = hipModuleLoadData(&{name}_modules[{i}], {name}_{i}_image)) != hipSuccess) return err;',
+                  f'  if ((err = hipModuleGetFunction(&{name}_functions[{i}], {name}_modules[{i}], "{v.binary.name}")) != hipSuccess) return err;']
+        else:
+            c += [f'  if ((err = cuModuleLoadData(&{name}_modules[{i}], {name}_{i}_image)) != CUDA_SUCCESS) return err;',
+                  f'  if ((err = cuModuleGetFunction(&{name}_functions[{i}], {name}_modules[{i}], "{v.binary.name}")) != CUDA_SUCCESS) return err;']
+            # same as `cu_get_function`: the L1/shared memory split chosen by the compiler,
+            # and the opt-in of kernels that use more than 48KB of shared memory
+            if v.binary.carveout >= 0:
+                c += [f'  cuFuncSetAttribute({name}_functions[{i}], CU_FUNC_ATTRIBUTE_PREFERRED_SHARED_MEMORY_CARVEOUT, {v.binary.carveout});']
+            if v.binary.shared_mem > 49152:
+                c += ['  {',
+                      '    CUdevice dev;',
+                      '    int shared_optin, shared_static;',
+                      '    if ((err = cuCtxGetDevice(&dev)) != CUDA_SUCCESS) return err;',
+                      '    cuDeviceGetAttribute(&shared_optin, CU_DEVICE_ATTRIBUTE_MAX_SHARED_MEMORY_PER_BLOCK_OPTIN, dev);']
+                if v.binary.carveout < 0:
+                    c += [f'    cuFuncSetCacheConfig({name}_functions[{i}], CU_FUNC_CACHE_PREFER_SHARED);']
+                c += [f'    cuFuncGetAttribute(&shared_static, CU_FUNC_ATTRIBUTE_SHARED_SIZE_BYTES, {name}_functions[{i}]);',
+                      f'    cuFuncSetAttribute({name}_functions[{i}], CU_FUNC_ATTRIBUTE_MAX_DYNAMIC_SHARED_SIZE_BYTES, shared_optin - shared_static);',
+                      '  }']
+    c += [f'  return {api["success"]};',
+          '}',
+          '',
+          f'{api["result"]} {name}_unload(void) {{',
+          f'  {api["result"]} err;',
+          f'  for (int i = 0; i < {len(variants)}; i++) {{',
+          f'    if (!{name}_modules[i]) continue;',
+          f'    if ((err = {"hipModuleUnload" if rocm else "cuModuleUnload"}({name}_modules[i])) != {api["success"]}) return err;',
+          f'    {name}_modules[i] = 0;',
+          '  }',
+          f'  return {api["success"]};',
+          '}',
+          '']
+    if same_params and any(v.conditions() for v in variants):
+        # tensors are specialized like in `Kernel`: on the divisibility of their
+        # address and of the size of their allocation
+        get_range = 'hipMemGetAddressRange' if rocm else 'cuMemGetAddressRange'
+        c += [f'static int _triton_pointer_divisible({api["ptr"]} ptr, uint64_t n) {{',
+              f'  {api["ptr"]} base;',
+              '  size_t size = 0;',
+              f'  {get_range}(&base, &size, ptr);',
+              '  return (uint64_t)ptr % n == 0 && size % n == 0;',
+              '}',
+              '']
+    for i, v in enumerate(variants):
+        c += [_prototype(f'{name}_{i}', v, rocm) + ' {',
+              f'  char params[{max(v.params_size, 1)}] __attribute__((aligned(8)));',
+              f'  size_t params_size = {v.params_size};']
+        for arg, offset in zip(v.params, v.offsets):
+            c.append(f'  memcpy(params + {offset}, &{arg.name}, sizeof({arg.name}));')
+        if rocm:
+            c += ['  void* config[] = {HIP_LAUNCH_PARAM_BUFFER_POINTER, params, HIP_LAUNCH_PARAM_BUFFER_SIZE, &params_size, HIP_LAUNCH_PARAM_END};',
+                  '  if (grid_0 * grid_1 * grid_2 == 0) return hipSuccess;',
+                  f'  return hipModuleLaunchKernel({name}_functions[{i}], grid_0, grid_1, grid_2, {v.binary.num_threads}, 1, 1, '
+                  f'{v.binary.shared_mem}, stream, NULL, config);']
+        else:
+            c += ['  void* config[] = {CU_LAUNCH_PARAM_BUFFER_POINTER, params, CU_LAUNCH_PARAM_BUFFER_SIZE, &params_size, CU_LAUNCH_PARAM_END};',
+                  '  if (grid_0 * grid_1 * grid_2 == 0) return CUDA_SUCCESS;',
+                  f'  return cuLaunchKernel({name}_functions[{i}], grid_0, grid_1, grid_2, {v.binary.num_threads}, 1, 1, '
+                  f'{v.binary.shared_mem}, stream, NULL, config);']
+        c += ['}', '']
+    if same_params:
+        args = ', '.join(['stream', 'grid_0', 'grid_1', 'grid_2'] + [arg.name for arg in variants[0].params])
+        c.append(_prototype(name, variants[0], rocm) + ' {')
+        for i, v in enumerate(variants):
+            conditions = v.conditions()
+            if not conditions:
+                c.append(f'  return {name}_{i}({args});')
+                break
+            c.append(f'  if ({" && ".join(conditions)})')
+            c.append(f'    return {name}_{i}({args});')
+        else:
+            c.append(f'  return {"hipErrorInvalidValue" if rocm else "CUDA_ERROR_INVALID_VALUE"};')
+        c += ['}', '']
+    return '\n'.join(h), '\n'.join(c)
+
+
+def compile(fn, signatures, name, out_dir, device=0):
+    """
+    Compiles `fn` for each of `signatures`, and writes `name`.h and `name`.c in `out_dir`.
+
+    :param fn: the kernel
+    :type fn: triton.code_gen.JITFunction
+    :param signatures: signatures of the kernel (see the documentation of this module),
+        or (signature, num_warps, num_stages) tuples
+    :param device: the device whose architecture the kernels are compiled for
+    :return: the paths of the header and of the source
+    """
+    if fn.persistent:
+        raise ValueError("persistent kernels cannot be compiled ahead of time")
+    signatures = [(s, 4, 2) if isinstance(s, str) else s for s in signatures]
+    variants = [Variant(fn, s, num_warps, num_stages, device) for s, num_warps, num_stages in signatures]
+    if variants[0].binary.backend not in (_triton.runtime.backend.CUDA, _triton.runtime.backend.ROCM):
+        raise ValueError("only CUDA and ROCm kernels can be compiled ahead of time")
+    header, source = generate(name, variants)
+    os.makedirs(out_dir, exist_ok=True)
+    paths = os.path.join(out_dir, f'{name}.h'), os.path.join(out_dir, f'{name}.c')
+    for path, text in zip(paths, [header, source]):
+        with open(path, 'w') as f:
+            f.write(text)
+    return paths
+
+
+def _load_kernel(path):
+    # `file.py:kernel`
+    file, _, kernel = path.rpartition(':')
+    spec = importlib.util.spec_from_file_location(os.path.splitext(os.path.basename(file))[0], file)
+    module = importlib.util.module_from_spec(spec)
+    sys.modules[spec.name] = module
+    spec.loader.exec_module(module)
+    fn = getattr(module, kernel)
+    if not isinstance(fn, triton.code_gen.JITFunction):
+        raise ValueError(f"{kernel} is not a @triton.jit function")
+    return fn
+
+
+def main(args=None):
+    parser = argparse.ArgumentParser(description="compiles a Triton kernel into C launch functions")
+    parser.add_argument('kernel', help="file and name of the kernel, as path/to/file.py:kernel")
+    parser.add_argument('-s', '--signature', action='append', required=True,
+                        help="signature to compile (may be repeated)")
+    parser.add_argument('-w', '--num-warps', type=int, default=4)
+    parser.add_argument('--num-stages', type=int, default=2)
+    parser.add_argument('-n', '--name', help="prefix of the generated functions and files (default: the kernel name)")
+    parser.add_argument('-o', '--out-dir', default='.')
+    parser.add_argument('-d', '--device', type=int, default=0)
+    args = parser.parse_args(args)
+    fn = _load_kernel(args.kernel)
+    signatures = [(s, args.num_warps, args.num_stages) for s in args.signature]
+    for path in compile(fn, signatures, args.name or fn.__name__, args.out_dir, args.device):
+        print(path)
+
+
+if __name__ == '__main__':
+    main()
@@ -20,6 +20,7 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+import os
 import re
 import subprocess
 
@@ -27,6 +28,10 @@ FLINE_RE = re.compile(r'\s*/\*\w{4}\*/\s*([^;]*;)\s*/\* 0x(\w{16}) \*/\s*')
 SLINE_RE = re.compile(r'\s*/\* 0x(\w{16}) \*/\s*')
 FNAME_RE = re.compile(r'\s*Function : (\w+)\s*')
 BRA_RE = re.compile(r'(.*BRA(?:\.U)? )(0x\w+);')
+# line table, as printed by nvdisasm -g
+SECTION_RE = re.compile(r'\s*\.text\.(\w+):')
+LOC_RE = re.compile(r'\s*//## File "([^"]+)", line (\d+)')
+OFFSET_RE = re.compile(r'\s*/\*([0-9a-f]{4,})\*/')
 
 
 def parseCtrl(sline):
@@ -60,7 +65,26 @@ def processSassLines(fline, sline, labels):
     return (f'{ctrl}', f'{asm}')
 
 
-def extract(file_path, fun):
+def source_lines(file_path):
+    '''
+    Returns the source location (file, line) of the instructions of each function
+    of a cubin compiled with line information, indexed by (function, offset)
+    '''
+    out = subprocess.check_output(["nvdisasm", "-g", "-c", file_path]).decode()
+    ret = dict()
+    fname, loc = None, None
+    for line in out.splitlines():
+        if SECTION_RE.match(line):
+            fname, loc = SECTION_RE.match(line).group(1), None
+        elif LOC_RE.match(line):
+            m = LOC_RE.match(line)
+            loc = (m.group(1), int(m.group(2)))
+        elif OFFSET_RE.match(line) and loc is not None:
+            ret[(fname, int(OFFSET_RE.match(line).group(1), 16))] = loc
+    return ret
+
+
+def extract(file_path, fun, lineinfo=False):
     if fun is None:
         sass_str = subprocess.check_output(["cuobjdump", "-sass", file_path])
     else:
@@ -105,12 +129,19 @@ def extract(file_path, fun):
             line = sass_lines[line_idx].decode()
         # Print sass
         # label naming convension: LBB#i
+        lines = source_lines(file_path) if lineinfo else dict()
+        prev_loc = None
         for idx, (ctrl, asm) in enumerate(asm_buffer):
             # Print label if this is BRA target
             offset = idx * 16
             if offset in labels:
                 label_name = f'LBB{labels[offset]}'
                 ret += f'{label_name}:\n'
+            # Print the source line of the instructions that follow
+            loc = lines.get((fname, offset))
+            if loc is not None and loc != prev_loc:
+                ret += f'// {os.path.basename(loc[0])}:{loc[1]}\n'
+                prev_loc = loc
             ret += ctrl + '\t'
             # if this is BRA, remap offset to label
             if BRA_RE.match(asm):
@@ -0,0 +1,124 @@
+import json
+import os
+import struct
+
+import torch
+
+import triton._C.libtriton.triton as _triton
+from triton.code_gen import LoadedBinary
+
+# header of the ring buffer, then records, in 32-bit words
+HEADER_WORDS = 4
+RECORD_WORDS = 8
+
+
+class Tracer:
+    """
+    Records a timeline of the warps of the kernels launched in its scope, for
+    chrome://tracing or Perfetto. Kernels compiled in the scope are instrumented
+    (with TRITON_TRACE) so that lane 0 of each warp writes timestamps at the entry
+    and exit of the kernel, at each loop header and, with level=2, before each
+    barrier, into a ring buffer of `capacity` records. With level=3, only entries
+    and exits are recorded, which perturbs the kernel least (see
+    `triton.testing.program_timeline`)::
+
+        with Tracer() as tracer:
+            kernel[grid](...)
+        tracer.save('trace.json')
+
+    Kernels that were instrumented in the scope of a previous tracer record into
+    the buffer of the current one; they are not instrumented outside of a scope.
+    """
+
+    def __init__(self, capacity=1 << 20, level=1):
+        assert level in [1, 2, 3], "tracing levels are 1 (entry, exit and loops), 2 (barriers too) " \
+                                   "and 3 (entry and exit only)"
+        self.capacity = capacity
+        self.level = level
+        self.binaries = []
+        self.buffer = None
+
+    def _attach(self, binary, addr):
+        tag = len(self.binaries) if addr else 0
+        _triton.code_gen.set_global(binary.bin.backend, binary.module, '__triton_trace_buffer', struct.pack('<Q', addr))
+        _triton.code_gen.set_global(binary.bin.backend, binary.module, '__triton_trace_tag', struct.pack('<I', tag))
+        if addr:
+            self.binaries.append(binary)
+
+    def __enter__(self):
+        self.buffer = torch.zeros(HEADER_WORDS + RECORD_WORDS * self.capacity, dtype=torch.int32, device='cuda')
+        self.buffer[1] = self.capacity
+        torch.cuda.synchronize()
+        self.prev_env = os.environ.get('TRITON_TRACE')
+        os.environ['TRITON_TRACE'] = str(self.level)
+        for binary in LoadedBinary.traced:
+            self._attach(binary, self.buffer.data_ptr())
+        LoadedBinary.trace_hook = lambda binary: self._attach(binary, self.buffer.data_ptr())
+        return self
+
+    def __exit__(self, *args):
+        # the buffer must not be written once it is released
+        torch.cuda.synchronize()
+        LoadedBinary.trace_hook = None
+        for binary in self.binaries:
+            self._attach(binary, 0)
+        if self.prev_env is None:
+            del os.environ['TRITON_TRACE']
+        else:
+            os.environ['TRITON_TRACE'] = self.prev_env
+
+    def records(self):
+        """
+        Returns the records as (timestamp in ns, kernel name, cta, sm, warp, event) tuples,
+        in the order of their timestamps. Events are 0 for the entry of a kernel, 1 for its
+        exit, 2 + k for the header of its k-th loop and 0x1000 + k for its k-th barrier.
+        Only the last `capacity` records are kept.
+        """
+        words = self.buffer.cpu()
+        count = min(int(words[0]) & 0xffffffff, self.capacity)
+        recs = words[HEADER_WORDS:].view(-1, RECORD_WORDS)[:count].tolist()
+        ret = []
+        for w in recs:
+            ts = (w[0] & 0xffffffff) | ((w[1] & 0xffffffff) << 32)
+            name = self.binaries[w[6]].bin.name if w[6] < len(self.binaries) else '?'
+            ret.append((ts, name, w[2], w[3], w[4], w[5]))
+        return sorted(ret)
+
+    def dropped(self):
+        """ number of records overwritten in the ring buffer """
+        return max(0, (int(self.buffer[0].item()) & 0xffffffff) - self.capacity)
+
+    def events(self):
+        """
+        Returns the records as Chrome trace events: one process per SM and one thread
+        per warp of a CTA, with a span per kernel and instant events for loop iterations
+        and barriers
+        """
+        records = self.records()
+        if not records:
+            return []
+        t0 = records[0][0]
+        events = []
+        threads = set()
+        for ts, name, cta, sm, warp, event in records:
+            tid = cta * 64 + warp
+            if (sm, tid) not in threads:
+                threads.add((sm, tid))
+                events.append({'ph': 'M', 'name': 'thread_name', 'pid': sm, 'tid': tid,
+                               'args': {'name': f'cta {cta} warp {warp}'}})
+                events.append({'ph': 'M', 'name': 'process_name', 'pid': sm, 'args': {'name': f'SM {sm}'}})
+            e = {'pid': sm, 'tid': tid, 'ts': (ts - t0) * 1e-3, 'name': name}
+            if event == 0:
+                e['ph'] = 'B'
+            elif event == 1:
+                e['ph'] = 'E'
+            else:
+                e['ph'] = 'i'
+                e['s'] = 't'
+                e['name'] = f'loop {event - 2}' if event < 0x1000 else f'barrier {event - 0x1000}'
+            events.append(e)
+        return events
+
+    def save(self, path):
+        with open(path, 'w') as f:
+            json.dump({'traceEvents': self.events(), 'displayTimeUnit': 'ns'}, f)
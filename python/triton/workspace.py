@@ -0,0 +1,134 @@
+"""
+Stream-ordered workspaces.
+
+Kernels that need temporary global memory, such as partial results, flags or locks, take it
+from the workspace of the current stream rather than allocating it at each call:
+
+    with triton.workspace.scope(x.device) as ws:
+        partials = ws.empty((M, num_chunks), torch.float32)
+        counters = ws.semaphores(M)
+        kernel[grid](x, partials, counters)
+
+`empty` suballocates from an arena of the stream. `semaphores` returns int32 counters that
+are zero when the kernels of the scope start, from a pool that is only zeroed when it grows:
+the kernels that use them must leave them at zero when they exit, as the last program to
+use a counter usually can. Memory is released when the scope exits: work queued later on the
+same stream runs after the kernels of the scope, so it may reuse the memory, while other
+streams have their own workspaces. Arenas and pools only grow, and keep their largest size
+until `empty_cache`.
+"""
+import contextlib
+import threading
+
+import torch
+
+# suballocations are aligned like those of the CUDA allocator, so that kernels
+# specialized for aligned pointers keep being reused
+_ALIGNMENT = 256
+_MIN_BYTES = 1 << 20
+
+
+class _Region:
+    """
+    Memory of a stream handed out in stack order. Buffers keep the storage they were cut from
+    alive, so growing a region while some of its buffers are in use replaces its storage only
+    for the next allocations
+    """
+
+    def __init__(self, zeroed):
+        self.zeroed = zeroed
+        self.storage = None
+        self.offset = 0
+
+    def reserved(self):
+        return 0 if self.storage is None else self.storage.numel()
+
+    def take(self, nbytes, device):
+        offset = (self.offset + _ALIGNMENT - 1) // _ALIGNMENT * _ALIGNMENT
+        end = offset + nbytes
+        if end > self.reserved():
+            size = max(end, 2 * self.reserved(), _MIN_BYTES)
+            alloc = torch.zeros if self.zeroed else torch.empty
+            self.storage = alloc(size, dtype=torch.uint8, device=device)
+        self.offset = end
+        return self.storage[offset:end]
+
+
+class _Pool:
+    # workspace of one stream
+    def __init__(self):
+        self.arena = _Region(zeroed=False)
+        self.semaphores = _Region(zeroed=True)
+
+
+_pools = dict()
+_lock = threading.Lock()
+
+
+def _pool(device, stream):
+    key = (device.index, stream.cuda_stream)
+    with _lock:
+        if key not in _pools:
+            _pools[key] = _Pool()
+        return _pools[key]
+
+
+class Workspace:
+    """
+    Allocations of a `scope`, valid until it exits
+    """
+
+    def __init__(self, device, pool):
+        self.device = device
+        self._pool = pool
+
+    def empty(self, shape, dtype):
+        """
+        Returns an uninitialized contiguous tensor of `shape` and `dtype`
+        """
+        shape = (shape,) if isinstance(shape, int) else tuple(shape)
+        numel = 1
+        for s in shape:
+            numel *= s
+        nbytes = numel * torch.empty((), dtype=dtype).element_size()
+        return self._pool.arena.take(nbytes, self.device).view(dtype).view(shape)
+
+    def semaphores(self, n):
+        """
+        Returns `n` int32 counters that are zero, and that the kernels of the scope must leave at zero
+        """
+        return self._pool.semaphores.take(4 * n, self.device).view(torch.int32)
+
+
+@contextlib.contextmanager
+def scope(device=None):
+    """
+    Workspace of the current stream of `device` (by default, the current device)
+    """
+    device = torch.device('cuda', torch.cuda.current_device()) if device is None else torch.device(device)
+    if device.index is None:
+        device = torch.device('cuda', torch.cuda.current_device())
+    pool = _pool(device, torch.cuda.current_stream(device))
+    offsets = pool.arena.offset, pool.semaphores.offset
+    try:
+        yield Workspace(device, pool)
+    finally:
+        pool.arena.offset, pool.semaphores.offset = offsets
+
+
+def memory_reserved():
+    """
+    Returns the bytes reserved by the workspaces, by (device index, stream handle)
+    """
+    with _lock:
+        return {key: pool.arena.reserved() + pool.semaphores.reserved() for key, pool in _pools.items()}
+
+
+def empty_cache():
+    """
+    Releases the memory of the workspaces that have no scope open. Their storage goes back
+    to the PyTorch allocator, which reuses it in the order of their streams
+    """
+    with _lock:
+        for key in [key for key, pool in _pools.items() if pool.arena.offset == 0 and pool.semaphores.offset == 0]:
+            del _pools[key]